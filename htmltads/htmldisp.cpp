@@ -886,6 +886,162 @@ void CHtmlDispBody::dispsite_inval(unsigned int x, unsigned int y,
         win_->inval_html_bg_image(x, y, width, height);
 }
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Font measurement cache accessors.  These belong to CHtmlSysFont, but
+ *   the cache itself is part of the display code, so we implement them
+ *   here. 
+ */
+CHtmlSysFont::~CHtmlSysFont()
+{
+    /* delete our measurement cache, if we created one */
+    if (meas_cache_ != 0)
+        delete meas_cache_;
+}
+
+CHtmlTextMeasureCache *CHtmlSysFont::get_meas_cache()
+{
+    /* create the cache on first use */
+    if (meas_cache_ == 0)
+        meas_cache_ = new CHtmlTextMeasureCache();
+
+    /* return it */
+    return meas_cache_;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Text measurement cache 
+ */
+
+CHtmlTextMeasureCache::CHtmlTextMeasureCache()
+{
+    /* start out empty */
+    memset(buckets_, 0, sizeof(buckets_));
+    cnt_ = 0;
+    bytes_ = 0;
+}
+
+CHtmlTextMeasureCache::~CHtmlTextMeasureCache()
+{
+    /* delete all of our entries */
+    flush();
+}
+
+/*
+ *   discard all entries 
+ */
+void CHtmlTextMeasureCache::flush()
+{
+    size_t i;
+
+    /* delete the entries in each bucket */
+    for (i = 0 ; i < HTML_MEAS_CACHE_BUCKETS ; ++i)
+    {
+        entry_t *e;
+        entry_t *nxt;
+
+        for (e = buckets_[i] ; e != 0 ; e = nxt)
+        {
+            nxt = e->nxt;
+            th_free(e);
+        }
+        buckets_[i] = 0;
+    }
+
+    /* we're empty now */
+    cnt_ = 0;
+    bytes_ = 0;
+}
+
+/*
+ *   compute a hash value for a string 
+ */
+unsigned int CHtmlTextMeasureCache::compute_hash(const textchar_t *txt,
+                                                 size_t len)
+{
+    unsigned int h;
+
+    /* FNV-1a */
+    for (h = 2166136261U ; len != 0 ; --len, ++txt)
+    {
+        h ^= (unsigned char)*txt;
+        h *= 16777619U;
+    }
+    return h;
+}
+
+/*
+ *   measure text, using a cached measurement if we have one 
+ */
+CHtmlPoint CHtmlTextMeasureCache::measure_text(CHtmlSysWin *win,
+                                               CHtmlSysFont *font,
+                                               const textchar_t *txt,
+                                               size_t len, int *ascent)
+{
+    unsigned int hash;
+    entry_t **bucket;
+    entry_t *e;
+    CHtmlPoint siz;
+    int asc;
+
+    /* don't bother with very long runs - they rarely repeat */
+    if (len > HTML_MEAS_CACHE_MAX_LEN)
+        return win->measure_text(font, txt, len, ascent);
+
+    /* look for an existing entry */
+    hash = compute_hash(txt, len);
+    bucket = &buckets_[hash % HTML_MEAS_CACHE_BUCKETS];
+    for (e = *bucket ; e != 0 ; e = e->nxt)
+    {
+        if (e->hash == hash && e->len == len
+            && memcmp(e + 1, txt, len * sizeof(textchar_t)) == 0)
+        {
+            /* got it - return the cached measurement */
+            if (ascent != 0)
+                *ascent = e->ascent;
+            return e->siz;
+        }
+    }
+
+    /* not cached - ask the window to measure it */
+    siz = win->measure_text(font, txt, len, &asc);
+    if (ascent != 0)
+        *ascent = asc;
+
+    /* if the cache is full, start over */
+    if (bytes_ + len > HTML_MEAS_CACHE_MAX_BYTES)
+        flush();
+
+    /* add a new entry, with a copy of the text following the header */
+    e = (entry_t *)th_malloc(sizeof(entry_t) + len * sizeof(textchar_t));
+    if (e != 0)
+    {
+        e->hash = hash;
+        e->len = len;
+        e->siz = siz;
+        e->ascent = asc;
+        memcpy(e + 1, txt, len * sizeof(textchar_t));
+        e->nxt = *bucket;
+        *bucket = e;
+        ++cnt_;
+        bytes_ += sizeof(entry_t) + len * sizeof(textchar_t);
+    }
+
+    /* return the measurement */
+    return siz;
+}
+
+/*
+ *   Measure text through the font's measurement cache 
+ */
+static CHtmlPoint measure_text_cached(CHtmlSysWin *win, CHtmlSysFont *font,
+                                      const textchar_t *txt, size_t len,
+                                      int *ascent)
+{
+    return font->get_meas_cache()->measure_text(win, font, txt, len, ascent);
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   text display object implementation 
@@ -906,7 +1062,7 @@ CHtmlDispText::CHtmlDispText(CHtmlSysWin *win, CHtmlSysFont *font,
     txtofs_ = txtofs;
 
     /* measure the size */
-    siz = win->measure_text(font, txt, len, &ascent);
+    siz = measure_text_cached(win, font, txt, len, &ascent);
     pos_.set(0, 0, siz.x, siz.y);
     ascent_ht_ = (unsigned short)ascent;
 }
@@ -933,7 +1089,7 @@ void CHtmlDispText::linked_text_cons(CHtmlSysWin *win, CHtmlDispLink *link)
                               CHtmlDispLink_clicked | CHtmlDispLink_hover);
 
     /* calculate our *real* size, now that we have the proper font */
-    siz = win->measure_text(font, txt_, len_, &ascent);
+    siz = measure_text_cached(win, font, txt_, len_, &ascent);
     pos_.bottom = pos_.top + siz.y;
     ascent_ht_ = (unsigned short)ascent;
 }
@@ -1297,7 +1453,7 @@ void CHtmlDispText::measure_for_table(CHtmlSysWin *win,
 
         /* add our width up to this point to the leftover */
         metrics->leftover_width_ +=
-            win->measure_text(font_, txt_, p - txt_, 0).x;
+            measure_text_cached(win, font_, txt_, p - txt_, 0).x;
 
         /* we don't need to use the leftover width */
         metrics->clear_leftover();
@@ -1343,9 +1499,9 @@ void CHtmlDispText::measure_for_table(CHtmlSysWin *win,
                 if (last_break_pos != 0)
                 {
                     /* measure the width from the last break position */
-                    wid = win->
-                          measure_text(font_, last_break_pos,
-                                        (size_t)(p - last_break_pos), 0).x;
+                    wid = measure_text_cached(win, font_, last_break_pos,
+                                              (size_t)(p - last_break_pos),
+                                              0).x;
                 }
                 else
                 {
@@ -1354,8 +1510,8 @@ void CHtmlDispText::measure_for_table(CHtmlSysWin *win,
                      *   the current position, and add the leftover width
                      *   from the previous item 
                      */
-                    wid = win->measure_text(font_, txt_,
-                                            (size_t)(p - txt_), 0).x
+                    wid = measure_text_cached(win, font_, txt_,
+                                              (size_t)(p - txt_), 0).x
                           + metrics->leftover_width_;
 
                     /* we've now consumed the leftover width */
@@ -1370,7 +1526,7 @@ void CHtmlDispText::measure_for_table(CHtmlSysWin *win,
             }
 
             /* add the separator to the line total */
-            wid = win->measure_text(font_, p, nxt - p, 0).x;
+            wid = measure_text_cached(win, font_, p, nxt - p, 0).x;
             metrics->add_to_cur_line(wid);
 
             /* remember the next character as the most recent break */
@@ -1390,8 +1546,9 @@ void CHtmlDispText::measure_for_table(CHtmlSysWin *win,
         metrics->leftover_width_ += measure_width(win);
     else if (last_break_pos < txt_ + len_)
         metrics->leftover_width_ +=
-            win->measure_text(font_, last_break_pos,
-                              (size_t)(len_ - (last_break_pos - txt_)), 0).x;
+            measure_text_cached(win, font_, last_break_pos,
+                                (size_t)(len_ - (last_break_pos - txt_)),
+                                0).x;
 
     /* remember my last character, if I have any characters */
     if (len_ != 0)
@@ -1736,7 +1893,7 @@ void CHtmlDispText::remove_trailing_whitespace(CHtmlSysWin *win, void *pos)
     displen_ = len_;
 
     /* calculate our new display size */
-    pos_.right = pos_.left + win->measure_text(font_, txt_, len_, 0).x;
+    pos_.right = pos_.left + measure_text_cached(win, font_, txt_, len_, 0).x;
 }
 
 /*
@@ -1781,7 +1938,7 @@ long CHtmlDispText::measure_trailing_ws_width(CHtmlSysWin *win) const
         return 0;
 
     /* measure the width of the spaces */
-    return win->measure_text(font_, p + 1, len_ - rem, 0).x;
+    return measure_text_cached(win, font_, p + 1, len_ - rem, 0).x;
 }
 
 /*
@@ -2145,59 +2302,55 @@ CHtmlDispTextInput::~CHtmlDispTextInput()
 }
 
 void CHtmlDispTextInput::diff_input_lists(CHtmlDispTextInput *other,
+                                          long difofs,
                                           class CHtmlSysWin *win)
 {
-    const textchar_t *p1;
-    const textchar_t *p2;
-    size_t len;
-    int did_inval;
-    
-    /*
-     *   Compare my buffer with the other one.  If we find a difference,
-     *   start invalidating at the difference. 
-     */
-    for (did_inval = FALSE, len = 0, p1 = txt_, p2 = other->txt_ ;
-         len < len_ && len < other->len_ ; ++p1, ++p2, ++len)
-    {
-        /* see if this character is different */
-        if (*p1 != *p2)
-        {
-            /* they differ - invalidate from here to the end of the line */
-            inval_eol(win, p1 - txt_);
-
-            /* note that we did the invalidation */
-            did_inval = TRUE;
+    long minlen;
+    long maxlen;
+    long ofs;
 
-            /*
-             *   no need to continue checking, since we're redrawing the
-             *   entire rest of the line 
-             */
-            break;
-        }
-    }
+    /* note the shorter and longer of the two lengths */
+    minlen = (len_ < other->len_ ? len_ : other->len_);
+    maxlen = (len_ > other->len_ ? len_ : other->len_);
 
     /*
-     *   If we didn't already invalidate the rest of the line, and if one
-     *   of the lists ran out before the other, invalidate from the
-     *   current position to the end of the line 
+     *   If both items start at the same character in the buffer and at
+     *   the same spot on the display, everything before the first change
+     *   looks exactly as it did, so we only need to redraw from the
+     *   change to the end of the text.  If the amount of text on the line
+     *   changed, the line wrapped differently, so redraw from the end of
+     *   the shorter text even if the change itself came later. 
      */
-    if (!did_inval && len_ != other->len_)
+    if (other->txt_ == txt_
+        && other->pos_.left == pos_.left
+        && other->pos_.top == pos_.top
+        && other->pos_.bottom == pos_.bottom)
     {
-        /* invalidate the one with more text remaining */
-        if (len_ > other->len_)
-            inval_eol(win, p1 - txt_);
-        else
-            other->inval_eol(win, p2 - other->txt_);
+        /* figure where the visible change starts */
+        ofs = (difofs < 0 ? 0 : difofs);
+        if (len_ != other->len_ && ofs > minlen)
+            ofs = minlen;
+
+        /* if anything on this line changed, redraw it */
+        if (ofs < maxlen)
+            inval_span(win, (int)ofs, other);
+    }
+    else
+    {
+        /* the line moved - redraw both the old and new versions */
+        other->inval_eol(win, 0);
+        inval_eol(win, 0);
     }
 
     /* if more items follow in both lists, diff the following items */
     if (input_continuation_ != 0 && other->input_continuation_ != 0)
     {
         /* both have follow-on's - diff those */
-        input_continuation_->
-            diff_input_lists(other->input_continuation_, win);
+        input_continuation_->diff_input_lists(
+            other->input_continuation_,
+            difofs - (long)(input_continuation_->txt_ - txt_), win);
     }
-    else
+    else if (input_continuation_ != 0 || other->input_continuation_ != 0)
     {
         /*
          *   one ends here, the other doesn't - invalidate to the bottom
@@ -2227,6 +2380,35 @@ void CHtmlDispTextInput::inval_eol(CHtmlSysWin *win, int textofs)
     win->inval_doc_coords(&r);
 }
 
+/*
+ *   invalidate the window from a given offset to the end of the longer of
+ *   two versions of the same line 
+ */
+void CHtmlDispTextInput::inval_span(CHtmlSysWin *win, int textofs,
+                                    const CHtmlDispTextInput *other)
+{
+    CHtmlRect r;
+
+    /* start with our own position */
+    r = pos_;
+
+    /* 
+     *   advance past the given offset in the text; the text before the
+     *   offset is the same in both versions, so we can measure it in our
+     *   own text, as long as we don't go past our end 
+     */
+    if ((size_t)textofs > len_)
+        textofs = len_;
+    r.left += win->measure_text(font_, txt_, textofs, 0).x;
+
+    /* go to the end of whichever version is wider */
+    if (other->pos_.right > r.right)
+        r.right = other->pos_.right;
+
+    /* invalidate the area */
+    win->inval_doc_coords(&r);
+}
+
 /*
  *   invalidate the window below this item to the bottom of the window
  */
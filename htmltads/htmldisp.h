@@ -41,6 +41,15 @@ Modified
 #include "htmlsys.h"
 #endif
 
+/*
+ *   Text measurement cache parameters.  We don't bother caching runs
+ *   longer than HTML_MEAS_CACHE_MAX_LEN bytes, and we start over when a
+ *   font's cache holds more than HTML_MEAS_CACHE_MAX_BYTES bytes of text.  
+ */
+#define HTML_MEAS_CACHE_BUCKETS    512
+#define HTML_MEAS_CACHE_MAX_LEN    4096
+#define HTML_MEAS_CACHE_MAX_BYTES  (256*1024)
+
 
 /* ------------------------------------------------------------------------ */
 /*
@@ -54,6 +63,69 @@ enum htmldisp_heapid_t
     HTMLDISP_HEAPID_FMT = 1                               /* formatter heap */
 };
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Text measurement cache.  Each font has one of these (see
+ *   CHtmlSysFont::get_meas_cache()); it remembers the sizes of the text
+ *   runs that the text display items have measured in the font.  Text
+ *   display items are rebuilt from scratch on each reformat, but the text
+ *   itself usually isn't, so when the window is reformatted - after a
+ *   change in width, say - most of the measurements come out of the cache
+ *   and only the line breaking has to be redone.
+ *   
+ *   Entries are keyed on the text itself rather than its address, since
+ *   the text of an input line changes in place as the user edits it, and
+ *   text array pages can be reused after they're deleted.  The cache is
+ *   bounded: when it fills up, we simply discard everything and start
+ *   over.  
+ */
+class CHtmlTextMeasureCache
+{
+public:
+    CHtmlTextMeasureCache();
+    ~CHtmlTextMeasureCache();
+
+    /*
+     *   Measure text in the given font.  This returns the same information
+     *   as CHtmlSysWin::measure_text(), asking the window to do the work
+     *   only if we haven't measured the same text before.  'ascent' can be
+     *   null if the caller doesn't need it.  
+     */
+    CHtmlPoint measure_text(class CHtmlSysWin *win, class CHtmlSysFont *font,
+                            const textchar_t *txt, size_t len, int *ascent);
+
+    /* discard all cached measurements */
+    void flush();
+
+protected:
+    /* a cached measurement */
+    struct entry_t
+    {
+        /* next entry in the hash chain */
+        entry_t *nxt;
+
+        /* hash value and length of the text */
+        unsigned int hash;
+        size_t len;
+
+        /* measured size and ascent height */
+        CHtmlPoint siz;
+        int ascent;
+
+        /* the text follows the structure */
+    };
+
+    /* compute the hash value for a string */
+    static unsigned int compute_hash(const textchar_t *txt, size_t len);
+
+    /* hash table */
+    entry_t *buckets_[HTML_MEAS_CACHE_BUCKETS];
+
+    /* number of entries and total bytes of cached text */
+    size_t cnt_;
+    size_t bytes_;
+};
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Whitespace search object.  This lets us search a series of display
@@ -582,6 +654,15 @@ public:
     virtual class CHtmlDispLink *get_link(class CHtmlFormatter *formatter,
                                           int /*x*/, int /*y*/) const;
 
+    /*
+     *   Determine if get_link() can return different links for different
+     *   points within the item, as it can for an image with an image map.
+     *   A caller tracking the link under the mouse can skip looking it up
+     *   again while the mouse stays within an item for which this returns
+     *   false.  
+     */
+    virtual int link_varies_by_pos() const { return FALSE; }
+
     /*
      *   Get the link I inherit from my enclosing DIV, if any.  This looks
      *   for the innermost enclosing DIV that has an associated link.  
@@ -1761,8 +1842,14 @@ public:
 
     ~CHtmlDispTextInput();
 
-    /* compare myself to another text display list */
-    void diff_input_lists(CHtmlDispTextInput *other,
+    /*
+     *   Compare myself to another text display list, and invalidate the
+     *   parts of the display that differ.  'other' is the list we're
+     *   replacing; 'difofs' is the offset, relative to the start of my
+     *   text, of the first character that changed in the underlying
+     *   buffer.  
+     */
+    void diff_input_lists(CHtmlDispTextInput *other, long difofs,
                           class CHtmlSysWin *win);
 
     /* create a new display item of the same type for breaking the line */
@@ -1794,6 +1881,13 @@ private:
      */
     void inval_eol(class CHtmlSysWin *win, int textofs);
 
+    /*
+     *   invalidate from a given text offset to the right end of either
+     *   this item or the other item, whichever extends further 
+     */
+    void inval_span(class CHtmlSysWin *win, int textofs,
+                    const CHtmlDispTextInput *other);
+
     /*
      *   invalidate from below this item to the bottom of the window on
      *   the display 
@@ -2672,6 +2766,9 @@ public:
     /* get my link object */
     CHtmlDispLink *get_link(class CHtmlFormatter *, int, int) const;
 
+    /* with an image map, the link depends on where in the image we are */
+    int link_varies_by_pos() const { return usemap_.get_url() != 0; }
+
     /* 
      *   An unliked image won't change appearance on click changes, so don't
      *   invalidate.  (Images can take up large areas of the screen, so it's
@@ -853,6 +853,46 @@ void CHtmlFormatter::extract_text(CStringBuf *buf,
     }
 }
 
+/*
+ *   Extract text in pieces 
+ */
+void CHtmlFormatter::extract_text(CStringBuf *buf,
+                                  unsigned long start_ofs,
+                                  unsigned long end_ofs, size_t chunk,
+                                  void (*flush)(void *ctx,
+                                                const textchar_t *txt,
+                                                size_t len),
+                                  void *ctx) const
+{
+    CHtmlDisp *disp;
+
+    /* start with an empty buffer */
+    buf->setlen(0);
+
+    /* traverse our display items and pull out their text values */
+    for (disp = find_by_txtofs(start_ofs, FALSE, TRUE) ;
+         disp != 0 ; disp = disp->get_next_disp())
+    {
+        /* if we're past the ending offset, we're done */
+        if (disp->is_past_text_ofs(end_ofs))
+            break;
+
+        /* add this item's text to the buffer */
+        disp->add_text_to_buf_clip(buf, start_ofs, end_ofs);
+
+        /* if we have a full piece, pass it on and start over */
+        if (buf->getlen() >= chunk)
+        {
+            (*flush)(ctx, buf->get(), buf->getlen());
+            buf->setlen(0);
+        }
+    }
+
+    /* pass on whatever's left */
+    if (buf->getlen() != 0)
+        (*flush)(ctx, buf->get(), buf->getlen());
+}
+
 /*
  *   Do some formatting and return.  We'll remember where we were, so the
  *   client can repeatedly call this routine to format an entire document.
@@ -2843,6 +2883,115 @@ void CHtmlFormatter::inval_links_on_screen(const CHtmlRect *area)
 }
 
 
+/*
+ *   Draw everything in a set of areas 
+ */
+void CHtmlFormatter::draw_areas(const CHtmlRect *areas, size_t cnt)
+{
+    CHtmlRect bounds;
+    CHtmlDisp *cur;
+    long cur_ypos;
+    long line_index;
+    size_t i;
+
+    /* if there's only one area, draw it the usual way */
+    if (cnt == 0)
+        return;
+    if (cnt == 1)
+    {
+        draw(areas, FALSE, 0);
+        return;
+    }
+
+    /* figure the bounding box of the areas */
+    bounds = areas[0];
+    for (i = 1 ; i < cnt ; ++i)
+    {
+        if (areas[i].left < bounds.left) bounds.left = areas[i].left;
+        if (areas[i].top < bounds.top) bounds.top = areas[i].top;
+        if (areas[i].right > bounds.right) bounds.right = areas[i].right;
+        if (areas[i].bottom > bounds.bottom) bounds.bottom = areas[i].bottom;
+    }
+
+    /* find the first line containing the top of the bounding box */
+    if (line_starts_->get_count() == 0)
+    {
+        line_index = 0;
+        cur = disp_head_;
+        cur_ypos = 0;
+    }
+    else
+    {
+        line_index = line_starts_->find_by_ypos(bounds.top);
+        cur = line_starts_->get(line_index);
+        cur_ypos = line_starts_->get_ypos(line_index);
+    }
+
+    /* draw lines until we're past the bottom of the bounding box */
+    while (cur != 0 && cur_ypos <= bounds.bottom)
+    {
+        CHtmlDisp *nxt_line;
+        long nxt_ypos;
+        int line_in_view;
+
+        /* note the next line and its position */
+        if (line_index + 1 < line_count_)
+        {
+            nxt_line = line_starts_->get(line_index + 1);
+            nxt_ypos = line_starts_->get_ypos(line_index + 1);
+        }
+        else
+        {
+            nxt_line = 0;
+            nxt_ypos = layout_max_y_pos_;
+        }
+
+        /* 
+         *   Check whether the line's vertical extent touches any of the
+         *   areas.  Items can extend past the line's extent (tall images,
+         *   table cells), so when there's no line start table to go by,
+         *   always check the items. 
+         */
+        for (i = 0, line_in_view = (line_starts_->get_count() == 0) ;
+             i < cnt && !line_in_view ; ++i)
+        {
+            if (areas[i].top <= nxt_ypos && areas[i].bottom >= cur_ypos)
+                line_in_view = TRUE;
+        }
+
+        /* draw the items on this line that intersect an area */
+        for ( ; cur != 0 && cur != nxt_line ; cur = cur->get_next_disp())
+        {
+            CHtmlRect curpos = cur->get_pos();
+
+            /* 
+             *   if the line isn't in view, only bother with items that
+             *   reach outside of the line 
+             */
+            if (!line_in_view
+                && curpos.top >= cur_ypos && curpos.bottom <= nxt_ypos)
+                continue;
+
+            /* draw it if it intersects any area */
+            for (i = 0 ; i < cnt ; ++i)
+            {
+                if (curpos.right >= areas[i].left
+                    && curpos.left <= areas[i].right
+                    && curpos.bottom >= areas[i].top
+                    && curpos.top <= areas[i].bottom)
+                {
+                    cur->draw(win_, sel_start_, sel_end_, FALSE);
+                    break;
+                }
+            }
+        }
+
+        /* move on to the next line */
+        ++line_index;
+        cur_ypos = nxt_ypos;
+    }
+}
+
 /*
  *   Get the height of the line at the given y position 
  */
@@ -3083,6 +3232,14 @@ CHtmlDisp *CHtmlFormatter::find_by_pos(CHtmlPoint pos, int exact) const
  */
 CHtmlDispDIV *CHtmlFormatter::find_div_by_pos(CHtmlPoint pos) const
 {
+    /* 
+     *   if there aren't any <DIV>s, don't bother looking up the text
+     *   offset - this is the common case when tracking the mouse over
+     *   blank space 
+     */
+    if (div_list_.get_count() == 0)
+        return 0;
+
     /* get our text offste, and find the item that way */
     return find_div_by_ofs(find_textofs_by_pos(pos), pos.y);
 }
@@ -3762,6 +3919,27 @@ void CHtmlFormatter::inval_window()
     }
 }
 
+/*
+ *   Get the amount of heap memory in use 
+ */
+unsigned long CHtmlFormatter::get_heap_mem_in_use() const
+{
+    unsigned long total;
+    size_t i;
+
+    /* if we haven't allocated anything yet, we're not using anything */
+    if (heap_pages_ == 0 || heap_pages_alloced_ == 0)
+        return 0;
+
+    /* add up the full pages before the current one */
+    for (i = 0, total = 0 ; i < heap_page_cur_ && i < heap_pages_alloced_ ;
+         ++i)
+        total += heap_pages_[i].siz;
+
+    /* add the part of the current page we've used */
+    return total + heap_page_cur_ofs_;
+}
+
 /*
  *   Heap allocator.  The formatter provides a simple heap for allocating
  *   display items.  Only display items should be allocated here, since an
@@ -4039,26 +4217,41 @@ CHtmlTagTABLE *CHtmlFormatter::begin_table(CHtmlTagTABLE *table_tag,
     /* presume we won't need a y offset for the contents as we format */
     y_ofs = 0;
 
+    /*
+     *   If this is an outermost table, and we're on the first line (i.e.,
+     *   there are no line starts), insert a zero-height line before the
+     *   start of the table.  
+     */
+    if (table_pass_ == 0 && line_count_ == 0)
+    {
+        /* 
+         *   add a blank item to anchor the first line, then start a new
+         *   line -- make both of these zero-height breaks, since we only
+         *   need something to serve as a placeholder in the list and don't
+         *   want to actually take up any screen space 
+         */
+        add_disp_item(new (this) CHtmlDispBreak(0));
+        add_disp_item_new_line(new (this) CHtmlDispBreak(0));
+    }
+
+    /*
+     *   If this is an outermost table that we've measured before, from its
+     *   complete contents and with the fonts we have now, the cell metrics
+     *   from back then still hold: they depend only on the contents and
+     *   the fonts, not on the window width.  So there's no need to run
+     *   the measuring pass again; go straight to the second pass.  This
+     *   makes reformatting for a new window width, or redrawing a banner
+     *   that's laid out as a table, much cheaper.  
+     */
+    if (table_pass_ == 0 && table_tag->is_closed() && win_ != 0
+        && win_->get_font_generation() != 0
+        && table_tag->get_metrics_gen() == win_->get_font_generation())
+        table_pass_ = 2;
+
     /* check which pass over the table we're running */
     switch(table_pass_)
     {
     case 0:
-        /*
-         *   If we're on the first line (i.e., there are no line starts),
-         *   insert a zero-height line before the start of the table.  
-         */
-        if (line_count_ == 0)
-        {
-            /* 
-             *   add a blank item to anchor the first line, then start a
-             *   new line -- make both of these zero-height breaks, since
-             *   we only need something to serve as a placeholder in the
-             *   list and don't want to actually take up any screen space 
-             */
-            add_disp_item(new (this) CHtmlDispBreak(0));
-            add_disp_item_new_line(new (this) CHtmlDispBreak(0));
-        }
-        
         /*
          *   We're not yet doing a table, so this is an outermost (not
          *   nested) table.  Prepare for the first pass, which will simply
@@ -4243,6 +4436,15 @@ void CHtmlFormatter::end_table(CHtmlDispTable *table_disp,
          */
         if (enclosing_table == 0)
         {
+            /* 
+             *   The whole table has now been measured.  If it's complete,
+             *   note the font generation we measured it with, so that we
+             *   can skip this pass on later reformats with the same fonts. 
+             */
+            ending_table->set_metrics_gen(ending_table->is_closed()
+                                          ? win_->get_font_generation()
+                                          : 0);
+
             /* time for pass two */
             run_table_pass_two(ending_table);
 
@@ -4361,6 +4563,14 @@ void CHtmlFormatter::end_table(CHtmlDispTable *table_disp,
             win_->inval_doc_coords(&pos);
         }
 
+        /* 
+         *   if we went straight to pass 2 on an outermost table, because
+         *   we already had its metrics, we're done with table formatting;
+         *   otherwise run_table_pass_two() will reset this when it's done 
+         */
+        if (enclosing_table == 0)
+            table_pass_ = 0;
+
         /* done with pass 2 */
         break;
     }
@@ -5701,6 +5911,10 @@ void CHtmlFormatterInput::add_disp_item_input(CHtmlDispTextInput *item,
                                               class CHtmlTagTextInput *tag)
 {
     int old_freeze;
+    const textchar_t *p1;
+    const textchar_t *p2;
+    size_t len;
+    size_t difofs;
 
     /* freeze display updating while we're formatting the input line */
     old_freeze = freeze_display_adjust_;
@@ -5762,13 +5976,25 @@ void CHtmlFormatterInput::add_disp_item_input(CHtmlDispTextInput *item,
         if (!old_freeze)
             win_->fmt_adjust_vscroll();
 
+        /*
+         *   Find the first character that changed since we last
+         *   formatted the input.  Everything before it looks the same as
+         *   before, unless the layout moved it.  
+         */
+        p1 = tag->get_input_buf();
+        p2 = input_snap_.get();
+        len = tag->get_input_len();
+        if (len > input_snap_.getlen())
+            len = input_snap_.getlen();
+        for (difofs = 0 ; difofs < len && p1[difofs] == p2[difofs] ;
+             ++difofs) ;
+
         /*
          *   compare the old input item list and the new input item list;
-         *   if we find a point at which they differ, invalidate the
-         *   display from that point forward so that we'll redraw the
-         *   changes 
+         *   invalidate only the parts of the display that changed, so
+         *   that we'll redraw the changes 
          */
-        item->diff_input_lists(input_head_, win_);
+        item->diff_input_lists(input_head_, (long)difofs, win_);
 
         /* we're done with the old input display items, so delete them */
         CHtmlDisp::delete_list(input_head_);
@@ -5819,6 +6045,9 @@ void CHtmlFormatterInput::add_disp_item_input(CHtmlDispTextInput *item,
             win_->fmt_adjust_vscroll();
     }
 
+    /* remember the text we're now showing, for comparison next time */
+    input_snap_.set(tag->get_input_buf(), tag->get_input_len());
+
     /* resume normal display adjustments */
     freeze_display_adjust_ = old_freeze;
 }
@@ -5885,6 +6114,22 @@ unsigned long CHtmlFormatterInput::store_input_text_temp(
     return parser_->get_text_array()->store_text_temp(txt, len);
 }
 
+/*
+ *   Determine if the input display is up to date with the given text 
+ */
+int CHtmlFormatterInput::is_input_current(const CHtmlTagTextInput *tag,
+                                          const textchar_t *buf,
+                                          size_t len) const
+{
+    /* if this isn't the input we've formatted, it's not current */
+    if (tag == 0 || tag != input_tag_ || input_pre_ == 0)
+        return FALSE;
+
+    /* it's current if the text matches what we last formatted */
+    return (len == input_snap_.getlen()
+            && (len == 0 || memcmp(buf, input_snap_.get(), len) == 0));
+}
+
 /*
  *   End the current command input line 
  */
@@ -6610,6 +6855,16 @@ void CHtmlFormatterBannerExtText::flush_txtbuf(int fmt)
     if (win_ == 0)
         return;
 
+    /* 
+     *   if nothing has been added since the last flush, and nothing is
+     *   left over from an earlier unformatted flush, there's no work to do;
+     *   the frame flushes every banner whenever the main window is flushed,
+     *   so skipping the formatting pass here saves redoing it for all of the
+     *   banners that didn't change 
+     */
+    if (txtbuf_->getlen() == 0 && (!fmt || !more_to_do()))
+        return;
+
     /* parse what's in the source buffer */
     parser_->parse(txtbuf_, win_->get_win_group());
 
@@ -7185,6 +7440,7 @@ CHtmlLineStarts::CHtmlLineStarts()
     pages_ = (CHtmlLineStartEntry **)
              th_malloc(top_pages_allocated_ * sizeof(CHtmlLineStartEntry *));
     count_ = 0;
+    last_found_ = 0;
 }
 
 CHtmlLineStarts::~CHtmlLineStarts()
@@ -7271,6 +7527,24 @@ long CHtmlLineStarts::find(const CHtmlLineStartSearcher *searcher) const
     long high_index;
     long cur_index;
 
+    /*
+     *   Lookups tend to cluster: mouse tracking asks about the same line
+     *   over and over as the pointer moves, and scrolling and selection
+     *   move a line at a time.  So before searching, check the line we
+     *   found last time, and the one after it. 
+     */
+    for (cur_index = last_found_ ;
+         cur_index < count_ && cur_index <= last_found_ + 1 ; ++cur_index)
+    {
+        if (searcher->is_between(get_internal(cur_index),
+                                 cur_index == count_ - 1 ? 0
+                                 : get_internal(cur_index + 1)))
+        {
+            last_found_ = cur_index;
+            return cur_index;
+        }
+    }
+
     /* do a binary search for the item containing the given position */
     for (low_index = 0, high_index = count_ - 1 ; ; )
     {
@@ -7291,7 +7565,10 @@ long CHtmlLineStarts::find(const CHtmlLineStartSearcher *searcher) const
 
         /* if this one matches, accept it */
         if (searcher->is_between(cur_entry, nxt_entry))
+        {
+            last_found_ = cur_index;
             return cur_index;
+        }
 
         /* see if we're above or below */
         if (searcher->is_low(cur_entry))
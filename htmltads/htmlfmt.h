@@ -461,6 +461,12 @@ private:
      *   one, since the caller may not fill in all items) 
      */
     long count_;
+
+    /* 
+     *   index of the entry found by the most recent search - we check
+     *   here first on the next search 
+     */
+    mutable long last_found_;
 };
 
 /* ------------------------------------------------------------------------ */
@@ -968,6 +974,16 @@ public:
      */
     void draw(const CHtmlRect *area, int clip_lines, long *clip_y);
 
+    /*
+     *   Draw everything in a set of areas.  This is for windows that keep
+     *   track of the updated part of the window as a list of rectangles:
+     *   rather than drawing everything in the bounding box of the update,
+     *   we skip lines that don't touch any of the areas, and items that
+     *   don't intersect any of them.  Each item is drawn at most once, even
+     *   if it overlaps several areas.  
+     */
+    void draw_areas(const CHtmlRect *areas, size_t cnt);
+
     /*
      *   Invalidate links that are visible on the screen.  This is used to
      *   quickly redraw the window's links (and only its links) for a
@@ -1006,6 +1022,21 @@ public:
     void extract_text(CStringBuf *buf,
                       unsigned long start_ofs, unsigned long end_ofs) const;
 
+    /*
+     *   Extract text in pieces.  This works like extract_text(), but rather
+     *   than collecting all of the text in 'buf', we pass it to 'flush'
+     *   whenever the buffer holds at least 'chunk' bytes, then reuse the
+     *   buffer for the next piece, so that extracting a large range doesn't
+     *   need a buffer for all of it.  Each piece ends at a display item
+     *   boundary, so it never splits a character.  
+     */
+    void extract_text(CStringBuf *buf,
+                      unsigned long start_ofs, unsigned long end_ofs,
+                      size_t chunk,
+                      void (*flush)(void *ctx, const textchar_t *txt,
+                                    size_t len),
+                      void *ctx) const;
+
     /* get the height of the line at the given y position */
     long get_line_height_ypos(long ypos) const;
 
@@ -1348,6 +1379,14 @@ public:
      */
     void *heap_alloc(size_t siz);
 
+    /* 
+     *   Get the amount of formatter heap memory currently in use for
+     *   display items.  Together with the text array's memory in use, this
+     *   tells the caller how much memory the window's contents are taking
+     *   up, for deciding when to prune the parse tree. 
+     */
+    unsigned long get_heap_mem_in_use() const;
+
     /* get my "stop" flag */
     int get_stop_formatting() const { return stop_formatting_; }
 
@@ -2203,6 +2242,15 @@ public:
     virtual unsigned long store_input_text_temp(
         const textchar_t *txt, size_t len);
 
+    /*
+     *   Determine if the given input tag is the active input, and its
+     *   display items still show the given text.  When this returns true,
+     *   the UI doesn't need to reformat the input; this is the case when
+     *   the user merely moves the caret or the selection.  
+     */
+    int is_input_current(const class CHtmlTagTextInput *tag,
+                         const textchar_t *buf, size_t len) const;
+
 protected:
     /* clear the old input line */
     void clear_old_input();
@@ -2236,6 +2284,14 @@ protected:
 
     /* first item on input line */
     class CHtmlDisp *input_line_head_;
+
+    /*
+     *   The input text as of the last time we formatted it.  The display
+     *   items point directly into the UI's buffer, so by the time we
+     *   reformat, the old items already show the new text; we compare
+     *   against this copy to find where the text actually changed.  
+     */
+    CStringBuf input_snap_;
 };
 
 
@@ -41,11 +41,17 @@ unsigned int CHtmlHashFuncCI::compute_hash(const textchar_t *s, size_t l)
     unsigned int acc;
 
     /*
-     *   add up all the character values in the string, converting all
-     *   characters to upper-case 
+     *   combine the character values in the string, converting all
+     *   characters to upper-case (this is FNV-1a; unlike a plain sum of
+     *   the characters, it distinguishes anagrams such as "TD" and "DT",
+     *   which lets CHtmlHashTable::make_perfect() find collision-free
+     *   layouts for the parser's tables) 
      */
-    for (acc = 0 ; l != 0 ; ++s, --l)
-        acc += is_lower(*s) ? to_upper(*s) : *s;
+    for (acc = 2166136261U ; l != 0 ; ++s, --l)
+    {
+        acc ^= (unsigned char)(is_lower(*s) ? to_upper(*s) : *s);
+        acc *= 16777619U;
+    }
 
     /* return the accumulated value */
     return acc;
@@ -60,11 +66,14 @@ unsigned int CHtmlHashFuncCS::compute_hash(const textchar_t *s, size_t l)
     unsigned int acc;
 
     /*
-     *   add up all the character values in the string, treating case as
-     *   significant 
+     *   combine the character values in the string (FNV-1a), treating case
+     *   as significant 
      */
-    for (acc = 0 ; l != 0 ; ++s, --l)
-        acc += *s;
+    for (acc = 2166136261U ; l != 0 ; ++s, --l)
+    {
+        acc ^= (unsigned char)*s;
+        acc *= 16777619U;
+    }
 
     /* return the accumulated value */
     return acc;
@@ -170,6 +179,8 @@ CHtmlHashTable::CHtmlHashTable(int hash_table_size,
     /* allocate the table */
     table_ = new CHtmlHashEntry *[hash_table_size];
     table_size_ = hash_table_size;
+    entry_cnt_ = 0;
+    seed_ = 0;
 
     /* clear the table */
     for (entry = table_, i = 0 ; i < table_size_ ; ++i, ++entry)
@@ -214,6 +225,9 @@ void CHtmlHashTable::delete_all_entries()
         /* there's nothing at this table entry now */
         *tableptr = 0;
     }
+
+    /* the table is now empty */
+    entry_cnt_ = 0;
 }
 
 /*
@@ -242,7 +256,146 @@ unsigned int CHtmlHashTable::compute_hash(CHtmlHashEntry *entry)
  */
 unsigned int CHtmlHashTable::compute_hash(const textchar_t *str, size_t len)
 {
-    return (hash_function_->compute_hash(str, len) & (table_size_ - 1));
+    return bucket_for(hash_function_->compute_hash(str, len),
+                      table_size_, seed_);
+}
+
+/*
+ *   Get the bucket for a raw hash value, given a table size and seed.  Mix
+ *   the bits first, so that the bucket depends on all of the bits of the
+ *   raw value, not just the low ones; the seed selects one of many
+ *   different mixings, for make_perfect().  
+ */
+unsigned int CHtmlHashTable::bucket_for(unsigned int hash, size_t size,
+                                        unsigned int seed)
+{
+    hash = (hash ^ seed) * 0x9E3779B1U;
+    return ((hash ^ (hash >> 16)) & (size - 1));
+}
+
+/*
+ *   Rearrange the table so that no two entries share a bucket 
+ */
+int CHtmlHashTable::make_perfect(size_t max_size)
+{
+    CHtmlHashEntry **entries;
+    unsigned int *hashes;
+    unsigned char *used;
+    size_t cnt;
+    size_t size;
+    size_t i;
+    int found;
+
+    /* gather up the entries and their raw hash values */
+    entries = new CHtmlHashEntry *[entry_cnt_ + 1];
+    hashes = new unsigned int[entry_cnt_ + 1];
+    for (i = 0, cnt = 0 ; i < table_size_ ; ++i)
+    {
+        CHtmlHashEntry *entry;
+        for (entry = table_[i] ; entry != 0 ; entry = entry->nxt_, ++cnt)
+        {
+            entries[cnt] = entry;
+            hashes[cnt] = hash_function_->compute_hash(entry->getstr(),
+                                                       entry->getlen());
+        }
+    }
+
+    /* 
+     *   start with the smallest power of two that's at least twice the
+     *   number of entries, and try a series of seeds at each size until
+     *   we find a layout without collisions 
+     */
+    for (size = 16 ; size < cnt * 2 ; size <<= 1) ;
+    for (found = FALSE, used = 0 ; !found && size <= max_size ; size <<= 1)
+    {
+        unsigned int seed;
+        int tries;
+
+        /* allocate the bucket usage map for this size */
+        delete [] used;
+        used = new unsigned char[size];
+
+        for (tries = 0, seed = 0 ; !found && tries < 64 ;
+             ++tries, seed += 0x85EBCA6BU)
+        {
+            /* check for collisions with this seed */
+            memset(used, 0, size);
+            for (i = 0 ; i < cnt ; ++i)
+            {
+                unsigned int b = bucket_for(hashes[i], size, seed);
+                if (used[b])
+                    break;
+                used[b] = 1;
+            }
+
+            /* if we placed every entry, rebuild the table this way */
+            if (i == cnt)
+            {
+                delete [] table_;
+                table_ = new CHtmlHashEntry *[size];
+                table_size_ = size;
+                seed_ = seed;
+                for (i = 0 ; i < size ; ++i)
+                    table_[i] = 0;
+                for (i = 0 ; i < cnt ; ++i)
+                {
+                    unsigned int b = bucket_for(hashes[i], size, seed);
+                    entries[i]->nxt_ = 0;
+                    table_[b] = entries[i];
+                }
+                found = TRUE;
+            }
+        }
+
+        /* if we found a layout at this size, don't go on to the next */
+        if (found)
+            break;
+    }
+
+    /* done with our working arrays */
+    delete [] used;
+    delete [] entries;
+    delete [] hashes;
+
+    /* tell the caller whether we succeeded */
+    return found;
+}
+
+/*
+ *   Double the table size 
+ */
+void CHtmlHashTable::grow()
+{
+    CHtmlHashEntry **old_table = table_;
+    size_t old_size = table_size_;
+    size_t i;
+
+    /* allocate and clear the new table */
+    table_size_ = old_size * 2;
+    table_ = new CHtmlHashEntry *[table_size_];
+    for (i = 0 ; i < table_size_ ; ++i)
+        table_[i] = 0;
+
+    /* move each entry from the old table into its new bucket */
+    for (i = 0 ; i < old_size ; ++i)
+    {
+        CHtmlHashEntry *entry, *nxt;
+        for (entry = old_table[i] ; entry != 0 ; entry = nxt)
+        {
+            unsigned int hash;
+
+            /* remember the next entry in the old chain */
+            nxt = entry->nxt_;
+
+            /* link it into its new chain */
+            hash = compute_hash(entry);
+            entry->nxt_ = table_[hash];
+            table_[hash] = entry;
+        }
+    }
+
+    /* done with the old table */
+    delete [] old_table;
 }
 
 /*
@@ -258,6 +411,10 @@ void CHtmlHashTable::add(CHtmlHashEntry *entry)
     /* link it into the slot for this hash value */
     entry->nxt_ = table_[hash];
     table_[hash] = entry;
+
+    /* count it, and grow the table if the chains are getting long */
+    if (++entry_cnt_ > table_size_ * HTML_HASH_MAX_LOAD)
+        grow();
 }
 
 /*
@@ -278,6 +435,7 @@ void CHtmlHashTable::remove(CHtmlHashEntry *entry)
     {
         /* it's the first item - simply advance the head to the next item */
         table_[hash] = entry->nxt_;
+        --entry_cnt_;
     }
     else
     {
@@ -289,7 +447,10 @@ void CHtmlHashTable::remove(CHtmlHashEntry *entry)
 
         /* if we found it, unlink this item */
         if (prv != 0)
+        {
             prv->nxt_ = entry->nxt_;
+            --entry_cnt_;
+        }
     }
 }
 
@@ -80,6 +80,10 @@ protected:
 /*
  *   Hash table 
  */
+
+/* maximum average entries per bucket before the table grows */
+#define HTML_HASH_MAX_LOAD  2
+
 class CHtmlHashTable
 {
 public:
@@ -87,6 +91,10 @@ public:
      *   Construct a hash table.  IMPORTANT: the hash table object takes
      *   ownership of the hash function object, so the hash table object
      *   will delete the hash function object when the table is deleted.
+     *   
+     *   The size is only the initial number of buckets; the table doubles
+     *   its bucket count as entries are added, whenever the average chain
+     *   would grow longer than HTML_HASH_MAX_LOAD entries.  
      */
     CHtmlHashTable(int hash_table_size, CHtmlHashFunc *hash_function);
 
@@ -134,18 +142,46 @@ public:
     void enum_entries(void (*func)(void *ctx, class CHtmlHashEntry *entry),
                       void *ctx);
 
+    /* get the number of entries in the table */
+    size_t get_entry_count() const { return entry_cnt_; }
+
+    /*
+     *   Make the table a perfect hash.  This is for tables with a fixed set
+     *   of entries, such as the parser's tag and attribute name tables:
+     *   once all of the entries have been added, we look for a table size
+     *   (no larger than 'max_size', which must be a power of two) and
+     *   hash seed that give every entry a bucket to itself, so that a
+     *   lookup never compares more than one entry.  Returns true if we
+     *   found such a layout; if not, the table is left as it was.  Adding
+     *   entries afterwards is allowed, but they might collide again.  
+     */
+    int make_perfect(size_t max_size);
+
 private:
     /* internal service routine for checking hash table sizes for validity */
     int is_power_of_two(int n);
 
+    /* double the number of buckets, redistributing the entries */
+    void grow();
+
     /* compute the hash value for an entry/a string */
     unsigned int compute_hash(CHtmlHashEntry *entry);
     unsigned int compute_hash(const textchar_t *str, size_t len);
 
+    /* get the bucket index for a raw hash value */
+    static unsigned int bucket_for(unsigned int hash, size_t size,
+                                   unsigned int seed);
+
     /* the table of hash entries */
     CHtmlHashEntry **table_;
     size_t table_size_;
 
+    /* number of entries in the table */
+    size_t entry_cnt_;
+
+    /* seed for mixing the hash values (see make_perfect()) */
+    unsigned int seed_;
+
     /* hash function */
     CHtmlHashFunc *hash_function_;
 };
@@ -730,6 +730,17 @@ void CHtmlParser::init(int literal_mode)
         attr_val_table_->add(entry);
     }
 
+    /*
+     *   The name tables never change after this point, and they're
+     *   consulted for every tag and attribute we parse, so lay each one
+     *   out as a perfect hash, with at most one entry in each bucket.  (The
+     *   '&' table is much bigger and far less busy, so it's not worth the
+     *   memory a collision-free layout would take.)  
+     */
+    tag_table_->make_perfect(HTML_PARSER_PERFECT_HASH_MAX);
+    attr_table_->make_perfect(HTML_PARSER_PERFECT_HASH_MAX);
+    attr_val_table_->make_perfect(HTML_PARSER_PERFECT_HASH_MAX);
+
     /* allocate the text array for storing the text stream */
     text_array_ = new CHtmlTextArray;
 
@@ -2221,6 +2232,32 @@ void CHtmlParser::parse_newline()
     parse_whitespace();
 }
 
+/*
+ *   Character classification table for parse_text()'s fast path: nonzero
+ *   for the printable ASCII characters that never need any interpretation
+ *   in running text.  That excludes whitespace, control characters, the
+ *   markup and entity introducers '<' and '&', and everything outside of
+ *   the ASCII range (which might be part of a multi-byte character).  
+ */
+static unsigned char S_plain_text_chars[256];
+static int S_plain_text_chars_inited = FALSE;
+
+static int init_plain_text_chars()
+{
+    int i;
+
+    for (i = 0x21 ; i < 0x7F ; ++i)
+        S_plain_text_chars[i] = 1;
+    S_plain_text_chars[(unsigned char)'<'] = 0;
+    S_plain_text_chars[(unsigned char)'&'] = 0;
+    return TRUE;
+}
+
+static inline int is_plain_text_char(textchar_t c)
+{
+    return S_plain_text_chars[(unsigned char)c];
+}
+
 /*
  *   Parse text 
  */
@@ -2241,6 +2278,35 @@ void CHtmlParser::parse_text()
     if (curtext_.getlen() > 30000)
         add_text_tag();
 
+    /*
+     *   Fast path for plain prose: if we're looking at a run of printable
+     *   ASCII characters with no markup, entities, or whitespace, none of
+     *   them needs any interpretation, so add the whole run to the text
+     *   buffer in one go rather than going through parse_char() for each
+     *   character.  (Every ASCII character is a single-byte character in
+     *   the character sets we support, so we don't have to worry about
+     *   splitting multi-byte characters.)  We limit the run to keep the
+     *   buffer within the size limits we check above.  
+     */
+    if (is_plain_text_char(p_.curchar()))
+    {
+        const textchar_t *start = p_.gettext();
+        const textchar_t *p = start;
+        const textchar_t *end = start + (p_.getlen() < 4096
+                                         ? p_.getlen() : 4096);
+
+        /* find the end of the run */
+        for (++p ; p < end && is_plain_text_char(*p) ; ++p) ;
+
+        /* add the run to the text buffer and skip it in the source */
+        curtext_.append(start, p - start);
+        p_.inc(p - start);
+
+        /* the run doesn't end in whitespace */
+        eat_whitespace_ = FALSE;
+        return;
+    }
+
     /* get the current character */
     len = parse_char(buf, sizeof(buf), &charset, &changed_charset, &special);
 
@@ -2488,6 +2554,10 @@ void CHtmlParser::parse(const textchar_t *src, size_t len,
         len = new_src.getlen();
     }
 
+    /* set up the plain text character table if we haven't already */
+    if (!S_plain_text_chars_inited)
+        S_plain_text_chars_inited = init_plain_text_chars();
+
     /* start at the beginning of the buffer */
     p_.set(src, len);
     p_start_.set(src, len);
@@ -31,6 +31,13 @@ Modified
 #endif
 
 
+/*
+ *   Maximum table size for the parser's perfect-hashed name tables (see
+ *   CHtmlHashTable::make_perfect()) 
+ */
+#define HTML_PARSER_PERFECT_HASH_MAX  2048
+
+
 /* ------------------------------------------------------------------------ */
 /*
  *   HTML parser.  The client first writes HTML source code to a
@@ -553,6 +553,16 @@ void CHtmlSoundQueue::maybe_start_sound()
         if (repeat == nxt->get_repeat_count() && repeat != 0 && !more_in_loop)
             fade_out = nxt->get_fade_out() * 1000.0;
         
+        /* 
+         *   tell the sound how important our layer is - each queue behind
+         *   us puts us one level further in the foreground 
+         */
+        int pri = 0;
+        for (CHtmlSoundQueue *q = next_bg_queue_ ; q != 0 ;
+             q = q->next_bg_queue_)
+            ++pri;
+        snd->set_layer_priority(pri);
+
         /* start it playing */
         if (snd->play_sound(win_, sound_done_cb, this, repeat,
                             nxt->get_res()->get_url(),
@@ -292,7 +292,17 @@ public:
 class CHtmlSysFont
 {
 public:
-    virtual ~CHtmlSysFont() { }
+    CHtmlSysFont() { meas_cache_ = 0; }
+    virtual ~CHtmlSysFont();
+
+    /* 
+     *   copying a font copies its descriptor, but not its measurement
+     *   cache, which belongs to the original object 
+     */
+    CHtmlSysFont(const CHtmlSysFont &src)
+        { desc_.copy_from(&src.desc_); meas_cache_ = 0; }
+    CHtmlSysFont &operator=(const CHtmlSysFont &src)
+        { desc_.copy_from(&src.desc_); return *this; }
 
     /* get the metrics for the font */
     virtual void get_font_metrics(class CHtmlFontMetrics *) = 0;
@@ -353,12 +363,26 @@ public:
     HTML_color_t get_font_bgcolor() const { return desc_.bgcolor; }
     int use_font_bgcolor() const { return !desc_.default_bgcolor; }
 
+    /*
+     *   Get the text measurement cache for the font, creating it if we
+     *   haven't already.  The portable display code uses this to remember
+     *   the sizes of text runs it has measured in this font, so that
+     *   laying out the same text again (when reformatting the window at a
+     *   new width, for example) doesn't have to ask the system to measure
+     *   it again.  The cache belongs to the font, so it goes away when the
+     *   font is deleted.  
+     */
+    class CHtmlTextMeasureCache *get_meas_cache();
+
 protected:
     /* 
      *   the font descriptor - the system must set this to the font
      *   descriptor when the font is created 
      */
     CHtmlFontDesc desc_;
+
+    /* text measurement cache, created on demand */
+    class CHtmlTextMeasureCache *meas_cache_;
 };
 
 
@@ -918,6 +942,26 @@ public:
                                  unsigned long *seek_pos,
                                  unsigned long *siz) = 0;
 
+    /*
+     *   Prefetch a resource.  The parser calls this when it finishes
+     *   parsing a tag that refers to an image or a sound, before the
+     *   formatter gets to the tag and asks the resource cache to load it.
+     *   'fname', 'seekpos' and 'siz' give the location of the resource
+     *   data, exactly as they will later be passed to the resource loader
+     *   function.  The system code can use this to start reading and
+     *   decoding the resource in the background, so that the loader finds
+     *   the work done (or under way) when it's called.
+     *   
+     *   This is purely a hint.  The loader function must still work if the
+     *   prefetch was ignored, and the formatter might never ask for the
+     *   resource at all (if graphics or sounds are turned off, for
+     *   example).  The default implementation does nothing.  
+     */
+    virtual void prefetch_resource(HTML_res_type_t /*res_type*/,
+                                   const textchar_t * /*fname*/,
+                                   unsigned long /*seekpos*/,
+                                   unsigned long /*siz*/) { }
+
 private:
     /*
      *   The system frame is a singleton object, defined and managed by the
@@ -1374,6 +1418,18 @@ public:
     virtual class CHtmlSysFont
         *get_bullet_font(class CHtmlSysFont *current_font) = 0;
 
+    /*
+     *   Get the font generation.  This is a number that changes whenever
+     *   anything changes that could make get_font() return a font with
+     *   different metrics for a descriptor it has seen before (a change to
+     *   the font preferences, for example).  The formatter uses it to tell
+     *   whether measurements it made earlier, such as a table's column
+     *   widths, still hold.  Zero means the system doesn't keep track, in
+     *   which case the formatter measures everything afresh on each
+     *   reformat; this is the default.  
+     */
+    virtual unsigned long get_font_generation() { return 0; }
+
     /* -------------------------------------------------------------------- */
     /*
      *   Timers
@@ -2462,6 +2518,17 @@ public:
      *   maybe_suspend(), this should continue playing where we left off. 
      */
     virtual void resume() = 0;
+
+    /*
+     *   Set the layer priority for the next play_sound() call.  The sound
+     *   queue calls this just before starting the sound, giving the number
+     *   of layers behind the sound's layer: 0 for the background layer, 1
+     *   for background ambient, 2 for ambient, and 3 for the foreground.
+     *   A system that can only mix a limited number of sounds at once can
+     *   use this to decide which sound to stop when it runs out of voices.
+     *   The default implementation ignores the priority.  
+     */
+    virtual void set_layer_priority(int /*pri*/) { }
 };
 
 /*
@@ -49,6 +49,9 @@ Modified
 #ifndef HTMLRC_H
 #include "htmlrc.h"
 #endif
+#ifndef HTMLRF_H
+#include "htmlrf.h"
+#endif
 
 
 /* ------------------------------------------------------------------------ */
@@ -60,6 +63,138 @@ CHtmlTag::~CHtmlTag()
 {
 }
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Tag memory pool.  Blocks are grouped into size classes in multiples of
+ *   HTML_TAG_POOL_UNIT bytes; each class has a free list, and we carve new
+ *   blocks out of pool pages as needed.  Tags larger than the biggest size
+ *   class come from the system heap.  
+ */
+
+/* size class granularity, number of size classes, and pool page size */
+#define HTML_TAG_POOL_UNIT      16
+#define HTML_TAG_POOL_CLASSES   16
+#define HTML_TAG_POOL_PAGESIZE  (16*1024)
+
+/* a pool page - the blocks follow the header */
+struct html_tag_pool_page
+{
+    html_tag_pool_page *nxt;
+};
+
+/* a free block */
+struct html_tag_pool_free
+{
+    html_tag_pool_free *nxt;
+};
+
+/* list of pool pages */
+static html_tag_pool_page *S_tag_pool_pages = 0;
+
+/* free list for each size class */
+static html_tag_pool_free *S_tag_pool_free[HTML_TAG_POOL_CLASSES];
+
+/* next free byte in the current page, and the end of the page */
+static char *S_tag_pool_cur = 0;
+static char *S_tag_pool_end = 0;
+
+/* number of pool blocks currently in use */
+static unsigned long S_tag_pool_live = 0;
+
+/*
+ *   get the size class index for an allocation size 
+ */
+static size_t tag_pool_class(size_t siz)
+{
+    return (siz + HTML_TAG_POOL_UNIT - 1) / HTML_TAG_POOL_UNIT - 1;
+}
+
+void *CHtmlTag::operator new(size_t siz)
+{
+    size_t cls;
+    size_t blksiz;
+    void *ret;
+
+    /* use the system heap for anything too big for our size classes */
+    cls = tag_pool_class(siz);
+    if (siz == 0 || cls >= HTML_TAG_POOL_CLASSES)
+        return ::operator new(siz);
+
+    /* take a block from the free list for the size class, if possible */
+    if (S_tag_pool_free[cls] != 0)
+    {
+        ret = S_tag_pool_free[cls];
+        S_tag_pool_free[cls] = S_tag_pool_free[cls]->nxt;
+        ++S_tag_pool_live;
+        return ret;
+    }
+
+    /* if the current page doesn't have room, start a new one */
+    blksiz = (cls + 1) * HTML_TAG_POOL_UNIT;
+    if (S_tag_pool_cur == 0 || S_tag_pool_end - S_tag_pool_cur < (long)blksiz)
+    {
+        html_tag_pool_page *pg;
+
+        /* 
+         *   allocate the page; the header is padded to a full unit so
+         *   that the blocks are suitably aligned 
+         */
+        pg = (html_tag_pool_page *)::operator new(HTML_TAG_POOL_PAGESIZE);
+        pg->nxt = S_tag_pool_pages;
+        S_tag_pool_pages = pg;
+        S_tag_pool_cur = (char *)pg + HTML_TAG_POOL_UNIT;
+        S_tag_pool_end = (char *)pg + HTML_TAG_POOL_PAGESIZE;
+    }
+
+    /* carve the block out of the current page */
+    ret = S_tag_pool_cur;
+    S_tag_pool_cur += blksiz;
+    ++S_tag_pool_live;
+    return ret;
+}
+
+void CHtmlTag::operator delete(void *ptr, size_t siz)
+{
+    size_t cls;
+    html_tag_pool_free *blk;
+
+    /* ignore null pointers */
+    if (ptr == 0)
+        return;
+
+    /* if it came from the system heap, return it there */
+    cls = tag_pool_class(siz);
+    if (siz == 0 || cls >= HTML_TAG_POOL_CLASSES)
+    {
+        ::operator delete(ptr);
+        return;
+    }
+
+    /* put it on the free list for its size class */
+    blk = (html_tag_pool_free *)ptr;
+    blk->nxt = S_tag_pool_free[cls];
+    S_tag_pool_free[cls] = blk;
+
+    /* 
+     *   if that was the last tag in use, release all of the pool pages -
+     *   this happens when a parser is deleted along with its tree 
+     */
+    if (--S_tag_pool_live == 0)
+    {
+        size_t i;
+
+        while (S_tag_pool_pages != 0)
+        {
+            html_tag_pool_page *nxt = S_tag_pool_pages->nxt;
+            ::operator delete(S_tag_pool_pages);
+            S_tag_pool_pages = nxt;
+        }
+        for (i = 0 ; i < HTML_TAG_POOL_CLASSES ; ++i)
+            S_tag_pool_free[i] = 0;
+        S_tag_pool_cur = S_tag_pool_end = 0;
+    }
+}
+
 /*
  *   check if my name matches a given name 
  */
@@ -612,6 +747,59 @@ void CHtmlTag::format_clear(CHtmlFormatter *formatter,
         formatter->add_disp_item_new_line(new (formatter) CHtmlDispBreak(0));
 }
 
+/*
+ *   Prefetch a resource 
+ */
+void CHtmlTag::prefetch_resource(const CHtmlUrl *url)
+{
+    htmlres_loader_func_t loader_func;
+    HTML_res_type_t res_type;
+    CStringBuf fname;
+    unsigned long seekpos;
+    unsigned long filesize;
+
+    /* 
+     *   if there's no URL, no system frame to ask, or no resource finder
+     *   to locate the data, there's nothing to do 
+     */
+    if (url->get_url() == 0 || url->get_url()[0] == 0
+        || CHtmlSysFrame::get_frame_obj() == 0
+        || CHtmlFormatter::get_res_finder() == 0)
+        return;
+
+    /* if the resource is already in the cache, there's nothing to load */
+    if (CHtmlFormatter::get_res_cache() != 0
+        && CHtmlFormatter::get_res_cache()->find(url) != 0)
+        return;
+
+    /* 
+     *   only still images and sounds are worth decoding ahead of time; the
+     *   system code decides which of those it can actually handle 
+     */
+    res_type = CHtmlResType::get_res_mapping(url->get_url(), &loader_func);
+    switch (res_type)
+    {
+    case HTML_res_type_JPEG:
+    case HTML_res_type_PNG:
+    case HTML_res_type_WAV:
+    case HTML_res_type_MP123:
+    case HTML_res_type_OGG:
+        break;
+
+    default:
+        return;
+    }
+
+    /* find the resource data, and pass it to the system code */
+    seekpos = filesize = 0;
+    CHtmlFormatter::get_res_finder()->get_file_info(
+        &fname, url->get_url(), get_strlen(url->get_url()),
+        &seekpos, &filesize);
+    if (fname.get() != 0 && fname.get()[0] != 0 && filesize != 0)
+        CHtmlSysFrame::get_frame_obj()->prefetch_resource(
+            res_type, fname.get(), seekpos, filesize);
+}
+
 /*
  *   Find the end of a token in a delimited attribute list.  This simply
  *   scans a string until we find the next occurrence of a delimiter
@@ -4037,6 +4225,22 @@ HTML_attrerr CHtmlTagIMG::set_attribute(CHtmlParser *parser,
     return HTML_attrerr_ok;
 }
 
+/*
+ *   Finish parsing.  The tag won't be formatted until the parser is done
+ *   with the current batch of text, so this is a good time to let the
+ *   system code start loading our images in the background.  
+ */
+void CHtmlTagIMG::on_parse(CHtmlParser *parser)
+{
+    /* inherit the default handling */
+    CHtmlTag::on_parse(parser);
+
+    /* prefetch the main image, and the hover/active images if any */
+    prefetch_resource(&src_);
+    prefetch_resource(&hsrc_);
+    prefetch_resource(&asrc_);
+}
+
 /*
  *   format the image 
  */
@@ -5272,6 +5476,7 @@ CHtmlTagTABLE::CHtmlTagTABLE(CHtmlParser *)
 
     /* widths are not yet known */
     min_width_ = max_width_ = 0;
+    metrics_gen_ = 0;
 
     /* no display item yet */
     disp_ = 0;
@@ -7752,6 +7957,20 @@ CHtmlTagSOUND::~CHtmlTagSOUND()
         sound_->remove_ref();
 }
 
+/*
+ *   On parsing, start loading the sound, so that it's ready to play when
+ *   the formatter gets to us 
+ */
+void CHtmlTagSOUND::on_parse(CHtmlParser *parser)
+{
+    /* inherit the default handling */
+    CHtmlTag::on_parse(parser);
+
+    /* a CANCEL tag doesn't play anything */
+    if (!cancel_)
+        prefetch_resource(&src_);
+}
+
 HTML_attrerr CHtmlTagSOUND::set_attribute(CHtmlParser *parser,
                                           HTML_Attrib_id_t attr_id,
                                           const textchar_t *val,
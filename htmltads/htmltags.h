@@ -58,6 +58,17 @@ public:
     CHtmlTag() { nxt_ = 0; container_ = 0; }
     virtual ~CHtmlTag();
 
+    /*
+     *   Memory management.  The parser creates a tag for every run of
+     *   text and every bit of markup, and pruning deletes them again one
+     *   at a time, so we allocate tags out of pools of fixed-size blocks
+     *   rather than going to the system heap for each one.  Freed blocks
+     *   are kept on a free list for their size class; the pool pages
+     *   themselves are released when the last tag is deleted.  
+     */
+    static void *operator new(size_t siz);
+    static void operator delete(void *ptr, size_t siz);
+
     /* 
      *   Process the end-tag.  This is a static function invoked directly
      *   from the parser to begin processing the </xxx> closing tag.  Almost
@@ -262,6 +273,14 @@ protected:
     void format_clear(class CHtmlFormatter *formatter,
                       HTML_Attrib_id_t clear);
 
+    /*
+     *   Ask the system code to start loading a resource in the background.
+     *   Tags that refer to images or sounds call this from on_parse(), so
+     *   that the resource is loaded (or on its way) by the time the
+     *   formatter gets to the tag.  
+     */
+    static void prefetch_resource(const CHtmlUrl *url);
+
     /* service routine to parse a color attribute value */
     HTML_attrerr set_color_attr(class CHtmlParser *parser,
                                 HTML_color_t *color_var,
@@ -648,6 +667,10 @@ public:
     /* change the underlying UI buffer */
     void change_buf(CHtmlFormatterInput *fmt, const textchar_t *buf);
 
+    /* get the UI's buffer and the length of the text in it */
+    const textchar_t *get_input_buf() const { return buf_; }
+    size_t get_input_len() const { return len_; }
+
 private:
     /* the text pointer, when it's still in the UI's buffer */
     const textchar_t *buf_;
@@ -2425,6 +2448,9 @@ public:
                                HTML_Attrib_id_t attr_id,
                                const textchar_t *val, size_t vallen);
 
+    /* on parsing, ask the system code to prefetch our images */
+    void on_parse(class CHtmlParser *parser);
+
     /* format the image */
     void format(class CHtmlSysWin *win, class CHtmlFormatter *formatter);
 
@@ -2518,6 +2544,9 @@ public:
                                HTML_Attrib_id_t attr_id,
                                const textchar_t *val, size_t vallen);
 
+    /* on parsing, ask the system code to prefetch our sound */
+    void on_parse(class CHtmlParser *parser);
+
     /* format the sound */
     void format(class CHtmlSysWin *win, class CHtmlFormatter *formatter);
 
@@ -3243,6 +3272,16 @@ public:
     /* get my enclosing table */
     CHtmlTagTABLE *get_enclosing_table() const { return enclosing_table_; }
 
+    /*
+     *   Get/set the font generation (see CHtmlSysWin::get_font_generation)
+     *   at which our cell metrics were last measured, or zero if they
+     *   haven't been measured from our complete contents.  The formatter
+     *   sets this after measuring an outermost table; the nested tables'
+     *   metrics are measured along with it.  
+     */
+    unsigned long get_metrics_gen() const { return metrics_gen_; }
+    void set_metrics_gen(unsigned long gen) { metrics_gen_ = gen; }
+
 private:
     /* my display item */
     class CHtmlDispTable *disp_;
@@ -3322,6 +3361,9 @@ private:
      */
     long min_width_;
     long max_width_;
+
+    /* font generation of our measurements, if they're complete */
+    unsigned long metrics_gen_;
 };
 
 class CHtmlTagCAPTION: public CHtmlTagContainer
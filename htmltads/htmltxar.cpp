@@ -53,7 +53,7 @@ CHtmlTextArray::~CHtmlTextArray()
     {
         /* free this page if it was allocated */
         if (p->text_ != 0)
-            th_free(p->text_);
+            free_page(p);
     }
 
     /* delete the page array itself */
@@ -75,11 +75,8 @@ void CHtmlTextArray::clear()
         /* free this page if it was allocated */
         if (p->text_ != 0)
         {
-            /* free the page */
-            th_free(p->text_);
-
-            /* forget about it */
-            p->text_ = 0;
+            /* free the page, and forget about it */
+            free_page(p);
         }
     }
 
@@ -125,11 +122,8 @@ void CHtmlTextArray::delete_text(unsigned long addr, size_t len)
         /* deduct anything remaining on this page from the memory in use */
         mem_in_use_ -= pages_[pg].space_in_use_;
 
-        /* delete the page's memory */
-        th_free(pages_[pg].text_);
-
-        /* forget the pointer, since it's gone now */
-        pages_[pg].text_ = 0;
+        /* delete the page's memory, and forget the pointers */
+        free_page(&pages_[pg]);
 
         /* that's one less page in use */
         --pages_in_use_;
@@ -141,14 +135,109 @@ void CHtmlTextArray::delete_text(unsigned long addr, size_t len)
  */
 void CHtmlTextArray::alloc_first_page()
 {
-    pages_[0].text_ = (textchar_t *)th_malloc(HTML_TEXTARRAY_PAGESIZE);
-    pages_[0].used_ = 0;
-    pages_[0].refs_ = 0;
-    pages_[0].space_in_use_ = 0;
-    pages_[0].alloced_ = 0;
+    init_page(&pages_[0]);
     pages_alloced_ = 1;
     pages_in_use_ = 1;
-    assert(pages_[0].text_ != 0);
+}
+
+/*
+ *   initialize a new page entry 
+ */
+void CHtmlTextArray::init_page(CHtmlTextArrayEntry *p)
+{
+    p->text_ = (textchar_t *)th_malloc(HTML_TEXTARRAY_PAGESIZE);
+    p->sig_ = (unsigned char *)th_malloc(HTML_TEXTARRAY_SIG_BITS / 8);
+    p->used_ = 0;
+    p->refs_ = 0;
+    p->space_in_use_ = 0;
+    p->alloced_ = 0;
+    assert(p->text_ != 0 && p->sig_ != 0);
+
+    /* nothing is stored on the page yet */
+    memset(p->sig_, 0, HTML_TEXTARRAY_SIG_BITS / 8);
+}
+
+/*
+ *   free a page's memory 
+ */
+void CHtmlTextArray::free_page(CHtmlTextArrayEntry *p)
+{
+    th_free(p->text_);
+    th_free(p->sig_);
+    p->text_ = 0;
+    p->sig_ = 0;
+}
+
+/*
+ *   Get the signature bucket for a trigram.  We fold ASCII letters to
+ *   lower case, and lump all non-ASCII bytes together.  This makes the
+ *   signature coarser than any case-insensitive comparison search() might
+ *   apply, so a page that can hold a match always has the bits set for all
+ *   of the match's trigrams.  
+ */
+size_t CHtmlTextArray::sig_bucket(textchar_t a, textchar_t b, textchar_t c)
+{
+    unsigned int ca = (unsigned char)a;
+    unsigned int cb = (unsigned char)b;
+    unsigned int cc = (unsigned char)c;
+    unsigned long h;
+
+    /* fold each character */
+    ca = (ca >= 0x80 ? 0x80 : ca >= 'A' && ca <= 'Z' ? ca + 32 : ca);
+    cb = (cb >= 0x80 ? 0x80 : cb >= 'A' && cb <= 'Z' ? cb + 32 : cb);
+    cc = (cc >= 0x80 ? 0x80 : cc >= 'A' && cc <= 'Z' ? cc + 32 : cc);
+
+    /* mix the three characters into a bucket number */
+    h = (((unsigned long)ca << 16) | (cb << 8) | cc) * 2654435761UL;
+    return (size_t)((h & 0xFFFFFFFFUL) >> 19) % HTML_TEXTARRAY_SIG_BITS;
+}
+
+/*
+ *   Add newly committed text to a page's signature.  The text is
+ *   contiguous with whatever precedes it on the page, so we include the
+ *   trigrams that straddle the boundary with the previous text as well.  
+ */
+void CHtmlTextArray::add_to_sig(size_t pg, size_t ofs, size_t len)
+{
+    CHtmlTextArrayEntry *p = &pages_[pg];
+    const textchar_t *t;
+    size_t i, end;
+
+    /* back up to include trigrams that start in the preceding text */
+    i = (ofs >= 2 ? ofs - 2 : 0);
+    end = ofs + len;
+
+    /* add each trigram that ends within the new text */
+    for (t = p->text_ ; i + 3 <= end ; ++i)
+    {
+        size_t b = sig_bucket(t[i], t[i+1], t[i+2]);
+        p->sig_[b >> 3] |= (unsigned char)(1 << (b & 7));
+    }
+}
+
+/*
+ *   Determine if a page might contain a string 
+ */
+int CHtmlTextArray::page_may_contain(size_t pg, const textchar_t *txt,
+                                     size_t txtlen) const
+{
+    const CHtmlTextArrayEntry *p = &pages_[pg];
+    size_t i;
+
+    /* without a full trigram, or without a signature, we can't tell */
+    if (txtlen < 3 || p->sig_ == 0)
+        return TRUE;
+
+    /* if any of the string's trigrams is missing, it can't be here */
+    for (i = 0 ; i + 3 <= txtlen ; ++i)
+    {
+        size_t b = sig_bucket(txt[i], txt[i+1], txt[i+2]);
+        if ((p->sig_[b >> 3] & (1 << (b & 7))) == 0)
+            return FALSE;
+    }
+
+    /* all of the trigrams are present, so there might be a match */
+    return TRUE;
 }
 
 
@@ -220,6 +309,9 @@ unsigned long CHtmlTextArray::store_text(const textchar_t *txt, size_t len)
     /* count this space in the total memory we're using */
     mem_in_use_ += len;
 
+    /* add the text to the page's trigram signature */
+    add_to_sig(pg, get_page_ofs(addr), len);
+
     /*
      *   commit the storage by moving the page's free space pointer past
      *   the text 
@@ -257,12 +349,7 @@ unsigned long CHtmlTextArray::reserve_space(size_t len)
         }
 
         /* allocate a new page */
-        pages_[pages_alloced_].text_ = (textchar_t *)
-                                       th_malloc(HTML_TEXTARRAY_PAGESIZE);
-        pages_[pages_alloced_].used_ = 0;
-        pages_[pages_alloced_].refs_ = 0;
-        pages_[pages_alloced_].alloced_ = 0;
-        pages_[pages_alloced_].space_in_use_ = 0;
+        init_page(&pages_[pages_alloced_]);
         ++pages_alloced_;
         ++pages_in_use_;
     }
@@ -523,6 +610,12 @@ int CHtmlTextArray::search(const textchar_t *txt, size_t txtlen,
     size_t cur_ofs;
     size_t start_pg;
     size_t start_ofs;
+    size_t sig_pg;
+    int sig_ok;
+
+    /* we haven't checked any page's signature yet */
+    sig_pg = (size_t)-1;
+    sig_ok = TRUE;
 
     /* 
      *   Get the system default character set.  For character classification
@@ -623,6 +716,53 @@ int CHtmlTextArray::search(const textchar_t *txt, size_t txtlen,
                 return FALSE;
         }
 
+        /* check the signature of each new page we visit */
+        if (cur_pg != sig_pg)
+        {
+            sig_pg = cur_pg;
+            sig_ok = page_may_contain(cur_pg, txt, txtlen);
+        }
+
+        /*
+         *   If the page's signature rules out a match lying entirely within
+         *   the page, there's no need to try any position from which the
+         *   whole string would fit on the page.  Only the last few
+         *   positions, where a match could run onto the next page, need a
+         *   real comparison.  
+         */
+        if (!sig_ok && cur_rem >= txtlen)
+        {
+            if (dir == 1)
+            {
+                size_t new_ofs = pages_[cur_pg].used_ - txtlen + 1;
+
+                /* if we're skipping past the starting point, we're done */
+                if (cur_pg == start_pg
+                    && start_ofs > cur_ofs && start_ofs <= new_ofs)
+                    return FALSE;
+
+                /* skip ahead */
+                cur_p += new_ofs - cur_ofs;
+                cur_rem -= new_ofs - cur_ofs;
+                cur_ofs = new_ofs;
+            }
+            else
+            {
+                /* if we're skipping past the starting point, we're done */
+                if (cur_pg == start_pg && start_ofs < cur_ofs)
+                    return FALSE;
+
+                /* 
+                 *   skip back to the start of the page; the next pass will
+                 *   move on to the previous page 
+                 */
+                cur_p -= cur_ofs;
+                cur_rem += cur_ofs;
+                cur_ofs = 0;
+                continue;
+            }
+        }
+
         /* set up with the current array page */
         arr_p = cur_p;
         arr_rem = cur_rem;
@@ -54,11 +54,23 @@ Modified
 
 const size_t HTML_TEXTARRAY_PAGESIZE = 32*1024;
 
+/*
+ *   Size in bits of each page's trigram signature.  The signature is a
+ *   bit set with one bit per hash bucket; we set the bucket's bit for each
+ *   three-character sequence stored on the page.  search() uses this to
+ *   skip pages that can't contain the target string without scanning
+ *   them.  A typical page of text has a few thousand distinct trigrams,
+ *   so this keeps the false positive rate low for all but one- and
+ *   two-trigram search strings.  
+ */
+const size_t HTML_TEXTARRAY_SIG_BITS = 8192;
+
 /* page entry */
 class CHtmlTextArrayEntry
 {
 public:
     textchar_t *text_;                                  /* text of the page */
+    unsigned char *sig_;                 /* trigram signature of the page */
     size_t used_;                      /* amount of space used on this page */
     size_t alloced_;                /* amount of space reserved on the page */
     size_t refs_;                      /* number of references to this page */
@@ -219,6 +231,10 @@ public:
      *   the buffer and continue the search from there; we'll only fail if
      *   we get back to the starting point and still haven't found the
      *   string.  
+     *   
+     *   Pages whose trigram signature shows that they can't contain the
+     *   string are skipped without being scanned, so searching a long
+     *   transcript mostly costs a few bit tests per page.  
      */
     int search(const textchar_t *txt, size_t txtlen, int exact_case,
                int whole_word, int wrap, int dir, unsigned long startofs,
@@ -227,6 +243,33 @@ public:
 private:
     /* allocate the first page */
     void alloc_first_page();
+
+    /* initialize a newly allocated page entry */
+    void init_page(CHtmlTextArrayEntry *p);
+
+    /* free a page's memory */
+    static void free_page(CHtmlTextArrayEntry *p);
+
+    /* 
+     *   add the trigrams of newly committed text, at the given offset and
+     *   length on the given page, to the page's signature 
+     */
+    void add_to_sig(size_t pg, size_t ofs, size_t len);
+
+    /* 
+     *   determine if a page might contain the given string entirely within
+     *   its text, based on its trigram signature - returns false only if
+     *   the page definitely can't 
+     */
+    int page_may_contain(size_t pg, const textchar_t *txt,
+                         size_t txtlen) const;
+
+    /* 
+     *   get the signature bucket for a three-character sequence; the
+     *   characters are folded so that case-insensitive matches land in the
+     *   same bucket 
+     */
+    static size_t sig_bucket(textchar_t a, textchar_t b, textchar_t c);
     
     /* get the page containing an address */
     size_t get_page(unsigned long addr) const
@@ -105,7 +105,7 @@ DEFINES += \
     TROLLTECH_QT \
     _M_QT \
     T3_COMPILING_FOR_HTML \
-    VM_FLAT_POOL \
+    VM_LAZY_POOL \
     USE_HTML \
     TC_TARGET_T3
 
@@ -114,7 +114,53 @@ DEFINES += \
 #} else {
 #    DEFINES += VMGLOB_PARAM TADSHTML_DEBUG T3_DEBUG NEW_DELETE_NEED_THROW
 #}
-DEFINES += VMGLOB_VARS
+
+# Build the T3 VM with its globals passed around as a parameter rather than
+# as static variables.  This lets a host run several independent T3 VM
+# instances in one process, each on its own thread (each vm_run_image() call
+# creates and destroys its own set of globals).  It's slightly slower, and
+# the QTads user interface itself still runs one game at a time.  To enable,
+# run qmake with "CONFIG+=t3_vmglob_param".
+t3_vmglob_param {
+    DEFINES += VMGLOB_PARAM
+} else {
+    DEFINES += VMGLOB_VARS
+}
+
+# Use "threaded" (computed goto) opcode dispatch in the T3 interpreter loop.
+# This only has an effect with compilers that support the GNU "labels as
+# values" extension (GCC and Clang); other compilers always use the plain
+# switch statement.  To build with the plain switch anyway, run qmake with
+# "CONFIG+=no_t3_threaded_dispatch".
+!no_t3_threaded_dispatch:DEFINES += VMRUN_THREADED_DISPATCH
+
+# The same for the TADS 2 interpreter loop (runexe).  To build it with the
+# plain switch statement, run qmake with "CONFIG+=no_t2_threaded_dispatch".
+!no_t2_threaded_dispatch:DEFINES += RUN_THREADED_DISPATCH
+
+# Build in the T3 sampling profiler (Unix only).  When enabled, setting the
+# T3_SAMPLE_PROFILE environment variable to a file name makes the T3 VM
+# write a collapsed-stack profile of the game to that file on exit.  To
+# enable, run qmake with "CONFIG+=t3_sampler".
+unix:t3_sampler:DEFINES += VM_SAMPLER
+
+# Detect T3 VM stack overflows with a protected guard region after the stack
+# (Unix only), instead of checking for space on every function call.  To
+# enable, run qmake with "CONFIG+=t3_stack_guard".
+unix:t3_stack_guard:DEFINES += VM_STACK_GUARD
+
+# Build in the T3 allocation tracer.  When enabled, setting the T3_ALLOC_TRACE
+# environment variable to a file name makes the T3 VM write a report of the
+# byte code locations that allocate the most objects and memory to that file
+# on exit.  T3_ALLOC_TRACE_RATE=N samples only every Nth allocation.  To
+# enable, run qmake with "CONFIG+=t3_alloc_trace".
+t3_alloc_trace:DEFINES += VM_ALLOC_TRACE
+
+# Build in the TADS 2 call profiler (Unix only).  When enabled, setting the
+# T2_PROFILE environment variable to a file name makes the TADS 2 run-time
+# write per-function and per-method call counts and timings to that file
+# when the game ends.  To enable, run qmake with "CONFIG+=t2_profiler".
+unix:t2_profiler:DEFINES += RUN_PROFILER
 
 macx|win32 {
     DEFINES += OS_NO_TYPES_DEFINED
@@ -188,7 +234,13 @@ HEADERS += \
     src/dispwidget.h \
     src/dispwidgetinput.h \
     src/qtadshostifc.h \
+    src/imageshare.h \
+    src/qtadsresdata.h \
     src/qtadstimer.h \
+    src/startupprofiler.h \
+    src/perfstats.h \
+    src/scrollbackjournal.h \
+    src/historydialog.h \
     src/confdialog.h \
     src/settings.h \
     src/gameinfodialog.h \
@@ -208,10 +260,17 @@ SOURCES += \
     src/syswinaboutbox.cc \
     src/syswininput.cc \
     src/sysimage.cc \
+    src/sysimagemng.cc \
     src/syssound.cc \
     src/missing.cc \
     src/qtadsimage.cc \
     src/qtadssound.cc \
+    src/qtadsresdata.cc \
+    src/startupprofiler.cc \
+    src/perfstats.cc \
+    src/scrollbackjournal.cc \
+    src/historydialog.cc \
+    src/imageshare.cc \
     src/main.cc \
     src/dispwidget.cc \
     src/dispwidgetinput.cc \
@@ -256,11 +315,21 @@ SOURCES += \
     $$HTDIR/oshtml.cpp \
     $$HTDIR/htmlsnd.cpp
 
+# Tads2 memory manager.  By default we use the flat version, which gives
+# each object its own heap block and never swaps, instead of the original
+# paged cache with compaction and a swap file.  To build with the original
+# cache manager, run qmake with "CONFIG+=t2_paged_mcm".
+t2_paged_mcm {
+    SOURCES += $$T2DIR/mcm.c
+} else {
+    DEFINES += MCM_FLAT
+    SOURCES += $$T2DIR/mcmflat.c
+}
+
 # Tads2 sources.
 SOURCES += \
     $$T2DIR/argize.c \
     $$T2DIR/ler.c \
-    $$T2DIR/mcm.c \
     $$T2DIR/mcs.c \
     $$T2DIR/mch.c \
     $$T2DIR/obj.c \
@@ -278,6 +347,7 @@ SOURCES += \
     $$T2DIR/dat.c \
     $$T2DIR/lst.c \
     $$T2DIR/run.c \
+    $$T2DIR/runprf.c \
     $$T2DIR/out.c \
     $$T2DIR/voc.c \
     $$T2DIR/bif.c \
@@ -327,6 +397,7 @@ SOURCES += \
     $$T3DIR/tct3unas.cpp \
     $$T3DIR/tctok.cpp \
     $$T3DIR/utf8.cpp \
+    $$T3DIR/vmalloctr.cpp \
     $$T3DIR/vmanonfn.cpp \
     $$T3DIR/vmbif.cpp \
     $$T3DIR/vmbifl.cpp \
@@ -370,6 +441,7 @@ SOURCES += \
     $$T3DIR/vmlog.cpp \
     $$T3DIR/vmlookup.cpp \
     $$T3DIR/vmlst.cpp \
+    $$T3DIR/vmlz.cpp \
     $$T3DIR/vmmain.cpp \
     $$T3DIR/vmmcreg.cpp \
     $$T3DIR/vmmeta.cpp \
@@ -380,10 +452,14 @@ SOURCES += \
     $$T3DIR/vmpat.cpp \
     $$T3DIR/vmpool.cpp \
     $$T3DIR/vmpoolfl.cpp \
+    $$T3DIR/vmpoollz.cpp \
     $$T3DIR/vmregex.cpp \
+    $$T3DIR/vmreplay.cpp \
+    $$T3DIR/vmredfa.cpp \
     $$T3DIR/vmrun.cpp \
     $$T3DIR/vmrunsym.cpp \
     $$T3DIR/vmsa.cpp \
+    $$T3DIR/vmsample.cpp \
     $$T3DIR/vmsave.cpp \
     $$T3DIR/vmsort.cpp \
     $$T3DIR/vmsortv.cpp \
@@ -394,6 +470,7 @@ SOURCES += \
     $$T3DIR/vmstrcmp.cpp \
     $$T3DIR/vmtmpfil.cpp \
     $$T3DIR/vmtobj.cpp \
+    $$T3DIR/vmtrace.cpp \
     $$T3DIR/vmtype.cpp \
     $$T3DIR/vmtypedh.cpp \
     $$T3DIR/vmtz.cpp \
@@ -2,6 +2,7 @@
 #include "ui_aboutqtadsdialog.h"
 
 #include "globals.h"
+#include "qtadsimage.h"
 #include "trd.h"
 #include "vmvsn.h"
 #include "htmlver.h"
@@ -37,6 +38,11 @@ AboutQtadsDialog::AboutQtadsDialog(QWidget *parent)
            + tr("Qt build version:") + QString::fromLatin1("</td><td>") + QString::fromLatin1(QT_VERSION_STR)
            + QString::fromLatin1("</td></tr><tr><td>")
            + tr("Qt runtime version:") + QString::fromLatin1("</td><td>") + QString::fromLatin1(qVersion())
+           + QString::fromLatin1("<br></td></tr><tr><td>")
+           + tr("Image memory:") + QString::fromLatin1("</td><td>")
+           + tr("%1 KB in %2 images (%3 dropped, %4 reloaded)")
+                 .arg(QTadsImage::bytesUsed() / 1024).arg(QTadsImage::imageCount())
+                 .arg(QTadsImage::evictionCount()).arg(QTadsImage::reloadCount())
            + QString::fromLatin1("</td></tr></table>");
     ui->versionInfoLabel->setText(str);
 }
@@ -16,11 +16,15 @@
  */
 
 #include <QDebug>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QTimer>
 #include <QPaintEvent>
 #include <QStatusBar>
 #include <QDrag>
 #include <QMimeData>
 #include <QClipboard>
+#include <QPointer>
 
 #include "htmlattr.h"
 #include "htmlfmt.h"
@@ -29,16 +33,129 @@
 #include "dispwidget.h"
 #include "settings.h"
 #include "syswininput.h"
+#include "perfstats.h"
+#include "vmtrace.h"
 
 
 DisplayWidget* DisplayWidget::curSelWidget = 0;
 
+// Selections with more characters than this aren't copied out of the display
+// list when they're put on the clipboard or dragged, but only when someone
+// asks for the text.
+static const unsigned long kLazySelectionChars = 64 * 1024;
+
+// Size of the pieces we extract the text in.
+static const size_t kExtractChunk = 64 * 1024;
+
+
+static void
+appendUtf8Chunk( void* ctx, const textchar_t* txt, size_t len )
+{
+    static_cast<QString*>(ctx)->append(QString::fromUtf8(txt, static_cast<int>(len)));
+}
+
+
+// Extracts the text in a range of the formatter's display list.  The text is
+// converted a piece at a time into a string that's reserved at full size up
+// front, so there's never more than one full copy of it.
+static QString
+extractText( const CHtmlFormatter* formatter, unsigned long startOfs, unsigned long endOfs )
+{
+    QString txt;
+    // The UTF-8 length is at least the number of UTF-16 units.
+    txt.reserve(static_cast<int>(formatter->get_chars_in_ofs_range(startOfs, endOfs)));
+    CStringBuf buf(kExtractChunk + 1024);
+    formatter->extract_text(&buf, startOfs, endOfs, kExtractChunk, appendUtf8Chunk, &txt);
+    return txt;
+}
+
+
+// Clipboard and drag data for a large selection.  The text is extracted when
+// it's asked for, which normally means when it's pasted or dropped.  The
+// offsets are only good as long as the display list stays the same, so
+// materializeAll() extracts the text of every such object that's still
+// around before the display list changes.
+class QTadsSelectionMimeData: public QMimeData {
+  private:
+    mutable const CHtmlFormatter* fFormatter;
+    unsigned long fStart;
+    unsigned long fEnd;
+    mutable QString fText;
+
+    // All instances that haven't extracted their text yet.  The clipboard
+    // and drag objects own them, so they can go away at any time.
+    static QList<QPointer<QMimeData> > fPending;
+
+    void
+    fMaterialize() const
+    {
+        if (this->fFormatter == 0) {
+            return;
+        }
+        this->fText = extractText(this->fFormatter, this->fStart, this->fEnd);
+        this->fFormatter = 0;
+    }
+
+  protected:
+    QVariant
+    retrieveData( const QString& mimeType, QVariant::Type type ) const override
+    {
+        if (mimeType != QLatin1String("text/plain")) {
+            return QMimeData::retrieveData(mimeType, type);
+        }
+        fMaterialize();
+        return this->fText;
+    }
+
+  public:
+    QTadsSelectionMimeData( const CHtmlFormatter* formatter, unsigned long start, unsigned long end )
+        : fFormatter(formatter),
+          fStart(start),
+          fEnd(end)
+    {
+        // Drop the entries of objects the clipboard has already replaced.
+        fPending.removeAll(QPointer<QMimeData>());
+        fPending.append(this);
+    }
+
+    bool
+    hasFormat( const QString& mimeType ) const override
+    {
+        return mimeType == QLatin1String("text/plain") or QMimeData::hasFormat(mimeType);
+    }
+
+    QStringList
+    formats() const override
+    {
+        QStringList list(QMimeData::formats());
+        if (not list.contains(QLatin1String("text/plain"))) {
+            list.prepend(QLatin1String("text/plain"));
+        }
+        return list;
+    }
+
+    static void
+    materializeAll()
+    {
+        for (int i = 0; i < fPending.size(); ++i) {
+            const QTadsSelectionMimeData* mime = static_cast<QTadsSelectionMimeData*>(fPending.at(i).data());
+            if (mime != 0) {
+                mime->fMaterialize();
+            }
+        }
+        fPending.clear();
+    }
+};
+
+QList<QPointer<QMimeData> > QTadsSelectionMimeData::fPending;
+
 
 DisplayWidget::DisplayWidget( CHtmlSysWinQt* parent, CHtmlFormatter* formatter )
     : QWidget(parent),
       fHoverLink(0),
       fClickedLink(0),
       fHasSelection(false),
+      fMovePending(false),
       inSelectMode(false),
       parentSysWin(parent),
       formatter(formatter)
@@ -49,6 +166,18 @@ DisplayWidget::DisplayWidget( CHtmlSysWinQt* parent, CHtmlFormatter* formatter )
     // Enable mouse tracking, since we need to change the mouse cursor shape
     // when hovering over hyperlinks.
     this->setMouseTracking(true);
+
+    // There's no point in tracking links more often than the screen can show
+    // the result.
+    int interval = 16;
+    const QScreen* screen = QGuiApplication::primaryScreen();
+    if (screen != 0 and screen->refreshRate() > 0) {
+        interval = qMax(1, static_cast<int>(1000.0 / screen->refreshRate()));
+    }
+    this->fMoveTimer = new QTimer(this);
+    this->fMoveTimer->setSingleShot(true);
+    this->fMoveTimer->setInterval(interval);
+    connect(this->fMoveTimer, SIGNAL(timeout()), this, SLOT(fHandlePendingMove()));
 }
 
 
@@ -60,12 +189,17 @@ DisplayWidget::~DisplayWidget()
         qWinGroup->enableCopyAction(false);
         DisplayWidget::curSelWidget = 0;
     }
+    // Clipboard data that still refers to our formatter needs its text now.
+    QTadsSelectionMimeData::materializeAll();
 }
 
 
 void
 DisplayWidget::fInvalidateLinkTracking()
 {
+    this->fTrackedRect = QRect();
+    this->fMovePending = false;
+    this->fMoveTimer->stop();
     // If we're tracking links (hover/click), forget about them.
     if (this->fClickedLink != 0) {
         this->fClickedLink->set_clicked(this->parentSysWin, CHtmlDispLink_none);
@@ -92,15 +226,47 @@ DisplayWidget::fMySelectedText()
         // There's nothing selected.
         return QString();
     }
+    return extractText(this->formatter, startOfs, endOfs);
+}
 
-    // Figure out how much space we need. This is a worst-case size.
-    unsigned long len = this->formatter->get_chars_in_ofs_range(startOfs, endOfs);
 
-    // Get the text in the internal format.
-    CStringBuf buf(len);
-    this->formatter->extract_text(&buf, startOfs, endOfs);
-    // Return only the useful part of the buffer (which is null-terminated).
-    return QString::fromUtf8(buf.get());
+bool
+DisplayWidget::fSelectionIsEmpty()
+{
+    unsigned long startOfs, endOfs;
+    this->formatter->get_sel_range(&startOfs, &endOfs);
+    if (startOfs == endOfs) {
+        return true;
+    }
+    // A large selection is sure to contain some text; don't extract it all
+    // just to find out.
+    if (this->formatter->get_chars_in_ofs_range(startOfs, endOfs) > kLazySelectionChars) {
+        return false;
+    }
+    return fMySelectedText().isEmpty();
+}
+
+
+QMimeData*
+DisplayWidget::fMySelectedMimeData()
+{
+    unsigned long startOfs, endOfs;
+    this->formatter->get_sel_range(&startOfs, &endOfs);
+    // Only the game window's text is deferred; the frame materializes it
+    // before it prunes or clears the page.  Banners can go away at any time,
+    // so their text is always extracted right here.
+    if (startOfs != endOfs and this->parentSysWin == qFrame->gameWindow()
+        and this->formatter->get_chars_in_ofs_range(startOfs, endOfs) > kLazySelectionChars)
+    {
+        return new QTadsSelectionMimeData(this->formatter, startOfs, endOfs);
+    }
+    const QString& txt = fMySelectedText();
+    if (txt.isEmpty()) {
+        return 0;
+    }
+    QMimeData* mime = new QMimeData;
+    mime->setText(txt);
+    return mime;
 }
 
 
@@ -142,11 +308,15 @@ DisplayWidget::fHandleDoubleOrTripleClick( QMouseEvent* e, bool tripleClick )
 void
 DisplayWidget::fSyncClipboard()
 {
-    const QString txt(fMySelectedText());
-    if (txt.isEmpty() or not QApplication::clipboard()->supportsSelection()) {
+    // This runs on every mouse move while selecting, so large selections
+    // only put a promise of their text on the clipboard.
+    if (not QApplication::clipboard()->supportsSelection()) {
         return;
     }
-    QApplication::clipboard()->setText(txt, QClipboard::Selection);
+    QMimeData* mime = fMySelectedMimeData();
+    if (mime != 0) {
+        QApplication::clipboard()->setMimeData(mime, QClipboard::Selection);
+    }
 }
 
 
@@ -156,9 +326,29 @@ DisplayWidget::paintEvent( QPaintEvent* e )
     //qDebug() << Q_FUNC_INFO << "called";
 
     //qDebug() << "repainting" << e->rect();
-    const QRect& qRect = e->region().boundingRect();
-    CHtmlRect cRect(qRect.left(), qRect.top(), qRect.left() + qRect.width(), qRect.top() + qRect.height());
-    this->formatter->draw(&cRect, false, 0);
+
+    QTadsPerfTimer perf(QTadsPerfStats::Paint);
+    CVmTraceSpan trace("ui", "paint");
+
+    // The update region often consists of a few small, far apart rectangles
+    // (new text at the bottom, a link changing its hover state further up.)
+    // Let the formatter draw only what touches them, rather than everything
+    // in their bounding rectangle.  Qt already clips painting to the region,
+    // so if it's made of very many rectangles, checking each item against
+    // all of them isn't worth it.
+    const QVector<QRect> qRects = e->region().rects();
+    if (qRects.size() <= 1 or qRects.size() > 16) {
+        const QRect& qRect = e->region().boundingRect();
+        CHtmlRect cRect(qRect.left(), qRect.top(), qRect.left() + qRect.width(), qRect.top() + qRect.height());
+        this->formatter->draw(&cRect, false, 0);
+        return;
+    }
+    CHtmlRect cRects[16];
+    for (int i = 0; i < qRects.size(); ++i) {
+        const QRect& r = qRects.at(i);
+        cRects[i].set(r.left(), r.top(), r.left() + r.width(), r.top() + r.height());
+    }
+    this->formatter->draw_areas(cRects, qRects.size());
 }
 
 
@@ -186,8 +376,11 @@ DisplayWidget::mouseMoveEvent( QMouseEvent* e )
                 > QApplication::startDragDistance())
         {
             QDrag* drag = new QDrag(this);
-            QMimeData* mime = new QMimeData;
-            mime->setText(this->fMySelectedText());
+            QMimeData* mime = this->fMySelectedMimeData();
+            if (mime == 0) {
+                mime = new QMimeData;
+                mime->setText(QString());
+            }
             drag->setMimeData(mime);
             drag->exec(Qt::CopyAction);
             this->fInvalidateLinkTracking();
@@ -195,8 +388,28 @@ DisplayWidget::mouseMoveEvent( QMouseEvent* e )
         }
     }
 
-    // This wasn't a selection event. Just update link tracking.
+    // This wasn't a selection event. Just update link tracking, unless we
+    // already did so since the last display refresh; in that case, we'll get
+    // to it when the timer runs out.
+    if (this->fMoveTimer->isActive()) {
+        this->fPendingMovePos = e->pos();
+        this->fMovePending = true;
+        return;
+    }
     this->updateLinkTracking(e->pos());
+    this->fMoveTimer->start();
+}
+
+
+void
+DisplayWidget::fHandlePendingMove()
+{
+    if (not this->fMovePending) {
+        return;
+    }
+    this->fMovePending = false;
+    this->updateLinkTracking(this->fPendingMovePos);
+    this->fMoveTimer->start();
 }
 
 
@@ -215,6 +428,13 @@ DisplayWidget::mousePressEvent( QMouseEvent* e )
         return;
     }
 
+    // Make sure we're tracking the link that's actually under the mouse, in
+    // case the last move is still pending.
+    if (this->fMovePending) {
+        this->fMovePending = false;
+        this->updateLinkTracking(e->pos());
+    }
+
     if (this->fHoverLink == 0) {
         // We're not hover-tracking a link. Start selection mode if we're not
         // already in that mode.
@@ -287,7 +507,7 @@ DisplayWidget::mouseReleaseEvent( QMouseEvent* e )
         // Releasing the button ends selection mode.
         this->inSelectMode = false;
         // If the selection is empty, there would be nothing to copy.
-        if (this->fMySelectedText().isEmpty()) {
+        if (this->fSelectionIsEmpty()) {
             qWinGroup->enableCopyAction(false);
         } else {
             this->fHasSelection = true;
@@ -306,6 +526,11 @@ DisplayWidget::mouseReleaseEvent( QMouseEvent* e )
         return;
     }
 
+    if (this->fMovePending) {
+        this->fMovePending = false;
+        this->updateLinkTracking(e->pos());
+    }
+
     // If we're still hovering over the clicked link, process it.
     if (this->fClickedLink == this->fHoverLink) {
         const textchar_t* cmd = this->fClickedLink->href_.get_url();
@@ -354,6 +579,23 @@ DisplayWidget::clearSelection()
 }
 
 
+QMimeData*
+DisplayWidget::selectedMimeData()
+{
+    if (DisplayWidget::curSelWidget == 0) {
+        return 0;
+    }
+    return DisplayWidget::curSelWidget->fMySelectedMimeData();
+}
+
+
+void
+DisplayWidget::materializeClipboardData()
+{
+    QTadsSelectionMimeData::materializeAll();
+}
+
+
 QString
 DisplayWidget::selectedText()
 {
@@ -371,15 +613,30 @@ DisplayWidget::updateLinkTracking( const QPoint& mousePos )
     // Get the display object containing the position.
     CHtmlPoint docPos;
     // If specified mouse position is invalid, map it from the current global
-    // position.
+    // position.  That's what callers do when the display changed, so we can't
+    // rely on what we found last time.
     if (mousePos.isNull()) {
         const QPoint pos(this->mapFromGlobal(QCursor::pos()));
         docPos.set(pos.x(), pos.y());
+        this->fTrackedRect = QRect();
     } else {
+        // If we're still in the item we found last time, nothing changed.
+        if (this->fTrackedRect.contains(mousePos)) {
+            return;
+        }
         docPos.set(mousePos.x(), mousePos.y());
     }
     CHtmlDisp* disp = this->formatter->find_by_pos(docPos, true);
 
+    // Remember where this item is, so we can skip all this while the mouse
+    // stays in it.
+    if (disp != 0 and not disp->link_varies_by_pos()) {
+        const CHtmlRect& pos = disp->get_pos();
+        this->fTrackedRect.setCoords(pos.left, pos.top, pos.right - 1, pos.bottom - 1);
+    } else {
+        this->fTrackedRect = QRect();
+    }
+
     // If there's nothing, no need to continue.
     if (disp == 0) {
         // If we were tracking anything, forget about it.
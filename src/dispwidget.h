@@ -20,6 +20,7 @@
 #include <QDebug>
 #include <QWidget>
 #include <QTime>
+#include <QRect>
 
 #include "config.h"
 
@@ -48,6 +49,19 @@ class DisplayWidget: public QWidget {
     // Time of last double-click event.
     QTime fLastDoubleClick;
 
+    // Area of the display item we last found under the mouse.  As long as
+    // the mouse stays in it, the link tracking result can't change, so we
+    // don't look it up again.  Null when there's no such item, or when the
+    // item's link depends on where in it the mouse is (image maps.)
+    QRect fTrackedRect;
+
+    // Link tracking on mouse moves is limited to once per display refresh;
+    // moves in between only update the pending position, which this timer
+    // then handles.
+    class QTimer* fMoveTimer;
+    QPoint fPendingMovePos;
+    bool fMovePending;
+
     // Stop tracking links.
     void
     fInvalidateLinkTracking();
@@ -56,12 +70,29 @@ class DisplayWidget: public QWidget {
     QString
     fMySelectedText();
 
+    // Whether there's no selected text, without extracting a large
+    // selection's text to find out.
+    bool
+    fSelectionIsEmpty();
+
+    // Returns clipboard data for the current selection, or null if there's
+    // no selected text.  The data for a large selection only extracts its
+    // text when it's asked for.
+    class QMimeData*
+    fMySelectedMimeData();
+
     void
     fHandleDoubleOrTripleClick( QMouseEvent* e, bool tripleClick );
 
     void
     fSyncClipboard();
 
+  private slots:
+    // Called by fMoveTimer to handle the last mouse move that came in while
+    // it was running.
+    void
+    fHandlePendingMove();
+
   protected:
     // Are we in text selection mode?
     bool inSelectMode;
@@ -107,6 +138,7 @@ class DisplayWidget: public QWidget {
         // Null so we won't try to access them.
         this->fClickedLink = this->fHoverLink = 0;
         this->fInvalidateLinkTracking();
+        materializeClipboardData();
     }
 
     // Clear the selection range.
@@ -119,6 +151,17 @@ class DisplayWidget: public QWidget {
     static QString
     selectedText();
 
+    // Like selectedText(), but returns clipboard data (owned by the caller),
+    // or null if there's no selected text.  See fMySelectedMimeData().
+    static class QMimeData*
+    selectedMimeData();
+
+    // Extracts the text of all clipboard and drag data that still refers to
+    // a display list.  Must be called before a display list changes in a way
+    // that invalidates text offsets.
+    static void
+    materializeClipboardData();
+
     // Update link tracking for specified mouse position.  If the specified
     // position isNull(), it will be autodetected.
     //
@@ -134,8 +134,8 @@ void
 DisplayWidgetInput::fBlinkCursor()
 {
     this->fBlinkVisible = not this->fBlinkVisible;
-    this->update(this->fCursorPos.x() - 5, this->fCursorPos.y() - 5,
-                 this->fCursorPos.x() + 5, this->fCursorPos.y() + this->fHeight + 5);
+    // Repaint just the cursor itself; the text around it hasn't changed.
+    this->update(this->fCursorPos.x() - 5, this->fCursorPos.y() - 5, 10, this->fHeight + 10);
 }
 
 
@@ -4,6 +4,9 @@
 #include <QDebug>
 #include <QMessageBox>
 #include <QFileInfo>
+#include <QDir>
+#include <QHash>
+#include <QDataStream>
 
 #include "globals.h"
 #include "settings.h"
@@ -70,6 +73,121 @@ QTadsGameInfoEnum::tads_enum_game_info( const char* name, const char* val )
 }
 
 
+// Metadata cache.  Reading a game's GameInfo means opening the game file
+// and scanning its resources, and the recent games menu does that for every
+// entry each time it's rebuilt.  So we keep what we read, in memory and in
+// the cache directory, keyed the same way as startup snapshots: by the
+// file's location, size and modification time, so an updated game is
+// simply read again.
+namespace {
+
+struct CachedGameInfo {
+    bool hasMetaInfo = false;
+    // The raw name/value pairs, in the order the game file gave them.
+    QList<QPair<QByteArray, QByteArray> > values;
+    // Whether we've looked for cover art, and the scaled image if found.
+    bool coverChecked = false;
+    QImage cover;
+};
+
+class GameInfoCollector: public CTadsGameInfo_enum {
+  public:
+    QList<QPair<QByteArray, QByteArray> > values;
+
+    void
+    tads_enum_game_info( const char* name, const char* val ) override
+    {
+        this->values.append(qMakePair(QByteArray(name), QByteArray(val)));
+    }
+};
+
+// Bump this when the layout of the cache file changes.
+const quint32 CACHE_FORMAT = 1;
+
+QHash<QString, CachedGameInfo> gameInfoCache;
+
+}
+
+
+// Returns the cache file name for a game file, or an empty string if there's
+// no cache directory.  This doubles as the in-memory cache key.
+static QString
+gameInfoCacheFile( const QByteArray& fname )
+{
+    return CHtmlSysFrameQt::gameCacheFile(fnameToQStr(fname.constData()), ".gameinfo");
+}
+
+
+static void
+writeGameInfoCache( const QString& cacheFile, const CachedGameInfo& entry )
+{
+    if (cacheFile.isEmpty() or not QDir().mkpath(QFileInfo(cacheFile).absolutePath())) {
+        return;
+    }
+    QFile file(cacheFile);
+    if (not file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return;
+    }
+    QDataStream out(&file);
+    out << CACHE_FORMAT << entry.hasMetaInfo << entry.values << entry.coverChecked << entry.cover;
+}
+
+
+static bool
+readGameInfoCache( const QString& cacheFile, CachedGameInfo& entry )
+{
+    QFile file(cacheFile);
+    if (cacheFile.isEmpty() or not file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&file);
+    quint32 format;
+    in >> format;
+    if (format != CACHE_FORMAT) {
+        return false;
+    }
+    in >> entry.hasMetaInfo >> entry.values >> entry.coverChecked >> entry.cover;
+    return in.status() == QDataStream::Ok;
+}
+
+
+// Returns the cached metadata for a game file, reading the game file only if
+// we don't already have it.
+static CachedGameInfo&
+cachedGameInfo( const QByteArray& fname )
+{
+    const QString& cacheFile = gameInfoCacheFile(fname);
+    const QString& key = cacheFile.isEmpty() ? fnameToQStr(fname.constData()) : cacheFile;
+    QHash<QString, CachedGameInfo>::iterator it = gameInfoCache.find(key);
+    if (it != gameInfoCache.end()) {
+        return it.value();
+    }
+
+    CachedGameInfo entry;
+    if (not readGameInfoCache(cacheFile, entry)) {
+        entry = CachedGameInfo();
+        CTadsGameInfo info;
+        GameInfoCollector cb;
+        entry.hasMetaInfo = info.read_from_file(fname.constData());
+        info.enum_values(&cb);
+        entry.values = cb.values;
+        writeGameInfoCache(cacheFile, entry);
+    }
+    return gameInfoCache.insert(key, entry).value();
+}
+
+
+// Feeds cached metadata to an enumerator as if it came from the game file.
+static void
+replayGameInfo( const CachedGameInfo& cached, QTadsGameInfoEnum& cb )
+{
+    for (int i = 0; i < cached.values.size(); ++i) {
+        cb.tads_enum_game_info(cached.values.at(i).first.constData(),
+                               cached.values.at(i).second.constData());
+    }
+}
+
+
 static void
 insertTableRow( QTableWidget* table, const QString& text1, const QString& text2 )
 {
@@ -163,20 +281,24 @@ GameInfoDialog::GameInfoDialog( const QByteArray& fname, QWidget* parent )
 {
     ui->setupUi(this);
 
-    CTadsGameInfo info;
     QTadsGameInfoEnum cb;
-
-    // Try to load the cover art.  If there is one, insert it into the text
-    // browser as the "CoverArt" resource.
-    const QImage& image = loadCoverArtImage();
+    CachedGameInfo& cached = cachedGameInfo(fname);
+
+    // Try to load the cover art, unless we already know what it is.  If there
+    // is one, insert it into the text browser as the "CoverArt" resource.
+    if (not cached.coverChecked) {
+        cached.cover = loadCoverArtImage();
+        cached.coverChecked = true;
+        writeGameInfoCache(gameInfoCacheFile(fname), cached);
+    }
+    const QImage& image = cached.cover;
     if (not image.isNull()) {
         ui->description->document()->addResource(QTextDocument::ImageResource,
                                                  QUrl(QString::fromLatin1("CoverArt")), image);
         this->resize(this->width(), this->height() + image.height());
     }
 
-    info.read_from_file(fname.constData());
-    info.enum_values(&cb);
+    replayGameInfo(cached, cb);
 
     // Fill out the description.
     QString tmp;
@@ -270,17 +392,15 @@ GameInfoDialog::~GameInfoDialog()
 bool
 GameInfoDialog::gameHasMetaInfo( const QByteArray& fname )
 {
-    CTadsGameInfo info;
-    return info.read_from_file(fname.constData());
+    return cachedGameInfo(fname).hasMetaInfo;
 }
 
 
 QTadsGameInfoEnum
 GameInfoDialog::getMetaInfo( const QByteArray& fname )
 {
-    CTadsGameInfo info;
+    const CachedGameInfo& cached = cachedGameInfo(fname);
     QTadsGameInfoEnum cb;
-    info.read_from_file(fname.constData());
-    info.enum_values(&cb);
+    replayGameInfo(cached, cb);
     return cb;
 }
@@ -0,0 +1,131 @@
+/* Copyright (C) 2013 Nikos Chantziaras.
+ *
+ * This file is part of the QTads program.  This program is free software; you
+ * can redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation; either version
+ * 2, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; see the file COPYING.  If not, write to the Free Software
+ * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <QApplication>
+#include <QHBoxLayout>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QRegExp>
+#include <QScrollBar>
+#include <QTextBrowser>
+#include <QTextCursor>
+#include <QVBoxLayout>
+
+#include "historydialog.h"
+#include "scrollbackjournal.h"
+
+
+// How many pages to load at a time.
+static const int pagesPerLoad = 20;
+
+
+HistoryDialog::HistoryDialog( QTadsScrollbackJournal* journal, QWidget* parent )
+    : QDialog(parent),
+      fJournal(journal),
+      fFirstPage(journal->pageCount())
+{
+    this->setWindowTitle(tr("Scrollback History"));
+    this->resize(640, 480);
+
+    this->fBrowser = new QTextBrowser(this);
+    this->fBrowser->setOpenLinks(false);
+    this->fFindEdit = new QLineEdit(this);
+    QPushButton* findButton = new QPushButton(tr("Find &Previous"), this);
+    findButton->setAutoDefault(false);
+
+    QHBoxLayout* findLayout = new QHBoxLayout;
+    findLayout->addWidget(this->fFindEdit);
+    findLayout->addWidget(findButton);
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addWidget(this->fBrowser);
+    layout->addLayout(findLayout);
+
+    connect(this->fFindEdit, SIGNAL(returnPressed()), this, SLOT(fFindPrevious()));
+    connect(findButton, SIGNAL(clicked()), this, SLOT(fFindPrevious()));
+
+    // Start out at the end of the history.
+    this->fLoadOlderPages(pagesPerLoad);
+    QScrollBar* bar = this->fBrowser->verticalScrollBar();
+    bar->setValue(bar->maximum());
+    this->fBrowser->moveCursor(QTextCursor::End);
+    connect(bar, SIGNAL(valueChanged(int)), this, SLOT(fScrolled(int)));
+}
+
+
+bool
+HistoryDialog::fLoadOlderPages( int count )
+{
+    if (this->fFirstPage == 0) {
+        return false;
+    }
+
+    const int first = qMax(this->fFirstPage - count, 0);
+    QByteArray html;
+    for (int i = first; i < this->fFirstPage; ++i) {
+        html += this->fJournal->page(i);
+    }
+    this->fFirstPage = first;
+
+    // Drop what only makes sense in the game window: banner and title
+    // contents, and images and sounds we have no way to load here.
+    QString str = QString::fromUtf8(html.constData(), html.size());
+    QRegExp hidden(QString::fromLatin1("<(banner|title|aboutbox)\\b.*</\\1\\s*>"), Qt::CaseInsensitive);
+    hidden.setMinimal(true);
+    str.remove(hidden);
+    str.remove(QRegExp(QString::fromLatin1("<(img|sound)\\b[^>]*>"), Qt::CaseInsensitive));
+
+    // Insert the pages in front of what we have, keeping the text the user
+    // is looking at in place.
+    QScrollBar* bar = this->fBrowser->verticalScrollBar();
+    const int fromBottom = bar->maximum() - bar->value();
+    QTextCursor cursor(this->fBrowser->document());
+    cursor.movePosition(QTextCursor::Start);
+    cursor.insertHtml(str);
+    bar->setValue(bar->maximum() - fromBottom);
+    return true;
+}
+
+
+void
+HistoryDialog::fScrolled( int value )
+{
+    if (value == this->fBrowser->verticalScrollBar()->minimum()) {
+        this->fLoadOlderPages(pagesPerLoad);
+    }
+}
+
+
+void
+HistoryDialog::fFindPrevious()
+{
+    const QString& text = this->fFindEdit->text();
+    if (text.isEmpty()) {
+        return;
+    }
+    while (not this->fBrowser->find(text, QTextDocument::FindBackward)) {
+        // Not in what we've loaded so far.  Load older pages and continue
+        // the search from the end of them.
+        const int oldLen = this->fBrowser->document()->characterCount();
+        if (not this->fLoadOlderPages(pagesPerLoad)) {
+            QApplication::beep();
+            return;
+        }
+        QTextCursor cursor(this->fBrowser->document());
+        cursor.setPosition(this->fBrowser->document()->characterCount() - oldLen);
+        this->fBrowser->setTextCursor(cursor);
+    }
+}
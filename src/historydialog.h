@@ -0,0 +1,62 @@
+/* Copyright (C) 2013 Nikos Chantziaras.
+ *
+ * This file is part of the QTads program.  This program is free software; you
+ * can redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation; either version
+ * 2, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; see the file COPYING.  If not, write to the Free Software
+ * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef HISTORYDIALOG_H
+#define HISTORYDIALOG_H
+
+#include <QDialog>
+
+#include "config.h"
+
+
+/* Viewer for the scrollback journal.
+ *
+ * Shows the most recent pages of the journal and pages in older ones as the
+ * user scrolls to the top, or as a search runs past the oldest page loaded
+ * so far.  Only what the user actually looks at gets read and laid out.
+ */
+class HistoryDialog: public QDialog {
+    Q_OBJECT
+
+  private:
+    class QTadsScrollbackJournal* fJournal;
+    class QTextBrowser* fBrowser;
+    class QLineEdit* fFindEdit;
+
+    // Oldest journal page we've loaded.
+    int fFirstPage;
+
+    // Loads up to 'count' pages preceding the ones we already have.  Returns
+    // false if there are no older pages.
+    bool
+    fLoadOlderPages( int count );
+
+  private slots:
+    void
+    fScrolled( int value );
+
+    // Searches backwards for the text in the find box, loading older pages
+    // until it's found or we run out of them.
+    void
+    fFindPrevious();
+
+  public:
+    HistoryDialog( class QTadsScrollbackJournal* journal, QWidget* parent = 0 );
+};
+
+
+#endif
@@ -0,0 +1,160 @@
+/* Copyright (C) 2013 Nikos Chantziaras.
+ *
+ * This file is part of the QTads program.  This program is free software; you
+ * can redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation; either version
+ * 2, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; see the file COPYING.  If not, write to the Free Software
+ * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+
+#include "imageshare.h"
+
+
+struct ImageMapping {
+    QFile* file;
+    const char* mem;
+    QString path;
+    qint64 size;
+    QDateTime modified;
+    int refs;
+};
+
+struct ImagePage {
+    const char* src;
+    char* data;
+    size_t len;
+    int refs;
+};
+
+static QMutex shareMutex;
+
+// Current mappings, by canonical file path and by address.  A file that
+// changed while mapped can have an older mapping that's only in the second
+// table.
+static QHash<QString, ImageMapping*> mappingsByPath;
+static QHash<const char*, ImageMapping*> mappingsByAddr;
+
+// Unmasked pages, by the address of their source data and by their own.
+static QHash<const char*, ImagePage*> pagesBySrc;
+static QHash<const char*, ImagePage*> pagesByData;
+
+
+const char*
+QTadsImageShare::mapFile( const char* fname, unsigned long* len )
+{
+    const QFileInfo info(QFile::decodeName(fname));
+    const QString& path = info.canonicalFilePath();
+    if (path.isEmpty()) {
+        return 0;
+    }
+
+    QMutexLocker lock(&shareMutex);
+
+    // If we have a mapping of the file as it is now, use that.
+    ImageMapping* map = mappingsByPath.value(path);
+    if (map != 0 and map->size == info.size() and map->modified == info.lastModified()) {
+        ++map->refs;
+        *len = static_cast<unsigned long>(map->size);
+        return map->mem;
+    }
+
+    QFile* file = new QFile(path);
+    uchar* mem = 0;
+    if (file->open(QIODevice::ReadOnly) and file->size() > 0) {
+        mem = file->map(0, file->size());
+    }
+    if (mem == 0) {
+        delete file;
+        return 0;
+    }
+    map = new ImageMapping;
+    map->file = file;
+    map->mem = reinterpret_cast<const char*>(mem);
+    map->path = path;
+    map->size = file->size();
+    map->modified = info.lastModified();
+    map->refs = 1;
+    mappingsByPath.insert(path, map);
+    mappingsByAddr.insert(map->mem, map);
+    *len = static_cast<unsigned long>(map->size);
+    return map->mem;
+}
+
+
+void
+QTadsImageShare::unmapFile( const char* mem )
+{
+    QMutexLocker lock(&shareMutex);
+    ImageMapping* map = mappingsByAddr.value(mem);
+    if (map == 0 or --map->refs > 0) {
+        return;
+    }
+    mappingsByAddr.remove(mem);
+    if (mappingsByPath.value(map->path) == map) {
+        mappingsByPath.remove(map->path);
+    }
+    // Deleting the file object also removes its mappings.
+    delete map->file;
+    delete map;
+}
+
+
+const char*
+QTadsImageShare::getPage( const char* src, size_t len, unsigned char xorMask )
+{
+    QMutexLocker lock(&shareMutex);
+    ImagePage* page = pagesBySrc.value(src);
+    if (page != 0 and page->len == len) {
+        ++page->refs;
+        return page->data;
+    }
+    if (page != 0) {
+        // Same source, different length; can't happen with a valid image,
+        // so just don't share it.
+        return 0;
+    }
+
+    page = new ImagePage;
+    page->src = src;
+    page->data = new char[len];
+    page->len = len;
+    page->refs = 1;
+    for (size_t i = 0; i < len; ++i) {
+        page->data[i] = static_cast<char>(src[i] ^ xorMask);
+    }
+    pagesBySrc.insert(src, page);
+    pagesByData.insert(page->data, page);
+    return page->data;
+}
+
+
+bool
+QTadsImageShare::releasePage( const char* data )
+{
+    QMutexLocker lock(&shareMutex);
+    ImagePage* page = pagesByData.value(data);
+    if (page == 0) {
+        return false;
+    }
+    if (--page->refs == 0) {
+        pagesByData.remove(data);
+        pagesBySrc.remove(page->src);
+        delete[] page->data;
+        delete page;
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+/* Copyright (C) 2013 Nikos Chantziaras.
+ *
+ * This file is part of the QTads program.  This program is free software; you
+ * can redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation; either version
+ * 2, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; see the file COPYING.  If not, write to the Free Software
+ * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef IMAGESHARE_H
+#define IMAGESHARE_H
+
+#include <cstddef>
+
+
+/* Process-wide store of T3 image file mappings and unmasked pool pages.
+ *
+ * Every T3 VM instance that runs the same image file gets the same read-only
+ * mapping of it, so the code and data in the file exist only once in memory,
+ * no matter how many instances use it.  Pool pages that are stored masked in
+ * the file can't be used in place; the first instance that needs such a page
+ * makes an unmasked copy, and later instances share that copy.  Only the
+ * state an instance creates or changes at run time is its own.
+ *
+ * A mapping is reused only while the file's size and modification time stay
+ * the same.  Everything here is safe to call from any thread.
+ */
+class QTadsImageShare {
+  public:
+    // Maps a file read-only, or returns the existing mapping of it.  Returns
+    // null if the file can't be mapped.
+    static const char*
+    mapFile( const char* fname, unsigned long* len );
+
+    // Releases a mapping returned by mapFile().  The file is unmapped when
+    // its last user releases it.
+    static void
+    unmapFile( const char* mem );
+
+    // Returns the unmasked copy of the 'len' bytes at 'src', which must be
+    // in a mapping returned by mapFile().
+    static const char*
+    getPage( const char* src, size_t len, unsigned char xorMask );
+
+    // Releases a page returned by getPage().  Returns false if 'page' isn't
+    // one of ours.
+    static bool
+    releasePage( const char* page );
+};
+
+
+#endif
@@ -21,6 +21,8 @@
 #include "settings.h"
 #include "sysframe.h"
 #include "qtadssound.h"
+#include "startupprofiler.h"
+#include "vmtrace.h"
 
 // Static OS X builds need the Qt codec plugins.
 #ifndef NO_STATIC_TEXTCODEC_PLUGINS
@@ -47,9 +49,45 @@
 
 int main( int argc, char** argv )
 {
+    // Check for our own options before anything else, so that the startup
+    // profiler sees all of startup.  We remove them from the argument list, so
+    // that neither Qt nor our game file argument handling below sees them.
+    //
+    //   --profile-startup    Print a breakdown of startup times on exit.
+    //   --replay <script>    Read the game's commands from a command script.
+    //   --trace <file>       Write a Chrome trace of each turn's phases.
+    QTadsStartupProfiler* startupProf = 0;
+    QByteArray replayScript;
+    int argOut = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--profile-startup") == 0) {
+            if (startupProf == 0) {
+                startupProf = new QTadsStartupProfiler;
+            }
+        } else if (qstrcmp(argv[i], "--replay") == 0 and i + 1 < argc) {
+            replayScript = argv[++i];
+        } else if (qstrcmp(argv[i], "--trace") == 0 and i + 1 < argc) {
+            ++i;
+            if (not vm_trace_open(argv[i])) {
+                qWarning() << "Can't open trace file" << argv[i];
+            }
+        } else {
+            argv[argOut++] = argv[i];
+        }
+    }
+    argv[argOut] = 0;
+    argc = argOut;
+
     CHtmlResType::add_basic_types();
-    CHtmlSysFrameQt* app = new CHtmlSysFrameQt(argc, argv, "QTads", "2.0", "Nikos Chantziaras",
-                                               "qtads.sourceforge.net");
+    CHtmlSysFrameQt* app;
+    {
+        QTadsStartupPhase phase("application setup");
+        app = new CHtmlSysFrameQt(argc, argv, "QTads", "2.0", "Nikos Chantziaras", "qtads.sourceforge.net");
+    }
+
+    if (not replayScript.isEmpty()) {
+        app->setReplayScript(QFile::decodeName(replayScript));
+    }
 
     // Filename of the game to run.
     QString gameFileName;
@@ -76,6 +114,7 @@ int main( int argc, char** argv )
 
     if (not initSound()) {
         delete app;
+        delete startupProf;
         return 1;
     }
 
@@ -84,5 +123,10 @@ int main( int argc, char** argv )
 
     delete app;
     quitSound();
+    vm_trace_close();
+    if (startupProf != 0) {
+        startupProf->report();
+        delete startupProf;
+    }
     return ret;
 }
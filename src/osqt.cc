@@ -32,6 +32,9 @@
 #endif
 #include <QDir>
 #include <QDateTime>
+#if QT_VERSION >= 0x040700
+    #include <QElapsedTimer>
+#endif
 #include <QTimer>
 #include <QTextCodec>
 #include <QFileDialog>
@@ -77,6 +80,249 @@ qStrToFname( const QString& fnameStr )
 }
 
 
+/* --------------------------------------------------------------------
+ * Buffered file handles.
+ *
+ * The T3 loader and the saved state code do lots of tiny reads and writes
+ * (CVmFile::read_uint2() and friends), and seek back and forth within small
+ * ranges.  QFile has a read buffer of its own, but every seek goes to the
+ * operating system and, for backward seeks, throws the buffer away.  So for
+ * binary files we open the QFile unbuffered and keep a larger buffer here,
+ * where seeks within the buffered range cost nothing.  Text files are passed
+ * straight through to QFile, since QFile does the newline translation for
+ * them.
+ *
+ * The buffer holds either data read from the file or data waiting to be
+ * written, never both.  fBufPos is the file offset of the start of the
+ * buffer and fBufIdx is our current position within it, so the logical file
+ * position is always fBufPos + fBufIdx.  When reading, the QFile's own
+ * position is at the end of the buffered data (fBufPos + fBufLen); when
+ * writing, it's at fBufPos.
+ */
+class QTadsFile {
+  private:
+    enum { kBufSize = 65536 };
+
+    QFile* fFile;
+    bool fBuffered;
+    char* fBuf;
+    qint64 fBufPos;
+    int fBufLen;
+    int fBufIdx;
+    bool fWriting;
+
+    // Write out any pending data.
+    bool
+    flushWrite()
+    {
+        if (not this->fWriting) {
+            return true;
+        }
+        this->fWriting = false;
+        qint64 len = this->fBufLen;
+        this->fBufPos += len;
+        this->fBufLen = this->fBufIdx = 0;
+        return len == 0 or this->fFile->write(this->fBuf, len) == len;
+    }
+
+    // Discard the read buffer, leaving the QFile at the logical position.
+    bool
+    dropReadBuffer()
+    {
+        if (this->fBufIdx == this->fBufLen) {
+            this->fBufPos += this->fBufLen;
+            this->fBufLen = this->fBufIdx = 0;
+            return true;
+        }
+        this->fBufPos += this->fBufIdx;
+        this->fBufLen = this->fBufIdx = 0;
+        return this->fFile->seek(this->fBufPos);
+    }
+
+    // Make the QFile's state match ours, emptying the buffer.
+    bool
+    sync()
+    {
+        return this->fWriting ? this->flushWrite() : this->dropReadBuffer();
+    }
+
+    // Refill the read buffer at the current position.
+    bool
+    fill()
+    {
+        if (this->fBuf == 0) {
+            this->fBuf = new char[kBufSize];
+        }
+        this->fBufPos += this->fBufLen;
+        this->fBufIdx = 0;
+        qint64 got = this->fFile->read(this->fBuf, kBufSize);
+        this->fBufLen = got > 0 ? static_cast<int>(got) : 0;
+        return this->fBufLen > 0;
+    }
+
+  public:
+    // Takes ownership of the (open) file.
+    QTadsFile( QFile* file )
+        : fFile(file),
+          fBuffered(not (file->openMode() & QIODevice::Text)),
+          fBuf(0),
+          fBufPos(file->pos()),
+          fBufLen(0),
+          fBufIdx(0),
+          fWriting(false)
+    { }
+
+    ~QTadsFile()
+    {
+        this->flushWrite();
+        delete this->fFile;
+        delete[] this->fBuf;
+    }
+
+    // Returns the underlying QFile, with any buffered state flushed out,
+    // for operations we don't buffer ourselves.
+    QFile*
+    qfile()
+    {
+        this->sync();
+        return this->fFile;
+    }
+
+    qint64
+    read( char* dst, qint64 len )
+    {
+        if (not this->fBuffered) {
+            return this->fFile->read(dst, len);
+        }
+        if (this->fWriting and not this->flushWrite()) {
+            return -1;
+        }
+        qint64 done = 0;
+        while (done < len) {
+            int avail = this->fBufLen - this->fBufIdx;
+            if (avail > 0) {
+                int n = static_cast<int>(qMin(static_cast<qint64>(avail), len - done));
+                memcpy(dst + done, this->fBuf + this->fBufIdx, n);
+                this->fBufIdx += n;
+                done += n;
+            } else if (len - done >= kBufSize) {
+                // Large reads go directly into the caller's buffer.
+                this->fBufPos += this->fBufLen;
+                this->fBufLen = this->fBufIdx = 0;
+                qint64 got = this->fFile->read(dst + done, len - done);
+                if (got <= 0) {
+                    break;
+                }
+                this->fBufPos += got;
+                done += got;
+            } else if (not this->fill()) {
+                break;
+            }
+        }
+        return done;
+    }
+
+    bool
+    getChar( char* c )
+    {
+        if (not this->fBuffered) {
+            return this->fFile->getChar(c);
+        }
+        if (not this->fWriting and this->fBufIdx < this->fBufLen) {
+            *c = this->fBuf[this->fBufIdx++];
+            return true;
+        }
+        return this->read(c, 1) == 1;
+    }
+
+    qint64
+    write( const char* src, qint64 len )
+    {
+        if (not this->fBuffered) {
+            return this->fFile->write(src, len);
+        }
+        if (not this->fWriting) {
+            if (not this->dropReadBuffer()) {
+                return -1;
+            }
+            this->fWriting = true;
+        }
+        if (this->fBufLen + len > kBufSize) {
+            // Doesn't fit; write out what we have.  Large writes then go
+            // directly to the file.
+            if (not this->flushWrite()) {
+                return -1;
+            }
+            if (len >= kBufSize) {
+                qint64 put = this->fFile->write(src, len);
+                if (put > 0) {
+                    this->fBufPos += put;
+                }
+                return put;
+            }
+            this->fWriting = true;
+        }
+        if (this->fBuf == 0) {
+            this->fBuf = new char[kBufSize];
+        }
+        memcpy(this->fBuf + this->fBufLen, src, len);
+        this->fBufLen += static_cast<int>(len);
+        this->fBufIdx = this->fBufLen;
+        return len;
+    }
+
+    bool
+    flush()
+    {
+        if (not this->flushWrite()) {
+            return false;
+        }
+        return this->fFile->flush();
+    }
+
+    qint64
+    pos() const
+    {
+        if (not this->fBuffered) {
+            return this->fFile->pos();
+        }
+        return this->fBufPos + this->fBufIdx;
+    }
+
+    qint64
+    size()
+    {
+        if (this->fWriting) {
+            this->flushWrite();
+        }
+        return this->fFile->size();
+    }
+
+    bool
+    seek( qint64 pos )
+    {
+        if (not this->fBuffered) {
+            return this->fFile->seek(pos);
+        }
+        // Seeking within the read buffer doesn't need to touch the file.
+        if (not this->fWriting and pos >= this->fBufPos and pos <= this->fBufPos + this->fBufLen) {
+            this->fBufIdx = static_cast<int>(pos - this->fBufPos);
+            return true;
+        }
+        if (not this->flushWrite()) {
+            return false;
+        }
+        this->fBufLen = this->fBufIdx = 0;
+        if (not this->fFile->seek(pos)) {
+            this->fBufPos = this->fFile->pos();
+            return false;
+        }
+        this->fBufPos = pos;
+        return true;
+    }
+};
+
+
 /* --------------------------------------------------------------------
  * Basic file I/O interface.
  */
@@ -86,12 +332,17 @@ createQFile( const char* fname, QFile::OpenMode mode )
 {
     Q_ASSERT(fname != 0);
 
+    // We buffer binary files ourselves.
+    if (not (mode & QFile::Text)) {
+        mode |= QFile::Unbuffered;
+    }
+
     QFile* file = new QFile(fnameToQStr(fname));
     if (not file->open(mode)) {
         delete file;
         return 0;
     }
-    return file;
+    return new QTadsFile(file);
 }
 
 
@@ -202,12 +453,16 @@ osfdup( osfildef* orig, const char* mode )
         return 0;
     }
 
+    if (not (qMode & QFile::Text)) {
+        qMode |= QFile::Unbuffered;
+    }
+
     QFile* file = new QFile(0);
-    if (not file->open(orig->handle(), qMode)) {
+    if (not file->open(orig->qfile()->handle(), qMode)) {
         delete file;
         return 0;
     }
-    return file;
+    return new QTadsFile(file);
 }
 
 
@@ -219,7 +474,7 @@ osfgets( char* buf, size_t len, osfildef* fp )
     Q_ASSERT(buf != 0);
     Q_ASSERT(fp != 0);
 
-    if (fp->readLine(buf, len) != static_cast<qint64>(len)) {
+    if (fp->qfile()->readLine(buf, len) != static_cast<qint64>(len)) {
         return 0;
     }
     return buf;
@@ -760,7 +1015,7 @@ os_create_tempfile( const char* fname, char* buf )
         delete file;
         return 0;
     }
-    return file;
+    return new QTadsFile(file);
 }
 
 
@@ -1495,6 +1750,16 @@ os_time_ns( os_time_t* seconds, long* nanoseconds )
 long
 os_get_sys_clock_ms( void )
 {
+#if QT_VERSION >= 0x040700
+    // Use a monotonic clock where we can.  QTime follows the wall clock, so
+    // it jumps when the system time is adjusted, which real-time games
+    // notice as stalls or bursts of timer events.
+    static QElapsedTimer zeroPoint;
+    if (not zeroPoint.isValid()) {
+        zeroPoint.start();
+    }
+    return static_cast<long>(zeroPoint.elapsed());
+#else
     static QTime zeroPoint(QTime::currentTime());
     static long lastRet = -1;
     static unsigned long wraps = 0;
@@ -1514,6 +1779,7 @@ os_get_sys_clock_ms( void )
 
     lastRet = ret;
     return ret + (wraps * 86400000L);
+#endif
 }
 
 
@@ -1529,6 +1795,9 @@ os_sleep_ms( long ms )
     QEventLoop idleLoop;
     QTimer timer;
     timer.setSingleShot(true);
+#if QT_VERSION >= 0x050000
+    timer.setTimerType(Qt::PreciseTimer);
+#endif
     QObject::connect(&timer, SIGNAL(timeout()), &idleLoop, SLOT(quit()));
     QObject::connect(qFrame, SIGNAL(gameQuitting()), &idleLoop, SLOT(quit()));
     timer.start(ms);
@@ -1536,6 +1805,37 @@ os_sleep_ms( long ms )
 }
 
 
+/* Yield CPU.
+ *
+ * The VM calls this every few thousand function calls.  The game runs in the
+ * GUI thread, so this is our only chance to keep the interface responsive
+ * (repainting, resizing, scrolling) while a long turn is being computed.
+ * Processing events is not free, so we only do it if at least 50ms have
+ * passed since the last time.
+ *
+ * We're in the middle of a turn here, so we leave keyboard and mouse events
+ * queued until the game asks for input.  Otherwise a keypress could reach the
+ * input line, or a menu action could start a new game or restore, while the
+ * VM is still executing.
+ */
+int
+os_yield( void )
+{
+    static long lastYield = 0;
+
+    if (not qFrame->gameRunning()) {
+        return false;
+    }
+    long now = os_get_sys_clock_ms();
+    if (now - lastYield < 50 and now >= lastYield) {
+        return false;
+    }
+    qFrame->advanceEventLoop(QEventLoop::ExcludeUserInputEvents, 10);
+    lastYield = os_get_sys_clock_ms();
+    return false;
+}
+
+
 /* Set a file's type information.
  *
  * TODO: Find out if this can be empty on all systems Qt supports.
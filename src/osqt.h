@@ -73,10 +73,17 @@ typedef quint16 uint16_t;
 typedef qint32 int32_t;
 typedef quint32 uint32_t;
 
-/* TODO: Implement threads.
- */
+/* Thread-local storage.  We only run one interpreter at a time, on one
+ * thread, unless we're built with VMGLOB_PARAM to host several T3 VMs on
+ * separate threads; only that build needs real thread-locals. */
 #define OS_DECLARATIVE_TLS
+#if defined(VMGLOB_PARAM) && defined(_MSC_VER)
+#define OS_DECL_TLS(t, v) __declspec(thread) t v
+#elif defined(VMGLOB_PARAM)
+#define OS_DECL_TLS(t, v) __thread t v
+#else
 #define OS_DECL_TLS(t, v) t v
+#endif
 
 /* We don't support the Atari 2600. */
 #include "osbigmem.h"
@@ -156,11 +163,12 @@ typedef quint32 uint32_t;
 #define OS_NEWLINE_SEQ  "\n"
 #endif
 
-/* File handle structure for osfxxx functions. */
+/* File handle structure for osfxxx functions.  This wraps a QFile and adds
+ * our own read/write buffer for binary files; see osqt.cc. */
 #ifdef __cplusplus
-typedef class QFile osfildef;
+typedef class QTadsFile osfildef;
 #else
-typedef struct QFile osfildef;
+typedef struct QTadsFile osfildef;
 #endif
 
 /* The maximum width of a line of text.  We ignore this, but the base code
@@ -0,0 +1,120 @@
+/* Copyright (C) 2013 Nikos Chantziaras.
+ *
+ * This file is part of the QTads program.  This program is free software; you
+ * can redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation; either version
+ * 2, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; see the file COPYING.  If not, write to the Free Software
+ * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <QLabel>
+
+#include "perfstats.h"
+#include "qtadsimage.h"
+#include "qtadssound.h"
+#include "vmobj.h"
+#include "vmmain.h"
+
+
+bool QTadsPerfStats::fEnabled = false;
+bool QTadsPerfStats::fInTurn = false;
+QElapsedTimer QTadsPerfStats::fTurnClock;
+qint64 QTadsPerfStats::fPhaseNs[QTadsPerfStats::PhaseCount];
+unsigned long QTadsPerfStats::fGcPasses = 0;
+unsigned long QTadsPerfStats::fGcPauseMs = 0;
+QLabel* QTadsPerfStats::fLabel = 0;
+
+
+// Formats a byte count for display.
+static QString
+fmtBytes( qint64 bytes )
+{
+    if (bytes < 1024 * 1024) {
+        return QString::number(bytes / 1024.0, 'f', 1) + QString::fromLatin1(" KB");
+    }
+    return QString::number(bytes / (1024.0 * 1024.0), 'f', 1) + QString::fromLatin1(" MB");
+}
+
+
+// Formats a nanosecond count as milliseconds.
+static QString
+fmtMs( qint64 ns )
+{
+    return QString::number(ns / 1000000.0, 'f', 1);
+}
+
+
+void
+QTadsPerfStats::setEnabled( bool enable, QLabel* label )
+{
+    fEnabled = enable;
+    fLabel = label;
+    fInTurn = false;
+    for (int i = 0; i < PhaseCount; ++i) {
+        fPhaseNs[i] = 0;
+    }
+    if (fLabel != 0) {
+        fLabel->setText(QObject::tr("Performance: waiting for the next turn"));
+    }
+}
+
+
+void
+QTadsPerfStats::beginTurn()
+{
+    if (not fEnabled) {
+        return;
+    }
+    fInTurn = true;
+    fTurnClock.start();
+    fPhaseNs[Parse] = 0;
+    fPhaseNs[Format] = 0;
+
+    // Remember where the collector stood, so we can tell what it did during
+    // the turn.
+    vm_gc_stats gc;
+    if (vm_get_gc_stats(&gc)) {
+        fGcPasses = gc.passes;
+        fGcPauseMs = gc.total_pause_ms;
+    }
+}
+
+
+void
+QTadsPerfStats::endTurn()
+{
+    if (not fEnabled or not fInTurn) {
+        return;
+    }
+    fInTurn = false;
+
+    const qint64 turnNs = fTurnClock.nsecsElapsed();
+    const qint64 vmNs = qMax(Q_INT64_C(0), turnNs - fPhaseNs[Parse] - fPhaseNs[Format] - fPhaseNs[Paint]);
+    QString text = QObject::tr("Turn %1 ms (VM %2, parse %3, format %4, paint %5)")
+                   .arg(fmtMs(turnNs)).arg(fmtMs(vmNs)).arg(fmtMs(fPhaseNs[Parse]))
+                   .arg(fmtMs(fPhaseNs[Format])).arg(fmtMs(fPhaseNs[Paint]));
+
+    vm_gc_stats gc;
+    if (vm_get_gc_stats(&gc)) {
+        text += QObject::tr(" | GC %1 passes, %2 ms | heap %3 | undo %4")
+                .arg(gc.passes - fGcPasses).arg(gc.total_pause_ms - fGcPauseMs)
+                .arg(fmtBytes(gc.live_bytes)).arg(fmtBytes(gc.undo_bytes));
+    }
+    text += QObject::tr(" | cache %1").arg(fmtBytes(QTadsImage::bytesUsed() + decodedSoundBytes()));
+
+    // Painting for this turn's output happens from here on.
+    fPhaseNs[Paint] = 0;
+
+    if (fLabel != 0) {
+        fLabel->setText(text);
+        fLabel->setToolTip(soundLayerStats());
+    }
+}
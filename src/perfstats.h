@@ -0,0 +1,99 @@
+/* Copyright (C) 2013 Nikos Chantziaras.
+ *
+ * This file is part of the QTads program.  This program is free software; you
+ * can redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation; either version
+ * 2, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; see the file COPYING.  If not, write to the Free Software
+ * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef PERFSTATS_H
+#define PERFSTATS_H
+
+#include <QElapsedTimer>
+#include <QtGlobal>
+
+
+/* Per-turn performance statistics, for the performance overlay in the status
+ * bar.
+ *
+ * A turn runs from the moment the game gets its input until it asks for the
+ * next input.  During the turn we add up the time spent parsing and
+ * formatting the game's output.  Painting mostly happens while we wait for
+ * input, so the paint time shown for a turn is everything painted since the
+ * previous turn ended.  The rest of the turn is VM time.  For T3 games, we
+ * also show the garbage collector's activity during the turn, the heap and
+ * undo log size, and the memory held by our image and sound caches.
+ *
+ * Nothing is measured unless the overlay is on.
+ */
+class QTadsPerfStats {
+  public:
+    enum Phase { Parse, Format, Paint, PhaseCount };
+
+  private:
+    static bool fEnabled;
+    static bool fInTurn;
+    static QElapsedTimer fTurnClock;
+    static qint64 fPhaseNs[PhaseCount];
+    static unsigned long fGcPasses;
+    static unsigned long fGcPauseMs;
+    static class QLabel* fLabel;
+
+  public:
+    static bool
+    enabled()
+    { return fEnabled; }
+
+    // Turns measuring on or off.  The results are shown in 'label'.
+    static void
+    setEnabled( bool enable, class QLabel* label );
+
+    static void
+    addPhaseTime( Phase phase, qint64 ns )
+    { fPhaseNs[phase] += ns; }
+
+    // The game got its input.
+    static void
+    beginTurn();
+
+    // The game is asking for input.  Updates the overlay.
+    static void
+    endTurn();
+};
+
+
+/* Adds the time from construction to destruction to a phase of the current
+ * turn, if the overlay is on.
+ */
+class QTadsPerfTimer {
+  private:
+    QTadsPerfStats::Phase fPhase;
+    QElapsedTimer fClock;
+
+  public:
+    explicit QTadsPerfTimer( QTadsPerfStats::Phase phase )
+        : fPhase(phase)
+    {
+        if (QTadsPerfStats::enabled()) {
+            this->fClock.start();
+        }
+    }
+
+    ~QTadsPerfTimer()
+    {
+        if (QTadsPerfStats::enabled() and this->fClock.isValid()) {
+            QTadsPerfStats::addPhaseTime(this->fPhase, this->fClock.nsecsElapsed());
+        }
+    }
+};
+
+
+#endif
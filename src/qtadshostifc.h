@@ -18,13 +18,68 @@
 #define QTADSHOSTIFC_H
 
 #include <cstddef>
+#include <QByteArray>
+#include <QFile>
+#include <QThread>
 
+#include "imageshare.h"
 #include "vmhost.h"
 #include "resload.h"
 #include "appctx.h"
 #include "config.h"
 
 
+/* Background writer for T3 autosave files.  The VM serializes the game state
+ * into a memory buffer on its own thread; this thread takes the buffer and
+ * does the disk I/O, so the VM can go straight back to waiting for input.
+ */
+class QTadsAutosaveWriter: public QThread {
+  private:
+    QByteArray fFileName;
+    char* fBuf;
+    size_t fLen;
+
+  protected:
+    void
+    run() override
+    {
+        // Write to a temporary file first and then replace the old autosave,
+        // so that a write that fails half-way doesn't leave us with nothing.
+        const QString& fname = QFile::decodeName(this->fFileName);
+        const QString& tmpName = fname + QString::fromLatin1(".tmp");
+        QFile file(tmpName);
+        bool ok = file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+                  and file.write(this->fBuf, this->fLen) == static_cast<qint64>(this->fLen);
+        file.close();
+        t3free(this->fBuf);
+        this->fBuf = 0;
+        if (ok) {
+            QFile::remove(fname);
+            QFile::rename(tmpName, fname);
+        } else {
+            QFile::remove(tmpName);
+        }
+    }
+
+  public:
+    QTadsAutosaveWriter()
+    : fBuf(0),
+      fLen(0)
+    { }
+
+    // Start writing a buffer.  We take ownership of the buffer.  Any
+    // previous write must have finished.
+    void
+    startWrite( const char* fname, char* buf, size_t len )
+    {
+        this->fFileName = fname;
+        this->fBuf = buf;
+        this->fLen = len;
+        this->start();
+    }
+};
+
+
 /* Host application interface.  This provides a bridge between the T3 VM host
  * interface (class CVmHostIfc) and the TADS 2 application context (struct
  * appctxdef) mechanism.
@@ -36,6 +91,13 @@ class QTadsHostIfc: public CVmHostIfc {
     int fIoSafetyWrite;
     CResLoader* fCmapResLoader;
 
+    // Autosave file name; empty if autosaves are disabled.
+    QByteArray fAutosaveFile;
+    QTadsAutosaveWriter fAutosaveWriter;
+
+    // Startup snapshot file name; empty if snapshots are disabled.
+    QByteArray fSnapshotFile;
+
   public:
     QTadsHostIfc( struct appctxdef* appctx )
     : fAppctx(appctx),
@@ -48,6 +110,7 @@ class QTadsHostIfc: public CVmHostIfc {
 
     ~QTadsHostIfc() override
     {
+        this->fAutosaveWriter.wait();
         delete this->fCmapResLoader;
     }
 
@@ -232,6 +295,56 @@ class QTadsHostIfc: public CVmHostIfc {
     {
         return os_get_special_path(buf, buflen, 0, id);
     }
+
+    const char*
+    get_autosave_file() override
+    { return this->fAutosaveFile.isEmpty() ? 0 : this->fAutosaveFile.constData(); }
+
+    void
+    write_autosave( const char* fname, char* buf, size_t len ) override
+    {
+        // We only keep one write in flight.  Saves happen once per command,
+        // so the previous one has normally finished long before the next.
+        this->fAutosaveWriter.wait();
+        this->fAutosaveWriter.startWrite(fname, buf, len);
+    }
+
+    const char*
+    get_snapshot_file() override
+    { return this->fSnapshotFile.isEmpty() ? 0 : this->fSnapshotFile.constData(); }
+
+    const char*
+    map_file( const char* fname, unsigned long* len ) override
+    { return QTadsImageShare::mapFile(fname, len); }
+
+    void
+    unmap_file( const char* mem ) override
+    { QTadsImageShare::unmapFile(mem); }
+
+    const char*
+    get_shared_page( const char* src, size_t len, uchar xor_mask ) override
+    { return QTadsImageShare::getPage(src, len, xor_mask); }
+
+    int
+    release_shared_page( const char* page ) override
+    { return QTadsImageShare::releasePage(page); }
+
+    // Set the autosave file name.  An empty name disables autosaves.  Waits
+    // for any pending autosave write to finish.
+    void
+    setAutosaveFile( const QByteArray& fname )
+    {
+        this->fAutosaveWriter.wait();
+        this->fAutosaveFile = fname;
+    }
+
+    // Set the startup snapshot file name.  An empty name disables snapshots.
+    void
+    setSnapshotFile( const QByteArray& fname )
+    {
+        this->fAutosaveWriter.wait();
+        this->fSnapshotFile = fname;
+    }
 };
 
 
@@ -15,17 +15,237 @@
  * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
 
+#include <QDebug>
 #include <QPainter>
+#include <QRunnable>
+#include <QThreadPool>
 
 #include "syswin.h"
 #include "qtadsimage.h"
+#include "qtadsresdata.h"
 #include "settings.h"
 
 
+QTadsImage* QTadsImage::fLruHead = 0;
+QTadsImage* QTadsImage::fLruTail = 0;
+qint64 QTadsImage::fBytesUsed = 0;
+int QTadsImage::fImageCount = 0;
+int QTadsImage::fEvictions = 0;
+int QTadsImage::fReloads = 0;
+
+
+QTadsImage::~QTadsImage()
+{
+    if (not this->fFormat.isEmpty()) {
+        this->lruUnlink();
+        fBytesUsed -= this->fBytes;
+        --fImageCount;
+    }
+}
+
+
+void
+QTadsImage::lruLink()
+{
+    this->fLruPrev = 0;
+    this->fLruNext = fLruHead;
+    if (fLruHead != 0) {
+        fLruHead->fLruPrev = this;
+    } else {
+        fLruTail = this;
+    }
+    fLruHead = this;
+}
+
+
+void
+QTadsImage::lruUnlink()
+{
+    if (this->fBytes == 0) {
+        // Dropped images aren't in the list.
+        return;
+    }
+    if (this->fLruPrev != 0) {
+        this->fLruPrev->fLruNext = this->fLruNext;
+    } else {
+        fLruHead = this->fLruNext;
+    }
+    if (this->fLruNext != 0) {
+        this->fLruNext->fLruPrev = this->fLruPrev;
+    } else {
+        fLruTail = this->fLruPrev;
+    }
+    this->fLruPrev = this->fLruNext = 0;
+}
+
+
+void
+QTadsImage::evict()
+{
+    this->lruUnlink();
+    fBytesUsed -= this->fBytes;
+    this->fBytes = 0;
+    QImage::operator =(QImage());
+    this->fPixmap = QPixmap();
+    ++fEvictions;
+}
+
+
+qint64
+QTadsImage::budgetBytes()
+{
+    // The budget is in MB; 0 means no limit.
+    return qMax(static_cast<qint64>(qFrame->settings()->imageMemoryBudget), qint64(0)) * 1024 * 1024;
+}
+
+
+bool
+QTadsImage::reserveBytes( qint64 bytes )
+{
+    const qint64 budget = budgetBytes();
+    if (budget > 0 and bytes > budget) {
+        return false;
+    }
+    fBytesUsed += bytes;
+    enforceBudget(0);
+    if (budget > 0 and fBytesUsed > budget) {
+        fBytesUsed -= bytes;
+        return false;
+    }
+    return true;
+}
+
+
+void
+QTadsImage::enforceBudget( const QTadsImage* keep )
+{
+    const qint64 budget = budgetBytes();
+    if (budget <= 0) {
+        return;
+    }
+    QTadsImage* img = fLruTail;
+    while (fBytesUsed > budget and img != 0) {
+        QTadsImage* prev = img->fLruPrev;
+        if (img != keep) {
+            img->evict();
+        }
+        img = prev;
+    }
+}
+
+
+void
+QTadsImage::setSource( const QString& filename, unsigned long seekpos, unsigned long size,
+                       const QByteArray& format )
+{
+    Q_ASSERT(this->fFormat.isEmpty());
+    if (format.isEmpty() or this->isNull()) {
+        return;
+    }
+    this->fSrcFile = filename;
+    this->fSrcPos = seekpos;
+    this->fSrcSize = size;
+    this->fFormat = format;
+    this->fWidth = QImage::width();
+    this->fHeight = QImage::height();
+    this->fBytes = this->byteCount();
+    if (this->fBytes == 0) {
+        // Keep the "in the list" test in lruUnlink() meaningful.
+        this->fBytes = 1;
+    }
+    fBytesUsed += this->fBytes;
+    ++fImageCount;
+    this->lruLink();
+    enforceBudget(this);
+}
+
+
+void
+QTadsImage::setPendingSource( const QString& filename, unsigned long seekpos, unsigned long size,
+                              const QByteArray& format, const QSize& dimensions )
+{
+    Q_ASSERT(this->fFormat.isEmpty() and this->isNull());
+    this->fSrcFile = filename;
+    this->fSrcPos = seekpos;
+    this->fSrcSize = size;
+    this->fFormat = format;
+    this->fWidth = dimensions.width();
+    this->fHeight = dimensions.height();
+    this->fBytes = 0;
+    ++fImageCount;
+}
+
+
+void
+QTadsImage::touch()
+{
+    if (this->fFormat.isEmpty()) {
+        return;
+    }
+    if (this->fBytes == 0) {
+        // We don't have our pixels.  Either they're still being decoded in
+        // the background, or they were dropped and we must decode the image
+        // again.
+        QImage decoded;
+        if (QTadsImagePrefetcher::take(this->fSrcFile, this->fSrcPos, this->fSrcSize, &decoded)) {
+            QImage::operator =(decoded);
+        } else {
+            const QTadsResourceData data(this->fSrcFile, this->fSrcPos, this->fSrcSize);
+            if (not data.isValid()
+                or not this->loadFromData(reinterpret_cast<const uchar*>(data.data()),
+                                          static_cast<int>(data.size()), this->fFormat.constData())) {
+                qWarning() << "ERROR: Could not reload image from" << this->fSrcFile;
+                return;
+            }
+            ++fReloads;
+        }
+        this->fBytes = qMax(this->byteCount(), 1);
+        fBytesUsed += this->fBytes;
+        this->lruLink();
+    } else if (fLruHead != this) {
+        this->lruUnlink();
+        this->lruLink();
+    }
+    enforceBudget(this);
+}
+
+
+const QPixmap&
+QTadsImage::cachedPixmap( const QSize& size, qreal dpr, bool smooth )
+{
+    const QSize devSize(qRound(size.width() * dpr), qRound(size.height() * dpr));
+    const bool scaled = devSize != QImage::size();
+    if (not this->fPixmap.isNull() and this->fPixmap.size() == devSize and this->fPixmapDpr == dpr
+        and (not scaled or this->fPixmapSmooth == smooth))
+    {
+        return this->fPixmap;
+    }
+
+    if (scaled) {
+        this->fPixmap = QPixmap::fromImage(QImage::scaled(devSize, Qt::IgnoreAspectRatio,
+                                                          smooth ? Qt::SmoothTransformation
+                                                                 : Qt::FastTransformation));
+    } else {
+        this->fPixmap = QPixmap::fromImage(*this);
+    }
+#if QT_VERSION >= 0x050000
+    this->fPixmap.setDevicePixelRatio(dpr);
+#endif
+    this->fPixmapDpr = dpr;
+    this->fPixmapSmooth = smooth;
+    return this->fPixmap;
+}
+
+
 void
 QTadsImage::drawFromPaintEvent( class CHtmlSysWin* win, class CHtmlRect* pos, htmlimg_draw_mode_t mode )
 {
-    QPainter painter(static_cast<CHtmlSysWinQt*>(win)->widget());
+    this->touch();
+    if (this->isNull()) {
+        return;
+    }
+    QWidget* widget = static_cast<CHtmlSysWinQt*>(win)->widget();
+    QPainter painter(widget);
     if (mode == HTMLIMG_DRAW_CLIP) {
         // Clip mode.  Only draw the part of the image that would fit.  If the
         // image is smaller than pos, adjust the drawing area to avoid scaling.
@@ -41,28 +261,154 @@ QTadsImage::drawFromPaintEvent( class CHtmlSysWin* win, class CHtmlRect* pos, ht
         } else {
             targetHeight = this->height();
         }
-        painter.drawImage(pos->left, pos->top, *this, 0, 0, targetWidth, targetHeight);
+        painter.drawPixmap(pos->left, pos->top, this->cachedPixmap(QImage::size(), 1.0, false), 0, 0,
+                           targetWidth, targetHeight);
         return;
     }
 
     if (mode == HTMLIMG_DRAW_STRETCH) {
         // If the image doesn't fit exactly, scale it. Use the "smooth"
         // transformation mode (which uses a bilinear filter) if enabled in
-        // the settings.
-        Qt::TransformationMode mode = qFrame->settings()->useSmoothScaling ?
-                                      Qt::SmoothTransformation : Qt::FastTransformation;
-        if (this->width() != pos->right - pos->left or this->height() != pos->bottom - pos->top) {
-            painter.drawImage(QPoint(pos->left, pos->top),
-                              this->scaled(pos->right - pos->left, pos->bottom - pos->top,
-                                           Qt::IgnoreAspectRatio, mode));
+        // the settings.  We scale to the screen's resolution rather than to
+        // logical pixels, so that the result stays sharp on high-DPI
+        // displays.
+        const QSize target(pos->right - pos->left, pos->bottom - pos->top);
+        if (target != QImage::size()) {
+#if QT_VERSION >= 0x050600
+            const qreal dpr = widget->devicePixelRatioF();
+#elif QT_VERSION >= 0x050000
+            const qreal dpr = widget->devicePixelRatio();
+#else
+            const qreal dpr = 1.0;
+#endif
+            painter.drawPixmap(QPoint(pos->left, pos->top),
+                               this->cachedPixmap(target, dpr, qFrame->settings()->useSmoothScaling));
         } else {
-            painter.drawImage(QPoint(pos->left, pos->top), *this);
+            painter.drawPixmap(QPoint(pos->left, pos->top), this->cachedPixmap(target, 1.0, false));
         }
         return;
     }
 
     // If we get here, 'mode' must have been HTMLIMG_DRAW_TILE.
     Q_ASSERT(mode == HTMLIMG_DRAW_TILE);
-    QPixmap pix(QPixmap::fromImage(*this));
-    painter.drawTiledPixmap(pos->left, pos->top, pos->right - pos->left, pos->bottom - pos->top, pix);
+    painter.drawTiledPixmap(pos->left, pos->top, pos->right - pos->left, pos->bottom - pos->top,
+                            this->cachedPixmap(QImage::size(), 1.0, false));
+}
+
+
+/* --------------------------------------------------------------------
+ * QTadsImagePrefetcher
+ */
+QMutex QTadsImagePrefetcher::fMutex;
+QWaitCondition QTadsImagePrefetcher::fDoneCond;
+QHash<QString, QTadsImagePrefetcher::Entry> QTadsImagePrefetcher::fEntries;
+
+
+/* A background decode job.  Runs on the global thread pool.
+ */
+class QTadsImagePrefetcher::Job: public QRunnable {
+  private:
+    QString fKey;
+    QString fFilename;
+    unsigned long fSeekpos;
+    unsigned long fSize;
+    QByteArray fFormat;
+
+  public:
+    Job( const QString& key, const QString& filename, unsigned long seekpos, unsigned long size,
+         const char* format )
+        : fKey(key),
+          fFilename(filename),
+          fSeekpos(seekpos),
+          fSize(size),
+          fFormat(format)
+    { }
+
+    void
+    run() override
+    {
+        QImage image;
+        const QTadsResourceData data(this->fFilename, this->fSeekpos, this->fSize);
+        if (data.isValid()) {
+            image.loadFromData(reinterpret_cast<const uchar*>(data.data()),
+                               static_cast<int>(data.size()), this->fFormat.constData());
+        }
+
+        QMutexLocker lock(&QTadsImagePrefetcher::fMutex);
+        QHash<QString, Entry>::iterator it = QTadsImagePrefetcher::fEntries.find(this->fKey);
+        if (it != QTadsImagePrefetcher::fEntries.end()) {
+            it->image = image;
+            it->done = true;
+        }
+        QTadsImagePrefetcher::fDoneCond.wakeAll();
+    }
+};
+
+
+QString
+QTadsImagePrefetcher::key( const QString& filename, unsigned long seekpos, unsigned long size )
+{
+    return filename + QChar(0) + QString::number(seekpos) + QChar(0) + QString::number(size);
+}
+
+
+void
+QTadsImagePrefetcher::prefetch( const QString& filename, unsigned long seekpos, unsigned long size,
+                                const char* format )
+{
+    const QString& k = key(filename, seekpos, size);
+    QMutexLocker lock(&fMutex);
+    if (fEntries.contains(k)) {
+        return;
+    }
+
+    // Drop finished images that nobody asked for, if we're holding too many.
+    if (fEntries.size() >= kMaxEntries) {
+        QHash<QString, Entry>::iterator it = fEntries.begin();
+        while (it != fEntries.end()) {
+            if (it->done) {
+                it = fEntries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (fEntries.size() >= kMaxEntries) {
+            return;
+        }
+    }
+
+    Entry& entry = fEntries[k];
+    entry.done = false;
+    QThreadPool::globalInstance()->start(new Job(k, filename, seekpos, size, format));
+}
+
+
+bool
+QTadsImagePrefetcher::take( const QString& filename, unsigned long seekpos, unsigned long size,
+                            QImage* image )
+{
+    const QString& k = key(filename, seekpos, size);
+    QMutexLocker lock(&fMutex);
+    QHash<QString, Entry>::iterator it = fEntries.find(k);
+    if (it == fEntries.end()) {
+        return false;
+    }
+    while (not it->done) {
+        fDoneCond.wait(&fMutex);
+        // The hash may have been modified while we were waiting.
+        it = fEntries.find(k);
+    }
+    *image = it->image;
+    fEntries.erase(it);
+    return not image->isNull();
+}
+
+
+bool
+QTadsImagePrefetcher::isPending( const QString& filename, unsigned long seekpos, unsigned long size )
+{
+    const QString& k = key(filename, seekpos, size);
+    QMutexLocker lock(&fMutex);
+    QHash<QString, Entry>::const_iterator it = fEntries.constFind(k);
+    return it != fEntries.constEnd() and not it->done;
 }
@@ -17,29 +17,220 @@
 #ifndef QTADSIMAGE_H
 #define QTADSIMAGE_H
 
+#include <QHash>
 #include <QImage>
+#include <QPixmap>
+#include <QMutex>
+#include <QWaitCondition>
 
 #include "htmlsys.h"
 
 
 /* We handle all types of images the same way, so we implement that handling
  * in this class and derive the various CHtmlSysImage* classes from this one.
+ *
+ * Images that know where their data came from (see setSource()) are subject
+ * to the image memory budget.  They're kept in a list ordered by when they
+ * were last drawn, and when the decoded images in memory add up to more than
+ * the budget, the least recently drawn ones drop their pixel data.  They keep
+ * their size, so layout doesn't change, and are decoded again from the game
+ * file the next time they're drawn.
  */
 class QTadsImage: public QImage {
+  private:
+    // Where the image data came from; fFormat is empty if we don't know.
+    QString fSrcFile;
+    unsigned long fSrcPos;
+    unsigned long fSrcSize;
+    QByteArray fFormat;
+
+    // Our size, which we remember even while our pixels are dropped.
+    int fWidth;
+    int fHeight;
+
+    // Bytes counted against the budget; 0 while our pixels are dropped.
+    qint64 fBytes;
+
+    // The image the way we last drew it, scaled to fPixmap.size() device
+    // pixels.  Images are nearly always drawn the same way each time, so
+    // repaints can blit this instead of scaling and converting the QImage
+    // again.  Dropped together with our pixels.
+    QPixmap fPixmap;
+    qreal fPixmapDpr;
+    bool fPixmapSmooth;
+
+    // Get a pixmap of the image for drawing into an area of 'size' logical
+    // pixels at the given device pixel ratio, rendering it if the cached one
+    // doesn't fit.
+    const QPixmap&
+    cachedPixmap( const QSize& size, qreal dpr, bool smooth );
+
+    // Links in the list of images in memory, most recently drawn first.
+    QTadsImage* fLruPrev;
+    QTadsImage* fLruNext;
+
+    static QTadsImage* fLruHead;
+    static QTadsImage* fLruTail;
+
+    // Usage statistics.
+    static qint64 fBytesUsed;
+    static int fImageCount;
+    static int fEvictions;
+    static int fReloads;
+
+    void
+    lruLink();
+
+    void
+    lruUnlink();
+
+    // Drop our pixel data.
+    void
+    evict();
+
+    // Drop the least recently drawn images until we're within the budget.
+    // 'keep' is never dropped.
+    static void
+    enforceBudget( const QTadsImage* keep );
+
   public:
     QTadsImage()
+    : fSrcPos(0), fSrcSize(0), fWidth(0), fHeight(0), fBytes(0), fPixmapDpr(1.0), fPixmapSmooth(false),
+      fLruPrev(0), fLruNext(0)
     { }
 
     QTadsImage( const QImage& qImg )
-    : QImage(qImg)
+    : QImage(qImg), fSrcPos(0), fSrcSize(0), fWidth(0), fHeight(0), fBytes(0), fPixmapDpr(1.0),
+      fPixmapSmooth(false), fLruPrev(0), fLruNext(0)
     { }
 
+    ~QTadsImage();
+
+    // Record where the (already loaded) image data came from.  This makes
+    // the image subject to the image memory budget.
+    void
+    setSource( const QString& filename, unsigned long seekpos, unsigned long size,
+               const QByteArray& format );
+
+    // Set up the image as a placeholder of the given dimensions for data
+    // that's still being decoded in the background.  The image starts out
+    // without pixels, the same as if the budget had dropped them, and picks
+    // up the decoded result the first time it's drawn.
+    void
+    setPendingSource( const QString& filename, unsigned long seekpos, unsigned long size,
+                      const QByteArray& format, const QSize& dimensions );
+
+    // Make sure the pixel data is in memory, decoding it again if it was
+    // dropped, and mark the image as recently used.  Call this before using
+    // the image as a QImage.
+    void
+    touch();
+
+    int
+    width() const
+    { return this->fFormat.isEmpty() ? QImage::width() : this->fWidth; }
+
+    int
+    height() const
+    { return this->fFormat.isEmpty() ? QImage::height() : this->fHeight; }
+
     // A call to this method is only allowed to happen from inside
     // QTadsDisplayWidget::paintEvent().  This always happens indirectly
     // through CHtmlFormatter::draw(), which QTadsDisplayWidget::painEvent() is
     // using to repaint the window.
     void
     drawFromPaintEvent( CHtmlSysWin* win, class CHtmlRect* pos, htmlimg_draw_mode_t mode );
+
+    // Image memory statistics.
+    static qint64
+    bytesUsed()
+    { return fBytesUsed; }
+
+    static int
+    imageCount()
+    { return fImageCount; }
+
+    static int
+    evictionCount()
+    { return fEvictions; }
+
+    static int
+    reloadCount()
+    { return fReloads; }
+
+    // The budget in bytes, or 0 if there's no limit.
+    static qint64
+    budgetBytes();
+
+    // Count memory that isn't held by a QTadsImage, such as cached animation
+    // frames, against the budget.  reserveBytes() drops the least recently
+    // drawn images to make room, and returns false without reserving
+    // anything if that isn't enough.
+    static bool
+    reserveBytes( qint64 bytes );
+
+    static void
+    releaseBytes( qint64 bytes )
+    { fBytesUsed -= bytes; }
+};
+
+
+/* Decodes images in the background ahead of their use.
+ *
+ * When the HTML parser sees an <IMG> tag, the frame passes the location of
+ * the image data to prefetch(), which queues a decode job on the global
+ * thread pool.  When the formatter later gets to the tag and the image is
+ * loaded, the loader calls take() to pick up the decoded image, waiting for
+ * the job to finish if it's still running.  Several images in the same
+ * batch of output thus decode in parallel, and overlap with parsing and
+ * formatting, instead of one after the other on the GUI thread.
+ *
+ * Images are identified by file name, offset and size, which is everything
+ * the loader gets to go on.  Images that are prefetched but never taken
+ * (because graphics are turned off, for instance) are dropped once we hold
+ * more than kMaxEntries of them.
+ *
+ * If the loader gets to an image while its job is still running, it doesn't
+ * wait.  It reads just the image header for the dimensions, so layout can
+ * go on, and the placeholder image picks up the pixels when it's first
+ * painted.
+ */
+class QTadsImagePrefetcher {
+  private:
+    enum { kMaxEntries = 32 };
+
+    struct Entry {
+        bool done;
+        QImage image;
+    };
+
+    class Job;
+    friend class Job;
+
+    static QMutex fMutex;
+    static QWaitCondition fDoneCond;
+    static QHash<QString, Entry> fEntries;
+
+    static QString
+    key( const QString& filename, unsigned long seekpos, unsigned long size );
+
+  public:
+    // Start decoding an image in the background.  'format' is an image
+    // format name as accepted by QImage ("JPG", "PNG".)
+    static void
+    prefetch( const QString& filename, unsigned long seekpos, unsigned long size,
+              const char* format );
+
+    // If the image was prefetched, wait for its decoding to finish, store it
+    // in 'image', and return true.  Returns false if the image wasn't
+    // prefetched or couldn't be decoded, in which case the caller should
+    // load it itself.
+    static bool
+    take( const QString& filename, unsigned long seekpos, unsigned long size, QImage* image );
+
+    // Is the image queued or being decoded, but not finished yet?
+    static bool
+    isPending( const QString& filename, unsigned long seekpos, unsigned long size );
 };
 
 
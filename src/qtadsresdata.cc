@@ -0,0 +1,199 @@
+/* Copyright (C) 2013 Nikos Chantziaras.
+ *
+ * This file is part of the QTads program.  This program is free software; you
+ * can redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation; either version
+ * 2, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; see the file COPYING.  If not, write to the Free Software
+ * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#include <QDebug>
+#include <QFileInfo>
+
+#ifndef Q_OS_ANDROID
+#include <SDL.h>
+#endif
+
+#include "qtadsresdata.h"
+
+
+QTadsResourceData::QTadsResourceData( const textchar_t* filename, unsigned long seekpos,
+                                      unsigned long size )
+    : fFile(fnameToQStr(filename)),
+      fMap(0),
+      fSize(size)
+{
+    this->load(seekpos);
+}
+
+
+QTadsResourceData::QTadsResourceData( const QString& filename, unsigned long seekpos,
+                                      unsigned long size )
+    : fFile(filename),
+      fMap(0),
+      fSize(size)
+{
+    this->load(seekpos);
+}
+
+
+void
+QTadsResourceData::load( unsigned long seekpos )
+{
+    const unsigned long size = this->fSize;
+    if (size == 0) {
+        qWarning() << "ERROR: Empty resource in file" << this->fFile.fileName();
+        return;
+    }
+    if (not this->fFile.open(QIODevice::ReadOnly)) {
+        qWarning() << "ERROR: Can't open file" << this->fFile.fileName();
+        return;
+    }
+
+    // Map the resource if we can.  QFile takes care of aligning the mapping
+    // to a page boundary.
+    this->fMap = this->fFile.map(seekpos, size);
+    if (this->fMap != 0) {
+        return;
+    }
+
+    // Mapping isn't available; read the data instead.
+    if (not this->fFile.seek(seekpos)) {
+        qWarning() << "ERROR: Can't seek in file" << this->fFile.fileName();
+        this->fFile.close();
+        return;
+    }
+    this->fCopy = this->fFile.read(size);
+    this->fFile.close();
+    if (static_cast<unsigned long>(this->fCopy.size()) < size) {
+        qWarning() << "ERROR: Could not read" << size << "bytes from file" << this->fFile.fileName();
+        this->fCopy.clear();
+    }
+}
+
+
+QTadsResourceData::~QTadsResourceData()
+{
+    // Closing the file also removes the mapping.
+    this->fFile.close();
+}
+
+
+#ifndef Q_OS_ANDROID
+/* State of a resource RWops: the open file, and the resource's location in
+ * it.  Positions seen through the RWops are relative to the resource.
+ */
+struct ResourceRWopsState {
+    QFile file;
+    qint64 base;
+    qint64 size;
+};
+
+
+static ResourceRWopsState*
+rwState( SDL_RWops* context )
+{
+    return static_cast<ResourceRWopsState*>(context->hidden.unknown.data1);
+}
+
+
+static int
+rwSeek( SDL_RWops* context, int offset, int whence )
+{
+    ResourceRWopsState* st = rwState(context);
+    qint64 pos;
+    switch (whence) {
+      case RW_SEEK_SET: pos = offset; break;
+      case RW_SEEK_CUR: pos = st->file.pos() - st->base + offset; break;
+      case RW_SEEK_END: pos = st->size + offset; break;
+      default:
+        SDL_SetError("Unknown value for 'whence'");
+        return -1;
+    }
+    if (pos < 0 or pos > st->size) {
+        SDL_SetError("Seek outside of resource");
+        return -1;
+    }
+    if (not st->file.seek(st->base + pos)) {
+        SDL_SetError("Can't seek in resource file");
+        return -1;
+    }
+    return static_cast<int>(pos);
+}
+
+
+static int
+rwRead( SDL_RWops* context, void* ptr, int size, int maxnum )
+{
+    ResourceRWopsState* st = rwState(context);
+    if (size <= 0 or maxnum <= 0) {
+        return 0;
+    }
+
+    // Don't read past the end of the resource.
+    qint64 avail = st->size - (st->file.pos() - st->base);
+    qint64 num = qMin(static_cast<qint64>(maxnum), avail / size);
+    if (num <= 0) {
+        return 0;
+    }
+    qint64 got = st->file.read(static_cast<char*>(ptr), num * size);
+    if (got < 0) {
+        SDL_SetError("Can't read from resource file");
+        return -1;
+    }
+    return static_cast<int>(got / size);
+}
+
+
+static int
+rwWrite( SDL_RWops*, const void*, int, int )
+{
+    SDL_SetError("Resources are read-only");
+    return -1;
+}
+
+
+static int
+rwClose( SDL_RWops* context )
+{
+    delete rwState(context);
+    SDL_FreeRW(context);
+    return 0;
+}
+
+
+SDL_RWops*
+createResourceRWops( const textchar_t* filename, unsigned long seekpos, unsigned long size )
+{
+    ResourceRWopsState* st = new ResourceRWopsState;
+    st->file.setFileName(fnameToQStr(filename));
+    st->base = seekpos;
+    st->size = size;
+    if (not st->file.open(QIODevice::ReadOnly) or not st->file.seek(st->base)) {
+        qWarning() << "ERROR: Can't open file" << st->file.fileName() << "at offset" << seekpos;
+        delete st;
+        return 0;
+    }
+
+    SDL_RWops* rw = SDL_AllocRW();
+    if (rw == 0) {
+        qWarning() << "ERROR:" << SDL_GetError();
+        SDL_ClearError();
+        delete st;
+        return 0;
+    }
+    rw->seek = rwSeek;
+    rw->read = rwRead;
+    rw->write = rwWrite;
+    rw->close = rwClose;
+    rw->hidden.unknown.data1 = st;
+    return rw;
+}
+#endif
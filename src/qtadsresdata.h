@@ -0,0 +1,86 @@
+/* Copyright (C) 2013 Nikos Chantziaras.
+ *
+ * This file is part of the QTads program.  This program is free software; you
+ * can redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation; either version
+ * 2, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; see the file COPYING.  If not, write to the Free Software
+ * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef QTADSRESDATA_H
+#define QTADSRESDATA_H
+
+#include <QByteArray>
+#include <QFile>
+
+#include "htmlsys.h"
+#include "config.h"
+
+
+/* The bytes of one resource inside a game or resource file.
+ *
+ * Whenever possible, the resource is memory-mapped straight from the file, so
+ * that decoders read it in place instead of from a copy of the data in a
+ * QByteArray.  If the file can't be mapped, the data is read into memory
+ * instead.  Either way, the data remains valid as long as this object exists.
+ */
+class QTadsResourceData {
+  private:
+    QFile fFile;
+    uchar* fMap;
+    QByteArray fCopy;
+    unsigned long fSize;
+
+    void
+    load( unsigned long seekpos );
+
+    // Not copyable.
+    QTadsResourceData( const QTadsResourceData& );
+    QTadsResourceData& operator =( const QTadsResourceData& );
+
+  public:
+    // Load 'size' bytes at offset 'seekpos' of the given file.  On failure, a
+    // warning is printed and isValid() returns false.
+    QTadsResourceData( const textchar_t* filename, unsigned long seekpos, unsigned long size );
+
+    // Same, with the file name already translated to a QString.  This one
+    // can be used from any thread.
+    QTadsResourceData( const QString& filename, unsigned long seekpos, unsigned long size );
+
+    ~QTadsResourceData();
+
+    bool
+    isValid() const
+    { return this->fMap != 0 or not this->fCopy.isEmpty(); }
+
+    const char*
+    data() const
+    { return this->fMap != 0 ? reinterpret_cast<const char*>(this->fMap) : this->fCopy.constData(); }
+
+    unsigned long
+    size() const
+    { return this->fSize; }
+};
+
+
+#ifndef Q_OS_ANDROID
+/* Creates an SDL_RWops that streams 'size' bytes at offset 'seekpos' of the
+ * given file, reading them from the file as the decoder asks for them.  This
+ * is meant for decoders that keep reading for as long as a sound is playing,
+ * like music, so that the resource doesn't have to be held in memory.
+ * Closing the RWops (SDL_RWclose()) closes the file and frees the RWops.
+ * Returns 0 if the file can't be opened.
+ */
+struct SDL_RWops*
+createResourceRWops( const textchar_t* filename, unsigned long seekpos, unsigned long size );
+#endif
+
+
+#endif
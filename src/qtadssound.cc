@@ -14,9 +14,16 @@
  * this program; see the file COPYING.  If not, write to the Free Software
  * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
+#include <QDateTime>
 #include <QDebug>
 #include <QFileInfo>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QRunnable>
+#include <QThreadPool>
 #include <QTimer>
+#include <QWaitCondition>
 
 #ifndef Q_OS_ANDROID
 #include <SDL_mixer.h>
@@ -24,6 +31,7 @@
 #endif
 
 #include "qtadssound.h"
+#include "qtadsresdata.h"
 #include "globals.h"
 #include "sysframe.h"
 #include "settings.h"
@@ -31,12 +39,272 @@
 #include "syssoundogg.h"
 #include "syssoundmpeg.h"
 #include "syssoundmidi.h"
+#include "startupprofiler.h"
+#include "vmtrace.h"
 
 
-bool
-initSound()
+#ifndef Q_OS_ANDROID
+/* Cache of decoded sounds.
+ *
+ * Each sound object plays its own Mix_Chunk (so that volume and the
+ * channel bookkeeping stay per object), but the chunks for the same resource
+ * all point at one shared buffer of decoded samples.  The buffer is kept
+ * after the last sound using it is deleted, as long as the idle buffers fit
+ * in the configured cache size, so that a game replaying the same effect
+ * doesn't decode it again each time.
+ */
+namespace {
+
+struct DecodedSound {
+    QString key;
+    // The chunk the samples were decoded into; owns the buffer.
+    Mix_Chunk* master;
+    // Number of sound objects currently using the buffer.
+    int refs;
+};
+
+// Decoded sounds by resource, and by sample buffer (which is how a sound
+// object finds its entry again when it's deleted.)
+QHash<QString, DecodedSound*> decodedByKey;
+QHash<const Uint8*, DecodedSound*> decodedByBuffer;
+
+// Entries nobody is using, least recently used first, and the memory they
+// take up.
+QList<DecodedSound*> idleDecoded;
+qint64 idleDecodedBytes = 0;
+
+void
+freeDecoded( DecodedSound* entry )
+{
+    decodedByKey.remove(entry->key);
+    decodedByBuffer.remove(entry->master->abuf);
+    // Free the sample buffer if SDL_mixer didn't allocate it itself.
+    if (not entry->master->allocated) {
+        free(entry->master->abuf);
+    }
+    Mix_FreeChunk(entry->master);
+    delete entry;
+}
+
+// Drop idle entries until they fit in the cache.
+void
+trimDecoded()
+{
+    const qint64 limit = static_cast<qint64>(qMax(qFrame->settings()->soundCacheSize, 0)) * 1024 * 1024;
+    while (idleDecodedBytes > limit and not idleDecoded.isEmpty()) {
+        DecodedSound* entry = idleDecoded.takeFirst();
+        idleDecodedBytes -= entry->master->alen;
+        freeDecoded(entry);
+    }
+}
+
+// Make a new chunk for a sound object playing the entry's samples.
+Mix_Chunk*
+chunkForDecoded( DecodedSound* entry )
+{
+    if (entry->refs == 0) {
+        idleDecoded.removeOne(entry);
+        idleDecodedBytes -= entry->master->alen;
+    }
+    Mix_Chunk* chunk = Mix_QuickLoad_RAW(entry->master->abuf, entry->master->alen);
+    if (chunk == 0) {
+        qWarning() << "ERROR:" << Mix_GetError();
+        Mix_SetError("");
+        if (entry->refs == 0) {
+            idleDecoded.append(entry);
+            idleDecodedBytes += entry->master->alen;
+            trimDecoded();
+        }
+        return 0;
+    }
+    ++entry->refs;
+    return chunk;
+}
+
+// Look up an already decoded sound.
+Mix_Chunk*
+findDecoded( const QString& key )
+{
+    DecodedSound* entry = decodedByKey.value(key);
+    return entry != 0 ? chunkForDecoded(entry) : 0;
+}
+
+// Enter a newly decoded sound into the cache and get a chunk for playing it.
+Mix_Chunk*
+addDecoded( const QString& key, Mix_Chunk* master )
+{
+    DecodedSound* entry = new DecodedSound;
+    entry->key = key;
+    entry->master = master;
+    entry->refs = 0;
+    decodedByKey.insert(key, entry);
+    decodedByBuffer.insert(master->abuf, entry);
+    idleDecoded.append(entry);
+    idleDecodedBytes += master->alen;
+    return chunkForDecoded(entry);
+}
+
+// A sound object is done with its chunk.
+void
+releaseDecoded( Mix_Chunk* chunk )
+{
+    DecodedSound* entry = decodedByBuffer.value(chunk->abuf);
+    Mix_FreeChunk(chunk);
+    if (entry == 0 or --entry->refs > 0) {
+        return;
+    }
+    idleDecoded.append(entry);
+    idleDecodedBytes += entry->master->alen;
+    trimDecoded();
+}
+
+
+/* Sounds being decoded in the background.
+ *
+ * The parser asks for a sound to be prefetched as soon as it sees the
+ * <SOUND> tag, and a job on the global thread pool decodes the samples while
+ * the formatter catches up.  createSound() then takes the samples (waiting
+ * for the job if it's still running) instead of decoding them itself, so
+ * sounds still start in the order the formatter plays them.  Only the raw
+ * samples are produced in the background; wrapping them into a chunk uses
+ * SDL_mixer, which we only call from the GUI thread.
+ */
+struct PrefetchedSound {
+    bool done;
+    Uint8* buf;
+    Uint32 len;
+};
+
+// Maximum number of decoded sounds we hold that nobody asked for yet.
+const int kMaxPrefetched = 8;
+
+QMutex prefetchMutex;
+QWaitCondition prefetchDone;
+QHash<QString, PrefetchedSound> prefetched;
+// Number of jobs that haven't finished yet.
+int prefetchJobs = 0;
+
+// Wait for all background decodes to finish and discard their results.
+void
+flushPrefetched()
 {
+    QMutexLocker lock(&prefetchMutex);
+    while (prefetchJobs > 0) {
+        prefetchDone.wait(&prefetchMutex);
+    }
+    for (QHash<QString, PrefetchedSound>::iterator it = prefetched.begin(); it != prefetched.end(); ++it) {
+        free(it->buf);
+    }
+    prefetched.clear();
+}
+
+/* Mixer channel bookkeeping.
+ *
+ * We start out with kMinChannels mixer channels and double the pool when
+ * all of them are busy, up to kMaxChannels.  Past that, a new sound takes
+ * the channel of the oldest sound in the least important layer that's less
+ * important than its own.  For tuning, we count what happens in each layer
+ * and measure how long it takes from asking SDL_mixer to play a sound until
+ * the mixer first mixes it.
+ */
+const int kMinChannels = 16;
+const int kMaxChannels = 128;
+const int kLayerCount = 4;
+
+struct LayerStats {
+    int started;
+    int stolen;
+    int dropped;
+    int measured;
+    Uint32 latencySum;
+    Uint32 latencyMax;
+};
+
+// The latency numbers are updated from the audio thread.
+QMutex layerStatsMutex;
+LayerStats layerStats[kLayerCount];
+
+int
+layerIndex( int pri )
+{
+    return qBound(0, pri, kLayerCount - 1);
+}
+
+struct LatencyProbe {
+    Uint32 requested;
+    int layer;
+    bool seen;
+};
+
+// SDL_mixer effect that notes when a channel is first mixed.  It leaves the
+// audio untouched.
+void
+latencyEffect( int, void*, int, void* udata )
+{
+    LatencyProbe* probe = static_cast<LatencyProbe*>(udata);
+    if (probe->seen) {
+        return;
+    }
+    probe->seen = true;
+    const Uint32 latency = SDL_GetTicks() - probe->requested;
+    QMutexLocker lock(&layerStatsMutex);
+    LayerStats& stats = layerStats[probe->layer];
+    ++stats.measured;
+    stats.latencySum += latency;
+    stats.latencyMax = qMax(stats.latencyMax, latency);
+}
+
+// SDL_mixer removes effects when the channel stops.
+void
+latencyEffectDone( int, void* udata )
+{
+    delete static_cast<LatencyProbe*>(udata);
+}
+
+// The key by which we know a decoded sound.  The file's modification time is
+// part of the key, so that a game file that was replaced (by recompiling it,
+// for instance) doesn't play stale sounds.
+QString
+soundKey( const QString& fname, unsigned long seekpos, unsigned long filesize, QTadsSound::SoundType type )
+{
+    return fname + QChar(0) + QString::number(seekpos) + QChar(0) + QString::number(filesize) + QChar(0)
+           + QString::number(type) + QChar(0) + QString::number(QFileInfo(fname).lastModified().toTime_t());
+}
+
+} // namespace
+#endif
+
+
+// Free all cached sounds that aren't in use.
+static void
+flushDecodedSounds()
+{
+#ifndef Q_OS_ANDROID
+    flushPrefetched();
+    while (not idleDecoded.isEmpty()) {
+        DecodedSound* entry = idleDecoded.takeFirst();
+        freeDecoded(entry);
+    }
+    idleDecodedBytes = 0;
+#endif
+}
+
+
 #ifndef Q_OS_ANDROID
+// Whether we tried to initialize the sound system yet, and whether that
+// worked.
+static bool soundInitTried = false;
+static bool soundInitOk = false;
+#endif
+
+
+// Initializes SDL audio, SDL_sound and SDL_mixer.
+static bool
+initSoundNow()
+{
+#ifndef Q_OS_ANDROID
+    QTadsStartupPhase phase("sound init");
+
     if (SDL_Init(SDL_INIT_AUDIO) != 0) {
         qWarning("Unable to initialize sound system: %s", SDL_GetError());
         return false;
@@ -58,11 +326,16 @@ initSound()
     }
 #endif
 
-    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) != 0) {
+    // SDL wants the buffer size to be a power of two.
+    int bufSize = 256;
+    while (bufSize < qBound(256, qFrame->settings()->audioBufferSize, 8192)) {
+        bufSize *= 2;
+    }
+    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, bufSize) != 0) {
         qWarning("Unable to initialize audio mixer: %s", Mix_GetError());
         return false;
     }
-    Mix_AllocateChannels(16);
+    Mix_AllocateChannels(kMinChannels);
     Mix_ChannelFinished(QTadsSound::callback);
     Mix_HookMusicFinished(CHtmlSysSoundMidiQt::callback);
 
@@ -104,12 +377,82 @@ initSound()
 }
 
 
+QString
+soundLayerStats()
+{
+    QString text;
+#ifndef Q_OS_ANDROID
+    static const char* const names[kLayerCount] = { "background", "bgambient", "ambient", "foreground" };
+    QMutexLocker lock(&layerStatsMutex);
+    for (int i = kLayerCount - 1; i >= 0; --i) {
+        const LayerStats& stats = layerStats[i];
+        if (stats.started == 0 and stats.dropped == 0) {
+            continue;
+        }
+        if (not text.isEmpty()) {
+            text += QChar::fromLatin1('\n');
+        }
+        text += QObject::tr("%1: %2 started, %3 stolen, %4 dropped, latency avg %5 ms, max %6 ms")
+                .arg(QString::fromLatin1(names[i])).arg(stats.started).arg(stats.stolen).arg(stats.dropped)
+                .arg(stats.measured > 0 ? stats.latencySum / stats.measured : 0).arg(stats.latencyMax);
+    }
+#endif
+    return text;
+}
+
+
+qint64
+decodedSoundBytes()
+{
+#ifndef Q_OS_ANDROID
+    qint64 bytes = 0;
+    for (QHash<QString, DecodedSound*>::const_iterator it = decodedByKey.constBegin();
+         it != decodedByKey.constEnd(); ++it) {
+        bytes += it.value()->master->alen;
+    }
+    return bytes;
+#else
+    return 0;
+#endif
+}
+
+
+bool
+initSound()
+{
+    // Nothing to do yet.  Opening the audio device takes hundreds of
+    // milliseconds on some systems, and many games never play a sound, so we
+    // wait until the game asks for one (see ensureSound()).
+    return true;
+}
+
+
+bool
+ensureSound()
+{
+#ifndef Q_OS_ANDROID
+    if (not soundInitTried) {
+        soundInitTried = true;
+        soundInitOk = initSoundNow();
+    }
+    return soundInitOk;
+#else
+    return false;
+#endif
+}
+
+
 void
 quitSound()
 {
 #ifndef Q_OS_ANDROID
+    // If no sound was ever requested, there's nothing to shut down.
+    if (not soundInitTried) {
+        return;
+    }
     Mix_ChannelFinished(0);
     Mix_HookMusicFinished(0);
+    flushDecodedSounds();
     // Close the audio device as many times as it was opened.
     // We disable this for now since it results in a crash in some systems.
     // It looks like a clash between SDL_mixer and SDL_sound.
@@ -141,7 +484,8 @@ QTadsSound::QTadsSound( QObject* parent, Mix_Chunk* chunk, SoundType type )
       fDone_func(0),
       fDone_func_ctx(0),
       fRepeats(0),
-      fRepeatsWanted(1)
+      fRepeatsWanted(1),
+      fPriority(0)
 {
     // FIXME: Calculate sound length in a safer way.
     this->fLength = (this->fChunk->alen * 8) / (2 * 16 * 44.1);
@@ -177,11 +521,8 @@ QTadsSound::~QTadsSound()
             SDL_Delay(10);
         }
     }
-    // Free the raw audio data buffer if SDL_mixer didn't allocate it itself.
-    if (not this->fChunk->allocated) {
-        free(this->fChunk->abuf);
-    }
-    Mix_FreeChunk(this->fChunk);
+    // Our chunk shares its samples with the decoded sound cache.
+    releaseDecoded(this->fChunk);
 }
 
 
@@ -206,7 +547,17 @@ void
 QTadsSound::fDoLoop()
 {
     // When playing again, we can't assume that we can use the same channel.
-    this->fChannel = Mix_PlayChannel(-1, this->fChunk, 0);
+    this->fChannel = this->fPlayOnChannel(0, false);
+    if (this->fChannel == -1) {
+        // No channel is free for another iteration; we're done.
+        Mix_SetError("");
+        QTadsSound::fObjList.removeOne(this);
+        this->fPlaying = false;
+        if (this->fDone_func) {
+            this->fDone_func(this->fDone_func_ctx, this->fRepeats);
+        }
+        return;
+    }
     this->fTimePos.start();
     ++this->fRepeats;
 
@@ -218,6 +569,92 @@ QTadsSound::fDoLoop()
 }
 
 
+int
+QTadsSound::fPlayOnChannel( int fadeIn, bool firstPlay )
+{
+    const Uint32 requested = SDL_GetTicks();
+    const int layer = layerIndex(this->fPriority);
+    int channel = -1;
+    void (*stolenDone)(void*, int) = 0;
+    void* stolenDoneCtx = 0;
+    int stolenRepeats = 0;
+
+    // If all channels are busy, grow the pool.  Once it's as large as we
+    // allow, take over the channel of the oldest sound in the least
+    // important layer below ours.
+    const int allocated = Mix_AllocateChannels(-1);
+    if (Mix_Playing(-1) >= allocated) {
+        if (allocated < kMaxChannels) {
+            Mix_AllocateChannels(qMin(allocated * 2, kMaxChannels));
+        } else {
+            QTadsSound* victim = 0;
+            for (int i = 0; i < fObjList.size(); ++i) {
+                QTadsSound* obj = fObjList.at(i);
+                if (obj->fPlaying and obj->fPriority < this->fPriority
+                    and (victim == 0 or obj->fPriority < victim->fPriority)) {
+                    victim = obj;
+                }
+            }
+            if (victim != 0) {
+                // Halt the victim ourselves rather than playing over it.
+                // SDL_mixer runs the channel-finished callback right away,
+                // from inside its own lock, so the victim must not be found
+                // there; its done callback runs once we're finished with the
+                // mixer.
+                fObjList.removeOne(victim);
+                victim->fPlaying = false;
+                victim->fFadeOutTimer->stop();
+                stolenDone = victim->fDone_func;
+                stolenDoneCtx = victim->fDone_func_ctx;
+                stolenRepeats = victim->fRepeats;
+                victim->fDone_func = 0;
+                victim->fDone_func_ctx = 0;
+                channel = victim->fChannel;
+                victim->fChannel = -1;
+                Mix_HaltChannel(channel);
+                QMutexLocker lock(&layerStatsMutex);
+                ++layerStats[layerIndex(victim->fPriority)].stolen;
+            }
+        }
+    }
+
+    // Lock the mixer so that the latency probe is in place before the
+    // channel can be mixed.
+    SDL_LockAudio();
+    if (fadeIn > 0) {
+        channel = Mix_FadeInChannel(channel, this->fChunk, 0, fadeIn);
+    } else {
+        channel = Mix_PlayChannel(channel, this->fChunk, 0);
+    }
+    if (firstPlay and channel != -1) {
+        LatencyProbe* probe = new LatencyProbe;
+        probe->requested = requested;
+        probe->layer = layer;
+        probe->seen = false;
+        if (Mix_RegisterEffect(channel, latencyEffect, latencyEffectDone, probe) == 0) {
+            delete probe;
+        }
+    }
+    SDL_UnlockAudio();
+
+    // The victim's sound is over.  Its queue may start another sound from
+    // the callback, which is fine now that we're out of the mixer.
+    if (stolenDone != 0) {
+        stolenDone(stolenDoneCtx, stolenRepeats);
+    }
+
+    if (firstPlay) {
+        QMutexLocker lock(&layerStatsMutex);
+        if (channel == -1) {
+            ++layerStats[layer].dropped;
+        } else {
+            ++layerStats[layer].started;
+        }
+    }
+    return channel;
+}
+
+
 void
 QTadsSound::fPrepareFadeOut()
 {
@@ -296,11 +733,7 @@ QTadsSound::startPlaying( void (*done_func)(void*, int repeat_count), void* done
     Mix_VolumeChunk(this->fChunk, vol);
 
     this->fRepeatsWanted = repeat;
-    if (fadeIn > 0) {
-        this->fChannel = Mix_FadeInChannel(-1, this->fChunk, 0, fadeIn);
-    } else {
-        this->fChannel = Mix_PlayChannel(-1, this->fChunk, 0);
-    }
+    this->fChannel = this->fPlayOnChannel(fadeIn, true);
     if (this->fChannel == -1) {
         qWarning() << "ERROR:" << Mix_GetError();
         Mix_SetError("");
@@ -379,99 +812,161 @@ QTadsSound::addCrossFade( int ms )
 #endif
 
 
-CHtmlSysSound*
-QTadsSound::createSound( const CHtmlUrl* /*url*/, const textchar_t* filename, unsigned long seekpos,
-                         unsigned long filesize, CHtmlSysWin*, SoundType type )
 #ifndef Q_OS_ANDROID
+// SDL_sound keeps global state that isn't protected against use from several
+// threads at once, so all decoding through it is serialized.
+static QMutex sdlSoundMutex;
+
+
+/* Decode a WAV or MP3 resource into a buffer of samples in the mixer's
+ * format.  This doesn't use SDL_mixer, so it's safe to call from any thread.
+ * On success, the buffer is allocated with malloc() and belongs to the
+ * caller.
+ */
+static bool
+decodePcm( const QString& filename, unsigned long seekpos, unsigned long filesize, QTadsSound::SoundType type,
+           Uint8** bufOut, Uint32* lenOut )
 {
-    //qDebug() << "Loading sound from" << filename << "offset:" << seekpos << "size:" << filesize
-    //      << "url:" << url->get_url();
+    Q_ASSERT(type == QTadsSound::MPEG or type == QTadsSound::WAV);
 
-    // Check if the file exists and is readable.
-    QFileInfo inf(fnameToQStr(filename));
-    if (not inf.exists() or not inf.isReadable()) {
-        qWarning() << "ERROR:" << inf.filePath() << "doesn't exist or is unreadable";
-        return 0;
+    // Get at the sound data.  This is normally mapped directly from the file,
+    // so the decoders read it in place instead of from a copy.  We decode the
+    // whole sound below, so we don't need the data after this function.
+    const QTadsResourceData data(filename, seekpos, filesize);
+    if (not data.isValid()) {
+        return false;
     }
 
-    // Open the file and seek to the specified position.
-    QFile file(inf.filePath());
-    if (not file.open(QIODevice::ReadOnly)) {
-        qWarning() << "ERROR: Can't open file" << inf.filePath();
-        return 0;
-    }
-    if (not file.seek(seekpos)) {
-        qWarning() << "ERROR: Can't seek in file" << inf.filePath();
-        file.close();
-        return 0;
-    }
-    QByteArray data(file.read(filesize));
-    file.close();
-    if (data.isEmpty() or static_cast<unsigned long>(data.size()) < filesize) {
-        qWarning() << "ERROR: Could not read" << filesize << "bytes from file" << inf.filePath();
-        return 0;
-    }
+    QMutexLocker lock(&sdlSoundMutex);
 
-    // Create the RWops through which the data will be read later.
-    SDL_RWops* rw = SDL_RWFromConstMem(data.constData(), data.size());
+    // Create the RWops through which the data will be read.
+    SDL_RWops* rw = SDL_RWFromConstMem(data.data(), static_cast<int>(data.size()));
     if (rw == 0) {
         qWarning() << "ERROR:" << SDL_GetError();
         SDL_ClearError();
-        return 0;
+        return false;
     }
 
+    Sound_AudioInfo wantedFormat;
+    wantedFormat.channels = 2;
+    wantedFormat.rate = 44100;
+    wantedFormat.format = MIX_DEFAULT_FORMAT;
+    Sound_Sample* sample = Sound_NewSample(rw, type == QTadsSound::WAV ? "WAV" : "MP3", &wantedFormat, 65536);
+    if (sample == 0) {
+        qWarning() << "ERROR:" << Sound_GetError();
+        Sound_ClearError();
+        return false;
+    }
+
+    // Decode the sound a buffer at a time, appending to our own output
+    // buffer.  Sound_DecodeAll() grows its buffer by one decode buffer per
+    // step, which copies the data over and over for long sounds (that's why
+    // we used to need a 6MB decode buffer on Windows), and then we had to
+    // copy the result once more.  Growing the output geometrically keeps
+    // decoding linear, and the only full-size allocation is the one the
+    // chunk ends up owning.
+    Uint8* buf = 0;
+    Uint32 bufLen = 0;
+    Uint32 bufAlloc = 0;
+    while (not (sample->flags & (SOUND_SAMPLEFLAG_EOF | SOUND_SAMPLEFLAG_ERROR))) {
+        const Uint32 len = Sound_Decode(sample);
+        if (len == 0) {
+            break;
+        }
+        if (bufLen + len > bufAlloc) {
+            Uint32 newAlloc = qMax(qMax(bufAlloc * 2, bufLen + len), static_cast<Uint32>(1048576));
+            Uint8* newBuf = static_cast<Uint8*>(realloc(buf, newAlloc));
+            if (newBuf == 0) {
+                qWarning() << "ERROR: Out of memory while decoding sound";
+                free(buf);
+                Sound_FreeSample(sample);
+                return false;
+            }
+            buf = newBuf;
+            bufAlloc = newAlloc;
+        }
+        memcpy(buf + bufLen, sample->buffer, len);
+        bufLen += len;
+    }
+    if (sample->flags & SOUND_SAMPLEFLAG_ERROR) {
+        // We don't abort since some of these errors can be non-fatal.
+        // Unfortunately, there's no way to tell :-/
+        qWarning() << "WARNING:" << Sound_GetError();
+        Sound_ClearError();
+    }
+    Sound_FreeSample(sample);
+    if (buf == 0) {
+        qWarning() << "ERROR: Sound contains no audio data";
+        return false;
+    }
+    // Give back the slack from the last doubling.
+    if (bufLen < bufAlloc) {
+        Uint8* newBuf = static_cast<Uint8*>(realloc(buf, bufLen));
+        if (newBuf != 0) {
+            buf = newBuf;
+        }
+    }
+    *bufOut = buf;
+    *lenOut = bufLen;
+    return true;
+}
+
+
+/* Wrap decoded samples into a Mix_Chunk that owns them.  Frees the samples
+ * and returns 0 on error.
+ */
+static Mix_Chunk*
+chunkFromPcm( Uint8* buf, Uint32 len )
+{
+    Mix_Chunk* chunk = Mix_QuickLoad_RAW(buf, len);
+    if (chunk == 0) {
+        qWarning() << "ERROR:" << Mix_GetError();
+        Mix_SetError("");
+        free(buf);
+    }
+    return chunk;
+}
+
+
+/* Decode a sound resource into a Mix_Chunk.  Returns 0 on error.
+ */
+static Mix_Chunk*
+decodeSound( const QString& filename, unsigned long seekpos, unsigned long filesize, QTadsSound::SoundType type )
+{
     // The chunk that will hold the final, decoded sound.
     Mix_Chunk* chunk;
 
+    // Check if the file exists and is readable.
+    QFileInfo inf(filename);
+    if (not inf.exists() or not inf.isReadable()) {
+        qWarning() << "ERROR:" << inf.filePath() << "doesn't exist or is unreadable";
+        return 0;
+    }
+
     // If it's an MP3 or WAV, we'll decode it with SDL_sound.  For Ogg Vorbis
     // we use SDL_mixer.  The reason is that SDL_mixer plays WAV at wrong
     // speeds if they're not 11, 22 or 44kHz (like 48kHz or 32kHz) and crashes
     // sometimes with MP3s.  SDL_sound can't cope well with Ogg Vorbis that
     // have more then two channels.
-    if (type == MPEG or type == WAV) {
-        if (rw == 0) {
-            qWarning() << "ERROR:" << SDL_GetError();
-            SDL_ClearError();
+    if (type == QTadsSound::MPEG or type == QTadsSound::WAV) {
+        Uint8* buf;
+        Uint32 len;
+        if (not decodePcm(filename, seekpos, filesize, type, &buf, &len)) {
             return 0;
         }
-        Sound_AudioInfo wantedFormat;
-        wantedFormat.channels = 2;
-        wantedFormat.rate = 44100;
-        wantedFormat.format = MIX_DEFAULT_FORMAT;
-        // Note that we use a large buffer size to speed-up decoding of large
-        // MP3s on Windows; the decoding will take extremely long with small
-        // buffer sizes.
-        Sound_Sample* sample = Sound_NewSample(rw, type == WAV ? "WAV" : "MP3", &wantedFormat,
-#ifdef Q_OS_WIN32
-                                               6291456
-#else
-                                               131072
-#endif
-                                               );
-        if (sample == 0) {
-            qWarning() << "ERROR:" << Sound_GetError();
-            Sound_ClearError();
+        chunk = chunkFromPcm(buf, len);
+    } else {
+        Q_ASSERT(type == QTadsSound::OGG);
+        const QTadsResourceData data(filename, seekpos, filesize);
+        if (not data.isValid()) {
             return 0;
         }
-        Sound_DecodeAll(sample);
-        if (sample->flags & SOUND_SAMPLEFLAG_ERROR) {
-            // We don't abort since some of these errors can be non-fatal.
-            // Unfortunately, there's no way to tell :-/
-            qWarning() << "WARNING:" << Sound_GetError();
-            Sound_ClearError();
-        }
-        Uint8* buf = static_cast<Uint8*>(malloc(sample->buffer_size));
-        memcpy(buf, sample->buffer, sample->buffer_size);
-        Sound_FreeSample(sample);
-        chunk = Mix_QuickLoad_RAW(buf, sample->buffer_size);
-        if (chunk == 0) {
-            qWarning() << "ERROR:" << Mix_GetError();
-            Mix_SetError("");
-            free(buf);
+        SDL_RWops* rw = SDL_RWFromConstMem(data.data(), static_cast<int>(data.size()));
+        if (rw == 0) {
+            qWarning() << "ERROR:" << SDL_GetError();
+            SDL_ClearError();
             return 0;
         }
-    } else {
-        Q_ASSERT(type == OGG);
         chunk = Mix_LoadWAV_RW(rw, true);
         if (chunk == 0) {
             qWarning() << "ERROR:" << Mix_GetError();
@@ -484,7 +979,7 @@ QTadsSound::createSound( const CHtmlUrl* /*url*/, const textchar_t* filename, un
     // since SMPEG, for the piece of crap it is, tends to play MP3s at double
     // speed (chipmunks ahoy...)
 #if 0
-    if (type == MPEG) {
+    if (type == QTadsSound::MPEG) {
         // The sound is an mp3.  We'll decode it into an SDL_Mixer chunk using
         // SMPEG.
         SMPEG* smpeg = SMPEG_new_data(data.data(), data.size(), 0, 0);
@@ -529,6 +1024,172 @@ QTadsSound::createSound( const CHtmlUrl* /*url*/, const textchar_t* filename, un
     }
 #endif
 
+    return chunk;
+}
+#endif
+
+
+#ifndef Q_OS_ANDROID
+/* A background decode job.  Runs on the global thread pool.
+ */
+class SoundPrefetchJob: public QRunnable {
+  private:
+    QString fKey;
+    QString fFilename;
+    unsigned long fSeekpos;
+    unsigned long fSize;
+    QTadsSound::SoundType fType;
+
+  public:
+    SoundPrefetchJob( const QString& key, const QString& filename, unsigned long seekpos, unsigned long size,
+                      QTadsSound::SoundType type )
+        : fKey(key),
+          fFilename(filename),
+          fSeekpos(seekpos),
+          fSize(size),
+          fType(type)
+    { }
+
+    void
+    run() override
+    {
+        Uint8* buf = 0;
+        Uint32 len = 0;
+        if (not decodePcm(this->fFilename, this->fSeekpos, this->fSize, this->fType, &buf, &len)) {
+            buf = 0;
+            len = 0;
+        }
+
+        QMutexLocker lock(&prefetchMutex);
+        PrefetchedSound& entry = prefetched[this->fKey];
+        entry.buf = buf;
+        entry.len = len;
+        entry.done = true;
+        --prefetchJobs;
+        prefetchDone.wakeAll();
+    }
+};
+
+
+// If the sound was prefetched, wait for its decoding to finish and return
+// its samples.  Returns false if it wasn't prefetched or couldn't be
+// decoded, in which case the caller should decode it itself.
+static bool
+takePrefetched( const QString& key, Uint8** buf, Uint32* len )
+{
+    QMutexLocker lock(&prefetchMutex);
+    QHash<QString, PrefetchedSound>::iterator it = prefetched.find(key);
+    if (it == prefetched.end()) {
+        return false;
+    }
+    while (not it->done) {
+        prefetchDone.wait(&prefetchMutex);
+        // The hash may have been modified while we were waiting.
+        it = prefetched.find(key);
+    }
+    *buf = it->buf;
+    *len = it->len;
+    prefetched.erase(it);
+    return *buf != 0;
+}
+#endif
+
+
+void
+QTadsSound::prefetch( const textchar_t* filename, unsigned long seekpos, unsigned long filesize,
+                      SoundType type )
+#ifndef Q_OS_ANDROID
+{
+    if (not qFrame->settings()->enableSoundEffects or (type != WAV and type != MPEG)) {
+        return;
+    }
+
+    // The decoder threads need SDL_sound, so bring up the sound system now,
+    // from the GUI thread.
+    if (not ensureSound()) {
+        return;
+    }
+
+    const QString& fname = fnameToQStr(filename);
+    if (not QFileInfo(fname).isReadable()) {
+        return;
+    }
+    const QString& key = soundKey(fname, seekpos, filesize, type);
+    if (decodedByKey.contains(key)) {
+        return;
+    }
+
+    QMutexLocker lock(&prefetchMutex);
+    if (prefetched.contains(key)) {
+        return;
+    }
+
+    // Drop finished sounds that nobody asked for, if we're holding too many.
+    if (prefetched.size() >= kMaxPrefetched) {
+        QHash<QString, PrefetchedSound>::iterator it = prefetched.begin();
+        while (it != prefetched.end()) {
+            if (it->done) {
+                free(it->buf);
+                it = prefetched.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (prefetched.size() >= kMaxPrefetched) {
+            return;
+        }
+    }
+
+    PrefetchedSound& entry = prefetched[key];
+    entry.done = false;
+    entry.buf = 0;
+    entry.len = 0;
+    ++prefetchJobs;
+    QThreadPool::globalInstance()->start(new SoundPrefetchJob(key, fname, seekpos, filesize, type));
+}
+#else
+{ }
+#endif
+
+
+CHtmlSysSound*
+QTadsSound::createSound( const CHtmlUrl* url, const textchar_t* filename, unsigned long seekpos,
+                         unsigned long filesize, CHtmlSysWin*, SoundType type )
+#ifndef Q_OS_ANDROID
+{
+    //qDebug() << "Loading sound from" << filename << "offset:" << seekpos << "size:" << filesize
+    //      << "url:" << url->get_url();
+
+    CVmTraceSpan trace("resource", "load sound", url->get_url());
+
+    if (not ensureSound()) {
+        return 0;
+    }
+
+    // If we decoded this sound before and still have it, we're done.
+    // Otherwise take it from the background decoder, or decode it if it
+    // wasn't prefetched, and keep it around for the next time.
+    const QString& fname = fnameToQStr(filename);
+    const QString& cacheKey = soundKey(fname, seekpos, filesize, type);
+    Mix_Chunk* chunk = findDecoded(cacheKey);
+    if (chunk == 0) {
+        Uint8* buf;
+        Uint32 len;
+        Mix_Chunk* decoded;
+        if (takePrefetched(cacheKey, &buf, &len)) {
+            decoded = chunkFromPcm(buf, len);
+        } else {
+            decoded = decodeSound(fname, seekpos, filesize, type);
+        }
+        if (decoded == 0) {
+            return 0;
+        }
+        chunk = addDecoded(cacheKey, decoded);
+        if (chunk == 0) {
+            return 0;
+        }
+    }
+
     // We have all the data we need; create the sound object.  It is
     // *important* not to pass the CHtmlSysWin object as the parent in the
     // constructor; doing so would result in Qt deleting the sound object when
@@ -24,10 +24,24 @@
 #include "config.h"
 
 
+// Prepares the sound system.  The audio device isn't actually opened until
+// the first call to ensureSound().
 bool initSound();
 
+// Initializes the sound system if that hasn't been done yet.  Returns false if
+// sound isn't available.  Must be called from the GUI thread.
+bool ensureSound();
+
 void quitSound();
 
+// Memory held by decoded sounds, in use or cached.
+qint64 decodedSoundBytes();
+
+// Per-layer counts of sounds started, stolen and dropped, and the latency
+// from play request to first mix, one layer per line.  Empty if no sound
+// was played yet.
+QString soundLayerStats();
+
 
 /* Provides the common code for all three types of digitized sound (WAV,
  * Ogg Vorbis and MP3).
@@ -65,6 +79,11 @@ class QTadsSound: public QObject {
     // Total length of the sound in milliseconds.
     unsigned fLength;
 
+    // Priority of the layer the sound plays in; 0 is the background layer,
+    // 3 the foreground.  When we run out of mixer channels, sounds in less
+    // important layers make room for more important ones.
+    int fPriority;
+
     // All QTadsMediaObjects that currently exist.  We need this in order to
     // implement the SDL_Mixer callback (which in turn needs to call the TADS
     // callback) that is invoked after a channel has stopped playing.  That
@@ -73,6 +92,11 @@ class QTadsSound: public QObject {
     // to invoke the TADS callback based on the channel number.
     static QList<QTadsSound*> fObjList;
 
+    // Start the chunk on a free mixer channel, making room if needed.
+    // 'firstPlay' is false when we're looping.  Returns the channel, or -1.
+    int
+    fPlayOnChannel( int fadeIn, bool firstPlay );
+
     // We can't call SDL_mixer functions from inside an SDL_mixer callback, so
     // we use the following method: when the sound stops and the callback gets
     // called, we don't play it again (if it's looped) from inside the callback
@@ -106,6 +130,10 @@ class QTadsSound: public QObject {
   public:
     QTadsSound( QObject* parent, struct Mix_Chunk* chunk, SoundType type );
     ~QTadsSound() override;
+
+    void
+    setLayerPriority( int pri )
+    { this->fPriority = pri; }
 #endif
 
   public:
@@ -125,6 +153,12 @@ class QTadsSound: public QObject {
     static class CHtmlSysSound*
     createSound( const class CHtmlUrl* url, const textchar_t* filename, unsigned long seekpos,
                  unsigned long filesize, class CHtmlSysWin* win, SoundType type );
+
+    // Start decoding a sound in the background, so that createSound() finds
+    // it ready when the formatter gets to it.  Only WAV and MP3 are decoded
+    // ahead of time; for other types this does nothing.
+    static void
+    prefetch( const textchar_t* filename, unsigned long seekpos, unsigned long filesize, SoundType type );
 };
 
 
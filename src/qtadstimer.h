@@ -46,6 +46,11 @@ class QTadsTimer: public QTimer, public CHtmlSysTimer {
     QTadsTimer( void (*func)(void*), void* ctx, QObject* parent = 0 )
     : QTimer(parent), CHtmlSysTimer(func, ctx)
     {
+#if QT_VERSION >= 0x050000
+        // Games use these for real-time events, so ask for millisecond
+        // accuracy instead of the default coarse timer.
+        this->setTimerType(Qt::PreciseTimer);
+#endif
         connect(this, SIGNAL(timeout()), this, SLOT(trigger()));
     }
 
@@ -0,0 +1,87 @@
+/* Copyright (C) 2013 Nikos Chantziaras.
+ *
+ * This file is part of the QTads program.  This program is free software; you
+ * can redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation; either version
+ * 2, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; see the file COPYING.  If not, write to the Free Software
+ * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <QDir>
+#include <QTemporaryFile>
+
+#include "scrollbackjournal.h"
+
+
+QTadsScrollbackJournal::QTadsScrollbackJournal()
+    : fFile(0),
+      fFailed(false)
+{ }
+
+
+QTadsScrollbackJournal::~QTadsScrollbackJournal()
+{
+    delete this->fFile;
+}
+
+
+void
+QTadsScrollbackJournal::endPage()
+{
+    if (this->fCurrent.isEmpty() or this->fFailed) {
+        return;
+    }
+
+    // Create the file on first use, so that we don't leave one behind for
+    // games that never need it.
+    if (this->fFile == 0) {
+        this->fFile = new QTemporaryFile(QDir::tempPath() + QString::fromLatin1("/qtads_XXXXXX"));
+        if (not this->fFile->open()) {
+            delete this->fFile;
+            this->fFile = 0;
+            this->fFailed = true;
+            this->fCurrent.clear();
+            return;
+        }
+    }
+
+    const QByteArray& data = qCompress(this->fCurrent);
+    this->fCurrent.clear();
+    Page page;
+    page.offset = this->fFile->size();
+    page.size = data.size();
+    if (not this->fFile->seek(page.offset) or this->fFile->write(data) != data.size()) {
+        this->fFailed = true;
+        return;
+    }
+    this->fPages.append(page);
+}
+
+
+void
+QTadsScrollbackJournal::clear()
+{
+    delete this->fFile;
+    this->fFile = 0;
+    this->fPages.clear();
+    this->fCurrent.clear();
+    this->fFailed = false;
+}
+
+
+QByteArray
+QTadsScrollbackJournal::page( int index )
+{
+    if (index < 0 or index >= this->fPages.size() or not this->fFile->seek(this->fPages.at(index).offset)) {
+        return QByteArray();
+    }
+    return qUncompress(this->fFile->read(this->fPages.at(index).size));
+}
@@ -0,0 +1,88 @@
+/* Copyright (C) 2013 Nikos Chantziaras.
+ *
+ * This file is part of the QTads program.  This program is free software; you
+ * can redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation; either version
+ * 2, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; see the file COPYING.  If not, write to the Free Software
+ * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef SCROLLBACKJOURNAL_H
+#define SCROLLBACKJOURNAL_H
+
+#include <QByteArray>
+#include <QVector>
+
+
+/* On-disk journal of the game window's output.
+ *
+ * The game window's parse tree is pruned to stay within the scrollback
+ * budget, which throws the oldest text away.  To let the player still read
+ * it, we keep every turn's output as a page in a temporary file.  The parse
+ * tree can't be turned back into the HTML it was parsed from, so pages are
+ * written as the output arrives rather than when it's pruned.  Each finished
+ * page is compressed and appended to the file; only its location stays in
+ * memory, so memory use doesn't grow with the length of the game.  Pages are
+ * read back one at a time, when the history viewer asks for them.
+ *
+ * If the temporary file can't be created, the journal quietly stays empty.
+ */
+class QTadsScrollbackJournal {
+  private:
+    struct Page {
+        qint64 offset;
+        int size;
+    };
+
+    class QTemporaryFile* fFile;
+    QVector<Page> fPages;
+
+    // Output of the page we're still collecting.
+    QByteArray fCurrent;
+
+    // Set when we couldn't create or write the file.
+    bool fFailed;
+
+  public:
+    QTadsScrollbackJournal();
+    ~QTadsScrollbackJournal();
+
+    // Adds game output (UTF-8 HTML) to the current page.
+    void
+    append( const char* html, size_t len )
+    {
+        if (not this->fFailed) {
+            this->fCurrent.append(html, static_cast<int>(len));
+        }
+    }
+
+    // Finishes the current page and writes it out.  Does nothing if the page
+    // is empty.
+    void
+    endPage();
+
+    // Forgets all pages.
+    void
+    clear();
+
+    // Number of finished pages.
+    int
+    pageCount() const
+    { return this->fPages.size(); }
+
+    // Reads back a finished page.  Returns an empty array if the page can't
+    // be read.
+    QByteArray
+    page( int index );
+};
+
+
+#endif
@@ -94,6 +94,20 @@ Settings::loadFromDisk()
     sett.beginGroup(QString::fromLatin1("misc"));
     this->ioSafetyLevelRead = sett.value(QString::fromLatin1("ioSafetyLevelRead"), 2).toInt();
     this->ioSafetyLevelWrite = sett.value(QString::fromLatin1("ioSafetyLevelWrite"), 2).toInt();
+    this->gcPauseBudget = sett.value(QString::fromLatin1("gcPauseBudget"), 0).toInt();
+    this->gcCompact = sett.value(QString::fromLatin1("gcCompact"), true).toBool();
+    this->lazyObjectLoad = sett.value(QString::fromLatin1("lazyObjectLoad"), false).toBool();
+    this->regexCacheSize = sett.value(QString::fromLatin1("regexCacheSize"), 32).toInt();
+    this->undoMemoryBudget = sett.value(QString::fromLatin1("undoMemoryBudget"), 0).toInt();
+    this->autosave = sett.value(QString::fromLatin1("autosave"), false).toBool();
+    this->compressSaves = sett.value(QString::fromLatin1("compressSaves"), false).toBool();
+    this->mapGameFile = sett.value(QString::fromLatin1("mapGameFile"), false).toBool();
+    this->tads2AccessMemo = sett.value(QString::fromLatin1("tads2AccessMemo"), false).toBool();
+    this->startupSnapshot = sett.value(QString::fromLatin1("startupSnapshot"), false).toBool();
+    this->imageMemoryBudget = sett.value(QString::fromLatin1("imageMemoryBudget"), 0).toInt();
+    this->soundCacheSize = sett.value(QString::fromLatin1("soundCacheSize"), 16).toInt();
+    this->audioBufferSize = sett.value(QString::fromLatin1("audioBufferSize"), 2048).toInt();
+    this->scrollbackBudget = sett.value(QString::fromLatin1("scrollbackBudget"), 256).toInt();
     this->tads2Encoding = sett.value(QString::fromLatin1("tads2encoding"), QByteArray("windows-1252")).toByteArray();
     this->pasteOnDblClk = sett.value(QString::fromLatin1("pasteondoubleclick"), true).toBool();
     this->softScrolling = sett.value(QString::fromLatin1("softscrolling"), true).toBool();
@@ -164,6 +178,20 @@ Settings::saveToDisk()
     sett.beginGroup(QString::fromLatin1("misc"));
     sett.setValue(QString::fromLatin1("ioSafetyLevelRead"), this->ioSafetyLevelRead);
     sett.setValue(QString::fromLatin1("ioSafetyLevelWrite"), this->ioSafetyLevelWrite);
+    sett.setValue(QString::fromLatin1("gcPauseBudget"), this->gcPauseBudget);
+    sett.setValue(QString::fromLatin1("gcCompact"), this->gcCompact);
+    sett.setValue(QString::fromLatin1("lazyObjectLoad"), this->lazyObjectLoad);
+    sett.setValue(QString::fromLatin1("regexCacheSize"), this->regexCacheSize);
+    sett.setValue(QString::fromLatin1("undoMemoryBudget"), this->undoMemoryBudget);
+    sett.setValue(QString::fromLatin1("autosave"), this->autosave);
+    sett.setValue(QString::fromLatin1("compressSaves"), this->compressSaves);
+    sett.setValue(QString::fromLatin1("mapGameFile"), this->mapGameFile);
+    sett.setValue(QString::fromLatin1("tads2AccessMemo"), this->tads2AccessMemo);
+    sett.setValue(QString::fromLatin1("startupSnapshot"), this->startupSnapshot);
+    sett.setValue(QString::fromLatin1("imageMemoryBudget"), this->imageMemoryBudget);
+    sett.setValue(QString::fromLatin1("soundCacheSize"), this->soundCacheSize);
+    sett.setValue(QString::fromLatin1("audioBufferSize"), this->audioBufferSize);
+    sett.setValue(QString::fromLatin1("scrollbackBudget"), this->scrollbackBudget);
     sett.setValue(QString::fromLatin1("tads2encoding"), this->tads2Encoding);
     sett.setValue(QString::fromLatin1("pasteondoubleclick"), this->pasteOnDblClk);
     sett.setValue(QString::fromLatin1("softscrolling"), this->softScrolling);
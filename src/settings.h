@@ -59,6 +59,62 @@ class Settings {
     int ioSafetyLevelRead;
     int ioSafetyLevelWrite;
 
+    // Target pause time in milliseconds for the T3 garbage collector; 0
+    // selects the VM's default.
+    int gcPauseBudget;
+
+    // Compact the T3 variable heap while waiting for input.
+    bool gcCompact;
+
+    // Create T3 image file objects on first use rather than at load time.
+    bool lazyObjectLoad;
+
+    // Number of compiled regular expressions the T3 VM caches for patterns
+    // given as strings; 0 disables the cache.
+    int regexCacheSize;
+
+    // Memory budget for the T2 and T3 undo logs in kilobytes; when it fills
+    // up, the oldest turns are discarded.  0 selects the VM's default.
+    int undoMemoryBudget;
+
+    // Save the T3 game state automatically at each command prompt.  The
+    // file is written in the background next to the game file.
+    bool autosave;
+
+    // Compress T3 saved game files.
+    bool compressSaves;
+
+    // Memory-map T3 game files instead of reading them into memory.
+    bool mapGameFile;
+
+    // Remember the results of T2 access checks (validDo and friends) for the
+    // rest of the command.  Faster with "all" and plurals in big games, but
+    // wrong for games whose checks have side effects.
+    bool tads2AccessMemo;
+
+    // Memory budget for decoded images in MB; when it's exceeded, the least
+    // recently drawn images are dropped and decoded again when next drawn.
+    // 0 means no limit.
+    int imageMemoryBudget;
+
+    // Size in MB of the cache of decoded sounds that aren't playing, so that
+    // effects a game plays over and over only get decoded once; 0 disables
+    // the cache.
+    int soundCacheSize;
+
+    // Audio device buffer size in sample frames.  Smaller buffers start
+    // sounds sooner but are more likely to skip on a busy system.
+    int audioBufferSize;
+
+    // Scrollback budget in KB for the game window; this covers both the text
+    // and the display items laid out from it.  When it's exceeded, the oldest
+    // output is discarded.  0 means no limit.
+    int scrollbackBudget;
+
+    // Cache the T3 game state after static initialization, and restore it
+    // on later launches of the same game file instead of initializing again.
+    bool startupSnapshot;
+
     QByteArray tads2Encoding;
     bool pasteOnDblClk;
     bool softScrolling;
@@ -0,0 +1,81 @@
+/* Copyright (C) 2013 Nikos Chantziaras.
+ *
+ * This file is part of the QTads program.  This program is free software; you
+ * can redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation; either version
+ * 2, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; see the file COPYING.  If not, write to the Free Software
+ * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <cstdio>
+
+#include "startupprofiler.h"
+
+
+QTadsStartupProfiler* QTadsStartupProfiler::fInstance = 0;
+
+
+QTadsStartupProfiler::QTadsStartupProfiler()
+{
+    Q_ASSERT(fInstance == 0);
+    this->fClock.start();
+    fInstance = this;
+    CVmImageLoader::set_startup_timer(this);
+}
+
+
+QTadsStartupProfiler::~QTadsStartupProfiler()
+{
+    CVmImageLoader::set_startup_timer(0);
+    fInstance = 0;
+}
+
+
+double
+QTadsStartupProfiler::now_ms()
+{
+    return this->fClock.nsecsElapsed() / 1000000.0;
+}
+
+
+void
+QTadsStartupProfiler::add_phase( const char* name, double start_ms, double ms, ulong cnt )
+{
+    Phase phase;
+    phase.name = name;
+    phase.start = start_ms;
+    phase.ms = ms;
+    phase.count = cnt;
+    this->fPhases.append(phase);
+}
+
+
+void
+QTadsStartupProfiler::report() const
+{
+    // Phases are reported when they finish, so an enclosing phase comes after
+    // the phases it contains.  Sort them by start time instead, which gives a
+    // timeline.  (Per-block-type image load entries start at the first block
+    // of their type.)
+    QList<Phase> phases(this->fPhases);
+    for (int i = 1; i < phases.size(); ++i) {
+        for (int j = i; j > 0 and phases.at(j).start < phases.at(j - 1).start; --j) {
+            phases.swap(j, j - 1);
+        }
+    }
+
+    std::fprintf(stderr, "Startup profile (times in milliseconds):\n");
+    std::fprintf(stderr, "%10s %10s %7s  %s\n", "start", "time", "count", "phase");
+    for (int i = 0; i < phases.size(); ++i) {
+        const Phase& p = phases.at(i);
+        std::fprintf(stderr, "%10.3f %10.3f %7lu  %s\n", p.start, p.ms, p.count, p.name.constData());
+    }
+}
@@ -0,0 +1,99 @@
+/* Copyright (C) 2013 Nikos Chantziaras.
+ *
+ * This file is part of the QTads program.  This program is free software; you
+ * can redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation; either version
+ * 2, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; see the file COPYING.  If not, write to the Free Software
+ * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef STARTUPPROFILER_H
+#define STARTUPPROFILER_H
+
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QList>
+
+#include "vmimage.h"
+
+
+/* Startup profiler, enabled with the --profile-startup command line option.
+ *
+ * It records how long each phase of startup takes, on a monotonic clock:
+ * our own setup phases (timed with QTadsStartupPhase) as well as the T3 VM's
+ * image loading, broken down by image block type, and its static
+ * initialization (which the VM reports through the CVmStartupTimer
+ * interface).  The breakdown is printed to stderr on exit.
+ */
+class QTadsStartupProfiler: public CVmStartupTimer {
+  private:
+    struct Phase {
+        QByteArray name;
+        double start;
+        double ms;
+        unsigned long count;
+    };
+
+    static QTadsStartupProfiler* fInstance;
+
+    // Zero point of our clock; started on construction.
+    QElapsedTimer fClock;
+
+    // Recorded phases, in the order they were reported.
+    QList<Phase> fPhases;
+
+  public:
+    // Starts the clock and makes this the active profiler, also for the VM.
+    QTadsStartupProfiler();
+
+    ~QTadsStartupProfiler() override;
+
+    // The active profiler, or 0 if startup profiling is off.
+    static QTadsStartupProfiler*
+    instance()
+    { return fInstance; }
+
+    double
+    now_ms() override;
+
+    void
+    add_phase( const char* name, double start_ms, double ms, ulong cnt ) override;
+
+    // Prints the recorded phases to stderr, in the order they started.
+    void
+    report() const;
+};
+
+
+/* Times a frontend startup phase, from construction to destruction.  Does
+ * nothing if startup profiling is off.
+ */
+class QTadsStartupPhase {
+  private:
+    const char* fName;
+    double fStart;
+
+  public:
+    explicit QTadsStartupPhase( const char* name )
+        : fName(name),
+          fStart(QTadsStartupProfiler::instance() != 0 ? QTadsStartupProfiler::instance()->now_ms() : 0.0)
+    { }
+
+    ~QTadsStartupPhase()
+    {
+        QTadsStartupProfiler* prof = QTadsStartupProfiler::instance();
+        if (prof != 0) {
+            prof->add_phase(this->fName, this->fStart, prof->now_ms() - this->fStart, 1);
+        }
+    }
+};
+
+
+#endif
@@ -20,6 +20,10 @@
 #include <QFontMetrics>
 #include <QFontInfo>
 #include <QColor>
+#if QT_VERSION >= 0x040700
+#include <QHash>
+#include <QStaticText>
+#endif
 
 #include "htmlsys.h"
 #include "config.h"
@@ -36,7 +40,128 @@ class CHtmlSysFontQt: public QFont, public CHtmlSysFont {
     QColor fColor;
     QColor fBgColor;
 
+    // Metrics for this font, created the first time we measure text.  The
+    // formatter measures every text run it lays out, so constructing a new
+    // QFontMetrics each time adds up.
+    mutable QFontMetrics* fMetrics;
+    mutable QFontMetricsF* fMetricsF;
+
+    // Advances of the ASCII characters, or a negative value for characters
+    // we haven't looked up yet.  We only use these when the advance of a
+    // string is the sum of the advances of its characters; that is, when
+    // there's no kerning.
+    mutable qreal fAsciiAdvance[128];
+    mutable signed char fUseAdvances;
+
+#if QT_VERSION >= 0x040700
+    // Laid out text runs in this font, keyed by their UTF-8 text.  Scrolling
+    // repaints the same display items over and over; with this, repainting
+    // them doesn't need to lay out their text again.  Colors come from the
+    // painter when drawing, so the cache only depends on the font.
+    mutable QHash<QByteArray, QStaticText> fStaticTexts;
+#endif
+
+    void
+    fResetMetrics()
+    {
+        delete this->fMetrics;
+        delete this->fMetricsF;
+        this->fMetrics = 0;
+        this->fMetricsF = 0;
+        for (int i = 0; i < 128; ++i) {
+            this->fAsciiAdvance[i] = -1;
+        }
+        this->fUseAdvances = -1;
+#if QT_VERSION >= 0x040700
+        this->fStaticTexts.clear();
+#endif
+    }
+
   public:
+    CHtmlSysFontQt()
+        : fMetrics(0),
+          fMetricsF(0)
+    { this->fResetMetrics(); }
+
+    CHtmlSysFontQt( const CHtmlSysFontQt& f )
+        : QFont(f),
+          CHtmlSysFont(f),
+          fColor(f.fColor),
+          fBgColor(f.fBgColor),
+          fMetrics(0),
+          fMetricsF(0)
+    { this->fResetMetrics(); }
+
+    ~CHtmlSysFontQt() override
+    {
+        delete this->fMetrics;
+        delete this->fMetricsF;
+    }
+
+    // Cached metrics of this font.
+    const QFontMetrics&
+    metrics() const
+    {
+        if (this->fMetrics == 0) {
+            this->fMetrics = new QFontMetrics(*this);
+        }
+        return *this->fMetrics;
+    }
+
+#if QT_VERSION >= 0x040700
+    // Returns the given UTF-8 text laid out in this font, from the cache if
+    // we've laid it out before.
+    const QStaticText&
+    staticText( const char* str, size_t len ) const
+    {
+        const QByteArray key(str, len);
+        QHash<QByteArray, QStaticText>::const_iterator it = this->fStaticTexts.constFind(key);
+        if (it != this->fStaticTexts.constEnd()) {
+            return it.value();
+        }
+        // Keep the cache bounded; when it fills up, start over.
+        if (this->fStaticTexts.size() >= 2048) {
+            this->fStaticTexts.clear();
+        }
+        QStaticText txt(QString::fromUtf8(str, len));
+        txt.setTextFormat(Qt::PlainText);
+        txt.setPerformanceHint(QStaticText::AggressiveCaching);
+        txt.prepare(QTransform(), *this);
+        return this->fStaticTexts.insert(key, txt).value();
+    }
+#endif
+
+    // Returns the distance from the start of the given UTF-8 text to where
+    // subsequent text should be drawn.
+    int
+    textAdvance( const char* str, size_t len ) const
+    {
+        if (this->fUseAdvances < 0) {
+            this->fUseAdvances = not this->kerning() or QFontInfo(*this).fixedPitch();
+        }
+        if (this->fUseAdvances) {
+            // Sum the advances if the text is plain ASCII.
+            qreal total = 0;
+            size_t i;
+            for (i = 0; i < len; ++i) {
+                unsigned char c = str[i];
+                if (c >= 128 or c < 32) {
+                    break;
+                }
+                if (this->fAsciiAdvance[c] < 0) {
+                    if (this->fMetricsF == 0) {
+                        this->fMetricsF = new QFontMetricsF(*this);
+                    }
+                    this->fAsciiAdvance[c] = this->fMetricsF->width(QChar(c));
+                }
+                total += this->fAsciiAdvance[c];
+            }
+            if (i == len) {
+                return qRound(total);
+            }
+        }
+        return this->metrics().width(QString::fromUtf8(str, len));
+    }
     // When color() is a valid color (QColor::isValid()) it should be used as
     // the foreground color when drawing text in this font.
     const QColor&
@@ -73,6 +198,18 @@ class CHtmlSysFontQt: public QFont, public CHtmlSysFont {
     operator =( const QFont& f )
     {
         QFont::operator =(f);
+        this->fResetMetrics();
+        return *this;
+    }
+
+    CHtmlSysFontQt&
+    operator =( const CHtmlSysFontQt& f )
+    {
+        QFont::operator =(f);
+        CHtmlSysFont::operator =(f);
+        this->fColor = f.fColor;
+        this->fBgColor = f.fBgColor;
+        this->fResetMetrics();
         return *this;
     }
 
@@ -94,7 +231,7 @@ class CHtmlSysFontQt: public QFont, public CHtmlSysFont {
     {
         //qDebug() << Q_FUNC_INFO << "called";
 
-        QFontMetrics tmp(*this);
+        const QFontMetrics& tmp = this->metrics();
 
         m->ascender_height = tmp.ascent();
         m->descender_height = tmp.descent();
@@ -21,16 +21,33 @@
 #include <QIcon>
 #include <QStatusBar>
 #include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QCryptographicHash>
+#if QT_VERSION < 0x050000
+    #include <QDesktopServices>
+#else
+    #include <QStandardPaths>
+#endif
 #include <QTextCodec>
+#include <QTextDocument>
 #include <QMessageBox>
+#include <QTimer>
 #include <cstdlib>
 
 #include "qtadshostifc.h"
+#include "qtadsimage.h"
+#include "globals.h"
 #include "settings.h"
 #include "syswinaboutbox.h"
 #include "syswininput.h"
 #include "gameinfodialog.h"
 #include "qtadssound.h"
+#include "startupprofiler.h"
+#include "perfstats.h"
+#include "scrollbackjournal.h"
+#include "dispwidget.h"
+#include "vmtrace.h"
 
 #include "htmlprs.h"
 #include "htmlfmt.h"
@@ -56,9 +73,11 @@ CHtmlSysFrameQt::CHtmlSysFrameQt( int& argc, char* argv[], const char* appName,
                                   const char* orgName, const char* orgDomain )
     : QApplication(argc, argv),
       fGameWin(0),
+      fFontGeneration(1),
       fGameRunning(false),
       fTads3(true),
       fReformatPending(false),
+      fFlushPending(false),
       fNonStopMode(false)
 {
     //qDebug() << Q_FUNC_INFO;
@@ -71,7 +90,10 @@ CHtmlSysFrameQt::CHtmlSysFrameQt( int& argc, char* argv[], const char* appName,
 
     // Load our persistent settings.
     this->fSettings = new Settings;
-    this->fSettings->loadFromDisk();
+    {
+        QTadsStartupPhase phase("Settings::loadFromDisk");
+        this->fSettings->loadFromDisk();
+    }
 
     // Initialize the input color with the user-configured one.  The game is
     // free to change the input color later on.
@@ -80,6 +102,13 @@ CHtmlSysFrameQt::CHtmlSysFrameQt( int& argc, char* argv[], const char* appName,
 
     this->fParser = 0;
     this->fFormatter = 0;
+    this->fJournal = new QTadsScrollbackJournal;
+
+    // A zero-interval timer fires whenever the event loop has nothing else
+    // to do, which is when we want to run idle-time GC.
+    this->fIdleGCTimer = new QTimer(this);
+    this->fIdleGCTimer->setInterval(0);
+    connect(this->fIdleGCTimer, SIGNAL(timeout()), this, SLOT(fIdleGCStep()));
 
     // Clear the TADS appctx; all unused fields must be 0.
     memset(&this->fAppctx, 0, sizeof(this->fAppctx));
@@ -93,9 +122,12 @@ CHtmlSysFrameQt::CHtmlSysFrameQt( int& argc, char* argv[], const char* appName,
     qFrame = this;
 
     // Create our main application window.
-    this->fMainWin = new CHtmlSysWinGroupQt;
-    this->fMainWin->setWindowTitle(QString::fromLatin1(appName));
-    this->fMainWin->updateRecentGames();
+    {
+        QTadsStartupPhase phase("main window setup");
+        this->fMainWin = new CHtmlSysWinGroupQt;
+        this->fMainWin->setWindowTitle(QString::fromLatin1(appName));
+        this->fMainWin->updateRecentGames();
+    }
 
     // Automatically quit the application when the last window has closed.
     connect(this, SIGNAL(lastWindowClosed()), this, SLOT(quit()));
@@ -149,8 +181,10 @@ CHtmlSysFrameQt::~CHtmlSysFrameQt()
     if (this->fFormatter != 0) {
         delete this->fFormatter;
     }
+    delete this->fJournal;
 
     // Delete cached fonts.
+    this->fFontHash.clear();
     while (not this->fFontList.isEmpty()) {
         delete this->fFontList.takeLast();
     }
@@ -207,19 +241,28 @@ CHtmlSysFrameQt::fRunGame()
             }
 
             // Delete cached fonts.
+            this->fFontHash.clear();
             while (not this->fFontList.isEmpty()) {
                 delete this->fFontList.takeLast();
             }
-
-            // Recreate them.
-            this->fParser = new CHtmlParser(true);
-            this->fFormatter = new CHtmlFormatterInput(this->fParser);
-            // Tell the resource finder about our appctx.
-            this->fFormatter->get_res_finder()->init_appctx(&this->fAppctx);
-            this->fGameWin = new CHtmlSysWinInputQt(this->fFormatter, qWinGroup->centralWidget());
-            this->fGameWin->resize(qWinGroup->centralWidget()->size());
-            this->fGameWin->show();
-            this->fGameWin->setFocus();
+            ++this->fFontGeneration;
+
+            // The new game starts with an empty history.
+            this->fJournal->clear();
+
+            // Recreate them.  Creating the game window also sets up its
+            // default fonts.
+            {
+                QTadsStartupPhase phase("game window and font setup");
+                this->fParser = new CHtmlParser(true);
+                this->fFormatter = new CHtmlFormatterInput(this->fParser);
+                // Tell the resource finder about our appctx.
+                this->fFormatter->get_res_finder()->init_appctx(&this->fAppctx);
+                this->fGameWin = new CHtmlSysWinInputQt(this->fFormatter, qWinGroup->centralWidget());
+                this->fGameWin->resize(qWinGroup->centralWidget()->size());
+                this->fGameWin->show();
+                this->fGameWin->setFocus();
+            }
 
             // Set the application's window title to contain the filename of
             // the game we're running or the game's name as at appears in the
@@ -288,7 +331,7 @@ CHtmlSysFrameQt::fRunGame()
             emit gameHasQuit();
 
             // Flush any pending output and cancel all sounds and animations.
-            this->flush_txtbuf(true, false);
+            this->fFlushTxtbuf(true, false, true);
             this->fFormatter->cancel_sound(HTML_Attrib_invalid, 0.0, false, false);
             this->fFormatter->cancel_playback();
 
@@ -297,7 +340,7 @@ CHtmlSysFrameQt::fRunGame()
             this->fParser->obey_markups(true);
             QString endMsg(QString::fromLatin1("<p><br><font face=tads-serif size=-1>(The game has ended.)</font></p>"));
             this->display_output(endMsg.toUtf8().constData(), endMsg.length());
-            this->flush_txtbuf(true, false);
+            this->fFlushTxtbuf(true, false, true);
         } else {
             QMessageBox::critical(this->fMainWin, tr("Open Game"), finfo.fileName() + tr(" is not a TADS game file."));
         }
@@ -318,13 +361,39 @@ CHtmlSysFrameQt::fRunT2Game( const QString& fname )
     char argv0[] = "qtads";
     char* argv1 = new char[qStrToFname(fname).size() + 1];
     strcpy(argv1, qStrToFname(fname).constData());
-    char* argv[2] = {argv0, argv1};
+    char* argv[7] = {argv0, 0, 0, 0, 0, 0, 0};
+    int argc = 1;
+
+    // Pass the undo memory budget, if there is one, as the "-u" option.  The
+    // game file has to remain the last argument.
+    QByteArray undoArg;
+    if (this->fSettings->undoMemoryBudget > 0) {
+        undoArg = "-u" + QByteArray::number(static_cast<qlonglong>(this->fSettings->undoMemoryBudget) * 1024);
+        argv[argc++] = undoArg.data();
+    }
+
+    // Remember access checks within a command, if enabled.
+    char accMemoOpt[] = "-accmemo+";
+    if (this->fSettings->tads2AccessMemo) {
+        argv[argc++] = accMemoOpt;
+    }
+
+    // Read the input from the replay script, if there is one, with "-i".
+    char iOpt[] = "-i";
+    QByteArray scriptArg;
+    if (not this->fReplayScript.isEmpty()) {
+        scriptArg = qStrToFname(this->fReplayScript);
+        this->fReplayScript.clear();
+        argv[argc++] = iOpt;
+        argv[argc++] = scriptArg.data();
+    }
+    argv[argc++] = argv1;
 
     // We always use .sav as the extension for T2 save files.
     char savExt[] = "sav";
 
     // Start the T2 VM.
-    trdmain(2, argv, &this->fAppctx, savExt);
+    trdmain(argc, argv, &this->fAppctx, savExt);
 
     delete[] argv1;
 }
@@ -338,8 +407,67 @@ CHtmlSysFrameQt::fRunT3Game( const QString& fname )
     // the data so that it won't go out of scope.
     const QByteArray& fnameData = qStrToFname(fname);
     vm_run_image_params params(this->fClientifc, this->fHostifc, fnameData.constData());
+    params.gc_pause_ms = this->fSettings->gcPauseBudget;
+    params.gc_compact = this->fSettings->gcCompact;
+    params.lazy_load = this->fSettings->lazyObjectLoad;
+    params.rex_cache_size = this->fSettings->regexCacheSize;
+    params.undo_budget = static_cast<long>(this->fSettings->undoMemoryBudget) * 1024;
+    params.save_compress = this->fSettings->compressSaves;
+    params.map_image = this->fSettings->mapGameFile;
+
+    // Read the input from the replay script, if there is one.  (Like the
+    // filename, the VM stores the pointer, so we hold on to the data.)
+    QByteArray scriptData;
+    if (not this->fReplayScript.isEmpty()) {
+        scriptData = qStrToFname(this->fReplayScript);
+        this->fReplayScript.clear();
+        params.script_file = scriptData.constData();
+    }
+
+    // Autosaves go next to the game file, as "<game>-autosave.t3v".
+    if (this->fSettings->autosave) {
+        const QFileInfo finfo(fname);
+        const QString& asName = finfo.absolutePath() + QString::fromLatin1("/") + finfo.completeBaseName()
+                                + QString::fromLatin1("-autosave.t3v");
+        this->fHostifc->setAutosaveFile(qStrToFname(asName));
+    }
+
+    // Startup snapshots go in the cache directory.  (The VM also checks the
+    // snapshot against the image's timestamp before using it.)
+    if (this->fSettings->startupSnapshot) {
+        const QString& snapName = gameCacheFile(fname, ".t3v");
+        if (not snapName.isEmpty() and QDir().mkpath(QFileInfo(snapName).absolutePath())) {
+            this->fHostifc->setSnapshotFile(qStrToFname(snapName));
+        }
+    }
+
     this->fTads3 = true;
     vm_run_image(&params);
+    this->fHostifc->setAutosaveFile(QByteArray());
+    this->fHostifc->setSnapshotFile(QByteArray());
+}
+
+
+QString
+CHtmlSysFrameQt::gameCacheFile( const QString& gameFile, const char* ext )
+{
+    const QFileInfo finfo(gameFile);
+    const QString& cacheDir =
+    #if QT_VERSION < 0x050000
+            QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+    #else
+            QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    #endif
+    if (cacheDir.isEmpty() or not finfo.exists()) {
+        return QString();
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(finfo.absoluteFilePath().toUtf8());
+    hash.addData(QByteArray::number(finfo.size()));
+    hash.addData(finfo.lastModified().toString(Qt::ISODate).toLatin1());
+    hash.addData(QTADS_VERSION);
+    return cacheDir + QString::fromLatin1("/") + QString::fromLatin1(hash.result().toHex())
+           + QString::fromLatin1(ext);
 }
 
 
@@ -416,12 +544,46 @@ qtRuntimeVersion()
 #endif
 
 
+// Builds the key for a font descriptor in our font hash.  It contains every
+// descriptor field that createFont() looks at.
+static QByteArray
+fontDescKey( const CHtmlFontDesc* desc )
+{
+    int fields[] = {
+        desc->pointsize, desc->weight, desc->htmlsize,
+        static_cast<int>(desc->color), static_cast<int>(desc->bgcolor),
+        static_cast<int>(desc->charset),
+        (desc->italic ? 1 : 0) | (desc->underline ? 2 : 0) | (desc->strikeout ? 4 : 0)
+        | (desc->default_color ? 8 : 0) | (desc->default_bgcolor ? 0x10 : 0)
+        | (desc->face_set_explicitly ? 0x20 : 0) | (desc->fixed_pitch ? 0x40 : 0)
+        | (desc->serif ? 0x80 : 0) | (desc->superscript ? 0x100 : 0) | (desc->subscript ? 0x200 : 0)
+        | (desc->pe_big ? 0x400 : 0) | (desc->pe_small ? 0x800 : 0) | (desc->pe_em ? 0x1000 : 0)
+        | (desc->pe_strong ? 0x2000 : 0) | (desc->pe_dfn ? 0x4000 : 0) | (desc->pe_code ? 0x8000 : 0)
+        | (desc->pe_samp ? 0x10000 : 0) | (desc->pe_kbd ? 0x20000 : 0) | (desc->pe_var ? 0x40000 : 0)
+        | (desc->pe_cite ? 0x80000 : 0) | (desc->pe_address ? 0x100000 : 0)
+        | (desc->default_charset ? 0x200000 : 0)
+    };
+    QByteArray key(reinterpret_cast<const char*>(fields), sizeof(fields));
+    key.append(desc->face);
+    return key;
+}
+
+
 CHtmlSysFontQt*
 CHtmlSysFrameQt::createFont( const CHtmlFontDesc* font_desc )
 {
     //qDebug() << Q_FUNC_INFO;
     Q_ASSERT(font_desc != 0);
 
+    // The formatter asks for a font on every font change in the output, so
+    // look for one we've already created for this descriptor before doing
+    // any of the work of building a QFont.
+    const QByteArray key(fontDescKey(font_desc));
+    CHtmlSysFontQt* cached = this->fFontHash.value(key, 0);
+    if (cached != 0) {
+        return cached;
+    }
+
     CHtmlFontDesc newFontDesc = *font_desc;
     CHtmlSysFontQt newFont;
     QFont::StyleStrategy strat;
@@ -629,9 +791,11 @@ CHtmlSysFrameQt::createFont( const CHtmlFontDesc* font_desc )
         newFont.bgColor(newFontDesc.bgcolor);
     }
 
-    // Check whether a matching font is already in our cache.
+    // Check whether a matching font is already in our cache.  Different
+    // descriptors can come out as the same font.
     for (int i = 0; i < this->fFontList.size(); ++i) {
         if (*this->fFontList.at(i) == newFont) {
+            this->fFontHash.insert(key, this->fFontList[i]);
             return this->fFontList[i];
         }
     }
@@ -644,6 +808,7 @@ CHtmlSysFrameQt::createFont( const CHtmlFontDesc* font_desc )
     CHtmlSysFontQt* font = new CHtmlSysFontQt(newFont);
     font->set_font_desc(&newFontDesc);
     this->fFontList.append(font);
+    this->fFontHash.insert(key, font);
     return font;
 }
 
@@ -686,37 +851,61 @@ CHtmlSysFrameQt::reformatBanners( bool showStatus, bool freezeDisplay, bool rese
 void
 CHtmlSysFrameQt::pruneParseTree()
 {
-    static int checkCount = 0;
-
-    // If there's a reformat pending, perform it.
+    // If there's a reformat pending, perform it.  Only the windows whose
+    // size changed need it; the layout itself is already up to date.
     if (this->fReformatPending) {
         this->fReformatPending = false;
-        this->reformatBanners(true, true, false);
+        if (this->fGameWin->needsReformat()) {
+            this->fGameWin->doReformat(true, true, false);
+        }
+        for (int i = 0; i < this->fBannerList.size(); ++i) {
+            if (this->fBannerList.at(i)->needsReformat()) {
+                this->fBannerList.at(i)->doReformat(true, true, false);
+            }
+        }
     }
 
-    // Skip this entirely most of the time; only check every so often, so that
-    // we don't waste a lot of time doing this too frequently.
-    ++checkCount;
-    if (checkCount < 10) {
+    // The budget is in KB; 0 means no limit.
+    const unsigned long budget = static_cast<unsigned long>(qMax(this->fSettings->scrollbackBudget, 0)) * 1024;
+    if (budget == 0) {
         return;
     }
-    checkCount = 0;
 
     // Check to see if we're consuming too much memory - if not, there's
-    // nothing we need to do here.
-    if (this->fParser->get_text_array()->get_mem_in_use() < 65536) {
+    // nothing we need to do here.  This is cheap, so we do it every time.
+    // We count the display items as well as the text, since for text with a
+    // lot of markup they can take up considerably more memory.
+    const unsigned long textMem = this->fParser->get_text_array()->get_mem_in_use();
+    const unsigned long totalMem = textMem + this->fFormatter->get_heap_mem_in_use();
+    if (totalMem < budget) {
         return;
     }
 
-    // Perform the pruning and reformat all banners.
-    this->fParser->prune_tree(65536 / 2);
-    this->reformatBanners(false, true, false);
+    // Prune down to half the budget.  The parser can only measure the text
+    // it's pruning, so scale the target by our current ratio of text to total
+    // memory.  A deferred clipboard copy still points into the text that's
+    // about to go away, so it has to take its text now.
+    DisplayWidget::materializeClipboardData();
+    this->fParser->prune_tree(static_cast<unsigned long>(static_cast<double>(textMem) * (budget / 2) / totalMem));
+
+    // Only the main game window's contents were pruned, so that's the only
+    // window we need to reformat.  The display list is laid out top-down from
+    // the parse tree, so it can't be trimmed in place; doReformat() does the
+    // work in slices, so this doesn't stall the interface.
+    this->fGameWin->doReformat(false, true, false);
 }
 
 
 void
 CHtmlSysFrameQt::notifyPreferencesChange( const Settings* sett )
 {
+    // The fonts we'd create for a given descriptor depend on the font
+    // preferences, so forget which font we created for which descriptor.  The
+    // fonts themselves stay in fFontList; createFont() will still find any of
+    // them that match the new preferences.
+    this->fFontHash.clear();
+    ++this->fFontGeneration;
+
     // Bail out if we currently don't have an active formatter.
     if (this->fFormatter == 0) {
         return;
@@ -770,13 +959,49 @@ CHtmlSysFrame::eof_on_console()
 void
 CHtmlSysFrameQt::flush_txtbuf( int fmt, int immediate_redraw )
 {
-    // Flush and clear the buffer.
-    this->fParser->parse(&this->fBuffer, qWinGroup);
-    this->fBuffer.clear();
+    this->fFlushTxtbuf(fmt, immediate_redraw, false);
+}
+
+
+void
+CHtmlSysFrameQt::fFlushTxtbuf( bool fmt, bool immediateRedraw, bool force )
+{
+    // Minimum time between two formatting passes for flushes we're allowed
+    // to defer.  One frame at 60Hz.
+    const int minInterval = 16;
+
+    // Flush and clear the buffer.  We always parse right away, since the
+    // caller might be about to change the parser's mode.
+    {
+        QTadsPerfTimer perf(QTadsPerfStats::Parse);
+        CVmTraceSpan trace("ui", "html parse");
+        this->fParser->parse(&this->fBuffer, qWinGroup);
+        this->fBuffer.clear();
+    }
+
+    // Games that print a lot of text usually flush after every few lines.
+    // Formatting after each of those is wasted work, since nothing gets
+    // painted until we return to the event loop anyway.  So unless we've
+    // been told to show the output right now, format at most once per frame
+    // and leave the rest to a timer.
+    if (fmt and not force and not immediateRedraw and this->fLastFlushTime.isValid()) {
+        int elapsed = this->fLastFlushTime.elapsed();
+        if (elapsed >= 0 and elapsed < minInterval) {
+            if (not this->fFlushPending) {
+                this->fFlushPending = true;
+                QTimer::singleShot(minInterval - elapsed, this, SLOT(fFlushPendingOutput()));
+            }
+            return;
+        }
+    }
 
     // If desired, run the parsed source through the formatter and display it.
     if (fmt) {
+        QTadsPerfTimer perf(QTadsPerfStats::Format);
+        CVmTraceSpan trace("ui", "format");
+        this->fFlushPending = false;
         this->fGameWin->do_formatting(false, false, false);
+        this->fLastFlushTime.start();
     }
 
     // Also flush all banner windows.
@@ -785,12 +1010,24 @@ CHtmlSysFrameQt::flush_txtbuf( int fmt, int immediate_redraw )
     }
 
     // If desired, immediately update the display.
-    if (immediate_redraw) {
+    if (immediateRedraw) {
         this->fMainWin->centralWidget()->update();
     }
 }
 
 
+void
+CHtmlSysFrameQt::fFlushPendingOutput()
+{
+    // The output might have been formatted by a forced flush in the meantime.
+    if (not this->fFlushPending or this->fGameWin == 0) {
+        this->fFlushPending = false;
+        return;
+    }
+    this->fFlushTxtbuf(true, false, true);
+}
+
+
 void
 CHtmlSysFrameQt::start_new_page()
 {
@@ -802,12 +1039,14 @@ CHtmlSysFrameQt::start_new_page()
     }
 
     // Flush any pending output.
-    this->flush_txtbuf(true, false);
+    this->fFlushTxtbuf(true, false, true);
 
     // Cancel all animations.
     this->fFormatter->cancel_playback();
 
-    // Tell the parser to clear the page.
+    // Tell the parser to clear the page.  Any deferred clipboard copy needs
+    // its text before that happens.
+    DisplayWidget::materializeClipboardData();
     this->fParser->clear_page();
 
     // Remove all banners.  The formatter will do the right thing and only
@@ -838,13 +1077,22 @@ CHtmlSysFrameQt::display_output( const textchar_t *buf, size_t len )
     //qDebug() << Q_FUNC_INFO;
 
     // Just add the new text to our buffer.  Append it as-is if we're running
-    // a TADS 3 game, since it's already UTF-8 encoded.
+    // a TADS 3 game, since it's already UTF-8 encoded.  If the window's
+    // contents get pruned, also keep the text in the journal.
+    const bool journal = this->fSettings->scrollbackBudget > 0;
     if (this->fTads3) {
         this->fBuffer.append(buf, len);
+        if (journal) {
+            this->fJournal->append(buf, len);
+        }
     } else {
         // TADS 2 does not use UTF-8; use the encoding from our settings.
         QTextCodec* codec = QTextCodec::codecForName(this->fSettings->tads2Encoding);
-        this->fBuffer.append(codec->toUnicode(buf, len).toUtf8().constData());
+        const QByteArray& utf8 = codec->toUnicode(buf, len).toUtf8();
+        this->fBuffer.append(utf8.constData());
+        if (journal) {
+            this->fJournal->append(utf8.constData(), utf8.size());
+        }
     }
 }
 
@@ -876,19 +1124,46 @@ CHtmlSysFrameQt::get_input_timeout( textchar_t* buf, size_t buflen, unsigned lon
 {
     //qDebug() << Q_FUNC_INFO;
 
-    // Flush and prune before input.
-    this->flush_txtbuf(true, false);
+    // Flush and prune before input.  The turn's output is complete, so it
+    // goes into the journal as a page.
+    this->fFlushTxtbuf(true, false, true);
+    this->fJournal->endPage();
     this->pruneParseTree();
+    QTadsPerfStats::endTurn();
+    vm_trace_command_end();
 
+    this->fBeginIdleGC();
     if (use_timeout) {
         bool timedOut = false;
         this->fGameWin->getInput(buf, buflen, timeout, true, &timedOut);
         if (timedOut) {
+            this->fEndIdleGC();
+            QTadsPerfStats::beginTurn();
+            vm_trace_command_begin("(input timeout)");
             return OS_EVT_TIMEOUT;
         }
     } else {
         this->fGameWin->getInput(buf, buflen);
     }
+    this->fEndIdleGC();
+    QTadsPerfStats::beginTurn();
+    vm_trace_command_begin(buf);
+
+    // The game window shows the command as part of the input line, which
+    // never goes through display_output(), so journal it here.
+    if (this->fSettings->scrollbackBudget > 0) {
+        const QString& cmdStr = this->fTads3 ? QString::fromUtf8(buf)
+                                : QTextCodec::codecForName(this->fSettings->tads2Encoding)->toUnicode(buf);
+        const QByteArray& cmd =
+        #if QT_VERSION < 0x050000
+            Qt::escape(cmdStr).toUtf8();
+        #else
+            cmdStr.toHtmlEscaped().toUtf8();
+        #endif
+        this->fJournal->append("<b>", 3);
+        this->fJournal->append(cmd.constData(), cmd.size());
+        this->fJournal->append("</b><br>", 8);
+    }
 
     // Return EOF if we're quitting the game.
     if (not this->fGameRunning) {
@@ -898,6 +1173,40 @@ CHtmlSysFrameQt::get_input_timeout( textchar_t* buf, size_t buflen, unsigned lon
 }
 
 
+void
+CHtmlSysFrameQt::fBeginIdleGC()
+{
+    // Only the T3 VM supports this.
+    if (this->fTads3) {
+        this->fIdleGCTimer->start();
+    }
+}
+
+
+void
+CHtmlSysFrameQt::fEndIdleGC()
+{
+    if (this->fTads3) {
+        this->fIdleGCTimer->stop();
+        // Complete the collection before the VM gets control back.
+        vm_idle_gc_finish();
+    }
+}
+
+
+void
+CHtmlSysFrameQt::fIdleGCStep()
+{
+    // Stop when there's no more work to do.  The heap has just been
+    // collected, so this is when we take the autosave, if the game is at its
+    // command prompt; the save then doesn't need a collection of its own.
+    if (not vm_idle_gc_step()) {
+        this->fIdleGCTimer->stop();
+        vm_autosave();
+    }
+}
+
+
 void
 CHtmlSysFrameQt::get_input_cancel( int reset )
 {
@@ -911,13 +1220,17 @@ CHtmlSysFrameQt::get_input_event( unsigned long timeout, int use_timeout, os_eve
 {
     //qDebug() << Q_FUNC_INFO << "use_timeout:" << use_timeout;
 
-    // Flush and prune before input.
-    this->flush_txtbuf(true, false);
+    // Flush and prune before input.  The turn's output is complete, so it
+    // goes into the journal as a page.
+    this->fFlushTxtbuf(true, false, true);
+    this->fJournal->endPage();
     this->pruneParseTree();
 
     // Get the input.
     bool timedOut = false;
+    this->fBeginIdleGC();
     int res = this->fGameWin->getKeypress(timeout, use_timeout, &timedOut);
+    this->fEndIdleGC();
 
     // Return EOF if we're quitting the game.
     if (not this->fGameRunning) {
@@ -1140,3 +1453,22 @@ CHtmlSysFrameQt::get_exe_resource( const textchar_t* /*resname*/, size_t /*resna
 
     return false;
 }
+
+
+void
+CHtmlSysFrameQt::prefetch_resource( HTML_res_type_t res_type, const textchar_t* fname,
+                                    unsigned long seekpos, unsigned long siz )
+{
+    // We decode still images, and the sounds we decode with SDL_sound, in the
+    // background.  Ogg Vorbis and MIDI go through SDL_mixer, which we only use
+    // from the GUI thread.
+    if (res_type == HTML_res_type_JPEG) {
+        QTadsImagePrefetcher::prefetch(fnameToQStr(fname), seekpos, siz, "JPG");
+    } else if (res_type == HTML_res_type_PNG) {
+        QTadsImagePrefetcher::prefetch(fnameToQStr(fname), seekpos, siz, "PNG");
+    } else if (res_type == HTML_res_type_WAV) {
+        QTadsSound::prefetch(fname, seekpos, siz, QTadsSound::WAV);
+    } else if (res_type == HTML_res_type_MP123) {
+        QTadsSound::prefetch(fname, seekpos, siz, QTadsSound::MPEG);
+    }
+}
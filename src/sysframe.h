@@ -18,6 +18,8 @@
 #define SYSFRAME_H
 
 #include <QApplication>
+#include <QHash>
+#include <QTime>
 
 #include "htmlsys.h"
 #include "config.h"
@@ -40,11 +42,16 @@ class CHtmlSysFrameQt: public QApplication, public CHtmlSysFrame {
     appctxdef fAppctx;
 
     // Tads3 host and client services interfaces.
-    class CVmHostIfc* fHostifc;
+    class QTadsHostIfc* fHostifc;
     class CVmMainClientConsole* fClientifc;
 
     class CHtmlTextBuffer fBuffer;
 
+    // Journal of the game window's output, so that what gets pruned from
+    // the window can still be read.  Only used when there's a scrollback
+    // budget.
+    class QTadsScrollbackJournal* fJournal;
+
     // Main window.
     class CHtmlSysWinGroupQt* fMainWin;
 
@@ -67,6 +74,16 @@ class CHtmlSysFrameQt: public QApplication, public CHtmlSysFrame {
     // responsible for deleting them when they're no longer needed.
     QList<class CHtmlSysFontQt*> fFontList;
 
+    // Fonts we created, keyed by the font descriptor they were requested
+    // with (see fontDescKey() in sysframe.cc.)  This lets createFont() find
+    // an existing font without building a QFont first.  The fonts are owned
+    // by fFontList; this only points to them.
+    QHash<QByteArray, class CHtmlSysFontQt*> fFontHash;
+
+    // Bumped whenever the fonts we'd create for a descriptor might change.
+    // See CHtmlSysWin::get_font_generation().
+    unsigned long fFontGeneration;
+
     // Are we currently executing a game?
     bool fGameRunning;
 
@@ -80,19 +97,48 @@ class CHtmlSysFrameQt: public QApplication, public CHtmlSysFrame {
     // The game we should try to run after the current one ends.
     QString fNextGame;
 
+    // Command script to read the next game's input from, if any.
+    QString fReplayScript;
+
     // Is there a reformat pending?
     bool fReformatPending;
 
     // Current input font color.
     HTML_color_t fInputColor;
 
+    // Is there parsed output that still needs to be formatted?  Flushes
+    // requested by the VM are rate-limited to one format per frame; whatever
+    // arrives in between is picked up by a single-shot timer, or by the next
+    // forced flush, whichever comes first.
+    bool fFlushPending;
+
+    // When we last ran the formatter on flushed output.
+    QTime fLastFlushTime;
+
     // Are we in non-stop mode?
     bool fNonStopMode;
 
+    // Drives T3 garbage collection while we're waiting for input.
+    class QTimer* fIdleGCTimer;
+
+    // Start and stop running the T3 garbage collector in the background
+    // while we wait for input.  fEndIdleGC() must be called before control
+    // returns to the VM.
+    void
+    fBeginIdleGC();
+
+    void
+    fEndIdleGC();
+
     // Run the game file contained in fNextGame.
     void
     fRunGame();
 
+    // Implementation of flush_txtbuf().  Unless 'force' is set, formatting
+    // is deferred if we already formatted within the last frame.
+    void
+    fFlushTxtbuf( bool fmt, bool immediateRedraw, bool force );
+
     void
     fRunT2Game( const QString& fname );
 
@@ -111,6 +157,15 @@ class CHtmlSysFrameQt: public QApplication, public CHtmlSysFrame {
     static void
     fCtxGetIOSafetyLevel( void*, int* read, int* write );
 
+  private slots:
+    // Do one slice of idle-time garbage collection work.
+    void
+    fIdleGCStep();
+
+    // Format output whose flush was deferred by the frame-rate limit.
+    void
+    fFlushPendingOutput();
+
   signals:
     // Emitted just prior to starting a game.  The game has not started yet
     // when this is emitted.
@@ -143,6 +198,10 @@ class CHtmlSysFrameQt: public QApplication, public CHtmlSysFrame {
     gameWindow()
     { return this->fGameWin; }
 
+    class QTadsScrollbackJournal*
+    journal()
+    { return this->fJournal; }
+
     const QList<class CHtmlSysWinQt*>&
     bannerList()
     { return this->fBannerList; }
@@ -158,6 +217,10 @@ class CHtmlSysFrameQt: public QApplication, public CHtmlSysFrame {
     CHtmlSysFontQt*
     createFont( const CHtmlFontDesc* font_desc );
 
+    unsigned long
+    fontGeneration()
+    { return this->fFontGeneration; }
+
     bool
     gameRunning()
     { return this->fGameRunning; }
@@ -166,6 +229,16 @@ class CHtmlSysFrameQt: public QApplication, public CHtmlSysFrame {
     gameFile()
     { return this->fGameFile; }
 
+    // Returns the name of the file in our cache directory that holds data
+    // derived from the game file 'gameFile', with the given extension.  The
+    // name is derived from the game file's location, size and modification
+    // time, and from our version, so that a changed game or interpreter never
+    // picks up a stale cache file.  Returns an empty string if the game file
+    // doesn't exist or there's no cache directory.  The directory might not
+    // exist yet.
+    static QString
+    gameCacheFile( const QString& gameFile, const char* ext );
+
     void
     setGameRunning( bool f )
     {
@@ -175,6 +248,11 @@ class CHtmlSysFrameQt: public QApplication, public CHtmlSysFrame {
         }
     }
 
+    // Read the input of the next game we run from a command script.
+    void
+    setReplayScript( const QString& fname )
+    { this->fReplayScript = fname; }
+
     void
     setNextGame( const QString& fname )
     {
@@ -329,6 +407,10 @@ class CHtmlSysFrameQt: public QApplication, public CHtmlSysFrame {
     int
     get_exe_resource( const textchar_t* resname, size_t resnamelen, textchar_t* fname_buf, size_t fname_buf_len,
                       unsigned long* seek_pos, unsigned long* siz ) override;
+
+    void
+    prefetch_resource( HTML_res_type_t res_type, const textchar_t* fname, unsigned long seekpos,
+                       unsigned long siz ) override;
 };
 
 
@@ -16,11 +16,14 @@
  */
 #include <QFileInfo>
 #include <QBuffer>
+#include <QImageReader>
 
 #include "qtadsimage.h"
+#include "qtadsresdata.h"
 #include "sysimagejpeg.h"
 #include "sysimagepng.h"
 #include "sysimagemng.h"
+#include "vmtrace.h"
 
 
 /* Helper routine.  Loads any type of image from the specified offset inside
@@ -30,12 +33,14 @@
  * QImageReader::supportedImageFormats() (like "JPG", "PNG", etc.)
  */
 static CHtmlSysResource*
-createImageFromFile( const CHtmlUrl* /*url*/, const textchar_t* filename, unsigned long seekpos,
+createImageFromFile( const CHtmlUrl* url, const textchar_t* filename, unsigned long seekpos,
                      unsigned long filesize, CHtmlSysWin* /*win*/, const QString& imageType )
 {
     //qDebug() << "Loading" << imageType << "image from" << filename << "at offset" << seekpos
     //      << "with size" << filesize << "url:" << url->get_url();
 
+    CVmTraceSpan trace("resource", "load image", url->get_url());
+
     // Check if the file exists and is readable.
     QFileInfo inf(fnameToQStr(filename));
     if (not inf.exists() or not inf.isReadable()) {
@@ -43,18 +48,6 @@ createImageFromFile( const CHtmlUrl* /*url*/, const textchar_t* filename, unsign
         return 0;
     }
 
-    // Open the file and seek to the specified position.
-    QFile file(inf.filePath());
-    if (not file.open(QIODevice::ReadOnly)) {
-        qWarning() << "ERROR: Can't open file" << inf.filePath();
-        return 0;
-    }
-    if (not file.seek(seekpos)) {
-        qWarning() << "ERROR: Can't seek in file" << inf.filePath();
-        file.close();
-        return 0;
-    }
-
     CHtmlSysResource* image = NULL;
     // Better get an error at compile-time using static_cast rather than an
     // abort at runtime using dynamic_cast.
@@ -74,31 +67,63 @@ createImageFromFile( const CHtmlUrl* /*url*/, const textchar_t* filename, unsign
         mngCast = static_cast<CHtmlSysImageMngQt*>(image);
     } else {
         qWarning() << "ERROR: Unknown image type" << imageType;
-        file.close();
         return NULL;
     }
 
-    // Load the image data.
-    const QByteArray& data(file.read(filesize));
-    file.close();
-    if (data.isEmpty() or static_cast<unsigned long>(data.size()) < filesize) {
-        qWarning() << "ERROR: Could not read" << filesize << "bytes from file" << inf.filePath();
+    // If the image is still being decoded in the background, don't wait for
+    // it.  Layout only needs the dimensions, which we get from the header;
+    // the pixels are picked up when the image is first drawn.
+    if (cast != 0 and QTadsImagePrefetcher::isPending(fnameToQStr(filename), seekpos, filesize)) {
+        const QTadsResourceData data(filename, seekpos, filesize);
+        if (data.isValid()) {
+            QByteArray bytes(QByteArray::fromRawData(data.data(), static_cast<int>(data.size())));
+            QBuffer buf(&bytes);
+            buf.open(QBuffer::ReadOnly);
+            QImageReader reader(&buf, imageType.toLatin1());
+            const QSize& dimensions = reader.size();
+            if (dimensions.isValid()) {
+                cast->setPendingSource(fnameToQStr(filename), seekpos, filesize, imageType.toLatin1(),
+                                       dimensions);
+                return image;
+            }
+        }
+    }
+
+    // If the image was decoded in the background, just take the result.
+    if (cast != 0) {
+        QImage prefetched;
+        if (QTadsImagePrefetcher::take(fnameToQStr(filename), seekpos, filesize, &prefetched)) {
+            *static_cast<QImage*>(cast) = prefetched;
+            cast->setSource(fnameToQStr(filename), seekpos, filesize, imageType.toLatin1());
+            return image;
+        }
+    }
+
+    // Get at the image data.  This is normally mapped directly from the file,
+    // so for the still image types the decoder reads it in place.
+    const QTadsResourceData data(filename, seekpos, filesize);
+    if (not data.isValid()) {
         delete image;
         return 0;
     }
 
     if (imageType == QString::fromLatin1("MNG")) {
-        QBuffer* buf = new QBuffer(mngCast);
-        buf->setData(data);
-        buf->open(QBuffer::ReadOnly);
-        mngCast->setFormat("MNG");
-        mngCast->setDevice(buf);
-        mngCast->start();
-    } else if (not cast->loadFromData(data, imageType.toLatin1())) {
+        // The animation keeps reading its data while it plays, so it makes
+        // its own copy.
+        if (not mngCast->load(data.data(), data.size())) {
+            qWarning() << "ERROR: Could not parse image data";
+            delete image;
+            return 0;
+        }
+    } else if (not cast->loadFromData(reinterpret_cast<const uchar*>(data.data()),
+                                      static_cast<int>(data.size()), imageType.toLatin1())) {
         qWarning() << "ERROR: Could not parse image data";
         delete image;
         return 0;
     }
+    if (cast != 0) {
+        cast->setSource(fnameToQStr(filename), seekpos, filesize, imageType.toLatin1());
+    }
     return image;
 }
 
@@ -0,0 +1,342 @@
+/* Copyright (C) 2013 Nikos Chantziaras.
+ *
+ * This file is part of the QTads program.  This program is free software; you
+ * can redistribute it and/or modify it under the terms of the GNU General
+ * Public License as published by the Free Software Foundation; either version
+ * 2, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; see the file COPYING.  If not, write to the Free Software
+ * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <QBuffer>
+#include <QImageReader>
+#include <QList>
+#include <QMutex>
+#include <QPainter>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "sysimagemng.h"
+#include "qtadsimage.h"
+#include "syswin.h"
+
+
+/* Decoding state of an animation.  The reader is only ever used by one
+ * thread at a time: by a decoding job while 'running' is set, and by the GUI
+ * thread otherwise.  Everything else is protected by the mutex.
+ */
+class QTadsMngDecoder {
+  public:
+    // How many frames to decode ahead of the one on screen.
+    enum { kAhead = 4 };
+
+    struct Frame {
+        QImage image;
+        int delay;
+    };
+
+    QMutex mutex;
+    QByteArray data;
+    QBuffer buffer;
+    QImageReader* reader;
+    QList<Frame> queue;
+    bool running;
+    bool atEnd;
+    bool cancelled;
+
+    QTadsMngDecoder( const char* bytes, size_t len )
+        : data(bytes, static_cast<int>(len)),
+          reader(0),
+          running(false),
+          atEnd(false),
+          cancelled(false)
+    {
+        this->buffer.setBuffer(&this->data);
+        this->buffer.open(QBuffer::ReadOnly);
+        this->reader = new QImageReader(&this->buffer, "MNG");
+    }
+
+    ~QTadsMngDecoder()
+    { delete this->reader; }
+
+    // Start reading the animation from the beginning again.
+    void
+    rewind()
+    {
+        delete this->reader;
+        this->buffer.seek(0);
+        this->reader = new QImageReader(&this->buffer, "MNG");
+        this->atEnd = false;
+    }
+
+    // Decode frames until we're kAhead frames ahead or reach the end.
+    void
+    decode()
+    {
+        for (;;) {
+            {
+                QMutexLocker lock(&this->mutex);
+                if (this->cancelled or this->queue.size() >= kAhead) {
+                    this->running = false;
+                    return;
+                }
+            }
+            Frame frame;
+            frame.image = this->reader->read();
+            frame.delay = this->reader->nextImageDelay();
+            QMutexLocker lock(&this->mutex);
+            if (frame.image.isNull()) {
+                this->atEnd = true;
+                this->running = false;
+                return;
+            }
+            this->queue.append(frame);
+        }
+    }
+};
+
+
+class QTadsMngDecodeJob: public QRunnable {
+  private:
+    QSharedPointer<QTadsMngDecoder> fDecoder;
+
+  public:
+    QTadsMngDecodeJob( const QSharedPointer<QTadsMngDecoder>& decoder )
+        : fDecoder(decoder)
+    { }
+
+    void
+    run() override
+    { this->fDecoder->decode(); }
+};
+
+
+CHtmlSysImageMngQt::CHtmlSysImageMngQt()
+    : fDispSite(0),
+      fTimer(new QTimer(this)),
+      fFrameBytes(0),
+      fCaching(true),
+      fCached(false),
+      fFrame(0),
+      fLoopsLeft(-1),
+      fPaused(false),
+      fStopped(false)
+{
+    this->fTimer->setSingleShot(true);
+    connect(this->fTimer, SIGNAL(timeout()), this, SLOT(fNextFrame()));
+}
+
+
+CHtmlSysImageMngQt::~CHtmlSysImageMngQt()
+{
+    if (this->fDecoder) {
+        QMutexLocker lock(&this->fDecoder->mutex);
+        this->fDecoder->cancelled = true;
+    }
+    QTadsImage::releaseBytes(this->fFrameBytes);
+}
+
+
+bool
+CHtmlSysImageMngQt::load( const char* data, size_t len )
+{
+    this->fDecoder = QSharedPointer<QTadsMngDecoder>(new QTadsMngDecoder(data, len));
+    QImageReader* reader = this->fDecoder->reader;
+    if (not reader->canRead()) {
+        return false;
+    }
+    this->fSize = reader->size();
+
+    // The loop count is the number of times to repeat the animation after
+    // the first pass.
+    this->fLoopsLeft = reader->loopCount();
+
+    // Decode the first frame right away, so that we have something to show
+    // and know our size.
+    this->fDecoder->decode();
+    if (this->fDecoder->queue.isEmpty()) {
+        return false;
+    }
+    if (not this->fSize.isValid()) {
+        this->fSize = this->fDecoder->queue.first().image.size();
+    }
+    this->fNextFrame();
+    return true;
+}
+
+
+void
+CHtmlSysImageMngQt::fDecodeAhead()
+{
+    QMutexLocker lock(&this->fDecoder->mutex);
+    if (this->fDecoder->running or this->fDecoder->atEnd
+        or this->fDecoder->queue.size() > QTadsMngDecoder::kAhead / 2)
+    {
+        return;
+    }
+    this->fDecoder->running = true;
+    QThreadPool::globalInstance()->start(new QTadsMngDecodeJob(this->fDecoder));
+}
+
+
+void
+CHtmlSysImageMngQt::fDropCache()
+{
+    this->fCaching = false;
+    this->fFrames.clear();
+    this->fDelays.clear();
+    QTadsImage::releaseBytes(this->fFrameBytes);
+    this->fFrameBytes = 0;
+}
+
+
+bool
+CHtmlSysImageMngQt::fLoop()
+{
+    if (this->fLoopsLeft == 0) {
+        return false;
+    }
+    if (this->fLoopsLeft > 0) {
+        --this->fLoopsLeft;
+    }
+    if (this->fCaching) {
+        // We've seen the whole animation and it fit.  From now on, play it
+        // from the cache; we don't need the decoder anymore.
+        this->fCaching = false;
+        this->fCached = true;
+        this->fDecoder.clear();
+    } else if (not this->fCached) {
+        // The decoder's job is done when it's at the end, so it's ours to
+        // rewind.
+        this->fDecoder->rewind();
+    }
+    this->fFrame = 0;
+    return true;
+}
+
+
+void
+CHtmlSysImageMngQt::fShow( const QPixmap& frame, int delay )
+{
+    this->fCurrent = frame;
+    if (this->fDispSite != 0) {
+        this->fDispSite->dispsite_inval(0, 0, this->fSize.width(), this->fSize.height());
+    }
+    this->fTimer->start(qMax(delay, 1));
+}
+
+
+void
+CHtmlSysImageMngQt::fNextFrame()
+{
+    if (this->fPaused or this->fStopped) {
+        return;
+    }
+
+    if (this->fCached) {
+        if (this->fFrame >= this->fFrames.size() and not this->fLoop()) {
+            return;
+        }
+        this->fShow(this->fFrames.at(this->fFrame), this->fDelays.at(this->fFrame));
+        ++this->fFrame;
+        return;
+    }
+
+    QTadsMngDecoder::Frame frame;
+    bool atEnd;
+    {
+        QMutexLocker lock(&this->fDecoder->mutex);
+        if (not this->fDecoder->queue.isEmpty()) {
+            frame = this->fDecoder->queue.takeFirst();
+        }
+        atEnd = this->fDecoder->atEnd and this->fDecoder->queue.isEmpty();
+    }
+
+    if (frame.image.isNull()) {
+        if (not atEnd) {
+            // The decoder hasn't caught up yet.  Check back shortly.
+            this->fDecodeAhead();
+            this->fTimer->start(5);
+        } else if (this->fLoop()) {
+            if (not this->fCached) {
+                this->fDecodeAhead();
+            }
+            this->fTimer->start(0);
+        }
+        return;
+    }
+    this->fDecodeAhead();
+
+    const QPixmap& pixmap = QPixmap::fromImage(frame.image);
+    if (this->fCaching) {
+        const qint64 bytes = static_cast<qint64>(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+        const qint64 budget = QTadsImage::budgetBytes();
+        if (this->fFrames.size() >= kMaxCachedFrames
+            or (budget > 0 and this->fFrameBytes + bytes > budget / 4)
+            or not QTadsImage::reserveBytes(bytes))
+        {
+            this->fDropCache();
+        } else {
+            this->fFrames.append(pixmap);
+            this->fDelays.append(frame.delay);
+            this->fFrameBytes += bytes;
+        }
+    }
+    this->fShow(pixmap, frame.delay);
+}
+
+
+void
+CHtmlSysImageMngQt::cancel_playback()
+{
+    this->fStopped = true;
+    this->fTimer->stop();
+}
+
+
+void
+CHtmlSysImageMngQt::pause_playback()
+{
+    this->fPaused = true;
+    this->fTimer->stop();
+}
+
+
+void
+CHtmlSysImageMngQt::resume_playback()
+{
+    if (not this->fPaused) {
+        return;
+    }
+    this->fPaused = false;
+    this->fNextFrame();
+}
+
+
+void
+CHtmlSysImageMngQt::draw_image( CHtmlSysWin* win, CHtmlRect* pos, htmlimg_draw_mode_t mode )
+{
+    if (this->fCurrent.isNull()) {
+        return;
+    }
+    QPainter painter(static_cast<CHtmlSysWinQt*>(win)->widget());
+    if (mode == HTMLIMG_DRAW_CLIP) {
+        painter.drawPixmap(pos->left, pos->top, this->fCurrent, 0, 0,
+                           qMin(this->fCurrent.width(), static_cast<int>(pos->right - pos->left)),
+                           qMin(this->fCurrent.height(), static_cast<int>(pos->bottom - pos->top)));
+    } else if (mode == HTMLIMG_DRAW_STRETCH) {
+        painter.drawPixmap(QRect(pos->left, pos->top, pos->right - pos->left, pos->bottom - pos->top),
+                           this->fCurrent);
+    } else {
+        painter.drawTiledPixmap(pos->left, pos->top, pos->right - pos->left, pos->bottom - pos->top,
+                                this->fCurrent);
+    }
+}
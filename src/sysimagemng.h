@@ -14,13 +14,17 @@
  * this program; see the file COPYING.  If not, write to the Free Software
  * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
+
 #ifndef SYSIMAGEMNG_H
 #define SYSIMAGEMNG_H
 
 #include <QDebug>
-#include <QMovie>
+#include <QObject>
+#include <QPixmap>
+#include <QSharedPointer>
+#include <QVector>
 
-#include "qtadsimage.h"
+#include "htmlsys.h"
 #include "config.h"
 
 
@@ -29,26 +33,79 @@
  *
  * See htmltads/htmlsys.h and htmltads/notes/porting.htm for information
  * about this class.
+ *
+ * Frames are decoded on the global thread pool, a few frames ahead of the
+ * one on screen, so several animations playing at once don't decode on the
+ * GUI thread as their timers fire.  While the first pass of an animation
+ * plays, we also keep its frames as pixmaps.  If the whole animation fits
+ * (see kMaxCachedFrames, and a quarter of the image memory budget), it then
+ * loops from those without decoding anything again.  Longer animations keep
+ * decoding ahead on each pass instead.
  */
-class CHtmlSysImageMngQt: public QMovie, public CHtmlSysImageMng {
+class CHtmlSysImageMngQt: public QObject, public CHtmlSysImageMng {
     Q_OBJECT
 
   private:
+    enum { kMaxCachedFrames = 120 };
+
     CHtmlSysImageDisplaySite* fDispSite;
 
+    // Decodes frames in the background.  Shared with the decoding job that's
+    // running, if any, so that it outlives us if we're deleted first.  Null
+    // once we've cached the whole animation.
+    QSharedPointer<class QTadsMngDecoder> fDecoder;
+
+    class QTimer* fTimer;
+    QSize fSize;
+
+    // The frame on screen.
+    QPixmap fCurrent;
+
+    // Frames seen so far in the first pass, while fCaching is set, and the
+    // whole animation once fCached is set.
+    QVector<QPixmap> fFrames;
+    QVector<int> fDelays;
+    qint64 fFrameBytes;
+    bool fCaching;
+    bool fCached;
+
+    // Next frame to show from fFrames.
+    int fFrame;
+
+    // How many more times to play the animation after the current pass; -1
+    // means forever.
+    int fLoopsLeft;
+
+    bool fPaused;
+    bool fStopped;
+
+    // Queue a decoding job if the decoder is running low on frames.
+    void
+    fDecodeAhead();
+
+    // Stop caching frames, and give back what we cached.
+    void
+    fDropCache();
+
+    // Start the next pass of the animation, if there is one.
+    bool
+    fLoop();
+
+    void
+    fShow( const QPixmap& frame, int delay );
+
   private slots:
     void
-    updateDisplay( const QRect& rect )
-    {
-        if (this->fDispSite != 0) {
-            this->fDispSite->dispsite_inval(rect.x(), rect.y(), rect.width(), rect.height());
-        }
-    }
+    fNextFrame();
 
   public:
-    CHtmlSysImageMngQt()
-    : fDispSite(0)
-    { connect(this, SIGNAL(updated(QRect)), this, SLOT(updateDisplay(QRect))); }
+    CHtmlSysImageMngQt();
+    ~CHtmlSysImageMngQt() override;
+
+    // Starts playing the animation in 'data', of 'len' bytes.  We make our
+    // own copy.  Returns false if the data isn't a usable MNG.
+    bool
+    load( const char* data, size_t len );
 
     //
     // CHtmlSysImageMng interface implementation.
@@ -58,28 +115,24 @@ class CHtmlSysImageMngQt: public QMovie, public CHtmlSysImageMng {
     { this->fDispSite = dispSite; }
 
     void
-    cancel_playback() override
-    { this->stop(); }
+    cancel_playback() override;
 
     void
-    pause_playback() override
-    { this->setPaused(true); }
+    pause_playback() override;
 
     void
-    resume_playback() override
-    { this->setPaused(false); }
+    resume_playback() override;
 
     void
-    draw_image( CHtmlSysWin* win, CHtmlRect* pos, htmlimg_draw_mode_t mode ) override
-    { QTadsImage(this->currentImage()).drawFromPaintEvent(win, pos, mode); }
+    draw_image( CHtmlSysWin* win, CHtmlRect* pos, htmlimg_draw_mode_t mode ) override;
 
     unsigned long
     get_width() const override
-    { return this->frameRect().width(); }
+    { return this->fSize.width(); }
 
     unsigned long
     get_height() const override
-    { return this->frameRect().height(); }
+    { return this->fSize.height(); }
 
     int
     map_palette( CHtmlSysWin*, int ) override
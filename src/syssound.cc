@@ -23,9 +23,12 @@
 #include "sysframe.h"
 #include "settings.h"
 #include "syssoundmidi.h"
+#include "qtadsresdata.h"
+#include "qtadssound.h"
 #include "syssoundwav.h"
 #include "syssoundogg.h"
 #include "syssoundmpeg.h"
+#include "vmtrace.h"
 
 
 #ifndef Q_OS_ANDROID
@@ -55,7 +58,7 @@ CHtmlSysSoundMidiQt::~CHtmlSysSoundMidiQt()
         CHtmlSysSoundMidiQt::fActiveMidi = 0;
     }
     Mix_FreeMusic(this->fMusic);
-    SDL_FreeRW(this->fRWops);
+    SDL_RWclose(this->fRWops);
 }
 
 
@@ -163,13 +166,19 @@ CHtmlSysSoundMidiQt::cancel_sound( CHtmlSysWin*, int, long, int )
 
 
 CHtmlSysResource*
-CHtmlSysSoundMidi::create_midi( const CHtmlUrl* /*url*/, const textchar_t* filename, unsigned long seekpos,
+CHtmlSysSoundMidi::create_midi( const CHtmlUrl* url, const textchar_t* filename, unsigned long seekpos,
                                 unsigned long filesize, CHtmlSysWin* )
 #ifndef Q_OS_ANDROID
 {
     //qDebug() << "Loading sound from" << filename << "offset:" << seekpos << "size:" << filesize
     //      << "url:" << url->get_url();
 
+    CVmTraceSpan trace("resource", "load sound", url->get_url());
+
+    if (not ensureSound()) {
+        return 0;
+    }
+
     // Check if the file exists and is readable.
     QFileInfo inf(fnameToQStr(filename));
     if (not inf.exists() or not inf.isReadable()) {
@@ -177,24 +186,13 @@ CHtmlSysSoundMidi::create_midi( const CHtmlUrl* /*url*/, const textchar_t* filen
         return 0;
     }
 
-    // Open the file and seek to the specified position.
-    QFile file(inf.filePath());
-    if (not file.open(QIODevice::ReadOnly)) {
-        qWarning() << "ERROR: Can't open file" << inf.filePath();
-        return 0;
-    }
-    if (not file.seek(seekpos)) {
-        qWarning() << "ERROR: Can't seek in file" << inf.filePath();
-        file.close();
-        return 0;
-    }
-    QByteArray data(file.read(filesize));
-    file.close();
-    if (data.isEmpty() or static_cast<unsigned long>(data.size()) < filesize) {
-        qWarning() << "ERROR: Could not read" << filesize << "bytes from file" << inf.filePath();
+    // The music decoder keeps reading while the music plays, so rather than
+    // loading the whole resource into memory, we stream it from the file.
+    SDL_RWops* rw = createResourceRWops(filename, seekpos, filesize);
+    if (rw == 0) {
         return 0;
     }
-    return new CHtmlSysSoundMidiQt(SDL_RWFromConstMem(data.constData(), data.size()));
+    return new CHtmlSysSoundMidiQt(rw);
 }
 #else
 {
@@ -59,6 +59,12 @@ class CHtmlSysSoundMpegQt: public QTadsSound, public CHtmlSysSoundMpeg {
 
     void
     resume() override;
+
+#ifndef Q_OS_ANDROID
+    void
+    set_layer_priority( int pri ) override
+    { this->setLayerPriority(pri); }
+#endif
 };
 
 
@@ -59,6 +59,12 @@ class CHtmlSysSoundOggQt: public QTadsSound, public CHtmlSysSoundOgg {
 
     void
     resume() override;
+
+#ifndef Q_OS_ANDROID
+    void
+    set_layer_priority( int pri ) override
+    { this->setLayerPriority(pri); }
+#endif
 };
 
 
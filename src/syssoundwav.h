@@ -58,6 +58,12 @@ class CHtmlSysSoundWavQt: public QTadsSound, public CHtmlSysSoundWav {
 
     void
     resume() override;
+
+#ifndef Q_OS_ANDROID
+    void
+    set_layer_priority( int pri ) override
+    { this->setLayerPriority(pri); }
+#endif
 };
 
 
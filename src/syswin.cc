@@ -18,6 +18,7 @@
 #include <QPainter>
 #include <QScrollBar>
 #include <QResizeEvent>
+#include <QTimer>
 #include <qdrawutil.h>
 
 #include "dispwidget.h"
@@ -41,6 +42,9 @@ CHtmlSysWinQt::CHtmlSysWinQt( CHtmlFormatter* formatter, QWidget* parent )
       fBannerStyleBorder(0),
       fBorderLine(qWinGroup->centralWidget()),
       fDontReformat(0),
+      fFormatPending(false),
+      fFormatHeight(0),
+      fNeedsReformat(false),
       fInPagePauseMode(false),
       fParentBanner(0),
       fBgImage(0),
@@ -386,6 +390,7 @@ CHtmlSysWinQt::calcChildBannerSizes( QRect& parentSize )
         //if (this != qFrame->gameWindow())
         //qDebug() << newSize.width();
         //if (newSize.width() != oldSize.width())
+        this->fNeedsReformat = true;
         qFrame->scheduleReformat();
     }
 
@@ -397,22 +402,115 @@ CHtmlSysWinQt::calcChildBannerSizes( QRect& parentSize )
 void
 CHtmlSysWinQt::doReformat( int showStatus, int freezeDisplay, int resetSounds )
 {
+    this->fNeedsReformat = false;
+
     // Forget any tracking links.
     this->dispWidget->notifyClearContents();
 
     // Restart the formatter.
     this->formatter_->start_at_top(resetSounds);
 
-    // Format the window contents.
-    this->do_formatting(showStatus, not freezeDisplay, freezeDisplay);
+    // Banners are small, so we simply format them all at once.
+    if (this != qFrame->gameWindow()) {
+        this->do_formatting(showStatus, not freezeDisplay, freezeDisplay);
+        // Reset last seen position.  Substract the top margin when doing this,
+        // since for scrolling purposes we need to take the whole area into
+        // account, not only the position where actual content starts.
+        this->lastInputHeight = this->formatter_->get_max_y_pos() - this->formatter_->get_phys_margins().top;
+        return;
+    }
+
+    // The game window can hold a very long transcript.  Laying it out has to
+    // proceed from the top, so we can't format just the visible part first;
+    // instead, we format it in slices from the event loop, so that the
+    // interface stays responsive (a burst of resize events during a window
+    // drag would otherwise reformat the whole transcript for each one.)  Any
+    // caller that needs the layout to be complete (new output, input) will
+    // finish it synchronously through do_formatting().
+    if (not this->fFormatPending) {
+        this->fFormatHeight = this->dispWidget->height();
+        this->fFormatPending = true;
+    }
+    this->fContinueFormatting();
+}
+
+
+void
+CHtmlSysWinQt::fContinueFormatting()
+{
+    // Nothing to do if the reformat has been completed in the meantime.  If
+    // we're called from inside the event loop while do_formatting() is
+    // active, try again later.
+    if (not this->fFormatPending) {
+        return;
+    }
+    if (this->fDontReformat != 0) {
+        QTimer::singleShot(0, this, SLOT(fContinueFormatting()));
+        return;
+    }
+
+    // Format for a limited amount of time.
+    QTime t;
+    t.start();
+    this->formatter_->freeze_display(true);
+    while (this->formatter_->more_to_do() and t.elapsed() < 25) {
+        this->formatter_->do_formatting();
+    }
+    this->formatter_->freeze_display(false);
+
+    if (this->formatter_->more_to_do()) {
+        // Show what we have so far and continue later.
+        this->fResizeDisplayWidget();
+        this->dispWidget->update();
+        QTimer::singleShot(0, this, SLOT(fContinueFormatting()));
+        return;
+    }
 
-    // Reset last seen position.  Substract the top margin when doing this,
-    // since for scrolling purposes we need to take the whole area into
-    // account, not only the position where actual content starts.
+    this->fFormatPending = false;
+    this->fResizeDisplayWidget();
+    this->dispWidget->update();
+    this->dispWidget->updateLinkTracking(QPoint());
     this->lastInputHeight = this->formatter_->get_max_y_pos() - this->formatter_->get_phys_margins().top;
 }
 
 
+void
+CHtmlSysWinQt::finishPendingReformat()
+{
+    if (not this->fFormatPending or this->fDontReformat != 0) {
+        return;
+    }
+    while (this->formatter_->more_to_do()) {
+        this->formatter_->do_formatting();
+    }
+    this->fContinueFormatting();
+}
+
+
+void
+CHtmlSysWinQt::fResizeDisplayWidget()
+{
+    if (this->fBannerStyleGrid) {
+        this->dispWidget->resize(this->viewport()->size());
+        return;
+    }
+
+    long newWidth;
+    if (this->formatter_->get_outer_max_line_width() > this->viewport()->width()) {
+        newWidth = this->formatter_->get_outer_max_line_width();
+    } else {
+        newWidth = this->viewport()->width();
+    }
+    long newHeight = this->formatter_->get_max_y_pos();
+    // While a reformat is still in progress, the old layout's height is a
+    // better estimate of the final height than what we have so far.
+    if (this->fFormatPending and newHeight < this->fFormatHeight) {
+        newHeight = this->fFormatHeight;
+    }
+    this->dispWidget->resize(newWidth, newHeight);
+}
+
+
 void
 CHtmlSysWinQt::addBanner( CHtmlSysWinQt* banner, HTML_BannerWin_Type_t type, int where,
                           CHtmlSysWinQt* other, HTML_BannerWin_Pos_t pos, unsigned long style )
@@ -568,7 +666,8 @@ CHtmlSysWinQt::measure_text( CHtmlSysFont* font, const textchar_t* str, size_t l
 {
     //qDebug() << Q_FUNC_INFO;
 
-    const QFontMetrics& tmpMetr = QFontMetrics(*static_cast<CHtmlSysFontQt*>(font));
+    const CHtmlSysFontQt* qFont = static_cast<CHtmlSysFontQt*>(font);
+    const QFontMetrics& tmpMetr = qFont->metrics();
     if (ascent != 0) {
         *ascent = tmpMetr.ascent();
     }
@@ -576,7 +675,7 @@ CHtmlSysWinQt::measure_text( CHtmlSysFont* font, const textchar_t* str, size_t l
     // subsequent text should be drawn.  This is really what our caller needs
     // to know, otherwise letters will start jumping left and right when
     // selecting text or moving the text cursor.
-    return CHtmlPoint(tmpMetr.width(QString::fromUtf8(str, len)), tmpMetr.height());
+    return CHtmlPoint(qFont->textAdvance(str, len), tmpMetr.height());
 }
 
 
@@ -628,6 +727,14 @@ CHtmlSysWinQt::draw_text( int hilite, long x, long y, CHtmlSysFont* font, const
 
     QPainter painter(this->dispWidget);
     this->fSetupPainterForFont(painter, hilite, font);
+#if QT_VERSION >= 0x040700
+    // Draw the cached layout, unless we need an opaque background; static
+    // text doesn't paint one.
+    if (painter.backgroundMode() != Qt::OpaqueMode) {
+        painter.drawStaticText(x, y, static_cast<CHtmlSysFontQt*>(font)->staticText(str, len));
+        return;
+    }
+#endif
     painter.drawText(x, y + painter.fontMetrics().ascent(), QString::fromUtf8(str, len));
 }
 
@@ -759,6 +866,10 @@ CHtmlSysWinQt::do_formatting( int /*show_status*/, int update_win, int freeze_di
     // We don't have enough formatting done yet to draw the window.
     bool drawn = false;
 
+    // If a sliced reformat is pending, we're about to finish it here.
+    bool finishingReformat = this->fFormatPending;
+    this->fFormatPending = false;
+
     // Reformat everything, drawing as soon as possible, if desired.
     /*
     if (update_win) {
@@ -797,16 +908,9 @@ CHtmlSysWinQt::do_formatting( int /*show_status*/, int update_win, int freeze_di
         this->formatter_->freeze_display(false);
     }
 
-    if (this->fBannerStyleGrid) {
-        this->dispWidget->resize(this->viewport()->size());
-    } else {
-        long newWidth;
-        if (this->formatter_->get_outer_max_line_width() > this->viewport()->width()) {
-            newWidth = this->formatter_->get_outer_max_line_width();
-        } else {
-            newWidth = this->viewport()->width();
-        }
-        this->dispWidget->resize(newWidth, this->formatter_->get_max_y_pos());
+    this->fResizeDisplayWidget();
+    if (finishingReformat) {
+        this->lastInputHeight = this->formatter_->get_max_y_pos() - this->formatter_->get_phys_margins().top;
     }
 
     // If we didn't do any drawing, and we updated the window coming in,
@@ -1212,6 +1316,8 @@ CHtmlSysWinQt::set_html_bg_image( CHtmlResCacheObject* image )
         castImg = reinterpret_cast<QTadsImage*>(image->get_image());
     }
 
+    // The image might have been dropped from memory.
+    castImg->touch();
     QPalette p(this->palette());
     p.setBrush(QPalette::Base, *castImg);
     this->setPalette(p);
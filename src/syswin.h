@@ -59,6 +59,20 @@ class CHtmlSysWinQt: public QScrollArea, public CHtmlSysWin {
     // Guard against re-entrancy for do_formatting().
     int fDontReformat;
 
+    // Is a full reformat still in progress?  A reformat of the game window
+    // is done in slices from the event loop so that resizing the window
+    // with a long transcript doesn't freeze the interface.  While this is
+    // set, the display widget keeps at least fFormatHeight pixels of height
+    // (the height of the previous layout) so that the scrollbar doesn't
+    // jump around while the rest of the text is being laid out.
+    bool fFormatPending;
+    int fFormatHeight;
+
+    // Has our size changed since we were last reformatted?  Set by
+    // calcChildBannerSizes() so that a pending reformat only needs to touch
+    // the windows that were actually resized.
+    bool fNeedsReformat;
+
     // Are we currently in page-pause mode?
     bool fInPagePauseMode;
 
@@ -77,6 +91,15 @@ class CHtmlSysWinQt: public QScrollArea, public CHtmlSysWin {
     void
     fSetupPainterForFont( QPainter& painter, bool hilite, CHtmlSysFont* font );
 
+    // Resize the display widget to fit the formatted contents.
+    void
+    fResizeDisplayWidget();
+
+  private slots:
+    // Format another slice of a pending reformat.
+    void
+    fContinueFormatting();
+
   protected:
     // The content height at the time of the last user input.  When the
     // formatter is producing a long run of output, we pause between screens to
@@ -115,6 +138,10 @@ class CHtmlSysWinQt: public QScrollArea, public CHtmlSysWin {
     void
     mousePressEvent( QMouseEvent* e ) override;
 
+    // If a reformat is still being done in the background, complete it now.
+    void
+    finishPendingReformat();
+
   public:
     CHtmlSysWinQt( class CHtmlFormatter* formatter, QWidget* parent );
     ~CHtmlSysWinQt() override;
@@ -135,6 +162,11 @@ class CHtmlSysWinQt: public QScrollArea, public CHtmlSysWin {
     void
     doReformat( int showStatus, int freezeDisplay, int resetSounds );
 
+    // Has our size changed since our last reformat?
+    bool
+    needsReformat() const
+    { return this->fNeedsReformat; }
+
     void
     addBanner( CHtmlSysWinQt* banner, HTML_BannerWin_Type_t type, int where, CHtmlSysWinQt* other,
                HTML_BannerWin_Pos_t pos, unsigned long style );
@@ -241,6 +273,10 @@ class CHtmlSysWinQt: public QScrollArea, public CHtmlSysWin {
     get_bullet_font( CHtmlSysFont* current_font ) override
     { return current_font; }
 
+    unsigned long
+    get_font_generation() override
+    { return qFrame->fontGeneration(); }
+
     void
     register_timer_func( void (*timer_func)( void* ), void* func_ctx ) override;
 
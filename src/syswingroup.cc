@@ -26,6 +26,8 @@
 #include <QDesktopServices>
 #include <QClipboard>
 #include <QMimeData>
+#include <QLabel>
+#include <QStatusBar>
 
 #include "syswininput.h"
 #include "syswinaboutbox.h"
@@ -34,6 +36,8 @@
 #include "gameinfodialog.h"
 #include "aboutqtadsdialog.h"
 #include "dispwidget.h"
+#include "perfstats.h"
+#include "historydialog.h"
 
 
 void
@@ -69,6 +73,7 @@ CHtmlSysWinGroupQt::CHtmlSysWinGroupQt()
       fAboutBoxDialog(0),
       fAboutBox(0),
       fAboutQtadsDialog(0),
+      fHistoryDialog(0),
       fNetManager(0),
       fWantsToQuit(false),
       fSilentIfNoUpdates(false)
@@ -167,6 +172,14 @@ CHtmlSysWinGroupQt::CHtmlSysWinGroupQt()
 #endif
     menu->addAction(act);
     connect(act, SIGNAL(triggered()), this, SLOT(fShowConfDialog()));
+    this->fPerfOverlayAction = new QAction(tr("Performance &Overlay"), this);
+    this->fPerfOverlayAction->setCheckable(true);
+    menu->addAction(this->fPerfOverlayAction);
+    connect(this->fPerfOverlayAction, SIGNAL(toggled(bool)), this, SLOT(fTogglePerfOverlay(bool)));
+    this->fHistoryAction = new QAction(tr("Scrollback &History..."), this);
+    this->fHistoryAction->setEnabled(false);
+    menu->addAction(this->fHistoryAction);
+    connect(this->fHistoryAction, SIGNAL(triggered()), this, SLOT(fShowHistory()));
 
     // "Help" menu.
     menu = menuBar->addMenu(tr("&Help"));
@@ -183,8 +196,11 @@ CHtmlSysWinGroupQt::CHtmlSysWinGroupQt()
 
     this->setMenuBar(menuBar);
 
-    // Create a default status bar.
-    this->statusBar();
+    // Create a default status bar.  The performance overlay lives in it, and
+    // stays hidden until it's turned on.
+    this->fPerfLabel = new QLabel(this);
+    this->fPerfLabel->hide();
+    this->statusBar()->addPermanentWidget(this->fPerfLabel);
 
     // Set up our central widget.
     this->fFrame = new QTadsFrame(this);
@@ -564,6 +580,9 @@ void
 CHtmlSysWinGroupQt::fNotifyGameStarting()
 {
     this->fHideGameInfoDialog();
+    // The history belongs to the previous game.
+    this->fHideHistory();
+    this->fHistoryAction->setEnabled(qFrame->settings()->scrollbackBudget > 0);
     this->fGameInfoAction->setEnabled(GameInfoDialog::gameHasMetaInfo(qStrToFname(qFrame->gameFile())));
     this->fRestartCurrentGameAction->setEnabled(true);
     this->fEndCurrentGameAction->setEnabled(true);
@@ -624,9 +643,9 @@ CHtmlSysWinGroupQt::dropEvent( QDropEvent* e )
 void
 CHtmlSysWinGroupQt::copyToClipboard()
 {
-    const QString& selectedText = DisplayWidget::selectedText();
-    if (not selectedText.isEmpty()) {
-        QApplication::clipboard()->setText(selectedText);
+    QMimeData* mime = DisplayWidget::selectedMimeData();
+    if (mime != 0) {
+        QApplication::clipboard()->setMimeData(mime);
     }
 }
 
@@ -647,6 +666,41 @@ CHtmlSysWinGroupQt::fRunDropEventFile()
 }
 
 
+void
+CHtmlSysWinGroupQt::fTogglePerfOverlay( bool show )
+{
+    QTadsPerfStats::setEnabled(show, show ? this->fPerfLabel : 0);
+    this->fPerfLabel->setVisible(show);
+}
+
+
+void
+CHtmlSysWinGroupQt::fShowHistory()
+{
+    if (this->fHistoryDialog != 0) {
+        this->fHistoryDialog->activateWindow();
+        this->fHistoryDialog->raise();
+        return;
+    }
+
+    this->fHistoryDialog = new HistoryDialog(qFrame->journal(), this);
+    connect(this->fHistoryDialog, SIGNAL(finished(int)), this, SLOT(fHideHistory()));
+    connect(this->fHistoryDialog, SIGNAL(finished(int)), SLOT(fActivateWindow()));
+    this->fHistoryDialog->show();
+}
+
+
+void
+CHtmlSysWinGroupQt::fHideHistory()
+{
+    // The dialog holds everything it paged in, so don't keep it around.
+    if (this->fHistoryDialog != 0) {
+        this->fHistoryDialog->deleteLater();
+        this->fHistoryDialog = 0;
+    }
+}
+
+
 void
 CHtmlSysWinGroupQt::updatePasteAction()
 {
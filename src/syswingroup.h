@@ -69,6 +69,10 @@ class CHtmlSysWinGroupQt: public QMainWindow, public CHtmlSysWinGroup {
     class QAction* fAboutQtadsAction;
     class QAction* fCopyAction;
     class QAction* fPasteAction;
+    class QAction* fPerfOverlayAction;
+    class QAction* fHistoryAction;
+    class HistoryDialog* fHistoryDialog;
+    class QLabel* fPerfLabel;
     class QNetworkAccessManager* fNetManager;
     class QNetworkReply* fReply;
     QString fGameFileFromDropEvent;
@@ -141,6 +145,15 @@ class CHtmlSysWinGroupQt: public QMainWindow, public CHtmlSysWinGroup {
     void
     fRunDropEventFile();
 
+    void
+    fTogglePerfOverlay( bool show );
+
+    void
+    fShowHistory();
+
+    void
+    fHideHistory();
+
     void
     fActivateWindow()
     { this->activateWindow(); }
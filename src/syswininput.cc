@@ -111,7 +111,17 @@ void CHtmlSysWinInputQt::fUpdateInputFormatter()
     if (this->fTag == 0) {
         return;
     }
-    this->fTag->setlen(static_cast<CHtmlFormatterInput*>(this->formatter_), this->fTadsBuffer->getlen());
+    CHtmlFormatterInput* formatter = static_cast<CHtmlFormatterInput*>(this->formatter_);
+    // Keys that only move the caret or the selection leave the text as it
+    // is, so there's nothing to lay out again; only the cursor moves.
+    if (formatter->is_input_current(this->fTag, this->fTadsBuffer->getbuf(), this->fTadsBuffer->getlen())) {
+        if (this->fTag->ready_to_format()) {
+            this->verticalScrollBar()->triggerAction(QAbstractSlider::SliderToMaximum);
+        }
+        this->fCastDispWidget->updateCursorPos(this->formatter_, false, true);
+        return;
+    }
+    this->fTag->setlen(formatter, this->fTadsBuffer->getlen());
     if (this->fTag->ready_to_format()) {
         this->fTag->format(static_cast<CHtmlSysWinQt*>(this), this->formatter_);
         this->verticalScrollBar()->triggerAction(QAbstractSlider::SliderToMaximum);
@@ -456,6 +466,7 @@ CHtmlSysWinInputQt::getInput( textchar_t* buf, size_t buflen, unsigned long time
     } else {
         // Since we're not resuming, make sure that we've formatted all
         // available input and tell the formatter to begin a new input.
+        this->finishPendingReformat();
         while (formatter->more_to_do()) {
             formatter->do_formatting();
         }
@@ -488,6 +499,11 @@ CHtmlSysWinInputQt::getInput( textchar_t* buf, size_t buflen, unsigned long time
         QEventLoop idleLoop;
         QTimer timer;
         timer.setSingleShot(true);
+#if QT_VERSION >= 0x050000
+        // Real-time games rely on their input timeouts; don't let Qt coalesce
+        // them with other timers.
+        timer.setTimerType(Qt::PreciseTimer);
+#endif
         connect(&timer, SIGNAL(timeout()), &idleLoop, SLOT(quit()));
         connect(qFrame, SIGNAL(gameQuitting()), &idleLoop, SLOT(quit()));
         connect(this, SIGNAL(inputReady()), &idleLoop, SLOT(quit()));
@@ -588,6 +604,7 @@ CHtmlSysWinInputQt::getKeypress( unsigned long timeout, bool useTimeout, bool* t
 
     // Prepare the formatter for input and format all remaining lines.
     CHtmlFormatterInput* formatter = static_cast<CHtmlFormatterInput*>(this->formatter_);
+    this->finishPendingReformat();
     formatter->prepare_for_input();
     while (formatter->more_to_do()) {
         formatter->do_formatting();
@@ -610,6 +627,11 @@ CHtmlSysWinInputQt::getKeypress( unsigned long timeout, bool useTimeout, bool* t
         QEventLoop idleLoop;
         QTimer timer;
         timer.setSingleShot(true);
+#if QT_VERSION >= 0x050000
+        // Real-time games rely on their input timeouts; don't let Qt coalesce
+        // them with other timers.
+        timer.setTimerType(Qt::PreciseTimer);
+#endif
         connect(&timer, SIGNAL(timeout()), &idleLoop, SLOT(quit()));
         connect(qFrame, SIGNAL(gameQuitting()), &idleLoop, SLOT(quit()));
         connect(this, SIGNAL(inputReady()), &idleLoop, SLOT(quit()));
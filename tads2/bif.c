@@ -1547,6 +1547,7 @@ void bifund(bifcxdef *ctx, int argc)
         if (ucx)
         {
             objundo(mcx, ucx);         /* try to undo to previous savepoint */
+            vocacinv(ctx->bifcxrun->runcxvoc);
             undone = TRUE;                       /* looks like we succeeded */
         }
         else
@@ -1850,7 +1851,7 @@ void bifgfu(bifcxdef *ctx, int argc)
         func = runpopfn(rcx);
         runpop(rcx, &val);
 
-        for (slots = vcx->voccxfuc, daem = vcx->voccxfus ;
+        for (slots = vcx->voccxfuu, daem = vcx->voccxfus ;
              slots ; ++daem, --slots)
         {
             if (daem->vocdfn == func
@@ -1866,7 +1867,7 @@ void bifgfu(bifcxdef *ctx, int argc)
         func = runpopobj(rcx);
         prop = runpopprp(rcx);
 
-        for (slots = vcx->voccxalc, daem = vcx->voccxalm ;
+        for (slots = vcx->voccxalu, daem = vcx->voccxalm ;
              slots ; ++daem, --slots)
         {
             if (daem->vocdfn == func && daem->vocdprp == prop)
@@ -122,6 +122,60 @@ void vocdmnclr(voccxdef *ctx)
     vocdmn1clr(ctx->voccxfus, ctx->voccxfuc);
     vocdmn1clr(ctx->voccxdmn, ctx->voccxdmc);
     vocdmn1clr(ctx->voccxalm, ctx->voccxalc);
+    ctx->voccxfuu = ctx->voccxdmu = ctx->voccxalu = 0;
+}
+
+/*
+ *   Find the in-use bound for the array containing a given slot, and the
+ *   slot's index in the array.  Returns null if the slot isn't in any of
+ *   our arrays.  
+ */
+static uint *vocdbnd(voccxdef *ctx, vocddef *what, uint *idx)
+{
+    if (what >= ctx->voccxdmn && what < ctx->voccxdmn + ctx->voccxdmc)
+    {
+        *idx = (uint)(what - ctx->voccxdmn);
+        return &ctx->voccxdmu;
+    }
+    if (what >= ctx->voccxfus && what < ctx->voccxfus + ctx->voccxfuc)
+    {
+        *idx = (uint)(what - ctx->voccxfus);
+        return &ctx->voccxfuu;
+    }
+    if (what >= ctx->voccxalm && what < ctx->voccxalm + ctx->voccxalc)
+    {
+        *idx = (uint)(what - ctx->voccxalm);
+        return &ctx->voccxalu;
+    }
+    return 0;
+}
+
+/* note that a slot has come into use, raising its array's bound */
+static void vocdbnduse(voccxdef *ctx, vocddef *what)
+{
+    uint *bnd;
+    uint  idx;
+
+    if ((bnd = vocdbnd(ctx, what, &idx)) != 0 && idx >= *bnd)
+        *bnd = idx + 1;
+}
+
+/* 
+ *   note that a slot has been freed; if it was the last one in use,
+ *   lower its array's bound past any free slots below it 
+ */
+static void vocdbndfre(voccxdef *ctx, vocddef *what)
+{
+    uint *bnd;
+    uint  idx;
+
+    if ((bnd = vocdbnd(ctx, what, &idx)) != 0 && idx + 1 == *bnd)
+    {
+        vocddef *base = what - idx;
+
+        while (*bnd != 0 && base[*bnd - 1].vocdfn == MCMONINV)
+            --*bnd;
+    }
 }
 
 /* save undo information for a daemon/fuse/notifier */
@@ -167,6 +221,10 @@ void vocdundo(void *ctx0, uchar *data)
     case VOC_UNDO_DAEMON:
         memcpy(&daemon, data + 1, (size_t)sizeof(daemon));
         memcpy(daemon, data + 1 + sizeof(daemon), (size_t)sizeof(*daemon));
+
+        /* if we've brought the slot back into use, cover it in the bound */
+        if (daemon->vocdfn != MCMONINV)
+            vocdbnduse(ctx, daemon);
         break;
 
     case VOC_UNDO_NEWOBJ:
@@ -446,6 +504,7 @@ void vocsetfd(voccxdef *ctx, vocddef *what, objnum func, prpnum prop,
                 OSCPYSTRUCT(what->vocdarg, *val);
             what->vocdprp = prop;
             what->vocdtim = tm;
+            vocdbnduse(ctx, what);
 
             /* 
              *   the fuse/notifier/daemon is set - no need to look further
@@ -465,9 +524,9 @@ void vocremfd(voccxdef *ctx, vocddef *what, objnum func, prpnum prop,
 {
     int      slots;
     
-    if (what == ctx->voccxdmn) slots = ctx->voccxdmc;
-    else if (what == ctx->voccxalm) slots = ctx->voccxalc;
-    else if (what == ctx->voccxfus) slots = ctx->voccxfuc;
+    if (what == ctx->voccxdmn) slots = ctx->voccxdmu;
+    else if (what == ctx->voccxalm) slots = ctx->voccxalu;
+    else if (what == ctx->voccxfus) slots = ctx->voccxfuu;
     else errsig(ctx->voccxerr, ERR_BADREMF);
     
     /* find the slot with this same fuse/daemon/notifier, and remove it */
@@ -484,6 +543,7 @@ void vocremfd(voccxdef *ctx, vocddef *what, objnum func, prpnum prop,
             vocdusav(ctx, what);
 
             what->vocdfn = MCMONINV;
+            vocdbndfre(ctx, what);
             return;
         }
     }
@@ -511,7 +571,7 @@ void vocturn(voccxdef *ctx, int turncnt, int do_fuses)
         do_exe = FALSE;
         
         /* go through notifiers, looking for fuse-type notifiers */
-        for (i = ctx->voccxalc, p = ctx->voccxalm ; i ; ++p, --i)
+        for (i = ctx->voccxalu, p = ctx->voccxalm ; i ; ++p, --i)
         {
             if (p->vocdfn != MCMONINV
                 && p->vocdtim != VOCDTIM_EACH_TURN
@@ -526,7 +586,7 @@ void vocturn(voccxdef *ctx, int turncnt, int do_fuses)
         }
         
         /* now go through the fuses */
-        for (i = ctx->voccxfuc, p = ctx->voccxfus ; i ; ++p, --i)
+        for (i = ctx->voccxfuu, p = ctx->voccxfus ; i ; ++p, --i)
         {
             if (p->vocdfn != MCMONINV && p->vocdtim != 0)
             {
@@ -598,12 +658,17 @@ void exedaem(voccxdef *ctx)
 {
     runcxdef *rcx = ctx->voccxrun;
     vocddef  *daemon;
-    int       i;
+    uint      i;
     runsdef   val;
     int       err;
 
-    for (i = ctx->voccxdmc, daemon = ctx->voccxdmn ; i ; ++daemon, --i)
+    /* 
+     *   check the in-use bound on each iteration, since a daemon can set
+     *   or remove others as it runs 
+     */
+    for (i = 0 ; i < ctx->voccxdmu ; ++i)
     {
+        daemon = ctx->voccxdmn + i;
         if (daemon->vocdfn != MCMONINV)
         {
             objnum thisd = daemon->vocdfn;
@@ -620,8 +685,9 @@ void exedaem(voccxdef *ctx)
             ERREND(ctx->voccxerr)
         }
     }
-    for (i = ctx->voccxalc, daemon = ctx->voccxalm ; i ; ++daemon, --i)
+    for (i = 0 ; i < ctx->voccxalu ; ++i)
     {
+        daemon = ctx->voccxalm + i;
         if (daemon->vocdfn != MCMONINV
             && daemon->vocdtim == VOCDTIM_EACH_TURN)
         {
@@ -645,14 +711,15 @@ int exefuse(voccxdef *ctx, int do_run)
 {
     runcxdef *rcx = ctx->voccxrun;
     vocddef  *daemon;
-    int       i;
+    uint      i;
     int       found = FALSE;
     runsdef   val;
     int       err;
 
     /* first, execute any expired function-based fuses */
-    for (i = ctx->voccxfuc, daemon = ctx->voccxfus ; i ; ++daemon, --i)
+    for (i = 0 ; i < ctx->voccxfuu ; ++i)
     {
+        daemon = ctx->voccxfus + i;
         if (daemon->vocdfn != MCMONINV && daemon->vocdtim == 0)
         {
             objnum thisf = daemon->vocdfn;
@@ -665,6 +732,7 @@ int exefuse(voccxdef *ctx, int do_run)
 
             /* remove the fuse prior to running  */
             daemon->vocdfn = MCMONINV;
+            vocdbndfre(ctx, daemon);
 
             if (do_run)
             {
@@ -681,8 +749,9 @@ int exefuse(voccxdef *ctx, int do_run)
     }
 
     /* next, execute any expired method-based notifier fuses */
-    for (i = ctx->voccxalc, daemon = ctx->voccxalm ; i ; ++daemon, --i)
+    for (i = 0 ; i < ctx->voccxalu ; ++i)
     {
+        daemon = ctx->voccxalm + i;
         if (daemon->vocdfn != MCMONINV && daemon->vocdtim == 0)
         {
             objnum thisa = daemon->vocdfn;
@@ -695,6 +764,7 @@ int exefuse(voccxdef *ctx, int do_run)
 
             /* delete it prior to running it */
             daemon->vocdfn = MCMONINV;
+            vocdbndfre(ctx, daemon);
 
             if (do_run)
                 runppr(rcx, thisa, daemon->vocdprp, 0);
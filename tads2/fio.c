@@ -225,6 +225,119 @@ static void fiordrscext(errcxdef *ec, osfildef *fp, appctxdef *appctx,
     }
 }
 
+/*
+ *   Read the OBJ section of a game file through an in-memory copy.  We
+ *   read the entire section with one file read, then register each object
+ *   with the cache manager straight from memory, exactly as we would when
+ *   reading the headers from the file one at a time; ordinary objects are
+ *   still loaded on demand later.  The file must be positioned at the
+ *   start of the section's contents ('curpos').  Returns FALSE, without
+ *   reading anything, if the section is too big to buffer or we can't
+ *   allocate the memory, in which case the caller must read the section
+ *   the slow way.  
+ */
+static int fiordobj(mcmcxdef *mctx, voccxdef *vctx, osfildef *fp,
+                    ulong curpos, ulong endpos, int flags)
+{
+    errcxdef *ec = vctx->voccxerr;
+    ulong     siz;
+    ulong     rem;
+    ulong     siz2;
+    uint      sizcur;
+    uchar    *bufp;
+    uchar    *p;
+    uchar    *p1;
+    uint      len;
+    int       obj;
+    runxdef  *ex;
+
+    /* allocate space for the section, if we can */
+    siz = endpos - curpos;
+    if (siz == 0 || siz >= OSMALMAX
+        || (bufp = (uchar *)osmalloc((size_t)siz)) == 0)
+        return FALSE;
+
+    /* read it */
+    for (p1 = bufp, siz2 = siz ; siz2 ; siz2 -= sizcur, p1 += sizcur)
+    {
+        sizcur = (siz2 > (uint)0xffff ? (uint)0xffff : siz2);
+        if (osfrb(fp, p1, sizcur))
+            goto bad_file;
+    }
+
+    /* run through the records */
+    for (p = bufp, rem = siz ; rem != 0 ; p += len, rem -= len)
+    {
+        /* make sure the basic header is present */
+        if (rem < 3)
+            goto bad_file;
+        obj = osrp2(p + 1);
+
+        switch(*p)
+        {
+        case TOKSTFUNC:
+        case TOKSTOBJ:
+            /* register the object for loading on demand */
+            if (rem < 7 || (len = osrp2(p + 5) + 7) > rem)
+                goto bad_file;
+            mcmrsrv(mctx, (ushort)osrp2(p + 3), (mcmon)obj,
+                    (mclhd)curpos);
+
+            /* load object if preloading */
+            if (flags & 2)
+            {
+                (void)mcmlck(mctx, (mcmon)obj);
+                mcmunlck(mctx, (mcmon)obj);
+            }
+            break;
+
+        case TOKSTFWDOBJ:
+        case TOKSTFWDFN:
+        {
+            uchar *objp;
+
+            /* allocate the object and copy it in */
+            if (rem < 5 || (len = osrp2(p + 3) + 5) > rem)
+                goto bad_file;
+            objp = mcmalonum(mctx, (ushort)(len - 5), (mcmon)obj);
+            memcpy(objp, p + 5, (size_t)(len - 5));
+            mcmunlck(mctx, (mcmon)obj);
+            break;
+        }
+
+        case TOKSTEXTERN:
+            if (!vctx->voccxrun->runcxext)
+            {
+                osfree(bufp);
+                errsig(ec, ERR_UNXEXT);
+            }
+            if (rem < 4 || (len = p[3] + 4) > rem)
+                goto bad_file;
+            ex = &vctx->voccxrun->runcxext[obj];
+            memcpy(ex->runxnam, p + 4, (size_t)p[3]);
+            ex->runxnam[p[3]] = '\0';
+            break;
+
+        default:
+            osfree(bufp);
+            errsig(ec, ERR_UNKOTYP);
+        }
+
+        /* the next record starts after this one */
+        curpos += len;
+    }
+
+    /* done with the copy of the section */
+    osfree(bufp);
+    return TRUE;
+
+bad_file:
+    osfree(bufp);
+    errsig(ec, ERR_RDGAM);
+    NOTREACHEDV(int);
+    return FALSE;
+}
+
 /*
  *   read a game from a binary file
  *
@@ -308,7 +421,17 @@ static void fiord1(mcmcxdef *mctx, voccxdef *vctx, tokcxdef *tctx,
                 continue;
             }
 
+            /* 
+             *   read the whole section in a single file read if we can,
+             *   rather than doing two small reads and a seek per object 
+             */
             curpos = osfpos(fp) - startofs;
+            if (fiordobj(mctx, vctx, fp, curpos, endpos, flags))
+            {
+                osfseek(fp, endpos + startofs, OSFSK_SET);
+                continue;
+            }
+
             while (curpos != endpos)
             {
                 /* read type and object number */
@@ -1149,7 +1272,7 @@ void fiord(mcmcxdef *mctx, voccxdef *vctx, tokcxdef *tctx, char *fname,
 #define FIOSAVVSN1 "v2.2.0"
 
 /* read fuse/daemon/alarm record */
-static int fiorfda(osfildef *fp, vocddef *p, uint cnt)
+static int fiorfda(osfildef *fp, vocddef *p, uint cnt, uint *bnd)
 {
     vocddef *q;
     uint     i;
@@ -1158,6 +1281,7 @@ static int fiorfda(osfildef *fp, vocddef *p, uint cnt)
     /* start by clearing out entire record */
     for (i = 0, q = p ; i < cnt ; ++q, ++i)
         q->vocdfn = MCMONINV;
+    *bnd = 0;
     
     /* now restore all the records from the file */
     for (;;)
@@ -1166,8 +1290,10 @@ static int fiorfda(osfildef *fp, vocddef *p, uint cnt)
         if (osfrb(fp, buf, 13)) return(TRUE);
         if ((i = osrp2(buf)) == 0xffff) return(FALSE);
         
-        /* restore this record */
+        /* restore this record, and cover it in the in-use bound */
         q = p + i;
+        if (i >= *bnd)
+            *bnd = i + 1;
         q->vocdfn = osrp2(buf+2);
         q->vocdarg.runstyp = buf[4];
         switch(buf[4])
@@ -1444,9 +1570,9 @@ int fiorso(voccxdef *vctx, char *fname)
     }
     
     /* read fuses/daemons/alarms */
-    if (fiorfda(fp, vctx->voccxdmn, vctx->voccxdmc)
-        || fiorfda(fp, vctx->voccxfus, vctx->voccxfuc)
-        || fiorfda(fp, vctx->voccxalm, vctx->voccxalc))
+    if (fiorfda(fp, vctx->voccxdmn, vctx->voccxdmc, &vctx->voccxdmu)
+        || fiorfda(fp, vctx->voccxfus, vctx->voccxfuc, &vctx->voccxfuu)
+        || fiorfda(fp, vctx->voccxalm, vctx->voccxalc, &vctx->voccxalu))
         goto ret_error;
 
     /* read the dynamically added and deleted vocabulary */
@@ -27,12 +27,70 @@ Modified
   04/16/92 MJRoberts   - creation
 */
 
+#include <string.h>
+
 #include "os.h"
 #include "std.h"
 #include "fio.h"
 
+/*
+ *   Each byte is XOR'ed with the low-order byte of the seed, and the seed
+ *   goes up by 'inc' for each byte, so the key stream depends only on the
+ *   low-order bytes of the seed and increment, and repeats every 256
+ *   bytes.  We keep one full period of the key stream for the most recent
+ *   seed/increment pair (the loader always uses the same pair), extended
+ *   by one machine word so that a whole word of key can be read starting
+ *   at any position, and XOR large blocks a word at a time.  
+ */
+#define FIOXPER 256
+
+static uchar fioxkey[FIOXPER + sizeof(ulong)];
+static uint  fioxseed;
+static uint  fioxinc;
+static int   fioxinit = FALSE;
+
 void fioxor(uchar *p, uint siz, uint seed, uint inc)
 {
-    for ( ; siz ; seed += inc, --siz)
-        *p++ ^= (uchar)seed;
+    uint  i;
+    uint  k;
+    ulong wd;
+    ulong wk;
+
+    /* do short blocks directly - they're not worth looking up the key */
+    if (siz < 2 * sizeof(ulong))
+    {
+        for ( ; siz ; seed += inc, --siz)
+            *p++ ^= (uchar)seed;
+        return;
+    }
+
+    /* build the key stream for this seed and increment if necessary */
+    seed &= 0xff;
+    inc &= 0xff;
+    if (!fioxinit || seed != fioxseed || inc != fioxinc)
+    {
+        for (i = 0, k = seed ; i < sizeof(fioxkey) ; ++i, k += inc)
+            fioxkey[i] = (uchar)k;
+        fioxseed = seed;
+        fioxinc = inc;
+        fioxinit = TRUE;
+    }
+
+    /* 
+     *   XOR a word at a time; the word size divides the period evenly, so
+     *   the key position wraps exactly at the end of the period 
+     */
+    for (i = 0 ; siz >= sizeof(ulong) ;
+         siz -= sizeof(ulong), p += sizeof(ulong))
+    {
+        memcpy(&wd, p, sizeof(wd));
+        memcpy(&wk, fioxkey + i, sizeof(wk));
+        wd ^= wk;
+        memcpy(p, &wd, sizeof(wd));
+        i = (i + sizeof(ulong)) & (FIOXPER - 1);
+    }
+
+    /* finish up any remaining bytes */
+    for ( ; siz ; --siz, ++i)
+        *p++ ^= fioxkey[i];
 }
@@ -27,6 +27,9 @@ Modified
 #include "mch.h"
 #include "err.h"
 
+/* object modification generation (see mcm.h) */
+ulong mcmgen = 1;
+
 /* get an unused object cache entry, allocating a new page if needed */
 static mcmodef *mcmoal(mcmcx1def *ctx, mcmon *objnum);
 
@@ -112,12 +115,21 @@ mcmcxdef *mcmcini(mcmcx1def *globalctx, uint pages,
     ret->mcmcxrvc = revertctx;
     ret->mcmcxflg = 0;
     memset(ret->mcmcxmtb, 0, (size_t)(pages * sizeof(mcmon *)));
+
+    /* 
+     *   a new context can reuse the memory of an old one, so make sure
+     *   nothing remembered about the old one still looks current 
+     */
+    ++mcmgen;
     return(ret);
 }
 
 /* uninitialize a client context */
 void mcmcterm(mcmcxdef *ctx)
 {
+    /* everything in the context's objects is going away */
+    ++mcmgen;
+
     /* delete the context memory */
     mchfre(ctx);
 }
@@ -228,6 +240,9 @@ void mcmterm(mcmcx1def *ctx)
 {
     mcmhdef *cur, *nxt;
     
+    /* the whole cache is going away */
+    ++mcmgen;
+
     /* 
      *   Free each chunk in the cache block list, *except* the last one.  The
      *   last one is special: it's actually the first chunk allocated, since
@@ -1173,6 +1188,9 @@ void mcmcswf(mcmcx1def *ctx, mcmon objn, mcsseg swapn, mcsseg oldswapn)
 
 void mcmfre(mcmcxdef *ctx, mcmon obj)
 {
+    /* the object's contents are going away */
+    ++mcmgen;
+
     /* free the actual object */
     mcmgfre(ctx->mcmcxgl, mcmc2g(ctx, obj));
 
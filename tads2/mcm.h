@@ -289,9 +289,22 @@ uchar *mcmrealo(mcmcxdef *ctx, mcmon objnum, ushort newsize);
  */
 /* void mcmtch(mcmcxdef *ctx, mcmon objnum); */
 #define mcmtch(ctx,obj) \
-  (mcmobje(ctx,obj)->mcmoflg |= MCMOFDIRTY)
+  (++mcmgen, mcmobje(ctx,obj)->mcmoflg |= MCMOFDIRTY)
 /* was: (mcmobje(ctx,obj)->mcmoflg |= (MCMOFDIRTY | MCMOFNODISC)) */
 
+/*
+ *   Modification generation counter.  This is incremented whenever any
+ *   object in any cache context is touched, reverted, or freed, and
+ *   whenever a cache or client context is created or deleted, so a client
+ *   that caches information derived from object contents can tell that its
+ *   cached information might be stale simply by remembering the generation
+ *   number in effect when the information was computed.  The counter is
+ *   shared by all contexts and never goes backwards, so a value remembered
+ *   from a context that has since been deleted can never come to look
+ *   current again, even if a new context gets the same address.  
+ */
+extern ulong mcmgen;
+
 /* get size of a cache manager object - object need not be locked */
 /* ushort mcmobjsiz(mcmcxdef *ctx, mcmon objn); */
 #define mcmobjsiz(ctx, objn) (mcmobje(ctx, objn)->mcmosiz)
@@ -320,7 +333,7 @@ void mcmfre(mcmcxdef *ctx, mcmon obj);
  */
 /* void mcmrevert(mcmcxdef *ctx, mcmon objn); */
 #define mcmrevert(ctx, objn) \
- ((mcmobje(ctx, objn)->mcmoflg & MCMOFPRES) ? \
+ (++mcmgen, (mcmobje(ctx, objn)->mcmoflg & MCMOFPRES) ? \
   ((*(ctx)->mcmcxrvf)((ctx)->mcmcxrvc, objn), DISCARD 0) \
   : DISCARD (mcmobje(ctx, objn)->mcmoflg |= MCMOFREVRT))
 
@@ -356,7 +369,12 @@ uchar *mcmalo0(mcmcxdef *ctx, ushort siz, mcmon *nump, mcmon clinum,
 void mcmgfre(mcmcx1def *ctx, mcmon obj);
 
 /* "use" an object (move to most-recent position in LRU chain) */
+#ifdef MCM_FLAT
+/* the flat heap never swaps, so it doesn't keep an LRU chain */
+# define mcmuse(ctx, n) ((void)0)
+#else /* MCM_FLAT */
 void mcmuse(mcmcx1def *ctx, mcmon n);
+#endif /* MCM_FLAT */
 
 /*
  *   Load or swap in a cache object which is currently unloaded, locking
@@ -0,0 +1,643 @@
+/*
+ *   Copyright (c) 1991, 2002 Michael J. Roberts.  All Rights Reserved.
+ *
+ *   Please see the accompanying license file, LICENSE.TXT, for information
+ *   on using and copying this software.
+ */
+/*
+Name
+  mcmflat.c - memory cache manager, flat heap version
+Function
+  Implements the memory cache manager interface with a flat in-memory
+  object store.
+Notes
+  This is a drop-in alternative to mcm.c for hosts with plenty of memory.
+  Rather than sub-allocating objects out of large chunks, and compacting
+  and swapping the chunks to stay within a fixed budget, we give each
+  object its own block from the low-level heap.  Objects therefore never
+  move (except when reallocated to a larger size) and are never swapped
+  out or discarded, so locking an object that's present is just a flag
+  update, and unlocking doesn't need to maintain an LRU chain.
+
+  The object header tables, the client mapping tables, and the interface
+  (including the lock/unlock macros in mcm.h) are the same as in the
+  paged version.  Build with MCM_FLAT defined, and with this file in
+  place of mcm.c.
+
+  Each object's block is preceded by a small header that records the
+  allocated capacity, so that an object can grow in place when it was
+  allocated with room to spare.
+Modified
+  10/14/26  - Creation
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "os.h"
+#include "mcm.h"
+#include "mch.h"
+#include "err.h"
+
+/*
+ *   Object block header.  Each object's memory is preceded by one of
+ *   these, padded to the alignment size.
+ */
+typedef struct mcmfblk mcmfblk;
+struct mcmfblk
+{
+    ushort  mcmfcap;                          /* allocated size of the block */
+};
+
+/* size of the block header, rounded for alignment */
+#define MCMFHDR osrndsz(sizeof(mcmfblk))
+
+/* get the block header from an object's memory pointer */
+#define mcmfhdr(p) ((mcmfblk *)((p) - MCMFHDR))
+
+/* object modification generation (see mcm.h) */
+ulong mcmgen = 1;
+
+/* get an unused object cache entry, allocating a new page if needed */
+static mcmodef *mcmoal(mcmcx1def *ctx, mcmon *objnum);
+
+/* add page pagenum, initializing entries after firstunu to unused */
+static void mcmadpg(mcmcx1def *ctx, uint pagenum, mcmon firstunu);
+
+/* allocate a memory block with the given capacity */
+static uchar *mcmfalo(mcmcx1def *ctx, ushort cap);
+
+/* free a memory block */
+static void mcmffre(uchar *p);
+
+#ifdef DEBUG
+# define MCMCLICTX(ctx) assert(*(((ulong *)ctx) - 1) == 0x02020202)
+# define MCMGLBCTX(ctx) assert(*(((ulong *)ctx) - 1) == 0x01010101)
+#else /* DEBUG */
+# define MCMCLICTX(ctx)
+# define MCMGLBCTX(ctx)
+#endif /* DEBUG */
+
+/* initialize a new client context */
+mcmcxdef *mcmcini(mcmcx1def *globalctx, uint pages,
+                  void (*loadfn)(void *, mclhd, uchar *, ushort),
+                  void *loadctx,
+                  void (*revertfn)(void *, mcmon), void *revertctx)
+{
+    mcmcxdef *ret;
+    ushort    siz;
+
+    siz = sizeof(mcmcxdef) + sizeof(mcmon *) * (pages - 1);
+    IF_DEBUG(siz += sizeof(ulong));
+
+    ret = (mcmcxdef *)mchalo(globalctx->mcmcxerr, siz, "mcm client context");
+    IF_DEBUG((*(ulong *)ret = 0x02020202,
+              ret = (mcmcxdef *)((uchar *)ret + sizeof(ulong))));
+
+    ret->mcmcxmsz = pages;
+    ret->mcmcxgl = globalctx;
+    ret->mcmcxldf = loadfn;
+    ret->mcmcxldc = loadctx;
+    ret->mcmcxrvf = revertfn;
+    ret->mcmcxrvc = revertctx;
+    ret->mcmcxflg = 0;
+    memset(ret->mcmcxmtb, 0, (size_t)(pages * sizeof(mcmon *)));
+
+    /* 
+     *   a new context can reuse the memory of an old one, so make sure
+     *   nothing remembered about the old one still looks current 
+     */
+    ++mcmgen;
+    return(ret);
+}
+
+/* uninitialize a client context */
+void mcmcterm(mcmcxdef *ctx)
+{
+    /* everything in the context's objects is going away */
+    ++mcmgen;
+
+    /* delete the context memory */
+    mchfre(ctx);
+}
+
+/*
+ *   Initialize a new global context.  'max' is ignored, since we never
+ *   swap; we still set up the swap manager, because its context is part of
+ *   ours and other subsystems look at its file information.
+ */
+mcmcx1def *mcmini(ulong max, uint pages, ulong swapsize,
+                  osfildef *swapfp, char *swapfilename, errcxdef *errctx)
+{
+    mcmcx1def *ctx;
+    uchar     *noreg p;
+    uint       siz;
+    int        err;
+
+    NOREG((&p))
+
+    VARUSED(max);
+
+    /* allocate the context and the page table together */
+    siz = sizeof(mcmcx1def) + pages * sizeof(mcmodef *);
+    IF_DEBUG(siz += sizeof(ulong));
+    p = mchalo(errctx, siz, "mcmini");
+    IF_DEBUG((*(ulong *)p = 0x01010101, p += sizeof(ulong)));
+    ctx = (mcmcx1def *)p;
+
+    /* initialize swapper; clean up if it fails */
+    ERRBEGIN(errctx)
+        mcsini(&ctx->mcmcxswc, ctx, swapsize, swapfp, swapfilename, errctx);
+    ERRCATCH(errctx, err)
+        mcsclose(&ctx->mcmcxswc);
+        mchfre(ctx);
+        errsig(errctx, err);
+    ERREND(errctx)
+
+    /* set up the page table, with no pages yet */
+    ctx->mcmcxtab = (mcmodef **)(p + sizeof(mcmcx1def));
+    memset(ctx->mcmcxtab, 0, (size_t)(pages * sizeof(mcmodef *)));
+
+    /* we don't use the heap chain, free list, or LRU chain */
+    ctx->mcmcxhpch = (mcmhdef *)0;
+    ctx->mcmcxlru = ctx->mcmcxmru = MCMONINV;
+    ctx->mcmcxfre = MCMONINV;
+    ctx->mcmcxmax = 0;
+
+    /* set up the rest of the context */
+    ctx->mcmcxunu = MCMONINV;
+    ctx->mcmcxpage = 0;
+    ctx->mcmcxpgmx = pages;
+    ctx->mcmcxerr = errctx;
+    ctx->mcmcxcsw = mcmcswf;
+
+    /*
+     *   Allocate the first page.  Reserve global object 0, so that object
+     *   numbers line up with the paged version (which uses object 0 for its
+     *   first page).
+     */
+    ctx->mcmcxtab[0] = (mcmodef *)mchalo(errctx, MCMPAGESIZE, "mcmini");
+    memset(ctx->mcmcxtab[0], 0, (size_t)MCMPAGESIZE);
+    ctx->mcmcxpage = 1;
+    mcmgobje(ctx, (mcmon)0)->mcmoflg = MCMOFPAGE | MCMOFNODISC | MCMOFNOSWAP;
+    mcmadpg(ctx, 0, 1);
+
+    return(ctx);
+}
+
+/*
+ *   Uninitialize the cache manager.  Frees each object still in memory,
+ *   the header pages, and the context itself.
+ */
+void mcmterm(mcmcx1def *ctx)
+{
+    uint     i;
+    uint     j;
+    mcmodef *o;
+
+    /* the whole cache is going away */
+    ++mcmgen;
+
+    for (i = 0 ; i < ctx->mcmcxpage ; ++i)
+    {
+        /* free the memory of each present object in this page */
+        for (j = 0, o = ctx->mcmcxtab[i] ; j < MCMPAGECNT ; ++j, ++o)
+        {
+            if ((o->mcmoflg & (MCMOFPRES | MCMOFPAGE)) == MCMOFPRES)
+                mcmffre(o->mcmoptr);
+        }
+
+        /* free the page */
+        mchfre(ctx->mcmcxtab[i]);
+    }
+
+    /* close the swapper */
+    mcsclose(&ctx->mcmcxswc);
+
+    /* free the context */
+    IF_DEBUG(ctx = (mcmcx1def *)(((ulong *)ctx) - 1));
+    mchfre(ctx);
+}
+
+/*
+ *   Allocate a memory block with room for 'cap' bytes, and set up its
+ *   header.  Returns a pointer to the object memory (just past the header).
+ */
+static uchar *mcmfalo(mcmcx1def *ctx, ushort cap)
+{
+    uchar *p;
+
+    /* allocate the block; mchalo signals an error if this fails */
+    p = mchalo(ctx->mcmcxerr, (size_t)cap + MCMFHDR, "mcmfalo");
+
+    /* set up the header, and return the object memory */
+    p += MCMFHDR;
+    mcmfhdr(p)->mcmfcap = cap;
+    return(p);
+}
+
+/* free a memory block allocated with mcmfalo */
+static void mcmffre(uchar *p)
+{
+    mchfre(p - MCMFHDR);
+}
+
+static void mcmcliexp(mcmcxdef *cctx, mcmon clinum)
+{
+    /* add global number to client mapping table at client number */
+    if (cctx->mcmcxmtb[clinum >> 8] == (mcmon *)0)
+    {
+        mcmcx1def *ctx = cctx->mcmcxgl;
+        int        i;
+        mcmon     *p;
+
+        /* this page is not allocated - allocate it */
+        p = (mcmon *)mchalo(ctx->mcmcxerr, (256 * sizeof(mcmon)),
+                            "client mapping page");
+        cctx->mcmcxmtb[clinum >> 8] = p;
+        for (i = 0 ; i < 256 ; ++i) *p++ = MCMONINV;
+    }
+}
+
+/* allocate a new object, locked, with memory of exactly the given size */
+uchar *mcmalo0(mcmcxdef *cctx, ushort siz, mcmon *nump,
+               mcmon clinum, int noclitrans)
+{
+    mcmcx1def *ctx = cctx->mcmcxgl;                       /* global context */
+    mcmon      glb;                       /* global object number allocated */
+    mcmodef   *o;
+
+    MCMCLICTX(cctx);
+    MCMGLBCTX(ctx);
+
+    /* round size to appropriate multiple */
+    siz = osrndsz(siz);
+
+    /* keep the same size limit as the paged version */
+    if (siz > MCMCHUNK)
+        errsig(ctx->mcmcxerr, ERR_BIGOBJ);
+
+    /* get a header */
+    o = mcmoal(ctx, &glb);
+    if (!o) errsig(ctx->mcmcxerr, ERR_NOMEM1);
+
+    /* allocate the memory */
+    o->mcmoptr = mcmfalo(ctx, siz);
+    o->mcmosiz = siz;
+    o->mcmoflg = MCMOFNODISC | MCMOFLOCK | MCMOFPRES;
+    o->mcmolcnt = 1;
+
+    if (noclitrans)
+    {
+        *nump = glb;
+        return(o->mcmoptr);
+    }
+
+    /* we have an object - generate client number */
+    if (clinum == MCMONINV)
+    {
+        /* find a free number */
+        mcmon **p;
+        uint    i;
+        mcmon   j;
+        mcmon  *q;
+        int     found = FALSE;
+        int     unused = -1;
+
+        for (i = 0, p = cctx->mcmcxmtb ; i < cctx->mcmcxmsz ; ++i, ++p)
+        {
+            if (*p)
+            {
+                for (j = 0, q = *p ; j < 256 ; ++j, ++q)
+                {
+                    if (*q == MCMONINV)
+                    {
+                        found = TRUE;
+                        break;
+                    }
+                }
+            }
+            else if (unused == -1)
+                unused = i;            /* note an unused page mapping table */
+
+            if (found) break;
+        }
+
+        if (found)
+            clinum = (i << 8) + j;
+        else if (unused != -1)
+            clinum = (unused << 8);
+        else
+            errsig(ctx->mcmcxerr, ERR_CLIFULL);
+    }
+
+    /* expand client mapping table if necessary */
+    mcmcliexp(cctx, clinum);
+
+    /* make sure the entry isn't already in use */
+    if (mcmc2g(cctx, clinum) != MCMONINV)
+        errsig(ctx->mcmcxerr, ERR_CLIUSE);
+
+    cctx->mcmcxmtb[clinum >> 8][clinum & 255] = glb;
+    if (nump) *nump = clinum;
+    return(o->mcmoptr);
+}
+
+/* reserve space for an object at a client object number */
+void mcmrsrv(mcmcxdef *cctx, ushort siz, mcmon clinum, mclhd loadhd)
+{
+    mcmcx1def *ctx = cctx->mcmcxgl;                       /* global context */
+    mcmon      glb;                       /* global object number allocated */
+    mcmodef   *o;
+
+    MCMCLICTX(cctx);
+    MCMGLBCTX(ctx);
+
+    o = mcmoal(ctx, &glb);                       /* get a new object header */
+    if (!o) errsig(ctx->mcmcxerr, ERR_NOHDR);     /* can't get a new header */
+
+    o->mcmoldh = loadhd;
+    o->mcmoflg = 0;
+    o->mcmosiz = siz;
+
+    mcmcliexp(cctx, clinum);
+    if (mcmc2g(cctx, clinum) != MCMONINV)
+        errsig(ctx->mcmcxerr, ERR_CLIUSE);
+
+    cctx->mcmcxmtb[clinum >> 8][clinum & 255] = glb;
+}
+
+/* resize an existing object */
+uchar *mcmrealo(mcmcxdef *cctx, mcmon cliobj, ushort newsize)
+{
+    mcmcx1def *ctx = cctx->mcmcxgl;                       /* global context */
+    mcmodef   *o = mcmobje(cctx, cliobj);
+    uchar     *p;
+    ulong      cap;
+    int        local_lock;
+
+    MCMCLICTX(cctx);
+    MCMGLBCTX(ctx);
+
+    newsize = osrndsz(newsize);
+    if (newsize > MCMCHUNK)
+        errsig(ctx->mcmcxerr, ERR_BIGOBJ);
+
+    /* make sure the object is locked, and note if we locked it */
+    if ((local_lock = !(o->mcmoflg & MCMOFLOCK)) != 0)
+        (void)mcmlck(cctx, cliobj);
+
+    ERRBEGIN(ctx->mcmcxerr)
+
+    if (newsize <= mcmfhdr(o->mcmoptr)->mcmfcap)
+    {
+        /* it fits in the block we already have */
+        o->mcmosiz = newsize;
+    }
+    else
+    {
+        /* we have to move it - we can't if anyone else has a lock */
+        if (o->mcmolcnt != 1)
+            errsig(ctx->mcmcxerr, ERR_REALCK);
+
+        /*
+         *   allocate a new block, leaving some room to grow, since objects
+         *   that grow once tend to keep growing
+         */
+        cap = (ulong)newsize + newsize/4;
+        if (cap > MCMCHUNK) cap = MCMCHUNK;
+        p = mcmfalo(ctx, (ushort)osrndsz(cap));
+
+        /* copy the old contents and free the old block */
+        memcpy(p, o->mcmoptr, (size_t)o->mcmosiz);
+        mcmffre(o->mcmoptr);
+
+        o->mcmoptr = p;
+        o->mcmosiz = newsize;
+    }
+
+    ERRCLEAN(ctx->mcmcxerr)
+        /* release our lock, if we had to obtain one */
+        if (local_lock) mcmunlck(cctx, cliobj);
+    ERRENDCLN(ctx->mcmcxerr)
+
+    /* return the address of the object */
+    return(o->mcmoptr);
+}
+
+/*
+ *   Free an object by GLOBAL number: release its memory and return the
+ *   header to the unused list.
+ */
+void mcmgfre(mcmcx1def *ctx, mcmon obj)
+{
+    mcmodef   *o = mcmgobje(ctx, obj);
+
+    MCMGLBCTX(ctx);
+
+    /* signal an error if the object is locked */
+    if (o->mcmolcnt) errsig(ctx->mcmcxerr, ERR_LCKFRE);
+
+    /* free the memory, if the object was ever loaded */
+    if (o->mcmoflg & MCMOFPRES)
+        mcmffre(o->mcmoptr);
+
+    /* put the header in the unused list */
+    o->mcmoflg = MCMOFFREE;
+    o->mcmonxt = ctx->mcmcxunu;
+    ctx->mcmcxunu = obj;
+}
+
+/*
+ *   Load and lock an object that has been reserved but not yet loaded.
+ *   Since we never swap or discard objects, this is the only way an object
+ *   can be absent from memory.
+ */
+uchar *mcmload(mcmcxdef *cctx, mcmon cnum)
+{
+    mcmcx1def   *ctx = cctx->mcmcxgl;
+    mcmodef     *o = mcmobje(cctx, cnum);
+    uchar       *p;
+
+    MCMCLICTX(cctx);
+    MCMGLBCTX(ctx);
+
+    /* we first need to obtain some memory for this object */
+    p = mcmfalo(ctx, (ushort)osrndsz(o->mcmosiz));
+
+    /* load the object */
+    ERRBEGIN(ctx->mcmcxerr)
+        if (cctx->mcmcxldf)
+            (*cctx->mcmcxldf)(cctx->mcmcxldc, o->mcmoldh, p, o->mcmosiz);
+        else
+            errsig(ctx->mcmcxerr, ERR_NOLOAD);
+    ERRCLEAN(ctx->mcmcxerr)
+        mcmffre(p);                      /* don't need new memory after all */
+    ERRENDCLN(ctx->mcmcxerr)
+
+    /* set flags in the newly loaded object and return */
+    o->mcmoptr = p;
+    o->mcmoflg |= MCMOFPRES | MCMOFLOCK | MCMOFNODISC;
+    o->mcmoflg &= ~MCMOFDIRTY;
+    o->mcmolcnt = 1;                                   /* one locker so far */
+
+    /* if the object is to be reverted upon loading, revert it now */
+    if (o->mcmoflg & MCMOFREVRT)
+    {
+        (*cctx->mcmcxrvf)(cctx->mcmcxrvc, cnum);
+        o->mcmoflg &= ~MCMOFREVRT;
+    }
+
+    return(o->mcmoptr);
+}
+
+/*
+ *   Allocate a new object header.  This doesn't allocate an object, just
+ *   the header for one.
+ */
+static mcmodef *mcmoal(mcmcx1def *ctx, mcmon *nump)
+{
+    mcmodef  *ret;
+    uint      pagenum;
+
+    MCMGLBCTX(ctx);
+
+    /* look first in list of unused headers */
+startover:
+    if (ctx->mcmcxunu != MCMONINV)
+    {
+        /* we have something in the unused list; return it */
+        *nump = ctx->mcmcxunu;
+        ret = mcmgobje(ctx, *nump);
+        ctx->mcmcxunu = ret->mcmonxt;
+        ret->mcmonxt = ret->mcmoprv = MCMONINV;
+        ret->mcmolcnt = 0;
+        ret->mcmoswh = MCSSEGINV;
+        return(ret);
+    }
+
+    /* no unused entries: we must create a new page */
+    if (ctx->mcmcxpage == ctx->mcmcxpgmx) goto error;      /* no more pages */
+    pagenum = ctx->mcmcxpage++;                      /* get a new page slot */
+
+    ctx->mcmcxtab[pagenum] =
+         (mcmodef *)mchalo(ctx->mcmcxerr, MCMPAGESIZE, "mcmoal");
+    memset(ctx->mcmcxtab[pagenum], 0, (size_t)MCMPAGESIZE);
+    mcmadpg(ctx, pagenum, MCMONINV);
+    goto startover;
+
+error:
+    *nump = MCMONINV;
+    return((mcmodef *)0);
+}
+
+/* add page pagenum, initializing entries after firstunu to unused */
+static void mcmadpg(mcmcx1def *ctx, uint pagenum, mcmon firstunu)
+{
+    mcmon    unu;
+    mcmodef *obj;
+    mcmon    lastunu;
+
+    MCMGLBCTX(ctx);
+
+    unu = (firstunu == MCMONINV ? pagenum * MCMPAGECNT : firstunu);
+    ctx->mcmcxunu = unu;
+    lastunu = (pagenum * MCMPAGECNT) + MCMPAGECNT - 1;
+    for (obj = mcmgobje(ctx, unu) ; unu < lastunu ; ++obj)
+        obj->mcmonxt = ++unu;
+    obj->mcmonxt = MCMONINV;
+}
+
+/* compute size of cache - this is the memory used by present objects */
+ulong mcmcsiz(mcmcxdef *cctx)
+{
+    mcmcx1def *ctx = cctx->mcmcxgl;
+    uint       i;
+    uint       j;
+    mcmodef   *o;
+    ulong      tot;
+
+    MCMCLICTX(cctx);
+    MCMGLBCTX(ctx);
+
+    for (tot = 0, i = 0 ; i < ctx->mcmcxpage ; ++i)
+    {
+        for (j = 0, o = ctx->mcmcxtab[i] ; j < MCMPAGECNT ; ++j, ++o)
+        {
+            if ((o->mcmoflg & (MCMOFPRES | MCMOFPAGE)) == MCMOFPRES)
+                tot += mcmfhdr(o->mcmoptr)->mcmfcap;
+        }
+    }
+
+    return(tot);
+}
+
+#ifdef MCM_NO_MACRO
+/* routines that can be either macros or functions */
+
+uchar *mcmlck(mcmcxdef *ctx, mcmon objnum)
+{
+    mcmodef *o = mcmobje(ctx, objnum);
+
+    if ((o->mcmoflg & MCMOFFREE) != 0 || mcmc2g(ctx, objnum) == MCMONINV)
+    {
+        errsig(ctx->mcmcxgl->mcmcxerr, ERR_INVOBJ);
+        return 0;
+    }
+    else if (o->mcmoflg & MCMOFPRES)
+    {
+        o->mcmoflg |= MCMOFLOCK;
+        ++(o->mcmolcnt);
+        return(o->mcmoptr);
+    }
+    else
+        return(mcmload(ctx, objnum));
+}
+
+void mcmunlck(mcmcxdef *ctx, mcmon obj)
+{
+    mcmodef *o = mcmobje(ctx, obj);
+
+    if ((o->mcmoflg & MCMOFLOCK) && !(--(o->mcmolcnt)))
+        o->mcmoflg &= ~MCMOFLOCK;
+}
+
+void mcmgunlck(mcmcx1def *ctx, mcmon obj)
+{
+    mcmodef *o = mcmgobje(ctx, obj);
+
+    if ((o->mcmoflg & MCMOFLOCK) && !(--(o->mcmolcnt)))
+        o->mcmoflg &= ~MCMOFLOCK;
+}
+
+#endif /* MCM_NO_MACRO */
+
+/*
+ *   Change an object's swap file handle.  Nothing is ever swapped out in
+ *   the flat heap, but keep the same behavior as the paged version in case
+ *   the swapper calls us.
+ */
+void mcmcswf(mcmcx1def *ctx, mcmon objn, mcsseg swapn, mcsseg oldswapn)
+{
+    mcmodef *o = mcmgobje(ctx, objn);
+
+    MCMGLBCTX(ctx);
+
+    if (((o->mcmoflg & (MCMOFDIRTY | MCMOFNODISC)) && o->mcmoswh == oldswapn)
+        || (o->mcmoflg & MCMOFPRES))
+        o->mcmoswh = swapn;
+}
+
+
+void mcmfre(mcmcxdef *ctx, mcmon obj)
+{
+    /* the object's contents are going away */
+    ++mcmgen;
+
+    /* free the actual object */
+    mcmgfre(ctx->mcmcxgl, mcmc2g(ctx, obj));
+
+    /* unmap the client object number */
+    mcmc2g(ctx, obj) = MCMONINV;
+}
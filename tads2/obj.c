@@ -308,6 +308,42 @@ static uint objgetap0(mcmcxdef *ctx, noreg objnum obj, prpnum prop,
     return (found ? psav : 0);
 }
 
+/*
+ *   Inherited property lookup cache.  A full lookup searches the object
+ *   and then recursively walks its superclass tree, checking lineage at
+ *   each step, and the same few (object, property) pairs tend to be
+ *   looked up over and over again (every method call and property
+ *   reference goes through here).  So, we remember the results of recent
+ *   lookups in a small direct-mapped table.
+ *   
+ *   Each entry records the cache manager's modification generation
+ *   (mcmgen) at the time the lookup started.  Setting or deleting a
+ *   property, reverting an object, creating or freeing an object, or
+ *   restoring a saved game all touch objects, which advances the
+ *   generation and thereby invalidates every entry at once, so we never
+ *   have to track down the individual entries a change affects.  
+ */
+#define OBJCSIZ  1024          /* number of cache entries - a power of two */
+
+typedef struct objcdef objcdef;
+struct objcdef
+{
+    ulong     objcgen;             /* mcmgen value when lookup was started */
+    mcmcxdef *objcctx;                  /* client cache manager context */
+    objnum    objcobj;                             /* object searched for */
+    prpnum    objcprp;                     /* property (before synonyms) */
+    int       objcinh;                            /* inherited-only flag */
+    uint      objcofs;                  /* result: offset of the prpdef */
+    objnum    objcorn;               /* result: object defining property */
+};
+
+static objcdef objcache[OBJCSIZ];
+
+/* get the cache slot for a lookup */
+#define objchash(obj, prop, inh) \
+    (((((uint)(obj)) * 257) + (((uint)(prop)) << 1) + (uint)(inh)) \
+     & (OBJCSIZ - 1))
+
 /*
  *   Get a property of an object, either from the object or from a
  *   superclass (inherited).  If the inh flag is TRUE, we do not look at
@@ -321,9 +357,11 @@ static uint objgetap0(mcmcxdef *ctx, noreg objnum obj, prpnum prop,
 uint objgetap(mcmcxdef *ctx, noreg objnum obj, prpnum prop,
               objnum *ornp, int inh)
 {
-    uint    retval;
-    dattyp  typ;
-    objnum  orn;
+    uint     retval;
+    dattyp   typ;
+    objnum   orn;
+    objcdef *ce;
+    ulong    gen;
 
     /* 
      *   even if the caller doesn't care about the original object number,
@@ -332,6 +370,31 @@ uint objgetap(mcmcxdef *ctx, noreg objnum obj, prpnum prop,
     if (ornp == 0)
         ornp = &orn;
 
+    /* check the lookup cache */
+    inh = (inh != 0);
+    gen = mcmgen;
+    ce = &objcache[objchash(obj, prop, inh)];
+    if (ce->objcgen == gen && ce->objcctx == ctx && ce->objcobj == obj
+        && ce->objcprp == prop && ce->objcinh == inh)
+    {
+        *ornp = ce->objcorn;
+        return ce->objcofs;
+    }
+
+    /* 
+     *   Fill in the key now, since synonym translation changes 'prop'.
+     *   Leave the generation invalid until we have the result, in case
+     *   we throw an error along the way.  Note that we store the
+     *   generation from the start of the lookup: if loading an object
+     *   during the search touches anything, the entry will simply be
+     *   stale on arrival, which is always safe.  
+     */
+    ce->objcgen = 0;
+    ce->objcctx = ctx;
+    ce->objcobj = obj;
+    ce->objcprp = prop;
+    ce->objcinh = inh;
+
     /* keep going until we've finished translating synonyms */
     for (;;)
     {
@@ -369,7 +432,12 @@ uint objgetap(mcmcxdef *ctx, noreg objnum obj, prpnum prop,
             continue;
         }
 
-        /* we don't have to perform a translation; return the result */
+        /* we don't have to perform a translation; cache the result */
+        ce->objcofs = retval;
+        ce->objcorn = *ornp;
+        ce->objcgen = gen;
+
+        /* return the result */
         return retval;
     }
 }
@@ -567,21 +635,70 @@ void objsetp(mcmcxdef *ctx, objnum objn, prpnum prop, dattyp typ,
 /* set an undo savepoint */
 void objusav(objucxdef *undoctx)
 {
+    /* the turn that's just ending is now complete - note its size */
+    undoctx->objucxlst = undoctx->objucxcur;
+    if (undoctx->objucxcur > undoctx->objucxpk)
+        undoctx->objucxpk = undoctx->objucxcur;
+    undoctx->objucxcur = 0;
+    
     /* the only thing in this record is the OBJUSAV header */
     objures(undoctx, OBJUSAV, (ushort)0);
 }
 
+/*
+ *   Grow an undo buffer so that it's at least 'need' bytes long.  We
+ *   double the size each time, but never go past the context's limit.
+ *   Returns TRUE if the buffer is now big enough, FALSE if not, in which
+ *   case the caller must make room by discarding old records instead.  
+ */
+static int objugrow(objucxdef *undoctx, uint need)
+{
+    uint   newsiz;
+    uchar *newbuf;
+
+    /* if we're already at the limit, we can't grow any further */
+    if (need > undoctx->objucxmax)
+        return FALSE;
+
+    /* double the size, subject to the limit */
+    newsiz = (undoctx->objucxsiz > undoctx->objucxmax / 2
+              ? undoctx->objucxmax : undoctx->objucxsiz * 2);
+    if (newsiz < need)
+        newsiz = need;
+
+    /* 
+     *   reallocate the buffer; if the memory isn't available, settle for
+     *   the size we have now from here on 
+     */
+    newbuf = (uchar *)osrealloc(undoctx->objucxbuf, (size_t)newsiz);
+    if (newbuf == 0)
+    {
+        undoctx->objucxmax = undoctx->objucxsiz;
+        return FALSE;
+    }
+
+    /* use the new buffer */
+    undoctx->objucxbuf = newbuf;
+    undoctx->objucxsiz = newsiz;
+    return TRUE;
+}
+
 /* reserve space in an undo buffer, and write header */
-uchar *objures(objucxdef *undoctx, uchar cmd, ushort siz)
+uchar *objures(objucxdef *undoctx, uchar cmd, ushort siz0)
 {
-    ushort  prv;
+    uint    siz;
+    uint    prv;
     uchar  *p;
     
     /* adjust size to include header information */
-    siz += 1 + sizeof(ushort);
+    siz = siz0 + OBJUHDRSIZ;
+
+    /* count the space toward the current turn */
+    undoctx->objucxcur += siz;
     
     /* make sure there's enough room overall for the record */
-    if (siz > undoctx->objucxsiz) errsig(undoctx->objucxerr, ERR_UNDOVF);
+    if (siz > undoctx->objucxsiz && !objugrow(undoctx, siz))
+        errsig(undoctx->objucxerr, ERR_UNDOVF);
     
     /* if there's no information, reset buffers */
     if (undoctx->objucxhead == undoctx->objucxprv)
@@ -597,6 +714,13 @@ uchar *objures(objucxdef *undoctx, uchar cmd, ushort siz)
         /* if there's enough space left after head, we're done */
         if (undoctx->objucxsiz - undoctx->objucxhead >= siz)
             goto done;
+
+        /* 
+         *   if we can make the buffer bigger, do so - this keeps all of
+         *   the old records, and we don't have to wrap yet 
+         */
+        if (objugrow(undoctx, undoctx->objucxhead + siz))
+            goto done;
         
         /* insufficient space:  wrap head down to bottom of buffer */
         undoctx->objucxtop = undoctx->objucxprv;            /* last was top */
@@ -607,6 +731,7 @@ uchar *objures(objucxdef *undoctx, uchar cmd, ushort siz)
     while (undoctx->objucxtail - undoctx->objucxhead < siz)
     {
         objutadv(undoctx);
+        ++undoctx->objucxdrp;
         
         /* if the tail wrapped, advancing won't do any more good */
         if (undoctx->objucxtail <= undoctx->objucxhead)
@@ -632,7 +757,7 @@ done:
     memcpy(p, &prv, sizeof(prv));
     
     /* advance the head pointer past the header */
-    undoctx->objucxhead += 1 + sizeof(prv);
+    undoctx->objucxhead += OBJUHDRSIZ;
     
     /* set the high-water mark if we've exceeded the old one */
     if (undoctx->objucxprv > undoctx->objucxtop)
@@ -646,7 +771,7 @@ done:
 void objutadv(objucxdef *undoctx)
 {
     uchar  *p;
-    ushort  siz;
+    uint    siz;
     uchar   pr[PRPHDRSIZ];                   /* space for a property header */
     uchar   cmd;
     
@@ -668,10 +793,10 @@ void objutadv(objucxdef *undoctx)
     
     /* determine size by inspecting current record */
     p = undoctx->objucxbuf + undoctx->objucxtail;
-    siz = 1 + sizeof(ushort);                          /* basic header size */
+    siz = OBJUHDRSIZ;                                  /* basic header size */
     
     cmd = *p++;
-    p += sizeof(ushort);                       /* skip the previous pointer */
+    p += sizeof(uint);                         /* skip the previous pointer */
     
     switch(cmd)
     {
@@ -706,7 +831,7 @@ void obj1undo(mcmcxdef *mctx, objucxdef *undoctx)
     objnum  objn;
     uchar   cmd;
     uchar   pr[PRPHDRSIZ];                     /* space for property header */
-    ushort  prv;
+    uint    prv;
     ushort  pofs;
     objdef *objptr;
     int     indexed;
@@ -777,7 +902,7 @@ void obj1undo(mcmcxdef *mctx, objucxdef *undoctx)
  */
 int objuok(objucxdef *undoctx)
 {
-    ushort prv;
+    uint prv;
 
     /* see if there's any more undo information */
     if (undoctx->objucxprv == undoctx->objucxhead)
@@ -807,8 +932,8 @@ int objuok(objucxdef *undoctx)
  */
 void objundo(mcmcxdef *mctx, objucxdef *undoctx)
 {
-    ushort prv;
-    ushort sav;
+    uint prv;
+    uint sav;
 
     /* see if there's any more undo information */
     if (undoctx->objucxprv == undoctx->objucxhead)
@@ -836,27 +961,28 @@ void objundo(mcmcxdef *mctx, objucxdef *undoctx)
 }
 
 /* initialize undo context */
-objucxdef *objuini(mcmcxdef *ctx, ushort siz,
+objucxdef *objuini(mcmcxdef *ctx, uint siz,
                    void (*undocb)(void *, uchar *), 
                    ushort (*sizecb)(void *, uchar *),
                    void *callctx)
 {
     objucxdef *ret;
-    long       totsiz;
+    uint       inisiz;
 
-    /* force size into valid range */
-    totsiz = (long)siz + sizeof(objucxdef) - 1;
-    if (totsiz > 0xff00)
-        siz = 0xff00 - sizeof(objucxdef) + 1;
+    /* start the buffer out small, and let it grow from there */
+    inisiz = (siz < OBJUINISIZ ? siz : OBJUINISIZ);
 
-    ret = (objucxdef *)mchalo(ctx->mcmcxgl->mcmcxerr,
-                              (sizeof(objucxdef) + siz - 1),
+    ret = (objucxdef *)mchalo(ctx->mcmcxgl->mcmcxerr, sizeof(objucxdef),
                               "objuini");
+    ret->objucxbuf = mchalo(ctx->mcmcxgl->mcmcxerr, (size_t)inisiz,
+                            "objuini");
     
     ret->objucxmem  = ctx;
     ret->objucxerr  = ctx->mcmcxgl->mcmcxerr;
-    ret->objucxsiz  = siz;
+    ret->objucxsiz  = inisiz;
+    ret->objucxmax  = siz;
     ret->objucxhead = ret->objucxprv = ret->objucxtail = ret->objucxtop = 0;
+    ret->objucxcur  = ret->objucxlst = ret->objucxpk = ret->objucxdrp = 0;
     
     /* set client callback functions */
     ret->objucxcun = undocb;               /* callback to apply client undo */
@@ -870,16 +996,20 @@ objucxdef *objuini(mcmcxdef *ctx, ushort siz,
 void objulose(objucxdef *ctx)
 {
     if (ctx)
+    {
         ctx->objucxhead =
         ctx->objucxprv  =
         ctx->objucxtail =
         ctx->objucxtop  = 0;
+        ctx->objucxcur  = 0;
+    }
 }
 
 /* uninitialize the undo context - release allocated memory */
 void objuterm(objucxdef *uctx)
 {
-    /* free the undo memory block */
+    /* free the undo buffer and the context itself */
+    mchfre(uctx->objucxbuf);
     mchfre(uctx);
 }
 
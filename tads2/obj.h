@@ -132,27 +132,38 @@ struct objucxdef
 {
     mcmcxdef *objucxmem;                           /* cache manager context */
     errcxdef *objucxerr;                                   /* error context */
-    ushort    objucxsiz;                         /* size of the undo buffer */
-    ushort    objucxhead;                  /* head (position of next write) */
-    ushort    objucxtail;               /* tail (position of oldest record) */
-    ushort    objucxprv;                           /* previous head pointer */
-    ushort    objucxtop;                      /* highest head value written */
+    uint      objucxsiz;                 /* current size of the undo buffer */
+    uint      objucxmax;           /* size the buffer is allowed to grow to */
+    uint      objucxhead;                  /* head (position of next write) */
+    uint      objucxtail;               /* tail (position of oldest record) */
+    uint      objucxprv;                           /* previous head pointer */
+    uint      objucxtop;                      /* highest head value written */
     void    (*objucxcun)(void *ctx, uchar *data);
                                               /* apply a client undo record */
     ushort  (*objucxcsz)(void *ctx, uchar *data);
                                         /* get size of a client undo record */
     void     *objucxccx;                             /* client undo context */
-    uchar     objucxbuf[1];                                  /* undo buffer */
+    ulong     objucxcur;          /* bytes written since the last savepoint */
+    ulong     objucxlst;       /* bytes written for the last complete turn */
+    ulong     objucxpk;            /* most bytes written for any one turn */
+    ulong     objucxdrp;    /* records discarded to make room for new ones */
+    uchar    *objucxbuf;                                     /* undo buffer */
 };
 typedef struct objucxdef objucxdef;
 
 /*
- *   Undo records are kept in a circular buffer allocated as part of an
- *   undo context.  Offsets within the buffer are kept for the head, tail,
- *   and previous head records.  The head always points to the byte at
- *   which the next undo record will be written.  The previous head points
- *   to the most recently written undo record; it contains a back link to
- *   the undo record before that, and so forth back through the entire
+ *   Undo records are kept in a circular buffer belonging to an undo
+ *   context.  The buffer starts out small and is reallocated to a larger
+ *   size when it fills up, until it reaches the maximum size given when
+ *   the context was created (objucxmax); only then does it start to wrap
+ *   around and discard old records.  Records are always addressed by
+ *   offset, so moving the buffer doesn't disturb them.
+ *   
+ *   Offsets within the buffer are kept for the head, tail, and previous
+ *   head records.  The head always points to the byte at which the next
+ *   undo record will be written.  The previous head points to the most
+ *   recently written undo record; it contains a back link to the undo
+ *   record before that, and so forth back through the entire
  *   chain.  (These reverse links are necessary because undo records vary
  *   in size depending on the data contained within.)  The tail points to
  *   the oldest undo record that's still in the buffer.  Conceptually, the
@@ -181,11 +192,20 @@ typedef struct objucxdef objucxdef;
 #define OBJUCLI    5                /* client undo record (any client data) */
 
 /*
- *   After the control byte (OBJUxxx), the object number, property
- *   number, datatype, and data value will follow; some or all of these
- *   may be omitted, depending on the control byte. 
+ *   After the control byte (OBJUxxx) and the back link to the previous
+ *   record, the object number, property number, datatype, and data value
+ *   will follow; some or all of these may be omitted, depending on the
+ *   control byte. 
  */
 
+/* size of an undo record header - control byte plus back link */
+#define OBJUHDRSIZ  (1 + sizeof(uint))
+
+/* initial size of an undo buffer (it grows from here as needed) */
+#ifndef OBJUINISIZ
+# define OBJUINISIZ  (16 * 1024)
+#endif
+
 /* get object flags */
 #define objflg(o) ((ushort)osrp2(((char *)(o)) + 2))
 
@@ -367,8 +387,12 @@ void objundo(mcmcxdef *mctx, objucxdef *undoctx);
 /* set an undo savepoint */
 void objusav(objucxdef *undoctx);
 
-/* initialize undo context */
-objucxdef *objuini(mcmcxdef *memctx, ushort undosiz,
+/*
+ *   Initialize undo context.  'undosiz' is the most memory the undo buffer
+ *   may use; the buffer is allocated at a smaller size to start with, and
+ *   grows on demand up to this limit. 
+ */
+objucxdef *objuini(mcmcxdef *memctx, uint undosiz,
                    void (*undocb)(void *ctx, uchar *data),
                    ushort (*sizecb)(void *ctx, uchar *data),
                    void *callctx);
@@ -35,7 +35,7 @@ Modified
 #define TRD_SETTINGS_DEFINED
 #define TRD_HEAPSIZ  65535
 #define TRD_STKSIZ   512
-#define TRD_UNDOSIZ  60000       /* WARNING: above 65535 will cause crashes */
+#define TRD_UNDOSIZ  (1024 * 1024)       /* the buffer grows up to this */
 
 #define TDD_SETTINGS_DEFINED
 #define TDD_HEAPSIZ  65535
@@ -59,7 +59,7 @@ Modified
 #define TRD_HEAPSIZ_MSG "  -mh size      heap size (default 65535 bytes)"
 #define TRD_STKSIZ_MSG  "  -ms size      stack size (default 512 elements)"
 #define TRD_UNDOSIZ_MSG \
-    "  -u size       set undo to size (0 to disable; default 60000)"
+    "  -u size       set undo to size (0 to disable; default 1048576)"
 
 #define TDD_HEAPSIZ_MSG "  -mh size      heap size (default 65535 bytes)"
 #define TDD_STKSIZ_MSG  "  -ms size      stack size (default 512 elements)"
@@ -1660,6 +1660,50 @@ static void outstring_noxlat_stream(out_stream_info *stream, char *s)
         outchar_noxlat_stream(stream, *s);
 }
 
+/*
+ *   Write out a run of ordinary text, translating to the local character
+ *   set.  This has the same effect as calling outchar_stream() for each
+ *   character, but when no capitalization flags are pending and we're
+ *   not capturing, we copy characters other than whitespace directly into
+ *   the line buffer for as long as they fit on the current line.  Spaces
+ *   and anything that would overflow the line still go through
+ *   outchar_noxlat_stream(), which takes care of spacing and wrapping. 
+ */
+static void outspan_stream(out_stream_info *stream, char *s, size_t len)
+{
+    char c;
+    
+    while (len != 0)
+    {
+        /* copy ordinary characters directly, as long as they fit */
+        if (!stream->capturing && !stream->capsflag
+            && !stream->allcapsflag && !stream->nocapsflag)
+        {
+            while (len != 0 && stream->linecol + 1 < G_os_linewidth)
+            {
+                /* stop at anything that needs special handling */
+                c = cmap_i2n(*s);
+                if (c == QSPACE || c == QTAB || outissp(c))
+                    break;
+
+                /* add this character to the buffer */
+                stream->attrbuf[stream->linepos] = stream->cur_attr;
+                stream->linebuf[stream->linepos++] = c;
+                ++(stream->linecol);
+                ++s, --len;
+            }
+
+            /* if that took care of everything, we're done */
+            if (len == 0)
+                break;
+        }
+
+        /* write the next character the normal way */
+        outchar_noxlat_stream(stream, cmap_i2n(*s));
+        ++s, --len;
+    }
+}
+
 
 /* ------------------------------------------------------------------------ */
 /*
@@ -2716,8 +2760,33 @@ static int outformatlen_stream(out_stream_info *stream,
         }
         else
         {
+            size_t run;
+            
             /* normal character */
             outchar_stream(stream, c);
+
+            /* 
+             *   Ordinary text tends to come in long runs between the
+             *   characters this loop has to interpret, so find the end of
+             *   the run and send the whole thing to the line buffer at
+             *   once, rather than coming back through the loop for each
+             *   character.  Outside of HTML mode, '<' and '&' are ordinary
+             *   characters, but they're rare enough that it's not worth
+             *   distinguishing the cases; we just end the run there. 
+             */
+            for (run = 0 ; run < slen ; ++run)
+            {
+                c = s[run];
+                if (c == '\0' || c == '%' || c == '\\' || c == '<'
+                    || c == '&')
+                    break;
+            }
+            if (run != 0)
+            {
+                outspan_stream(stream, s, run);
+                s += run;
+                slen -= run;
+            }
         }
 
         /* move on to the next character, unless we're finished */
@@ -161,6 +161,11 @@ void re_init(re_context *ctx, errcxdef *errctx)
 
     /* no string buffer yet */
     ctx->strbuf = 0;
+
+    /* nothing compiled yet, and nothing in the pattern cache */
+    ctx->curpat = 0;
+    memset(ctx->cache, 0, sizeof(ctx->cache));
+    ctx->use_counter = 0;
 }
 
 /* ------------------------------------------------------------------------ */
@@ -188,6 +193,37 @@ static void re_reset(re_context *ctx)
     ctx->cur_group = 0;
 }
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Free the resources held by a cached compiled pattern, leaving the
+ *   entry unused. 
+ */
+static void re_free_compiled(re_compiled *ent)
+{
+    int i;
+
+    /* delete the range tables and the tuple array */
+    if (ent->tuple_arr != 0)
+    {
+        for (i = 0 ; i < ent->next_state ; ++i)
+        {
+            if (ent->tuple_arr[i].char_range != 0)
+                mchfre(ent->tuple_arr[i].char_range);
+        }
+        mchfre(ent->tuple_arr);
+        ent->tuple_arr = 0;
+    }
+    ent->tuples_alloc = 0;
+    ent->next_state = RE_STATE_FIRST_VALID;
+
+    /* delete the pattern source */
+    if (ent->pat != 0)
+    {
+        mchfre(ent->pat);
+        ent->pat = 0;
+    }
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Delete the context - frees structures associated with the context.
@@ -195,8 +231,21 @@ static void re_reset(re_context *ctx)
  */
 void re_delete(re_context *ctx)
 {
+    int i;
+    
     /* reset state */
     re_reset(ctx);
+
+    /* forget the current pattern */
+    if (ctx->curpat != 0)
+    {
+        mchfre(ctx->curpat);
+        ctx->curpat = 0;
+    }
+
+    /* delete the cached patterns */
+    for (i = 0 ; i < RE_CACHE_CNT ; ++i)
+        re_free_compiled(&ctx->cache[i]);
     
     /* if we've allocated an array, delete it */
     if (ctx->tuple_arr != 0)
@@ -1441,6 +1490,109 @@ static int re_match(re_context *ctx, const char *entire_str,
     }
 }
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Exchange the context's current compiled pattern with a cache entry.
+ *   Since the entry and the context each own their tuple arrays, this is
+ *   just a matter of trading pointers.  
+ */
+static void re_swap_compiled(re_context *ctx, re_compiled *ent)
+{
+    re_compiled tmp;
+
+    /* save the context's current pattern */
+    tmp.pat = ctx->curpat;
+    tmp.patlen = ctx->curpatlen;
+    tmp.tuple_arr = ctx->tuple_arr;
+    tmp.tuples_alloc = ctx->tuples_alloc;
+    tmp.next_state = ctx->next_state;
+    tmp.group_cnt = ctx->cur_group;
+    tmp.init = ctx->cur_init;
+    tmp.final = ctx->cur_final;
+
+    /* make the entry's pattern current */
+    ctx->curpat = ent->pat;
+    ctx->curpatlen = ent->patlen;
+    ctx->tuple_arr = ent->tuple_arr;
+    ctx->tuples_alloc = ent->tuples_alloc;
+    ctx->next_state = ent->next_state;
+    ctx->cur_group = ent->group_cnt;
+    ctx->cur_init = ent->init;
+    ctx->cur_final = ent->final;
+
+    /* store the old current pattern in the entry */
+    tmp.last_use = ++(ctx->use_counter);
+    *ent = tmp;
+}
+
+/*
+ *   Compile an expression, reusing a previous compilation of the same
+ *   pattern if we have one.  The compiled pattern always ends up in the
+ *   context's tuple array; when we compile something new, the pattern
+ *   that was there before moves into the cache, replacing the least
+ *   recently used entry.  
+ */
+static re_status_t re_compile_cached(re_context *ctx,
+                                     const char *pattern, size_t patlen,
+                                     re_machine *machine)
+{
+    re_compiled *ent;
+    re_compiled *victim;
+    re_status_t stat;
+    int i;
+
+    /* check the current pattern first, then the cache */
+    if (ctx->curpat != 0 && ctx->curpatlen == patlen
+        && memcmp(ctx->curpat, pattern, patlen) == 0)
+        goto found;
+    for (i = 0, ent = ctx->cache, victim = ent ; i < RE_CACHE_CNT ;
+         ++i, ++ent)
+    {
+        if (ent->pat != 0 && ent->patlen == patlen
+            && memcmp(ent->pat, pattern, patlen) == 0)
+        {
+            /* got it - make it current */
+            re_swap_compiled(ctx, ent);
+            goto found;
+        }
+
+        /* remember the best entry to replace: unused, or oldest */
+        if (victim->pat != 0
+            && (ent->pat == 0 || ent->last_use < victim->last_use))
+            victim = ent;
+    }
+
+    /* 
+     *   it's not cached, so we'll have to compile it; if the context
+     *   holds a usable pattern, move it into the cache first, leaving the
+     *   context with an empty tuple array to compile into 
+     */
+    if (ctx->curpat != 0)
+    {
+        re_free_compiled(victim);
+        re_swap_compiled(ctx, victim);
+    }
+
+    /* compile the new pattern */
+    if ((stat = re_compile(ctx, pattern, patlen, machine))
+        != RE_STATUS_SUCCESS)
+        return stat;
+
+    /* remember its source, so we can find it again next time */
+    ctx->curpat = (char *)mchalo(ctx->errctx, patlen + 1, "regex pat");
+    memcpy(ctx->curpat, pattern, patlen);
+    ctx->curpatlen = patlen;
+    ctx->cur_init = machine->init;
+    ctx->cur_final = machine->final;
+    return RE_STATUS_SUCCESS;
+
+found:
+    /* use the current compiled machine */
+    machine->init = ctx->cur_init;
+    machine->final = ctx->cur_final;
+    return RE_STATUS_SUCCESS;
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Search for a regular expression within a string.  Returns -1 if the
@@ -1453,6 +1605,22 @@ static int re_search(re_context *ctx, const char *str, size_t len,
                      int *result_len)
 {
     int ofs;
+    re_tuple *tuple;
+    int first;
+    
+    /*
+     *   If the machine can only start by matching one particular literal
+     *   character, we can skip straight to each occurrence of that
+     *   character rather than trying a full match at every offset.  The
+     *   initial state is a literal character matcher if it's not a group
+     *   marker and its character isn't one of our special symbols.  
+     */
+    tuple = &ctx->tuple_arr[machine->init];
+    first = -1;
+    if (machine->init != machine->final
+        && !(tuple->flags & (RE_STATE_GROUP_BEGIN | RE_STATE_GROUP_END))
+        && (unsigned char)tuple->ch > (unsigned char)RE_GROUP_MATCH_9)
+        first = (unsigned char)tuple->ch;
     
     /*
      *   Starting at the first character in the string, search for the
@@ -1462,6 +1630,17 @@ static int re_search(re_context *ctx, const char *str, size_t len,
     for (ofs = 0 ; ofs < (int)len ; ++ofs)
     {
         int matchlen;
+
+        /* if we know the first character, skip to its next occurrence */
+        if (first >= 0)
+        {
+            const char *nxt;
+
+            if ((nxt = (const char *)memchr(str + ofs, first, len - ofs))
+                == 0)
+                break;
+            ofs = nxt - str;
+        }
         
         /* check for a match */
         matchlen = re_match(ctx, str, str + ofs, len - ofs,
@@ -1535,7 +1714,8 @@ int re_compile_and_search(re_context *ctx,
     re_machine machine;
     
     /* compile the expression - return failure if we get an error */
-    if (re_compile(ctx, pattern, patlen, &machine) != RE_STATUS_SUCCESS)
+    if (re_compile_cached(ctx, pattern, patlen, &machine)
+        != RE_STATUS_SUCCESS)
         return -1;
 
     /* save the search string in our internal buffer */
@@ -1567,7 +1747,8 @@ int re_compile_and_match(re_context *ctx,
     re_machine machine;
 
     /* compile the expression - return failure if we get an error */
-    if (re_compile(ctx, pattern, patlen, &machine) != RE_STATUS_SUCCESS)
+    if (re_compile_cached(ctx, pattern, patlen, &machine)
+        != RE_STATUS_SUCCESS)
         return FALSE;
 
     /* save the search string in our internal buffer */
@@ -85,6 +85,40 @@ typedef struct
 #define RE_STATE_GROUP_END    0x04
 
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Compiled pattern.  We keep a few recently compiled patterns in the
+ *   context, so that a game that searches with the same handful of
+ *   patterns over and over doesn't have to recompile them on every call.
+ *   Each entry owns its own tuple array (and the range tables it refers
+ *   to).  
+ */
+typedef struct
+{
+    /* copy of the pattern source, or null if the entry is unused */
+    char *pat;
+    size_t patlen;
+
+    /* the compiled machine's tuples */
+    re_tuple *tuple_arr;
+    int tuples_alloc;
+    re_state_id next_state;
+
+    /* number of groups in the pattern */
+    int group_cnt;
+
+    /* the machine's initial and final states */
+    re_state_id init;
+    re_state_id final;
+
+    /* last use counter value, for choosing an entry to replace */
+    unsigned long last_use;
+} re_compiled;
+
+/* number of compiled patterns we cache in addition to the current one */
+#define RE_CACHE_CNT  8
+
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Regular expression compilation context structure.  This tracks the
@@ -128,6 +162,22 @@ typedef struct
 
     /* size of the buffer allocated to strbuf */
     size_t strbufsiz;
+
+    /* 
+     *   Source of the pattern currently compiled into tuple_arr, and the
+     *   initial and final states of its machine.  curpat is null if
+     *   tuple_arr doesn't hold a usable compiled pattern.  
+     */
+    char *curpat;
+    size_t curpatlen;
+    re_state_id cur_init;
+    re_state_id cur_final;
+
+    /* other recently compiled patterns */
+    re_compiled cache[RE_CACHE_CNT];
+
+    /* use counter for the pattern cache */
+    unsigned long use_counter;
 } re_context;
 
 
@@ -78,6 +78,7 @@ static void run_new(runcxdef *ctx, uchar *noreg *codepp,
 
     /* save undo for the object creation */
     vocdusave_newobj(ctx->runcxvoc, objn);
+    vocacinv(ctx->runcxvoc);
 
     /* touch and unlock the object */
     mcmtch(ctx->runcxmem, (mcmon)objn);
@@ -140,6 +141,7 @@ static void run_delete(runcxdef *ctx, uchar *noreg *codepp,
 
     /* save undo for the object deletion */
     vocdusave_delobj(vctx, objn);
+    vocacinv(vctx);
 
     /* delete the object's inheritance and vocabulary records */
     vocdel(vctx, objn);
@@ -188,20 +190,24 @@ void runfn(runcxdef *ctx, noreg objnum  objn, int argc)
 {
     uchar *fn;
     int    err;
+    RUN_IF_PROFILER(int prfdep;)
     
     NOREG((&objn))
 
     /* get a lock on the object */
     fn = mcmlck(ctx->runcxmem, objn);
+    RUN_IF_PROFILER(prfdep = runprfenter(objn, (prpnum)0);)
     
     /* catch any errors, so we can unlock the object */
     ERRBEGIN(ctx->runcxerr)
 
     /* execute the object */
     runexe(ctx, fn, MCMONINV, objn, (prpnum)0, argc);
+    RUN_IF_PROFILER(runprfleave(prfdep);)
 
     /* in case of error, unlock the object and resignal the error */
     ERRCATCH(ctx->runcxerr, err)
+        RUN_IF_PROFILER(runprfleave(prfdep);)
         mcmunlck(ctx->runcxmem, objn);    /* release the lock on the object */
         if (err < ERR_RUNEXIT || err > ERR_RUNEXITOBJ)
             dbgdump(ctx->runcxdbg);                       /* dump the stack */
@@ -212,6 +218,31 @@ void runfn(runcxdef *ctx, noreg objnum  objn, int argc)
     mcmunlck(ctx->runcxmem, objn);
 }
 
+/*
+ *   Heap reference entry for the sorted compaction pass.  We remember
+ *   the original heap address separately from the value, since the same
+ *   value can be listed more than once (as a stack slot and as one of the
+ *   explicitly saved values), and the first match updates its pointer.  
+ */
+typedef struct runhrdef runhrdef;
+struct runhrdef
+{
+    uchar   *runhrptr;                    /* original heap address of item */
+    runsdef *runhrval;                    /* value that refers to the item */
+};
+
+/* maximum number of references we'll sort on the fast path */
+#define RUNHRMAX  512
+
+/* compare two heap references by address, for qsort */
+static int runhrcmp(const void *a, const void *b)
+{
+    uchar *pa = ((const runhrdef *)a)->runhrptr;
+    uchar *pb = ((const runhrdef *)b)->runhrptr;
+
+    return (pa < pb ? -1 : pa > pb ? 1 : 0);
+}
+
 /*
  *   compress the heap - remove unreferenced items 
  */
@@ -226,44 +257,110 @@ void runhcmp(runcxdef *ctx, uint siz, uint below,
     uchar   *dst  = hp;
     uchar   *hnxt;
     int      ref;
-    
-    /* go through heap, finding references on stack */
-    for ( ; hp < htop ; hp = hnxt)
+    runhrdef refs[RUNHRMAX];
+    uint     nrefs;
+    uint     i;
+
+    /*
+     *   Gather every value that points into the heap, so that we can
+     *   sort the references by address and then sweep the heap and the
+     *   reference list together.  This makes compaction proportional to
+     *   the number of heap items plus the stack depth, rather than their
+     *   product, which matters for games that build large lists with a
+     *   deep stack.  If there are too many references to hold locally,
+     *   fall back on the exhaustive search below.  
+     */
+    for (nrefs = 0, sp = stk ; sp < stop && nrefs < RUNHRMAX ; ++sp)
+    {
+        if ((sp->runstyp == DAT_SSTRING || sp->runstyp == DAT_LIST)
+            && sp->runsv.runsvstr >= hp && sp->runsv.runsvstr < htop)
+        {
+            refs[nrefs].runhrptr = sp->runsv.runsvstr;
+            refs[nrefs++].runhrval = sp;
+        }
+    }
+
+#define ADD_VAL(val) \
+    if (val && val->runsv.runsvstr >= hp && val->runsv.runsvstr < htop \
+        && nrefs < RUNHRMAX) \
+        refs[nrefs].runhrptr = val->runsv.runsvstr, \
+        refs[nrefs++].runhrval = val;
+    if (sp == stop)
     {
-        hnxt = hp + osrp2(hp);                /* remember next heap element */
+        ADD_VAL(val1);
+        ADD_VAL(val2);
+        ADD_VAL(val3);
+    }
+#undef ADD_VAL
+
+    /* use the sorted sweep if we captured every reference */
+    if (sp == stop && nrefs < RUNHRMAX)
+    {
+        qsort(refs, (size_t)nrefs, sizeof(refs[0]), runhrcmp);
 
-        for (ref = FALSE, sp = stk ; sp < stop ; ++sp)
+        for (i = 0 ; hp < htop ; hp = hnxt)
         {
-            switch(sp->runstyp)
+            hnxt = hp + osrp2(hp);            /* remember next heap element */
+
+            /* skip references that don't point at the start of an item */
+            while (i < nrefs && refs[i].runhrptr < hp)
+                ++i;
+
+            /* redirect all references to this item to its new location */
+            for (ref = FALSE ; i < nrefs && refs[i].runhrptr == hp ; ++i)
             {
-            case DAT_SSTRING:
-            case DAT_LIST:
-                if (sp->runsv.runsvstr == hp)    /* reference to this item? */
+                ref = TRUE;
+                refs[i].runhrval->runsv.runsvstr = dst;
+            }
+
+            /* if referenced, copy it to dst and advance dst */
+            if (ref)
+            {
+                if (hp != dst) memmove(dst, hp, (size_t)osrp2(hp));
+                dst += osrp2(dst);
+            }
+        }
+    }
+    else
+    {
+        /* go through heap, finding references on stack */
+        for ( ; hp < htop ; hp = hnxt)
+        {
+            hnxt = hp + osrp2(hp);            /* remember next heap element */
+
+            for (ref = FALSE, sp = stk ; sp < stop ; ++sp)
+            {
+                switch(sp->runstyp)
                 {
-                    ref = TRUE;             /* this heap item is referenced */
-                    sp->runsv.runsvstr = dst;      /* reflect imminent move */
-                }
-                break;
+                case DAT_SSTRING:
+                case DAT_LIST:
+                    if (sp->runsv.runsvstr == hp) /* reference to this item? */
+                    {
+                        ref = TRUE;         /* this heap item is referenced */
+                        sp->runsv.runsvstr = dst;  /* reflect imminent move */
+                    }
+                    break;
                 
-            default:                /* other types do not refer to the heap */
-                break;
+                default:            /* other types do not refer to the heap */
+                    break;
+                }
             }
-        }
 
-        /* check the explicitly referenced value pointers as well */
+            /* check the explicitly referenced value pointers as well */
 #define CHECK_VAL(val) \
-        if (val && val->runsv.runsvstr == hp) \
-            ref = TRUE, val->runsv.runsvstr = dst;
-        CHECK_VAL(val1);
-        CHECK_VAL(val2);
-        CHECK_VAL(val3);
+            if (val && val->runsv.runsvstr == hp) \
+                ref = TRUE, val->runsv.runsvstr = dst;
+            CHECK_VAL(val1);
+            CHECK_VAL(val2);
+            CHECK_VAL(val3);
 #undef CHECK_VAL
 
-        /* if referenced, copy it to dst and advance dst */
-        if (ref)
-        {
-            if (hp != dst) memmove(dst, hp, (size_t)osrp2(hp));
-            dst += osrp2(dst);
+            /* if referenced, copy it to dst and advance dst */
+            if (ref)
+            {
+                if (hp != dst) memmove(dst, hp, (size_t)osrp2(hp));
+                dst += osrp2(dst);
+            }
         }
     }
 
@@ -921,6 +1018,7 @@ void runpprop(runcxdef *ctx, uchar *noreg *codepp,
     int      times_through = 0;
     int      err;
     objnum   otherobj;
+    RUN_IF_PROFILER(int prfdep;)
     
     NOREG((&obj, &codepp));
 
@@ -938,6 +1036,7 @@ startover:
 
     /* found a property; get the prpdef, and the value and type of data */
     objptr = mcmlck(ctx->runcxmem, target);
+    RUN_IF_PROFILER(prfdep = runprfdepth();)
     ERRBEGIN(ctx->runcxerr)         /* catch errors so we can unlock object */
 
     prpptr = (prpdef *)(((uchar *)objptr) + pofs);
@@ -953,7 +1052,9 @@ startover:
             saveofs = runcpsav(ctx, codepp, callobj, callprop);
         
         /* execute the code */
+        RUN_IF_PROFILER(runprfenter(target, prop);)
         runexe(ctx, val, self, target, prop, argc);
+        RUN_IF_PROFILER(runprfleave(prfdep);)
         
         /* restore caller's code pointer in case object moved */
         if (codepp)
@@ -988,6 +1089,7 @@ startover:
 
     /* if an error occurs, unlock the object, and resignal the error */
     ERRCATCH(ctx->runcxerr, err)
+        RUN_IF_PROFILER(runprfleave(prfdep);)
         mcmunlck(ctx->runcxmem, target);
         if (err < ERR_RUNEXIT || err > ERR_RUNEXITOBJ)
             dbgdump(ctx->runcxdbg);                       /* dump the stack */
@@ -1094,6 +1196,47 @@ static void runuflpu(runuxdef *ctx, int typ)
 
 
 /* ======================================================================== */
+/*
+ *   Threaded opcode dispatch.  If RUN_THREADED_DISPATCH is defined (see
+ *   qtads.pro), and the compiler supports the GNU "labels as values"
+ *   extension, runexe() dispatches each instruction through a table of
+ *   label addresses rather than through its main 'switch'.  Each handler
+ *   then ends with its own copy of the indirect jump, which gives each
+ *   opcode its own branch-prediction history.  The handlers remain 'case'
+ *   labels of the same switch, so compilers without the extension simply
+ *   use the switch.  
+ */
+#if defined(RUN_THREADED_DISPATCH) && defined(__GNUC__)
+# define RUN_COMPUTED_GOTO
+#endif
+
+#ifdef RUN_COMPUTED_GOTO
+# define RUNCASE(op)         case op: runop_##op
+# define RUNCASEX(op, lbl)   case op: runop_##lbl
+# define RUNENTRY(op)        (runtbl[op] = &&runop_##op)
+# define RUNENTRYX(op, lbl)  (runtbl[op] = &&runop_##lbl)
+
+/* the dispatch table, built on the first call to runexe() */
+static void *runtbl[256];
+static int   runtblini;
+#else
+# define RUNCASE(op)         case op
+# define RUNCASEX(op, lbl)   case op
+#endif
+
+/*
+ *   Proceed to the next instruction.  Handlers use this in place of a
+ *   plain 'break'.  In threaded mode, we go directly to the next handler,
+ *   except that every 1000 instructions we go back through the top of the
+ *   loop so that it can check for a user break.  
+ */
+#ifdef RUN_COMPUTED_GOTO
+# define RUNNEXT \
+    if (++brkchk < 1000) { opc = *p++; goto *runtbl[opc]; } else break
+#else
+# define RUNNEXT  break
+#endif
+
 /*
  *   execute p-code 
  */
@@ -1139,10 +1282,115 @@ resume_from_error:
     ERRBEGIN(ctx->runcxerr)
 #endif /* DBG_OFF */
     
+#ifdef RUN_COMPUTED_GOTO
+    /* 
+     *   Set up the threaded dispatch table the first time through.  The
+     *   label addresses are local to this function, so the table has to
+     *   be built here.  Anything we don't list explicitly goes to the
+     *   'default' handler, which takes care of the assignment opcodes and
+     *   rejects everything else as invalid.  
+     */
+    if (!runtblini)
+    {
+        for (i = 0 ; i < 256 ; ++i)
+            runtbl[i] = &&runop_default;
+
+        RUNENTRY(OPCPUSHNUM);
+        RUNENTRY(OPCPUSHOBJ);
+        RUNENTRY(OPCPUSHSELF);
+        RUNENTRY(OPCPUSHSTR);
+        RUNENTRY(OPCPUSHLST);
+        RUNENTRY(OPCPUSHNIL);
+        RUNENTRY(OPCPUSHTRUE);
+        RUNENTRY(OPCPUSHFN);
+        RUNENTRY(OPCPUSHPN);
+        RUNENTRY(OPCNEG);
+        RUNENTRY(OPCBNOT);
+        RUNENTRY(OPCNOT);
+        RUNENTRY(OPCADD);
+        RUNENTRY(OPCSUB);
+        RUNENTRY(OPCMUL);
+        RUNENTRY(OPCBAND);
+        RUNENTRY(OPCBOR);
+        RUNENTRY(OPCSHL);
+        RUNENTRY(OPCSHR);
+        RUNENTRY(OPCXOR);
+        RUNENTRY(OPCDIV);
+        RUNENTRY(OPCMOD);
+        RUNENTRY(OPCEQ);
+        RUNENTRY(OPCNE);
+        RUNENTRY(OPCLT);
+        RUNENTRY(OPCLE);
+        RUNENTRY(OPCGT);
+        RUNENTRY(OPCGE);
+        RUNENTRY(OPCCALL);
+        RUNENTRY(OPCGETP);
+        RUNENTRY(OPCGETPDATA);
+        RUNENTRY(OPCGETDBLCL);
+        RUNENTRY(OPCGETLCL);
+        RUNENTRY(OPCRETURN);
+        RUNENTRY(OPCRETVAL);
+        RUNENTRY(OPCENTER);
+        RUNENTRY(OPCDISCARD);
+        RUNENTRY(OPCSWITCH);
+        RUNENTRY(OPCJMP);
+        RUNENTRY(OPCJT);
+        RUNENTRY(OPCJF);
+        RUNENTRY(OPCSAY);
+        RUNENTRY(OPCBUILTIN);
+        RUNENTRY(OPCPTRCALL);
+        RUNENTRY(OPCINHERIT);
+        RUNENTRY(OPCPTRINH);
+        RUNENTRY(OPCPTRGETP);
+        RUNENTRY(OPCPTRGETPDATA);
+        RUNENTRY(OPCEXPINH);
+        RUNENTRY(OPCEXPINHPTR);
+        RUNENTRY(OPCPASS);
+        RUNENTRY(OPCEXIT);
+        RUNENTRY(OPCABORT);
+        RUNENTRY(OPCASKDO);
+        RUNENTRY(OPCASKIO);
+        RUNENTRY(OPCJE);
+        RUNENTRY(OPCJNE);
+        RUNENTRY(OPCJGT);
+        RUNENTRY(OPCJGE);
+        RUNENTRY(OPCJLT);
+        RUNENTRY(OPCJLE);
+        RUNENTRY(OPCJNAND);
+        RUNENTRY(OPCJNOR);
+        RUNENTRY(OPCGETPSELF);
+        RUNENTRY(OPCGETPSELFDATA);
+        RUNENTRY(OPCGETPPTRSELF);
+        RUNENTRY(OPCGETPOBJ);
+        RUNENTRY(OPCINDEX);
+        RUNENTRY(OPCJST);
+        RUNENTRY(OPCJSF);
+        RUNENTRY(OPCCALLEXT);
+        RUNENTRY(OPCDBGRET);
+        RUNENTRY(OPCCONS);
+        RUNENTRY(OPCARGC);
+        RUNENTRY(OPCCHKARGC);
+        RUNENTRY(OPCLINE);
+        RUNENTRY(OPCBP);
+        RUNENTRY(OPCFRAME);
+        RUNENTRY(OPCNEW);
+        RUNENTRY(OPCDELETE);
+        RUNENTRYX(OPCASI_MASK | OPCASIDIR | OPCASILCL, asidirlcl);
+        RUNENTRYX(OPCASI_MASK | OPCASIDIR | OPCASIPRP, asidirprp);
+        RUNENTRYX(OPCASI_MASK | OPCASIDIR | OPCASIPRPPTR, asidirprpptr);
+
+        runtblini = TRUE;
+    }
+#endif /* RUN_COMPUTED_GOTO */
+
     for (brkchk = 0 ;; ++brkchk)
     {
-        /* check for break - signal if user has hit break */
-        if (brkchk == 1000)
+        /* 
+         *   check for break - signal if user has hit break (note that
+         *   RUNNEXT can bring us here with the counter already past the
+         *   limit) 
+         */
+        if (brkchk >= 1000)
         {
             brkchk = 0;
             if (os_break()) runsig(ctx, ERR_USRINT);
@@ -1150,126 +1398,130 @@ resume_from_error:
         
         opc = *p++;
 
+#ifdef RUN_COMPUTED_GOTO
+        /* jump straight to the handler, bypassing the switch itself */
+        goto *runtbl[opc];
+#endif
         switch(opc)
         {
-        case OPCPUSHNUM:
+        RUNCASE(OPCPUSHNUM):
             val.runsv.runsvnum = osrp4s(p);
             runpush(ctx, DAT_NUMBER, &val);
             p += 4;
-            break;
+            RUNNEXT;
             
-        case OPCPUSHOBJ:
+        RUNCASE(OPCPUSHOBJ):
             val.runsv.runsvobj = osrp2(p);
             runpush(ctx, DAT_OBJECT, &val);
             p += 2;
-            break;
+            RUNNEXT;
             
-        case OPCPUSHSELF:
+        RUNCASE(OPCPUSHSELF):
             val.runsv.runsvobj = self;
             runpush(ctx, DAT_OBJECT, &val);
-            break;
+            RUNNEXT;
 
-        case OPCPUSHSTR:
+        RUNCASE(OPCPUSHSTR):
             val.runsv.runsvstr = p;
             runpush(ctx, DAT_SSTRING, &val);
             p += osrp2(p);                              /* skip past string */
-            break;
+            RUNNEXT;
             
-        case OPCPUSHLST:
+        RUNCASE(OPCPUSHLST):
             val.runsv.runsvstr = p;
             runpush(ctx, DAT_LIST, &val);
             p += osrp2(p);                                /* skip past list */
-            break;
+            RUNNEXT;
             
-        case OPCPUSHNIL:
+        RUNCASE(OPCPUSHNIL):
             runpush(ctx, DAT_NIL, &val);
-            break;
+            RUNNEXT;
             
-        case OPCPUSHTRUE:
+        RUNCASE(OPCPUSHTRUE):
             runpush(ctx, DAT_TRUE, &val);
-            break;
+            RUNNEXT;
             
-        case OPCPUSHFN:
+        RUNCASE(OPCPUSHFN):
             val.runsv.runsvobj = osrp2(p);
             runpush(ctx, DAT_FNADDR, &val);
             p += 2;
-            break;
+            RUNNEXT;
             
-        case OPCPUSHPN:
+        RUNCASE(OPCPUSHPN):
             val.runsv.runsvprp = osrp2(p);
             runpush(ctx, DAT_PROPNUM, &val);
             p += 2;
-            break;
+            RUNNEXT;
             
-        case OPCNEG:
+        RUNCASE(OPCNEG):
             val.runstyp = DAT_NUMBER;
             val.runsv.runsvnum = -runpopnum(ctx);
             runrepush(ctx, &val);
-            break;
+            RUNNEXT;
             
-        case OPCBNOT:
+        RUNCASE(OPCBNOT):
             val.runstyp = DAT_NUMBER;
             val.runsv.runsvnum = ~runpopnum(ctx);
             runrepush(ctx, &val);
-            break;
+            RUNNEXT;
             
-        case OPCNOT:
+        RUNCASE(OPCNOT):
             if (runtoslog(ctx))
                 runpush(ctx, runclog(!runpoplog(ctx)), &val);
             else
                 runpush(ctx, runclog(runpopnum(ctx)), &val);
-            break;
+            RUNNEXT;
             
-        case OPCADD:
+        RUNCASE(OPCADD):
             runpop(ctx, &val2);    /* right op is pushed last -> popped 1st */
             runpop(ctx, &val);
             runadd(ctx, &val, &val2, 2);
             runrepush(ctx, &val);
-            break;
+            RUNNEXT;
             
-        case OPCSUB:
+        RUNCASE(OPCSUB):
             runpop(ctx, &val2);    /* right op is pushed last -> popped 1st */
             runpop(ctx, &val);
             (void)runsub(ctx, &val, &val2, 2);
             runrepush(ctx, &val);
-            break;
+            RUNNEXT;
 
-        case OPCMUL:
+        RUNCASE(OPCMUL):
             val.runstyp = DAT_NUMBER;
             val.runsv.runsvnum = runpopnum(ctx);
             val.runsv.runsvnum *= runpopnum(ctx);
             runrepush(ctx, &val);
-            break;
+            RUNNEXT;
             
-        case OPCBAND:
+        RUNCASE(OPCBAND):
             val.runstyp = DAT_NUMBER;
             val.runsv.runsvnum = runpopnum(ctx);
             val.runsv.runsvnum &= runpopnum(ctx);
             runrepush(ctx, &val);
-            break;
+            RUNNEXT;
             
-        case OPCBOR:
+        RUNCASE(OPCBOR):
             val.runstyp = DAT_NUMBER;
             val.runsv.runsvnum = runpopnum(ctx);
             val.runsv.runsvnum |= runpopnum(ctx);
             runrepush(ctx, &val);
-            break;
+            RUNNEXT;
 
-        case OPCSHL:
+        RUNCASE(OPCSHL):
             val.runstyp = DAT_NUMBER;
             val.runsv.runsvnum = runpopnum(ctx);
             val.runsv.runsvnum = runpopnum(ctx) << val.runsv.runsvnum;
             runrepush(ctx, &val);
-            break;
+            RUNNEXT;
 
-        case OPCSHR:
+        RUNCASE(OPCSHR):
             val.runstyp = DAT_NUMBER;
             val.runsv.runsvnum = runpopnum(ctx);
             val.runsv.runsvnum = runpopnum(ctx) >> val.runsv.runsvnum;
             runrepush(ctx, &val);
-            break;
+            RUNNEXT;
             
-        case OPCXOR:
+        RUNCASE(OPCXOR):
             /* allow logical ^ logical or number ^ number */
             if (runtoslog(ctx))
             {
@@ -1288,64 +1540,64 @@ resume_from_error:
                 val.runsv.runsvnum ^= runpopnum(ctx);
             }
             runrepush(ctx, &val);
-            break;
+            RUNNEXT;
             
-        case OPCDIV:
+        RUNCASE(OPCDIV):
             val.runsv.runsvnum = runpopnum(ctx);
             if (val.runsv.runsvnum == 0)
                 runsig(ctx, ERR_DIVZERO);
             val.runsv.runsvnum = runpopnum(ctx) / val.runsv.runsvnum;
             val.runstyp = DAT_NUMBER;
             runrepush(ctx, &val);
-            break;
+            RUNNEXT;
 
-        case OPCMOD:
+        RUNCASE(OPCMOD):
             val.runsv.runsvnum = runpopnum(ctx);
             if (val.runsv.runsvnum == 0)
                 runsig(ctx, ERR_DIVZERO);
             val.runsv.runsvnum = runpopnum(ctx) % val.runsv.runsvnum;
             val.runstyp = DAT_NUMBER;
             runrepush(ctx, &val);
-            break;
+            RUNNEXT;
             
 #ifdef NEVER
-        case OPCAND:
+        RUNCASE(OPCAND):
             if (runtostyp(ctx) == DAT_LIST)
                 runlstisect(ctx);
             else
                 runpush(ctx, runclog(runpoplog(ctx) && runpoplog(ctx)), &val);
-            break;
+            RUNNEXT;
             
-        case OPCOR:
+        RUNCASE(OPCOR):
             runpush(ctx, runclog(runpoplog(ctx) || runpoplog(ctx)), &val);
-            break;
+            RUNNEXT;
 #endif /* NEVER */
 
-        case OPCEQ:
+        RUNCASE(OPCEQ):
             runpush(ctx, runclog(runeq(ctx)), &val);
-            break;
+            RUNNEXT;
             
-        case OPCNE:
+        RUNCASE(OPCNE):
             runpush(ctx, runclog(!runeq(ctx)), &val);
-            break;
+            RUNNEXT;
             
-        case OPCLT:
+        RUNCASE(OPCLT):
             runpush(ctx, runclog(runmcmp(ctx) < 0), &val);
-            break;
+            RUNNEXT;
             
-        case OPCLE:
+        RUNCASE(OPCLE):
             runpush(ctx, runclog(runmcmp(ctx) <= 0), &val);
-            break;
+            RUNNEXT;
             
-        case OPCGT:
+        RUNCASE(OPCGT):
             runpush(ctx, runclog(runmcmp(ctx) > 0), &val);
-            break;
+            RUNNEXT;
             
-        case OPCGE:
+        RUNCASE(OPCGE):
             runpush(ctx, runclog(runmcmp(ctx) >= 0), &val);
-            break;
+            RUNNEXT;
             
-        case OPCCALL:
+        RUNCASE(OPCCALL):
             {
                 objnum o;
 
@@ -1364,10 +1616,10 @@ resume_from_error:
 
                 /* restore code pointer in case target object moved */
                 p = runcprst(ctx, ofs, target, targprop) + 2;
-                break;
+                RUNNEXT;
             }
         
-        case OPCGETP:
+        RUNCASE(OPCGETP):
             nargc = *p++;
             runcheckargc(ctx, &nargc);
             prop = osrp2(p);
@@ -1375,17 +1627,17 @@ resume_from_error:
             obj = runpopobj(ctx);
             runpprop(ctx, &p, target, targprop, obj, prop, FALSE, nargc,
                      obj);
-            break;
+            RUNNEXT;
 
-        case OPCGETPDATA:
+        RUNCASE(OPCGETPDATA):
             prop = osrp2(p);
             p += 2;
             obj = runpopobj(ctx);
             runcheckpropdata(ctx, obj, prop);
             runpprop(ctx, &p, target, targprop, obj, prop, FALSE, 0, obj);
-            break;
+            RUNNEXT;
 
-        case OPCGETDBLCL:
+        RUNCASE(OPCGETDBLCL):
 #ifdef DBG_OFF
             /* non-debug mode - this will always throw an error */
             dbgfrfind(ctx->runcxdbg, 0, 0);
@@ -1402,20 +1654,20 @@ resume_from_error:
                 runrepush(ctx, otherbp + runrp2s(p + 4) - 1);
                 p += 6;
             }
-            break;
+            RUNNEXT;
 #endif
 
-        case OPCGETLCL:
+        RUNCASE(OPCGETLCL):
             runrepush(ctx, ctx->runcxbp + runrp2s(p) - 1);
             p += 2;
-            break;
+            RUNNEXT;
             
-        case OPCRETURN:
+        RUNCASE(OPCRETURN):
             runleave(ctx, argc /* was: osrp2(p) */);
             dbgleave(ctx->runcxdbg, DBGEXRET);
             goto done;
             
-        case OPCRETVAL:
+        RUNCASE(OPCRETVAL):
             /* if there's nothing on the stack, return nil */
             if (runtostyp(ctx) != DAT_BASEPTR)
                 runpop(ctx, &val);
@@ -1427,7 +1679,7 @@ resume_from_error:
             dbgleave(ctx->runcxdbg, DBGEXVAL);
             goto done;
             
-        case OPCENTER:
+        RUNCASE(OPCENTER):
             /* push old base pointer and set up new one */
             ctx->runcxsp = rstsp;
             val.runsv.runsvstr = (uchar *)ctx->runcxbp;
@@ -1444,13 +1696,13 @@ resume_from_error:
             
             /* save stack pointer - reset sp to this value on DISCARD */
             rstsp = ctx->runcxsp;
-            break;
+            RUNNEXT;
             
-        case OPCDISCARD:
+        RUNCASE(OPCDISCARD):
             ctx->runcxsp = rstsp;
-            break;
+            RUNNEXT;
             
-        case OPCSWITCH:
+        RUNCASE(OPCSWITCH):
         {
             int      i;
             int      tostyp;
@@ -1531,21 +1783,21 @@ resume_from_error:
 
             if (!match) p += 2;         /* if default, skip to default case */
             p += runrp2s(p);      /* wherever we left off, p points to jump */
-            break;
+            RUNNEXT;
         }
 
-        case OPCJMP:
+        RUNCASE(OPCJMP):
             p += runrp2s(p);
-            break;
+            RUNNEXT;
             
-        case OPCJT:
+        RUNCASE(OPCJT):
             if (runtoslog(ctx))
                 p += (runpoplog(ctx) ? runrp2s(p) : 2);
             else
                 p += (runpopnum(ctx) != 0 ? runrp2s(p) : 2);
-            break;
+            RUNNEXT;
             
-        case OPCJF:
+        RUNCASE(OPCJF):
             if (runtoslog(ctx))
                 p += ((!runpoplog(ctx)) ? runrp2s(p) : 2);
             else if (runtostyp(ctx) == DAT_NUMBER)
@@ -1555,14 +1807,14 @@ resume_from_error:
                 rundisc(ctx);  /* throw away the item considered to be true */
                 p += 2;
             }
-            break;
+            RUNNEXT;
             
-        case OPCSAY:
+        RUNCASE(OPCSAY):
             outfmt(ctx->runcxtio, p);
             p += osrp2(p);                              /* skip past string */
-            break;
+            RUNNEXT;
             
-        case OPCBUILTIN:
+        RUNCASE(OPCBUILTIN):
             {
                 int      binum;
                 runsdef *stkp;
@@ -1582,51 +1834,51 @@ resume_from_error:
 
                 p = runcprst(ctx, ofs, target, targprop);
                 p += 2;
-                break;
+                RUNNEXT;
             }
             
-        case OPCPTRCALL:
+        RUNCASE(OPCPTRCALL):
             nargc = *p++;
             runcheckargc(ctx, &nargc);
             ofs = runcpsav(ctx, &p, target, targprop);
             runfn(ctx, runpopfn(ctx), nargc);
             p = runcprst(ctx, ofs, target, targprop);
-            break;
+            RUNNEXT;
             
-        case OPCINHERIT:
+        RUNCASE(OPCINHERIT):
             nargc = *p++;
             runcheckargc(ctx, &nargc);
             prop = osrp2(p);
             p += 2;
             runpprop(ctx, &p, target, targprop, target, prop, TRUE, nargc,
                      self);
-            break;
+            RUNNEXT;
 
-        case OPCPTRINH:
+        RUNCASE(OPCPTRINH):
             nargc = *p++;
             runcheckargc(ctx, &nargc);
             prop = runpopprp(ctx);
             runpprop(ctx, &p, target, targprop, target, prop, TRUE, nargc,
                      self);
-            break;
+            RUNNEXT;
             
-        case OPCPTRGETP:
+        RUNCASE(OPCPTRGETP):
             nargc = *p++;
             runcheckargc(ctx, &nargc);
             prop = runpopprp(ctx);
             obj = runpopobj(ctx);
             runpprop(ctx, &p, target, targprop, obj, prop, FALSE, nargc,
                      obj);
-            break;
+            RUNNEXT;
 
-        case OPCPTRGETPDATA:
+        RUNCASE(OPCPTRGETPDATA):
             prop = runpopprp(ctx);
             obj = runpopobj(ctx);
             runcheckpropdata(ctx, obj, prop);
             runpprop(ctx, &p, target, targprop, obj, prop, FALSE, 0, obj);
-            break;
+            RUNNEXT;
             
-        case OPCEXPINH:
+        RUNCASE(OPCEXPINH):
             /* inheritance from explicit superclass */
             nargc = *p++;
             runcheckargc(ctx, &nargc);
@@ -1643,9 +1895,9 @@ resume_from_error:
              */
             runpprop(ctx, &p, target, targprop, obj, prop, FALSE,
                      nargc, self);
-            break;
+            RUNNEXT;
 
-        case OPCEXPINHPTR:
+        RUNCASE(OPCEXPINHPTR):
             nargc = *p++;
             runcheckargc(ctx, &nargc);
             prop = runpopprp(ctx);
@@ -1653,9 +1905,9 @@ resume_from_error:
             p += 2;
             runpprop(ctx, &p, target, targprop, obj, prop, FALSE,
                      nargc, self);
-            break;
+            RUNNEXT;
             
-        case OPCPASS:
+        RUNCASE(OPCPASS):
             prop = osrp2(p);
             runleave(ctx, 0);
             dbgleave(ctx->runcxdbg, DBGEXPASS);
@@ -1663,79 +1915,79 @@ resume_from_error:
                      self);
             goto done;
             
-        case OPCEXIT:
+        RUNCASE(OPCEXIT):
             errsig(ctx->runcxerr, ERR_RUNEXIT);
             /* NOTREACHED */
             
-        case OPCABORT:
+        RUNCASE(OPCABORT):
             errsig(ctx->runcxerr, ERR_RUNABRT);
             /* NOTREACHED */
             
-        case OPCASKDO:
+        RUNCASE(OPCASKDO):
             errsig(ctx->runcxerr, ERR_RUNASKD);
             /* NOTREACHED */
             
-        case OPCASKIO:
+        RUNCASE(OPCASKIO):
             errsig1(ctx->runcxerr, ERR_RUNASKI, ERRTINT, osrp2(p));
             /* NOTREACHED */
             
-        case OPCJE:
+        RUNCASE(OPCJE):
             p += (runeq(ctx) ? runrp2s(p) : 2);
-            break;
+            RUNNEXT;
             
-        case OPCJNE:
+        RUNCASE(OPCJNE):
             p += (!runeq(ctx) ? runrp2s(p) : 2);
-            break;
+            RUNNEXT;
             
-        case OPCJGT:
+        RUNCASE(OPCJGT):
             p += (runmcmp(ctx) > 0 ? runrp2s(p) : 2);
-            break;
+            RUNNEXT;
             
-        case OPCJGE:
+        RUNCASE(OPCJGE):
             p += (runmcmp(ctx) >= 0 ? runrp2s(p) : 2);
-            break;
+            RUNNEXT;
             
-        case OPCJLT:
+        RUNCASE(OPCJLT):
             p += (runmcmp(ctx) < 0 ? runrp2s(p) : 2);
-            break;
+            RUNNEXT;
             
-        case OPCJLE:
+        RUNCASE(OPCJLE):
             p += (runmcmp(ctx) <= 0 ? runrp2s(p) : 2);
-            break;
+            RUNNEXT;
             
-        case OPCJNAND:
+        RUNCASE(OPCJNAND):
             p += (!(runpoplog(ctx) && runpoplog(ctx)) ? runrp2s(p) : 2);
-            break;
+            RUNNEXT;
             
-        case OPCJNOR:
+        RUNCASE(OPCJNOR):
             p += (!(runpoplog(ctx) || runpoplog(ctx)) ? runrp2s(p) : 2);
-            break;
+            RUNNEXT;
             
-        case OPCGETPSELF:
+        RUNCASE(OPCGETPSELF):
             nargc = *p++;
             runcheckargc(ctx, &nargc);
             prop = osrp2(p);
             p += 2;
             runpprop(ctx, &p, target, targprop, self, prop, FALSE, nargc,
                      self);
-            break;
+            RUNNEXT;
             
-        case OPCGETPSELFDATA:
+        RUNCASE(OPCGETPSELFDATA):
             prop = osrp2(p);
             p += 2;
             runcheckpropdata(ctx, self, prop);
             runpprop(ctx, &p, target, targprop, self, prop, FALSE, 0, self);
-            break;
+            RUNNEXT;
 
-        case OPCGETPPTRSELF:
+        RUNCASE(OPCGETPPTRSELF):
             nargc = *p++;
             runcheckargc(ctx, &nargc);
             prop = runpopprp(ctx);
             runpprop(ctx, &p, target, targprop, self, prop, FALSE, nargc,
                      self);
-            break;
+            RUNNEXT;
             
-        case OPCGETPOBJ:
+        RUNCASE(OPCGETPOBJ):
             nargc = *p++;
             runcheckargc(ctx, &nargc);
             obj = osrp2(p);
@@ -1743,15 +1995,15 @@ resume_from_error:
             p += 4;
             runpprop(ctx, &p, target, targprop, obj, prop, FALSE, nargc,
                      obj);
-            break;
+            RUNNEXT;
             
-        case OPCINDEX:
+        RUNCASE(OPCINDEX):
             i = runpopnum(ctx);                                /* get index */
             lstp = runpoplst(ctx);                          /* get the list */
             runpind(ctx, i, lstp);
-            break;
+            RUNNEXT;
             
-        case OPCJST:
+        RUNCASE(OPCJST):
             if (runtostyp(ctx) == DAT_TRUE)
                 p += runrp2s(p);
             else
@@ -1759,9 +2011,9 @@ resume_from_error:
                 (void)runpoplog(ctx);
                 p += 2;
             }
-            break;
+            RUNNEXT;
             
-        case OPCJSF:
+        RUNCASE(OPCJSF):
             if (runtostyp(ctx) == DAT_NIL ||
                 (runtostyp(ctx) == DAT_NUMBER &&
                  (ctx->runcxsp - 1)->runsv.runsvnum == 0))
@@ -1771,9 +2023,9 @@ resume_from_error:
                 runpop(ctx, &val);
                 p += 2;
             }
-            break;
+            RUNNEXT;
             
-        case OPCCALLEXT:
+        RUNCASE(OPCCALLEXT):
             {
 #if 0 // external functions are now obsolete
                 static runufdef uf =
@@ -1812,12 +2064,12 @@ resume_from_error:
                 runsig1(ctx, ERR_EXTRUN, ERRTSTR, ex->runxnam);
 #endif
             }
-            break;
+            RUNNEXT;
             
-        case OPCDBGRET:
+        RUNCASE(OPCDBGRET):
             goto done;
             
-        case OPCCONS:
+        RUNCASE(OPCCONS):
             {
                 uint    totsiz;
                 uint    oldsiz;
@@ -1864,14 +2116,14 @@ resume_from_error:
                 ctx->runcxhp = lstend.runsv.runsvstr + totsiz;
                 runrepush(ctx, &lstend);
             }
-            break;
+            RUNNEXT;
             
-        case OPCARGC:
+        RUNCASE(OPCARGC):
             val.runsv.runsvnum = argc;
             runpush(ctx, DAT_NUMBER, &val);
-            break;
+            RUNNEXT;
             
-        case OPCCHKARGC:
+        RUNCASE(OPCCHKARGC):
             if ((*p & 0x80) ? argc < (*p & 0x7f) : argc != *p)
             {
                 char namebuf[128];
@@ -1901,10 +2153,10 @@ resume_from_error:
                 runsig1(ctx, ERR_ARGC, ERRTSTR, namebuf);
             }
             ++p;
-            break;
+            RUNNEXT;
             
-        case OPCLINE:
-        case OPCBP:
+        RUNCASE(OPCLINE):
+        RUNCASE(OPCBP):
             {
                 uchar *ptr = mcmobjptr(ctx->runcxmem, (mcmon)target);
                 uint   ofs;
@@ -1924,22 +2176,22 @@ resume_from_error:
 
                 /* let the debugger take over, if it wants to */
                 dbgssi(ctx->runcxdbg, ofs, instr, 0, &p);
-                break;
+                RUNNEXT;
             }
             
-        case OPCFRAME:
+        RUNCASE(OPCFRAME):
             /* this is a frame record - just jump past it */
             p += osrp2(p);
-            break;
+            RUNNEXT;
             
-        case OPCASI_MASK | OPCASIDIR | OPCASILCL:
+        RUNCASEX(OPCASI_MASK | OPCASIDIR | OPCASILCL, asidirlcl):
             runpop(ctx, &val);
             OSCPYSTRUCT(*(ctx->runcxbp + runrp2s(p) - 1), val);
             stkval = &val;
             p += 2;
             goto no_assign;
             
-        case OPCASI_MASK | OPCASIDIR | OPCASIPRP:
+        RUNCASEX(OPCASI_MASK | OPCASIDIR | OPCASIPRP, asidirprp):
             obj = runpopobj(ctx);
             prop = osrp2(p);
             p += 2;
@@ -1947,22 +2199,25 @@ resume_from_error:
             stkval = valp = &val;
             goto assign_property;
 
-        case OPCASI_MASK | OPCASIDIR | OPCASIPRPPTR:
+        RUNCASEX(OPCASI_MASK | OPCASIDIR | OPCASIPRPPTR, asidirprpptr):
             prop = runpopprp(ctx);
             obj = runpopobj(ctx);
             runpop(ctx, &val);
             stkval = valp = &val;
             goto assign_property;
 
-        case OPCNEW:
+        RUNCASE(OPCNEW):
             run_new(ctx, &p, target, targprop);
-            break;
+            RUNNEXT;
             
-        case OPCDELETE:
+        RUNCASE(OPCDELETE):
             run_delete(ctx, &p, target, targprop);
-            break;
+            RUNNEXT;
             
         default:
+#ifdef RUN_COMPUTED_GOTO
+        runop_default:
+#endif
             if ((opc & OPCASI_MASK) == OPCASI_MASK)
             {
                 runsdef  val3;
@@ -2267,6 +2522,7 @@ resume_from_error:
                         ofs = runcpsav(ctx, &p, target, targprop);
                         objsetp(ctx->runcxmem, obj, prop, valp->runstyp,
                                 valbuf, ctx->runcxundo);
+                        vocacinv(ctx->runcxvoc);
                         p = runcprst(ctx, ofs, target, targprop);
                         break;
                     }
@@ -2333,6 +2589,7 @@ resume_from_error:
             }
             else
                 errsig(ctx->runcxerr, ERR_INVOPC);
+            RUNNEXT;
         }
     }
 
@@ -135,6 +135,24 @@ typedef struct runcxdef runcxdef;
 /* execute a function, given the function object number */
 void runfn(runcxdef *ctx, noreg objnum objn, int argc);
 
+/*
+ *   Call profiler (see runprf.c).  These are compiled in only if
+ *   RUN_PROFILER is defined; RUN_IF_PROFILER() expands its argument only
+ *   in profiling builds.  runprfenter() returns the call depth before the
+ *   call (as does runprfdepth()), which the caller passes to runprfleave()
+ *   when the call returns or when an error unwinds through it.  
+ */
+#ifdef RUN_PROFILER
+# define RUN_IF_PROFILER(x)  x
+void runprfstart(void);
+void runprfstop(void);
+int  runprfenter(objnum obj, prpnum prp);
+int  runprfdepth(void);
+void runprfleave(int dep);
+#else
+# define RUN_IF_PROFILER(x)
+#endif
+
 /*
  *   Execute p-code given a pointer to the code.  p is the actual pointer
  *   to the first byte of code to be executed. self is the object to be
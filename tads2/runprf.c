@@ -0,0 +1,244 @@
+/*
+ *   Please see the accompanying license file, LICENSE.TXT, for information
+ *   on using and copying this software.
+ */
+/*
+Name
+  runprf.c - run-time call profiler
+Function
+  Keeps call counts and inclusive and exclusive elapsed times for every
+  function and every object.property method the run-time executes, and
+  writes a report sorted by exclusive time when the game ends.
+Notes
+  Compiled in only if RUN_PROFILER is defined (see the t2_profiler option
+  in qtads.pro).  Profiling is active only if the T2_PROFILE environment
+  variable is set when the game starts; it gives the name of the report
+  file.
+
+  runfn() and runpprop() call runprfenter() before executing code and
+  runprfleave() afterwards, including when an error unwinds through them,
+  so the profiler's own stack always mirrors the active calls.  Since the
+  run-time normally has no symbol table, the report identifies functions
+  and methods by object and property number.
+Modified
+  10/14/26  - Creation
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "os.h"
+#include "run.h"
+
+#ifdef RUN_PROFILER
+
+/* per-function running totals */
+typedef struct runprfrec runprfrec;
+struct runprfrec
+{
+    runprfrec *runprfnxt;                      /* next record in hash chain */
+    objnum     runprfobj;                       /* function or method object */
+    prpnum     runprfprp;                   /* method property; 0 = function */
+    ulong      runprfcnt;                               /* invocation count */
+    double     runprfinc;               /* inclusive time, in microseconds */
+    double     runprfexc;                /* exclusive time, in microseconds */
+};
+
+/* active call stack entry */
+typedef struct runprffrm runprffrm;
+struct runprffrm
+{
+    runprfrec *runprffrec;                           /* record being timed */
+    double     runprfstrt;                      /* time the call started */
+    double     runprfchi;             /* time spent in children so far */
+};
+
+#define RUNPRFHSIZ  1024                              /* hash table size */
+#define RUNPRFSTK   512                       /* maximum call depth timed */
+
+static runprfrec *runprftab[RUNPRFHSIZ];        /* hash table of records */
+static runprffrm  runprfstk[RUNPRFSTK];                    /* call stack */
+static int        runprfdep;                      /* current call depth */
+static ulong      runprfnrec;                   /* number of records kept */
+static char      *runprffname;         /* report file name; null if off */
+
+/* hash an object.property pair */
+#define runprfhsh(obj, prp) \
+    ((((uint)(obj) * 31) + (uint)(prp)) & (RUNPRFHSIZ - 1))
+
+/* get the current time, in microseconds */
+static double runprftim(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, (struct timezone *)0);
+    return (double)tv.tv_sec * 1000000.0 + (double)tv.tv_usec;
+}
+
+/* start profiling, if the environment asks for it */
+void runprfstart(void)
+{
+    char *fname;
+
+    if (runprffname != 0 || (fname = getenv("T2_PROFILE")) == 0
+        || *fname == '\0')
+        return;
+
+    if ((runprffname = (char *)osmalloc(strlen(fname) + 1)) == 0)
+        return;
+    strcpy(runprffname, fname);
+    runprfdep = 0;
+}
+
+/* find or create the record for an object.property pair */
+static runprfrec *runprffind(objnum obj, prpnum prp)
+{
+    runprfrec **bucket = &runprftab[runprfhsh(obj, prp)];
+    runprfrec  *rec;
+
+    for (rec = *bucket ; rec ; rec = rec->runprfnxt)
+        if (rec->runprfobj == obj && rec->runprfprp == prp)
+            return rec;
+
+    if ((rec = (runprfrec *)osmalloc(sizeof(runprfrec))) == 0)
+        return 0;
+    memset(rec, 0, sizeof(*rec));
+    rec->runprfobj = obj;
+    rec->runprfprp = prp;
+    rec->runprfnxt = *bucket;
+    *bucket = rec;
+    ++runprfnrec;
+    return rec;
+}
+
+/* note entry into a function or method, returning the prior call depth */
+int runprfenter(objnum obj, prpnum prp)
+{
+    int        dep = runprfdep;
+    runprffrm *frm;
+
+    if (runprffname == 0)
+        return dep;
+
+    /* time the call, unless we're past our maximum depth */
+    if (dep < RUNPRFSTK)
+    {
+        frm = &runprfstk[dep];
+        frm->runprffrec = runprffind(obj, prp);
+        frm->runprfchi = 0.0;
+        frm->runprfstrt = runprftim();
+        if (frm->runprffrec)
+            ++(frm->runprffrec->runprfcnt);
+    }
+    ++runprfdep;
+    return dep;
+}
+
+/* get the current call depth */
+int runprfdepth(void)
+{
+    return runprfdep;
+}
+
+/* note exit from calls back down to the given depth */
+void runprfleave(int dep)
+{
+    double     now;
+    double     elapsed;
+    runprffrm *frm;
+
+    if (runprffname == 0)
+        return;
+
+    now = runprftim();
+    while (runprfdep > dep)
+    {
+        if (--runprfdep >= RUNPRFSTK)
+            continue;
+        frm = &runprfstk[runprfdep];
+        elapsed = now - frm->runprfstrt;
+        if (frm->runprffrec)
+        {
+            frm->runprffrec->runprfinc += elapsed;
+            frm->runprffrec->runprfexc += elapsed - frm->runprfchi;
+        }
+        if (runprfdep > 0)
+            runprfstk[runprfdep - 1].runprfchi += elapsed;
+    }
+}
+
+/* sort records by descending exclusive time, for qsort */
+static int runprfcmp(const void *a0, const void *b0)
+{
+    const runprfrec *a = *(const runprfrec *const *)a0;
+    const runprfrec *b = *(const runprfrec *const *)b0;
+
+    return (a->runprfexc > b->runprfexc ? -1
+            : a->runprfexc < b->runprfexc ? 1 : 0);
+}
+
+/* stop profiling, write the report, and discard the data */
+void runprfstop(void)
+{
+    runprfrec **arr;
+    runprfrec  *rec;
+    runprfrec  *nxt;
+    osfildef   *fp;
+    char        buf[128];
+    ulong       i;
+    ulong       n;
+
+    if (runprffname == 0)
+        return;
+
+    /* close out any calls still active */
+    runprfleave(0);
+
+    /* gather the records into an array and sort them */
+    arr = (runprfrec **)osmalloc((size_t)(runprfnrec + 1) * sizeof(*arr));
+    for (n = 0, i = 0 ; arr != 0 && i < RUNPRFHSIZ ; ++i)
+        for (rec = runprftab[i] ; rec ; rec = rec->runprfnxt)
+            arr[n++] = rec;
+    if (arr != 0 && (fp = osfopwt(runprffname, OSFTTEXT)) != 0)
+    {
+        qsort(arr, (size_t)n, sizeof(*arr), runprfcmp);
+
+        sprintf(buf, "%10s %12s %12s  %s\n",
+                "calls", "excl (ms)", "incl (ms)", "function/method");
+        os_fprintz(fp, buf);
+        for (i = 0 ; i < n ; ++i)
+        {
+            rec = arr[i];
+            sprintf(buf, "%10lu %12.3f %12.3f  ",
+                    (unsigned long)rec->runprfcnt, rec->runprfexc / 1000.0, rec->runprfinc / 1000.0);
+            os_fprintz(fp, buf);
+            if (rec->runprfprp == 0)
+                sprintf(buf, "function#%u\n", (unsigned)rec->runprfobj);
+            else
+                sprintf(buf, "obj#%u.prop#%u\n", (unsigned)rec->runprfobj,
+                        (unsigned)rec->runprfprp);
+            os_fprintz(fp, buf);
+        }
+        osfcls(fp);
+    }
+    if (arr != 0)
+        osfree(arr);
+
+    /* discard the records */
+    for (i = 0 ; i < RUNPRFHSIZ ; ++i)
+    {
+        for (rec = runprftab[i] ; rec ; rec = nxt)
+        {
+            nxt = rec->runprfnxt;
+            osfree(rec);
+        }
+        runprftab[i] = 0;
+    }
+    runprfnrec = 0;
+    osfree(runprffname);
+    runprffname = 0;
+}
+
+#endif /* RUN_PROFILER */
@@ -204,7 +204,7 @@ static void trdmain1(errcxdef *ec, int argc, char *argv[],
     noreg int  loadopen = FALSE;
     char       inbuf[OSFNMAX];
     ulong      cachelimit = 0xffffffff;
-    ushort     undosiz = TRD_UNDOSIZ;      /* default undo context size 16k */
+    uint       undosiz = TRD_UNDOSIZ;     /* maximum undo context size */
     objucxdef *undoptr = 0;
     uint       flags;         /* flags used to write the file we're reading */
     objnum     preinit;         /* preinit object, if we need to execute it */
@@ -222,6 +222,7 @@ static void trdmain1(errcxdef *ec, int argc, char *argv[],
     char      *charmap = 0;                           /* character map file */
     int        charmap_none;       /* explicitly do not use a character set */
     int        doublespace = TRUE;        /* formatter double-space setting */
+    int        accmemo = FALSE;  /* remember access checks within a command */
     
     NOREG((&loadopen))
 
@@ -242,6 +243,16 @@ static void trdmain1(errcxdef *ec, int argc, char *argv[],
         {
             switch(*(arg+1))
             {
+            case 'a':
+                if (!strnicmp(arg, "-accmemo", 8))
+                {
+                    /* remember access checks within a command */
+                    accmemo = cmdtog(ec, accmemo, arg, 7, trdusage);
+                }
+                else
+                    trdusage(ec);
+                break;
+
             case 'c':
                 if (!strcmp(arg+1, "ctab"))
                 {
@@ -367,7 +378,8 @@ static void trdmain1(errcxdef *ec, int argc, char *argv[],
                 break;
                 
             case 'u':
-                undosiz = atoi(cmdarg(ec, &argp, &i, argc, 1, trdusage));
+                undosiz = (uint)atol(cmdarg(ec, &argp, &i, argc, 1,
+                                            trdusage));
                 break;
                 
             default:
@@ -532,6 +544,8 @@ static void trdmain1(errcxdef *ec, int argc, char *argv[],
 
     /* set up vocabulary context */
     vocini(&vocctx, ec, mctx, &runctx, undoptr, 100, 100, 200);
+    if (accmemo)
+        vocctx.voccxflg |= VOCCXFACM;
 
     /*
      *   save a pointer to the voc context globally, so that certain
@@ -632,7 +646,9 @@ static void trdmain1(errcxdef *ec, int argc, char *argv[],
     os_csr_busy(FALSE);
     
     /* play the game */
+    RUN_IF_PROFILER(runprfstart();)
     plygo(&runctx, &vocctx, (tiocxdef *)0, preinit, restore_file);
+    RUN_IF_PROFILER(runprfstop();)
     
     /* close load file */
     fiorcls(&fiolctx);
@@ -651,6 +667,9 @@ static void trdmain1(errcxdef *ec, int argc, char *argv[],
     qasclose();
 
     ERRCLEAN(ec)
+        /* write the profile, if we were collecting one */
+        RUN_IF_PROFILER(runprfstop();)
+
         /* close and delete swapfile, if one was opened */
         trd_close_swapfile(&runctx);
         
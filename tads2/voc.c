@@ -535,6 +535,7 @@ void vocini(voccxdef *vocctx, errcxdef *errctx, mcmcxdef *memctx,
     vocinialo(vocctx, &vocctx->voccxfus, (vocctx->voccxfuc = fuses));
     vocinialo(vocctx, &vocctx->voccxdmn, (vocctx->voccxdmc = daemons));
     vocinialo(vocctx, &vocctx->voccxalm, (vocctx->voccxalc = notifiers));
+    vocctx->voccxfuu = vocctx->voccxdmu = vocctx->voccxalu = 0;
 
     /* no entries in vocwdef free list yet */
     vocctx->voccxwfre = VOCCXW_NONE;
@@ -173,6 +173,24 @@ struct vocddef
 };
 typedef struct vocddef vocddef;
 
+/* 
+ *   access check memo entry - the result of one call to vocchkaccess(),
+ *   keyed on everything that goes into the call 
+ */
+struct vocacdef
+{
+    objnum   vocacobj;                                    /* object checked */
+    objnum   vocacact;                                    /* actor checking */
+    objnum   vocacvrb;                                     /* verb checking */
+    prpnum   vocacprp;                               /* validation property */
+    int      vocacseq;                                   /* sequence number */
+    int      vocacval;                          /* result of the validation */
+};
+typedef struct vocacdef vocacdef;
+
+/* number of access checks we remember per command */
+#define VOCACMAX  64
+
 /* vocabulary object list entry */
 struct vocoldef
 {
@@ -240,6 +258,16 @@ struct voccxdef
     uint       voccxfuc;                   /* number of slots in fuse array */
     vocddef   *voccxalm;                            /* array of alarm slots */
     uint       voccxalc;                  /* number of slots in alarm array */
+
+    /*
+     *   In-use bounds for the daemon, fuse, and alarm arrays: every slot at
+     *   or past the bound is free, so scans of an array can stop there
+     *   rather than visiting every slot each turn.  A bound can be higher
+     *   than needed (after an undo, for example), but never lower. 
+     */
+    uint       voccxdmu;
+    uint       voccxfuu;
+    uint       voccxalu;
     char       voccxtim[26];            /* game's timestamp (asctime value) */
     
     objnum     voccxvtk;                /* object number of "take" deepverb */
@@ -302,6 +330,24 @@ struct voccxdef
 #define VOCCXFVWARN    2                /* generate redundant verb warnings */
 #define VOCCXFDBG      4           /* debug mode:  show parsing information */
 #define VOCCXAGAINDEL  8             /* "again" lost due to object deletion */
+#define VOCCXFACM     16         /* remember access checks within a command */
+
+    /*
+     *   Access check memo.  When VOCCXFACM is set, vocchkaccess() remembers
+     *   the results of the validDo/validIo/validActor calls it makes, so
+     *   that checking the same object again for the same verb and actor
+     *   (as happens a lot with "all" and plurals) doesn't run the game's
+     *   code again.  This assumes the validation methods depend only on
+     *   property values and have no side effects, which isn't true of
+     *   every game, so it's off by default.  The memo is cleared at the
+     *   start of each command and whenever a property is set, an object
+     *   is created or deleted, or a turn is undone; voccxacg counts these
+     *   so that a check whose own code changed something isn't recorded. 
+     */
+    vocacdef   voccxacm[VOCACMAX];
+    uint       voccxacn;                        /* number of entries in use */
+    uint       voccxacx;                   /* next entry to replace if full */
+    uint       voccxacg;                         /* invalidation generation */
 
     /* number of remaining unresolved unknown words in the command */
     int        voccxunknown;
@@ -511,6 +557,9 @@ void voc_parse_disambig(voccxdef *ctx);
 /* replace the current command - TADS program code interface */
 void voc_parse_replace_cmd(voccxdef *ctx);
 
+/* clear the access check memo - see voccxacm */
+#define vocacinv(ctx) ((ctx)->voccxacn = 0, ++(ctx)->voccxacg)
+
 /* check access to an object */
 int vocchkaccess(voccxdef *ctx, objnum obj, prpnum verprop,
                  int seqno, objnum actor, objnum verb);
@@ -1897,6 +1897,23 @@ startover:
     return 0;
 }
 
+/*
+ *   Object membership set for list intersection.  This has one bit per
+ *   possible object number.  To intersect two lists, we mark the members
+ *   of the second list in the set, run through the first list keeping
+ *   the elements whose bits are set, and then clear the second list's
+ *   bits again, so the set is always empty between uses.  This makes an
+ *   intersection linear in the lengths of the lists, rather than taking
+ *   time proportional to the product of the lengths, which adds up
+ *   quickly when disambiguating among a large number of objects.  
+ */
+static uchar vocisset[(MCMONINV >> 3) + 1];
+
+/* add an object to, remove an object from, or test the membership set */
+#define vocisadd(obj) (vocisset[(obj) >> 3] |= (uchar)(1 << ((obj) & 7)))
+#define vocisdel(obj) (vocisset[(obj) >> 3] &= (uchar)~(1 << ((obj) & 7)))
+#define vocistst(obj) (vocisset[(obj) >> 3] & (1 << ((obj) & 7)))
+
 /*
  *   intersect - takes two lists and puts the intersection of them into
  *   the first list.
@@ -1905,18 +1922,22 @@ static int vocisect(objnum *list1, objnum *list2)
 {
     int i, j, k;
 
+    /* mark the members of the second list */
+    for (j = 0 ; list2[j] != MCMONINV ; ++j)
+        vocisadd(list2[j]);
+
+    /* keep the elements of the first list that are in the second list */
     for (i = k = 0 ; list1[i] != MCMONINV ; ++i)
     {
-        for (j = 0 ; list2[j] != MCMONINV ; ++j)
-        {
-            if (list1[i] == list2[j])
-            {
-                list1[k++] = list1[i];
-                break;
-            }
-        }
+        if (vocistst(list1[i]))
+            list1[k++] = list1[i];
     }
     list1[k] = MCMONINV;
+
+    /* clear the marks */
+    for (j = 0 ; list2[j] != MCMONINV ; ++j)
+        vocisdel(list2[j]);
+
     return(k);
 }
 
@@ -1929,20 +1950,28 @@ static int vocisect_flags(objnum *list1, uint *flags1,
 {
     int i, j, k;
 
+    /* mark the members of the second list */
+    for (j = 0 ; list2[j] != MCMONINV ; ++j)
+        vocisadd(list2[j]);
+
     for (i = k = 0 ; list1[i] != MCMONINV ; ++i)
     {
-        for (j = 0 ; list2[j] != MCMONINV ; ++j)
-        {
-            if (list1[i] == list2[j])
-            {
-                list1[k] = list1[i];
-                flags1[k] = flags1[i] | flags2[j];
-                ++k;
-                break;
-            }
-        }
+        /* skip this element if it's not in the second list at all */
+        if (!vocistst(list1[i]))
+            continue;
+
+        /* find the (first) matching entry, so we can merge its flags */
+        for (j = 0 ; list2[j] != list1[i] ; ++j) ;
+        list1[k] = list1[i];
+        flags1[k] = flags1[i] | flags2[j];
+        ++k;
     }
     list1[k] = MCMONINV;
+
+    /* clear the marks */
+    for (j = 0 ; list2[j] != MCMONINV ; ++j)
+        vocisdel(list2[j]);
+
     return(k);
 }
 
@@ -4591,16 +4620,9 @@ int voclistlen(vocoldef *lst)
  *   functions).  Note that if we're checking an actor, we'll just call
  *   obj.validActor() for the object itself (not the verb).
  */
-int vocchkaccess(voccxdef *ctx, objnum obj, prpnum verprop,
-                 int seqno, objnum cmdActor, objnum cmdVerb)
+static int vocchkacc1(voccxdef *ctx, objnum obj, prpnum verprop,
+                      int seqno, objnum cmdActor, objnum cmdVerb)
 {
-    /* 
-     *   special case: the special "string" and "number" objects are
-     *   always accessible 
-     */
-    if (obj == ctx->voccxstr || obj == ctx->voccxnum)
-        return TRUE;
-
     /*
      *   If the access method is validActor, make sure the object in fact
      *   has a validActor method defined; if it doesn't, we must be
@@ -4637,6 +4659,63 @@ int vocchkaccess(voccxdef *ctx, objnum obj, prpnum verprop,
     return runpoplog(ctx->voccxrun);
 }
 
+int vocchkaccess(voccxdef *ctx, objnum obj, prpnum verprop,
+                 int seqno, objnum cmdActor, objnum cmdVerb)
+{
+    vocacdef *p;
+    uint      i;
+    uint      gen;
+    int       val;
+    
+    /* 
+     *   special case: the special "string" and "number" objects are
+     *   always accessible 
+     */
+    if (obj == ctx->voccxstr || obj == ctx->voccxnum)
+        return TRUE;
+
+    /* if we're not remembering checks, just run it */
+    if (!(ctx->voccxflg & VOCCXFACM))
+        return vocchkacc1(ctx, obj, verprop, seqno, cmdActor, cmdVerb);
+
+    /* look for the same check earlier in this command */
+    if (cmdActor == MCMONINV)
+        cmdActor = ctx->voccxme;
+    for (i = ctx->voccxacn, p = ctx->voccxacm ; i ; ++p, --i)
+    {
+        if (p->vocacobj == obj && p->vocacprp == verprop
+            && p->vocacact == cmdActor && p->vocacvrb == cmdVerb
+            && p->vocacseq == seqno)
+            return p->vocacval;
+    }
+
+    /* 
+     *   run the check, and remember the result - unless the check itself
+     *   changed something, in which case the result might not hold for a
+     *   second check 
+     */
+    gen = ctx->voccxacg;
+    val = vocchkacc1(ctx, obj, verprop, seqno, cmdActor, cmdVerb);
+    if (gen == ctx->voccxacg)
+    {
+        /* use a free entry if there is one, otherwise replace in turn */
+        if (ctx->voccxacn < VOCACMAX)
+            p = &ctx->voccxacm[ctx->voccxacn++];
+        else
+        {
+            p = &ctx->voccxacm[ctx->voccxacx];
+            ctx->voccxacx = (ctx->voccxacx + 1) % VOCACMAX;
+        }
+        p->vocacobj = obj;
+        p->vocacact = cmdActor;
+        p->vocacvrb = cmdVerb;
+        p->vocacprp = verprop;
+        p->vocacseq = seqno;
+        p->vocacval = val;
+    }
+    return val;
+}
+
 /* ask game if object is visible to the actor */
 int vocchkvis(voccxdef *ctx, objnum obj, objnum cmdActor)
 {
@@ -4653,6 +4732,7 @@ void vocsetobj(voccxdef *ctx, objnum obj, dattyp typ, void *val,
     *outobj = *inobj;
     outobj->vocolobj = obj;
     objsetp(ctx->voccxmem, obj, PRP_VALUE, typ, val, ctx->voccxundo);
+    vocacinv(ctx);
 }
 
 /* set up a vocoldef */
@@ -8070,6 +8150,9 @@ int voccmd(voccxdef *ctx, char *cmd, uint cmdlen)
         /* presume we won't find an unknown word */
         ctx->voccxunknown = 0;
 
+        /* forget access checks from the previous command */
+        vocacinv(ctx);
+
         /* find the THEN that ends the command, if there is one */
         for (next = cur ; cur < wrdcnt && !vocspec(wordlist[cur], VOCW_THEN)
              ; ++cur) ;
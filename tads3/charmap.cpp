@@ -31,6 +31,72 @@ Modified
 #include "vmdatasrc.h"
 
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Get the length of the run of plain ASCII bytes (1-127) at the start of
+ *   a buffer.  Most of the text that passes through the mappers is ASCII,
+ *   so we scan a machine word at a time where we can: a word can be skipped
+ *   as a unit if none of its bytes has the high bit set and none is zero.
+ *   We stop at null bytes because the mappers don't all treat null as an
+ *   ordinary character.  
+ */
+static size_t ascii_run_len(const char *p, size_t len)
+{
+    const unsigned long lo = ~0UL / 255;
+    const unsigned long hi = lo * 128;
+    const char *start = p;
+
+    /* skip whole words of ASCII */
+    for ( ; len >= sizeof(unsigned long) ;
+          p += sizeof(unsigned long), len -= sizeof(unsigned long))
+    {
+        /* fetch the word (memcpy, since 'p' might not be aligned) */
+        unsigned long w;
+        memcpy(&w, p, sizeof(w));
+
+        /* stop at any high-bit byte, or (failing that) any zero byte */
+        if ((w & hi) != 0 || ((w - lo) & hi) != 0)
+            break;
+    }
+
+    /* finish up a byte at a time */
+    for ( ; len != 0 && (unsigned char)(*p - 1) < 127 ; ++p, --len) ;
+
+    /* return the length of the run */
+    return p - start;
+}
+
+/*
+ *   Copy a run of plain ASCII bytes from a single-byte local character set
+ *   to UTF-8, for a mapper that maps ASCII to itself.  Follows the usual
+ *   map() conventions: we advance the output pointer and deduct from the
+ *   output length for what fits, and return the full length of the run
+ *   whether or not it fits.  
+ */
+static size_t copy_ascii_run(char **outp, size_t *outlen,
+                             const char **inp, size_t *inlen)
+{
+    size_t run, n;
+
+    /* find the run; if there isn't one, there's nothing to do */
+    if ((run = ascii_run_len(*inp, *inlen)) == 0)
+        return 0;
+
+    /* copy as much as fits */
+    n = (run <= *outlen ? run : *outlen);
+    memcpy(*outp, *inp, n);
+    *outp += n;
+    *outlen -= n;
+
+    /* consume the input */
+    *inp += run;
+    *inlen -= run;
+
+    /* return the run length */
+    return run;
+}
+
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Basic Mapper Class 
@@ -670,6 +736,9 @@ CCharmapToLocalASCII::CCharmapToLocalASCII()
                 *exp_dst++ = (wchar_t)p->asc[i];
         }
     }
+
+    /* note whether ASCII maps to itself */
+    note_ascii_ident();
 }
 
 /* ------------------------------------------------------------------------ */
@@ -722,6 +791,72 @@ CCharmapToLocal8859_1::CCharmapToLocal8859_1()
         *dst++ = 1;
         *dst++ = (unsigned char)c;
     }
+
+    /* note the ASCII identity mapping */
+    note_ascii_ident();
+}
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Windows code page 1252 
+ */
+
+const wchar_t CCharmap::cp1252_hi_[32] =
+{
+    0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,
+    0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178
+};
+
+/*
+ *   create the local-to-Unicode mapper 
+ */
+CCharmapToUniCp1252::CCharmapToUniCp1252()
+{
+    wchar_t i;
+
+    /* everything outside 0x80-0x9F is the same as ISO 8859-1 */
+    for (i = 0 ; i < 256 ; ++i)
+        set_mapping(i >= 0x80 && i <= 0x9F ? cp1252_hi_[i - 0x80] : i, i);
+}
+
+/*
+ *   create the Unicode-to-local mapper 
+ */
+CCharmapToLocalCp1252::CCharmapToLocalCp1252()
+{
+    unsigned char *dst;
+    wchar_t c;
+
+    /* 
+     *   allocate the translation array: a length byte and a character byte
+     *   for each of the 256 code points, plus the default entry 
+     */
+    xlat_array_ = (unsigned char *)t3malloc(256*2 + 2);
+    dst = xlat_array_;
+
+    /* add the default entry for unmappable characters */
+    set_mapping(0, 0);
+    *dst++ = 1;
+    *dst++ = '?';
+
+    /* 
+     *   Map each byte's Unicode code point to the byte.  The C1 controls
+     *   that Windows reassigns to other characters are left unmapped, so
+     *   they fall back on the default entry.  
+     */
+    for (c = 0 ; c < 256 ; ++c)
+    {
+        wchar_t uni = (c >= 0x80 && c <= 0x9F ? cp1252_hi_[c - 0x80] : c);
+        set_mapping(uni, dst - xlat_array_);
+        *dst++ = 1;
+        *dst++ = (unsigned char)c;
+    }
+
+    /* note the ASCII identity mapping */
+    note_ascii_ident();
 }
 
 
@@ -742,6 +877,9 @@ CCharmapToLocal::CCharmapToLocal()
     /* no translation or expansion arrays yet */
     xlat_array_ = 0;
     exp_array_ = 0;
+
+    /* we don't know anything about the ASCII mappings yet */
+    ascii_ident_ = FALSE;
 }
 
 /*
@@ -1077,6 +1215,10 @@ CCharmapToLocal *CCharmapToLocal::load(CResLoader *res_loader,
         if (name_is_8859_1_synonym(table_name))
             return new CCharmapToLocal8859_1();
 
+        /* likewise for Windows 1252 */
+        if (name_is_cp1252_synonym(table_name))
+            return new CCharmapToLocalCp1252();
+
         /* no map file - return failure */
         return 0;
     }
@@ -1109,6 +1251,9 @@ CCharmapToLocal *CCharmapToLocal::load(CResLoader *res_loader,
     {
         /* load the table */
         mapper->load_table(fp);
+
+        /* note whether ASCII maps to itself */
+        mapper->note_ascii_ident();
     }
 
     /* close the file */
@@ -1118,6 +1263,36 @@ CCharmapToLocal *CCharmapToLocal::load(CResLoader *res_loader,
     return mapper;
 }
 
+/*
+ *   Note whether the ASCII characters map to themselves 
+ */
+void CCharmapToLocal::note_ascii_ident()
+{
+    wchar_t c;
+
+    /* presume not */
+    ascii_ident_ = FALSE;
+
+    /* if we don't have a translation array, there are no mappings */
+    if (xlat_array_ == 0)
+        return;
+
+    /* check each ASCII character other than null */
+    for (c = 1 ; c < 128 ; ++c)
+    {
+        const unsigned char *mapping;
+        size_t map_len;
+
+        /* if this one doesn't map to the single byte 'c', we're done */
+        mapping = get_xlation(c, &map_len);
+        if (map_len != 1 || mapping[0] != (unsigned char)c)
+            return;
+    }
+
+    /* they all map to themselves */
+    ascii_ident_ = TRUE;
+}
+
 /*
  *   Load the character set translation table 
  */
@@ -1464,6 +1639,36 @@ size_t CCharmapToLocalSB::map_utf8(char *dest, size_t dest_len,
     {
         const unsigned char *mapping;
         size_t map_len;
+
+        /* 
+         *   if ASCII maps to itself, copy any run of ASCII characters
+         *   straight through, as much as will fit 
+         */
+        if (ascii_ident_)
+        {
+            size_t run = ascii_run_len(src.getptr(), srcend - src.getptr());
+            if (dest != 0 && run > dest_len)
+                run = dest_len;
+
+            if (run != 0)
+            {
+                /* copy the run */
+                if (dest != 0)
+                {
+                    memcpy(dest, src.getptr(), run);
+                    dest += run;
+                    dest_len -= run;
+                }
+
+                /* count it and skip it in the source */
+                cur_total += run;
+                src.set(src.getptr() + run);
+
+                /* if that's the end of the source, we're done */
+                if (src.getptr() >= srcend)
+                    break;
+            }
+        }
         
         /* get the mapping for this character */
         mapping = get_xlation(src.getch(), &map_len);
@@ -1517,6 +1722,32 @@ size_t CCharmapToLocalSB::map_utf8z(char *dest, size_t dest_len,
         const unsigned char *mapping;
         size_t map_len;
 
+        /* 
+         *   if ASCII maps to itself, copy any run of ASCII characters
+         *   straight through, as much as will fit 
+         */
+        if (ascii_ident_)
+        {
+            const char *p = src.getptr();
+            const char *start = p;
+
+            /* copy what fits */
+            for ( ; dest_len != 0 && (unsigned char)(*p - 1) < 127 ;
+                  ++p, --dest_len)
+                *dest++ = *p;
+
+            /* count (but don't copy) the rest of the run */
+            for ( ; (unsigned char)(*p - 1) < 127 ; ++p) ;
+
+            /* count it and skip it in the source */
+            cur_total += p - start;
+            src.set((char *)p);
+
+            /* if that's the end of the string, we're done */
+            if (*p == '\0')
+                break;
+        }
+
         /* get the mapping for this character */
         mapping = get_xlation(src.getch(), &map_len);
 
@@ -2030,6 +2261,18 @@ CCharmapToUni *CCharmapToUni::load(class CResLoader *res_loader,
     if (name_is_ucs2be_synonym(table_name))
         return new CCharmapToUniUcs2Big();
 
+    /* 
+     *   ISO 8859-1 and Windows 1252 map one-to-one into Unicode, so a
+     *   mapping file can't tell us anything our built-in tables don't;
+     *   skip the search for one.  (This isn't true in the other direction,
+     *   where a mapping file can supply approximations for characters
+     *   outside the local set.)  
+     */
+    if (name_is_8859_1_synonym(table_name))
+        return new CCharmapToUni8859_1();
+    if (name_is_cp1252_synonym(table_name))
+        return new CCharmapToUniCp1252();
+
     /* presume failure */
     mapper = 0;
 
@@ -2046,10 +2289,6 @@ CCharmapToUni *CCharmapToUni::load(class CResLoader *res_loader,
         if (name_is_ascii_synonym(table_name))
             return new CCharmapToUniASCII();
 
-        /* if they want an ISO-8859-1 translator, return a default one */
-        if (name_is_8859_1_synonym(table_name))
-            return new CCharmapToUni8859_1();
-
         /* return failure */
         return 0;
     }
@@ -2183,6 +2422,16 @@ void CCharmapToUni::validate(char *buf, size_t len)
 {
     for ( ; len != 0 ; ++buf, --len)
     {
+        /* skip any run of plain ASCII, which is always valid */
+        size_t run = ascii_run_len(buf, len);
+        if (run != 0)
+        {
+            buf += run;
+            len -= run;
+            if (len == 0)
+                break;
+        }
+
         /* check the type of the character */
         char c = *buf;
         if ((c & 0x80) == 0)
@@ -2313,6 +2562,11 @@ size_t CCharmapToUniASCII::map(char **outp, size_t *outlen,
         wchar_t uni;
         size_t csiz;
 
+        /* copy any run of ASCII characters straight through */
+        tot_outlen += copy_ascii_run(outp, outlen, &inp, &inlen);
+        if (inlen == 0)
+            break;
+
         /* 
          *   map any character outside of the 7-bit range to U+FFFD, the
          *   Unicode REPLACEMENT CHARACTER, which is the standard way to
@@ -2372,6 +2626,17 @@ size_t CCharmapToUniSB::map(char **outp, size_t *outlen,
     {
         wchar_t uni;
         size_t csiz;
+
+        /* 
+         *   if ASCII maps to itself, copy any run of ASCII characters
+         *   straight through 
+         */
+        if (ascii_ident_cnt_ == 127)
+        {
+            tot_outlen += copy_ascii_run(outp, outlen, &inp, &inlen);
+            if (inlen == 0)
+                break;
+        }
         
         /* get the unicode mapping for this character */
         uni = map_[(unsigned char)*inp];
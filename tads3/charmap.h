@@ -181,6 +181,24 @@ protected:
                 || stricmp(table_name, "cp819") == 0);
     }
 
+    /* check a name to see if it matches one of the names for Windows 1252 */
+    static int name_is_cp1252_synonym(const char *table_name)
+    {
+        return (stricmp(table_name, "cp1252") == 0
+                || stricmp(table_name, "1252") == 0
+                || stricmp(table_name, "windows-1252") == 0
+                || stricmp(table_name, "windows1252") == 0
+                || stricmp(table_name, "win-1252") == 0
+                || stricmp(table_name, "win1252") == 0);
+    }
+
+    /* 
+     *   Unicode code points for Windows 1252 bytes 0x80-0x9F.  The rest of
+     *   the code page matches ISO 8859-1.  The five bytes that Windows
+     *   leaves undefined map to the C1 control with the same value. 
+     */
+    static const wchar_t cp1252_hi_[32];
+
     /* reference count */
     unsigned int ref_cnt_;
 };
@@ -230,6 +248,15 @@ public:
      */
     virtual int mapchar(wchar_t &ch, const char *&p, size_t &len) = 0;
 
+    /*
+     *   Does this mapping pass the ASCII characters 1-127 through
+     *   unchanged, one byte per character?  If so, a caller reading local
+     *   text can copy runs of ASCII bytes directly instead of mapping them
+     *   a character at a time.  Returns false by default; subclasses
+     *   override this when they know better.  
+     */
+    virtual int is_ascii_transparent() const { return FALSE; }
+
     /*
      *   Convert a string from the local character set to Unicode.
      *   Returns the byte length of the output.  If the output buffer is
@@ -397,6 +424,13 @@ public:
     virtual size_t map(wchar_t unicode_char, char **output_ptr,
                        size_t *output_buf_len) const = 0;
 
+    /* 
+     *   Is the local character set UTF-8?  If so, callers holding Unicode
+     *   text can encode it directly rather than mapping it a character at
+     *   a time through map().  
+     */
+    virtual int is_utf8() const { return FALSE; }
+
     /*
      *   Simple single-character mapper - returns the byte length of the
      *   local character equivalent of the unicode character, which is
@@ -674,6 +708,15 @@ protected:
     /* set an expansion mapping */
     void set_exp_mapping(wchar_t unicode_char, unsigned int exp_offset);
 
+    /*
+     *   Note whether the 7-bit ASCII characters (other than null) map to
+     *   themselves as single bytes.  Call this after the mappings have all
+     *   been set up; when this is true, the single-byte mappers can copy
+     *   runs of ASCII text straight through without looking up each
+     *   character.  
+     */
+    void note_ascii_ident();
+
     /*
      *   The master mapping table list.  Each entry points to the
      *   sub-array that contains the mapping for the 256 characters whose
@@ -713,6 +756,12 @@ protected:
      *   expansion.  
      */
     wchar_t *exp_array_;
+
+    /* 
+     *   do the ASCII characters 1-127 map to themselves?  (set by
+     *   note_ascii_ident()) 
+     */
+    int ascii_ident_;
 };
 
 
@@ -745,6 +794,9 @@ public:
         return (len >= utf8_ptr::s_charsize(*p));
     }
 
+    /* ASCII is the same in UTF-8 */
+    virtual int is_ascii_transparent() const { return TRUE; }
+
     /* map one character */
     virtual int mapchar(wchar_t &ch, const char *&p, size_t &len)
     {
@@ -955,6 +1007,9 @@ public:
     size_t map(char **output_ptr, size_t *output_buf_len,
                const char *input_ptr, size_t input_len) const;
 
+    /* ASCII passes through unchanged */
+    virtual int is_ascii_transparent() const { return TRUE; }
+
     /* map one character */
     virtual int mapchar(wchar_t &ch, const char *&p, size_t &len)
     {
@@ -999,12 +1054,19 @@ public:
         /* initialize the mapping table to all U+FFFD */
         for (i = 0 ; i < 256 ; ++i)
             map_[i] = 0xFFFD;
+
+        /* none of the ASCII characters map to themselves yet */
+        ascii_ident_cnt_ = 0;
     }
     
     /* map a string */
     size_t map(char **output_ptr, size_t *output_buf_len,
                const char *input_ptr, size_t input_len) const;
 
+    /* ASCII passes through if each ASCII character maps to itself */
+    virtual int is_ascii_transparent() const
+        { return ascii_ident_cnt_ == 127; }
+
     /* map one character */
     virtual int mapchar(wchar_t &ch, const char *&p, size_t &len)
     {
@@ -1032,7 +1094,22 @@ protected:
          *   range 
          */
         if (((unsigned int)local_code_pt) < 256)
+        {
+            /* 
+             *   keep our count of ASCII characters 1-127 that map to
+             *   themselves up to date 
+             */
+            if (local_code_pt >= 1 && local_code_pt <= 127)
+            {
+                if (map_[local_code_pt] == local_code_pt)
+                    --ascii_ident_cnt_;
+                if (uni_code_pt == local_code_pt)
+                    ++ascii_ident_cnt_;
+            }
+
+            /* set the mapping */
             map_[local_code_pt] = uni_code_pt;
+        }
     }
 
 private:
@@ -1042,6 +1119,12 @@ private:
      *   possible 256 source characters 
      */
     wchar_t map_[256];
+
+    /* 
+     *   the number of ASCII characters 1-127 that map to themselves; when
+     *   this is 127, we can copy runs of ASCII input straight through 
+     */
+    int ascii_ident_cnt_;
 };
 
 /* ------------------------------------------------------------------------ */
@@ -1251,6 +1334,17 @@ public:
     }
 };
 
+/*
+ *   Character mapper for Windows code page 1252 to UTF-8.  This is the
+ *   usual local character set on Western Windows systems, so we build it
+ *   in rather than requiring a mapping file for it.  
+ */
+class CCharmapToUniCp1252: public CCharmapToUniSB
+{
+public:
+    CCharmapToUniCp1252();
+};
+
 /* ======================================================================== */
 /*
  *   Unicode UTF-8 - to - local character set mappers 
@@ -1287,6 +1381,8 @@ public:
         /* every character can be mapped UTF8-to-UTF8, obviously */
         return TRUE;
     }
+    /* the local character set is UTF-8 */
+    virtual int is_utf8() const { return TRUE; }
 };
 
 /* ------------------------------------------------------------------------ */
@@ -1366,6 +1462,17 @@ public:
     CCharmapToLocal8859_1();
 };
 
+/*
+ *   Character mapper for mapping to local Windows code page 1252.  As with
+ *   8859-1, this is built in so that we can create one without a mapping
+ *   file.  
+ */
+class CCharmapToLocalCp1252: public CCharmapToLocalSB
+{
+public:
+    CCharmapToLocalCp1252();
+};
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Character mapper for 16-bit Wide Unicode local character set.  Stores
@@ -186,6 +186,14 @@
 #pragma intrinsic(memcpy)
 #endif
 
+/* use the x86 SHA extensions when the CPU has them           */
+#if (defined(__GNUC__) || defined(__clang__)) \
+    && (defined(__x86_64__) || defined(__i386__))
+#  define SHA256_NI
+#  include <cpuid.h>
+#  include <immintrin.h>
+#endif
+
 #define rotr32(x,n)   (((x) >> n) | ((x) << (32 - n)))
 
 #if !defined(bswap_32)
@@ -273,7 +281,29 @@ void sha256_begin(sha256_ctx ctx[1])
 /* buffer will now go to the high end of words on BOTH big  */
 /* and little endian systems                                */
 
+#if defined(SHA256_NI)
+static void sha256_compile_ni(sha256_ctx ctx[1]);
+static int sha256_have_ni();
+
+/* the SHA extensions are detected once, at program start-up  */
+static const int sha256_use_ni = sha256_have_ni();
+#endif
+
+static void sha256_compile_c(sha256_ctx ctx[1]);
+
 void sha256_compile(sha256_ctx ctx[1])
+{
+#if defined(SHA256_NI)
+    if(sha256_use_ni)
+    {
+        sha256_compile_ni(ctx);
+        return;
+    }
+#endif
+    sha256_compile_c(ctx);
+}
+
+static void sha256_compile_c(sha256_ctx ctx[1])
 {   sha2_32t    v[8], j;
 
     memcpy(v, ctx->hash, 8 * sizeof(sha2_32t));
@@ -290,6 +320,82 @@ void sha256_compile(sha256_ctx ctx[1])
     ctx->hash[4] += v[4]; ctx->hash[5] += v[5]; ctx->hash[6] += v[6]; ctx->hash[7] += v[7];
 }
 
+#if defined(SHA256_NI)
+
+/* x86 SHA extensions version of sha256_compile.  This needs */
+/* SHA, SSSE3 and SSE4.1; every CPU with the SHA extensions   */
+/* also has the others, but we check them all anyway.         */
+
+static int sha256_have_ni()
+{   unsigned int a, b, c, d;
+
+    if(!__get_cpuid(1, &a, &b, &c, &d)
+       || !(c & bit_SSSE3) || !(c & bit_SSE4_1))
+        return 0;
+
+    if(__get_cpuid_max(0, 0) < 7)
+        return 0;
+
+    __cpuid_count(7, 0, a, b, c, d);
+    return (b & (1 << 29)) != 0;
+}
+
+/* The message words in ctx->wbuf[] are already in native     */
+/* order (see the note on sha256_compile above), so unlike    */
+/* the usual SHA-NI code we can load them without a shuffle.  */
+
+__attribute__((target("sha,ssse3,sse4.1")))
+static void sha256_compile_ni(sha256_ctx ctx[1])
+{   __m128i     st0, st1, save0, save1, tmp, k, m[4];
+    int         i;
+
+    /* rearrange the state from ABCD/EFGH into ABEF/CDGH order */
+    tmp = _mm_loadu_si128((const __m128i *)&ctx->hash[0]);
+    st1 = _mm_loadu_si128((const __m128i *)&ctx->hash[4]);
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);
+    st1 = _mm_shuffle_epi32(st1, 0x1B);
+    st0 = _mm_alignr_epi8(tmp, st1, 8);
+    st1 = _mm_blend_epi16(st1, tmp, 0xF0);
+
+    save0 = st0;
+    save1 = st1;
+
+    for(i = 0; i < 16; ++i)
+    {
+        /* message words 4i..4i+3, expanding the schedule past 15 */
+        if(i < 4)
+            m[i] = _mm_loadu_si128((const __m128i *)&ctx->wbuf[i * 4]);
+        else
+        {
+            tmp = _mm_sha256msg1_epu32(m[i & 3], m[(i + 1) & 3]);
+            tmp = _mm_add_epi32(
+                tmp, _mm_alignr_epi8(m[(i + 3) & 3], m[(i + 2) & 3], 4));
+            m[i & 3] = _mm_sha256msg2_epu32(tmp, m[(i + 3) & 3]);
+        }
+
+        /* four rounds */
+        k = _mm_add_epi32(
+            m[i & 3], _mm_loadu_si128((const __m128i *)&k256[i * 4]));
+        st1 = _mm_sha256rnds2_epu32(st1, st0, k);
+        k = _mm_shuffle_epi32(k, 0x0E);
+        st0 = _mm_sha256rnds2_epu32(st0, st1, k);
+    }
+
+    st0 = _mm_add_epi32(st0, save0);
+    st1 = _mm_add_epi32(st1, save1);
+
+    /* back to ABCD/EFGH order */
+    tmp = _mm_shuffle_epi32(st0, 0x1B);
+    st1 = _mm_shuffle_epi32(st1, 0xB1);
+    st0 = _mm_blend_epi16(tmp, st1, 0xF0);
+    st1 = _mm_alignr_epi8(st1, tmp, 8);
+
+    _mm_storeu_si128((__m128i *)&ctx->hash[0], st0);
+    _mm_storeu_si128((__m128i *)&ctx->hash[4], st1);
+}
+
+#endif
+
 /* SHA256 hash data in an array of bytes into hash buffer   */
 /* and call the hash_compile function as required.          */
 
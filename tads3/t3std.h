@@ -132,6 +132,21 @@ Modified
 #endif
 #endif
 
+/*
+ *   Per-thread static data.  A few pieces of process-wide state have to be
+ *   kept per thread when the host runs several VM instances at once, each
+ *   on its own thread, which it can do in the VMGLOB_PARAM configuration.
+ *   In that configuration we declare these with OS_DECL_TLS, so the OS
+ *   header must provide declarative TLS (OS_DECLARATIVE_TLS).  In the other
+ *   configurations there's only one VM per process, so they're ordinary
+ *   statics.
+ */
+#ifdef VMGLOB_PARAM
+#define T3_DECL_PER_THREAD(typ, varname)  OS_DECL_TLS(typ, varname)
+#else
+#define T3_DECL_PER_THREAD(typ, varname)  typ varname
+#endif
+
 
 /* ------------------------------------------------------------------------ */
 /*
@@ -6463,6 +6463,16 @@ void *CTcPrsAllocObj::operator new(size_t siz)
  *   Parse Tree space manager 
  */
 
+/* 
+ *   block size - pick a size that's large enough that we won't be unduly
+ *   inefficient (in terms of having tons of blocks), but still friendly to
+ *   16-bit platforms (i.e., under 64k) 
+ */
+#define TCPRSMEM_BLOCK_SIZE  65000
+
+/* maximum number of spare blocks we keep for reuse */
+#define TCPRSMEM_MAX_SPARE  4
+
 /*
  *   create 
  */
@@ -6470,6 +6480,8 @@ CTcPrsMem::CTcPrsMem()
 {
     /* we have no blocks yet */
     head_ = tail_ = 0;
+    spare_ = 0;
+    spare_cnt_ = 0;
 
     /* allocate our first block */
     alloc_block();
@@ -6479,6 +6491,14 @@ CTcPrsMem::~CTcPrsMem()
 {
     /* delete all objects in our pool */
     delete_all();
+
+    /* delete the spare blocks */
+    while (spare_ != 0)
+    {
+        tcprsmem_blk_t *nxt = spare_->next_;
+        t3free(spare_);
+        spare_ = nxt;
+    }
 }
 
 /*
@@ -6497,11 +6517,24 @@ void CTcPrsMem::save_state(tcprsmem_state_t *state)
  */
 void CTcPrsMem::reset()
 {
-    /* delete all blocks */
-    delete_all();
-
-    /* re-allocate the initial block */
-    alloc_block();
+    /* 
+     *   Reset to the start of the first block.  This releases all of the
+     *   later blocks to the spare list, so that we don't have to allocate
+     *   them again the next time the pool grows.  
+     */
+    if (head_ != 0)
+    {
+        tcprsmem_state_t state;
+        state.tail = head_;
+        state.free_ptr = (char *)osrndpt((unsigned char *)head_->buf_);
+        state.rem = TCPRSMEM_BLOCK_SIZE - (state.free_ptr - head_->buf_);
+        reset(&state);
+    }
+    else
+    {
+        /* we have no blocks at all - allocate the initial block */
+        alloc_block();
+    }
 
     /* fixups are allocated in parser memory, so they're gone now */
     G_objfixup = 0;
@@ -6528,8 +6561,15 @@ void CTcPrsMem::reset(const tcprsmem_state_t *state)
         /* remember the next block */
         nxt = cur->next_;
 
-        /* delete this block */
-        t3free(cur);
+        /* keep the block for reuse if we have room, otherwise delete it */
+        if (spare_cnt_ < TCPRSMEM_MAX_SPARE)
+        {
+            cur->next_ = spare_;
+            spare_ = cur;
+            ++spare_cnt_;
+        }
+        else
+            t3free(cur);
 
         /* move on to the next one */
         cur = nxt;
@@ -6579,19 +6619,23 @@ void CTcPrsMem::alloc_block()
 {
     tcprsmem_blk_t *blk;
 
-    /* 
-     *   block size - pick a size that's large enough that we won't be
-     *   unduly inefficient (in terms of having tons of blocks), but still
-     *   friendly to 16-bit platforms (i.e., under 64k) 
-     */
-    const size_t BLOCK_SIZE = 65000;
-
-    /* allocate space for the block */
-    blk = (tcprsmem_blk_t *)t3malloc(sizeof(tcprsmem_blk_t) + BLOCK_SIZE - 1);
+    /* reuse a spare block if we have one, otherwise allocate a new one */
+    if (spare_ != 0)
+    {
+        blk = spare_;
+        spare_ = blk->next_;
+        --spare_cnt_;
+    }
+    else
+    {
+        /* allocate space for the block */
+        blk = (tcprsmem_blk_t *)t3malloc(
+            sizeof(tcprsmem_blk_t) + TCPRSMEM_BLOCK_SIZE - 1);
 
-    /* if that failed, throw an error */
-    if (blk == 0)
-        err_throw(TCERR_NO_MEM_PRS_TREE);
+        /* if that failed, throw an error */
+        if (blk == 0)
+            err_throw(TCERR_NO_MEM_PRS_TREE);
+    }
 
     /* link in the block at the end of our list */
     blk->next_ = 0;
@@ -6619,7 +6663,7 @@ void CTcPrsMem::alloc_block()
      *   above the start of the buffer, we'll have lost a little space in
      *   the buffer for the alignment offset) 
      */
-    rem_ = BLOCK_SIZE - (free_ptr_ - blk->buf_);
+    rem_ = TCPRSMEM_BLOCK_SIZE - (free_ptr_ - blk->buf_);
 }
 
 /*
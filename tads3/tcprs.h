@@ -2777,6 +2777,16 @@ private:
 
     /* remaining space available in last block */
     size_t rem_;
+
+    /* 
+     *   Spare blocks.  When we reset to a saved state, we keep the blocks
+     *   we release here (up to a limit), so that a caller that repeatedly
+     *   saves and resets the pool - as the dynamic compiler does for each
+     *   compilation - reuses the same memory instead of going back to the
+     *   system allocator every time. 
+     */
+    struct tcprsmem_blk_t *spare_;
+    int spare_cnt_;
 };
 
 /* 
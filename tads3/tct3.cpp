@@ -841,6 +841,30 @@ void CTcGenTarg::remove_last_jmp()
     G_cs->dec_ofs(3);
 }
 
+/*
+ *   Remove a conditional jump that can never be taken 
+ */
+int CTcGenTarg::remove_dead_cond_jump(uchar opc)
+{
+    /* check for JT on nil or JF on true */
+    if ((opc == OPC_JT && last_op_ == OPC_PUSHNIL)
+        || (opc == OPC_JF && last_op_ == OPC_PUSHTRUE))
+    {
+        /* delete the one-byte push */
+        G_cs->dec_ofs(1);
+
+        /* roll back the peephole for the deletion */
+        last_op_ = second_last_op_;
+        second_last_op_ = OPC_NOP;
+
+        /* tell the caller to leave out the jump */
+        return TRUE;
+    }
+
+    /* it's not a constant condition */
+    return FALSE;
+}
+
 /*
  *   Add a line record 
  */
@@ -897,6 +921,41 @@ try_combine:
         break;
 
     case OPC_DISC:
+        /*
+         *   If the previous instruction simply pushed a value, with no
+         *   side effects and no fixups in its operands, the DISC cancels
+         *   it out: delete both instructions.
+         */
+        switch(last_op_)
+        {
+        case OPC_PUSH_0:
+        case OPC_PUSH_1:
+        case OPC_PUSHNIL:
+        case OPC_PUSHTRUE:
+        case OPC_PUSHSELF:
+        case OPC_PUSHINT8:
+        case OPC_PUSHINT:
+        case OPC_DUP:
+        case OPC_GETR0:
+        case OPC_GETLCL1:
+        case OPC_GETARG1:
+        case OPC_GETLCLN0:
+        case OPC_GETLCLN1:
+        case OPC_GETLCLN2:
+        case OPC_GETLCLN3:
+        case OPC_GETLCLN4:
+        case OPC_GETLCLN5:
+            /* delete the DISC and the push */
+            G_cs->dec_ofs(op_len + CVmOpcodes::op_siz[last_op_]);
+
+            /* roll back the peephole for the two deleted instructions */
+            last_op_ = second_last_op_;
+            second_last_op_ = OPC_NOP;
+
+            /* there's nothing left to write */
+            return;
+        }
+
         /* combine DISC+DISC -> DISC1<2> */
         if (last_op_ == OPC_DISC)
         {
@@ -1007,6 +1066,11 @@ try_combine:
         case OPC_GETR0:
             opc = OPC_JR0F;
             goto combine;
+
+        case OPC_PUSHNIL:
+            /* jumping if nil is false - the jump is always taken */
+            opc = OPC_JMP;
+            goto combine;
         }
         break;
 
@@ -1072,6 +1136,29 @@ try_combine:
         case OPC_GETR0:
             opc = OPC_JR0T;
             goto combine;
+
+        case OPC_PUSHTRUE:
+            /* jumping if true is true - the jump is always taken */
+            opc = OPC_JMP;
+            goto combine;
+        }
+        break;
+
+    case OPC_JNIL:
+        /* if the value being tested is a constant nil, always jump */
+        if (last_op_ == OPC_PUSHNIL)
+        {
+            opc = OPC_JMP;
+            goto combine;
+        }
+        break;
+
+    case OPC_JNOTNIL:
+        /* a constant 'true' is never nil, so always jump */
+        if (last_op_ == OPC_PUSHTRUE)
+        {
+            opc = OPC_JMP;
+            goto combine;
         }
         break;
 
@@ -2803,7 +2890,17 @@ void CTcPrsNode::gen_code_cond(CTcCodeLabel *then_label,
      *   is true; otherwise, jump to the 'else' part if the condition is
      *   false 
      */
-    if (then_label != 0)
+    if (G_cg->remove_dead_cond_jump(then_label != 0 ? OPC_JT : OPC_JF))
+    {
+        /* 
+         *   the condition is a constant that never takes the jump - the
+         *   code generator removed the constant, so we can simply fall
+         *   through 
+         */
+        G_cg->note_pop();
+        return;
+    }
+    else if (then_label != 0)
     {
         /* we have a 'then' part, so jump if true to the 'then' part */
         G_cg->write_op(OPC_JT);
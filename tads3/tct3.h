@@ -674,6 +674,15 @@ public:
      */
     void remove_last_jmp();
 
+    /*
+     *   Check for a conditional jump (JT or JF) that will never be taken
+     *   because it tests a constant we just pushed.  If so, we delete the
+     *   push and return true; the caller should then omit the jump
+     *   entirely.  Conditional jumps on a constant that are always taken
+     *   are converted to JMP by write_op(), so we don't handle those.  
+     */
+    int remove_dead_cond_jump(uchar opc);
+
     /*
      *   Stack depth counting.  While we're generating code for a code
      *   block (a function or method), we'll keep track of our stack push
@@ -92,6 +92,32 @@ void tok_embed_ctx::start_expr(wchar_t qu, int triple, int report)
 }
 
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Character class and keyword prefilter tables.  These are filled in
+ *   when the first tokenizer is created.
+ *   
+ *   tok_symch_[c] is non-zero if byte 'c' is an ASCII symbol character
+ *   (letter, digit, or underscore).  The symbol scanner uses this to skip
+ *   over the plain ASCII part of a symbol a byte at a time, without the
+ *   UTF-8 decoding and character classification it needs for the general
+ *   case.
+ *   
+ *   tok_kwlen_[c] has bit N set if there's a keyword of length N that
+ *   starts with byte 'c'.  Most symbols can't possibly be keywords by this
+ *   test, which lets us skip hashing them for the keyword table lookup.  
+ */
+static unsigned char tok_symch_[256];
+static unsigned long tok_kwlen_[256];
+
+/* might the given symbol text be a keyword? */
+inline static int tok_maybe_kw(const char *txt, size_t len)
+{
+    return (len != 0 && len < 32
+            && (tok_kwlen_[(unsigned char)txt[0]] & (1UL << len)) != 0);
+}
+
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Initialize the tokenizer 
@@ -325,9 +351,21 @@ CTcTokenizer::CTcTokenizer(CResLoader *res_loader,
     /* create the keyword hash table */
     kw_ = new CVmHashTable(64, new CVmHashFuncCS(), TRUE);
 
-    /* populate the keyword table */
+    /* populate the keyword table and the keyword prefilter */
     for (kwp = kwlist ; kwp->kw_text != 0 ; ++kwp)
+    {
+        size_t kwlen = strlen(kwp->kw_text);
+
         kw_->add(new CTcHashEntryKw(kwp->kw_text, kwp->kw_tok_id));
+        if (kwlen < 32)
+            tok_kwlen_[(unsigned char)kwp->kw_text[0]] |= (1UL << kwlen);
+        else
+            tok_kwlen_[(unsigned char)kwp->kw_text[0]] |= ~0UL;
+    }
+
+    /* set up the symbol character table */
+    for (i = 0 ; i < 256 ; ++i)
+        tok_symch_[i] = (i < 128 && is_sym((wchar_t)i));
 
     /* no ungot tokens yet */
     unget_head_ = unget_cur_ = 0;
@@ -2025,6 +2063,24 @@ tc_toktyp_t CTcTokenizer::next_on_line(utf8_ptr *p, CTcToken *tok,
             if (!is_ascii(cur))
                 non_ascii = cur;
 
+            /* 
+             *   Skip the plain ASCII symbol characters directly.  These are
+             *   all single bytes, so we can scan the bytes with our
+             *   character class table; the loop below takes care of
+             *   anything else.  
+             */
+            {
+                const char *q = p->getptr();
+                while (tok_symch_[(unsigned char)*q])
+                    ++q;
+
+                /* note where the symbol limit falls, if we passed it */
+                if ((size_t)(q - start.getptr()) >= TOK_SYM_MAX_LEN)
+                    stop = start.getptr() + TOK_SYM_MAX_LEN - 1;
+
+                p->set((char *)q);
+            }
+
             /* 
              *   scan the identifier (note that we've already skipped the
              *   first character, so we start out at length = 1) 
@@ -2178,7 +2234,10 @@ int CTcTokenizer::look_up_keyword(const CTcToken *tok, tc_toktyp_t *kwtok)
     CTcHashEntryKw *kw;
 
     /* look it up in the keyword table */
-    kw = (CTcHashEntryKw *)kw_->find(tok->get_text(), tok->get_text_len());
+    kw = (tok_maybe_kw(tok->get_text(), tok->get_text_len())
+          ? (CTcHashEntryKw *)kw_->find(tok->get_text(),
+                                        tok->get_text_len())
+          : 0);
     if (kw != 0)
     {
         /* we found the keyword - set 'kw' to the keyword token id */
@@ -2249,8 +2308,11 @@ tc_toktyp_t CTcTokenizer::next_on_line_xlat_keep()
                     CTcHashEntryKw *kw;
                 
                     /* look it up in the keyword table */
-                    kw = (CTcHashEntryKw *)kw_->find(curtok_.get_text(),
-                        curtok_.get_text_len());
+                    kw = (tok_maybe_kw(curtok_.get_text(),
+                                       curtok_.get_text_len())
+                          ? (CTcHashEntryKw *)kw_->find(
+                              curtok_.get_text(), curtok_.get_text_len())
+                          : 0);
                     if (kw != 0)
                     {
                         /* replace the token with the keyword token type */
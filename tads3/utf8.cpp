@@ -20,8 +20,41 @@ Modified
   10/17/98 MJRoberts  - Creation
 */
 
+#include <string.h>
+
 #include "utf8.h"
 
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Measure the ASCII run at the start of a buffer.  We check a whole
+ *   machine word at a time for any byte with the high bit set; the word is
+ *   fetched with memcpy() so that we don't depend on the platform's
+ *   alignment or aliasing rules, which compilers turn into a plain load.  
+ */
+size_t utf8_ptr::s_ascii_len(const char *p, size_t bytecnt)
+{
+    /* a mask with the high bit of each byte of a word set */
+    const unsigned long hibits = (~0UL / 0xFF) * 0x80;
+    const char *start = p;
+    const char *end = p + bytecnt;
+
+    /* check whole words while we have at least a word remaining */
+    for ( ; (size_t)(end - p) >= sizeof(hibits) ; p += sizeof(hibits))
+    {
+        unsigned long w;
+        memcpy(&w, p, sizeof(w));
+        if ((w & hibits) != 0)
+            break;
+    }
+
+    /* finish up a byte at a time */
+    for ( ; p < end && (*p & 0x80) == 0 ; ++p) ;
+
+    /* return the length of the run */
+    return p - start;
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   encode a string of wide characters into the buffer 
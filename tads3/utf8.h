@@ -162,8 +162,7 @@ public:
     }
 
     /* increment by a give number of characters */
-    void inc_by(size_t cnt)
-        { for ( ; cnt > 0 ; inc(), --cnt) ; }
+    void inc_by(size_t cnt) { p_ += s_bytelen(p_, cnt); }
 
     /* decrement the pointer by one character */
     void dec() { p_ = s_dec(p_); }
@@ -276,7 +275,7 @@ public:
     static wchar_t s_getch_at(const char *p, size_t ofs)
     {
         /* skip the given number of characters */
-        for ( ; ofs != 0 ; --ofs, p += s_charsize(*p)) ;
+        p += s_bytelen(p, ofs);
 
         /* return the character at the current position */
         return s_getch(p);
@@ -409,9 +408,23 @@ public:
         /* get the ending pointer */
         const char *end = p + bytecnt;
 
-        /* increment until we run out of bytes */ 
+        /* 
+         *   Step through the buffer a character at a time, but skip over
+         *   runs of plain ASCII in bulk - each ASCII byte is exactly one
+         *   character, and most text is mostly ASCII.  
+         */
         size_t cnt;
-        for (cnt = 0 ; p < end ; p = s_inc(p), ++cnt) ;
+        for (cnt = 0 ; p < end ; p = s_inc(p), ++cnt)
+        {
+            if ((*p & 0x80) == 0)
+            {
+                size_t n = s_ascii_len(p, end - p);
+                p += n;
+                cnt += n;
+                if (p >= end)
+                    break;
+            }
+        }
 
         /* return the result */
         return cnt;
@@ -420,14 +433,39 @@ public:
     /* count the number of bytes in the given number of characters */
     static size_t s_bytelen(const char *str, size_t charcnt)
     {
-        /* skip the given number of characters */
+        /* 
+         *   skip the given number of characters, again skipping ASCII
+         *   runs in bulk; a run of 'charcnt' characters is at least
+         *   'charcnt' bytes long, so it's safe to scan that far ahead 
+         */
         const char *p;
-        for (p = str ; charcnt != 0 ; p = s_inc(p), --charcnt) ;
+        for (p = str ; charcnt != 0 ; p = s_inc(p), --charcnt)
+        {
+            if ((*p & 0x80) == 0)
+            {
+                size_t n = s_ascii_len(p, charcnt);
+                p += n;
+                charcnt -= n;
+                if (charcnt == 0)
+                    break;
+            }
+        }
 
         /* return the number of bytes we skipped */
         return (p - str);
     }
 
+    /*
+     *   Get the length in bytes of the run of plain ASCII characters
+     *   (0x00-0x7F) at the start of the buffer, looking at no more than
+     *   'bytecnt' bytes.  This scans a machine word at a time.  
+     */
+    static size_t s_ascii_len(const char *p, size_t bytecnt);
+
+    /* determine if a buffer consists entirely of plain ASCII characters */
+    static int s_is_ascii(const char *p, size_t bytecnt)
+        { return s_ascii_len(p, bytecnt) == bytecnt; }
+
     /* 
      *   get the number of bytes required to encode a given wchar_t in
      *   UTF-8 format 
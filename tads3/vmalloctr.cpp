@@ -0,0 +1,453 @@
+/*
+ *   Please see the accompanying license file, LICENSE.TXT, for information
+ *   on using and copying this software.
+ */
+/*
+Name
+  vmalloctr.cpp - T3 VM allocation tracing
+Function
+  See vmalloctr.h.
+Notes
+
+Modified
+  10/15/26  - Creation
+*/
+
+#include "vmalloctr.h"
+
+#ifdef VM_ALLOC_TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "t3std.h"
+#include "os.h"
+#include "vmtype.h"
+#include "vmglob.h"
+#include "vmobj.h"
+#include "vmrun.h"
+#include "vmfunc.h"
+#include "vmhash.h"
+#include "vmimage.h"
+#include "vmrunsym.h"
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Limits
+ */
+
+/* number of records in the sample ring buffer */
+const size_t VMALLOCTR_RING_RECS = 16384;
+
+/* number of allocation sites we list in the report */
+const size_t VMALLOCTR_TOP_SITES = 50;
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Sample record 
+ */
+struct vmalloctr_rec
+{
+    /* entry pointer of the executing function, and the offset of the pc */
+    const uchar *ep;
+    ulong ofs;
+
+    /* defining object and target property, for a method */
+    vm_obj_id_t defobj;
+    vm_prop_id_t prop;
+
+    /* the invokee, for a function */
+    vm_val_t invokee;
+
+    /* 
+     *   metaclass of the allocating object; null for an object allocation
+     *   whose metaclass we haven't learned yet 
+     */
+    class CVmMetaclass *meta;
+
+    /* for an object allocation, the new object; otherwise invalid */
+    vm_obj_id_t obj;
+
+    /* bytes allocated (zero for an object allocation) */
+    ulong bytes;
+};
+
+/*
+ *   Allocation site table entry.  The key is the binary frame identity
+ *   plus the metaclass.  
+ */
+class CVmHashEntryAllocSite: public CVmHashEntryCS
+{
+public:
+    CVmHashEntryAllocSite(const char *key, size_t len,
+                          const vmalloctr_rec *rec)
+        : CVmHashEntryCS(key, len, TRUE)
+    {
+        rec_ = *rec;
+        objs_ = 0;
+        bytes_ = 0;
+    }
+
+    /* a sample record for the site, for naming it */
+    vmalloctr_rec rec_;
+
+    /* sampled object count and bytes */
+    ulong objs_;
+    ulong bytes_;
+};
+
+/*
+ *   Tracing state.  The heap doesn't have access to the VM globals, so we
+ *   keep our own pointer to them.  
+ */
+static struct
+{
+    /* flag: tracing is on */
+    int active;
+
+    /* globals of the VM we're tracing */
+    vm_globals *vmg;
+
+    /* report file name */
+    char *fname;
+
+    /* sampling rate, and countdown to the next sample */
+    ulong rate;
+    ulong countdown;
+
+    /* totals for all allocations, sampled or not */
+    ulong obj_cnt;
+    ulong mem_cnt;
+    ulong mem_bytes;
+
+    /* sample ring buffer, and the number of records in it */
+    vmalloctr_rec *ring;
+    size_t used;
+
+    /* ring index of an object record waiting for its metaclass, or -1 */
+    long pending;
+
+    /* allocation site table, and the number of sites in it */
+    CVmHashTable *sites;
+    size_t site_cnt;
+} S;
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Start tracing 
+ */
+void vm_alloc_trace_start_from_env(VMG0_)
+{
+    const char *fname = getenv("T3_ALLOC_TRACE");
+
+    /* if there's no file, or we're already running, ignore it */
+    if (fname == 0 || fname[0] == '\0' || S.active)
+        return;
+
+    /* get the sampling rate */
+    const char *rate = getenv("T3_ALLOC_TRACE_RATE");
+    S.rate = (rate != 0 ? strtoul(rate, 0, 10) : 0);
+    if (S.rate == 0)
+        S.rate = 1;
+
+    /* set up the state */
+    S.vmg = VMGLOB_ADDR;
+    S.fname = lib_copy_str(fname);
+    S.countdown = S.rate;
+    S.obj_cnt = S.mem_cnt = S.mem_bytes = 0;
+    S.ring = (vmalloctr_rec *)t3malloc(
+        VMALLOCTR_RING_RECS * sizeof(vmalloctr_rec));
+    S.used = 0;
+    S.pending = -1;
+    S.sites = new CVmHashTable(1024, new CVmHashFuncCS(), TRUE);
+    S.site_cnt = 0;
+    S.active = TRUE;
+}
+
+/*
+ *   Fold the ring buffer into the site table 
+ */
+static void fold_ring()
+{
+    char key[sizeof(const uchar *) + sizeof(ulong) + sizeof(CVmMetaclass *)];
+    size_t i;
+
+    /* 
+     *   the pending object record (if any) is about to leave the ring, so
+     *   it's too late to learn its metaclass 
+     */
+    S.pending = -1;
+
+    for (i = 0 ; i < S.used ; ++i)
+    {
+        const vmalloctr_rec *rec = &S.ring[i];
+
+        /* build the key */
+        memcpy(key, &rec->ep, sizeof(rec->ep));
+        memcpy(key + sizeof(rec->ep), &rec->ofs, sizeof(rec->ofs));
+        memcpy(key + sizeof(rec->ep) + sizeof(rec->ofs),
+               &rec->meta, sizeof(rec->meta));
+
+        /* find or add the site */
+        CVmHashEntryAllocSite *site =
+            (CVmHashEntryAllocSite *)S.sites->find(key, sizeof(key));
+        if (site == 0)
+        {
+            site = new CVmHashEntryAllocSite(key, sizeof(key), rec);
+            S.sites->add(site);
+            ++S.site_cnt;
+        }
+
+        /* count it */
+        if (rec->obj != VM_INVALID_OBJ)
+            ++site->objs_;
+        site->bytes_ += rec->bytes;
+    }
+
+    /* the ring is empty again */
+    S.used = 0;
+}
+
+/*
+ *   Record a sample.  Returns the record, with the frame information and
+ *   size filled in, for the caller to fill in the rest.  
+ */
+static vmalloctr_rec *record(ulong bytes)
+{
+    VMGLOB_PTR(S.vmg);
+
+    /* make room if necessary */
+    if (S.used == VMALLOCTR_RING_RECS)
+        fold_ring();
+
+    /* set up the record */
+    vmalloctr_rec *rec = &S.ring[S.used++];
+    rec->bytes = bytes;
+    rec->meta = 0;
+    rec->obj = VM_INVALID_OBJ;
+
+    /* note where the byte code is, if it's running */
+    const uchar *pc = G_interpreter->get_last_pc();
+    vm_val_t *fp = G_interpreter->get_frame_ptr();
+    const uchar *ep = G_interpreter->get_entry_ptr();
+    if (pc != 0 && fp != 0 && ep != 0)
+    {
+        rec->ep = ep;
+        rec->ofs = (ulong)(pc - ep);
+        rec->defobj = G_interpreter->get_defining_obj_from_frame(vmg_ fp);
+        rec->prop = G_interpreter->get_target_prop_from_frame(vmg_ fp);
+        rec->invokee = *G_interpreter->get_invokee_from_frame(vmg_ fp);
+    }
+    else
+    {
+        /* no byte code is running - it's the VM itself (loading, etc) */
+        rec->ep = 0;
+        rec->ofs = 0;
+        rec->defobj = VM_INVALID_OBJ;
+        rec->prop = VM_INVALID_PROP;
+        rec->invokee.set_nil();
+    }
+
+    /* return the record */
+    return rec;
+}
+
+/*
+ *   Count an allocation, and decide whether to sample it 
+ */
+static int take_sample()
+{
+    if (--S.countdown != 0)
+        return FALSE;
+
+    S.countdown = S.rate;
+    return TRUE;
+}
+
+/*
+ *   Note an object ID allocation 
+ */
+void vm_alloc_trace_obj(vm_obj_id_t id)
+{
+    /* if we're not tracing, ignore it */
+    if (!S.active)
+        return;
+
+    /* 
+     *   if the previous object hasn't allocated any memory yet, we won't
+     *   learn its metaclass 
+     */
+    S.pending = -1;
+
+    /* count it */
+    ++S.obj_cnt;
+    if (!take_sample())
+        return;
+
+    /* record it; we'll learn the metaclass later */
+    vmalloctr_rec *rec = record(0);
+    rec->obj = id;
+    S.pending = (long)(rec - S.ring);
+}
+
+/*
+ *   Note a variable-heap allocation 
+ */
+void vm_alloc_trace_mem(size_t siz, const CVmObject *obj)
+{
+    /* if we're not tracing, ignore it */
+    if (!S.active)
+        return;
+
+    /* get the object's metaclass */
+    CVmMetaclass *meta = (obj != 0 ? obj->get_metaclass_reg() : 0);
+
+    /* if this is the pending object's memory, we know its metaclass now */
+    if (S.pending >= 0)
+    {
+        VMGLOB_PTR(S.vmg);
+        vmalloctr_rec *prec = &S.ring[S.pending];
+        if (obj != 0 && vm_objp(vmg_ prec->obj) == obj)
+        {
+            prec->meta = meta;
+            S.pending = -1;
+        }
+    }
+
+    /* count it */
+    ++S.mem_cnt;
+    S.mem_bytes += siz;
+    if (!take_sample())
+        return;
+
+    /* record it */
+    vmalloctr_rec *rec = record(siz);
+    rec->meta = meta;
+}
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Report generation 
+ */
+
+/* enumeration callback - collect the sites into an array */
+struct vmalloctr_collect_ctx
+{
+    CVmHashEntryAllocSite **arr;
+    size_t cnt;
+};
+static void collect_cb(void *ctx0, CVmHashEntry *entry)
+{
+    vmalloctr_collect_ctx *ctx = (vmalloctr_collect_ctx *)ctx0;
+    ctx->arr[ctx->cnt++] = (CVmHashEntryAllocSite *)entry;
+}
+
+/* sort comparison - most bytes first, then most objects */
+static int cmp_sites(const void *a0, const void *b0)
+{
+    const CVmHashEntryAllocSite *a = *(const CVmHashEntryAllocSite **)a0;
+    const CVmHashEntryAllocSite *b = *(const CVmHashEntryAllocSite **)b0;
+
+    if (a->bytes_ != b->bytes_)
+        return (a->bytes_ > b->bytes_ ? -1 : 1);
+    if (a->objs_ != b->objs_)
+        return (a->objs_ > b->objs_ ? -1 : 1);
+    return 0;
+}
+
+/*
+ *   Get the display name of a site's code location 
+ */
+static void site_name(VMG_ char *buf, size_t buflen,
+                      const vmalloctr_rec *rec)
+{
+    /* name the function or method */
+    vm_code_name(vmg_ G_image_loader != 0
+                      ? G_image_loader->get_runtime_symtab() : 0,
+                 buf, buflen, rec->ep, rec->defobj, rec->prop,
+                 &rec->invokee);
+    if (rec->ep == 0)
+        return;
+
+    /* add the source line, if we have debug records for it */
+    CVmFuncPtr func(rec->ep);
+    CVmDbgLinePtr line;
+    const uchar *stm_start, *stm_end;
+    size_t used = strlen(buf);
+    if (CVmRun::get_stm_bounds(vmg_ &func, rec->ofs, &line,
+                               &stm_start, &stm_end))
+        t3sprintf(buf + used, buflen - used, ":%lu",
+                  line.get_source_line());
+    else
+        t3sprintf(buf + used, buflen - used, "+%lu", rec->ofs);
+}
+
+/*
+ *   Stop tracing and write the report 
+ */
+void vm_alloc_trace_stop(VMG0_)
+{
+    /* if we never started, there's nothing to do */
+    if (!S.active)
+        return;
+
+    /* stop tracing, and fold in the last samples */
+    S.active = FALSE;
+    fold_ring();
+
+    /* sort the sites */
+    vmalloctr_collect_ctx ctx;
+    ctx.arr = (CVmHashEntryAllocSite **)t3malloc(
+        (S.site_cnt + 1) * sizeof(ctx.arr[0]));
+    ctx.cnt = 0;
+    S.sites->enum_entries(&collect_cb, &ctx);
+    qsort(ctx.arr, ctx.cnt, sizeof(ctx.arr[0]), &cmp_sites);
+
+    /* write the report */
+    osfildef *fp = osfopwt(S.fname, OSFTTEXT);
+    if (fp != 0)
+    {
+        char buf[512];
+        size_t i;
+
+        sprintf(buf, "objects allocated: %lu\n"
+                "heap allocations: %lu (%lu bytes)\n"
+                "sampling rate: 1 in %lu (counts below are scaled)\n\n",
+                S.obj_cnt, S.mem_cnt, S.mem_bytes, S.rate);
+        os_fprintz(fp, buf);
+        sprintf(buf, "%10s %12s  %-24s %s\n",
+                "objects", "bytes", "metaclass", "site");
+        os_fprintz(fp, buf);
+
+        for (i = 0 ; i < ctx.cnt && i < VMALLOCTR_TOP_SITES ; ++i)
+        {
+            CVmHashEntryAllocSite *site = ctx.arr[i];
+            char name[300];
+
+            site_name(vmg_ name, sizeof(name), &site->rec_);
+            t3sprintf(buf, sizeof(buf), "%10lu %12lu  %-24s %s\n",
+                      site->objs_ * S.rate, site->bytes_ * S.rate,
+                      site->rec_.meta != 0
+                      ? site->rec_.meta->get_meta_name() : "<unknown>",
+                      name);
+            os_fprintz(fp, buf);
+        }
+        osfcls(fp);
+    }
+
+    /* clean up */
+    t3free(ctx.arr);
+    delete S.sites;
+    S.sites = 0;
+    t3free(S.ring);
+    S.ring = 0;
+    lib_free_str(S.fname);
+    S.fname = 0;
+}
+
+#endif /* VM_ALLOC_TRACE */
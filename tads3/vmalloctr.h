@@ -0,0 +1,70 @@
+/*
+ *   Please see the accompanying license file, LICENSE.TXT, for information
+ *   on using and copying this software.
+ */
+/*
+Name
+  vmalloctr.h - T3 VM allocation tracing
+Function
+  Finds the byte code that creates the most garbage.  When tracing is on,
+  every object allocation (CVmObjTable::alloc_obj()) and every allocation
+  or reallocation of object memory in the variable-size heap (alloc_mem()
+  and realloc_mem()) is counted, and every Nth one is sampled: we record
+  the metaclass, the size, and the byte code location that was executing
+  (the function or method and the offset of the current instruction).  For
+  an allocation made by native code, such as an intrinsic class method,
+  that's the byte code that called the native code.
+
+  Samples go into a ring buffer, which is folded into a table of
+  allocation sites whenever it fills up, so that the allocation path only
+  has to store a record.  When tracing stops, we write a report listing
+  the top allocation sites by bytes, with their object counts, metaclasses
+  and source lines (if the image has debug records).
+Notes
+  Tracing is compiled in only if VM_ALLOC_TRACE is defined (see the
+  t3_alloc_trace option in qtads.pro).  Even then, it's off unless the
+  environment variable T3_ALLOC_TRACE gives a report file name.  The
+  optional variable T3_ALLOC_TRACE_RATE sets the sampling rate N (the
+  default is 1, which records every allocation).  Counts in the report are
+  scaled up by N.
+
+  The metaclass isn't known yet when an object ID is allocated, since the
+  object's constructor hasn't run.  We fill it in from the object's first
+  memory allocation, if it makes one before the next object is allocated.
+  (We can't ask the object itself, since we can't tell whether its
+  constructor has started.)  Objects that never allocate memory show up
+  with an unknown metaclass.
+Modified
+  10/15/26  - Creation
+*/
+
+#ifndef VMALLOCTR_H
+#define VMALLOCTR_H
+
+#include "vmglob.h"
+#include "vmtype.h"
+
+#ifdef VM_ALLOC_TRACE
+
+/* include allocation tracing code */
+#define VM_IF_ALLOC_TRACE(x)  x
+
+/* start tracing if requested through the environment */
+void vm_alloc_trace_start_from_env(VMG0_);
+
+/* note an object ID allocation */
+void vm_alloc_trace_obj(vm_obj_id_t id);
+
+/* note a variable-heap allocation of 'siz' bytes on behalf of 'obj' */
+void vm_alloc_trace_mem(size_t siz, const class CVmObject *obj);
+
+/* stop tracing and write the report */
+void vm_alloc_trace_stop(VMG0_);
+
+#else /* VM_ALLOC_TRACE */
+
+#define VM_IF_ALLOC_TRACE(x)
+
+#endif /* VM_ALLOC_TRACE */
+
+#endif /* VMALLOCTR_H */
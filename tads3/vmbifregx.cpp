@@ -58,13 +58,13 @@ vm_bif_entry_t G_bif_reg_table[] =
     MAKE_ENTRY("t3vm/010006", CVmBifT3),
 
     /* T3 VM Testing interface */
-    MAKE_ENTRY("t3vmTEST/010000", CVmBifT3Test),
+    MAKE_ENTRY("t3vmTEST/010005", CVmBifT3Test),
     
     /* TADS generic data manipulation functions */
-    MAKE_ENTRY("tads-gen/030008", CVmBifTADS),
+    MAKE_ENTRY("tads-gen/030010", CVmBifTADS),
 
     /* TADS input/output functions */
-    MAKE_ENTRY("tads-io/030007", CVmBifTIO),
+    MAKE_ENTRY("tads-io/030008", CVmBifTIO),
 
     /* TADS extended input/output functions (if the platform supports them) */
     MAKE_ENTRY("tads-io-ext/030000", CVmBifTIOExt),
@@ -46,6 +46,8 @@ Modified
 #include "vmimport.h"
 #include "vmmeta.h"
 #include "vmfref.h"
+#include "vmbignum.h"
+#include "vmgram.h"
 
 
 /*
@@ -198,12 +200,12 @@ void CVmBifT3::get_global_symtab(VMG_ uint argc)
     {
     case 1:
         /* return the loader's symbol table object, if any */
-        retval_obj(vmg_ G_image_loader->get_reflection_symtab());
+        retval_obj(vmg_ G_image_loader->get_reflection_symtab(vmg0_));
         break;
 
     case 2:
         /* return the macro table, if any */
-        retval_obj(vmg_ G_image_loader->get_reflection_macros());
+        retval_obj(vmg_ G_image_loader->get_reflection_macros(vmg0_));
         break;
 
     case 3:
@@ -1160,6 +1162,253 @@ void CVmBifT3Test::get_obj_gc_state(VMG_ uint argc)
                (long)G_obj_table->get_obj_internal_state(val.val.intval));
 }
 
+/*
+ *   Get the garbage collector statistics.  Takes no arguments, and returns
+ *   a list of integers:
+ *   
+ *.  [1] number of collection passes completed
+ *.  [2] total pause time in milliseconds
+ *.  [3] longest pause in milliseconds
+ *.  [4] total objects freed
+ *.  [5] total heap bytes freed
+ *.  [6] objects that survived the last pass
+ *.  [7] heap bytes in use after the last pass
+ *.  [8] heap high-water mark in bytes
+ *.  [9] objects awaiting finalization
+ *.  [10] undo log bytes in use
+ *.  [11] undo log memory budget in bytes
+ *.  [12] undo savepoints currently held
+ *   
+ *   Values too large for an integer are capped at the largest integer.  
+ */
+void CVmBifT3Test::get_gc_stats(VMG_ uint argc)
+{
+    vm_gc_stats stats;
+    ulong vals[12];
+    vm_val_t ele;
+    size_t i;
+
+    /* no arguments allowed */
+    check_argc(vmg_ argc, 0);
+
+    /* get the statistics */
+    G_obj_table->get_gc_stats(vmg_ &stats);
+    vals[0] = stats.passes;
+    vals[1] = stats.total_pause_ms;
+    vals[2] = stats.max_pause_ms;
+    vals[3] = stats.objs_freed;
+    vals[4] = stats.bytes_freed;
+    vals[5] = stats.live_objs;
+    vals[6] = stats.live_bytes;
+    vals[7] = stats.peak_bytes;
+    vals[8] = stats.finalize_queue_len;
+    vals[9] = stats.undo_bytes;
+    vals[10] = stats.undo_budget;
+    vals[11] = stats.undo_savepts;
+
+    /* 
+     *   build the list (it only contains integers, so we don't need to
+     *   protect it from gc while we fill it in) 
+     */
+    vm_obj_id_t id = CVmObjList::create(vmg_ FALSE, countof(vals));
+    CVmObjList *lst = (CVmObjList *)vm_objp(vmg_ id);
+    for (i = 0 ; i < countof(vals) ; ++i)
+    {
+        ele.set_int(vals[i] > 0x7fffffffUL ? 0x7fffffffL : (long)vals[i]);
+        lst->cons_set_element(i, &ele);
+    }
+
+    /* return the list */
+    retval_obj(vmg_ id);
+}
+
+/*
+ *   Get the BigNumber register cache statistics.  Takes no arguments, and
+ *   returns a list of integers:
+ *   
+ *.  [1] number of register allocations
+ *.  [2] allocations satisfied by a free register without allocating memory
+ *.  [3] allocations that had to allocate or grow a register's memory
+ *.  [4] allocations that failed because every register was in use
+ *.  [5] registers currently in use
+ *.  [6] high-water mark of registers in use
+ *.  [7] largest register requested, in bytes
+ *   
+ *   Values too large for an integer are capped at the largest integer.  
+ */
+void CVmBifT3Test::get_bignum_stats(VMG_ uint argc)
+{
+    const vmbn_cache_stats *stats;
+    ulong vals[7];
+    vm_val_t ele;
+    size_t i;
+
+    /* no arguments allowed */
+    check_argc(vmg_ argc, 0);
+
+    /* get the statistics */
+    stats = CVmObjBigNum::get_cache_stats();
+    vals[0] = stats->allocs;
+    vals[1] = stats->hits;
+    vals[2] = stats->grows;
+    vals[3] = stats->failures;
+    vals[4] = stats->in_use;
+    vals[5] = stats->peak_in_use;
+    vals[6] = stats->max_siz;
+
+    /* build the list (it only contains integers) */
+    vm_obj_id_t id = CVmObjList::create(vmg_ FALSE, countof(vals));
+    CVmObjList *lst = (CVmObjList *)vm_objp(vmg_ id);
+    for (i = 0 ; i < countof(vals) ; ++i)
+    {
+        ele.set_int(vals[i] > 0x7fffffffUL ? 0x7fffffffL : (long)vals[i]);
+        lst->cons_set_element(i, &ele);
+    }
+
+    /* return the list */
+    retval_obj(vmg_ id);
+}
+
+/*
+ *   Get the grammar sub-production memo statistics, accumulated over all
+ *   parseTokens calls so far.  Returns a list of integers:
+ *   
+ *.  [1] parseTokens calls
+ *.  [2] sub-production expansions (alternatives enqueued for a new
+ *.      production and token position)
+ *.  [3] sub-production requests satisfied from the memo table instead
+ *.  [4] memoized matches delivered to those requests
+ *   
+ *   Values too large for an integer are capped at the largest integer.  
+ */
+void CVmBifT3Test::get_gram_stats(VMG_ uint argc)
+{
+    const vmgram_memo_stats *stats;
+    ulong vals[4];
+    vm_val_t ele;
+    size_t i;
+
+    /* no arguments allowed */
+    check_argc(vmg_ argc, 0);
+
+    /* get the statistics */
+    stats = CVmObjGramProd::get_memo_stats();
+    vals[0] = stats->parses;
+    vals[1] = stats->expansions;
+    vals[2] = stats->hits;
+    vals[3] = stats->shared_results;
+
+    /* build the list (it only contains integers) */
+    vm_obj_id_t id = CVmObjList::create(vmg_ FALSE, countof(vals));
+    CVmObjList *lst = (CVmObjList *)vm_objp(vmg_ id);
+    for (i = 0 ; i < countof(vals) ; ++i)
+    {
+        ele.set_int(vals[i] > 0x7fffffffUL ? 0x7fffffffL : (long)vals[i]);
+        lst->cons_set_element(i, &ele);
+    }
+
+    /* return the list */
+    retval_obj(vmg_ id);
+}
+
+/*
+ *   Get the ofKind cache statistics 
+ */
+void CVmBifT3Test::get_kind_stats(VMG_ uint argc)
+{
+    const vm_tadsobj_kind_stats *stats;
+    ulong vals[2];
+    vm_val_t ele;
+    size_t i;
+
+    /* no arguments allowed */
+    check_argc(vmg_ argc, 0);
+
+    /* get the statistics */
+    stats = G_tadsobj_cache->get_kind_stats();
+    vals[0] = stats->hits;
+    vals[1] = stats->misses;
+
+    /* build the list (it only contains integers) */
+    vm_obj_id_t id = CVmObjList::create(vmg_ FALSE, countof(vals));
+    CVmObjList *lst = (CVmObjList *)vm_objp(vmg_ id);
+    for (i = 0 ; i < countof(vals) ; ++i)
+    {
+        ele.set_int(vals[i] > 0x7fffffffUL ? 0x7fffffffL : (long)vals[i]);
+        lst->cons_set_element(i, &ele);
+    }
+
+    /* return the list */
+    retval_obj(vmg_ id);
+}
+
+/*
+ *   Take a census of the heap.  Takes no arguments, and returns a list with
+ *   one element per metaclass that has any live objects.  Each element is
+ *   a list [name, count, bytes], where 'name' is the metaclass's full
+ *   identifier string (such as 'tads-object/030005'), 'count' is the number
+ *   of live objects, and 'bytes' is the memory they use.  Values too large
+ *   for an integer are capped at the largest integer.  
+ */
+void CVmBifT3Test::get_heap_census(VMG_ uint argc)
+{
+    vm_heap_census *arr;
+    size_t cnt, i;
+
+    /* no arguments allowed */
+    check_argc(vmg_ argc, 0);
+
+    /* take the census */
+    arr = G_obj_table->heap_census(vmg_ &cnt);
+
+    err_try
+    {
+        /* create the result list, and push it for gc protection */
+        vm_obj_id_t id = CVmObjList::create(vmg_ FALSE, cnt);
+        CVmObjList *lst = (CVmObjList *)vm_objp(vmg_ id);
+        lst->cons_clear();
+        G_stk->push()->set_obj(id);
+
+        /* build an element for each metaclass */
+        for (i = 0 ; i < cnt ; ++i)
+        {
+            vm_val_t ele;
+
+            /* create the sublist and store it in the result list */
+            vm_obj_id_t subid = CVmObjList::create(vmg_ FALSE, 3);
+            CVmObjList *sub = (CVmObjList *)vm_objp(vmg_ subid);
+            sub->cons_clear();
+            ele.set_obj(subid);
+            lst->cons_set_element(i, &ele);
+
+            /* fill in the counts */
+            ele.set_int(arr[i].objs > 0x7fffffffUL
+                        ? 0x7fffffffL : (long)arr[i].objs);
+            sub->cons_set_element(1, &ele);
+            ele.set_int(arr[i].bytes > 0x7fffffffUL
+                        ? 0x7fffffffL : (long)arr[i].bytes);
+            sub->cons_set_element(2, &ele);
+
+            /* add the metaclass name */
+            const char *name = arr[i].meta->get_meta_name();
+            ele.set_obj(CVmObjString::create(vmg_ FALSE, name, strlen(name)));
+            sub->cons_set_element(0, &ele);
+        }
+
+        /* return the list */
+        retval_obj(vmg_ id);
+
+        /* discard our gc protection */
+        G_stk->discard();
+    }
+    err_finally
+    {
+        /* done with the census */
+        t3free(arr);
+    }
+    err_end;
+}
+
 /*
  *   Get the Unicode character code of the first character of a string 
  */
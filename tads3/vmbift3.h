@@ -101,6 +101,21 @@ public:
 
     /* get the Unicode character code for the first character of a string */
     static void get_charcode(VMG_ uint argc);
+
+    /* get the garbage collector statistics */
+    static void get_gc_stats(VMG_ uint argc);
+
+    /* get the BigNumber register cache statistics */
+    static void get_bignum_stats(VMG_ uint argc);
+
+    /* get the grammar sub-production memo statistics */
+    static void get_gram_stats(VMG_ uint argc);
+
+    /* get the ofKind cache statistics */
+    static void get_kind_stats(VMG_ uint argc);
+
+    /* take a census of live objects and memory by metaclass */
+    static void get_heap_census(VMG_ uint argc);
 };
 
 
@@ -148,7 +163,12 @@ vm_bif_desc CVmBifT3Test::bif_table[] =
 {
     { &CVmBifT3Test::get_obj_id, 1, 0, FALSE },
     { &CVmBifT3Test::get_obj_gc_state, 1, 0, FALSE },
-    { &CVmBifT3Test::get_charcode, 1, 0, FALSE }
+    { &CVmBifT3Test::get_charcode, 1, 0, FALSE },
+    { &CVmBifT3Test::get_gc_stats, 0, 0, FALSE },
+    { &CVmBifT3Test::get_bignum_stats, 0, 0, FALSE },
+    { &CVmBifT3Test::get_gram_stats, 0, 0, FALSE },
+    { &CVmBifT3Test::get_kind_stats, 0, 0, FALSE },
+    { &CVmBifT3Test::get_heap_census, 0, 0, FALSE }
 };
 
 #endif /* VMBIF_DEFINE_VECTOR */
@@ -65,6 +65,10 @@ CVmBifTADSGlobals::CVmBifTADSGlobals(VMG0_)
     /* allocate our regular expression parser */
     rex_parser = new CRegexParser();
     rex_searcher = new CRegexSearcherSimple(rex_parser);
+    rex_cache = new CRegexCache(rex_parser, RE_CACHE_DEFAULT_SIZE);
+
+    /* create the sprintf format cache */
+    fmt_cache = new CVmFmtCache();
 
     /* 
      *   Allocate a global variable to hold the most recent regular
@@ -104,10 +108,14 @@ CVmBifTADSGlobals::CVmBifTADSGlobals(VMG0_)
  */
 CVmBifTADSGlobals::~CVmBifTADSGlobals()
 {
-    /* delete our regular expression searcher and parser */
+    /* delete our regular expression cache, searcher, and parser */
+    delete rex_cache;
     delete rex_searcher;
     delete rex_parser;
 
+    /* delete the sprintf format cache */
+    delete fmt_cache;
+
     /* 
      *   note that we leave our last_rex_str global variable undeleted here,
      *   as we don't have access to G_obj_table (as there's no VMG_ to a
@@ -260,68 +268,100 @@ void CVmBifTADS::enum_objects(VMG_ uint argc, vm_obj_id_t start_obj)
     retval_nil(vmg0_);
 
     /* 
-     *   starting with the given object, scan objects until we find one
-     *   that's valid and matches our superclass, if one was provided 
+     *   If the superclass is a TadsObject class, get the candidates from
+     *   its instance index rather than scanning the whole object table.
+     *   The index can include objects that have been deleted since it was
+     *   built, so we still apply the full test to each candidate. 
      */
-    for (obj = start_obj ; obj < G_obj_table->get_max_used_obj_id() ; ++obj)
+    if (sc != VM_INVALID_OBJ && CVmObjTads::is_tadsobj_obj(vmg_ sc))
     {
-        /* 
-         *   If it's valid, and it's not an intrinsic class modifier object,
-         *   consider it further.  Skip intrinsic class modifiers, since
-         *   they're not really separate objects; they're really part of the
-         *   intrinsic class they modify, and all of the properties and
-         *   methods of a modifier object are reachable through the base
-         *   intrinsic class.  
-         */
-        if (G_obj_table->is_obj_id_valid(obj)
-            && !CVmObjIntClsMod::is_intcls_mod_obj(vmg_ obj))
+        size_t cnt;
+        const vm_obj_id_t *ids = G_tadsobj_insts->get_list(vmg_ sc, &cnt);
+
+        /* find the first candidate at or after the starting object */
+        size_t lo = 0, hi = cnt;
+        while (lo < hi)
         {
-            /* 
-             *   if it's a class, skip it if the flags indicate classes are
-             *   not wanted; if it's an instance, skip it if the flags
-             *   indicate that instances are not wanted 
-             */
-            if (vm_objp(vmg_ obj)->is_class_object(vmg_ obj))
-            {
-                /* it's a class - skip it if classes are not wanted */
-                if ((flags & VMBIFTADS_ENUM_CLASSES) == 0)
-                    continue;
-            }
+            size_t mid = (lo + hi) / 2;
+            if (ids[mid] < start_obj)
+                lo = mid + 1;
             else
-            {
-                /* it's an instance - skip it if instances are not wanted */
-                if ((flags & VMBIFTADS_ENUM_INSTANCES) == 0)
-                    continue;
-            }
+                hi = mid;
+        }
 
-            /* 
-             *   if a superclass was specified, and it matches, we have a
-             *   winner 
-             */
-            if (sc != VM_INVALID_OBJ)
-            {
-                /* if the object matches, return it */
-                if (vm_objp(vmg_ obj)->is_instance_of(vmg_ sc))
-                {
-                    retval_obj(vmg_ obj);
-                    break;
-                }
-            }
-            else
+        /* return the first one that passes the test */
+        for ( ; lo < cnt ; ++lo)
+        {
+            if (enum_objects_match(vmg_ ids[lo], sc, flags))
             {
-                /* 
-                 *   We're enumerating all objects - but skip List and String
-                 *   object, as we expose these as special types.  
-                 */
-                if (vm_objp(vmg_ obj)->get_as_list() == 0
-                    && vm_objp(vmg_ obj)->get_as_string(vmg0_) == 0)
-                {
-                    retval_obj(vmg_ obj);
-                    break;
-                }
+                retval_obj(vmg_ ids[lo]);
+                break;
             }
         }
+
+        /* done */
+        return;
+    }
+
+    /* 
+     *   starting with the given object, scan objects until we find one
+     *   that's valid and matches our superclass, if one was provided 
+     */
+    for (obj = start_obj ; obj < G_obj_table->get_max_used_obj_id() ; ++obj)
+    {
+        if (enum_objects_match(vmg_ obj, sc, flags))
+        {
+            retval_obj(vmg_ obj);
+            break;
+        }
+    }
+}
+
+/*
+ *   Test an object for firstobj/nextobj iteration 
+ */
+int CVmBifTADS::enum_objects_match(VMG_ vm_obj_id_t obj, vm_obj_id_t sc,
+                                   unsigned long flags)
+{
+    /* 
+     *   If it's invalid, or it's an intrinsic class modifier object, skip
+     *   it.  Skip intrinsic class modifiers, since they're not really
+     *   separate objects; they're really part of the intrinsic class they
+     *   modify, and all of the properties and methods of a modifier object
+     *   are reachable through the base intrinsic class.  
+     */
+    if (!G_obj_table->is_obj_id_valid(obj)
+        || CVmObjIntClsMod::is_intcls_mod_obj(vmg_ obj))
+        return FALSE;
+
+    /* 
+     *   if it's a class, skip it if the flags indicate classes are not
+     *   wanted; if it's an instance, skip it if the flags indicate that
+     *   instances are not wanted 
+     */
+    if (vm_objp(vmg_ obj)->is_class_object(vmg_ obj))
+    {
+        /* it's a class - skip it if classes are not wanted */
+        if ((flags & VMBIFTADS_ENUM_CLASSES) == 0)
+            return FALSE;
     }
+    else
+    {
+        /* it's an instance - skip it if instances are not wanted */
+        if ((flags & VMBIFTADS_ENUM_INSTANCES) == 0)
+            return FALSE;
+    }
+
+    /* if a superclass was specified, the object matches if it inherits */
+    if (sc != VM_INVALID_OBJ)
+        return vm_objp(vmg_ obj)->is_instance_of(vmg_ sc);
+
+    /* 
+     *   We're enumerating all objects - but skip List and String object, as
+     *   we expose these as special types.  
+     */
+    return (vm_objp(vmg_ obj)->get_as_list() == 0
+            && vm_objp(vmg_ obj)->get_as_string(vmg0_) == 0);
 }
 
 /* ------------------------------------------------------------------------ */
@@ -336,6 +376,18 @@ public:
     /* get the next random number */
     virtual uint32_t rand() = 0;
 
+    /* 
+     *   Fill a buffer with the next 'n' random numbers.  This must produce
+     *   exactly the same sequence as 'n' calls to rand(); generators that
+     *   work in blocks internally can override it to copy straight out of
+     *   their block buffer.  
+     */
+    virtual void rand_block(uint32_t *buf, size_t n)
+    {
+        for ( ; n != 0 ; --n)
+            *buf++ = rand();
+    }
+
     /* seed the generator from random data */
     virtual void seed_random() = 0;
 
@@ -457,6 +509,34 @@ public:
 
     virtual uint32_t rand() { return isaac_rand(ctx); }
 
+    /* 
+     *   Copy a block of values out of the result array.  isaac_rand() hands
+     *   out rsl[] from the top down, regenerating the whole group when it
+     *   runs dry, so we do the same a run at a time.  
+     */
+    virtual void rand_block(uint32_t *buf, size_t n)
+    {
+        while (n != 0)
+        {
+            /* if the current group is used up, generate the next one */
+            if (ctx->cnt == 0)
+            {
+                isaac_gen_group(ctx);
+                ctx->cnt = ISAAC_RANDSIZ;
+            }
+
+            /* take as much of this group as we need */
+            size_t run = (n < ctx->cnt ? n : ctx->cnt);
+            const uint32_t *src = &ctx->rsl[ctx->cnt];
+            for (size_t i = run ; i != 0 ; --i)
+                *buf++ = *--src;
+
+            /* consume the values we used */
+            ctx->cnt -= (uint32_t)run;
+            n -= run;
+        }
+    }
+
     /* seed from random data */
     virtual void seed_random()
     {
@@ -832,6 +912,15 @@ static uint32_t rng_next(VMG0_)
     return sel.get(G_bif_tads_globals->rng_id)->rand();
 }
 
+/*
+ *   Get the next 'n' random numbers from the selected RNG 
+ */
+static void rng_block(VMG_ uint32_t *buf, size_t n)
+{
+    CVmRNGSelector sel Pvmg0_P;
+    sel.get(G_bif_tads_globals->rng_id)->rand_block(buf, n);
+}
+
 
 /* ------------------------------------------------------------------------ */
 /*
@@ -2003,6 +2092,100 @@ void CVmBifTADS::rand(VMG_ uint argc)
     }
 }
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   randList - generate a batch of random numbers in one call.
+ *   
+ *.    randList(n) - list of n random integers over the full range
+ *.    randList(n, range) - list of n random integers 0..range-1
+ *.    randList(n, range, true) - the same, as a ByteArray (range <= 256)
+ *   
+ *   This draws the same sequence as n successive calls to rand(range), but
+ *   pulls the numbers from the generator a block at a time and builds the
+ *   result directly, instead of going through the interpreter per value.
+ *   A nil range means the full range, as for rand().  
+ */
+void CVmBifTADS::randList(VMG_ uint argc)
+{
+    /* check arguments */
+    check_argc_range(vmg_ argc, 1, 3);
+
+    /* get the count */
+    long cnt = pop_long_val(vmg0_);
+    if (cnt < 0)
+        err_throw(VMERR_BAD_VAL_BIF);
+
+    /* get the range, if present; zero means the full range */
+    ulong range = 0;
+    if (argc >= 2)
+    {
+        if (G_stk->get(0)->typ == VM_NIL)
+            G_stk->discard();
+        else
+        {
+            long r = pop_long_val(vmg0_);
+            if (r <= 0)
+                err_throw(VMERR_BAD_VAL_BIF);
+            range = (ulong)r;
+        }
+    }
+
+    /* check for the ByteArray flag */
+    int as_bytes = (argc >= 3 ? pop_bool_val(vmg0_) : FALSE);
+
+    /* a ByteArray can only hold byte values */
+    if (as_bytes && (range == 0 || range > 256))
+        err_throw(VMERR_BAD_VAL_BIF);
+
+    /* create the result object */
+    vm_obj_id_t id = (as_bytes
+                      ? CVmObjByteArray::create(vmg_ FALSE, cnt)
+                      : CVmObjList::create(vmg_ FALSE, cnt));
+    CVmObject *obj = vm_objp(vmg_ id);
+
+    /* generate the values a block at a time */
+    uint32_t buf[ISAAC_RANDSIZ];
+    for (long idx = 0 ; idx < cnt ; )
+    {
+        /* fill the next block */
+        size_t n = (size_t)(cnt - idx < (long)countof(buf)
+                            ? cnt - idx : countof(buf));
+        rng_block(vmg_ buf, n);
+
+        /* scale each value to the range */
+        if (range != 0)
+        {
+            for (size_t i = 0 ; i < n ; ++i)
+                buf[i] = (uint32_t)rand_range(buf[i], range);
+        }
+
+        /* store the block */
+        if (as_bytes)
+        {
+            unsigned char bytes[countof(buf)];
+            for (size_t i = 0 ; i < n ; ++i)
+                bytes[i] = (unsigned char)buf[i];
+            ((CVmObjByteArray *)obj)->cons_copy_from_buf(bytes, idx + 1, n);
+        }
+        else
+        {
+            CVmObjList *lst = (CVmObjList *)obj;
+            for (size_t i = 0 ; i < n ; ++i)
+            {
+                vm_val_t val;
+                val.set_int((long)buf[i]);
+                lst->cons_set_element(idx + i, &val);
+            }
+        }
+
+        /* advance past the block */
+        idx += (long)n;
+    }
+
+    /* return the result */
+    retval_obj(vmg_ id);
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   toString - convert to string 
@@ -2433,6 +2616,7 @@ void CVmBifTADS::re_match(VMG_ uint argc)
     int start_idx;
     CVmObjPattern *pat_obj = 0;
     const char *pat_str = 0;
+    re_compiled_pattern *cpat;
     
     /* check arguments */
     check_argc_range(vmg_ argc, 2, 3);
@@ -2506,6 +2690,13 @@ void CVmBifTADS::re_match(VMG_ uint argc)
                     match_pattern(pat_obj->get_pattern(vmg0_),
                                   str + VMB_LEN, p.getptr(), len);
     }
+    else if ((cpat = G_bif_tads_globals->rex_cache->get(
+        pat_str + VMB_LEN, vmb_get_len(pat_str))) != 0)
+    {
+        /* match the cached compiled version of the expression string */
+        match_len = G_bif_tads_globals->rex_searcher->
+                    match_pattern(cpat, str + VMB_LEN, p.getptr(), len);
+    }
     else
     {
         /* match the pattern to the regular expression string */
@@ -2531,6 +2722,152 @@ void CVmBifTADS::re_match(VMG_ uint argc)
 }
 
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Match one pattern for re_match_first().  'patval' is a RexPattern
+ *   object or a regular expression string.  Returns the byte length of the
+ *   match, or -1 if there's no match.  
+ */
+static int re_match_first_one(VMG_ const vm_val_t *patval,
+                              const char *entire_str,
+                              const char *str, size_t len)
+{
+    CRegexSearcherSimple *searcher = G_bif_tads_globals->rex_searcher;
+    const char *pat_str;
+    re_compiled_pattern *cpat;
+
+    /* match a compiled pattern object directly */
+    if (patval->typ == VM_OBJ
+        && CVmObjPattern::is_pattern_obj(vmg_ patval->val.obj))
+    {
+        CVmObjPattern *pat_obj = (CVmObjPattern *)vm_objp(vmg_ patval->val.obj);
+        return searcher->match_pattern(pat_obj->get_pattern(vmg0_),
+                                       entire_str, str, len);
+    }
+
+    /* otherwise it has to be a string */
+    if ((pat_str = patval->get_as_string(vmg0_)) == 0)
+        err_throw(VMERR_BAD_TYPE_BIF);
+
+    /* use the cached compiled version if possible */
+    if ((cpat = G_bif_tads_globals->rex_cache->get(
+        pat_str + VMB_LEN, vmb_get_len(pat_str))) != 0)
+        return searcher->match_pattern(cpat, entire_str, str, len);
+
+    /* compile and match */
+    return searcher->compile_and_match(pat_str + VMB_LEN,
+                                       vmb_get_len(pat_str),
+                                       entire_str, str, len);
+}
+
+/*
+ *   re_match_first - match a list of regular expressions to a string, and
+ *   return the index of the first pattern that matches.  This is for
+ *   tokenizers and the like, which try a list of rules in order at each
+ *   position: one call here replaces a rexMatch() call per rule, and the
+ *   patterns that can't match quickly fail on their literal prefix or
+ *   their DFA's cached first transition without entering the full matcher.
+ *   
+ *   rexMatchFirst(patterns, str, index?, longest?)
+ *   
+ *   'patterns' is a list of RexPattern objects and/or regular expression
+ *   strings.  If 'longest' is true, we return the pattern with the longest
+ *   match instead, taking the earliest pattern in case of a tie.  Returns
+ *   the 1-based index in the list of the winning pattern, or nil if none
+ *   matches.  The group registers and rexGroup(0) describe the winning
+ *   pattern's match.  
+ */
+void CVmBifTADS::re_match_first(VMG_ uint argc)
+{
+    /* check arguments */
+    check_argc_range(vmg_ argc, 2, 4);
+
+    /* leave the arguments on the stack for gc protection */
+    const vm_val_t *pats = G_stk->get(0);
+    const vm_val_t *strval = G_stk->get(1);
+
+    /* make sure the pattern argument is a list */
+    if (!pats->is_listlike(vmg0_))
+        err_throw(VMERR_BAD_TYPE_BIF);
+
+    /* note the starting index, if given */
+    int start_idx = 1;
+    if (argc >= 3 && G_stk->get(2)->typ != VM_NIL)
+    {
+        if (G_stk->get(2)->typ != VM_INT)
+            err_throw(VMERR_BAD_TYPE_BIF);
+        start_idx = (int)G_stk->get(2)->val.intval;
+    }
+
+    /* note the match mode */
+    int longest = (argc >= 4 && G_stk->get(3)->get_logical_only());
+
+    /* get the string to match */
+    const char *str = strval->get_as_string(vmg0_);
+    if (str == 0)
+        err_throw(VMERR_BAD_TYPE_BIF);
+    size_t len = vmb_get_len(str);
+    utf8_ptr p((char *)str + VMB_LEN);
+
+    /* if the starting index is negative, it's from the end of the string */
+    start_idx += (start_idx < 0 ? (int)p.len(len) : -1);
+
+    /* skip to the starting index */
+    for ( ; start_idx > 0 && len != 0 ; --start_idx, p.inc(&len)) ;
+
+    /*
+     *   remember the search string, for rexGroup(), and reset any old group
+     *   registers 
+     */
+    G_bif_tads_globals->last_rex_str->val = *strval;
+    G_bif_tads_globals->rex_searcher->clear_group_regs();
+
+    /* try each pattern in turn */
+    int cnt = pats->ll_length(vmg0_);
+    int best_idx = 0, best_len = -1, last_idx = 0;
+    for (int i = 1 ; i <= cnt ; ++i)
+    {
+        vm_val_t ele;
+        pats->ll_index(vmg_ &ele, i);
+        int m = re_match_first_one(vmg_ &ele, str + VMB_LEN,
+                                   p.getptr(), len);
+        if (m >= 0)
+        {
+            /* note the match, and whether it's the best so far */
+            last_idx = i;
+            if (m > best_len)
+            {
+                best_idx = i;
+                best_len = m;
+            }
+
+            /* in first-match mode, this is the answer */
+            if (!longest)
+                break;
+        }
+    }
+
+    /*
+     *   If the last pattern we matched isn't the winner, match the winner
+     *   again, so that the group registers describe its match.  
+     */
+    if (best_idx != 0 && last_idx != best_idx)
+    {
+        vm_val_t ele;
+        pats->ll_index(vmg_ &ele, best_idx);
+        re_match_first_one(vmg_ &ele, str + VMB_LEN, p.getptr(), len);
+    }
+
+    /* return the winning index, or nil if nothing matched */
+    if (best_idx != 0)
+        retval_int(vmg_ best_idx);
+    else
+        retval_nil(vmg0_);
+
+    /* discard the arguments */
+    G_stk->discard(argc);
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Common handler for re_search() and re_search_back()
@@ -2604,6 +2941,7 @@ template<int dir> inline void CVmBifTADS::re_search_common(VMG_ uint argc)
     /* search for the pattern */
     int match_idx;
     int match_len;
+    re_compiled_pattern *cpat;
     if (pat_obj != 0)
     {
         /* try finding the compiled pattern */
@@ -2616,6 +2954,17 @@ template<int dir> inline void CVmBifTADS::re_search_common(VMG_ uint argc)
                  pat_obj->get_pattern(vmg0_),
                  str + VMB_LEN, p.getptr(), len, &match_len));
     }
+    else if ((cpat = G_bif_tads_globals->rex_cache->get(
+        pat_str + VMB_LEN, vmb_get_len(pat_str))) != 0)
+    {
+        /* try finding the cached compiled version of the expression */
+        match_idx =
+            (dir > 0
+             ? G_bif_tads_globals->rex_searcher->search_for_pattern(
+                 cpat, str + VMB_LEN, p.getptr(), len, &match_len)
+             : G_bif_tads_globals->rex_searcher->search_back_for_pattern(
+                 cpat, str + VMB_LEN, p.getptr(), len, &match_len));
+    }
     else
     {
         /* try finding the regular expression string pattern */
@@ -3875,6 +4224,34 @@ struct bpwriter
             putwch(opts.pad, padcnt);
     }
 
+    /* 
+     *   Format a 32-bit integer in decimal, given its magnitude and sign.
+     *   This is the fast path for %d and %u with no options beyond width,
+     *   alignment and padding, which produce the same result as
+     *   format_int() in that case.  
+     */
+    void format_dec(VMG_ uint32_t u, int neg, const fmtopts &opts)
+    {
+        char buf[16];
+        char *p = buf + sizeof(buf);
+
+        /* generate the digits in reverse order, then the sign */
+        do
+        {
+            *--p = (char)('0' + u % 10);
+            u /= 10;
+        } while (u != 0);
+        if (neg)
+            *--p = '-';
+
+        /* write it out, padding it if there's a width */
+        size_t len = buf + sizeof(buf) - p;
+        if (opts.width < 0)
+            puts(p, len);
+        else
+            format_with_padding(vmg_ p, len, len, opts);
+    }
+
     /* format a Roman numeral */
     void format_roman(VMG_ const vm_val_t *val, const fmtopts &opts, int flags)
     {
@@ -4065,156 +4442,444 @@ struct bpwriter
 };
 
 
+/* ------------------------------------------------------------------------ */
 /*
- *   Internal sprintf formatter.  The arguments are on the stack in the usual
- *   function call order, with the first argument at top of stack.  We'll
- *   allocate a new String object to hold the result.  
+ *   Compiled format strings.  We compile a format string into a list of
+ *   operations, each of which is either a run of literal text to copy, or a
+ *   '%' conversion with its options already parsed.  Literal runs refer to
+ *   the format text by byte offset, so a program compiled from one copy of
+ *   a string works with any other copy of the same text.  
  */
-static void tsprintf(VMG_ vm_val_t *retval, const char *fmtp, size_t fmtl,
-                     int arg0, int argc)
+struct vmfmt_op
 {
-    /* set up a format string reader */
-    bpptr fmt(fmtp, fmtl);
+    /* true -> literal text; false -> conversion */
+    int lit;
+
+    /* for literal text, the byte offset and length in the format string */
+    size_t ofs;
+    size_t len;
+
+    /* for a conversion, the type code, options, and "[n]" argument number */
+    char type_spec;
+    fmtopts opts;
+    int argno;
 
     /* 
-     *   Create a string to hold the result.  Use 150% the length of the
-     *   format string as a guess, with a minimum of 64 characters; we'll
-     *   expand this as needed as we go. 
+     *   true -> the options are only width, alignment and padding, so an
+     *   integer value for %d or %u can use the direct decimal conversion 
      */
-    size_t init_len = (fmtl < 43 ? 64 : fmtl*3/2);
-    retval->set_obj(CVmObjString::create(vmg_ FALSE, init_len));
+    int plain;
+};
 
-    /* push it for gc protection */
-    G_stk->push(retval);
+/* compiled format program */
+struct vmfmt_prog
+{
+    /* next program in the cache's MRU list */
+    vmfmt_prog *nxt;
 
-    /* adjust the argument base for our additions */
-    arg0 += 1;
+    /* our copy of the format text, its length, and its hash value */
+    char *fmt;
+    size_t len;
+    uint hash;
 
-    /* set up an output writer */
-    bpwriter dst(vmg_ (CVmObjString *)vm_objp(vmg_ retval->val.obj));
+    /* number of sprintf calls using the program */
+    int refs;
 
-    /* set up a nil value for missing arguments */
-    vm_val_t nil_val;
-    nil_val.set_nil();
+    /* true -> the program is in the cache; false -> it's private */
+    int cached;
+
+    /* the operations */
+    vmfmt_op *ops;
+    size_t nops;
+};
+
+/*
+ *   Compile a format string.  If 'ops' is null, we just count the
+ *   operations; otherwise we fill in the array, which must be big enough.
+ *   Returns the number of operations.  
+ */
+static size_t compile_fmt(const char *fmtp, size_t fmtl, vmfmt_op *ops)
+{
+    /* set up a format string reader */
+    bpptr fmt(fmtp, fmtl);
+    size_t n = 0;
 
     /* 
      *   Scan the format string.  The string is in utf8 format as always, but
      *   our format codes are all plain ASCII characters, so a simple byte
      *   scan is perfectly adequate.  
      */
-    for (int argpos = 1 ; fmt.more() ; )
+    while (fmt.more())
     {
         /* check for format codes */
-        char ch = fmt.skipch();
-        if (ch == '%')
+        if (fmt.getch() != '%')
         {
-            /* format specifier - remember where the '%' was */
-            const char *pct = fmt.p - 1;
+            /* literal text - take everything up to the next '%' */
+            const char *start = fmt.p;
+            while (fmt.more() && fmt.getch() != '%')
+                fmt.inc();
+
+            /* add the literal run */
+            if (ops != 0)
+            {
+                ops[n].lit = TRUE;
+                ops[n].ofs = start - fmtp;
+                ops[n].len = fmt.p - start;
+            }
+            ++n;
+            continue;
+        }
+
+        /* format specifier - remember where the '%' was */
+        const char *pct = fmt.p;
+        fmt.inc();
 
-            /* set up our initial default options */
-            fmtopts opts;
-            int argno = -1;
+        /* set up our initial default options */
+        fmtopts opts;
+        int argno = -1;
 
-            /* parse flags until we're out of them */
-            for (int flags_done = FALSE ; !flags_done ; )
+        /* parse flags until we're out of them */
+        for (int flags_done = FALSE ; !flags_done ; )
+        {
+            /* check the next character */
+            switch (fmt.getch())
             {
-                /* check the next character */
-                switch (fmt.getch())
-                {
-                case '[':
-                    /* argument number specifier - "[digits]" */
-                    fmt.inc();
-                    argno = fmt.atoi();
-                    fmt.match_skip(']');
-                    break;
-                    
-                case '+':
-                    /* note the sign specifier */
-                    opts.sign = '+';
-                    fmt.inc();
-                    break;
+            case '[':
+                /* argument number specifier - "[digits]" */
+                fmt.inc();
+                argno = fmt.atoi();
+                fmt.match_skip(']');
+                break;
 
-                case ' ':
-                    /* note the blank-for-plus specifier */
-                    opts.sign = ' ';
-                    fmt.inc();
-                    break;
+            case '+':
+                /* note the sign specifier */
+                opts.sign = '+';
+                fmt.inc();
+                break;
 
-                case ',':
-                    /* note the group specifier */
-                    opts.group = ',';
-                    fmt.inc();
-                    break;
+            case ' ':
+                /* note the blank-for-plus specifier */
+                opts.sign = ' ';
+                fmt.inc();
+                break;
 
-                case '-':
-                    /* note the left-alignment specifier */
-                    opts.left_align = TRUE;
-                    fmt.inc();
-                    break;
+            case ',':
+                /* note the group specifier */
+                opts.group = ',';
+                fmt.inc();
+                break;
 
-                case '_':
-                    /* padding spec - the next charater is the pad char */
-                    fmt.inc();
-                    opts.pad = fmt.skipwch();
-                    break;
+            case '-':
+                /* note the left-alignment specifier */
+                opts.left_align = TRUE;
+                fmt.inc();
+                break;
 
-                case '#':
-                    /* pound flag - special flag per type */
-                    opts.pound = TRUE;
-                    fmt.inc();
-                    break;
+            case '_':
+                /* padding spec - the next charater is the pad char */
+                fmt.inc();
+                opts.pad = fmt.skipwch();
+                break;
 
-                default:
-                    /* it's not an option flag, so we're done with flags */
-                    flags_done = TRUE;
-                    break;
-                }
+            case '#':
+                /* pound flag - special flag per type */
+                opts.pound = TRUE;
+                fmt.inc();
+                break;
+
+            default:
+                /* it's not an option flag, so we're done with flags */
+                flags_done = TRUE;
+                break;
             }
+        }
 
-            /* 
-             *   Next comes the width, but there's one more flag character
-             *   that has a special position just before the width: '0', to
-             *   specify leading zero padding.
-             */
-            if (fmt.match_skip('0'))
+        /* 
+         *   Next comes the width, but there's one more flag character that
+         *   has a special position just before the width: '0', to specify
+         *   leading zero padding.
+         */
+        if (fmt.match_skip('0'))
+        {
+            /* obey this only if we're in right-align mode */
+            if (!opts.left_align)
+                opts.pad = '0';
+        }
+
+        /* check for a width specifier */
+        opts.width = fmt.check_atoi();
+
+        /* check for a precision specifier */
+        if (fmt.match_skip('.'))
+            opts.prec = fmt.atoi();
+
+        /* we're at the type specifier */
+        char type_spec = fmt.skipch();
+
+        /* if we're only counting, we're done with this one */
+        if (ops == 0)
+        {
+            ++n;
+            continue;
+        }
+
+        /* check the type */
+        switch (type_spec)
+        {
+        case '%':
+            /* literal % - copy it */
+            ops[n].lit = TRUE;
+            ops[n].ofs = fmt.p - 1 - fmtp;
+            ops[n].len = 1;
+            break;
+
+        case 'b':
+        case 'c':
+        case 'd':
+        case 'r':
+        case 'R':
+        case 'u':
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'g':
+        case 'G':
+        case 'o':
+        case 's':
+        case 'x':
+        case 'X':
+            /* valid conversion */
+            ops[n].lit = FALSE;
+            ops[n].type_spec = type_spec;
+            ops[n].opts = opts;
+            ops[n].argno = argno;
+            ops[n].plain = (opts.sign == '\0' && opts.group == 0
+                            && opts.prec < 0 && !opts.pound);
+            break;
+
+        default:
+            /* anything else is invalid - just copy the source % string */
+            ops[n].lit = TRUE;
+            ops[n].ofs = pct - fmtp;
+            ops[n].len = fmt.p - pct;
+            break;
+        }
+        ++n;
+    }
+
+    /* return the operation count */
+    return n;
+}
+
+/*
+ *   Create a program for a format string 
+ */
+static vmfmt_prog *new_fmt_prog(const char *fmt, size_t len, uint hash,
+                                int cached)
+{
+    vmfmt_prog *prog = new vmfmt_prog;
+
+    /* compile the string */
+    prog->nops = compile_fmt(fmt, len, 0);
+    prog->ops = new vmfmt_op[prog->nops != 0 ? prog->nops : 1];
+    compile_fmt(fmt, len, prog->ops);
+
+    /* keep a copy of the text if we're caching it */
+    prog->fmt = 0;
+    if (cached)
+    {
+        prog->fmt = new char[len != 0 ? len : 1];
+        memcpy(prog->fmt, fmt, len);
+    }
+
+    /* set up the rest */
+    prog->nxt = 0;
+    prog->len = len;
+    prog->hash = hash;
+    prog->refs = 1;
+    prog->cached = cached;
+
+    /* return the new program */
+    return prog;
+}
+
+/*
+ *   Delete a program 
+ */
+static void delete_fmt_prog(vmfmt_prog *prog)
+{
+    delete [] prog->ops;
+    delete [] prog->fmt;
+    delete prog;
+}
+
+/*
+ *   construction 
+ */
+CVmFmtCache::CVmFmtCache()
+{
+    head_ = 0;
+    cnt_ = 0;
+}
+
+/*
+ *   destruction 
+ */
+CVmFmtCache::~CVmFmtCache()
+{
+    while (head_ != 0)
+    {
+        vmfmt_prog *nxt = head_->nxt;
+        delete_fmt_prog(head_);
+        head_ = nxt;
+    }
+}
+
+/*
+ *   Find or compile the program for a format string 
+ */
+vmfmt_prog *CVmFmtCache::get(const char *fmt, size_t len)
+{
+    vmfmt_prog *prog;
+    vmfmt_prog *prv;
+    vmfmt_prog *victim;
+    vmfmt_prog *victim_prv;
+
+    /* don't bother caching very long strings */
+    if (len > VMFMT_CACHE_MAX_LEN)
+        return new_fmt_prog(fmt, len, 0, FALSE);
+
+    /* compute the hash of the format text */
+    uint hash = 2166136261U;
+    for (size_t i = 0 ; i < len ; ++i)
+        hash = (hash ^ (uchar)fmt[i]) * 16777619U;
+
+    /* 
+     *   look for an existing entry, noting the last unreferenced entry
+     *   along the way, in case we need to evict one 
+     */
+    for (prog = head_, prv = 0, victim = victim_prv = 0 ; prog != 0 ;
+         prv = prog, prog = prog->nxt)
+    {
+        if (prog->hash == hash && prog->len == len
+            && memcmp(prog->fmt, fmt, len) == 0)
+        {
+            /* found it - move it to the head of the list */
+            if (prv != 0)
             {
-                /* obey this only if we're in right-align mode */
-                if (!opts.left_align)
-                    opts.pad = '0';
+                prv->nxt = prog->nxt;
+                prog->nxt = head_;
+                head_ = prog;
             }
 
-            /* check for a width specifier */
-            opts.width = fmt.check_atoi();
+            /* add the caller's reference and return it */
+            ++prog->refs;
+            return prog;
+        }
+
+        /* note the least recently used unreferenced entry */
+        if (prog->refs == 0)
+        {
+            victim = prog;
+            victim_prv = prv;
+        }
+    }
+
+    /* if the cache is full, evict the least recently used free entry */
+    if (cnt_ >= VMFMT_CACHE_SIZE)
+    {
+        /* if everything's in use, use a private program */
+        if (victim == 0)
+            return new_fmt_prog(fmt, len, hash, FALSE);
+
+        /* unlink and delete the victim */
+        if (victim_prv != 0)
+            victim_prv->nxt = victim->nxt;
+        else
+            head_ = victim->nxt;
+        delete_fmt_prog(victim);
+        --cnt_;
+    }
 
-            /* check for a precision specifier */
-            if (fmt.match_skip('.'))
-                opts.prec = fmt.atoi();
+    /* compile the new program and link it in at the head of the list */
+    prog = new_fmt_prog(fmt, len, hash, TRUE);
+    prog->nxt = head_;
+    head_ = prog;
+    ++cnt_;
 
-            /* we're at the type specifier */
-            char type_spec = fmt.skipch();
+    /* return it */
+    return prog;
+}
 
-            /* presume we'll use an argument */
-            int used_arg = TRUE;
+/*
+ *   Release a reference to a program 
+ */
+void CVmFmtCache::release(vmfmt_prog *prog)
+{
+    if (!prog->cached)
+        delete_fmt_prog(prog);
+    else
+        --prog->refs;
+}
+
+/*
+ *   Internal sprintf formatter.  The arguments are on the stack in the usual
+ *   function call order, with the first argument at top of stack.  We'll
+ *   allocate a new String object to hold the result.  
+ */
+static void tsprintf(VMG_ vm_val_t *retval, const char *fmtp, size_t fmtl,
+                     int arg0, int argc)
+{
+    /* 
+     *   Create a string to hold the result.  Use 150% the length of the
+     *   format string as a guess, with a minimum of 64 characters; we'll
+     *   expand this as needed as we go. 
+     */
+    size_t init_len = (fmtl < 43 ? 64 : fmtl*3/2);
+    retval->set_obj(CVmObjString::create(vmg_ FALSE, init_len));
+
+    /* push it for gc protection */
+    G_stk->push(retval);
+
+    /* adjust the argument base for our additions */
+    arg0 += 1;
+
+    /* set up an output writer */
+    bpwriter dst(vmg_ (CVmObjString *)vm_objp(vmg_ retval->val.obj));
+
+    /* set up a nil value for missing arguments */
+    vm_val_t nil_val;
+    nil_val.set_nil();
+
+    /* get the compiled program for the format string */
+    CVmFmtCache *cache = G_bif_tads_globals->fmt_cache;
+    vmfmt_prog *prog = cache->get(fmtp, fmtl);
+
+    err_try
+    {
+        /* run the program */
+        int argpos = 1;
+        const vmfmt_op *op = prog->ops;
+        for (size_t i = 0 ; i < prog->nops ; ++i, ++op)
+        {
+            /* if it's literal text, copy it */
+            if (op->lit)
+            {
+                dst.puts(fmtp + op->ofs, op->len);
+                continue;
+            }
 
             /* retrieve the current argument value */
-            int argi = (argno > 0 ? argno : argpos);
+            int argi = (op->argno > 0 ? op->argno : argpos);
             const vm_val_t *val =
                 (argi <= argc ? G_stk->get(arg0 + argi - 1) : &nil_val);
 
             /* apply the substitution based on the type */
-            switch (type_spec)
+            switch (op->type_spec)
             {
-            case '%':
-                /* literal % - copy it */
-                dst.putch('%');
-
-                /* this doesn't use an argument */
-                used_arg = FALSE;
-                break;
-
             case 'b':
                 /* number -> binary integer */
-                dst.format_int(vmg_ val, 2, 0, opts, FI_UNSIGNED);
+                dst.format_int(vmg_ val, 2, 0, op->opts, FI_UNSIGNED);
                 break;
 
             case 'c':
@@ -4224,22 +4889,34 @@ static void tsprintf(VMG_ vm_val_t *retval, const char *fmtp, size_t fmtl,
 
             case 'd':
                 /* number -> decimal integer */
-                dst.format_int(vmg_ val, 10, 0, opts);
+                if (op->plain && val->typ == VM_INT)
+                {
+                    int32_t iv = val->val.intval;
+                    dst.format_dec(vmg_ iv < 0 ? 0U - (uint32_t)iv
+                                               : (uint32_t)iv,
+                                   iv < 0, op->opts);
+                }
+                else
+                    dst.format_int(vmg_ val, 10, 0, op->opts);
                 break;
 
             case 'r':
                 /* number -> roman numeral (lowercase) */
-                dst.format_roman(vmg_ val, opts, 0);
+                dst.format_roman(vmg_ val, op->opts, 0);
                 break;
 
             case 'R':
                 /* number -> roman numeral (uppercase) */
-                dst.format_roman(vmg_ val, opts, FI_CAPS);
+                dst.format_roman(vmg_ val, op->opts, FI_CAPS);
                 break;
 
             case 'u':
                 /* number -> decimal integer, unsigned interpretation */
-                dst.format_int(vmg_ val, 10, 0, opts, FI_UNSIGNED);
+                if (op->plain && val->typ == VM_INT)
+                    dst.format_dec(vmg_ (uint32_t)val->val.intval,
+                                   FALSE, op->opts);
+                else
+                    dst.format_int(vmg_ val, 10, 0, op->opts, FI_UNSIGNED);
                 break;
 
             case 'e':
@@ -4248,49 +4925,42 @@ static void tsprintf(VMG_ vm_val_t *retval, const char *fmtp, size_t fmtl,
             case 'g':
             case 'G':
                 /* number -> floating point */
-                dst.format_float(vmg_ val, type_spec, opts);
+                dst.format_float(vmg_ val, op->type_spec, op->opts);
                 break;
 
             case 'o':
                 /* number -> octal integer */
-                dst.format_int(vmg_ val, 8, "0", opts, FI_UNSIGNED);
+                dst.format_int(vmg_ val, 8, "0", op->opts, FI_UNSIGNED);
                 break;
 
             case 's':
                 /* string */
-                dst.format_string(vmg_ val, opts);
+                dst.format_string(vmg_ val, op->opts);
                 break;
 
             case 'x':
                 /* number -> hex integer, lowercase letters */
-                dst.format_int(vmg_ val, 16, "0x", opts, FI_UNSIGNED);
+                dst.format_int(vmg_ val, 16, "0x", op->opts, FI_UNSIGNED);
                 break;
 
             case 'X':
                 /* number -> hex integer, uppercase letters */
-                dst.format_int(vmg_ val, 16, "0X", opts,
+                dst.format_int(vmg_ val, 16, "0X", op->opts,
                                FI_UNSIGNED | FI_CAPS);
                 break;
-
-            default:
-                /* anything else is invalid - just copy the source % string */
-                dst.puts(pct, fmt.p - pct);
-
-                /* we didn't use an argument after all */
-                used_arg = FALSE;
-                break;
             }
 
             /* if we used a positional argument, count it */
-            if (used_arg && argno < 0)
+            if (op->argno < 0)
                 ++argpos;
         }
-        else
-        {
-            /* just copy this byte verbatim */
-            dst.putch(ch);
-        }
     }
+    err_finally
+    {
+        /* done with the program */
+        cache->release(prog);
+    }
+    err_end;
 
     /* set the final result string length */
     dst.close();
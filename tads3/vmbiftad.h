@@ -74,6 +74,8 @@ public:
     static void get_sgn(VMG_ uint argc);
     static void concat(VMG_ uint argc);
     static void re_search_back(VMG_ uint argc);
+    static void randList(VMG_ uint argc);
+    static void re_match_first(VMG_ uint argc);
 
     /* internal toString interface */
     static void toString(VMG_ vm_val_t *retval, const vm_val_t *srcval,
@@ -88,6 +90,8 @@ protected:
 
     /* enumerate objects (common handler for firstobj and nextobj) */
     static void enum_objects(VMG_ uint argc, vm_obj_id_t start_obj);
+    static int enum_objects_match(VMG_ vm_obj_id_t obj, vm_obj_id_t sc,
+                                  unsigned long flags);
 
     /* common handler for toInteger and toNumber */
     static void toIntOrNum(VMG_ uint argc, int int_only);
@@ -104,6 +108,49 @@ protected:
 #define VMBT_RNGID_BITSHIFT  4
 
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Compiled format string cache for sprintf().  Programs tend to call
+ *   sprintf() over and over with the same few literal format strings (for
+ *   status lines, scores, tables of numbers), so rather than parsing the
+ *   flags, widths and conversion codes on every call, we compile each
+ *   format string into a list of operations the first time we see it - a
+ *   run of literal text, or a conversion with its parsed options - and keep
+ *   the list, keyed by the format text.  
+ */
+
+/* number of format strings we cache */
+const size_t VMFMT_CACHE_SIZE = 32;
+
+/* longest format string we'll cache */
+const size_t VMFMT_CACHE_MAX_LEN = 512;
+
+class CVmFmtCache
+{
+public:
+    CVmFmtCache();
+    ~CVmFmtCache();
+
+    /* 
+     *   Find or compile the program for a format string, and add a
+     *   reference to it; the caller must release() it when done.  If the
+     *   string can't be cached, this returns a private program that
+     *   release() deletes.  
+     */
+    struct vmfmt_prog *get(const char *fmt, size_t len);
+
+    /* release a reference to a program */
+    void release(struct vmfmt_prog *prog);
+
+protected:
+    /* head of the program list, in most-recently-used order */
+    struct vmfmt_prog *head_;
+
+    /* number of programs in the list */
+    size_t cnt_;
+};
+
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Global information for the TADS intrinsics.  We allocate this
@@ -123,6 +170,12 @@ public:
     class CRegexParser *rex_parser;
     class CRegexSearcherSimple *rex_searcher;
 
+    /* cache of compiled patterns for expressions passed as strings */
+    class CRegexCache *rex_cache;
+
+    /* cache of compiled sprintf format strings */
+    class CVmFmtCache *fmt_cache;
+
     /* 
      *   global variable for the last regular expression search string (we
      *   need to hold onto this because we might need to extract group-match
@@ -211,7 +264,9 @@ vm_bif_desc CVmBifTADS::bif_table[] =
     { &CVmBifTADS::get_abs, 1, 0, FALSE },                            /* 26 */
     { &CVmBifTADS::get_sgn, 1, 0, FALSE },                            /* 27 */
     { &CVmBifTADS::concat, 0, 0, TRUE },                              /* 28 */
-    { &CVmBifTADS::re_search_back, 2, 1, FALSE }                      /* 29 */
+    { &CVmBifTADS::re_search_back, 2, 1, FALSE },                     /* 29 */
+    { &CVmBifTADS::randList, 1, 2, FALSE },                           /* 30 */
+    { &CVmBifTADS::re_match_first, 2, 2, FALSE }                      /* 31 */
 };
 
 #endif /* VMBIF_DEFINE_VECTOR */
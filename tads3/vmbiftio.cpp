@@ -46,6 +46,7 @@ Modified
 #include "vmpredef.h"
 #include "vmcset.h"
 #include "vmfilobj.h"
+#include "vmstrbuf.h"
 #include "vmfilnam.h"
 #include "vmnetfil.h"
 #include "vmnet.h"
@@ -2567,3 +2568,55 @@ void CVmBifTIO::log_input_event(VMG_ uint argc)
     /* no return value */
     retval_nil(vmg0_);
 }
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Begin capturing main console output.  With a StringBuffer argument, the
+ *   captured text is appended to the buffer; with no argument (or nil), the
+ *   text is only counted.  Either way, nothing is displayed until the
+ *   capture ends.  
+ */
+void CVmBifTIO::output_capture_begin(VMG_ uint argc)
+{
+    /* check arguments */
+    check_argc_range(vmg_ argc, 0, 1);
+
+    /* get the buffer, if any */
+    vm_obj_id_t buf = VM_INVALID_OBJ;
+    if (argc >= 1)
+    {
+        const vm_val_t *val = G_stk->get(0);
+        if (val->typ == VM_OBJ
+            && CVmObjStringBuffer::is_string_buffer_obj(vmg_ val->val.obj))
+            buf = val->val.obj;
+        else if (val->typ != VM_NIL)
+            err_throw(VMERR_BAD_TYPE_BIF);
+    }
+
+    /* start the capture */
+    if (G_console->begin_capture(vmg_ buf))
+        err_throw(VMERR_BAD_VAL_BIF);
+
+    /* discard arguments */
+    G_stk->discard(argc);
+
+    /* no return value */
+    retval_nil(vmg0_);
+}
+
+/*
+ *   End the current output capture, returning the number of characters
+ *   captured, or nil if there's no capture in effect 
+ */
+void CVmBifTIO::output_capture_end(VMG_ uint argc)
+{
+    /* check arguments */
+    check_argc(vmg_ argc, 0);
+
+    /* end the capture and return the count */
+    long cnt = G_console->end_capture(vmg0_);
+    if (cnt >= 0)
+        retval_int(vmg_ cnt);
+    else
+        retval_nil(vmg0_);
+}
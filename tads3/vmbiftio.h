@@ -80,6 +80,12 @@ public:
     static void log_console_close(VMG_ uint argc);
     static void log_console_say(VMG_ uint argc);
 
+    /*
+     *   output capture functions 
+     */
+    static void output_capture_begin(VMG_ uint argc);
+    static void output_capture_end(VMG_ uint argc);
+
 protected:
     /*
      *   Map an "extended" keystroke from raw (os_getc_raw, os_get_event) to
@@ -198,7 +204,10 @@ vm_bif_desc CVmBifTIO::bif_table[] =
     { &CVmBifTIO::log_console_close, 1, 0, FALSE },                   /* 31 */
     { &CVmBifTIO::log_console_say, 1, 0, TRUE },                      /* 32 */
 
-    { &CVmBifTIO::log_input_event, 1, 0, FALSE }                      /* 33 */
+    { &CVmBifTIO::log_input_event, 1, 0, FALSE },                     /* 33 */
+
+    { &CVmBifTIO::output_capture_begin, 0, 1, FALSE },                /* 34 */
+    { &CVmBifTIO::output_capture_end, 0, 0, FALSE }                   /* 35 */
 };
 
 #endif /* VMBIF_DEFINE_VECTOR */
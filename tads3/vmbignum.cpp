@@ -291,7 +291,7 @@ const unsigned char CVmObjBigNum::pi_[] =
  *   the S_ naming prefix to emphasize that it's conceptually a "static"
  *   variable, private to this two-file module.
  */
-extern CVmBigNumCache *S_bignum_cache;
+extern T3_DECL_PER_THREAD(CVmBigNumCache *, S_bignum_cache);
 
 /* ------------------------------------------------------------------------ */
 /*
@@ -1822,6 +1822,25 @@ const char *CVmObjBigNum::cvt_to_string_in_radix(
     return new_str->get_as_string(vmg0_);
 }
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   load from an image file 
+ */
+void CVmObjBigNum::load_from_image(VMG_ vm_obj_id_t, const char *ptr, size_t)
+{
+    /* point directly to the image data */
+    ext_ = (char *)ptr;
+
+    /* 
+     *   The image's BigNumber constants tell us the precision the program
+     *   works at, so pre-allocate the cache's temporary registers at that
+     *   size (plus the guard digits the calculations add), so that the
+     *   first calculations don't have to build up the register pool one
+     *   allocation at a time.  
+     */
+    S_bignum_cache->prewarm(calc_alloc(get_prec(ptr) + 3));
+}
+
 /* ------------------------------------------------------------------------ */
 /* 
  *   save to a file 
@@ -35,6 +35,46 @@ Modified
  *   with sufficient precision, and allocate a new register if not.
  */
 
+/* 
+ *   Number of size buckets for free registers.  Bucket n holds registers
+ *   of VMBN_CACHE_MIN_SIZE * 2^n bytes; the last bucket also holds
+ *   anything larger.  
+ */
+#define VMBN_CACHE_BUCKETS   12
+#define VMBN_CACHE_MIN_SIZE  64
+
+/* 
+ *   Number of registers to pre-allocate when we learn the precision the
+ *   program uses (from the BigNumber objects in the image file).  The
+ *   transcendental functions use up to nine registers each, and they
+ *   nest, so this covers a typical calculation without any allocation.  
+ */
+#define VMBN_CACHE_PREWARM   16
+
+/* register cache statistics */
+struct vmbn_cache_stats
+{
+    /* number of register allocations */
+    ulong allocs;
+
+    /* number of allocations satisfied from a free register already large
+       enough, without touching the heap */
+    ulong hits;
+
+    /* number of allocations that had to allocate or grow a buffer */
+    ulong grows;
+
+    /* number of allocations that failed because all registers were busy */
+    ulong failures;
+
+    /* registers currently in use, and the high-water mark */
+    size_t in_use;
+    size_t peak_in_use;
+
+    /* largest register size requested, in bytes */
+    size_t max_siz;
+};
+
 /* internal register descriptor */
 struct CVmBigNumCacheReg
 {
@@ -125,6 +165,17 @@ public:
     /* release all registers */
     void release_all();
 
+    /* 
+     *   Pre-allocate registers of the given byte size, so that
+     *   calculations at that size don't have to allocate memory.  This
+     *   only ever grows the pool: if we've already pre-allocated at this
+     *   size or larger, it does nothing.  
+     */
+    void prewarm(size_t siz);
+
+    /* get the statistics */
+    const vmbn_cache_stats *get_stats() const { return &stats_; }
+
     /* 
      *   Get a special dedicated constant value register, reallocating it
      *   to the required precision if it's not already available at the
@@ -167,11 +218,47 @@ private:
         return reg->buf_;
     }
     
+    /* get the bucket index for a register of the given byte size */
+    static int bucket_for(size_t siz)
+    {
+        int b;
+        size_t bsiz;
+        for (b = 0, bsiz = VMBN_CACHE_MIN_SIZE ;
+             bsiz < siz && b < VMBN_CACHE_BUCKETS - 1 ; bsiz <<= 1, ++b) ;
+        return b;
+    }
+
+    /* 
+     *   get the buffer size to allocate for a request of the given size -
+     *   we round up to the full bucket size, so that any register in a
+     *   bucket satisfies any request that maps to that bucket 
+     */
+    static size_t alloc_size_for(size_t siz)
+    {
+        int b = bucket_for(siz);
+        size_t bsiz = (size_t)VMBN_CACHE_MIN_SIZE << b;
+        return (siz > bsiz ? siz : bsiz);
+    }
+
+    /* add a register to the free list for its size */
+    void add_free(CVmBigNumCacheReg *p)
+    {
+        int b = bucket_for(p->siz_);
+        p->nxt_ = free_reg_[b];
+        free_reg_[b] = p;
+    }
+
     /* our register array */
     CVmBigNumCacheReg *reg_;
 
-    /* head of free register list */
-    CVmBigNumCacheReg *free_reg_;
+    /* heads of the free register lists, by size bucket */
+    CVmBigNumCacheReg *free_reg_[VMBN_CACHE_BUCKETS];
+
+    /* size of the registers we've pre-allocated, if any */
+    size_t prewarm_siz_;
+
+    /* statistics */
+    vmbn_cache_stats stats_;
 
     /* head of unallocated register list */
     CVmBigNumCacheReg *unalloc_reg_;
@@ -255,6 +342,14 @@ private:
 #define VMBN_T_INF        0x0004         /* INFINITY (negative or positive) */
 #define VMBN_T_RSRVD      0x0006                                /* reserved */
 
+/* 
+ *   Maximum number of significant digits for the small-value arithmetic
+ *   fast paths.  Operands with this many digits, and their sums and
+ *   products, must fit in an unsigned long, which the C standard only
+ *   guarantees to be 32 bits. 
+ */
+#define VMBN_SMALL_DIGITS  9
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Flags for cvt_to_string 
@@ -527,6 +622,9 @@ public:
     static void init_cache();
     static void term_cache();
 
+    /* get the register cache usage statistics */
+    static const vmbn_cache_stats *get_cache_stats();
+
     /* 
      *   write to a 'data' mode file - returns zero on success, non-zero on
      *   I/O or other error 
@@ -689,6 +787,9 @@ public:
 
     /* notify of deletion */
     void notify_delete(VMG_ int in_root_set);
+    /* report our memory use; an image-file number owns no heap memory */
+    size_t get_mem_usage(VMG_ int in_root_set) const
+        { return in_root_set ? 0 : get_ext_heap_bytes(vmg0_); }
 
     /* set a property */
     void set_prop(VMG_ class CVmUndo *undo,
@@ -711,8 +812,7 @@ public:
     void remove_stale_weak_refs(VMG0_) { }
 
     /* load from an image file */
-    void load_from_image(VMG_ vm_obj_id_t, const char *ptr, size_t)
-        { ext_ = (char *)ptr; }
+    void load_from_image(VMG_ vm_obj_id_t, const char *ptr, size_t);
 
     /* rebuild for image file */
     virtual ulong rebuild_image(VMG_ char *buf, ulong buflen);
@@ -1258,6 +1358,56 @@ protected:
     /* compute a square root */
     static void compute_sqrt_into(char *new_ext, const char *ext);
 
+    /*
+     *   Small-value fast paths.  Most BigNumber arithmetic in practice
+     *   involves values with only a few significant digits (money, scores,
+     *   percentages), which we can add, subtract, and multiply exactly with
+     *   native integer arithmetic rather than digit by digit.
+     *   
+     *   get_small_val() retrieves the significant digits of an ordinary,
+     *   non-zero number as an integer 'm', such that the absolute value of
+     *   the number is m * 10^lo_exp.  Returns false if the value isn't an
+     *   ordinary non-zero number, or has more than VMBN_SMALL_DIGITS
+     *   significant digits.
+     *   
+     *   set_small_val() stores the non-negative value m * 10^lo_exp into
+     *   a buffer, if it fits exactly: the result must not need more digits
+     *   than the buffer's precision, and the operands the result was
+     *   computed from must not span more digit positions than that, either
+     *   ('span' is the number of digit positions from the result's lowest
+     *   digit up through the highest digit of either operand).  If it fits,
+     *   we store it and return true; otherwise we leave the buffer
+     *   untouched and return false, so that the caller can fall back on
+     *   the general algorithm and its rounding rules.  
+     */
+    static int get_small_val(const char *ext, ulong *m, int *lo_exp);
+    static int set_small_val(char *ext, ulong m, int lo_exp, int span);
+
+    /* 
+     *   get two small values scaled to a common exponent, for addition or
+     *   subtraction; fills in the scaled mantissas, the common (lower)
+     *   exponent, and the number of digit positions the two values span 
+     */
+    static int get_small_pair(const char *ext1, const char *ext2,
+                              ulong *m1, ulong *m2, int *lo_exp, int *span);
+
+    /* 
+     *   Limb arithmetic for long operands.  limbs_from_ext() converts a
+     *   number's significant digits to base-10000 limbs; limbs_to_ext()
+     *   stores limbs back into a number, rounding to its precision.  The
+     *   compute_xxx_limbs() routines return false if the operands are too
+     *   short for limb arithmetic to pay off, or scratch memory isn't
+     *   available, in which case the caller uses the digit-wise algorithm.
+     */
+    static size_t limbs_from_ext(const char *ext, ulong *l,
+                                 size_t *sig, int *lo_exp);
+    static void limbs_to_ext(char *ext, const ulong *l, size_t n,
+                             int lo_exp, int sticky);
+    static int compute_prod_limbs(char *new_ext,
+                                  const char *ext1, const char *ext2);
+    static int compute_quotient_limbs(char *new_ext,
+                                      const char *ext1, const char *ext2);
+
     /* compute the sum of two operands into the given buffer */
     static void compute_sum_into(char *new_ext,
                                  const char *ext1, const char *ext2);
@@ -1838,6 +1838,117 @@ int CVmObjBigNum::compare_abs(const char *ext1, const char *ext2)
     return 0;
 }
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Get a small value as an integer mantissa and exponent  
+ */
+int CVmObjBigNum::get_small_val(const char *ext, ulong *m, int *lo_exp)
+{
+    /* this only works for ordinary, non-zero numbers */
+    if (get_type(ext) != VMBN_T_NUM || is_zero(ext))
+        return FALSE;
+
+    /* gather up to the maximum number of leading digits */
+    size_t prec = get_prec(ext);
+    size_t n = (prec < VMBN_SMALL_DIGITS ? prec : VMBN_SMALL_DIGITS);
+    ulong val = 0;
+    size_t i;
+    for (i = 0 ; i < n ; ++i)
+        val = val*10 + get_dig(ext, i);
+
+    /* the rest of the digits must all be zero */
+    for ( ; i < prec ; ++i)
+    {
+        if (get_dig(ext, i) != 0)
+            return FALSE;
+    }
+
+    /* drop trailing zeros, to keep the integer as small as possible */
+    for ( ; val % 10 == 0 ; val /= 10, --n) ;
+
+    /* return the value; the mantissa's implicit point is before 'n' digits */
+    *m = val;
+    *lo_exp = get_exp(ext) - (int)n;
+    return TRUE;
+}
+
+/*
+ *   Store a small value, if it fits exactly 
+ */
+int CVmObjBigNum::set_small_val(char *ext, ulong m, int lo_exp, int span)
+{
+    size_t prec = get_prec(ext);
+
+    /* if the operands span more positions than we can hold, give up */
+    if (span > (int)prec)
+        return FALSE;
+
+    /* if the value is zero, store a canonical zero */
+    if (m == 0)
+    {
+        ext[VMBN_FLAGS] = 0;
+        memset(ext + VMBN_MANT, 0, (prec + 1)/2);
+        set_zero(ext);
+        return TRUE;
+    }
+
+    /* count the digits */
+    size_t n = 0;
+    for (ulong t = m ; t != 0 ; t /= 10, ++n) ;
+
+    /* make sure it fits in our precision and exponent range */
+    if (n > prec || lo_exp + (int)n > 32767 || lo_exp + (int)n < -32767)
+        return FALSE;
+
+    /* it's an ordinary, positive number */
+    ext[VMBN_FLAGS] = 0;
+    set_type(ext, VMBN_T_NUM);
+
+    /* store the digits, left-justified, with zeros after */
+    memset(ext + VMBN_MANT, 0, (prec + 1)/2);
+    for (size_t i = n ; i != 0 ; m /= 10)
+        set_dig(ext, --i, (unsigned int)(m % 10));
+
+    /* set the exponent to put the decimal point in the right place */
+    set_exp(ext, lo_exp + (int)n);
+
+    /* success */
+    return TRUE;
+}
+
+/*
+ *   Get two small values scaled to a common exponent 
+ */
+int CVmObjBigNum::get_small_pair(const char *ext1, const char *ext2,
+                                 ulong *m1, ulong *m2,
+                                 int *lo_exp, int *span)
+{
+    int e1, e2;
+
+    /* both values must be small */
+    if (!get_small_val(ext1, m1, &e1) || !get_small_val(ext2, m2, &e2))
+        return FALSE;
+
+    /* scale the one with the higher exponent down to the lower exponent */
+    ulong *mp = (e1 > e2 ? m1 : m2);
+    int e = (e1 > e2 ? e2 : e1);
+    for (int d = (e1 > e2 ? e1 - e2 : e2 - e1) ; d != 0 ; --d)
+    {
+        /* make sure we still fit in the small digit limit after scaling */
+        if (*mp >= 100000000UL)
+            return FALSE;
+
+        /* scale it */
+        *mp *= 10;
+    }
+
+    /* the span runs from the lower exponent up to the higher high digit */
+    int hi1 = get_exp(ext1), hi2 = get_exp(ext2);
+    *span = (hi1 > hi2 ? hi1 : hi2) - e;
+    *lo_exp = e;
+    return TRUE;
+}
+
 /* ------------------------------------------------------------------------ */
 /* 
  *   Compute a sum into the given buffer 
@@ -1900,6 +2011,13 @@ void CVmObjBigNum::compute_abs_sum_into(char *new_ext,
         return;
     }
 
+    /* if the values are small enough, add them as native integers */
+    ulong m1, m2;
+    int lo_exp, span;
+    if (get_small_pair(ext1, ext2, &m1, &m2, &lo_exp, &span)
+        && set_small_val(new_ext, m1 + m2, lo_exp, span))
+        return;
+
     /* 
      *   start the new value with the larger of the two exponents - this
      *   will have the desired effect of dropping the least significant
@@ -2102,6 +2220,19 @@ void CVmObjBigNum::compute_abs_diff_into(char *new_ext,
         return;
     }
 
+    /* if the values are small enough, subtract them as native integers */
+    ulong m1, m2;
+    int lo_exp, span;
+    if (get_small_pair(ext1, ext2, &m1, &m2, &lo_exp, &span)
+        && set_small_val(new_ext, m1 >= m2 ? m1 - m2 : m2 - m1,
+                         lo_exp, span))
+    {
+        /* the result is negative if the second value was larger */
+        if (m1 < m2)
+            set_neg(new_ext, TRUE);
+        return;
+    }
+
     /*
      *   Compare the absolute values of the two operands.  If the first
      *   value is larger than the second, subtract them in the given
@@ -2246,6 +2377,534 @@ void CVmObjBigNum::compute_abs_diff_into(char *new_ext,
     normalize(new_ext);
 }
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Limb arithmetic.  The digit-at-a-time multiplication and division
+ *   algorithms are quadratic in the precision, and they spend most of their
+ *   time packing and unpacking BCD nibbles, which makes them very slow for
+ *   values with hundreds or thousands of digits.  For long operands we
+ *   instead convert the significant digits to arrays of base-10000 "limbs"
+ *   (little-endian: limb 0 holds the four least significant digits),
+ *   operate on those, and convert the result back, rounding it exactly as
+ *   the digit-wise algorithms would.
+ *   
+ *   Every intermediate value fits in 32 bits: a limb product plus two
+ *   carries is at most 9999*9999 + 2*9999, so we can use unsigned long,
+ *   which the C standard guarantees to be at least that large.
+ *   
+ *   The limb routines return false if they can't allocate scratch memory,
+ *   in which case the caller falls back on the digit-wise algorithm.  
+ */
+
+/* limb base, and the number of decimal digits per limb */
+#define VMBN_LIMB_BASE    10000UL
+#define VMBN_LIMB_DIGITS  4
+
+/* 
+ *   Minimum number of significant digits, in both operands, for which we
+ *   use limb multiplication; and the minimum quotient precision for which
+ *   we use limb division.  Below these sizes the conversion overhead isn't
+ *   worth it.  
+ */
+#define VMBN_LIMB_MUL_MIN  6
+#define VMBN_LIMB_DIV_MIN  6
+
+/* 
+ *   Minimum length, in limbs, of the shorter operand for which we use
+ *   Karatsuba multiplication rather than the schoolbook algorithm 
+ */
+#define VMBN_KARATSUBA_MIN  32
+
+/* powers of ten within a limb */
+static const ulong S_limb_pow10[VMBN_LIMB_DIGITS] = { 1, 10, 100, 1000 };
+
+/* allocate/free limb scratch space */
+static ulong *limb_alloc(size_t cnt)
+    { return (ulong *)t3malloc(cnt * sizeof(ulong)); }
+static void limb_free(ulong *p)
+    { t3free(p); }
+
+/* get the length of a limb array, ignoring leading (high-order) zeros */
+static size_t limb_len(const ulong *a, size_t n)
+{
+    while (n != 0 && a[n-1] == 0)
+        --n;
+    return n;
+}
+
+/* add b[0..nb) into a[0..na); the sum must fit in na limbs */
+static void limb_add_into(ulong *a, size_t na, const ulong *b, size_t nb)
+{
+    size_t i;
+    ulong carry = 0;
+
+    /* add the digits of b, then propagate the carry */
+    nb = limb_len(b, nb);
+    for (i = 0 ; i < nb ; ++i)
+    {
+        ulong t = a[i] + b[i] + carry;
+        carry = (t >= VMBN_LIMB_BASE);
+        a[i] = (carry ? t - VMBN_LIMB_BASE : t);
+    }
+    for ( ; carry && i < na ; ++i)
+    {
+        carry = (++a[i] == VMBN_LIMB_BASE);
+        if (carry)
+            a[i] = 0;
+    }
+}
+
+/* subtract b[0..nb) from a[0..na); a must be at least as large as b */
+static void limb_sub_from(ulong *a, size_t na, const ulong *b, size_t nb)
+{
+    size_t i;
+    ulong borrow = 0;
+
+    /* subtract the digits of b, then propagate the borrow */
+    nb = limb_len(b, nb);
+    for (i = 0 ; i < nb ; ++i)
+    {
+        ulong d = b[i] + borrow;
+        borrow = (a[i] < d);
+        a[i] = (borrow ? a[i] + VMBN_LIMB_BASE - d : a[i] - d);
+    }
+    for ( ; borrow && i < na ; ++i)
+    {
+        borrow = (a[i] == 0);
+        a[i] = (borrow ? VMBN_LIMB_BASE - 1 : a[i] - 1);
+    }
+}
+
+/* schoolbook multiplication: r[0..na+nb) = a * b */
+static void limb_mul_basic(ulong *r, const ulong *a, size_t na,
+                           const ulong *b, size_t nb)
+{
+    memset(r, 0, (na + nb) * sizeof(r[0]));
+    for (size_t i = 0 ; i < na ; ++i)
+    {
+        /* skip zero limbs */
+        ulong ai = a[i];
+        if (ai == 0)
+            continue;
+
+        /* add ai*b into the result at limb i */
+        ulong carry = 0;
+        ulong *rp = r + i;
+        for (size_t j = 0 ; j < nb ; ++j)
+        {
+            ulong t = ai*b[j] + rp[j] + carry;
+            carry = t / VMBN_LIMB_BASE;
+            rp[j] = t % VMBN_LIMB_BASE;
+        }
+        rp[nb] = carry;
+    }
+}
+
+/* 
+ *   Multiply: r[0..na+nb) = a * b.  We use Karatsuba's method for long
+ *   operands: splitting each operand into high and low halves, a*b =
+ *   a1*b1*B^2m + ((a0+a1)*(b0+b1) - a0*b0 - a1*b1)*B^m + a0*b0, which takes
+ *   three half-size multiplications rather than four.  
+ */
+static int limb_mul(ulong *r, const ulong *a, size_t na,
+                    const ulong *b, size_t nb)
+{
+    /* make 'a' the longer operand */
+    if (na < nb)
+    {
+        const ulong *tp = a; a = b; b = tp;
+        size_t tn = na; na = nb; nb = tn;
+    }
+
+    /* use the schoolbook algorithm for short operands */
+    if (nb < VMBN_KARATSUBA_MIN)
+    {
+        limb_mul_basic(r, a, na, b, nb);
+        return TRUE;
+    }
+
+    /* 
+     *   if the operands are very unbalanced, multiply b by slices of a that
+     *   are the same length as b, so that the halves we split into below
+     *   are always comparable in size 
+     */
+    if (na >= 2*nb)
+    {
+        ulong *t = limb_alloc(2*nb);
+        if (t == 0)
+            return FALSE;
+
+        memset(r, 0, (na + nb) * sizeof(r[0]));
+        for (size_t off = 0 ; off < na ; off += nb)
+        {
+            size_t len = (na - off < nb ? na - off : nb);
+            if (!limb_mul(t, a + off, len, b, nb))
+            {
+                limb_free(t);
+                return FALSE;
+            }
+            limb_add_into(r + off, na + nb - off, t, len + nb);
+        }
+
+        limb_free(t);
+        return TRUE;
+    }
+
+    /* 
+     *   Split at m limbs.  Since na < 2*nb, nb >= m, so b0 is a full m
+     *   limbs, and b1 might be empty. 
+     */
+    size_t m = (na + 1)/2;
+    size_t na1 = na - m, nb1 = nb - m;
+
+    /* allocate space for the half sums and their product */
+    ulong *sa = limb_alloc(4*m + 4);
+    if (sa == 0)
+        return FALSE;
+    ulong *sb = sa + m + 1;
+    ulong *z1 = sb + m + 1;
+
+    /* z0 = a0*b0 goes in the low part of r, z2 = a1*b1 in the high part */
+    int ok = limb_mul(r, a, m, b, m);
+    if (ok && nb1 != 0)
+        ok = limb_mul(r + 2*m, a + m, na1, b + m, nb1);
+    else if (ok)
+        memset(r + 2*m, 0, na1 * sizeof(r[0]));
+
+    /* form the half sums, and multiply them */
+    if (ok)
+    {
+        memcpy(sa, a, m * sizeof(sa[0]));
+        sa[m] = 0;
+        limb_add_into(sa, m + 1, a + m, na1);
+        memcpy(sb, b, m * sizeof(sb[0]));
+        sb[m] = 0;
+        limb_add_into(sb, m + 1, b + m, nb1);
+        ok = limb_mul(z1, sa, m + 1, sb, m + 1);
+    }
+
+    /* z1 = (a0+a1)*(b0+b1) - z0 - z2 is the middle term; add it in */
+    if (ok)
+    {
+        limb_sub_from(z1, 2*m + 2, r, 2*m);
+        limb_sub_from(z1, 2*m + 2, r + 2*m, na1 + nb1);
+        limb_add_into(r + m, na + nb - m, z1, 2*m + 2);
+    }
+
+    /* done with the scratch space */
+    limb_free(sa);
+    return ok;
+}
+
+/*
+ *   Divide: q[0..un-vn] = u / v, where u has un limbs, v has vn limbs, and
+ *   un >= vn.  v must not have any leading zero limbs.  u is overwritten,
+ *   and must have room for un+1 limbs.  Returns true if the remainder is
+ *   non-zero.
+ *   
+ *   This is Knuth's Algorithm D (TAOCP vol. 2, 4.3.1): we scale both
+ *   operands so that v's leading limb is at least half the base, which
+ *   lets us estimate each quotient limb from the leading limbs of the
+ *   running remainder with an error of at most two.  
+ */
+static int limb_div(ulong *q, ulong *u, size_t un, ulong *v, size_t vn)
+{
+    const long B = (long)VMBN_LIMB_BASE;
+    size_t i, j;
+
+    /* if the divisor is a single limb, use short division */
+    if (vn == 1)
+    {
+        ulong d = v[0], r = 0;
+        for (i = un ; i != 0 ; )
+        {
+            --i;
+            ulong t = r*VMBN_LIMB_BASE + u[i];
+            q[i] = t / d;
+            r = t % d;
+        }
+        return r != 0;
+    }
+
+    /* normalize, so that the divisor's leading limb is >= B/2 */
+    ulong f = VMBN_LIMB_BASE / (v[vn-1] + 1);
+    ulong carry = 0;
+    for (i = 0 ; i < un ; ++i)
+    {
+        ulong t = u[i]*f + carry;
+        u[i] = t % VMBN_LIMB_BASE;
+        carry = t / VMBN_LIMB_BASE;
+    }
+    u[un] = carry;
+    for (carry = 0, i = 0 ; i < vn ; ++i)
+    {
+        ulong t = v[i]*f + carry;
+        v[i] = t % VMBN_LIMB_BASE;
+        carry = t / VMBN_LIMB_BASE;
+    }
+
+    /* figure each quotient limb, from most to least significant */
+    long vtop = (long)v[vn-1], vnext = (long)v[vn-2];
+    for (j = un - vn + 1 ; j != 0 ; )
+    {
+        --j;
+
+        /* estimate the quotient limb from the leading remainder limbs */
+        long num = (long)u[j+vn]*B + (long)u[j+vn-1];
+        long qhat = num / vtop, rhat = num % vtop;
+        while (qhat >= B || qhat*vnext > rhat*B + (long)u[j+vn-2])
+        {
+            --qhat;
+            rhat += vtop;
+            if (rhat >= B)
+                break;
+        }
+
+        /* subtract qhat*v from the running remainder */
+        long borrow = 0;
+        for (carry = 0, i = 0 ; i < vn ; ++i)
+        {
+            ulong p = (ulong)qhat*v[i] + carry;
+            carry = p / VMBN_LIMB_BASE;
+            long t = (long)u[i+j] - (long)(p % VMBN_LIMB_BASE) - borrow;
+            borrow = (t < 0);
+            u[i+j] = (ulong)(borrow ? t + B : t);
+        }
+        long t = (long)u[j+vn] - (long)carry - borrow;
+
+        /* if that went negative, qhat was one too large, so add v back */
+        if (t < 0)
+        {
+            --qhat;
+            u[j+vn] = (ulong)(t + B);
+            for (carry = 0, i = 0 ; i < vn ; ++i)
+            {
+                ulong s = u[i+j] + v[i] + carry;
+                carry = (s >= VMBN_LIMB_BASE);
+                u[i+j] = (carry ? s - VMBN_LIMB_BASE : s);
+            }
+            u[j+vn] = (u[j+vn] + carry) % VMBN_LIMB_BASE;
+        }
+        else
+            u[j+vn] = (ulong)t;
+
+        /* store the quotient limb */
+        q[j] = (ulong)qhat;
+    }
+
+    /* the remainder is what's left in the low vn limbs of u */
+    return limb_len(u, vn) != 0;
+}
+
+/*
+ *   Convert the significant digits of an ordinary, non-zero number to
+ *   limbs.  The caller must provide room for (prec+3)/4 limbs.  Fills in
+ *   the number of significant digits, and the exponent of the units
+ *   position of the resulting integer; returns the number of limbs.  
+ */
+size_t CVmObjBigNum::limbs_from_ext(const char *ext, ulong *l,
+                                    size_t *sig, int *lo_exp)
+{
+    /* find the last non-zero digit */
+    size_t n = get_prec(ext);
+    while (n != 0 && get_dig(ext, n - 1) == 0)
+        --n;
+
+    /* pack the digits into limbs, from the least significant end */
+    size_t cnt = (n + VMBN_LIMB_DIGITS - 1)/VMBN_LIMB_DIGITS;
+    memset(l, 0, cnt * sizeof(l[0]));
+    for (size_t i = 0 ; i < n ; ++i)
+    {
+        size_t pos = n - 1 - i;
+        l[pos / VMBN_LIMB_DIGITS] +=
+            get_dig(ext, i) * S_limb_pow10[pos % VMBN_LIMB_DIGITS];
+    }
+
+    /* return the results */
+    *sig = n;
+    *lo_exp = get_exp(ext) - (int)n;
+    return cnt;
+}
+
+/*
+ *   Store the value l * 10^lo_exp into a buffer, rounding to the buffer's
+ *   precision.  'sticky' indicates that the true value is slightly larger
+ *   than the value in 'l' (because the limbs are a truncated quotient, for
+ *   example), which matters when the dropped digits are exactly half a
+ *   unit.  The result is positive; the caller sets the sign.  
+ */
+void CVmObjBigNum::limbs_to_ext(char *ext, const ulong *l, size_t n,
+                                int lo_exp, int sticky)
+{
+    size_t prec = get_prec(ext);
+
+    /* count the digits */
+    n = limb_len(l, n);
+    if (n == 0)
+    {
+        ext[VMBN_FLAGS] = 0;
+        set_zero(ext);
+        return;
+    }
+    size_t ndig = (n - 1)*VMBN_LIMB_DIGITS;
+    for (ulong t = l[n-1] ; t != 0 ; t /= 10, ++ndig) ;
+
+    /* it's an ordinary number */
+    ext[VMBN_FLAGS] = 0;
+    set_type(ext, VMBN_T_NUM);
+    memset(ext + VMBN_MANT, 0, (prec + 1)/2);
+
+    /* store digits from the most significant, noting what we drop */
+    int trail_dig = 0, trail_val = sticky;
+    for (size_t i = 0 ; i < ndig ; ++i)
+    {
+        size_t pos = ndig - 1 - i;
+        unsigned int dig = (unsigned int)
+            ((l[pos / VMBN_LIMB_DIGITS]
+              / S_limb_pow10[pos % VMBN_LIMB_DIGITS]) % 10);
+
+        if (i < prec)
+            set_dig(ext, i, dig);
+        else if (i == prec)
+            trail_dig = dig;
+        else if (dig != 0)
+        {
+            trail_val = TRUE;
+            break;
+        }
+    }
+
+    /* set the exponent, and round for the dropped digits */
+    set_exp(ext, lo_exp + (int)ndig);
+    round_for_dropped_digits(ext, trail_dig, trail_val);
+    normalize(ext);
+}
+
+/*
+ *   Compute a product using limb arithmetic.  Returns false if the
+ *   operands are too short to bother, or we can't allocate memory.  
+ */
+int CVmObjBigNum::compute_prod_limbs(char *new_ext,
+                                     const char *ext1, const char *ext2)
+{
+    /* this only works for ordinary non-zero numbers */
+    if (get_type(ext1) != VMBN_T_NUM || is_zero(ext1)
+        || get_type(ext2) != VMBN_T_NUM || is_zero(ext2))
+        return FALSE;
+
+    /* allocate space for the operands and the product */
+    size_t max1 = (get_prec(ext1) + VMBN_LIMB_DIGITS - 1)/VMBN_LIMB_DIGITS;
+    size_t max2 = (get_prec(ext2) + VMBN_LIMB_DIGITS - 1)/VMBN_LIMB_DIGITS;
+    ulong *a = limb_alloc(2*(max1 + max2));
+    if (a == 0)
+        return FALSE;
+    ulong *b = a + max1;
+    ulong *r = b + max2;
+
+    /* convert the operands; if either is short, don't bother */
+    size_t sig1, sig2;
+    int e1, e2;
+    size_t na = limbs_from_ext(ext1, a, &sig1, &e1);
+    size_t nb = limbs_from_ext(ext2, b, &sig2, &e2);
+    int ok = (sig1 >= VMBN_LIMB_MUL_MIN && sig2 >= VMBN_LIMB_MUL_MIN);
+
+    /* multiply, and store the rounded result */
+    if (ok && (ok = limb_mul(r, a, na, b, nb)) != 0)
+    {
+        limbs_to_ext(new_ext, r, na + nb, e1 + e2, FALSE);
+        set_neg(new_ext, get_neg(ext1) != get_neg(ext2));
+    }
+
+    /* done with the scratch space */
+    limb_free(a);
+    return ok;
+}
+
+/*
+ *   Compute a quotient using limb arithmetic.  Returns false if the
+ *   quotient precision is too small to bother, or we can't allocate
+ *   memory.  
+ */
+int CVmObjBigNum::compute_quotient_limbs(char *new_ext,
+                                         const char *ext1, const char *ext2)
+{
+    /* this only works for ordinary non-zero numbers */
+    if (get_type(ext1) != VMBN_T_NUM || is_zero(ext1)
+        || get_type(ext2) != VMBN_T_NUM || is_zero(ext2))
+        return FALSE;
+
+    /* if the quotient is short, don't bother */
+    size_t quo_prec = get_prec(new_ext);
+    if (quo_prec < VMBN_LIMB_DIV_MIN)
+        return FALSE;
+
+    /* convert the divisor */
+    size_t max2 = (get_prec(ext2) + VMBN_LIMB_DIGITS - 1)/VMBN_LIMB_DIGITS;
+    ulong *v = limb_alloc(max2);
+    if (v == 0)
+        return FALSE;
+    size_t sig1, sig2;
+    int e1, e2;
+    size_t vn = limbs_from_ext(ext2, v, &sig2, &e2);
+
+    /* 
+     *   Figure how far to scale up the dividend so that the integer
+     *   quotient has at least one more digit than the result precision,
+     *   giving us a digit for rounding.  If the dividend has sig1 digits
+     *   and the divisor sig2, the quotient of dividend*10^s by the divisor
+     *   has at least sig1 + s - sig2 digits.  
+     */
+    for (sig1 = get_prec(ext1) ; sig1 != 0 && get_dig(ext1, sig1 - 1) == 0 ;
+         --sig1) ;
+    long s = (long)quo_prec + 1 + (long)sig2 - (long)sig1;
+    if (s < 0)
+        s = 0;
+
+    /* 
+     *   allocate the scaled dividend (with room for the scaling carry and
+     *   the normalization limb) and the quotient 
+     */
+    size_t shift = (size_t)s / VMBN_LIMB_DIGITS;
+    size_t max1 = (get_prec(ext1) + VMBN_LIMB_DIGITS - 1)/VMBN_LIMB_DIGITS;
+    size_t un = shift + max1 + 1;
+    ulong *u = limb_alloc(2*un + 2);
+    if (u == 0)
+    {
+        limb_free(v);
+        return FALSE;
+    }
+    ulong *q = u + un + 1;
+
+    /* convert the dividend, shifted up by whole limbs */
+    memset(u, 0, shift * sizeof(u[0]));
+    size_t n1 = limbs_from_ext(ext1, u + shift, &sig1, &e1);
+
+    /* scale it up by the remaining power of ten */
+    ulong mul = S_limb_pow10[s % VMBN_LIMB_DIGITS], carry = 0;
+    for (size_t i = shift ; i < shift + n1 ; ++i)
+    {
+        ulong t = u[i]*mul + carry;
+        u[i] = t % VMBN_LIMB_BASE;
+        carry = t / VMBN_LIMB_BASE;
+    }
+    u[shift + n1] = carry;
+    un = limb_len(u, shift + n1 + 1);
+
+    /* divide, and store the rounded result */
+    int ok = (un >= vn);
+    if (ok)
+    {
+        int rem = limb_div(q, u, un, v, vn);
+        limbs_to_ext(new_ext, q, un - vn + 1, e1 - e2 - (int)s, rem);
+        set_neg(new_ext, get_neg(ext1) != get_neg(ext2));
+    }
+
+    /* done with the scratch space */
+    limb_free(u);
+    limb_free(v);
+    return ok;
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Compute the product of the values into the given buffer 
@@ -2261,7 +2920,35 @@ void CVmObjBigNum::compute_prod_into(char *new_ext,
     size_t out_idx;
     size_t start_idx;
     int out_exp;
+
+    /* 
+     *   if the values are small enough, multiply them as native integers;
+     *   the operands have at most VMBN_SMALL_DIGITS digits between them,
+     *   so the product fits 
+     */
+    ulong m1, m2;
+    int e1, e2;
+    if (get_small_val(ext1, &m1, &e1) && get_small_val(ext2, &m2, &e2))
+    {
+        /* count the combined digits */
+        int n = 0;
+        ulong t;
+        for (t = m1 ; t != 0 ; t /= 10, ++n) ;
+        for (t = m2 ; t != 0 ; t /= 10, ++n) ;
+
+        /* if they fit, compute and store the product */
+        if (n <= VMBN_SMALL_DIGITS
+            && set_small_val(new_ext, m1 * m2, e1 + e2, 0))
+        {
+            set_neg(new_ext, get_neg(ext1) != get_neg(ext2));
+            return;
+        }
+    }
     
+    /* for long operands, use limb arithmetic */
+    if (compute_prod_limbs(new_ext, ext1, ext2))
+        return;
+
     /* start out with zero in the accumulator */
     memset(new_ext + VMBN_MANT, 0, (new_prec + 1)/2);
 
@@ -2429,6 +3116,13 @@ void CVmObjBigNum::compute_quotient_into(char *new_ext,
         return;
     }
 
+    /* 
+     *   for a long quotient, use limb arithmetic, unless the caller wants
+     *   the remainder, which comes from the integer-quotient mode below 
+     */
+    if (new_rem_ext == 0 && compute_quotient_limbs(new_ext, ext1, ext2))
+        return;
+
     /* 
      *   Calculate the precision we need for the running remainder.  We
      *   must retain enough precision in the remainder to calculate exact
@@ -2792,11 +3486,14 @@ done:
  *   in the whole VM global subsystem.  This last bit lets us use BigNumber
  *   calculations in the compiler, for example, which is useful for constant
  *   folding.
+ *
+ *   VM instances on different threads can't share it, though, since the
+ *   register allocator isn't synchronized, so each thread gets its own.
  */
-CVmBigNumCache *S_bignum_cache = 0;
+T3_DECL_PER_THREAD(CVmBigNumCache *, S_bignum_cache) = 0;
 
 /* number of references to the cache */
-static int S_bignum_cache_refs = 0;
+static T3_DECL_PER_THREAD(int, S_bignum_cache_refs) = 0;
 
 
 /* ------------------------------------------------------------------------ */
@@ -2819,6 +3516,11 @@ void CVmObjBigNum::term_cache()
     }
 }
 
+const vmbn_cache_stats *CVmObjBigNum::get_cache_stats()
+{
+    return S_bignum_cache->get_stats();
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Allocate a temporary register 
@@ -4134,9 +4836,13 @@ CVmBigNumCache::CVmBigNumCache(size_t max_regs)
     max_regs_ = max_regs;
 
     /* clear the list heads */
-    free_reg_ = 0;
+    memset(free_reg_, 0, sizeof(free_reg_));
     unalloc_reg_ = 0;
 
+    /* we haven't pre-allocated anything, or gathered any statistics */
+    prewarm_siz_ = 0;
+    memset(&stats_, 0, sizeof(stats_));
+
     /* we haven't actually allocated any registers yet - clear them out */
     for (p = reg_, i = max_regs ; i != 0 ; ++p, --i)
     {
@@ -4188,34 +4894,48 @@ char *CVmBigNumCache::alloc_reg(size_t siz, uint *hdl)
 {
     CVmBigNumCacheReg *p;
     CVmBigNumCacheReg *prv;
+    int b;
+
+    /* count the request */
+    ++stats_.allocs;
+    if (siz > stats_.max_siz)
+        stats_.max_siz = siz;
 
     /* 
-     *   search the free list for an available register satisfying the size
-     *   requirements 
+     *   Look for a free register that's already large enough, starting
+     *   with the bucket for this size, and moving up to larger buckets.
+     *   Every register in a bucket is at least the bucket size, so we can
+     *   take the first register in any bucket short of the last one; the
+     *   last bucket holds registers of assorted sizes, so search it.  
      */
-    for (p = free_reg_, prv = 0 ; p != 0 ; prv = p, p = p->nxt_)
+    for (b = bucket_for(siz) ; b < VMBN_CACHE_BUCKETS ; ++b)
     {
-        /* if it satisfies the size requirements, return it */
-        if (p->siz_ >= siz)
+        for (p = free_reg_[b], prv = 0 ; p != 0 ; prv = p, p = p->nxt_)
         {
-            /* unlink it from the free list */
-            if (prv == 0)
-                free_reg_ = p->nxt_;
-            else
-                prv->nxt_ = p->nxt_;
+            /* if it satisfies the size requirements, use it */
+            if (p->siz_ >= siz)
+            {
+                /* unlink it from the free list */
+                if (prv == 0)
+                    free_reg_[b] = p->nxt_;
+                else
+                    prv->nxt_ = p->nxt_;
 
-            /* it's no longer in the free list */
-            p->nxt_ = 0;
+                /* it's no longer in the free list */
+                p->nxt_ = 0;
 
-            /* return it */
-            *hdl = (uint)(p - reg_);
-            return p->buf_;
+                /* count it and return it */
+                ++stats_.hits;
+                goto found;
+            }
         }
     }
 
     /* 
      *   if there's an unallocated register, allocate it and use it;
-     *   otherwise, reallocate the smallest free register 
+     *   otherwise, reallocate the largest free register that's too small
+     *   (it's the closest to what we need, and the larger registers might
+     *   still satisfy later requests as they are) 
      */
     if (unalloc_reg_ != 0)
     {
@@ -4225,47 +4945,38 @@ char *CVmBigNumCache::alloc_reg(size_t siz, uint *hdl)
         /* unlink it from the list */
         unalloc_reg_ = unalloc_reg_->nxt_;
     }
-    else if (free_reg_ != 0)
+    else
     {
-        CVmBigNumCacheReg *min_free_p;
-        CVmBigNumCacheReg *min_free_prv = 0;
-
-        /* search for the smallest free register */
-        for (min_free_p = 0, p = free_reg_, prv = 0 ; p != 0 ;
-             prv = p, p = p->nxt_)
+        /* find the largest non-empty bucket below the one we need */
+        for (p = 0, b = bucket_for(siz) ; b >= 0 && p == 0 ; --b)
         {
-            /* if it's the smallest so far, remember it */
-            if (min_free_p == 0 || p->siz_ < min_free_p->siz_)
-            {
-                /* remember it */
-                min_free_p = p;
-                min_free_prv = prv;
-            }
+            if ((p = free_reg_[b]) != 0)
+                free_reg_[b] = p->nxt_;
         }
 
-        /* use the smallest register we found */
-        p = min_free_p;
-
-        /* unlink it from the list */
-        if (min_free_prv == 0)
-            free_reg_ = p->nxt_;
-        else
-            min_free_prv->nxt_ = p->nxt_;
-    }
-    else
-    {
-        /* there are no free registers - return failure */
-        return 0;
+        /* if there are no free registers, return failure */
+        if (p == 0)
+        {
+            ++stats_.failures;
+            return 0;
+        }
     }
 
     /* 
      *   we found a register that was either previously unallocated, or was
      *   previously allocated but was too small - allocate or reallocate the
-     *   register at the new size 
+     *   register at the full size for its bucket 
      */
-    p->alloc_mem(siz);
+    p->alloc_mem(alloc_size_for(siz));
+    p->nxt_ = 0;
+    ++stats_.grows;
+
+found:
+    /* count it as in use */
+    if (++stats_.in_use > stats_.peak_in_use)
+        stats_.peak_in_use = stats_.in_use;
 
-    /* return the new register */
+    /* return the register */
     *hdl = (uint)(p - reg_);
     return p->buf_;
 }
@@ -4275,11 +4986,11 @@ char *CVmBigNumCache::alloc_reg(size_t siz, uint *hdl)
  */
 void CVmBigNumCache::release_reg(uint hdl)
 {
-    CVmBigNumCacheReg *p = &reg_[hdl];
+    /* add the register to the free list for its size */
+    add_free(&reg_[hdl]);
 
-    /* add the register to the free list */
-    p->nxt_ = free_reg_;
-    free_reg_ = p;
+    /* it's no longer in use */
+    --stats_.in_use;
 }
 
 /*
@@ -4289,9 +5000,63 @@ void CVmBigNumCache::release_all()
 {
     size_t i;
 
-    /* mark each of our registers as not in use */
+    /* clear the lists */
+    memset(free_reg_, 0, sizeof(free_reg_));
+    unalloc_reg_ = 0;
+
+    /* 
+     *   put each register back in the free list for its size, or in the
+     *   unallocated list if it's never been allocated 
+     */
     for (i = 0 ; i < max_regs_ ; ++i)
-        release_reg(i);
+    {
+        CVmBigNumCacheReg *p = &reg_[i];
+        if (p->buf_ == 0)
+        {
+            p->nxt_ = unalloc_reg_;
+            unalloc_reg_ = p;
+        }
+        else
+            add_free(p);
+    }
+
+    /* nothing is in use now */
+    stats_.in_use = 0;
+}
+
+/*
+ *   Pre-allocate registers of a given size 
+ */
+void CVmBigNumCache::prewarm(size_t siz)
+{
+    size_t i;
+
+    /* if we've already done this at this size or larger, we're set */
+    siz = alloc_size_for(siz);
+    if (siz <= prewarm_siz_)
+        return;
+
+    /* note the new size */
+    prewarm_siz_ = siz;
+
+    /* 
+     *   Allocate registers of this size, holding each one so that the next
+     *   allocation gets a different register; then release them all.  We
+     *   can't just call release_all(), since other registers might be in
+     *   use.  Don't count these allocations in the statistics, since they
+     *   don't represent real work.  
+     */
+    vmbn_cache_stats saved = stats_;
+    uint hdl[VMBN_CACHE_PREWARM];
+    for (i = 0 ; i < VMBN_CACHE_PREWARM ; ++i)
+    {
+        if (alloc_reg(siz, &hdl[i]) == 0)
+            break;
+    }
+    while (i != 0)
+        release_reg(hdl[--i]);
+    stats_ = saved;
 }
 
 
+
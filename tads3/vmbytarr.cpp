@@ -247,7 +247,8 @@ int (CVmObjByteArray::
     &CVmObjByteArray::getp_packBytes,                                  /* 8 */
     &CVmObjByteArray::getp_unpackBytes,                                /* 9 */
     &CVmObjByteArray::getp_sha256,                                    /* 10 */
-    &CVmObjByteArray::getp_digestMD5                                  /* 11 */
+    &CVmObjByteArray::getp_digestMD5,                                 /* 11 */
+    &CVmObjByteArray::getp_find                                       /* 12 */
 };
 
 /* static property indices */
@@ -557,6 +558,18 @@ void CVmObjByteArray::alloc_array(VMG_ unsigned long ele_count)
     size_t alloc_size;
     size_t i;
     
+    /* 
+     *   if the array is small enough, store it contiguously in the
+     *   extension, right after the element count 
+     */
+    if (ele_count <= VMBYTARR_CONTIG_MAX)
+    {
+        ext_ = (char *)G_mem->get_var_heap()->alloc_mem(
+            (size_t)(4 + ele_count), this);
+        set_element_count(ele_count);
+        return;
+    }
+
     /* 
      *   figure out how many first-level page tables we need - each
      *   first-level page table refers to 256M bytes (8k pages per
@@ -637,10 +650,15 @@ void CVmObjByteArray::notify_delete(VMG_ int /*in_root_set*/)
     if (ext_ == 0)
         return;
 
+    /* a contiguous array is entirely within the extension */
+    if (is_contiguous())
+    {
+        G_mem->get_var_heap()->free_mem(ext_);
+        return;
+    }
+
     /* calculate the number of second-level page table slots */
-    slot_cnt = (size_t)(get_element_count() == 0
-                        ? 0
-                        : ((get_element_count() >> 28) + 1));
+    slot_cnt = (size_t)(((get_element_count() - 1) >> 28) + 1);
 
     /* we have all of the bytes in the array left do delete */
     bytes_rem = get_element_count();
@@ -1266,7 +1284,12 @@ uint CVmObjByteArray::calc_hash(VMG_ vm_obj_id_t self, int /*depth*/) const
         idx += chunk;
         rem -= chunk;
 
-        /* add up the bytes in this part */
+        /* add up the bytes in this part, eight at a time */
+        for ( ; chunk >= 8 ; chunk -= 8, p += 8)
+            hash += (uint)p[0] + p[1] + p[2] + p[3]
+                    + p[4] + p[5] + p[6] + p[7];
+
+        /* add the odd bytes at the end of the chunk */
         for ( ; chunk != 0 ; --chunk, ++p)
             hash += *p;
     }
@@ -1434,18 +1457,12 @@ void CVmObjByteArray::move_bytes(unsigned long dst_idx,
         src_idx += cnt;
         dst_idx += cnt;
 
-        /* get the chunk pointers */
-        srcp = get_ele_ptr(src_idx - 1, &src_avail) + 1;
-        dstp = get_ele_ptr(dst_idx - 1, &dst_avail) + 1;
-
         /* 
-         *   since we're working backwards, we actually want to know the
-         *   number of bytes on the page *before* the current pointers, so
-         *   subtract the available spaces from the size of the page to get
-         *   the available space preceding each 
+         *   get the chunk pointers - since we're working backwards, we want
+         *   to know the number of bytes *before* the current pointers 
          */
-        src_avail = 32*1024 - src_avail + 1;
-        dst_avail = 32*1024 - dst_avail + 1;
+        srcp = get_ele_end_ptr(src_idx - 1, &src_avail);
+        dstp = get_ele_end_ptr(dst_idx - 1, &dst_avail);
 
         /* keep going until we've moved all of the requested bytes */
         while (cnt != 0)
@@ -1481,17 +1498,11 @@ void CVmObjByteArray::move_bytes(unsigned long dst_idx,
 
             /* if we've exhausted the source chunk, get the next one */
             if (src_avail == 0)
-            {
-                srcp = get_ele_ptr(src_idx - 1, &src_avail) + 1;
-                src_avail = 32*1024 - src_avail + 1;
-            }
+                srcp = get_ele_end_ptr(src_idx - 1, &src_avail);
 
             /* if we've exhausted the destination chunk, get the next one */
             if (dst_avail == 0)
-            {
-                dstp = get_ele_ptr(dst_idx - 1, &dst_avail) + 1;
-                dst_avail = 32*1024 - dst_avail + 1;
-            }
+                dstp = get_ele_end_ptr(dst_idx - 1, &dst_avail);
         }
     }
 }
@@ -1753,6 +1764,185 @@ int CVmObjByteArray::getp_fill_val(VMG_ vm_obj_id_t self,
     return TRUE;
 }
 
+/* 
+ *   property evaluator - find a byte or byte sequence 
+ */
+int CVmObjByteArray::getp_find(VMG_ vm_obj_id_t self,
+                               vm_val_t *retval, uint *in_argc)
+{
+    uint argc = (in_argc != 0 ? *in_argc : 0);
+    static CVmNativeCodeDesc desc(1, 1);
+    unsigned char bytebuf;
+    unsigned char *pat;
+    size_t patlen;
+    int pat_alloced = FALSE;
+    unsigned long idx;
+    unsigned long found;
+
+    /* check arguments */
+    if (get_prop_check_argc(retval, in_argc, &desc))
+        return TRUE;
+
+    /* get the starting index, if provided, leaving the target on the stack */
+    idx = 1;
+    if (argc >= 2)
+    {
+        long l = G_stk->get(1)->num_to_int(vmg0_);
+        idx = (l < 1 ? 1 : (unsigned long)l);
+    }
+
+    /* get the target - a single byte value or another byte array */
+    const vm_val_t *val = G_stk->get(0);
+    if (val->typ == VM_INT)
+    {
+        /* it's a single byte - make sure it's in range */
+        if (val->val.intval < 0 || val->val.intval > 255)
+            err_throw(VMERR_OUT_OF_RANGE);
+
+        /* search for the one-byte sequence */
+        bytebuf = (unsigned char)val->val.intval;
+        pat = &bytebuf;
+        patlen = 1;
+    }
+    else if (val->typ == VM_OBJ && is_byte_array(vmg_ val->val.obj))
+    {
+        /* get the other array */
+        CVmObjByteArray *arr = (CVmObjByteArray *)vm_objp(vmg_ val->val.obj);
+        size_t avail;
+
+        /* 
+         *   if the whole sequence is on one page, search for it in place;
+         *   otherwise make a contiguous copy 
+         */
+        patlen = (size_t)arr->get_element_count();
+        pat = (patlen != 0 ? arr->get_ele_ptr(1, &avail) : 0);
+        if (patlen != 0 && avail < patlen)
+        {
+            pat = (unsigned char *)t3malloc(patlen);
+            pat_alloced = TRUE;
+            if (pat == 0)
+                err_throw(VMERR_OUT_OF_MEMORY);
+            arr->copy_to_buf(pat, 1, patlen);
+        }
+    }
+    else
+    {
+        /* other types aren't allowed */
+        err_throw(VMERR_BAD_TYPE_BIF);
+    }
+
+    /* do the search */
+    found = find_bytes(pat, patlen, idx);
+
+    /* if we allocated a copy of the sequence, free it */
+    if (pat_alloced)
+        t3free(pat);
+
+    /* discard the arguments */
+    G_stk->discard(argc);
+
+    /* return the index of the match, or nil if there's no match */
+    if (found != 0)
+        retval->set_int(found);
+    else
+        retval->set_nil();
+
+    /* handled */
+    return TRUE;
+}
+
+/*
+ *   Search for a byte sequence, starting at the given (1-based) index.
+ *   Returns the index of the first match, or zero if there's no match.  
+ */
+unsigned long CVmObjByteArray::find_bytes(const unsigned char *pat,
+                                          size_t patlen,
+                                          unsigned long idx) const
+{
+    unsigned long cnt = get_element_count();
+    unsigned long last;
+
+    /* an empty sequence matches at the starting index, if it's in range */
+    if (patlen == 0)
+        return (idx <= cnt + 1 ? idx : 0);
+
+    /* if the sequence is longer than the array, it can't match */
+    if (patlen > cnt)
+        return 0;
+
+    /* figure the last index where a match could start */
+    last = cnt - patlen + 1;
+
+    /* 
+     *   Scan a page at a time for the first byte of the sequence, using
+     *   memchr() to do the scanning (the C library's version is generally
+     *   much faster than a byte loop), and check for the rest of the
+     *   sequence at each candidate position.  
+     */
+    while (idx <= last)
+    {
+        size_t avail;
+        unsigned char *p;
+        unsigned char *q;
+
+        /* get the next page, limited to the remaining candidate positions */
+        p = get_ele_ptr(idx, &avail);
+        if (avail > last - idx + 1)
+            avail = (size_t)(last - idx + 1);
+
+        /* look for the first byte on this page */
+        q = (unsigned char *)memchr(p, pat[0], avail);
+        if (q == 0)
+        {
+            /* not on this page - move on to the next one */
+            idx += avail;
+            continue;
+        }
+
+        /* if the rest of the sequence matches here, we've found it */
+        idx += (unsigned long)(q - p);
+        if (patlen == 1 || match_bytes(idx + 1, pat + 1, patlen - 1))
+            return idx;
+
+        /* no match here - resume the scan at the next byte */
+        ++idx;
+    }
+
+    /* didn't find it */
+    return 0;
+}
+
+/*
+ *   Compare the bytes at the given (1-based) index to a buffer.  The
+ *   caller must make sure the range is within the array. 
+ */
+int CVmObjByteArray::match_bytes(unsigned long idx,
+                                 const unsigned char *buf, size_t len) const
+{
+    while (len != 0)
+    {
+        size_t avail;
+        unsigned char *p;
+
+        /* get the next chunk, limited to the remaining length */
+        p = get_ele_ptr(idx, &avail);
+        if (avail > len)
+            avail = len;
+
+        /* if this chunk differs, the ranges differ */
+        if (memcmp(p, buf, avail) != 0)
+            return FALSE;
+
+        /* advance past the chunk */
+        buf += avail;
+        idx += avail;
+        len -= avail;
+    }
+
+    /* we found no differences */
+    return TRUE;
+}
+
 /* 
  *   property evaluator - convert to string 
  */
@@ -2629,7 +2819,8 @@ int CVmObjByteArray::getp_digestMD5(
         /* feed this chunk into the hash */
         md5_append(&ctx, p, cur);
 
-        /* deduct this chunk from the remaining length */
+        /* advance past this chunk */
+        idx += cur;
         len -= cur;
     }
 
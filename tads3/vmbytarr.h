@@ -63,7 +63,26 @@ Modified
  *   the page) as i%32k.  The byte is then accessed as
  *   
  *   page[s1][s2][s3] 
+ *   
+ *   The page tables are only needed for very large arrays.  An array of
+ *   up to VMBYTARR_CONTIG_MAX bytes is stored contiguously, directly in
+ *   the extension after the element count:
+ *   
+ *   UINT4 number of elements
+ *.  BYTE bytes[1..number_of_elements]
+ *   
+ *   The element count never changes after the array is allocated, so the
+ *   count alone tells us which layout an array uses.  
  */
+
+/* 
+ *   Largest array we store contiguously.  Larger arrays use page tables,
+ *   so that we never have to find a single huge block of memory.  
+ */
+#ifndef VMBYTARR_CONTIG_MAX
+#define VMBYTARR_CONTIG_MAX  (4UL*1024*1024)
+#endif
+
 class CVmObjByteArray: public CVmObject
 {
     friend class CVmMetaclassByteArray;
@@ -143,6 +162,12 @@ public:
 
     /* notify of deletion */
     void notify_delete(VMG_ int in_root_set);
+    /* report our memory use, including the pages of a large array */
+    size_t get_mem_usage(VMG_ int) const
+    {
+        return get_ext_heap_bytes(vmg0_)
+            + (is_contiguous() ? 0 : (size_t)get_element_count());
+    }
 
     /* set a property */
     void set_prop(VMG_ class CVmUndo *undo,
@@ -211,6 +236,8 @@ public:
     unsigned char get_element(unsigned long idx) const
     {
         size_t avail;
+        if (is_contiguous())
+            return get_contig_ptr()[idx - 1];
         return *get_ele_ptr(idx, &avail);
     }
 
@@ -340,6 +367,9 @@ protected:
     /* property evaluator - digestMD5 */
     int getp_digestMD5(VMG_ vm_obj_id_t self, vm_val_t *val, uint *argc);
 
+    /* property evaluator - find a byte or byte sequence */
+    int getp_find(VMG_ vm_obj_id_t self, vm_val_t *val, uint *argc);
+
     /* 
      *   Given a 1-based index, get a pointer to the byte at the index, and
      *   the number of contiguous bytes available starting with that byte.
@@ -355,6 +385,16 @@ protected:
         size_t s2;
         size_t s3;
 
+        /* 
+         *   if the array is contiguous, the rest of the array is available
+         *   starting at the byte 
+         */
+        if (is_contiguous())
+        {
+            *bytes_avail = (size_t)(get_element_count() + 1 - idx);
+            return get_contig_ptr() + idx - 1;
+        }
+
         /* convert to a zero-based index */
         --idx;
         
@@ -391,6 +431,41 @@ protected:
         return get_page_table_ptr(s1)[s2] + s3;
     }
 
+    /*
+     *   Given a 1-based index, get a pointer just past the byte at the
+     *   index, and the number of contiguous bytes ending there (including
+     *   the byte at the index).  This is the mirror image of get_ele_ptr(),
+     *   for working backwards through the array.  
+     */
+    unsigned char *get_ele_end_ptr(unsigned long idx,
+                                   size_t *bytes_before) const
+    {
+        size_t avail;
+
+        /* in a contiguous array, everything up to the index precedes it */
+        if (is_contiguous())
+        {
+            *bytes_before = (size_t)idx;
+            return get_contig_ptr() + idx;
+        }
+
+        /* 
+         *   get the byte's page - the bytes preceding it on the page are
+         *   the full page size less the bytes following it 
+         */
+        unsigned char *p = get_ele_ptr(idx, &avail) + 1;
+        *bytes_before = 32*1024 - avail + 1;
+        return p;
+    }
+
+    /* is the array stored contiguously? */
+    int is_contiguous() const
+        { return get_element_count() <= VMBYTARR_CONTIG_MAX; }
+
+    /* get a pointer to the bytes of a contiguous array */
+    unsigned char *get_contig_ptr() const
+        { return (unsigned char *)ext_ + 4; }
+
     /*
      *   Given a page table selector, return a pointer to the selected page
      *   table.  
@@ -418,6 +493,17 @@ protected:
                    CVmObjByteArray *src_arr,
                    unsigned long src_start_idx, unsigned long cnt);
 
+    /* 
+     *   search for a byte sequence starting at the given 1-based index;
+     *   returns the index of the first match, or zero if there's no match 
+     */
+    unsigned long find_bytes(const unsigned char *pat, size_t patlen,
+                             unsigned long start_idx) const;
+
+    /* compare the bytes starting at the given index to a buffer */
+    int match_bytes(unsigned long idx,
+                    const unsigned char *buf, size_t len) const;
+
     /* move bytes within this array */
     void move_bytes(unsigned long dst_idx, unsigned long src_idx,
                     unsigned long cnt);
@@ -452,7 +538,7 @@ class CVmMetaclassByteArray: public CVmMetaclass
 {
 public:
     /* get the global name */
-    const char *get_meta_name() const { return "bytearray/030002"; }
+    const char *get_meta_name() const { return "bytearray/030003"; }
 
     /* create from image file */
     void create_for_image_load(VMG_ vm_obj_id_t id)
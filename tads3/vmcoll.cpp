@@ -30,6 +30,8 @@ Modified
 #include "vmmeta.h"
 #include "vmstack.h"
 #include "vmrun.h"
+#include "vmop.h"
+#include "vmiter.h"
 
 
 /* ------------------------------------------------------------------------ */
@@ -119,8 +121,28 @@ int CVmObjCollection::getp_create_iter(VMG_ vm_val_t *retval,
     /* push a self-reference for gc protection */
     G_stk->push(self_val);
 
-    /* create the iterator */
-    new_iterator(vmg_ retval, self_val);
+    /*
+     *   If this call is initializing a foreach loop, and the loop's
+     *   iterator local still holds the iterator from an earlier run of the
+     *   same loop, reset that iterator rather than creating a new one.
+     *   Nested loops would otherwise create a new iterator object on every
+     *   pass through the inner loop.  
+     */
+    vm_val_t *iter_lcl = get_foreach_iter_local(vmg0_);
+    if (iter_lcl != 0 && reset_iterator(vmg_ iter_lcl, self_val))
+    {
+        /* recycled - return the same iterator */
+        *retval = *iter_lcl;
+    }
+    else
+    {
+        /* create the iterator */
+        new_iterator(vmg_ retval, self_val);
+
+        /* if it's for a foreach loop, note that we can recycle it */
+        if (iter_lcl != 0)
+            CVmObjIterIdx::mark_foreach(vmg_ retval);
+    }
 
     /* discard the gc protection */
     G_stk->discard();
@@ -129,6 +151,87 @@ int CVmObjCollection::getp_create_iter(VMG_ vm_val_t *retval,
     return TRUE;
 }
 
+/*
+ *   Get the iterator local of the foreach loop that the current instruction
+ *   is initializing, if any.  The compiler generates the loop initializer as
+ *   a createIterator() property call, followed by a store of the result
+ *   into a hidden local, followed immediately by the ITERNEXT at the top of
+ *   the loop, which reads the same local.  ITERNEXT is only ever generated
+ *   for foreach loops, so if we find the whole sequence, the local is one
+ *   that user code can't otherwise reach.  
+ */
+vm_val_t *CVmObjCollection::get_foreach_iter_local(VMG0_)
+{
+    /* get the current instruction; give up if we're not in byte code */
+    const uchar *p = G_interpreter->get_last_pc();
+    if (p == 0)
+        return 0;
+
+    /* it has to be one of the property call or evaluation instructions */
+    switch (*p)
+    {
+    case OPC_GETPROP:
+    case OPC_GETPROPDATA:
+    case OPC_GETPROPLCL1:
+    case OPC_GETPROPR0:
+    case OPC_GETPROPSELF:
+    case OPC_OBJGETPROP:
+    case OPC_CALLPROP:
+    case OPC_CALLPROPLCL1:
+    case OPC_CALLPROPR0:
+    case OPC_CALLPROPSELF:
+    case OPC_OBJCALLPROP:
+        break;
+
+    default:
+        return 0;
+    }
+
+    /* 
+     *   in all of these, the property ID is the last operand - make sure
+     *   it's Collection.createIterator 
+     */
+    p += CVmOpcodes::get_op_size(p);
+    if (G_meta_table->prop_to_vector_idx(
+        metaclass_reg_->get_reg_idx(), (vm_prop_id_t)osrp2(p - 2)) != 1)
+        return 0;
+
+    /* the result has to be stored in a local */
+    uint lcl;
+    switch (*p)
+    {
+    case OPC_SETLCL1R0:
+        lcl = p[1];
+        p += 2;
+        break;
+
+    case OPC_GETR0:
+        if (p[1] == OPC_SETLCL1)
+        {
+            lcl = p[2];
+            p += 3;
+        }
+        else if (p[1] == OPC_SETLCL2)
+        {
+            lcl = osrp2(p + 2);
+            p += 4;
+        }
+        else
+            return 0;
+        break;
+
+    default:
+        return 0;
+    }
+
+    /* the next instruction has to be the ITERNEXT for the same local */
+    if (*p != OPC_ITERNEXT || osrp2(p + 1) != lcl)
+        return 0;
+
+    /* it's a foreach initializer - return the iterator local */
+    return G_interpreter->get_local(vmg_ lcl);
+}
+
 /*
  *   Create a live iterator 
  */
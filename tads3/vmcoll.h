@@ -89,6 +89,22 @@ protected:
     virtual void new_live_iterator(VMG_ vm_val_t *retval,
                                    const vm_val_t *self_val) = 0;
 
+    /*
+     *   Reset an existing foreach loop iterator to iterate over this
+     *   collection, as though new_iterator() had just created it.  Returns
+     *   false if the iterator can't be reused, in which case the caller
+     *   creates a new one.  By default, we never reuse iterators.  
+     */
+    virtual int reset_iterator(VMG_ const vm_val_t * /*iter*/,
+                               const vm_val_t * /*self_val*/)
+        { return FALSE; }
+
+    /* 
+     *   If the current instruction is the createIterator() call that
+     *   initializes a foreach loop, get the loop's iterator local.  
+     */
+    static vm_val_t *get_foreach_iter_local(VMG0_);
+
     /* property evaluator - undefined property */
     int getp_undef(VMG_ vm_val_t *, const vm_val_t *, uint *)
         { return FALSE; }
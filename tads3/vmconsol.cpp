@@ -52,6 +52,9 @@ Modified
 #include "vmfilobj.h"
 #include "vmerr.h"
 #include "vmobj.h"
+#include "vmstrbuf.h"
+#include "vmrun.h"
+#include "vmreplay.h"
 
 
 /* ------------------------------------------------------------------------ */
@@ -188,6 +191,9 @@ int CVmFormatterLog::close_log_file(VMG0_)
     /* if we have a file, close it */
     if (logfp_ != 0)
     {
+        /* write out anything still in the buffer */
+        write_log_buf();
+
         /* close and forget the handle */
         osfcls(logfp_);
         logfp_ = 0;
@@ -219,6 +225,64 @@ int CVmFormatterLog::close_log_file(VMG0_)
     return err;
 }
 
+/*
+ *   Display text to the log file.  We collect the text in our output
+ *   buffer, so that we write to the file in large chunks rather than for
+ *   every line. 
+ */
+void CVmFormatterLog::print_to_os(const char *txt, size_t len)
+{
+    /* if there's no log file, there's nowhere to write the text */
+    if (logfp_ == 0)
+        return;
+
+    /* allocate the buffer if we haven't already */
+    if (logbuf_ == 0)
+        logbuf_ = (char *)t3malloc(VMCON_LOGBUF_SIZE);
+
+    /* if the text won't fit in the buffer, make room */
+    if (logbuf_len_ + len > VMCON_LOGBUF_SIZE)
+        write_log_buf();
+
+    /* 
+     *   if we have no buffer, or the text is too large to buffer even
+     *   after emptying it, write it directly 
+     */
+    if (logbuf_ == 0 || len > VMCON_LOGBUF_SIZE)
+    {
+        os_fprint(logfp_, txt, len);
+        return;
+    }
+
+    /* add the text to the buffer */
+    memcpy(logbuf_ + logbuf_len_, txt, len);
+    logbuf_len_ += len;
+}
+
+/*
+ *   Flush the log file.  The formatter calls this whenever it flushes
+ *   without a newline, which includes stopping for input, so the log file
+ *   is up to date whenever the game waits for the player. 
+ */
+void CVmFormatterLog::flush_to_os()
+{
+    if (logfp_ != 0)
+    {
+        write_log_buf();
+        osfflush(logfp_);
+    }
+}
+
+/*
+ *   Write out the buffered text 
+ */
+void CVmFormatterLog::write_log_buf()
+{
+    if (logbuf_len_ != 0 && logfp_ != 0)
+        os_fprint(logfp_, logbuf_, logbuf_len_);
+    logbuf_len_ = 0;
+}
+
 
 /* ------------------------------------------------------------------------ */
 /*
@@ -270,9 +334,11 @@ void CVmFormatter::write_text(VMG_ const wchar_t *txt, size_t cnt,
      */
     if (!console_->is_quiet_script() || !is_disp_stream_)
     {
-        char local_buf[128];
+        char local_buf[1024];
         char *dst;
         size_t rem;
+        CCharmapToLocal *cm = (cmap_ != 0 ? cmap_ : G_cmap_to_ui);
+        int utf8 = cm->is_utf8();
 
         /*
          *   Check to see if we've reached the end of the screen, and if so
@@ -327,7 +393,7 @@ void CVmFormatter::write_text(VMG_ const wchar_t *txt, size_t cnt,
                  *   old color and attributes
                  */
                 *dst = '\0';
-                print_to_os(local_buf);
+                print_to_os(local_buf, dst - local_buf);
 
                 /* reset to the start of the local output buffer */
                 dst = local_buf;
@@ -361,9 +427,24 @@ void CVmFormatter::write_text(VMG_ const wchar_t *txt, size_t cnt,
             if (!html_target_ && c == 0x00A0)
                 c = ' ';
 
-            /* try storing another character */
+            /* 
+             *   Try storing another character.  If the local character set
+             *   is UTF-8, we can simply encode the character ourselves
+             *   rather than calling the mapper for each character. 
+             */
             old_rem = rem;
-            cur = (cmap_ != 0 ? cmap_ : G_cmap_to_ui)->map(c, &dst, &rem);
+            if (utf8)
+            {
+                cur = utf8_ptr::s_wchar_size(c);
+                if (cur <= rem)
+                {
+                    utf8_ptr::s_putch(dst, c);
+                    dst += cur;
+                    rem -= cur;
+                }
+            }
+            else
+                cur = cm->map(c, &dst, &rem);
 
             /* if that failed, flush the buffer and try again */
             if (cur > old_rem)
@@ -372,7 +453,7 @@ void CVmFormatter::write_text(VMG_ const wchar_t *txt, size_t cnt,
                 *dst = '\0';
                 
                 /* display the text */
-                print_to_os(local_buf);
+                print_to_os(local_buf, dst - local_buf);
 
                 /* reset to the start of the local output buffer */
                 dst = local_buf;
@@ -393,7 +474,7 @@ void CVmFormatter::write_text(VMG_ const wchar_t *txt, size_t cnt,
         {
             /* null-terminate and display the buffer */
             *dst = '\0';
-            print_to_os(local_buf);
+            print_to_os(local_buf, dst - local_buf);
         }
 
         /* write the appropriate type of line termination */
@@ -1676,6 +1757,88 @@ void CVmFormatter::buffer_rendered(wchar_t c, unsigned char flags, int wid)
     }
 }
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Buffer a run of plain ASCII text.  For printable ASCII characters other
+ *   than the markup-start characters, buffer_expchar() only tracks the HTML
+ *   lexical state (which stays at plain text), consolidates whitespace, and
+ *   adds the character to the line if it fits.  Most output consists of
+ *   long stretches of such characters, so we do that work here for the
+ *   whole run, without going through the full character-by-character
+ *   state machine for each one.  
+ */
+wchar_t CVmFormatter::buffer_plain_run(VMG_ wchar_t c,
+                                       const char **s, size_t *slen)
+{
+    CCharmapToLocal *cm = (cmap_ != 0 ? cmap_ : G_cmap_to_ui);
+    int maxcol = get_buffer_maxcol();
+    int plain_spaces = (!obey_whitespace_ && html_pre_level_ == 0);
+    const char *p = *s;
+    const char *endp = p + *slen;
+    size_t exp_len;
+
+    for (;;)
+    {
+        /* markup goes back to the caller, which has already consumed it */
+        if (c == '<' || c == '&')
+        {
+            *slen = endp - p;
+            *s = p;
+            return c;
+        }
+
+        /* 
+         *   If the character has a display expansion, doesn't fit on the
+         *   line, or is a space that we can't simply consolidate, buffer it
+         *   the long way.  That can flush the line, so don't assume
+         *   anything about our state afterwards - just go back to the
+         *   caller with the next character.  
+         */
+        if ((c == ' ' && !plain_spaces)
+            || linecol_ + 1 >= maxcol
+            || cm->get_expansion(c, &exp_len) != 0)
+        {
+            buffer_char(vmg_ c);
+            *slen = endp - p;
+            *s = p;
+            return next_wchar(s, slen);
+        }
+
+        /* 
+         *   ignore ordinary whitespace at the start of a line, and combine
+         *   it with a preceding space; buffer anything else 
+         */
+        if (c != ' '
+            || (linecol_ != 0
+                && (linepos_ == 0 || linebuf_[linepos_ - 1] != ' ')))
+        {
+            linebuf_[linepos_] = c;
+            flagbuf_[linepos_] = cur_flags_;
+            colorbuf_[linepos_] = cur_color_;
+            ++linepos_;
+            ++linecol_;
+        }
+
+        /* we're in plain text in the underlying HTML stream */
+        if (html_target_)
+            html_passthru_state_ = VMCON_HPS_NORMAL;
+
+        /* 
+         *   Get the next character.  Printable ASCII characters are single
+         *   bytes in UTF-8, so we can read them directly; at anything else,
+         *   including the end of the string, go back to decoding UTF-8 and
+         *   let the caller take it from there. 
+         */
+        if (p == endp || (unsigned char)*p < ' ' || (unsigned char)*p > '~')
+        {
+            *slen = endp - p;
+            *s = p;
+            return next_wchar(s, slen);
+        }
+        c = (unsigned char)*p++;
+    }
+}
+
 /* ------------------------------------------------------------------------ */
 /* 
  *   write out a UTF-8 string
@@ -1757,6 +1920,18 @@ int CVmFormatter::format_text(VMG_ const char *s, size_t slen)
             continue;
         }
 
+        /* 
+         *   if we're at the start of a run of plain text, and nothing about
+         *   our state requires looking at each character individually,
+         *   buffer the whole run at once 
+         */
+        if (c >= ' ' && c <= '~' && c != '<' && c != '&'
+            && can_buffer_plain_run())
+        {
+            c = buffer_plain_run(vmg_ c, &s, &slen);
+            continue;
+        }
+
         /* check for special characters */
         switch(c)
         {
@@ -1897,12 +2072,25 @@ CVmConsole::CVmConsole()
     command_nf_ = 0;
     command_glob_ = 0;
 
+    /* no output captures yet */
+    memset(capture_glob_, 0, sizeof(capture_glob_));
+    capture_depth_ = 0;
+
     /* assume we'll double-space after each period */
     doublespace_ = TRUE;
 
     /* presume we'll have no log stream */
     log_str_ = 0;
     log_enabled_ = FALSE;
+
+    /* no input yet */
+    old_more_mode_ = FALSE;
+    read_in_progress_ = FALSE;
+    read_buf_[0] = '\0';
+
+    /* we haven't seen the command prompt yet */
+    autosave_pending_ = FALSE;
+    cmd_read_depth_ = ~(size_t)0;
 }
 
 /*
@@ -1931,6 +2119,24 @@ void CVmConsole::delete_obj(VMG0_)
  */
 int CVmConsole::format_text(VMG_ const char *p, size_t len)
 {
+    /* if we're capturing output, send it to the capture instead */
+    if (capture_depth_ != 0)
+    {
+        int i = capture_depth_ - 1;
+        const vm_val_t *buf = &capture_glob_[i]->val;
+
+        /* count the characters */
+        capture_cnt_[i] += utf8_ptr::s_len(p, len);
+
+        /* if there's a buffer, append the text to it */
+        if (buf->typ == VM_OBJ)
+            ((CVmObjStringBuffer *)vm_objp(vmg_ buf->val.obj))
+                ->append_utf8(vmg_ buf->val.obj, p, len);
+
+        /* that's all we do with captured text */
+        return 0;
+    }
+
     /* display the string */
     disp_str_->format_text(vmg_ p, len);
 
@@ -1955,6 +2161,52 @@ int CVmConsole::format_text_to_log(VMG_ const char *p, size_t len)
     return 0;
 }
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Begin an output capture 
+ */
+int CVmConsole::begin_capture(VMG_ vm_obj_id_t buf)
+{
+    /* make sure we have room for another level */
+    if (capture_depth_ >= VMCON_CAPTURE_MAX)
+        return 1;
+
+    /* create the global for this level if we haven't already */
+    int i = capture_depth_;
+    if (capture_glob_[i] == 0)
+        capture_glob_[i] = G_obj_table->create_global_var();
+
+    /* remember the buffer, and start the count at zero */
+    if (buf != VM_INVALID_OBJ)
+        capture_glob_[i]->val.set_obj(buf);
+    else
+        capture_glob_[i]->val.set_nil();
+    capture_cnt_[i] = 0;
+
+    /* the new level is now in effect */
+    ++capture_depth_;
+
+    /* success */
+    return 0;
+}
+
+/*
+ *   End the current output capture 
+ */
+long CVmConsole::end_capture(VMG0_)
+{
+    /* if there's no capture in effect, say so */
+    if (capture_depth_ == 0)
+        return -1;
+
+    /* pop the level, and forget its buffer so that it can be collected */
+    int i = --capture_depth_;
+    capture_glob_[i]->val.set_nil();
+
+    /* return the character count */
+    return capture_cnt_[i];
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Set the text color 
@@ -2352,6 +2604,13 @@ int CVmConsole::close_script_file(VMG0_)
         /* pop the stack */
         script_sp_ = e->enc;
 
+        /* 
+         *   if that was the outermost script, the replay is over, so write
+         *   the replay statistics, if we're collecting them 
+         */
+        if (script_sp_ == 0)
+            vm_replay_stats_stop(vmg0_);
+
         /* restore the enclosing level's MORE mode */
         os_nonstop_mode(!e->old_more_mode);
 
@@ -2760,22 +3019,6 @@ void CVmConsole::log_event(VMG_ const char *tag,
 }
 
 /* ------------------------------------------------------------------------ */
-/*
- *   Static variables for input state.  We keep these statically, because we
- *   might need to use the values across a series of read_line_timeout calls
- *   if timeouts occur. 
- */
-
-/* original 'more' mode, before input began */
-static int S_old_more_mode;
-
-/* flag: input is pending from an interrupted read_line_timeout invocation */
-static int S_read_in_progress;
-
-/* local buffer for reading input lines */
-static char S_read_buf[256];
-
-
 /*
  *   Read a line of input from the console, with an optional timeout value. 
  */
@@ -2797,19 +3040,19 @@ int CVmConsole::read_line_timeout(VMG_ char *buf, size_t buflen,
     int echo_text = FALSE;
 
     /* remember the initial MORE mode */
-    S_old_more_mode = is_more_mode();
+    old_more_mode_ = is_more_mode();
 
     /*
      *   If we're not resuming an interrupted read already in progress,
      *   initialize some display settings. 
      */
-    if (!S_read_in_progress)
+    if (!read_in_progress_)
     {
         /* 
          *   Turn off MORE mode if it's on - we don't want a MORE prompt
          *   showing up in the midst of user input.  
          */
-        S_old_more_mode = set_more_state(FALSE);
+        old_more_mode_ = set_more_state(FALSE);
 
         /* 
          *   flush the output; don't start a new line, since we might have
@@ -2830,11 +3073,14 @@ int CVmConsole::read_line_timeout(VMG_ char *buf, size_t buflen,
         int was_quiet = script_sp_->quiet;
         
         /* try reading a line from the script file */
-        if (read_line_from_script(S_read_buf, sizeof(S_read_buf), &evt))
+        if (read_line_from_script(read_buf_, sizeof(read_buf_), &evt))
         {
             /* we successfully read input from the script */
             got_script_input = TRUE;
 
+            /* if we're timing the replay, a new command starts here */
+            vm_replay_stats_command(vmg_ read_buf_);
+
             /*
              *   if we're not in quiet mode, make a note to echo the text to
              *   the display 
@@ -2853,7 +3099,7 @@ int CVmConsole::read_line_timeout(VMG_ char *buf, size_t buflen,
              *   when we restore the enclosing MORE mode so that we restore
              *   the pre-script MORE mode when we return.  
              */
-            S_old_more_mode = close_script_file(vmg0_);
+            old_more_mode_ = close_script_file(vmg0_);
             
             /* note the new 'quiet' mode */
             int is_quiet = (script_sp_ != 0 && script_sp_->quiet);
@@ -2888,7 +3134,7 @@ int CVmConsole::read_line_timeout(VMG_ char *buf, size_t buflen,
             if (was_quiet && !is_quiet)
             {
                 /* return to the old MORE mode */
-                set_more_state(S_old_more_mode);
+                set_more_state(old_more_mode_);
                 
                 /* add a blank line to the log file, if necessary */
                 if (log_enabled_)
@@ -2928,8 +3174,21 @@ int CVmConsole::read_line_timeout(VMG_ char *buf, size_t buflen,
     if (script_sp_ == 0)
         reset_line_count(FALSE);
     
+    /* 
+     *   If this is a fresh read (rather than one resumed after a timeout),
+     *   note whether it's at the command prompt, so that the host can take
+     *   an autosave while it waits for the line.  
+     */
+    if (!read_in_progress_)
+    {
+        size_t depth = G_stk->get_depth();
+        autosave_pending_ = (depth <= cmd_read_depth_);
+        if (depth < cmd_read_depth_)
+            cmd_read_depth_ = depth;
+    }
+
     /* reading is now in progress */
-    S_read_in_progress = TRUE;
+    read_in_progress_ = TRUE;
 
     /* if we didn't get input from a script, read from the keyboard */
     if (!got_script_input)
@@ -2947,7 +3206,7 @@ int CVmConsole::read_line_timeout(VMG_ char *buf, size_t buflen,
         }
 
         /* read a line from the keyboard */
-        evt = os_gets_timeout((uchar *)S_read_buf, sizeof(S_read_buf),
+        evt = os_gets_timeout((uchar *)read_buf_, sizeof(read_buf_),
                               timeout, use_timeout);
 
         /*
@@ -2959,7 +3218,7 @@ int CVmConsole::read_line_timeout(VMG_ char *buf, size_t buflen,
         if (evt == OS_EVT_NOTIMEOUT && !use_timeout)
         {
             /* perform an ordinary untimed input */
-            if (os_gets((uchar *)S_read_buf, sizeof(S_read_buf)) != 0)
+            if (os_gets((uchar *)read_buf_, sizeof(read_buf_)) != 0)
             {
                 /* success */
                 evt = OS_EVT_LINE;
@@ -2991,7 +3250,7 @@ int CVmConsole::read_line_timeout(VMG_ char *buf, size_t buflen,
     /* if we got an error, return it */
     if (evt == OS_EVT_EOF)
     {
-        set_more_state(S_old_more_mode);
+        set_more_state(old_more_mode_);
         read_line_done(vmg0_);
         return log_event(vmg_ evt);
     }
@@ -3002,7 +3261,7 @@ int CVmConsole::read_line_timeout(VMG_ char *buf, size_t buflen,
      */
     char *outp = buf;
     size_t outlen = buflen - 1;
-    G_cmap_from_ui->map(&outp, &outlen, S_read_buf, strlen(S_read_buf));
+    G_cmap_from_ui->map(&outp, &outlen, read_buf_, strlen(read_buf_));
 
     /* add the null terminator */
     *outp = '\0';
@@ -3030,7 +3289,7 @@ int CVmConsole::read_line_timeout(VMG_ char *buf, size_t buflen,
      *   character set, so we want to simply use the original, untranslated
      *   input buffer. 
      */
-    return log_event(vmg_ evt, S_read_buf, strlen(S_read_buf), FALSE);
+    return log_event(vmg_ evt, read_buf_, strlen(read_buf_), FALSE);
 }
 
 /*
@@ -3052,11 +3311,14 @@ void CVmConsole::read_line_cancel(VMG_ int reset)
  */
 void CVmConsole::read_line_done(VMG0_)
 {
+    /* an autosave not taken by now is stale */
+    autosave_pending_ = FALSE;
+
     /* if we have a line in progress, finish it off */
-    if (S_read_in_progress)
+    if (read_in_progress_)
     {
         /* set the original 'more' mode */
-        set_more_state(S_old_more_mode);
+        set_more_state(old_more_mode_);
 
         /* 
          *   Write the input line, followed by a newline, to the log file.
@@ -3072,7 +3334,7 @@ void CVmConsole::read_line_done(VMG0_)
          */
         if (log_enabled_ && (script_sp_ == 0 || script_sp_->quiet))
         {
-            log_str_->print_to_os(S_read_buf);
+            log_str_->print_to_os(read_buf_);
             log_str_->print_to_os("\n");
         }
         
@@ -3082,7 +3344,7 @@ void CVmConsole::read_line_done(VMG0_)
             log_str_->note_input_line();
 
         /* clear the in-progress flag */
-        S_read_in_progress = FALSE;
+        read_in_progress_ = FALSE;
     }
 }
 
@@ -3553,9 +3815,6 @@ CVmConsoleMain::CVmConsoleMain(VMG0_)
     /* we don't have a statusline formatter until asked for one */
     statline_str_ = 0;
 
-    /* reset statics */
-    S_read_in_progress = FALSE;
-    S_read_buf[0] = '\0';
 }
 
 /*
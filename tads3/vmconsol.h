@@ -345,6 +345,14 @@ private:
 };
 
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Maximum nesting depth for output captures (see
+ *   CVmConsole::begin_capture()) 
+ */
+#define VMCON_CAPTURE_MAX  32
+
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Console.  A console corresponds to device that shows information to
@@ -371,6 +379,29 @@ public:
     /* format text explicitly to the log file, if any */
     int format_text_to_log(VMG_ const char *p, size_t len);
 
+    /*
+     *   Begin an output capture.  While a capture is in effect, text sent
+     *   to format_text() doesn't go through the formatter or to the log
+     *   file at all; instead, if 'buf' is a StringBuffer object, we append
+     *   the text to it as-is, and in any case we count the characters.
+     *   This lets the program find out whether something generated any
+     *   output, or collect the text, without displaying it and without
+     *   creating a string for each chunk.  Pass VM_INVALID_OBJ to count
+     *   only.  Captures nest, up to VMCON_CAPTURE_MAX deep; text goes to
+     *   the innermost capture only.  Returns zero on success, non-zero if
+     *   the nesting limit is exceeded.  
+     */
+    int begin_capture(VMG_ vm_obj_id_t buf);
+
+    /*
+     *   End the innermost output capture, returning the number of
+     *   characters captured, or -1 if there's no capture in effect.  
+     */
+    long end_capture(VMG0_);
+
+    /* is an output capture in effect? */
+    int is_capturing() const { return capture_depth_ != 0; }
+
     /* display a blank line */
     void write_blank_line(VMG0_);
 
@@ -559,6 +590,26 @@ public:
      */
     void read_line_cancel(VMG_ int reset);
 
+    /*
+     *   Take the pending autosave request, if any.  Returns true if the
+     *   line read in progress is at the program's command prompt and we
+     *   haven't yet taken an autosave for it, and clears the request, so
+     *   that the host takes at most one autosave per prompt (see
+     *   vm_autosave()).
+     *   
+     *   We consider a read to be at the command prompt if it's made with
+     *   no more on the stack than any line read before it.  Programs read
+     *   commands from a loop at a fixed depth, while prompts that arise
+     *   in the course of a command (a yes/no question, a disambiguation
+     *   query) are read from further down the stack.  
+     */
+    int take_autosave_request()
+    {
+        int ret = autosave_pending_;
+        autosave_pending_ = FALSE;
+        return ret;
+    }
+
     /*
      *   Display a file dialog.  This routine works exactly the same way
      *   as os_askfile(), but is implemented here to allow for a formatted
@@ -695,6 +746,36 @@ protected:
     class CVmDataSource *command_fp_;
     class CVmNetFile *command_nf_;
     struct vm_globalvar_t *command_glob_;
+
+    /* 
+     *   Output capture stack.  For each active capture, we keep the
+     *   character count, and a VM global holding the StringBuffer we're
+     *   appending to (or nil if we're only counting), for gc protection.
+     *   We create the globals as needed and keep them for reuse.  
+     */
+    struct vm_globalvar_t *capture_glob_[VMCON_CAPTURE_MAX];
+    long capture_cnt_[VMCON_CAPTURE_MAX];
+    int capture_depth_;
+
+    /*
+     *   Input state.  We might need these across a series of
+     *   read_line_timeout calls if timeouts occur.  
+     */
+
+    /* original 'more' mode, before input began */
+    int old_more_mode_;
+
+    /* flag: input is pending from an interrupted read_line_timeout call */
+    int read_in_progress_;
+
+    /* flag: the read in progress wants an autosave */
+    int autosave_pending_;
+
+    /* stack depth of the shallowest line read so far */
+    size_t cmd_read_depth_;
+
+    /* local buffer for reading input lines */
+    char read_buf_[256];
 };
 
 /* ------------------------------------------------------------------------ */
@@ -1332,6 +1413,16 @@ public:
      */
     virtual void print_to_os(const char *txt) = 0;
 
+    /*
+     *   Display text of a known byte length directly to the OS renderer.
+     *   The text must be null-terminated as well (txt[len] == '\0'), so the
+     *   default implementation simply passes it to print_to_os().
+     *   Subclasses whose OS routines take a counted length can override
+     *   this to save the OS layer from measuring the text again.  
+     */
+    virtual void print_to_os(const char *txt, size_t /*len*/)
+        { print_to_os(txt); }
+
     /* flush the underlying OS-level rendere */
     virtual void flush_to_os() = 0;
 
@@ -1375,6 +1466,26 @@ protected:
     /* buffer a rendered expanded character */
     void buffer_rendered(wchar_t c, unsigned char flags, int wid);
 
+    /*
+     *   Buffer a run of ordinary printable ASCII characters, starting with
+     *   'c', directly into the line buffer.  This is a fast path for
+     *   format_text(): 'c' must be printable ASCII other than '<' or '&',
+     *   and the caller must check can_buffer_plain_run() first.  Returns
+     *   the next character to process.  
+     */
+    wchar_t buffer_plain_run(VMG_ wchar_t c, const char **s, size_t *slen);
+
+    /* can we currently take the buffer_plain_run() fast path? */
+    int can_buffer_plain_run() const
+    {
+        return (html_parse_state_ == VMCON_HPS_NORMAL
+                && !html_in_ignore_
+                && (!html_target_
+                    || html_passthru_state_ == VMCON_HPS_NORMAL
+                    || html_passthru_state_ == VMCON_HPS_MARKUP_END)
+                && !capsflag_ && !nocapsflag_ && !allcapsflag_);
+    }
+
     /* 
      *   Buffer a string of output to the stream.  The string is in UTF-8
      *   format. 
@@ -1873,6 +1984,9 @@ protected:
         os_printz(txt);
     }
 
+    virtual void print_to_os(const char *txt, size_t len)
+        { os_print(txt, len); }
+
     /* flush the underlying OS-level renderer */
     virtual void flush_to_os() { os_flush(); }
 
@@ -1934,6 +2048,8 @@ public:
 
     /* text displayed in the status line goes directly to the main console */
     virtual void print_to_os(const char *txt) { os_printz(txt); }
+    virtual void print_to_os(const char *txt, size_t len)
+        { os_print(txt, len); }
 
     /* flushing the status line simply flushes the main text stream */
     virtual void flush_to_os() { os_flush(); }
@@ -2022,6 +2138,9 @@ protected:
         os_banner_disp(banner_, txt, strlen(txt));
     }
 
+    virtual void print_to_os(const char *txt, size_t len)
+        { os_banner_disp(banner_, txt, len); }
+
     /* turn HTML mode on/off in the underlying OS-level renderer */
     virtual void start_html_in_os() { os_banner_start_html(banner_); }
     virtual void end_html_in_os() { os_banner_end_html(banner_); }
@@ -2076,6 +2195,15 @@ protected:
 };
 
 /* ------------------------------------------------------------------------ */
+/*
+ *   Log file output buffer size.  Rather than writing and flushing the log
+ *   file for every chunk of text, the log formatter collects its output in
+ *   a buffer of this size, and writes it out when the buffer fills up, when
+ *   the formatter flushes to the OS (which happens when we stop for input),
+ *   and when the file is closed.  
+ */
+#define VMCON_LOGBUF_SIZE  8192
+
 /*
  *   Formatter subclass for the log file 
  */
@@ -2093,6 +2221,10 @@ public:
         logfp_ = 0;
         logglob_ = 0;
 
+        /* we don't allocate the output buffer until we need it */
+        logbuf_ = 0;
+        logbuf_len_ = 0;
+
         /* remember our width */
         width_ = width;
     }
@@ -2102,6 +2234,10 @@ public:
         /* close the log file */
         close_log_file(vmg0_);
 
+        /* free the output buffer */
+        if (logbuf_ != 0)
+            t3free(logbuf_);
+
         /* do the basic deletion */
         CVmFormatter::delete_obj(vmg0_);
     }
@@ -2162,17 +2298,14 @@ protected:
 
     /* display text to the underlying OS device */
     virtual void print_to_os(const char *txt)
-    {
-        /* display the text through the log file */
-        if (logfp_ != 0)
-        {
-            os_fprintz(logfp_, txt);
-            osfflush(logfp_);
-        }
-    }
+        { print_to_os(txt, strlen(txt)); }
+    virtual void print_to_os(const char *txt, size_t len);
 
-    /* flush the underlying OS-level rendere */
-    virtual void flush_to_os() { }
+    /* write out buffered text and flush the log file */
+    virtual void flush_to_os();
+
+    /* write out the text in our output buffer */
+    void write_log_buf();
 
     /* set the window title in the OS layer - no effect for log streams */
     virtual void set_title_in_os(const char *) { }
@@ -2210,6 +2343,10 @@ protected:
     {
     }
 
+    /* output buffer, and the number of bytes in it */
+    char *logbuf_;
+    size_t logbuf_len_;
+
     /* my log file handle and network file descriptor */
     osfildef *logfp_;
     class CVmNetFile *lognf_;
@@ -167,7 +167,8 @@ int (CVmObjDict::
     &CVmObjDict::getp_del,                                             /* 4 */
     &CVmObjDict::getp_is_defined,                                      /* 5 */
     &CVmObjDict::getp_for_each_word,                                   /* 6 */
-    &CVmObjDict::getp_correct                                          /* 7 */
+    &CVmObjDict::getp_correct,                                         /* 7 */
+    &CVmObjDict::getp_find_words                                       /* 8 */
 };
 
 /* ------------------------------------------------------------------------ */
@@ -210,7 +211,7 @@ vm_obj_id_t CVmObjDict::create_from_stack(VMG_ const uchar **pc_ptr,
     obj->set_comparator(vmg_ comp);
 
     /* build an empty initial hash table */
-    obj->create_hash_table(vmg0_);
+    obj->create_hash_table(vmg_ 0);
 
     /* 
      *   mark the object as modified since image load, since it doesn't
@@ -245,9 +246,15 @@ CVmObjDict::CVmObjDict(VMG0_)
     /* no Trie yet */
     get_ext()->trie_ = 0;
 
+    /* no image hash table to build yet */
+    get_ext()->image_hash_pending_ = FALSE;
+
     /* no non-image entries yet */
     get_ext()->modified_ = FALSE;
 
+    /* no entries outside the root set yet */
+    get_ext()->has_dyn_refs_ = FALSE;
+
     /* no comparator yet */
     get_ext()->comparator_ = VM_INVALID_OBJ;
     set_comparator_type(vmg_ VM_INVALID_OBJ);
@@ -293,7 +300,7 @@ void CVmObjDict::set_comparator(VMG_ vm_obj_id_t obj)
 
     /* rebuild the hash tale */
     if (get_ext()->hashtab_ != 0)
-        create_hash_table(vmg0_);
+        create_hash_table(vmg_ 0);
 }
 
 /*
@@ -329,10 +336,26 @@ void CVmObjDict::set_comparator_type(VMG_ vm_obj_id_t obj)
  *   the entries from the old table to the new table, and delete the old
  *   table.  
  */
-void CVmObjDict::create_hash_table(VMG0_)
+void CVmObjDict::create_hash_table(VMG_ size_t nwords)
 {
     CVmHashTable *new_tab;
     CVmHashFunc *hash_func;
+    size_t siz;
+
+    /* 
+     *   Figure the table size.  If the caller knows how many words we'll
+     *   hold, use a power of two at least that large (within limits), so
+     *   that large vocabularies don't end up in long hash chains.
+     *   Otherwise, keep the size of the existing table, if any.  
+     */
+    siz = VMDICT_HASH_MIN;
+    if (nwords == 0 && get_ext()->hashtab_ != 0)
+        siz = get_ext()->hashtab_->get_table_size();
+    else
+    {
+        while (siz < nwords && siz < VMDICT_HASH_MAX)
+            siz <<= 1;
+    }
     
     /*
      *   Create our hash function.  If we have a comparator object, base the
@@ -367,9 +390,14 @@ void CVmObjDict::create_hash_table(VMG0_)
     }
 
     /* create the hash table */
-    new_tab = new CVmHashTable(256, hash_func, TRUE);
+    new_tab = new CVmHashTable((int)siz, hash_func, TRUE);
 
-    /* if we had a previous hash table, move its contents to the new table */
+    /* 
+     *   If we had a previous hash table, move its contents to the new table.
+     *   The trie (if we have one) is keyed on the literal word text rather
+     *   than on the comparator, so it stays valid as the same words move to
+     *   the new table.  
+     */
     if (get_ext()->hashtab_ != 0)
     {
         /* copy the old hash table to the new one */
@@ -378,10 +406,9 @@ void CVmObjDict::create_hash_table(VMG0_)
         /* delete the old hash table */
         delete get_ext()->hashtab_;
     }
-
-    /* if we had a previous trie, get rid of it */
-    if (get_ext()->trie_ != 0)
+    else if (get_ext()->trie_ != 0)
     {
+        /* no previous table, so any old trie is stale - get rid of it */
         delete get_ext()->trie_;
         get_ext()->trie_ = 0;
     }
@@ -489,7 +516,7 @@ unsigned int CVmObjDict::calc_str_hash(VMG_ const vm_val_t *valstrval,
     {
     case VMDICT_COMP_NONE:
         /* no comparator - use the hash table's basic hash calculation */
-        return get_ext()->hashtab_->compute_hash(valstr, vallen);
+        return get_ext()->hashtab_->compute_raw_hash(valstr, vallen);
 
     case VMDICT_COMP_STRCOMP:
         /* calculate the hash directly with the StringComparator */
@@ -857,7 +884,6 @@ int CVmObjDict::getp_find(VMG_ vm_obj_id_t, vm_val_t *val, uint *argc)
     const char *strp;
     size_t strl;
     vm_prop_id_t voc_prop;
-    unsigned int hash;
 
     /* check arguments */
     if (get_prop_check_argc(val, argc, &desc))
@@ -888,18 +914,145 @@ int CVmObjDict::getp_find(VMG_ vm_obj_id_t, vm_val_t *val, uint *argc)
     else
         err_throw(VMERR_PROPPTR_VAL_REQD);
 
+    /* look up the word, and return the list of matches */
+    val->set_obj(find_word_list(vmg_ arg0, strp, strl, voc_prop));
+
+    /* discard arguments */
+    G_stk->discard(orig_argc);
+
+    /* success */
+    return TRUE;
+}
+
+/*
+ *   Look up a word, returning a list of the matching [object, match
+ *   result] pairs, in the format findWord() returns.  
+ */
+vm_obj_id_t CVmObjDict::find_word_list(VMG_ const vm_val_t *strval,
+                                       const char *strp, size_t strl,
+                                       vm_prop_id_t voc_prop)
+{
     /* calculate the hash value */
-    hash = calc_str_hash(vmg_ arg0, strp, strl);
+    unsigned int hash = calc_str_hash(vmg_ strval, strp, strl);
 
     /* enumerate everything that matches the string's hash code */
-    find_ctx ctx(vmg_ this, arg0, strp, strl, voc_prop);
+    find_ctx ctx(vmg_ this, strval, strp, strl, voc_prop);
     get_ext()->hashtab_->enum_hash_matches(hash, &find_cb, &ctx);
 
-    /* build a list out of the results, and return the list */
-    val->set_obj(ctx.results_to_list(vmg0_));
+    /* build a list out of the results */
+    return ctx.results_to_list(vmg0_);
+}
 
-    /* discard arguments */
-    G_stk->discard(orig_argc);
+/* ------------------------------------------------------------------------ */
+/*
+ *   property evaluation - look up a list of words.  This does the same
+ *   thing as calling findWord() on each word in the list, but does it in
+ *   a single call.  Each element of the list can be a string, or a token
+ *   list entry of the form [text, type, ...], which is what the tokenizer
+ *   produces.  We return a list with one element per input element, each
+ *   of which is the list findWord() would return for that word.  
+ */
+int CVmObjDict::getp_find_words(VMG_ vm_obj_id_t, vm_val_t *val, uint *argc)
+{
+    static CVmNativeCodeDesc desc(1, 1);
+    uint orig_argc = (argc != 0 ? *argc : 0);
+    vm_val_t *lstval;
+    vm_val_t *arg1;
+    vm_prop_id_t voc_prop;
+    int cnt;
+    int i;
+
+    /* check arguments */
+    if (get_prop_check_argc(val, argc, &desc))
+        return TRUE;
+
+    /* get the word list, leaving it on the stack for gc protection */
+    lstval = G_stk->get(0);
+    if (!lstval->is_listlike(vmg0_) || (cnt = lstval->ll_length(vmg0_)) < 0)
+        err_throw(VMERR_LIST_VAL_REQD);
+
+    /* get the property ID, which can be omitted or nil to mean any */
+    if (orig_argc < 2)
+        voc_prop = VM_INVALID_PROP;
+    else if ((arg1 = G_stk->get(1))->typ == VM_NIL)
+        voc_prop = VM_INVALID_PROP;
+    else if (arg1->typ == VM_PROP)
+        voc_prop = arg1->val.prop;
+    else
+        err_throw(VMERR_PROPPTR_VAL_REQD);
+
+    /* create the result list, and push it for gc protection */
+    val->set_obj(CVmObjList::create(vmg_ FALSE, cnt));
+    CVmObjList *lst = (CVmObjList *)vm_objp(vmg_ val->val.obj);
+    lst->cons_clear();
+    G_stk->push(val);
+
+    /* look up each word */
+    for (i = 0 ; i < cnt ; ++i)
+    {
+        vm_val_t ele;
+        vm_val_t strval;
+        vm_val_t res;
+        const char *strp;
+
+        /* get the element; if it's a token entry, get its text */
+        lstval->ll_index(vmg_ &ele, i + 1);
+        if (ele.get_as_string(vmg0_) == 0 && ele.is_listlike(vmg0_)
+            && ele.ll_length(vmg0_) > 0)
+            ele.ll_index(vmg_ &strval, 1);
+        else
+            strval = ele;
+
+        /* get the string (anything else simply has no matches) */
+        if ((strp = strval.get_as_string(vmg0_)) == 0)
+        {
+            res.set_obj(CVmObjList::create(vmg_ FALSE, (size_t)0));
+            lst->cons_set_element(i, &res);
+            continue;
+        }
+
+        /* 
+         *   Command input usually repeats a few words ("the", "and"), so
+         *   check for an earlier element with the same text; if we find
+         *   one, its results apply to this word as well, and we can share
+         *   the result list rather than looking the word up again.  (The
+         *   result lists are immutable, so sharing is safe.)  
+         */
+        size_t strl = vmb_get_len(strp);
+        int j;
+        for (j = 0 ; j < i ; ++j)
+        {
+            vm_val_t prv, prvstr;
+            const char *prvp;
+
+            /* get the earlier element's text */
+            lstval->ll_index(vmg_ &prv, j + 1);
+            if (prv.get_as_string(vmg0_) == 0 && prv.is_listlike(vmg0_)
+                && prv.ll_length(vmg0_) > 0)
+                prv.ll_index(vmg_ &prvstr, 1);
+            else
+                prvstr = prv;
+
+            /* if it's the same text, use its result */
+            if ((prvp = prvstr.get_as_string(vmg0_)) != 0
+                && vmb_get_len(prvp) == strl
+                && memcmp(prvp + VMB_LEN, strp + VMB_LEN, strl) == 0)
+                break;
+        }
+
+        /* use the earlier result, or look up the word */
+        if (j < i)
+            lst->get_element(j, &res);
+        else
+            res.set_obj(find_word_list(vmg_ &strval, strp + VMB_LEN, strl,
+                                       voc_prop));
+
+        /* store it */
+        lst->cons_set_element(i, &res);
+    }
+
+    /* discard the gc protection and the arguments */
+    G_stk->discard(orig_argc + 1);
 
     /* success */
     return TRUE;
@@ -2024,10 +2177,18 @@ void CVmObjDict::mark_refs(VMG_ uint state)
 void CVmObjDict::remove_stale_weak_refs(VMG0_)
 {
     enum_hashtab_ctx ctx;
+
+    /* if all of our entries are for root set objects, none can go stale */
+    if (!get_ext()->has_dyn_refs_ || get_ext()->hashtab_ == 0)
+        return;
     
-    /* iterate over our hash table */
+    /* 
+     *   iterate over our hash table; the callback notes whether any entries
+     *   for objects outside the root set remain 
+     */
     ctx.vmg = VMGLOB_ADDR;
     ctx.dict = this;
+    get_ext()->has_dyn_refs_ = FALSE;
     get_ext()->hashtab_->enum_entries(&remove_weak_ref_cb, &ctx);
 }
 
@@ -2053,14 +2214,18 @@ void CVmObjDict::remove_weak_ref_cb(void *ctx0, CVmHashEntry *entry0)
         /* check to see if this object is free - if so, remove this record */
         if (G_obj_table->is_obj_deletable(cur->obj_))
         {
-            /* if we have a trie, delete the trie entry */
-            if (ctx->dict->get_ext()->trie_ != 0)
-                ctx->dict->get_ext()->trie_->del_word(
-                    entry->getstr(), entry->getlen());
-
-            /* delete the entry */
+            /* 
+             *   delete the entry; if this was the last item for the word,
+             *   this removes the word from the trie as well 
+             */
             entry->del_entry(ctx->dict->get_ext()->hashtab_,
-                             cur->obj_, cur->prop_);
+                             cur->obj_, cur->prop_,
+                             ctx->dict->get_ext()->trie_);
+        }
+        else if (!G_obj_table->is_obj_in_root_set(cur->obj_))
+        {
+            /* we're keeping a reference that could go stale later */
+            ctx->dict->get_ext()->has_dyn_refs_ = TRUE;
         }
     }
 }
@@ -2077,16 +2242,53 @@ void CVmObjDict::load_from_image(VMG_ vm_obj_id_t self,
     get_ext()->image_data_ = ptr;
     get_ext()->image_data_size_ = siz;
 
-    /* build the hash table from the image data */
-    build_hash_from_image(vmg0_);
+    /* build the hash table from the image data, or arrange to do so */
+    load_hash_from_image(vmg0_);
 
     /* 
-     *   register for post-load initialization, as we might need to rebuild
+     *   register for post-load initialization, as we might need to build
      *   our hash table once we have access to the comparator object 
      */
     G_obj_table->request_post_load_init(self);
 }
 
+/*
+ *   Set up the hash table from the image data.  If the image doesn't
+ *   specify a comparator, the exact-match table we'd build now is final,
+ *   so just build it.  Otherwise, the table has to be built with the
+ *   comparator's hash function, and the comparator might not be loaded
+ *   yet; rather than building a tentative table now and rehashing every
+ *   entry at post-load time, we leave an empty table in place and build
+ *   the real one once, in post_load_init().  Nothing can look up words
+ *   before then, since no byte code runs until post-load initialization
+ *   is complete, and any native code that depends on us during
+ *   initialization calls ensure_post_load_init() first.  
+ */
+void CVmObjDict::load_hash_from_image(VMG0_)
+{
+    /* read the comparator object ID from the image data */
+    vm_obj_id_t comp = (vm_obj_id_t)t3rp4u(get_ext()->image_data_);
+
+    if (comp == VM_INVALID_OBJ)
+    {
+        /* no comparator - build the final table now */
+        build_hash_from_image(vmg_ FALSE);
+    }
+    else
+    {
+        /* 
+         *   set up an empty exact-match table for now, remember the
+         *   comparator (without installing its type, since it might not
+         *   be loaded yet), and note that the table still has to be built 
+         */
+        get_ext()->comparator_ = VM_INVALID_OBJ;
+        set_comparator_type(vmg_ VM_INVALID_OBJ);
+        create_hash_table(vmg_ 0);
+        get_ext()->comparator_ = comp;
+        get_ext()->image_hash_pending_ = TRUE;
+    }
+}
+
 /*
  *   Post-load initialization 
  */
@@ -2103,7 +2305,20 @@ void CVmObjDict::post_load_init(VMG_ vm_obj_id_t self)
      *   and then we go back and re-install the comparator for real,
      *   rebuilding the hash table with the actual comparator.  
      */
-    if ((comp = get_ext()->comparator_) != VM_INVALID_OBJ)
+    if ((comp = get_ext()->comparator_) != VM_INVALID_OBJ
+        && get_ext()->image_hash_pending_)
+    {
+        /* 
+         *   we deferred building the table from the image data until the
+         *   comparator was available - discard the empty placeholder table
+         *   and build the real one with the comparator installed 
+         */
+        get_ext()->image_hash_pending_ = FALSE;
+        delete get_ext()->hashtab_;
+        get_ext()->hashtab_ = 0;
+        build_hash_from_image(vmg_ TRUE);
+    }
+    else if (comp != VM_INVALID_OBJ)
     {
         /* ensure the comparator object is initialized */
         G_obj_table->ensure_post_load_init(vmg_ comp);
@@ -2115,14 +2330,14 @@ void CVmObjDict::post_load_init(VMG_ vm_obj_id_t self)
          *   force a rebuild the hash table, so that we build it with the
          *   comparator properly installed 
          */
-        create_hash_table(vmg0_);
+        create_hash_table(vmg_ 0);
     }
 }
 
 /*
  *   Build the hash table from the image data 
  */
-void CVmObjDict::build_hash_from_image(VMG0_)
+void CVmObjDict::build_hash_from_image(VMG_ int use_comp)
 {
     uint cnt;
     uint i;
@@ -2138,30 +2353,40 @@ void CVmObjDict::build_hash_from_image(VMG0_)
     comp = (vm_obj_id_t)t3rp4u(p);
     p += 4;
 
-    /*
-     *   Do NOT install the actual comparator object at this point, but
-     *   simply build the table tentatively with a nil comparator.  We can't
-     *   assume that the comparator object has been loaded yet (as it might
-     *   be loaded after us), so we cannot use it to build the hash table.
-     *   We have to do something with the data, though, so build the hash
-     *   table tentatively with no comparator; we'll rebuild it again at
-     *   post-load-init time with the real comparator.
-     *   
-     *   (This isn't as inefficient as it sounds, as we retain all of the
-     *   original hash table entries when we rebuild the table.  All we end
-     *   up doing is scanning the entries again to recompute their new hash
-     *   values, and reallocating the hash table object itself.)  
-     */
-    get_ext()->comparator_ = VM_INVALID_OBJ;
-    set_comparator_type(vmg_ VM_INVALID_OBJ);
-
-    /* create the new hash table */
-    create_hash_table(vmg0_);
+    if (use_comp && comp != VM_INVALID_OBJ)
+    {
+        /* 
+         *   The caller says it's safe to use the comparator, so make sure
+         *   it's initialized and install it.  We'll build the table with
+         *   its hash function directly.  Lookups while we're building still
+         *   match keys exactly (see CVmHashEntryCS), so we get the same
+         *   set of entries as we would building with no comparator.  
+         */
+        G_obj_table->ensure_post_load_init(vmg_ comp);
+        get_ext()->comparator_ = comp;
+        set_comparator_type(vmg_ comp);
+    }
+    else
+    {
+        /*
+         *   Do NOT install the actual comparator object at this point, but
+         *   simply build the table tentatively with a nil comparator.  We
+         *   can't assume that the comparator object has been loaded yet (as
+         *   it might be loaded after us), so we cannot use it to build the
+         *   hash table.  We'll rebuild it at post-load-init time with the
+         *   real comparator.  
+         */
+        get_ext()->comparator_ = VM_INVALID_OBJ;
+        set_comparator_type(vmg_ VM_INVALID_OBJ);
+    }
 
     /* read the entry count */
     cnt = osrp2(p);
     p += 2;
 
+    /* create the new hash table, sized for the number of words */
+    create_hash_table(vmg_ cnt);
+
     /* scan the entries */
     for (i = 0 ; p < endp && i < cnt ; ++i)
     {
@@ -2291,13 +2516,20 @@ void vmdict_TrieNode::add_word(const char *str, size_t len)
         /* get this character */
         wchar_t ch = p.getch();
 
-        /* find the child node for this letter */
-        vmdict_TrieNode *chi;
-        for (chi = n->chi ; chi != 0 && chi->ch != ch ; chi = chi->nxt) ;
+        /* count the word in this node's subtree */
+        n->sub_cnt += 1;
+
+        /* 
+         *   find the child node for this letter, or the insertion point
+         *   that keeps the child list in character order 
+         */
+        vmdict_TrieNode **link, *chi;
+        for (link = &n->chi ; (chi = *link) != 0 && chi->ch < ch ;
+             link = &chi->nxt) ;
 
         /* if there's no existing child for this letter, add one */
-        if (chi == 0)
-            n->chi = chi = new vmdict_TrieNode(n->chi, ch);
+        if (chi == 0 || chi->ch != ch)
+            *link = chi = new vmdict_TrieNode(chi, ch);
 
         /* advance to this child node */
         n = chi;
@@ -2305,6 +2537,7 @@ void vmdict_TrieNode::add_word(const char *str, size_t len)
 
     /* 'n' is the final node for this word, so count the word there */
     n->word_cnt += 1;
+    n->sub_cnt += 1;
 }
 
 /* find a node for a given word */
@@ -2321,10 +2554,10 @@ vmdict_TrieNode *vmdict_TrieNode::find_word(const char *str, size_t len)
 
         /* find the child node for this letter */
         vmdict_TrieNode *chi;
-        for (chi = n->chi ; chi != 0 && chi->ch != ch ; chi = chi->nxt) ;
+        for (chi = n->chi ; chi != 0 && chi->ch < ch ; chi = chi->nxt) ;
 
         /* if we didn't find a child, the word isn't in the trie */
-        if (chi == 0)
+        if (chi == 0 || chi->ch != ch)
             return 0;
 
         /* advance to this child node */
@@ -2341,9 +2574,45 @@ void vmdict_TrieNode::del_word(const char *str, size_t len)
     /* find the final node for this word */
     vmdict_TrieNode *n = find_word(str, len);
 
-    /* if we found it, decrement its word count */
-    if (n != 0 && n->word_cnt != 0)
-        n->word_cnt -= 1;
+    /* if the word isn't in the trie, there's nothing to do */
+    if (n == 0 || n->word_cnt == 0)
+        return;
+
+    /* decrement its word count */
+    n->word_cnt -= 1;
+
+    /* 
+     *   Walk the path again, removing the word from each subtree count.
+     *   As soon as we reach a child whose subtree has no words left, unlink
+     *   and delete it - everything below it is dead.  
+     */
+    utf8_ptr p((char *)str);
+    for (n = this ; ; p.inc(&len))
+    {
+        /* remove the word from this subtree */
+        n->sub_cnt -= 1;
+
+        /* stop at the end of the word */
+        if (len == 0)
+            break;
+
+        /* find the link to the child for the next letter */
+        wchar_t ch = p.getch();
+        vmdict_TrieNode **link;
+        for (link = &n->chi ; (*link)->ch != ch ; link = &(*link)->nxt) ;
+
+        /* if this child's subtree is about to become empty, prune it */
+        vmdict_TrieNode *chi = *link;
+        if (chi->sub_cnt == 1)
+        {
+            *link = chi->nxt;
+            delete chi;
+            break;
+        }
+
+        /* advance to the child */
+        n = chi;
+    }
 }
 
 
@@ -2374,6 +2643,11 @@ int CVmObjDict::add_hash_entry(VMG_ const char *p, size_t len, int copy,
             get_ext()->trie_->add_word(p, len);
     }
 
+    /* note if the object could ever be deleted */
+    if (!G_obj_table->is_obj_id_valid(obj)
+        || !G_obj_table->is_obj_in_root_set(obj))
+        get_ext()->has_dyn_refs_ = TRUE;
+
     /* add the obj/prop to the entry's item list */
     return entry->add_entry(obj, prop, from_image);
 }
@@ -2393,12 +2667,13 @@ int CVmObjDict::del_hash_entry(VMG_ const char *str, size_t len,
     /* if we found it, delete the obj/prop entry */
     if (entry != 0)
     {
-        /* if we have a trie, delete the trie entry */
-        if (get_ext()->trie_ != 0)
-            get_ext()->trie_->del_word(str, len);
-        
-        /* delete the hash table entry */
-        return entry->del_entry(get_ext()->hashtab_, obj, voc_prop);
+        /* 
+         *   Delete the hash table entry.  Only remove the word from the
+         *   trie if this removes the last item for the word - the trie
+         *   counts words, not obj/prop associations.  
+         */
+        return entry->del_entry(get_ext()->hashtab_, obj, voc_prop,
+                                get_ext()->trie_);
     }
 
     /* we didn't find anything to delete */
@@ -2429,10 +2704,10 @@ void CVmObjDict::reset_to_image(VMG_ vm_obj_id_t self)
     }
 
     /* rebuild the hash table from the image file data */
-    build_hash_from_image(vmg0_);
+    load_hash_from_image(vmg0_);
 
     /* 
-     *   register for post-load initialization, as we might need to rebuild
+     *   register for post-load initialization, as we might need to build
      *   our hash table once we have access to the comparator object 
      */
     G_obj_table->request_post_load_init(self);
@@ -2586,12 +2861,15 @@ void CVmObjDict::restore_from_file(VMG_ vm_obj_id_t self,
      */
     comp = fixups->get_new_id(vmg_ (vm_obj_id_t)fp->read_uint4());
 
-    /* create the new, empty hash table */
-    create_hash_table(vmg0_);
+    /* we're building from the file, not the image data */
+    get_ext()->image_hash_pending_ = FALSE;
 
     /* read the number of symbols */
     cnt = fp->read_uint4();
 
+    /* create the new, empty hash table, sized for the number of words */
+    create_hash_table(vmg_ (size_t)cnt);
+
     /* read the symbols */
     for ( ; cnt != 0 ; --cnt)
     {
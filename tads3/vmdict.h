@@ -88,6 +88,13 @@ enum dict_undo_action
  *   that we have to rebuild the hash table on restoring a saved state file.
  */
 
+/* 
+ *   Hash table size limits.  We size each dictionary's hash table to the
+ *   number of words it holds, within these bounds (both powers of two). 
+ */
+#define VMDICT_HASH_MIN  256
+#define VMDICT_HASH_MAX  65536
+
 /* comparator object types */
 enum vm_dict_comp_type
 {
@@ -121,13 +128,37 @@ struct vm_dict_ext
 
     /* Trie of our entries, for spelling correction */
     struct vmdict_TrieNode *trie_;
+
+    /* 
+     *   flag: the hash table still has to be built from the image data;
+     *   we defer this to post-load initialization when the image specifies
+     *   a comparator, so that we only build the table once 
+     */
+    int image_hash_pending_;
+
+    /*
+     *   flag: we might have entries for objects outside the root set.  Our
+     *   references are weak, but root set objects are never deleted, so
+     *   while all of our entries refer to root set objects (as they do for
+     *   the vocabulary in the image file), there's nothing for the garbage
+     *   collector's stale reference scan to find. 
+     */
+    int has_dyn_refs_;
 };
 
 
 /* ------------------------------------------------------------------------ */
 /*
  *   For spelling correction, we maintain a Trie on the dictionary in
- *   parallel to the hash table.  
+ *   parallel to the hash table.  The Trie is built on demand from the hash
+ *   table the first time it's needed, and from then on it's kept in sync
+ *   incrementally as words are added and removed.
+ *   
+ *   Each node keeps its children sorted by transition character, and
+ *   keeps a count of the words in its whole subtree.  When a subtree's
+ *   count drops to zero, we prune it, so that the Trie only ever contains
+ *   paths that lead to live words.  This keeps the correction search from
+ *   wandering down dead branches left behind by removed words.  
  */
 
 /* 
@@ -140,8 +171,9 @@ struct vmdict_TrieNode
         /* remember the transition character from our parent to us */
         ch = c;
 
-        /* we don't have any words in this node yet */
+        /* we don't have any words in this node or its subtree yet */
         word_cnt = 0;
+        sub_cnt = 0;
 
         /* remember our next sibling link */
         this->nxt = nxt;
@@ -191,7 +223,14 @@ struct vmdict_TrieNode
      */
     int word_cnt;
 
-    /* the head of the list of child nodes */
+    /* 
+     *   Number of words in this node's subtree, including this node's own
+     *   word_cnt.  A node whose subtree count drops to zero is pruned from
+     *   the tree.  
+     */
+    int sub_cnt;
+
+    /* the head of the list of child nodes, in ascending 'ch' order */
     vmdict_TrieNode *chi;
 
     /* our next sibling */
@@ -356,11 +395,28 @@ protected:
     /* set the comparator type */
     void set_comparator_type(VMG_ vm_obj_id_t obj);
 
-    /* create or re-create the hash table */
-    void create_hash_table(VMG0_);
+    /* 
+     *   Create or re-create the hash table.  'nwords' is the number of
+     *   words we expect to hold, for sizing the table; zero keeps the size
+     *   of the current table, or uses the default if there isn't one.  
+     */
+    void create_hash_table(VMG_ size_t nwords);
+
+    /* 
+     *   Fill the hash table with entries from the image data.  If
+     *   'use_comp' is true, we install the image's comparator first, so
+     *   the table is built with its final hash function; this is only
+     *   possible once the comparator object is loaded.  Otherwise we build
+     *   the table tentatively with an exact comparison, to be rehashed
+     *   when the comparator is installed.  
+     */
+    void build_hash_from_image(VMG_ int use_comp);
 
-    /* fill the hash table with entries from the image data */
-    void build_hash_from_image(VMG0_);
+    /* 
+     *   set up for building the hash table from the image data, building
+     *   it now or deferring it to post-load initialization 
+     */
+    void load_hash_from_image(VMG0_);
 
     /* build the Trie from the hash table */
     void build_trie(VMG0_);
@@ -399,6 +455,14 @@ protected:
     /* property evaluation - find corrections for a misspelled word */
     int getp_correct(VMG_ vm_obj_id_t self, vm_val_t *retval, uint *argc);
 
+    /* property evaluation - findWords */
+    int getp_find_words(VMG_ vm_obj_id_t, vm_val_t *val, uint *argc);
+
+    /* look up a word, returning the findWord() result list */
+    vm_obj_id_t find_word_list(VMG_ const vm_val_t *strval,
+                               const char *strp, size_t strl,
+                               vm_prop_id_t voc_prop);
+
     /* get my extension, properly cast */
     vm_dict_ext *get_ext() const { return (vm_dict_ext *)ext_; }
 
@@ -561,9 +625,12 @@ public:
 
     /* 
      *   Delete all entries matching a given object ID from our list.
-     *   Returns true if any entries were deleted, false if not. 
+     *   Returns true if any entries were deleted, false if not.  If this
+     *   leaves the list empty, we delete the hash entry itself, along with
+     *   its word in the given Trie (if 'trie' isn't null).  
      */
-    int del_entry(CVmHashTable *table, vm_obj_id_t obj, vm_prop_id_t prop)
+    int del_entry(CVmHashTable *table, vm_obj_id_t obj, vm_prop_id_t prop,
+                  vmdict_TrieNode *trie)
     {
         vm_dict_entry *cur;
         vm_dict_entry *nxt;
@@ -594,9 +661,16 @@ public:
             }
         }
 
-        /* if our list is now empty, delete myself from the table */
+        /* 
+         *   if our list is now empty, delete myself from the table, and
+         *   remove my word from the Trie if there is one 
+         */
         if (list_ == 0)
         {
+            /* remove my word from the Trie */
+            if (trie != 0)
+                trie->del_word(getstr(), getlen());
+
             /* remove myself from the table */
             table->remove(this);
 
@@ -622,7 +696,7 @@ class CVmMetaclassDict: public CVmMetaclass
 {
 public:
     /* get the global name */
-    const char *get_meta_name() const { return "dictionary2/030001"; }
+    const char *get_meta_name() const { return "dictionary2/030002"; }
 
     /* create from image file */
     void create_for_image_load(VMG_ vm_obj_id_t id)
@@ -257,7 +257,13 @@ void CVmDynamicFunc::notify_delete(VMG_ int /*in_root_set*/)
 {
     /* free our additional data, if we have any */
     if (ext_ != 0)
+    {
+        /* our byte code is going away, so it can't stay in the cache */
+        CVmRun::inval_exc_cache();
+
+        /* free the memory */
         G_mem->get_var_heap()->free_mem(ext_);
+    }
 }
 
 /*
@@ -689,6 +695,309 @@ private:
 };
 
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Compiled-code cache support.
+ *   
+ *   The byte code we generate for a given source string depends only on
+ *   the source text, the compilation mode, and the values of the global
+ *   symbols and macros the compiler looked up along the way.  While
+ *   compiling, we record each name we look up in the program's symbol and
+ *   macro tables, along with a "signature" of the value we found.  When
+ *   the same source is compiled again, we repeat just those lookups: if
+ *   every signature still matches, the compiler would generate exactly the
+ *   same code, so we can copy the cached byte code into a new DynamicFunc
+ *   rather than running the compiler again.
+ *   
+ *   A value's signature is a serialization of its type and contents.
+ *   Strings and lists are serialized by value.  Other objects are recorded
+ *   by ID, which is only meaningful for root-set objects, since anything
+ *   else could be collected and its ID reused; a lookup that yields a
+ *   non-root object makes the compilation uncacheable.  
+ */
+
+/* maximum number of cached compilations */
+#define VMDYNCOMP_CACHE_MAX  64
+
+/* maximum nesting depth of list values we'll serialize in a signature */
+#define VMDYNCOMP_SIG_DEPTH  8
+
+/*
+ *   Value signature buffer 
+ */
+class CVmDynCompSig
+{
+public:
+    CVmDynCompSig() : buf_(0), len_(0), alo_(0) { }
+    ~CVmDynCompSig() { if (buf_ != 0) t3free(buf_); }
+
+    /* 
+     *   Add a value to the signature.  Returns false if the value can't be
+     *   represented, in which case the lookup isn't cacheable. 
+     */
+    int add_val(VMG_ const vm_val_t *val, int depth)
+    {
+        const char *str, *lst;
+
+        /* strings and lists are represented by value */
+        if ((str = val->get_as_string(vmg0_)) != 0)
+        {
+            put_byte('s');
+            put(str, VMB_LEN + vmb_get_len(str));
+            return TRUE;
+        }
+        if ((lst = val->get_as_list(vmg0_)) != 0)
+        {
+            /* don't go too deep into nested lists */
+            if (depth >= VMDYNCOMP_SIG_DEPTH)
+                return FALSE;
+
+            /* add the element count, then each element */
+            size_t cnt = vmb_get_len(lst);
+            put_byte('l');
+            put(lst, VMB_LEN);
+            for (size_t i = 1 ; i <= cnt ; ++i)
+            {
+                vm_val_t ele;
+                CVmObjList::index_list(vmg_ &ele, lst, i);
+                if (!add_val(vmg_ &ele, depth + 1))
+                    return FALSE;
+            }
+            return TRUE;
+        }
+
+        /* for anything else, add the type and the scalar value */
+        put_byte((char)val->typ);
+        switch (val->typ)
+        {
+        case VM_NIL:
+        case VM_TRUE:
+        case VM_EMPTY:
+            return TRUE;
+
+        case VM_OBJ:
+            /* only root-set objects have stable IDs */
+            if (!G_obj_table->is_obj_in_root_set(val->val.obj))
+                return FALSE;
+            put(&val->val.obj, sizeof(val->val.obj));
+            return TRUE;
+
+        case VM_PROP:
+            put(&val->val.prop, sizeof(val->val.prop));
+            return TRUE;
+
+        case VM_INT:
+            put(&val->val.intval, sizeof(val->val.intval));
+            return TRUE;
+
+        case VM_ENUM:
+            put(&val->val.enumval, sizeof(val->val.enumval));
+            return TRUE;
+
+        case VM_FUNCPTR:
+        case VM_CODEOFS:
+            put(&val->val.ofs, sizeof(val->val.ofs));
+            return TRUE;
+
+        case VM_BIFPTR:
+            put(&val->val.bifptr.set_idx, sizeof(val->val.bifptr.set_idx));
+            put(&val->val.bifptr.func_idx, sizeof(val->val.bifptr.func_idx));
+            return TRUE;
+
+        default:
+            /* other types aren't used as symbol values */
+            return FALSE;
+        }
+    }
+
+    /* does this signature match the given buffer? */
+    int matches(const char *buf, size_t len) const
+        { return len == len_ && (len == 0 || memcmp(buf, buf_, len) == 0); }
+
+    /* take ownership of the buffer */
+    char *detach(size_t *len)
+    {
+        char *ret = buf_;
+        *len = len_;
+        buf_ = 0;
+        len_ = alo_ = 0;
+        return ret;
+    }
+
+protected:
+    /* append bytes */
+    void put(const void *p, size_t len)
+    {
+        if (len_ + len > alo_)
+        {
+            alo_ = (len_ + len + 63) & ~(size_t)63;
+            buf_ = (char *)t3realloc(buf_, alo_);
+        }
+        memcpy(buf_ + len_, p, len);
+        len_ += len;
+    }
+    void put_byte(char c) { put(&c, 1); }
+
+    char *buf_;
+    size_t len_;
+    size_t alo_;
+};
+
+/*
+ *   Symbol dependency.  This records one name that the compiler looked up
+ *   in a program symbol table or macro table, and the signature of the
+ *   value it found there.  
+ */
+struct vm_dyncomp_dep
+{
+    /* next dependency in the list */
+    vm_dyncomp_dep *nxt;
+
+    /* TRUE if this is a macro table lookup, FALSE for the symbol table */
+    int is_macro;
+
+    /* the symbol name */
+    char *name;
+    size_t namelen;
+
+    /* the value signature */
+    char *sig;
+    size_t siglen;
+};
+
+/*
+ *   Look up a symbol in a program table, and compute the signature of the
+ *   value.  Returns false if the value isn't representable. 
+ */
+static int dyncomp_lookup_sig(VMG_ vm_obj_id_t tab,
+                              const char *sym, size_t len,
+                              CVmDynCompSig *sig)
+{
+    /* create a string for the symbol name; stack it for gc protection */
+    vm_val_t symstr;
+    symstr.set_obj(CVmObjString::create(vmg_ FALSE, sym, len));
+    G_stk->push(&symstr);
+
+    /* look up the symbol string in the table */
+    vm_val_t symval;
+    vm_objp(vmg_ tab)->index_val_ov(vmg_ &symval, tab, &symstr);
+    G_stk->push(&symval);
+
+    /* build the signature */
+    int ok = sig->add_val(vmg_ &symval, 0);
+
+    /* done with the gc protection */
+    G_stk->discard(2);
+    return ok;
+}
+
+/*
+ *   Dependency list for a compilation in progress 
+ */
+class CVmDynCompDeps
+{
+public:
+    CVmDynCompDeps() : head_(0), ok_(TRUE) { }
+    ~CVmDynCompDeps() { free_list(head_); }
+
+    /* record a lookup and the value found */
+    void add(VMG_ int is_macro, const char *sym, size_t len,
+             const vm_val_t *val)
+    {
+        /* if we've already given up on caching, don't bother */
+        if (!ok_)
+            return;
+
+        /* build the signature; if we can't, the result isn't cacheable */
+        CVmDynCompSig sig;
+        if (!sig.add_val(vmg_ val, 0))
+        {
+            ok_ = FALSE;
+            return;
+        }
+
+        /* add the dependency */
+        vm_dyncomp_dep *dep = (vm_dyncomp_dep *)t3malloc(sizeof(*dep));
+        dep->is_macro = is_macro;
+        dep->name = lib_copy_str(sym, len);
+        dep->namelen = len;
+        dep->sig = sig.detach(&dep->siglen);
+        dep->nxt = head_;
+        head_ = dep;
+    }
+
+    /* is the compilation still cacheable? */
+    int is_ok() const { return ok_; }
+
+    /* take ownership of the list */
+    vm_dyncomp_dep *detach()
+    {
+        vm_dyncomp_dep *ret = head_;
+        head_ = 0;
+        return ret;
+    }
+
+    /* free a dependency list */
+    static void free_list(vm_dyncomp_dep *dep)
+    {
+        for (vm_dyncomp_dep *nxt ; dep != 0 ; dep = nxt)
+        {
+            nxt = dep->nxt;
+            lib_free_str(dep->name);
+            if (dep->sig != 0)
+                t3free(dep->sig);
+            t3free(dep);
+        }
+    }
+
+protected:
+    /* head of the dependency list */
+    vm_dyncomp_dep *head_;
+
+    /* are we still cacheable? */
+    int ok_;
+};
+
+/*
+ *   Cache entry 
+ */
+struct vm_dyncomp_entry
+{
+    /* next entry in the cache list */
+    vm_dyncomp_entry *nxt;
+
+    /* hash of the source text */
+    unsigned long hash;
+
+    /* the compilation mode */
+    CVmDynCompMode mode;
+
+    /* did the compilation have a symbol table and a macro table? */
+    int has_globals;
+    int has_macros;
+
+    /* the source text */
+    char *src;
+    size_t srclen;
+
+    /* the symbol and macro lookups the compilation depended upon */
+    vm_dyncomp_dep *deps;
+
+    /* the generated byte code */
+    char *bytecode;
+    size_t bytecode_len;
+};
+
+/* compute the hash of a source string */
+static unsigned long dyncomp_hash(const char *src, size_t len)
+{
+    unsigned long h = 2166136261UL;
+    for ( ; len != 0 ; --len, ++src)
+        h = ((h ^ (unsigned char)*src) * 16777619UL) & 0xffffffffUL;
+    return h;
+}
+
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Dynamic compiler symbol table interface.  This provides the compiler
@@ -708,7 +1017,8 @@ class CVmDynFuncSymtab: public CTcPrsSymtab
 {
 public:
     /* initialize with a source object */
-    CVmDynFuncSymtab(VMG_ vm_obj_id_t globals, vm_obj_id_t locals)
+    CVmDynFuncSymtab(VMG_ vm_obj_id_t globals, vm_obj_id_t locals,
+                     CVmDynCompDeps *deps)
         : CTcPrsSymtab(0)
     {
         /* remember the globals */
@@ -717,6 +1027,9 @@ public:
         /* remember my symbol table objects */
         globals_ = globals;
         locals_ = locals;
+
+        /* remember the dependency recorder */
+        deps_ = deps;
     }
 
     /* find a symbol - implementation of CTcPrsDbgSymtab interface */
@@ -854,6 +1167,10 @@ private:
         vm_objp(vmg_ globals_)->index_val_ov(vmg_ &symval, globals_, &symstr);
         G_stk->push(&symval);
 
+        /* record the dependency for the compiled-code cache */
+        if (deps_ != 0)
+            deps_->add(vmg_ FALSE, sym, len, &symval);
+
         /* check what we found */
         switch (symval.typ)
         {
@@ -979,6 +1296,9 @@ private:
     /* the local and global symbol table objects */
     vm_obj_id_t globals_;
     vm_obj_id_t locals_;
+
+    /* dependency recorder for the compiled-code cache, if caching */
+    CVmDynCompDeps *deps_;
 };
 
 
@@ -991,14 +1311,18 @@ private:
 class CVmDynFuncMacros:  public CTcMacroTable
 {
 public:
-    CVmDynFuncMacros(VMG_ vm_obj_id_t tab)
-        : hash_(512, new CVmHashFuncCS(), TRUE)
+    CVmDynFuncMacros(VMG_ vm_obj_id_t tab, CVmDynCompDeps *deps)
+        : hash_(512, new CVmHashFuncCS(), TRUE),
+          miss_(256, new CVmHashFuncCS(), TRUE)
     {
         /* remember the globals */
         globals_ = VMGLOB_ADDR;
 
         /* remember my symbol table object */
         tab_ = tab;
+
+        /* remember the dependency recorder */
+        deps_ = deps;
     }
 
     /* find an entry */
@@ -1015,6 +1339,14 @@ public:
         if (tab_ == VM_INVALID_OBJ)
             return 0;
 
+        /* 
+         *   if we've already looked this symbol up and found that it's not
+         *   a macro, don't look again - the tokenizer checks every symbol
+         *   token for expansion, and most of them aren't macros 
+         */
+        if (miss_.find(sym, len) != 0)
+            return 0;
+
         /* establish access to globals */
         VMGLOB_PTR(globals_);
 
@@ -1028,6 +1360,10 @@ public:
         vm_objp(vmg_ tab_)->index_val_ov(vmg_ &symval, tab_, &symstr);
         G_stk->push(&symval);
 
+        /* record the dependency for the compiled-code cache */
+        if (deps_ != 0)
+            deps_->add(vmg_ TRUE, sym, len, &symval);
+
         /* it has to be a list, and it has to have at least three elements */
         const char *lst = symval.get_as_list(vmg0_);
         if (lst != 0 && vmb_get_len(lst) >= 3)
@@ -1100,6 +1436,10 @@ public:
         /* done with our gc protection */
         G_stk->discard(2);
 
+        /* if it's not a macro, remember that for next time */
+        if (entry == 0)
+            miss_.add(new CVmHashEntryCS(sym, len, TRUE));
+
         /* return what we found */
         return entry;
     }
@@ -1123,8 +1463,14 @@ private:
     /* the user LookupTable object */
     vm_obj_id_t tab_;
 
+    /* dependency recorder for the compiled-code cache, if caching */
+    CVmDynCompDeps *deps_;
+
     /* our cache of symbols we've already translated */
     CVmHashTable hash_;
+
+    /* symbols we've looked up and found not to be macros */
+    CVmHashTable miss_;
 };
 
 
@@ -1464,6 +1810,10 @@ CVmDynamicCompiler::CVmDynamicCompiler(VMG0_)
 
     /* point the compiler to the loaded metaclass table */
     G_metaclass_tab = G_meta_table;
+
+    /* nothing in the compiled-code cache yet */
+    cache_ = 0;
+    cache_cnt_ = 0;
 }
 
 /*
@@ -1471,6 +1821,9 @@ CVmDynamicCompiler::CVmDynamicCompiler(VMG0_)
  */
 CVmDynamicCompiler::~CVmDynamicCompiler()
 {
+    /* discard the compiled-code cache */
+    clear_cache();
+
     /* terminate the compiler */
     CTcMain::terminate();
 
@@ -1509,6 +1862,29 @@ vm_obj_id_t CVmDynamicCompiler::compile(
     int frame_has_self = FALSE;
     CVmObjFrameDesc *framedesc = 0;
     CVmObjFrameRef *frameref = 0;
+
+    /*
+     *   Check the compiled-code cache.  We only cache plain compilations:
+     *   debugger evaluations and code that refers to local variables in
+     *   enclosing stack frames depend on the run-time state of those
+     *   frames, and grammar rules don't produce byte code at all.  
+     */
+    int cacheable = (dbg == 0 && locals == VM_INVALID_OBJ
+                     && mode != DCModeGramAlt);
+    if (cacheable)
+    {
+        vm_obj_id_t id = find_cached(vmg_ in_root_set, globals, macros,
+                                     srcval, src, srclen, mode);
+        if (id != VM_INVALID_OBJ)
+        {
+            results->err = 0;
+            results->free_msgbuf();
+            return id;
+        }
+    }
+
+    /* if we're caching, record the symbols we look up */
+    CVmDynCompDeps deps;
     
     /* 
      *   save the parser memory pool state, so we can reset it when we're
@@ -1545,11 +1921,13 @@ vm_obj_id_t CVmDynamicCompiler::compile(
     {
         /* install a new symbol table; remember the old one to restore */
         old_global_symtab = G_prs->set_global_symtab(
-            new CVmDynFuncSymtab(vmg_ globals, locals));
+            new CVmDynFuncSymtab(vmg_ globals, locals,
+                                 cacheable ? &deps : 0));
 
         /* install a new macro table; remember the old one to restore */
         old_macros = G_tok->set_defines_table(
-            new_macros = new CVmDynFuncMacros(vmg_ macros));
+            new_macros = new CVmDynFuncMacros(vmg_ macros,
+                                              cacheable ? &deps : 0));
     }
     
     /* presume no error will occur */
@@ -1868,6 +2246,17 @@ vm_obj_id_t CVmDynamicCompiler::compile(
         goto done;
     }
 
+    /* 
+     *   Success.  Add the result to the cache if it's self-contained: it
+     *   can't have any nested code bodies, since those are separate
+     *   objects, and all of its object references must be to root-set
+     *   objects, since we can't keep anything else alive.  
+     */
+    if (cacheable && deps.is_ok() && G_prs->get_first_nested_stm() == 0
+        && ((CVmDynamicFunc *)vm_objp(vmg_ coid))->get_ext()->obj_ref_cnt
+           == 0)
+        add_cached(vmg_ coid, globals, macros, src, srclen, mode, &deps);
+
 done:
     /* restore the original symbol table and macros in the parser */
     G_prs->set_debug_symtab(old_symtab);
@@ -1914,6 +2303,156 @@ done:
     return coid;
 }
 
+/*
+ *   Look for a cached compilation 
+ */
+vm_obj_id_t CVmDynamicCompiler::find_cached(
+    VMG_ int in_root_set, vm_obj_id_t globals, vm_obj_id_t macros,
+    const vm_val_t *srcval, const char *src, size_t srclen,
+    CVmDynCompMode mode)
+{
+    unsigned long hash = dyncomp_hash(src, srclen);
+    vm_dyncomp_entry *e, *prv;
+
+    /* scan the cache */
+    for (prv = 0, e = cache_ ; e != 0 ; prv = e, e = e->nxt)
+    {
+        /* check the key */
+        if (e->hash != hash || e->srclen != srclen || e->mode != mode
+            || e->has_globals != (globals != VM_INVALID_OBJ)
+            || e->has_macros != (macros != VM_INVALID_OBJ)
+            || memcmp(e->src, src, srclen) != 0)
+            continue;
+
+        /* 
+         *   The source matches.  Repeat the compiler's symbol lookups to
+         *   make sure they'd all come out the same way.  If a lookup throws
+         *   an error, let the compiler run into it and report it as usual.
+         */
+        vm_dyncomp_dep *dep = e->deps;
+        int stale = FALSE;
+        err_try
+        {
+            for ( ; dep != 0 ; dep = dep->nxt)
+            {
+                CVmDynCompSig sig;
+                if (!dyncomp_lookup_sig(
+                        vmg_ dep->is_macro ? macros : globals,
+                        dep->name, dep->namelen, &sig)
+                    || !sig.matches(dep->sig, dep->siglen))
+                {
+                    stale = TRUE;
+                    break;
+                }
+            }
+        }
+        err_catch_disc
+        {
+            /* treat the entry as stale */
+            stale = TRUE;
+        }
+        err_end;
+
+        /* if a dependency changed, the entry is stale - drop it */
+        if (stale)
+        {
+            if (prv != 0)
+                prv->nxt = e->nxt;
+            else
+                cache_ = e->nxt;
+            --cache_cnt_;
+
+            CVmDynCompDeps::free_list(e->deps);
+            t3free(e->bytecode);
+            t3free(e->src);
+            t3free(e);
+            return VM_INVALID_OBJ;
+        }
+
+        /* move the entry to the head of the list */
+        if (prv != 0)
+        {
+            prv->nxt = e->nxt;
+            e->nxt = cache_;
+            cache_ = e;
+        }
+
+        /* create a new DynamicFunc with a copy of the byte code */
+        vm_obj_id_t coid = vm_new_id(vmg_ in_root_set, TRUE, FALSE);
+        CVmDynamicFunc *co = new (vmg_ coid) CVmDynamicFunc(
+            vmg_ coid, srcval, e->bytecode_len, 0);
+        memcpy(co->get_ext()->get_bytecode_ptr(), e->bytecode,
+               e->bytecode_len);
+
+        /* return the new object */
+        return coid;
+    }
+
+    /* not found */
+    return VM_INVALID_OBJ;
+}
+
+/*
+ *   Add a compilation to the cache 
+ */
+void CVmDynamicCompiler::add_cached(
+    VMG_ vm_obj_id_t coid, vm_obj_id_t globals, vm_obj_id_t macros,
+    const char *src, size_t srclen, CVmDynCompMode mode,
+    CVmDynCompDeps *deps)
+{
+    /* get the byte code from the object we just generated */
+    vm_dynfunc_ext *ext = ((CVmDynamicFunc *)vm_objp(vmg_ coid))->get_ext();
+
+    /* if the cache is full, drop the least recently used entry */
+    if (cache_cnt_ >= VMDYNCOMP_CACHE_MAX)
+    {
+        vm_dyncomp_entry **pp;
+        for (pp = &cache_ ; (*pp)->nxt != 0 ; pp = &(*pp)->nxt) ;
+
+        CVmDynCompDeps::free_list((*pp)->deps);
+        t3free((*pp)->bytecode);
+        t3free((*pp)->src);
+        t3free(*pp);
+        *pp = 0;
+        --cache_cnt_;
+    }
+
+    /* set up the new entry */
+    vm_dyncomp_entry *e = (vm_dyncomp_entry *)t3malloc(sizeof(*e));
+    e->hash = dyncomp_hash(src, srclen);
+    e->mode = mode;
+    e->has_globals = (globals != VM_INVALID_OBJ);
+    e->has_macros = (macros != VM_INVALID_OBJ);
+    e->src = (char *)t3malloc(srclen + 1);
+    memcpy(e->src, src, srclen);
+    e->srclen = srclen;
+    e->deps = deps->detach();
+    e->bytecode_len = ext->bytecode_len;
+    e->bytecode = (char *)t3malloc(ext->bytecode_len + 1);
+    memcpy(e->bytecode, ext->get_bytecode_ptr(), ext->bytecode_len);
+
+    /* link it in at the head of the list */
+    e->nxt = cache_;
+    cache_ = e;
+    ++cache_cnt_;
+}
+
+/*
+ *   Delete the compiled-code cache 
+ */
+void CVmDynamicCompiler::clear_cache()
+{
+    for (vm_dyncomp_entry *nxt ; cache_ != 0 ; cache_ = nxt)
+    {
+        nxt = cache_->nxt;
+        CVmDynCompDeps::free_list(cache_->deps);
+        t3free(cache_->bytecode);
+        t3free(cache_->src);
+        t3free(cache_);
+    }
+    cache_cnt_ = 0;
+}
+
 /*
  *   Generate code for a parsed code body.  Parsing a single block of source
  *   code might yield multiple parsed code bodies, because anonymous
@@ -520,11 +520,44 @@ protected:
         VMG_ class CTPNStmTop *node, const vm_val_t *srcval,
         CVmDynCompDebug *dbg);
 
+    /* 
+     *   Look for a cached compilation of the given source, and create a new
+     *   DynamicFunc from it if we find one whose symbol dependencies still
+     *   hold.  Returns VM_INVALID_OBJ if there's no usable cache entry. 
+     */
+    vm_obj_id_t find_cached(VMG_ int in_root_set,
+                            vm_obj_id_t globals, vm_obj_id_t macros,
+                            const vm_val_t *srcval,
+                            const char *src, size_t srclen,
+                            CVmDynCompMode mode);
+
+    /* 
+     *   Add a successful compilation to the cache.  This takes ownership of
+     *   the dependency list. 
+     */
+    void add_cached(VMG_ vm_obj_id_t coid,
+                    vm_obj_id_t globals, vm_obj_id_t macros,
+                    const char *src, size_t srclen, CVmDynCompMode mode,
+                    class CVmDynCompDeps *deps);
+
+    /* delete all cache entries */
+    void clear_cache();
+
     /* parser */
     class CTcParser *prs_;
 
     /* compiler host interface */
     class CTcHostIfcDynComp *hostifc_;
+
+    /* 
+     *   Compiled-code cache.  This is a list of recently compiled source
+     *   strings, with the byte code we generated for each one, most
+     *   recently used first.  
+     */
+    struct vm_dyncomp_entry *cache_;
+
+    /* number of entries in the cache */
+    int cache_cnt_;
 };
 
 
@@ -34,6 +34,10 @@ CVmFile::~CVmFile()
     /* if we still have an underlying OS file, close it */
     if (fp_ != 0)
         osfcls(fp_);
+
+    /* if we have a memory buffer, free it */
+    if (mem_ != 0)
+        t3free(mem_);
 }
 
 /*
@@ -61,3 +65,105 @@ void CVmFile::open_write(const char *fname, os_filetype_t typ)
     if (fp_ == 0)
         err_throw(VMERR_CREATE_FILE);
 }
+
+/*
+ *   open a memory file 
+ */
+void CVmFile::open_memory()
+{
+    /* allocate an initial buffer; we'll expand it as needed */
+    mem_size_ = 64*1024;
+    mem_ = (char *)t3malloc(mem_size_);
+    if (mem_ == 0)
+        err_throw(VMERR_OUT_OF_MEMORY);
+
+    /* the file is empty, and we're at the start of it */
+    mem_len_ = mem_pos_ = 0;
+}
+
+/*
+ *   open a memory file on existing data 
+ */
+void CVmFile::open_memory(char *buf, size_t len)
+{
+    /* take over the buffer, and start at the beginning of the data */
+    mem_ = buf;
+    mem_len_ = mem_size_ = len;
+    mem_pos_ = 0;
+}
+
+/*
+ *   detach the memory buffer 
+ */
+char *CVmFile::detach_memory(size_t *len)
+{
+    /* hand the buffer and its length to the caller */
+    char *buf = mem_;
+    *len = mem_len_;
+
+    /* forget the buffer */
+    mem_ = 0;
+    mem_len_ = mem_size_ = mem_pos_ = 0;
+
+    /* return the buffer */
+    return buf;
+}
+
+/*
+ *   read from a memory file; returns the number of bytes read 
+ */
+size_t CVmFile::mem_read(char *buf, size_t buflen)
+{
+    /* limit the read to the data available */
+    size_t avail = (mem_pos_ < mem_len_ ? mem_len_ - mem_pos_ : 0);
+    if (buflen > avail)
+        buflen = avail;
+
+    /* copy the data and advance the position */
+    memcpy(buf, mem_ + mem_pos_, buflen);
+    mem_pos_ += buflen;
+    return buflen;
+}
+
+/*
+ *   write to a memory file 
+ */
+void CVmFile::mem_write(const char *buf, size_t buflen)
+{
+    /* expand the buffer if necessary */
+    if (mem_pos_ + buflen > mem_size_)
+    {
+        /* double the size until the new data fit */
+        size_t newsize = (mem_size_ != 0 ? mem_size_ : 1024);
+        while (mem_pos_ + buflen > newsize)
+            newsize *= 2;
+
+        char *newmem = (char *)t3realloc(mem_, newsize);
+        if (newmem == 0)
+            err_throw(VMERR_OUT_OF_MEMORY);
+
+        mem_ = newmem;
+        mem_size_ = newsize;
+    }
+
+    /* if we're positioned past the end of the data, zero the gap */
+    if (mem_pos_ > mem_len_)
+        memset(mem_ + mem_len_, 0, mem_pos_ - mem_len_);
+
+    /* copy the data and advance the position */
+    memcpy(mem_ + mem_pos_, buf, buflen);
+    mem_pos_ += buflen;
+
+    /* extend the data length if we wrote past the old end */
+    if (mem_pos_ > mem_len_)
+        mem_len_ = mem_pos_;
+}
+
+/*
+ *   seek in a memory file 
+ */
+void CVmFile::mem_seek(long pos)
+{
+    /* don't allow seeking before the start of the file */
+    mem_pos_ = (pos < 0 ? 0 : (size_t)pos);
+}
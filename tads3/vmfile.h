@@ -42,12 +42,18 @@ public:
 
         /* presume the base seek position is at the start of the file */
         seek_base_ = 0;
+
+        /* we're not a memory file */
+        mem_ = 0;
+        mem_len_ = mem_size_ = mem_pos_ = 0;
     }
 
     CVmFile(osfildef *fp, long seek_base)
     {
         fp_ = fp;
         seek_base_ = seek_base;
+        mem_ = 0;
+        mem_len_ = mem_size_ = mem_pos_ = 0;
     }
 
     /* 
@@ -115,9 +121,42 @@ public:
      */
     void open_write(const char *fname, os_filetype_t typ);
 
+    /*
+     *   Open an empty memory file.  Instead of going to an OS file, the
+     *   data are written to a growable buffer in memory, which can be read
+     *   back and repositioned like an ordinary file.  This lets the caller
+     *   generate a file image (such as a saved game) without doing any
+     *   disk I/O, and then hand off the finished bytes with
+     *   detach_memory().
+     */
+    void open_memory();
+
+    /*
+     *   Open a memory file on existing data.  'buf' must be allocated with
+     *   t3malloc(); we take ownership of it, and free it when the file is
+     *   closed.  The file is positioned at the start of the data.  
+     */
+    void open_memory(char *buf, size_t len);
+
+    /*
+     *   Detach the memory buffer from a memory file.  Returns the buffer,
+     *   allocated with t3malloc(), and fills in '*len' with the number of
+     *   bytes written.  The caller takes ownership of the buffer and must
+     *   free it with t3free().  The file is closed after this call.
+     */
+    char *detach_memory(size_t *len);
+
     /* close the underlying file */
     void close()
     {
+        if (mem_ != 0)
+        {
+            t3free(mem_);
+            mem_ = 0;
+            mem_len_ = mem_size_ = mem_pos_ = 0;
+            return;
+        }
+
         osfcls(fp_);
         fp_ = 0;
     }
@@ -125,7 +164,7 @@ public:
     /* flush buffers */
     void flush()
     {
-        if (osfflush(fp_))
+        if (mem_ == 0 && osfflush(fp_))
             err_throw(VMERR_WRITE_FILE);
     }
 
@@ -142,7 +181,15 @@ public:
     /* read bytes - throws an error if all of the bytes cannot be read */
     void read_bytes(char *buf, size_t buflen)
     {
-        if (buflen != 0 && osfrb(fp_, buf, buflen))
+        if (buflen == 0)
+            return;
+
+        if (mem_ != 0)
+        {
+            if (mem_read(buf, buflen) != buflen)
+                err_throw(VMERR_READ_FILE);
+        }
+        else if (osfrb(fp_, buf, buflen))
             err_throw(VMERR_READ_FILE);
     }
 
@@ -156,7 +203,10 @@ public:
      */
     size_t read_nbytes(char *buf, size_t buflen)
     {
-        return buflen == 0 ? 0 : osfrbc(fp_, buf, buflen);
+        if (buflen == 0)
+            return 0;
+
+        return mem_ != 0 ? mem_read(buf, buflen) : osfrbc(fp_, buf, buflen);
     }
 
     /* read a line (fgets semantics) */
@@ -256,27 +306,62 @@ public:
     /* write bytes - throws an error if the bytes cannot be written */
     void write_bytes(const char *buf, size_t buflen)
     {
-        if (buflen != 0 && osfwb(fp_, buf, buflen))
+        if (buflen == 0)
+            return;
+
+        if (mem_ != 0)
+            mem_write(buf, buflen);
+        else if (osfwb(fp_, buf, buflen))
             err_throw(VMERR_WRITE_FILE);
     }
 
     /* get the current seek position */
-    long get_pos() const { return osfpos(fp_) - seek_base_; }
+    long get_pos() const
+    {
+        if (mem_ != 0)
+            return (long)mem_pos_;
+
+        return osfpos(fp_) - seek_base_;
+    }
 
     /* seek to a new position */
     void set_pos(long seekpos)
     {
+        /* for a memory file, just move the buffer position */
+        if (mem_ != 0)
+        {
+            mem_seek(seekpos);
+            return;
+        }
+
         /* seek relative to the base seek position */
         osfseek(fp_, seekpos + seek_base_, OSFSK_SET);
     }
 
     /* seek to a position relative to the end of the file */
-    void set_pos_from_eof(long pos) { osfseek(fp_, pos, OSFSK_END); }
+    void set_pos_from_eof(long pos)
+    {
+        if (mem_ != 0)
+            mem_seek((long)mem_len_ + pos);
+        else
+            osfseek(fp_, pos, OSFSK_END);
+    }
 
     /* seek to a position relative to the current file position */
-    void set_pos_from_cur(long pos) { osfseek(fp_, pos, OSFSK_CUR); }
+    void set_pos_from_cur(long pos)
+    {
+        if (mem_ != 0)
+            mem_seek((long)mem_pos_ + pos);
+        else
+            osfseek(fp_, pos, OSFSK_CUR);
+    }
 
 protected:
+    /* memory file operations */
+    size_t mem_read(char *buf, size_t buflen);
+    void mem_write(const char *buf, size_t buflen);
+    void mem_seek(long pos);
+
     /* our underlying OS file handle */
     osfildef *fp_;
 
@@ -289,6 +374,17 @@ protected:
      *   embedded stream ends at the end of the enclosing file. 
      */
     long seek_base_;
+
+    /* 
+     *   Memory file buffer, if we're a memory file (null otherwise).
+     *   mem_len_ is the number of bytes of data written, mem_size_ is the
+     *   allocated size of the buffer, and mem_pos_ is the current
+     *   read/write position.  
+     */
+    char *mem_;
+    size_t mem_len_;
+    size_t mem_size_;
+    size_t mem_pos_;
 };
 
 /* ------------------------------------------------------------------------ */
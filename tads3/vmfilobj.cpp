@@ -88,7 +88,8 @@ int (CVmObjFile::
     &CVmObjFile::getp_packBytes,                                      /* 21 */
     &CVmObjFile::getp_unpackBytes,                                    /* 22 */
     &CVmObjFile::getp_sha256,                                         /* 23 */
-    &CVmObjFile::getp_digestMD5                                       /* 24 */
+    &CVmObjFile::getp_digestMD5,                                      /* 24 */
+    &CVmObjFile::getp_readLines                                       /* 25 */
 };
 
 /*
@@ -1654,6 +1655,9 @@ void CVmObjFile::read_text_mode(VMG_ vm_val_t *retval)
         ((CVmObjCharSet *)vm_objp(vmg_ get_ext()->charset))
         ->get_to_uni(vmg0_);
 
+    /* note whether we can copy ASCII text straight through */
+    int ascii = charmap->is_ascii_transparent();
+
     /* replenish the buffer if it's empty */
     if (readbuf->rem == 0 && !readbuf->refill(fp))
     {
@@ -1684,6 +1688,35 @@ void CVmObjFile::read_text_mode(VMG_ vm_val_t *retval)
      */
     for (;;)
     {
+        /*
+         *   If the mapping passes ASCII through unchanged, copy the run of
+         *   ordinary ASCII characters at the read pointer as a block.  We
+         *   leave newlines and nulls to the character-by-character path
+         *   below. 
+         */
+        if (ascii)
+        {
+            size_t n;
+            for (n = 0 ; n < readbuf->rem ; ++n)
+            {
+                unsigned char c = (unsigned char)readbuf->ptr[n];
+                if (c == 0 || c > 127 || c == '\n' || c == '\r')
+                    break;
+            }
+
+            if (n != 0)
+            {
+                /* copy the run into the string */
+                dst = str->cons_ensure_space(vmg_ dst, n, 128);
+                memcpy(dst, readbuf->ptr, n);
+                dst += n;
+
+                /* consume it, and go back for more */
+                readbuf->commit_peek(n);
+                continue;
+            }
+        }
+
         /* read the next character; if we can't, we're at EOF */
         wchar_t ch;
         size_t chlen;
@@ -1730,6 +1763,92 @@ void CVmObjFile::read_text_mode(VMG_ vm_val_t *retval)
     G_stk->discard();
 }
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Property evaluator - read lines of text.  Reads up to the given number
+ *   of lines (or, if no limit is given, as many as will fit in a list) and
+ *   returns them as a list of strings, each in the same form readFile()
+ *   returns.  Returns nil if we're already at the end of the file.
+ */
+int CVmObjFile::getp_readLines(VMG_ vm_obj_id_t self, vm_val_t *retval,
+                               uint *in_argc)
+{
+    static CVmNativeCodeDesc desc(0, 1);
+    uint argc = (in_argc != 0 ? *in_argc : 0);
+
+    /* check arguments */
+    if (get_prop_check_argc(retval, in_argc, &desc))
+        return TRUE;
+
+    /* figure the most lines we can return in one list */
+    size_t max_cnt = (65535 - VMB_LEN) / VMB_DATAHOLDER;
+
+    /* if there's a line limit argument, apply it */
+    if (argc >= 1)
+    {
+        int32_t n = CVmBif::pop_int_val(vmg0_);
+        if (n < 1)
+            err_throw(VMERR_BAD_VAL_BIF);
+        if ((size_t)n < max_cnt)
+            max_cnt = (size_t)n;
+    }
+
+    /* push a self-reference for gc protection */
+    G_stk->push()->set_obj(self);
+
+    /* make sure we are allowed to perform operations on the file */
+    check_valid_file(vmg0_);
+
+    /* check that we have read access */
+    check_read_access(vmg0_);
+
+    /* this only works in text mode */
+    if (get_ext()->mode != VMOBJFILE_MODE_TEXT)
+        G_interpreter->throw_new_class(vmg_ G_predef->file_mode_exc,
+                                       0, "wrong file mode");
+
+    /* note the implicit seeking */
+    note_file_seek(vmg_ FALSE);
+
+    /* flush stdio buffers as needed and note the read operation */
+    switch_read_write_mode(vmg_ FALSE);
+
+    /* create the result list, and push it for gc protection */
+    vm_obj_id_t lstid = CVmObjList::create(vmg_ FALSE, (size_t)16);
+    CVmObjList *lst = (CVmObjList *)vm_objp(vmg_ lstid);
+    lst->cons_clear();
+    G_stk->push()->set_obj(lstid);
+
+    /* read lines until we reach the limit or the end of the file */
+    size_t cnt;
+    for (cnt = 0 ; cnt < max_cnt ; ++cnt)
+    {
+        /* read the next line; stop at end of file */
+        vm_val_t line;
+        read_text_mode(vmg_ &line);
+        if (line.typ == VM_NIL)
+            break;
+
+        /* add it to the list, leaving room to grow up to the limit */
+        size_t margin = max_cnt - cnt - 1;
+        lst->cons_ensure_space(vmg_ cnt, margin < 16 ? margin : 16);
+        lst->cons_set_element(cnt, &line);
+    }
+
+    /* set the final length; if we didn't read anything, return nil */
+    lst->cons_set_len(cnt);
+    if (cnt != 0)
+        retval->set_obj(lstid);
+    else
+        retval->set_nil();
+
+    /* discard the gc protection */
+    G_stk->discard(2);
+
+    /* handled */
+    return TRUE;
+}
+
 /*
  *   Read a value in 'data' mode 
  */
@@ -346,6 +346,9 @@ protected:
     /* property evaluator - digestMD5 */
     int getp_digestMD5(VMG_ vm_obj_id_t self, vm_val_t *retval, uint *argc);
 
+    /* property evaluator - readLines */
+    int getp_readLines(VMG_ vm_obj_id_t self, vm_val_t *retval, uint *argc);
+
     /* retrieve the filename and access arguments for an 'open' method */
     static class CVmNetFile *get_filename_and_access(
         VMG_ const struct vm_rcdesc *rc, int *access, int is_resource_file,
@@ -442,6 +445,13 @@ struct vmobjfile_ext_t
     struct vmobjfile_readbuf_t *readbuf;
 };
 
+/*
+ *   Text read buffer size.  This is large enough that reading a big text
+ *   file line by line doesn't go back to the underlying data source for
+ *   every few lines. 
+ */
+#define VMOBJFILE_READBUF_SIZE  4096
+
 /*
  *   File object text read buffer.  This is attached to the file extension
  *   if the file is opened in text mode with read access.  
@@ -455,7 +465,7 @@ struct vmobjfile_readbuf_t
     size_t rem;
 
     /* read buffer */
-    char buf[512];
+    char buf[VMOBJFILE_READBUF_SIZE];
 
     /* read a character */
     int getch(wchar_t &ch, CVmDataSource *fp, class CCharmapToUni *charmap);
@@ -589,7 +599,7 @@ class CVmMetaclassFile: public CVmMetaclass
 {
 public:
     /* get the global name */
-    const char *get_meta_name() const { return "file/030003"; }
+    const char *get_meta_name() const { return "file/030004"; }
 
     /* create from image file */
     void create_for_image_load(VMG_ vm_obj_id_t id)
@@ -72,6 +72,7 @@ struct re_replace_arg
         s = 0;
         pat = 0;
         pat_str = 0;
+        cache = 0;
         rpl_func.set_nil();
         match_valid = FALSE;
     }
@@ -81,6 +82,10 @@ struct re_replace_arg
         /* if we created the pattern object, delete it */
         if (pat != 0 && our_pat)
             CRegexParser::free_pattern(pat);
+
+        /* if we're using a cached pattern, release it */
+        if (pat != 0 && cache != 0)
+            cache->release(pat);
         if (s != 0)
             delete s;
     }
@@ -114,17 +119,35 @@ struct re_replace_arg
                 /* create the searcher */
                 create_searcher(vmg0_);
 
-                /* we treat strings as regular expressions - compile it */
-                re_status_t stat;
-                stat = G_bif_tads_globals->rex_parser->compile_pattern(
-                    str + VMB_LEN, vmb_get_len(str), &pat);
+                /* 
+                 *   We treat strings as regular expressions.  Look for a
+                 *   cached compilation first; if we find one, hold a
+                 *   reference on it, since compiling the other patterns in
+                 *   an argument list (or running a replacement callback)
+                 *   could otherwise evict it while we're using it.  
+                 */
+                CRegexCache *c = G_bif_tads_globals->rex_cache;
+                if ((pat = c->get(str + VMB_LEN, vmb_get_len(str))) != 0)
+                {
+                    /* got it - note that it belongs to the cache */
+                    c->add_ref(pat);
+                    cache = c;
+                    our_pat = FALSE;
+                }
+                else
+                {
+                    /* compile it */
+                    re_status_t stat;
+                    stat = G_bif_tads_globals->rex_parser->compile_pattern(
+                        str + VMB_LEN, vmb_get_len(str), &pat);
 
-                /* if that failed, we don't have a pattern */
-                if (stat != RE_STATUS_SUCCESS)
-                    pat = 0;
+                    /* if that failed, we don't have a pattern */
+                    if (stat != RE_STATUS_SUCCESS)
+                        pat = 0;
 
-                /* make a note that we allocated the pattern */
-                our_pat = TRUE;
+                    /* make a note that we allocated the pattern */
+                    our_pat = TRUE;
+                }
             }
             else
             {
@@ -275,6 +298,12 @@ struct re_replace_arg
     /* Did we create the pattern?  If so, delete it on destruction. */
     int our_pat;
 
+    /* 
+     *   the cache that owns our pattern, if we got it from the compiled
+     *   pattern cache; we release our reference on destruction 
+     */
+    CRegexCache *cache;
+
     /* our replacement string, or null if it's a callback function */
     const char *rpl_str;
 
@@ -115,6 +115,14 @@ public:
      */
     int argc_ok(int argc) const
     {
+        /* 
+         *   check for the common case of an exact match to a fixed-arity
+         *   function: the raw argument count byte is the exact count when
+         *   the varargs bit is clear 
+         */
+        if ((int)get_argc() == argc)
+            return TRUE;
+
         /* check for match to the min-max range */
         if (argc >= get_min_argc() && argc <= get_max_argc())
         {
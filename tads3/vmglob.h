@@ -537,6 +537,7 @@ inline void vmglob_delete(vm_globals *glob) { delete glob; }
 #define G_bif_table   VMGLOB_ACCESS(bif_table)
 #define G_varheap     VMGLOB_ACCESS(varheap)
 #define G_preinit_mode VMGLOB_ACCESS(preinit_mode)
+#define G_save_compress VMGLOB_ACCESS(save_compress)
 #define G_bif_tads_globals VMGLOB_ACCESS(bif_tads_globals)
 #define G_host_ifc    VMGLOB_ACCESS(host_ifc)
 #define G_image_loader VMGLOB_ACCESS(image_loader)
@@ -562,6 +563,9 @@ inline void vmglob_delete(vm_globals *glob) { delete glob; }
 #define G_iter_get_next  VMGLOB_ACCESS(iter_get_next)
 #define G_iter_next_avail  VMGLOB_ACCESS(iter_next_avail)
 #define G_tadsobj_queue  VMGLOB_PREACCESS(tadsobj_queue)
+#define G_tadsobj_cache  VMGLOB_PREACCESS(tadsobj_cache)
+#define G_tadsobj_insts  VMGLOB_PREACCESS(tadsobj_insts)
+#define G_tadsobj_shapes VMGLOB_PREACCESS(tadsobj_shapes)
 #define G_predef      VMGLOB_PREACCESS(predef)
 #define G_stk         G_interpreter
 #define G_interpreter VMGLOB_PREACCESS(interpreter)
@@ -572,6 +576,8 @@ inline void vmglob_delete(vm_globals *glob) { delete glob; }
 #define G_file_path   VMGLOB_ACCESS(file_path)
 #define G_sandbox_path VMGLOB_ACCESS(sandbox_path)
 #define G_tzcache     VMGLOB_ACCESS(tzcache)
+#define G_strhash_cache VMGLOB_ACCESS(strhash_cache)
+#define G_pack_cache  VMGLOB_ACCESS(pack_cache)
 #define G_debugger    VMGLOB_ACCESS(debugger)
 
 #endif /* VMGLOB_H */
@@ -63,6 +63,9 @@ VM_GLOBALS_BEGIN
     /* preinit mode flag */
     VM_GLOBAL_VARDEF(int, preinit_mode)
 
+    /* flag: compress saved state files */
+    VM_GLOBAL_VARDEF(int, save_compress)
+
     /* flag: error subsystem initialized outside of VM globals */
     VM_GLOBAL_VARDEF(int, err_pre_inited)
 
@@ -121,6 +124,15 @@ VM_GLOBALS_BEGIN
     /* TadsObject inheritance path analysis queue */
     VM_GLOBAL_PREOBJDEF(class CVmObjTadsInhQueue, tadsobj_queue)
 
+    /* TadsObject call-site property cache */
+    VM_GLOBAL_PREOBJDEF(class CVmObjTadsPropCache, tadsobj_cache)
+
+    /* TadsObject per-class instance index */
+    VM_GLOBAL_PREOBJDEF(class CVmObjTadsInstIndex, tadsobj_insts)
+
+    /* TadsObject property table shapes */
+    VM_GLOBAL_PREOBJDEF(class CVmObjTadsShapeTable, tadsobj_shapes)
+
     /* dynamic compiler */
     VM_GLOBAL_OBJDEF(class CVmDynamicCompiler, dyncomp)
 
@@ -161,6 +173,12 @@ VM_GLOBALS_BEGIN
    /* time zone cache */
    VM_GLOBAL_OBJDEF(class CVmTimeZoneCache, tzcache)
 
+   /* string hash cache */
+   VM_GLOBAL_OBJDEF(class CVmObjStrHashCache, strhash_cache)
+
+   /* parsed pack/unpack template cache */
+   VM_GLOBAL_OBJDEF(class CVmPackCache, pack_cache)
+
     /* size of header of each method's debug table */
    VM_GLOBAL_VARDEF(size_t, dbg_hdr_size)
 
@@ -42,6 +42,7 @@ Modified
 #include "vmfile.h"
 #include "vmbif.h"
 #include "vmdynfunc.h"
+#include "vmtrace.h"
 #include "vmpredef.h"
 
 
@@ -384,21 +385,86 @@ struct CVmGramProdMatchEntry
     CVmGramProdMatchEntry *nxt_;
 };
 
+/*
+ *   Sub-production match memo.  When a parsing state reaches a
+ *   sub-production item, the results of matching the sub-production depend
+ *   only on the production and the token position where the match starts -
+ *   not on the state that asked for it.  Ambiguous grammars ask for the
+ *   same sub-production at the same position over and over (once for each
+ *   way of parsing the tokens before that position), so rather than
+ *   enqueueing the sub-production's alternatives again for each request,
+ *   we keep one memo entry per (production, position) pair.
+ *   
+ *   The memo entry keeps a list of the states waiting for the
+ *   sub-production to match (the "waiters"), and a list of the matches
+ *   found so far (the "results").  Each time the sub-production completes
+ *   a match, we record the result and resume each waiter with it.  When a
+ *   new state asks for a sub-production that's already in the memo, we
+ *   simply add it to the waiter list and resume it with each result found
+ *   so far; it'll be resumed with any further results as they come in.  
+ */
+struct CVmGramProdMemoResult
+{
+    /* the match tree for the sub-production, with no target property */
+    const struct CVmGramProdMatch *match_;
+
+    /* token position at the end of the match */
+    size_t tok_pos_;
+
+    /* did the match end with a '*' item? */
+    int matched_star_;
+
+    /* next result for the same memo entry */
+    CVmGramProdMemoResult *nxt_;
+};
+
+struct CVmGramProdMemo
+{
+    /* the production object and starting token position */
+    vm_obj_id_t prod_obj_;
+    size_t tok_pos_;
+
+    /* 
+     *   The badness generation in which we created the entry.  Whenever we
+     *   fall back on the badness queue, the states that are promoted can
+     *   produce results that weren't available before, and a caller that
+     *   asks for the sub-production after that point must be able to
+     *   consider its own badness alternatives at the proper time as well.
+     *   To keep the results exactly the same as when each caller matched
+     *   the sub-production separately, we only share an entry within the
+     *   generation that created it.  
+     */
+    unsigned long gen_;
+
+    /* list of waiting states, linked through their nxt_ fields */
+    struct CVmGramProdState *waiters_;
+
+    /* results found so far */
+    CVmGramProdMemoResult *results_;
+
+    /* next entry in the same hash bucket */
+    CVmGramProdMemo *nxt_;
+};
+
+/* number of hash buckets in the memo table */
+#define VMGRAM_MEMO_HASH_SIZE  64
+
 /*
  *   Parsing state object.  At any given time, we will have one or more of
  *   these state objects in our processing queue.  A state object tracks a
  *   parsing position - the token position, the alternative position, the
  *   match list so far for the alternative (i.e., the match for each item
  *   in the alternative up to but not including the current position), and
- *   the enclosing parsing state object (i.e., the parsing state that
- *   "recursed" into this alternative).  
+ *   the memo entry for the sub-production match that this alternative is
+ *   part of, through which we'll resume the parsing states that
+ *   "recursed" into this alternative.  
  */
 struct CVmGramProdState
 {
     /* allocate */
     static CVmGramProdState *alloc(CVmGramProdMem *mem,
                                    int tok_pos, int alt_pos,
-                                   CVmGramProdState *enclosing,
+                                   CVmGramProdMemo *memo,
                                    const vmgram_alt_info *altp,
                                    vm_obj_id_t prod_obj,
                                    int circular_alt)
@@ -415,7 +481,7 @@ struct CVmGramProdState
                            + (match_cnt - 1)*sizeof(CVmGramProdMatch *));
 
         /* initialize */
-        state->init(tok_pos, alt_pos, enclosing, altp, prod_obj,
+        state->init(tok_pos, alt_pos, memo, altp, prod_obj,
                     circular_alt);
 
         /* return the new item */
@@ -423,7 +489,7 @@ struct CVmGramProdState
     }
     
     /* initialize */
-    void init(int tok_pos, int alt_pos, CVmGramProdState *enclosing,
+    void init(int tok_pos, int alt_pos, CVmGramProdMemo *memo,
               const vmgram_alt_info *altp, vm_obj_id_t prod_obj,
               int circular_alt)
     {
@@ -434,8 +500,8 @@ struct CVmGramProdState
         /* we haven't matched a '*' token yet */
         matched_star_ = FALSE;
 
-        /* remember our stack position */
-        enclosing_ = enclosing;
+        /* remember the memo entry for the sub-production we're matching */
+        memo_ = memo;
 
         /* remember our alternative image data pointer */
         altp_ = altp;
@@ -453,17 +519,16 @@ struct CVmGramProdState
         nxt_ = 0;
     }
 
-    /* clone the state */
+    /* 
+     *   clone the state (the memo entry is shared, since it's specific to
+     *   the production and starting position, not to the state) 
+     */
     CVmGramProdState *clone(CVmGramProdMem *mem)
     {
         CVmGramProdState *new_state;
-        CVmGramProdState *new_enclosing;
 
-        /* clone our enclosing state */
-        new_enclosing = (enclosing_ != 0 ? enclosing_->clone(mem) : 0);
-        
         /* create a new state object */
-        new_state = alloc(mem, tok_pos_, alt_pos_, new_enclosing,
+        new_state = alloc(mem, tok_pos_, alt_pos_, memo_,
                           altp_, prod_obj_, circular_alt_);
 
         /* copy the target sub-production property */
@@ -503,10 +568,12 @@ struct CVmGramProdState
     size_t alt_pos_;
 
     /* 
-     *   the enclosing state object - this is the state object that
-     *   "recursed" to our position 
+     *   the memo entry for the sub-production match this state is part of;
+     *   when we finish matching our alternative, we add the result to the
+     *   memo entry, which resumes the states that "recursed" to our
+     *   position.  This is null for a top-level state.  
      */
-    CVmGramProdState *enclosing_;
+    CVmGramProdMemo *memo_;
 
     /* pointer to alternative definition */
     const vmgram_alt_info *altp_;
@@ -548,6 +615,8 @@ struct CVmGramProdQueue
         work_queue_ = 0;
         badness_queue_ = 0;
         success_list_ = 0;
+        memo_tab_ = 0;
+        badness_gen_ = 0;
     }
 
     /* head of work queue */
@@ -558,6 +627,15 @@ struct CVmGramProdQueue
 
     /* head of success list */
     CVmGramProdMatchEntry *success_list_;
+
+    /* sub-production memo hash table, VMGRAM_MEMO_HASH_SIZE buckets */
+    CVmGramProdMemo **memo_tab_;
+
+    /* 
+     *   badness generation - we increment this each time we move states
+     *   from the badness queue to the work queue 
+     */
+    unsigned long badness_gen_;
 };
 
 /* ------------------------------------------------------------------------ */
@@ -569,6 +647,9 @@ struct CVmGramProdQueue
 static CVmMetaclassGramProd metaclass_reg_obj;
 CVmMetaclass *CVmObjGramProd::metaclass_reg_ = &metaclass_reg_obj;
 
+/* sub-production memo statistics */
+vmgram_memo_stats CVmObjGramProd::memo_stats_;
+
 /* function table */
 int (CVmObjGramProd::
      *CVmObjGramProd::func_table_[])(VMG_ vm_obj_id_t self,
@@ -651,6 +732,9 @@ CVmObjGramProd::CVmObjGramProd(VMG0_)
     get_ext()->hashes_cached_ = FALSE;
     get_ext()->comparator_ = VM_INVALID_OBJ;
 
+    /* we haven't built the first-item index yet */
+    get_ext()->first_idx_ = 0;
+
     /* presume we have no circular rules */
     get_ext()->has_circular_alt = FALSE;
 
@@ -686,6 +770,9 @@ void CVmObjGramProd::notify_delete(VMG_ int /*in_root_set*/)
             t3free(alts);
         }
 
+        /* delete the first-item index */
+        free_first_index();
+
         /* delete our memory pool */
         delete get_ext()->mem_;
 
@@ -709,6 +796,9 @@ void CVmObjGramProd::clear_alts()
 
     /* there are no more alternatives in the list */
     get_ext()->alt_cnt_ = 0;
+
+    /* the first-item index is no longer valid */
+    free_first_index();
 }
 
 /*
@@ -762,6 +852,13 @@ void CVmObjGramProd::insert_alt(
     /* we've been modified since load time */
     get_ext()->modified_ = TRUE;
 
+    /* 
+     *   the new alternative's literals don't have hash values yet, and the
+     *   first-item index doesn't include it 
+     */
+    get_ext()->hashes_cached_ = FALSE;
+    free_first_index();
+
     /* note if this adds a circular rule */
     if (alt->tok_cnt != 0
         && alt->toks->typ == VMGRAM_MATCH_PROD
@@ -783,6 +880,9 @@ void CVmObjGramProd::delete_alt(size_t idx)
 
     /* we've been modified since load time */
     get_ext()->modified_ = TRUE;
+
+    /* the alternative indices have changed, so rebuild the index */
+    free_first_index();
 }
 
 
@@ -1309,6 +1409,7 @@ int CVmObjGramProd::getp_parse(VMG_ vm_obj_id_t self,
     int succ_cnt;
     CVmGramProdMatchEntry *match;
     static CVmNativeCodeDesc desc(2);
+    CVmTraceSpan trace("vm", "grammar parse");
     
     /* check arguments */
     if (get_prop_check_argc(retval, argc, &desc))
@@ -1320,6 +1421,15 @@ int CVmObjGramProd::getp_parse(VMG_ vm_obj_id_t self,
     /* clear the work queues */
     queues.clear();
 
+    /* set up an empty sub-production memo table */
+    queues.memo_tab_ = (CVmGramProdMemo **)get_ext()->mem_->alloc(
+        VMGRAM_MEMO_HASH_SIZE * sizeof(queues.memo_tab_[0]));
+    memset(queues.memo_tab_, 0,
+           VMGRAM_MEMO_HASH_SIZE * sizeof(queues.memo_tab_[0]));
+
+    /* count the parse */
+    memo_stats_.parses++;
+
     /* 
      *   get the tokenList argument and make sure it's a list; leave it on
      *   the stack for now so it remains reachable for the garbage
@@ -1786,6 +1896,13 @@ void CVmObjGramProd::process_work_queue(VMG_ CVmGramProdMem *mem,
                     min_badness = cur->altp_->badness;
             }
 
+            /* 
+             *   we're starting a new badness generation, so existing memo
+             *   entries can't be shared with new requests after this
+             *   point 
+             */
+            queues->badness_gen_++;
+
             /* 
              *   move each of the items whose badness matches the minimum
              *   badness out of the badness queue and into the work queue 
@@ -1842,7 +1959,6 @@ void CVmObjGramProd::process_work_queue_head(VMG_ CVmGramProdMem *mem,
     CVmGramProdMatch *match;
     const vmgram_tok_info *tokp;
     int tok_matched_star;
-    vm_prop_id_t enclosing_target_prop;
     
     /* get the first entry from the queue */
     state = queues->work_queue_;
@@ -1892,23 +2008,23 @@ void CVmObjGramProd::process_work_queue_head(VMG_ CVmGramProdMem *mem,
 
                 /* 
                  *   set my subproduction target property, so that the
-                 *   sub-production can set the target property correctly 
+                 *   sub-production's matches get the target property
+                 *   correctly when we're resumed 
                  */
                 state->sub_target_prop_ = tokp->prop;
                 
-                /* enqueue the alternatives for the sub-production */
-                sub_objp->enqueue_alts(vmg_ mem, tok, tok_cnt,
-                                       state->tok_pos_, state, queues,
-                                       sub_obj_id, FALSE, 0, dict);
+                /* match the sub-production, via the memo table */
+                sub_objp->match_sub_prod(vmg_ mem, tok, tok_cnt, state,
+                                         queues, sub_obj_id, dict);
             }
 
             /* 
              *   Do not process the current state any further for now -
              *   we'll get back to it when (and if) we finish processing
              *   the sub-production.  Note that we don't even put the
-             *   current state back in the queue - it's stacked behind the
-             *   sub-production, and will be re-enqueued when we
-             *   successfully finish with the sub-production.  
+             *   current state back in the queue - it's waiting in the
+             *   sub-production's memo entry, and a copy of it will be
+             *   enqueued each time the sub-production finds a match.  
              */
             return;
             
@@ -2043,14 +2159,14 @@ void CVmObjGramProd::process_work_queue_head(VMG_ CVmGramProdMem *mem,
      *   the matched tokens with this production.  
      */
 
-    /* if we have an enclosing state, get its target property */
-    enclosing_target_prop = (state->enclosing_ != 0
-                             ? state->enclosing_->sub_target_prop_
-                             : VM_INVALID_PROP);
-
-    /* create a match for the entire alternative (i.e., the subproduction) */
+    /* 
+     *   Create a match for the entire alternative (i.e., the
+     *   subproduction).  The target property depends on the state that
+     *   we're resuming, so we leave it unset here; we'll fill it in for
+     *   each waiting state when we resume it.  
+     */
     match = CVmGramProdMatch::alloc(
-        mem, state->tok_pos_, 0, FALSE, enclosing_target_prop,
+        mem, state->tok_pos_, 0, FALSE, VM_INVALID_PROP,
         state->altp_->proc_obj, &state->match_list_[0],
         state->altp_->tok_cnt);
 
@@ -2099,28 +2215,28 @@ void CVmObjGramProd::process_work_queue_head(VMG_ CVmGramProdMem *mem,
          *   reference element).  
          */
         prod_objp->enqueue_alts(vmg_ mem, tok, tok_cnt, state->tok_pos_,
-                                state->enclosing_, queues, prod_obj_id,
+                                state->memo_, queues, prod_obj_id,
                                 TRUE, match, dict);
     }
 
-    /* check for an enclosing state to pop */
-    if (state->enclosing_ != 0)
+    /* check for a memo entry, which means we're matching a sub-production */
+    if (state->memo_ != 0)
     {
-        /* add the match to the enclosing state's match list */
-        state->enclosing_->match_list_[state->enclosing_->alt_pos_] = match;
-        state->enclosing_->alt_pos_++;
+        CVmGramProdMemo *memo = state->memo_;
+        CVmGramProdMemoResult *res;
+        CVmGramProdState *w;
 
-        /* 
-         *   Move the enclosing state's token position to our token position
-         *   - since it now encompasses our match, it has consumed all of
-         *   the tokens therein.  Likewise, set the '*' flag in the parent
-         *   to our own setting.  
-         */
-        state->enclosing_->tok_pos_ = state->tok_pos_;
-        state->enclosing_->matched_star_ = state->matched_star_;
+        /* add the result to the memo entry */
+        res = (CVmGramProdMemoResult *)mem->alloc(sizeof(*res));
+        res->match_ = match;
+        res->tok_pos_ = state->tok_pos_;
+        res->matched_star_ = state->matched_star_;
+        res->nxt_ = memo->results_;
+        memo->results_ = res;
 
-        /* enqueue the enclosing state so we can continue parsing it */
-        enqueue_state(state->enclosing_, queues);
+        /* resume each state waiting for the sub-production */
+        for (w = memo->waiters_ ; w != 0 ; w = w->nxt_)
+            resume_waiter(mem, w, res, queues);
     }
     else
     {
@@ -2163,7 +2279,7 @@ void CVmObjGramProd::process_work_queue_head(VMG_ CVmGramProdMem *mem,
 void CVmObjGramProd::enqueue_alts(VMG_ CVmGramProdMem *mem,
                                   const vmgramprod_tok *tok,
                                   size_t tok_cnt, size_t start_tok_pos,
-                                  CVmGramProdState *enclosing_state,
+                                  CVmGramProdMemo *memo,
                                   CVmGramProdQueue *queues, vm_obj_id_t self,
                                   int circ_only,
                                   CVmGramProdMatch *circ_match,
@@ -2171,19 +2287,9 @@ void CVmObjGramProd::enqueue_alts(VMG_ CVmGramProdMem *mem,
 {
     vmgram_alt_info *const *altp;
     size_t i;
-    int need_to_clone;
     int has_circ;
     vm_obj_id_t comparator;
 
-    /* 
-     *   We don't need to clone the enclosing state until we've set up one
-     *   new state referring back to it.  However, if we're doing circular
-     *   alternatives, the enclosing state could also be enqueued
-     *   separately as its own state, so do clone all required copies in
-     *   this case.  
-     */
-    need_to_clone = circ_only;
-
     /* note whether or not we have any circular alternatives */
     has_circ = get_ext()->has_circular_alt;
 
@@ -2196,13 +2302,31 @@ void CVmObjGramProd::enqueue_alts(VMG_ CVmGramProdMem *mem,
     if (!get_ext()->hashes_cached_ || get_ext()->comparator_ != comparator)
         cache_hashes(vmg_ dict);
 
+    /* 
+     *   look up the alternatives whose first items could match the current
+     *   token, so that we can skip the rest without examining them 
+     */
+    const uint32_t *cand = get_first_candidates(
+        mem, tok, tok_cnt, start_tok_pos, circ_only);
+
     /* 
      *   run through our alternatives and enqueue each one that looks
      *   plausible 
      */
-    for (altp = get_ext()->alts_, i = get_ext()->alt_cnt_ ; i != 0 ;
-         --i, ++altp)
+    for (i = 0 ; i < get_ext()->alt_cnt_ ; ++i)
     {
+        /* if this isn't a candidate, skip it */
+        if (cand != 0 && (cand[i / 32] & ((uint32_t)1 << (i % 32))) == 0)
+        {
+            /* if there are no candidates in this whole word, skip it */
+            if (cand[i / 32] == 0)
+                i |= 31;
+            continue;
+        }
+
+        /* get this alternative */
+        altp = &get_ext()->alts_[i];
+
         /* start at the first token remaining in the string */
         size_t tok_idx = start_tok_pos;
 
@@ -2453,9 +2577,8 @@ void CVmObjGramProd::enqueue_alts(VMG_ CVmGramProdMem *mem,
             CVmGramProdState *state;
             
             /* create and enqueue the new state */
-            state = enqueue_new_state(mem, start_tok_pos, enclosing_state,
-                                      *altp, self, &need_to_clone, queues,
-                                      has_circ);
+            state = enqueue_new_state(mem, start_tok_pos, memo,
+                                      *altp, self, queues, has_circ);
 
             /* 
              *   if we are enqueuing circular references, we already have
@@ -2517,6 +2640,268 @@ void CVmObjGramProd::cache_hashes(VMG_ CVmObjDict *dict)
     /* note that we've cached hash values, and note the comparator we used */
     get_ext()->hashes_cached_ = TRUE;
     get_ext()->comparator_ = comparator;
+
+    /* the first-item index is keyed on the literal hashes, so rebuild it */
+    free_first_index();
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   First-item index.  Most alternatives start with a literal, a part of
+ *   speech, or a token type, so only the few alternatives whose first item
+ *   matches the current token can possibly match.  Rather than checking
+ *   each alternative against the token in turn, we index the alternatives
+ *   by their first items, and look up the candidates for the token.  Any
+ *   alternative that starts with a sub-production or a '*' (or that's
+ *   empty) could match anything, so we keep these in a separate "wildcard"
+ *   list that's always included.
+ *   
+ *   The lookup produces a bit vector with one bit per alternative, so that
+ *   we can still visit the candidates in their original order.  
+ */
+
+/* index key types */
+#define VMGRAM_FIRST_LIT      1                                  /* literal */
+#define VMGRAM_FIRST_SPEECH   2                           /* part of speech */
+#define VMGRAM_FIRST_TOKTYPE  3                               /* token type */
+
+/* number of hash buckets in the index */
+#define VMGRAM_FIRST_HASH_SIZE  128
+
+/* 
+ *   Minimum number of alternatives for indexing.  A production with only a
+ *   few alternatives is cheaper to scan directly.  
+ */
+#define VMGRAM_FIRST_INDEX_MIN  8
+
+/* index entry */
+struct vmgram_first_entry
+{
+    /* key type and value */
+    int typ;
+    ulong key;
+
+    /* index of the alternative */
+    size_t alt_idx;
+
+    /* next entry in the hash bucket */
+    vmgram_first_entry *nxt;
+};
+
+/* the index */
+struct vmgram_first_index
+{
+    /* hash buckets */
+    vmgram_first_entry *buckets[VMGRAM_FIRST_HASH_SIZE];
+
+    /* the entries (all allocated as a single array) */
+    vmgram_first_entry *entries;
+
+    /* the wildcard alternatives, by index */
+    size_t *wild;
+    size_t wild_cnt;
+
+    /* get the hash bucket for a key */
+    vmgram_first_entry **bucket(int typ, ulong key)
+        { return &buckets[(key * 7 + typ) % VMGRAM_FIRST_HASH_SIZE]; }
+};
+
+/*
+ *   Discard the first-item index 
+ */
+void CVmObjGramProd::free_first_index()
+{
+    vmgram_first_index *idx = get_ext()->first_idx_;
+    if (idx != 0)
+    {
+        t3free(idx->entries);
+        t3free(idx->wild);
+        t3free(idx);
+        get_ext()->first_idx_ = 0;
+    }
+}
+
+/*
+ *   Build the first-item index 
+ */
+void CVmObjGramProd::build_first_index()
+{
+    vmgram_alt_info **alts = get_ext()->alts_;
+    size_t alt_cnt = get_ext()->alt_cnt_;
+    size_t ent_cnt, wild_cnt;
+    size_t i;
+
+    /* count the entries and wildcards we'll need */
+    for (i = 0, ent_cnt = wild_cnt = 0 ; i < alt_cnt ; ++i)
+    {
+        const vmgram_tok_info *tokp = alts[i]->toks;
+        if (alts[i]->tok_cnt == 0)
+            ++wild_cnt;
+        else if (tokp->typ == VMGRAM_MATCH_NSPEECH)
+            ent_cnt += tokp->typinfo.nspeech.cnt;
+        else if (tokp->typ == VMGRAM_MATCH_SPEECH
+                 || tokp->typ == VMGRAM_MATCH_LITERAL
+                 || tokp->typ == VMGRAM_MATCH_TOKTYPE)
+            ++ent_cnt;
+        else
+            ++wild_cnt;
+    }
+
+    /* allocate the index */
+    vmgram_first_index *idx =
+        (vmgram_first_index *)t3malloc(sizeof(vmgram_first_index));
+    memset(idx->buckets, 0, sizeof(idx->buckets));
+    idx->entries = (vmgram_first_entry *)t3malloc(
+        (ent_cnt != 0 ? ent_cnt : 1) * sizeof(vmgram_first_entry));
+    idx->wild = (size_t *)t3malloc(
+        (wild_cnt != 0 ? wild_cnt : 1) * sizeof(size_t));
+    idx->wild_cnt = 0;
+
+    /* add each alternative */
+    vmgram_first_entry *e = idx->entries;
+    for (i = 0 ; i < alt_cnt ; ++i)
+    {
+        const vmgram_tok_info *tokp = alts[i]->toks;
+        size_t n = 1;
+        int typ;
+        ulong key;
+
+        /* figure the key for the first item */
+        if (alts[i]->tok_cnt == 0)
+        {
+            /* empty alternative - this is a wildcard */
+            idx->wild[idx->wild_cnt++] = i;
+            continue;
+        }
+        switch (tokp->typ)
+        {
+        case VMGRAM_MATCH_LITERAL:
+            typ = VMGRAM_FIRST_LIT;
+            key = tokp->typinfo.lit.hash;
+            break;
+
+        case VMGRAM_MATCH_SPEECH:
+            typ = VMGRAM_FIRST_SPEECH;
+            key = tokp->typinfo.speech_prop;
+            break;
+
+        case VMGRAM_MATCH_NSPEECH:
+            /* add an entry for each part of speech */
+            typ = VMGRAM_FIRST_SPEECH;
+            n = tokp->typinfo.nspeech.cnt;
+            key = 0;
+            break;
+
+        case VMGRAM_MATCH_TOKTYPE:
+            typ = VMGRAM_FIRST_TOKTYPE;
+            key = tokp->typinfo.toktyp_enum;
+            break;
+
+        default:
+            /* a sub-production or '*' could match anything */
+            idx->wild[idx->wild_cnt++] = i;
+            continue;
+        }
+
+        /* add the entries */
+        for (size_t j = 0 ; j < n ; ++j, ++e)
+        {
+            /* get the key for this entry */
+            if (tokp->typ == VMGRAM_MATCH_NSPEECH)
+                key = tokp->typinfo.nspeech.props[j];
+
+            /* set up the entry and link it into its bucket */
+            vmgram_first_entry **b = idx->bucket(typ, key);
+            e->typ = typ;
+            e->key = key;
+            e->alt_idx = i;
+            e->nxt = *b;
+            *b = e;
+        }
+    }
+
+    /* store the new index */
+    get_ext()->first_idx_ = idx;
+}
+
+/*
+ *   Get the candidate alternatives for the token at the given position.
+ *   Returns a bit vector (allocated from the parsing memory pool) with a
+ *   bit set for each alternative whose first item could match the token,
+ *   or null if the caller should simply check every alternative.  
+ */
+const uint32_t *CVmObjGramProd::get_first_candidates(
+    CVmGramProdMem *mem, const vmgramprod_tok *tok, size_t tok_cnt,
+    size_t tok_pos, int circ_only)
+{
+    size_t alt_cnt = get_ext()->alt_cnt_;
+    size_t i;
+
+    /* if we don't have enough alternatives to bother, check them all */
+    if (alt_cnt < VMGRAM_FIRST_INDEX_MIN)
+        return 0;
+
+    /* allocate the bit vector; if it's too big, check everything */
+    size_t nwords = (alt_cnt + 31) / 32;
+    uint32_t *bits = (uint32_t *)mem->alloc(nwords * sizeof(uint32_t));
+    if (bits == 0)
+        return 0;
+    memset(bits, 0, nwords * sizeof(uint32_t));
+
+    /* build the index if we haven't already */
+    if (get_ext()->first_idx_ == 0)
+        build_first_index();
+    vmgram_first_index *idx = get_ext()->first_idx_;
+
+    /* the wildcards are always candidates */
+    for (i = 0 ; i < idx->wild_cnt ; ++i)
+        bits[idx->wild[i] / 32] |= (uint32_t)1 << (idx->wild[i] % 32);
+
+    /* 
+     *   If we're matching circular alternatives only, only wildcards can be
+     *   candidates, since a circular alternative starts with a
+     *   sub-production.  Likewise, if we're out of input tokens, nothing
+     *   but a wildcard can match.  
+     */
+    if (circ_only || tok_pos >= tok_cnt)
+        return bits;
+
+    /* add the alternatives keyed on the token's literal text and type */
+    const vmgramprod_tok *t = &tok[tok_pos];
+    int typs[2];
+    ulong keys[2];
+    size_t nkeys = 0;
+    if (t->txt_ != 0)
+    {
+        typs[nkeys] = VMGRAM_FIRST_LIT;
+        keys[nkeys++] = t->hash_;
+    }
+    typs[nkeys] = VMGRAM_FIRST_TOKTYPE;
+    keys[nkeys++] = t->typ_;
+    for (i = 0 ; i < nkeys ; ++i)
+    {
+        for (vmgram_first_entry *e = *idx->bucket(typs[i], keys[i]) ;
+             e != 0 ; e = e->nxt)
+        {
+            if (e->typ == typs[i] && e->key == keys[i])
+                bits[e->alt_idx / 32] |= (uint32_t)1 << (e->alt_idx % 32);
+        }
+    }
+
+    /* add the alternatives keyed on each of the token's parts of speech */
+    for (i = 0 ; i < t->match_cnt_ ; ++i)
+    {
+        ulong key = t->matches_[i].prop;
+        for (vmgram_first_entry *e = *idx->bucket(VMGRAM_FIRST_SPEECH, key) ;
+             e != 0 ; e = e->nxt)
+        {
+            if (e->typ == VMGRAM_FIRST_SPEECH && e->key == key)
+                bits[e->alt_idx / 32] |= (uint32_t)1 << (e->alt_idx % 32);
+        }
+    }
+
+    /* return the candidates */
+    return bits;
 }
 
 /*
@@ -2524,17 +2909,15 @@ void CVmObjGramProd::cache_hashes(VMG_ CVmObjDict *dict)
  */
 CVmGramProdState *CVmObjGramProd::
    enqueue_new_state(CVmGramProdMem *mem,
-                     size_t start_tok_pos,
-                     CVmGramProdState *enclosing_state,
+                     size_t start_tok_pos, CVmGramProdMemo *memo,
                      const vmgram_alt_info *altp, vm_obj_id_t self,
-                     int *need_to_clone, CVmGramProdQueue *queues,
-                     int circular_alt)
+                     CVmGramProdQueue *queues, int circular_alt)
 {
     CVmGramProdState *state;
 
-    /* create the new state */
-    state = create_new_state(mem, start_tok_pos, enclosing_state,
-                             altp, self, need_to_clone, circular_alt);
+    /* create the new state object for the alternative */
+    state = CVmGramProdState::alloc(mem, start_tok_pos, 0, memo,
+                                    altp, self, circular_alt);
     
     /* 
      *   Add the item to the appropriate queue.  If the item has an
@@ -2562,33 +2945,113 @@ CVmGramProdState *CVmObjGramProd::
 }
 
 /*
- *   Create a new state 
+ *   Match a sub-production on behalf of a parsing state.  'state' is the
+ *   state that's reached the sub-production item; it waits in the memo
+ *   entry for the sub-production at the state's token position, and each
+ *   match of the sub-production resumes a copy of it.
  */
-CVmGramProdState *CVmObjGramProd::
-   create_new_state(CVmGramProdMem *mem, size_t start_tok_pos,
-                    CVmGramProdState *enclosing_state,
-                    const vmgram_alt_info *altp, vm_obj_id_t self,
-                    int *need_to_clone, int circular_alt)
+void CVmObjGramProd::match_sub_prod(VMG_ CVmGramProdMem *mem,
+                                    const vmgramprod_tok *tok,
+                                    size_t tok_cnt, CVmGramProdState *state,
+                                    CVmGramProdQueue *queues,
+                                    vm_obj_id_t self, CVmObjDict *dict)
+{
+    CVmGramProdMemo **bucket;
+    CVmGramProdMemo *memo;
+    CVmGramProdMemoResult *res;
+
+    /* look for an existing memo entry for this production and position */
+    bucket = &queues->memo_tab_[((ulong)self * 31 + state->tok_pos_)
+                                % VMGRAM_MEMO_HASH_SIZE];
+    for (memo = *bucket ; memo != 0 ; memo = memo->nxt_)
+    {
+        if (memo->prod_obj_ == self && memo->tok_pos_ == state->tok_pos_)
+            break;
+    }
+
+    /* 
+     *   If we found an entry from the current badness generation, share
+     *   it: add the state to the waiter list, and resume it with each
+     *   result found so far.  (Since we add new entries at the head of the
+     *   bucket, the first entry we find is always the newest.)  
+     */
+    if (memo != 0 && memo->gen_ == queues->badness_gen_)
+    {
+        /* count the expansion we avoided */
+        memo_stats_.hits++;
+
+        /* add the state to the waiters */
+        state->nxt_ = memo->waiters_;
+        memo->waiters_ = state;
+
+        /* resume it with the results so far */
+        for (res = memo->results_ ; res != 0 ; res = res->nxt_)
+        {
+            memo_stats_.shared_results++;
+            resume_waiter(mem, state, res, queues);
+        }
+
+        /* done */
+        return;
+    }
+
+    /* create a new entry, with the state as its only waiter */
+    memo = (CVmGramProdMemo *)mem->alloc(sizeof(*memo));
+    memo->prod_obj_ = self;
+    memo->tok_pos_ = state->tok_pos_;
+    memo->gen_ = queues->badness_gen_;
+    memo->waiters_ = state;
+    memo->results_ = 0;
+    state->nxt_ = 0;
+
+    /* link it in at the head of the bucket */
+    memo->nxt_ = *bucket;
+    *bucket = memo;
+
+    /* count the expansion */
+    memo_stats_.expansions++;
+
+    /* enqueue our alternatives for the sub-production match */
+    enqueue_alts(vmg_ mem, tok, tok_cnt, state->tok_pos_, memo, queues,
+                 self, FALSE, 0, dict);
+}
+
+/*
+ *   Resume a state that's waiting for a sub-production, given one of the
+ *   sub-production's matches.  The waiting state stays in the memo entry
+ *   unchanged, since it might have to be resumed again with other
+ *   matches; we continue parsing with a copy of it.  
+ */
+void CVmObjGramProd::resume_waiter(CVmGramProdMem *mem,
+                                   CVmGramProdState *waiter,
+                                   const CVmGramProdMemoResult *res,
+                                   CVmGramProdQueue *queues)
 {
+    CVmGramProdState *state;
+
+    /* make a copy of the waiting state to continue with */
+    state = waiter->clone(mem);
+
     /* 
-     *   if necessary, clone the enclosing state; we need to do this if we
-     *   enqueue more than one nested alternative, since each nested
-     *   alternative could parse the rest of the token list differently
-     *   and thus provide a different result to the enclosing state 
+     *   add the sub-production match to the match list, setting the target
+     *   property that the waiting state specified for the sub-production 
      */
-    if (*need_to_clone && enclosing_state != 0)
-        enclosing_state = enclosing_state->clone(mem);
+    state->match_list_[state->alt_pos_] = CVmGramProdMatch::alloc(
+        mem, res->tok_pos_, 0, FALSE, waiter->sub_target_prop_,
+        res->match_->proc_obj_, res->match_->sub_match_list_,
+        res->match_->sub_match_cnt_);
+    state->alt_pos_++;
 
     /* 
-     *   we will need to clone the enclosing state if we create another
-     *   alternative after this one 
+     *   Move the state's token position to the end of the match - since
+     *   it now encompasses the match, it has consumed all of the tokens
+     *   therein.  Likewise, take the match's '*' setting.  
      */
-    *need_to_clone = TRUE;
+    state->tok_pos_ = res->tok_pos_;
+    state->matched_star_ = res->matched_star_;
 
-    /* create a new state object for the alternative */
-    return CVmGramProdState::alloc(mem, start_tok_pos, 0,
-                                   enclosing_state, altp, self,
-                                   circular_alt);
+    /* enqueue the state so we can continue parsing it */
+    enqueue_state(state, queues);
 }
 
 /*
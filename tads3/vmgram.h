@@ -174,6 +174,13 @@ struct vm_gram_ext
 
     /* number of alternatives allocated */
     size_t alt_alo_;
+
+    /* 
+     *   Index of our alternatives by their first items, or null if we
+     *   haven't built it yet.  We build this on demand, and discard it
+     *   whenever the alternatives or the literal hash values change.  
+     */
+    struct vmgram_first_index *first_idx_;
 };
 
 /*
@@ -288,6 +295,26 @@ struct vmgram_tok_info
     } typinfo;
 };
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Sub-production memo statistics.  These accumulate over all parses, and
+ *   show how much repeated sub-production matching the memo table saved.  
+ */
+struct vmgram_memo_stats
+{
+    /* number of parseTokens calls */
+    unsigned long parses;
+
+    /* number of sub-production expansions (memo misses) */
+    unsigned long expansions;
+
+    /* number of sub-production requests satisfied from the memo */
+    unsigned long hits;
+
+    /* number of existing memo results delivered to new requests */
+    unsigned long shared_results;
+};
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Grammar-Production object interface 
@@ -323,6 +350,9 @@ public:
                               vm_prop_id_t prop)
         { return CVmObject::call_stat_prop(vmg_ result, pc_ptr, argc, prop); }
 
+    /* get the sub-production memo statistics */
+    static const vmgram_memo_stats *get_memo_stats() { return &memo_stats_; }
+
     /* determine if an object is a GrammarProduction object */
     static int is_gramprod_obj(VMG_ vm_obj_id_t obj)
         { return vm_objp(vmg_ obj)->is_of_metaclass(metaclass_reg_); }
@@ -398,6 +428,18 @@ protected:
     /* check the alternative list for circular references */
     void check_circular_refs(vm_obj_id_t self);
 
+    /* build/discard the index of alternatives by first item */
+    void build_first_index();
+    void free_first_index();
+
+    /* 
+     *   get the bit vector of alternatives that could match the token at
+     *   the given position, or null if we need to check all of them 
+     */
+    const uint32_t *get_first_candidates(
+        class CVmGramProdMem *mem, const struct vmgramprod_tok *tok,
+        size_t tok_cnt, size_t tok_pos, int circ_only);
+
     /* build the grammarAltProps list for a match object */
     void build_alt_props(VMG_ vm_obj_id_t match_obj);
     size_t build_alt_props_list(VMG_ vm_obj_id_t match_obj,
@@ -459,7 +501,7 @@ protected:
     void enqueue_alts(VMG_ class CVmGramProdMem *mem,
                       const struct vmgramprod_tok *tok,
                       size_t tok_cnt, size_t start_tok_pos,
-                      struct CVmGramProdState *state,
+                      struct CVmGramProdMemo *memo,
                       struct CVmGramProdQueue *queues,
                       vm_obj_id_t self, int circ_only,
                       struct CVmGramProdMatch *circ_match,
@@ -469,19 +511,23 @@ protected:
     static struct CVmGramProdState *
         enqueue_new_state(class CVmGramProdMem *mem,
                           size_t start_tok_pos,
-                          struct CVmGramProdState *enclosing_state,
+                          struct CVmGramProdMemo *memo,
                           const vmgram_alt_info *altp, vm_obj_id_t self,
-                          int *need_to_clone,
                           struct CVmGramProdQueue *queues,
                           int circular_alt);
-    
-    /* create a new state */
-    static struct CVmGramProdState *
-        create_new_state(class CVmGramProdMem *mem,
-                         size_t start_tok_pos,
-                         struct CVmGramProdState *enclosing_state,
-                         const vmgram_alt_info *altp, vm_obj_id_t self,
-                         int *need_to_clone, int circular_alt);
+
+    /* match a sub-production for a state, sharing results via the memo */
+    void match_sub_prod(VMG_ class CVmGramProdMem *mem,
+                        const struct vmgramprod_tok *tok, size_t tok_cnt,
+                        struct CVmGramProdState *state,
+                        struct CVmGramProdQueue *queues,
+                        vm_obj_id_t self, class CVmObjDict *dict);
+
+    /* resume a state waiting for a sub-production with one of its matches */
+    static void resume_waiter(class CVmGramProdMem *mem,
+                              struct CVmGramProdState *waiter,
+                              const struct CVmGramProdMemoResult *res,
+                              struct CVmGramProdQueue *queues);
     
     /* enqueue a state */
     static void enqueue_state(struct CVmGramProdState *state,
@@ -526,6 +572,9 @@ protected:
     /* property evaluation function table */
     static int (CVmObjGramProd::*func_table_[])(VMG_ vm_obj_id_t self,
                                                 vm_val_t *retval, uint *argc);
+
+    /* sub-production memo statistics */
+    static vmgram_memo_stats memo_stats_;
 };
 
 
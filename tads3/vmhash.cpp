@@ -30,26 +30,32 @@ Modified
 #ifndef VMHASH_H
 #include "vmhash.h"
 #endif
+#include "vmerr.h"
 
 
 /* ------------------------------------------------------------------------ */
 /*
- *   Simple case-insensitive hash function implementation.
+ *   Case-insensitive hash function implementation.
  */
 unsigned int CVmHashFuncCI::compute_hash(const char *s, size_t l) const
 {
     uint acc;
 
     /*
-     *   Add up all the character values in the string, converting all
-     *   characters to upper-case.
+     *   Combine the bytes of the string with FNV-1a, converting all
+     *   characters to upper-case.  Only ASCII letters fold, the same as in
+     *   memicmp(), so strings that CVmHashEntryCI considers equal always
+     *   hash alike.  (Unlike the plain character sum we used to use, this
+     *   distinguishes anagrams, and spreads short identifiers over the
+     *   whole range rather than a few hundred values.)  
      */
-    for (acc = 0 ; l != 0 ; ++s, --l)
+    for (acc = 2166136261U ; l != 0 ; ++s, --l)
     {
         uchar c;
 
         c = (uchar)(is_lower(*s) ? to_upper(*s) : *s);
-        acc += c;
+        acc ^= c;
+        acc *= 16777619U;
     }
 
     /* return the accumulated value */
@@ -58,22 +64,20 @@ unsigned int CVmHashFuncCI::compute_hash(const char *s, size_t l) const
 
 /* ------------------------------------------------------------------------ */
 /*
- *   Simple case-sensitive hash function implementation 
+ *   Case-sensitive hash function implementation 
  */
 unsigned int CVmHashFuncCS::compute_hash(const char *s, size_t l) const
 {
     uint acc;
 
     /*
-     *   add up all the character values in the string, treating case as
+     *   combine the bytes of the string with FNV-1a, treating case as
      *   significant 
      */
-    for (acc = 0 ; l != 0 ; ++s, --l)
+    for (acc = 2166136261U ; l != 0 ; ++s, --l)
     {
-        uchar c;
-
-        c = (uchar)*s;
-        acc += c;
+        acc ^= (uchar)*s;
+        acc *= 16777619U;
     }
 
     /* return the accumulated value */
@@ -202,6 +206,10 @@ void CVmHashTable::init(int hash_table_size,
     /* clear the table */
     for (entry = table_, i = 0 ; i < table_size_ ; ++i, ++entry)
         *entry = 0;
+
+    /* we have no entries yet, and we're not enumerating */
+    entry_cnt_ = 0;
+    enum_depth_ = 0;
 }
 
 CVmHashTable::~CVmHashTable()
@@ -244,6 +252,9 @@ void CVmHashTable::delete_all_entries()
         /* there's nothing at this table entry now */
         *tableptr = 0;
     }
+
+    /* the table is empty now */
+    entry_cnt_ = 0;
 }
 
 /*
@@ -275,6 +286,61 @@ unsigned int CVmHashTable::compute_hash(const char *str, size_t len) const
     return adjust_hash(hash_function_->compute_hash(str, len));
 }
 
+/*
+ *   Double the table size 
+ */
+void CVmHashTable::grow()
+{
+    CVmHashEntry **old_table = table_;
+    size_t old_size = table_size_;
+    size_t i;
+
+    /* allocate and clear the new table */
+    table_size_ = old_size * 2;
+    table_ = new CVmHashEntry *[table_size_];
+    for (i = 0 ; i < table_size_ ; ++i)
+        table_[i] = 0;
+
+    /* move each entry from the old table into its new bucket */
+    for (i = 0 ; i < old_size ; ++i)
+    {
+        CVmHashEntry *entry, *nxt;
+        for (entry = old_table[i] ; entry != 0 ; entry = nxt)
+        {
+            unsigned int hash;
+
+            /* remember the next entry in the old chain */
+            nxt = entry->nxt_;
+
+            /* link it into its new chain */
+            hash = compute_hash(entry);
+            entry->nxt_ = table_[hash];
+            table_[hash] = entry;
+        }
+    }
+
+    /* 
+     *   done with the old table; if the caller provided it, it's theirs
+     *   to free, but the new one is ours either way 
+     */
+    if (own_hash_table_)
+        delete [] old_table;
+    own_hash_table_ = TRUE;
+}
+
+/*
+ *   Finish an enumeration.  If entries were added during the enumeration
+ *   and the table is now overloaded, grow it now that it's safe. 
+ */
+void CVmHashTable::end_enum()
+{
+    if (--enum_depth_ == 0)
+    {
+        while (entry_cnt_ > table_size_ * VMHASH_MAX_LOAD)
+            grow();
+    }
+}
+
 /*
  *   Add an object to the table
  */
@@ -288,6 +354,13 @@ void CVmHashTable::add(CVmHashEntry *entry)
     /* link it into the slot for this hash value */
     entry->nxt_ = table_[hash];
     table_[hash] = entry;
+
+    /* 
+     *   count it, and grow the table if the chains are getting long
+     *   (unless an enumeration is under way - see end_enum()) 
+     */
+    if (++entry_cnt_ > table_size_ * VMHASH_MAX_LOAD && enum_depth_ == 0)
+        grow();
 }
 
 /*
@@ -308,6 +381,7 @@ void CVmHashTable::remove(CVmHashEntry *entry)
     {
         /* it's the first item - simply advance the head to the next item */
         table_[hash] = entry->nxt_;
+        --entry_cnt_;
     }
     else
     {
@@ -319,7 +393,10 @@ void CVmHashTable::remove(CVmHashEntry *entry)
 
         /* if we found it, unlink this item */
         if (prv != 0)
+        {
             prv->nxt_ = entry->nxt_;
+            --entry_cnt_;
+        }
     }
 }
 
@@ -356,8 +433,11 @@ void CVmHashTable::enum_hash_matches(const char *str, size_t len,
 {
     unsigned int hash;
 
-    /* compute the hash value for this entry */
-    hash = compute_hash(str, len);
+    /* 
+     *   compute the raw hash value for this entry - the other version
+     *   adjusts it to the table size itself 
+     */
+    hash = compute_raw_hash(str, len);
 
     /* enumerate matches at the hash value */
     enum_hash_matches(hash, cb, cbctx);
@@ -376,12 +456,24 @@ void CVmHashTable::enum_hash_matches(unsigned int hash,
     /* adjust the hash value for the table size */
     hash = adjust_hash(hash);
 
-    /* enumerate the complete list of entries at this hash value */
-    for (entry = table_[hash] ; entry ; entry = entry->nxt_)
+    /* 
+     *   enumerate the complete list of entries at this hash value; end the
+     *   enumeration even if the callback throws 
+     */
+    ++enum_depth_;
+    err_try
+    {
+        for (entry = table_[hash] ; entry ; entry = entry->nxt_)
+        {
+            /* call the callback with this entry */
+            (*cb)(cbctx, entry);
+        }
+    }
+    err_finally
     {
-        /* call the callback with this entry */
-        (*cb)(cbctx, entry);
+        end_enum();
     }
+    err_end;
 }
 
 /*
@@ -423,25 +515,37 @@ void CVmHashTable::enum_entries(void (*func)(void *, CVmHashEntry *),
     CVmHashEntry **tableptr;
     size_t i;
 
-    /* go through each hash value */
-    for (tableptr = table_, i = 0 ; i < table_size_ ; ++i, ++tableptr)
+    /* 
+     *   go through each hash value; end the enumeration even if the
+     *   callback throws 
+     */
+    ++enum_depth_;
+    err_try
     {
-        CVmHashEntry *entry;
-        CVmHashEntry *nxt;
-
-        /* go through each entry at this hash value */
-        for (entry = *tableptr ; entry ; entry = nxt)
+        for (tableptr = table_, i = 0 ; i < table_size_ ; ++i, ++tableptr)
         {
-            /* 
-             *   remember the next entry, in case the callback deletes the
-             *   current entry 
-             */
-            nxt = entry->nxt_;
-
-            /* invoke the callback on this entry */
-            (*func)(ctx, entry);
+            CVmHashEntry *entry;
+            CVmHashEntry *nxt;
+
+            /* go through each entry at this hash value */
+            for (entry = *tableptr ; entry ; entry = nxt)
+            {
+                /* 
+                 *   remember the next entry, in case the callback deletes
+                 *   the current entry 
+                 */
+                nxt = entry->nxt_;
+
+                /* invoke the callback on this entry */
+                (*func)(ctx, entry);
+            }
         }
     }
+    err_finally
+    {
+        end_enum();
+    }
+    err_end;
 }
 
 /*
@@ -456,44 +560,60 @@ void CVmHashTable::safe_enum_entries(void (*func)(void *, CVmHashEntry *),
     CVmHashEntry **tableptr;
     size_t i;
 
-    /* go through each hash value */
-    for (tableptr = table_, i = 0 ; i < table_size_ ; ++i, ++tableptr)
+    /* 
+     *   go through each hash value; end the enumeration even if the
+     *   callback throws 
+     */
+    ++enum_depth_;
+    err_try
     {
-        size_t list_idx;
-
-        /* 
-         *   start at the first (0th) entry in the current hash chain, and
-         *   keep going until we run out of entries in the chain 
-         */
-        for (list_idx = 0 ; ; ++list_idx)
+        for (tableptr = table_, i = 0 ; i < table_size_ ; ++i, ++tableptr)
         {
-            CVmHashEntry *entry;
-            size_t j;
+            size_t list_idx;
 
             /* 
-             *   Scan the hash chain for the current entry index.
-             *   
-             *   This is the part that makes this version slower than the
-             *   standard version and safer than the standard version.  It's
-             *   slower than enum_entries() because we must scan the chain
-             *   list on every iteration to find the next entry, whereas
-             *   enum_entries() simply keeps a pointer to the next entry.
-             *   It's safer because we don't keep any pointers - if next
-             *   element is deleted in the callback in enum_entries(), that
-             *   stored next pointer would be invalid, but we store no
-             *   pointers that could become stale.  
+             *   start at the first (0th) entry in the current hash chain, and
+             *   keep going until we run out of entries in the chain 
              */
-            for (j = 0, entry = *tableptr ; j < list_idx && entry != 0 ;
-                 entry = entry->nxt_, ++j) ;
-
-            /* if we failed to find the entry, we're done with this chain */
-            if (entry == 0)
-                break;
-
-            /* invoke the callback on this entry */
-            (*func)(ctx, entry);
+            for (list_idx = 0 ; ; ++list_idx)
+            {
+                CVmHashEntry *entry;
+                size_t j;
+
+                /* 
+                 *   Scan the hash chain for the current entry index.
+                 *   
+                 *   This is the part that makes this version slower than
+                 *   the standard version and safer than the standard
+                 *   version.  It's slower than enum_entries() because we
+                 *   must scan the chain list on every iteration to find the
+                 *   next entry, whereas enum_entries() simply keeps a
+                 *   pointer to the next entry.  It's safer because we don't
+                 *   keep any pointers - if next element is deleted in the
+                 *   callback in enum_entries(), that stored next pointer
+                 *   would be invalid, but we store no pointers that could
+                 *   become stale.  
+                 */
+                for (j = 0, entry = *tableptr ; j < list_idx && entry != 0 ;
+                     entry = entry->nxt_, ++j) ;
+
+                /* 
+                 *   if we failed to find the entry, we're done with this
+                 *   chain 
+                 */
+                if (entry == 0)
+                    break;
+
+                /* invoke the callback on this entry */
+                (*func)(ctx, entry);
+            }
         }
     }
+    err_finally
+    {
+        end_enum();
+    }
+    err_end;
 }
 
 
@@ -538,6 +658,9 @@ void CVmHashTable::move_entries_to(CVmHashTable *new_tab)
          */
         *tableptr = 0;
     }
+
+    /* we're empty now */
+    entry_cnt_ = 0;
 }
 
 /* ------------------------------------------------------------------------ */
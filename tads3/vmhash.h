@@ -79,6 +79,10 @@ protected:
 /*
  *   Hash table 
  */
+
+/* maximum average entries per bucket before the table grows */
+#define VMHASH_MAX_LOAD  2
+
 class CVmHashTable
 {
 public:
@@ -86,7 +90,11 @@ public:
      *   Construct a hash table.  If own_hash_func is true, the hash table
      *   object takes ownership of the hash function object, so the hash
      *   table object will delete the hash function object when the table
-     *   is deleted.  
+     *   is deleted.
+     *   
+     *   The size is only the initial number of buckets; the table doubles
+     *   its bucket count as entries are added, whenever the average chain
+     *   would grow longer than VMHASH_MAX_LOAD entries.  
      */
     CVmHashTable(int hash_table_size, CVmHashFunc *hash_function,
                  int own_hash_func)
@@ -97,7 +105,8 @@ public:
 
     /*
      *   Construct a hash table, using memory allocated and owned by the
-     *   caller for the hash array. 
+     *   caller for the hash array.  If the table grows, it switches to an
+     *   array of its own; the caller still owns (and frees) the original.  
      */
     CVmHashTable(int hash_table_size, CVmHashFunc *hash_function,
                  int own_hash_func, CVmHashEntry **hash_array)
@@ -142,7 +151,11 @@ public:
                            void (*cb)(void *cbctx, CVmHashEntry *entry),
                            void *cbctx);
 
-    /* enumerate all entries with the given hash value */
+    /* 
+     *   enumerate all entries with the given hash value; this is the raw
+     *   value from the hash function (see compute_raw_hash()), before
+     *   adjustment for the table size 
+     */
     void enum_hash_matches(uint hash,
                            void (*cb)(void *cbctx, CVmHashEntry *entry),
                            void *cbctx);
@@ -156,7 +169,11 @@ public:
 
     /*
      *   Enumerate all entries, invoking a callback for each entry in the
-     *   table 
+     *   table.  The table doesn't grow while an enumeration is in
+     *   progress (here or in safe_enum_entries() or enum_hash_matches()),
+     *   so a callback that adds entries doesn't disturb the bucket order;
+     *   any growth that's due happens when the outermost enumeration
+     *   finishes.  
      */
     void enum_entries(void (*func)(void *ctx, class CVmHashEntry *entry),
                       void *ctx);
@@ -187,10 +204,31 @@ public:
     unsigned int compute_hash(CVmHashEntry *entry) const;
     unsigned int compute_hash(const char *str, size_t len) const;
 
+    /* compute the raw hash function value for a string */
+    unsigned int compute_raw_hash(const char *str, size_t len) const
+        { return hash_function_->compute_hash(str, len); }
+
+    /* get the number of buckets in the table */
+    size_t get_table_size() const { return table_size_; }
+
+    /* get the number of entries in the table */
+    size_t get_entry_count() const { return entry_cnt_; }
+
 private:
     /* adjust a hash to the table size */
     unsigned int adjust_hash(unsigned int hash) const
-        { return hash & (table_size_ - 1); }
+    {
+        /* 
+         *   Scramble the bits before masking.  Our own hash functions mix
+         *   well, but clients can supply their own (the dictionary's
+         *   comparator hashes, for example), and those are often simple
+         *   character sums that cluster in a narrow band of values; taking
+         *   the low bits directly would leave most of the buckets of a
+         *   large table empty.  
+         */
+        hash *= 0x9E3779B1U;
+        return (hash ^ (hash >> 16)) & (table_size_ - 1);
+    }
 
     /* initialize */
     void init(int hash_table_size, CVmHashFunc *hash_function,
@@ -199,10 +237,25 @@ private:
     /* internal service routine for checking hash table sizes for validity */
     int is_power_of_two(int n);
 
+    /* double the number of buckets, redistributing the entries */
+    void grow();
+
+    /* note the end of an enumeration, and grow if we put it off */
+    void end_enum();
+
     /* the table of hash entries */
     CVmHashEntry **table_;
     size_t table_size_;
 
+    /* number of entries in the table */
+    size_t entry_cnt_;
+
+    /* 
+     *   nesting depth of enumerations in progress; each enumeration ends
+     *   in an err_finally block, so this unwinds even if a callback throws 
+     */
+    int enum_depth_;
+
     /* hash function */
     CVmHashFunc *hash_function_;
 
@@ -215,7 +268,8 @@ private:
 
 /* ------------------------------------------------------------------------ */
 /*
- *   Simple case-insensitive hash function 
+ *   Case-insensitive hash function (FNV-1a over the bytes of the string,
+ *   folding ASCII letters to upper-case, to agree with CVmHashEntryCI) 
  */
 class CVmHashFuncCI: public CVmHashFunc
 {
@@ -225,7 +279,7 @@ public:
 
 /* ------------------------------------------------------------------------ */
 /*
- *   Simple case-sensitive hash function implementation 
+ *   Case-sensitive hash function (FNV-1a over the bytes of the string) 
  */
 class CVmHashFuncCS: public CVmHashFunc
 {
@@ -26,6 +26,7 @@ Modified
 #define VMHOST_H
 
 #include "os.h"
+#include "t3std.h"
 
 /* ------------------------------------------------------------------------ */
 /*
@@ -257,6 +258,84 @@ public:
      *   os_get_special_path() (see tads2/osifc.h).  
      */
     virtual void get_special_file_path(char *buf, size_t buflen, int id) = 0;
+
+    /*
+     *   Get the autosave filename.  If the host wants to save the game
+     *   state automatically at the program's command prompt, through
+     *   vm_autosave(), it returns the name of the file to write; otherwise
+     *   it returns null, which is the default.  
+     */
+    virtual const char *get_autosave_file() { return 0; }
+
+    /*
+     *   Write an autosave file.  'buf' holds the complete contents of the
+     *   saved state file, allocated with t3malloc(); we take ownership of
+     *   the buffer and must free it with t3free() when done with it.
+     *   
+     *   The VM calls this from its own thread as soon as it has serialized
+     *   the game state into memory, so the host is free to do the actual
+     *   disk write in the background while it waits for input.  The
+     *   default implementation simply writes the file synchronously.
+     *   Errors are ignored, since an autosave failure shouldn't interrupt
+     *   the game.  
+     */
+    virtual void write_autosave(const char *fname, char *buf, size_t len)
+    {
+        osfildef *fp = osfopwb(fname, OSFTT3SAV);
+        if (fp != 0)
+        {
+            osfwb(fp, buf, len);
+            osfcls(fp);
+        }
+        t3free(buf);
+    }
+
+    /*
+     *   Get the startup snapshot filename.  If the host wants the VM to
+     *   cache the program state as it stands just after the static
+     *   initializers run, so that later launches of the same image can
+     *   restore it instead of running them again, it returns the name of
+     *   the cache file for the current image; otherwise it returns null,
+     *   which is the default.  The VM writes the file through
+     *   write_autosave().  
+     */
+    virtual const char *get_snapshot_file() { return 0; }
+
+    /*
+     *   Map a file into memory, read-only.  On success, returns a pointer
+     *   to the start of the file's contents and fills in '*len' with the
+     *   file's size; the mapping remains valid until unmap_file().  Returns
+     *   null if the host can't map the file, in which case the caller
+     *   should read it the ordinary way.  The default implementation
+     *   doesn't support mapping.  
+     */
+    virtual const char *map_file(const char *fname, unsigned long *len)
+        { return 0; }
+
+    /* release a mapping created with map_file() */
+    virtual void unmap_file(const char *mem) { }
+
+    /*
+     *   Get a shared, unmasked copy of a masked pool page in a mapped image
+     *   file.  'src' points to the page's data within a mapping returned
+     *   by map_file(), 'len' is its size, and 'xor_mask' is the mask to
+     *   remove.  A host that runs several VM instances on the same image
+     *   can keep one copy of each page for all of them, so that only the
+     *   first instance to use a page pays for it.  The page is read-only,
+     *   and remains valid until released with release_shared_page().
+     *
+     *   Returns null if the host doesn't share pages, which is the default;
+     *   the VM then makes its own private copy.
+     */
+    virtual const char *get_shared_page(const char *src, size_t len,
+                                        uchar xor_mask)
+        { return 0; }
+
+    /*
+     *   Release a page obtained from get_shared_page().  Returns true if
+     *   this was one of our shared pages, false if not.
+     */
+    virtual int release_shared_page(const char *page) { return FALSE; }
 };
 
 #endif /* VMHOST_H */
@@ -163,6 +163,8 @@ CVmImageLoader::CVmImageLoader(CVmImageFile *fp, const char *fname,
     /* there's no reflection LookupTable yet */
     reflection_symtab_ = VM_INVALID_OBJ;
     reflection_macros_ = VM_INVALID_OBJ;
+    reflection_symtab_var_ = 0;
+    reflection_macros_var_ = 0;
 
     /* create the exported symbol hash table */
     exports_ = new CVmHashTable(64, new CVmHashFuncCS(), TRUE);
@@ -175,6 +177,10 @@ CVmImageLoader::CVmImageLoader(CVmImageFile *fp, const char *fname,
 
     /* we don't have a static initializer code offset yet */
     static_cs_ofs_ = 0;
+
+    /* no pristine state yet */
+    pristine_ = 0;
+    pristine_len_ = 0;
 }
 
 /*
@@ -202,6 +208,10 @@ CVmImageLoader::~CVmImageLoader()
     delete exports_;
     delete synth_exports_;
 
+    /* delete the pristine state */
+    if (pristine_ != 0)
+        t3free(pristine_);
+
     /* delete the static initializer pages */
     while (static_head_ != 0)
     {
@@ -222,6 +232,59 @@ CVmImageLoader::~CVmImageLoader()
 }
 
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Startup timer
+ */
+CVmStartupTimer *CVmImageLoader::startup_timer_ = 0;
+
+/*
+ *   Block load time accumulator for the startup timer.  We keep one entry
+ *   per distinct block type; an image only uses a dozen or so types, so a
+ *   small linear table is all we need.  
+ */
+struct vmimg_block_time
+{
+    /* phase name: "load XXXX", where XXXX is the block type */
+    char name[10];
+
+    /* start of the first block of this type */
+    double start;
+
+    /* total time spent and number of blocks of this type */
+    double ms;
+    ulong cnt;
+};
+const size_t VMIMG_MAX_BLOCK_TIMES = 32;
+
+static void add_block_time(vmimg_block_time *tab, size_t *cnt,
+                           const char *type, double start, double ms)
+{
+    size_t i;
+
+    /* look for an existing entry for the type */
+    for (i = 0 ; i < *cnt && memcmp(tab[i].name + 5, type, 4) != 0 ; ++i) ;
+
+    /* if it's a new type, add an entry, if there's room */
+    if (i == *cnt)
+    {
+        if (i == VMIMG_MAX_BLOCK_TIMES)
+            return;
+
+        memcpy(tab[i].name, "load ", 5);
+        memcpy(tab[i].name + 5, type, 4);
+        tab[i].name[9] = '\0';
+        tab[i].start = start;
+        tab[i].ms = 0;
+        tab[i].cnt = 0;
+        ++*cnt;
+    }
+
+    /* count it */
+    tab[i].ms += ms;
+    tab[i].cnt += 1;
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   load the image 
@@ -230,6 +293,10 @@ void CVmImageLoader::load(VMG0_)
 {
     char buf[128];
     int done;
+    CVmStartupTimer *timer = startup_timer_;
+    vmimg_block_time block_times[VMIMG_MAX_BLOCK_TIMES];
+    size_t block_time_cnt = 0;
+    double t0 = (timer != 0 ? timer->now_ms() : 0);
 
     /* set myself to be the global image loader */
     G_image_loader = this;
@@ -252,6 +319,8 @@ void CVmImageLoader::load(VMG0_)
         ulong siz;
         uint flags;
         
+        double tblk = (timer != 0 ? timer->now_ms() : 0);
+
         /* read the next data block header */
         fp_->copy_data(buf, 10);
 
@@ -369,8 +438,16 @@ void CVmImageLoader::load(VMG0_)
             /* skip past the block */
             fp_->skip_ahead(siz);
         }
+
+        /* if we're timing startup, count the time for this block type */
+        if (timer != 0)
+            add_block_time(block_times, &block_time_cnt, buf,
+                           tblk, timer->now_ms() - tblk);
     }
 
+    /* note where the post-load linking and initialization starts */
+    double tlink = (timer != 0 ? timer->now_ms() : 0);
+
     /* the image file is required to contain an entrypoint definition */
     if (!loaded_entrypt_)
         err_throw(VMERR_IMAGE_NO_ENTRYPT);
@@ -438,6 +515,19 @@ void CVmImageLoader::load(VMG0_)
      */
     os_init_ui_after_load(G_bif_table, G_meta_table);
 
+    /* report the startup times, if desired */
+    if (timer != 0)
+    {
+        double tend = timer->now_ms();
+        size_t i;
+
+        for (i = 0 ; i < block_time_cnt ; ++i)
+            timer->add_phase(block_times[i].name, block_times[i].start,
+                             block_times[i].ms, block_times[i].cnt);
+        timer->add_phase("link and post-load init", tlink, tend - tlink, 1);
+        timer->add_phase("image load", t0, tend - t0, 1);
+    }
+
     /* forget the image loader */
     G_image_loader = 0;
 }
@@ -795,31 +885,38 @@ void CVmImageLoader::run(VMG_ const char *const *argv, int argc,
         if (macro_symtab != 0)
             runtime_macros_ = macro_symtab;
 
-        /* create a LookupTable for the reflection symbols, if any */
-        create_global_symtab_lookup_table(vmg0_);
-
         /* 
-         *   if we successfully created a reflection symbol table, push it
-         *   onto the stack - this will ensure that the object won't be
-         *   discarded as long as the program is running 
+         *   Note that we don't build the reflection LookupTables for the
+         *   global symbols and macros here.  Most sessions never ask for
+         *   them, and for a debug build of a large game they're thousands
+         *   of strings and lists, so we wait until the program actually
+         *   retrieves one (see get_reflection_symtab()).
+         *   
+         *   Run static initializers.  If the host has a snapshot of the
+         *   state as it stood after the initializers ran on an earlier
+         *   launch, restore that instead; otherwise run them, and take a
+         *   snapshot for next time.  
          */
-        if (reflection_symtab_ != VM_INVALID_OBJ)
+        double tinit = (startup_timer_ != 0 ? startup_timer_->now_ms() : 0);
+        if (CVmSaveFile::restore_snapshot(vmg0_))
         {
-            /* set up an object value for the table and push it */
-            G_stk->push()->set_obj(reflection_symtab_);
+            if (startup_timer_ != 0)
+                startup_timer_->add_phase(
+                    "restore startup snapshot", tinit,
+                    startup_timer_->now_ms() - tinit, 1);
+        }
+        else
+        {
+            run_static_init(vmg0_);
+            if (startup_timer_ != 0)
+                startup_timer_->add_phase(
+                    "static init", tinit,
+                    startup_timer_->now_ms() - tinit, 1);
+            CVmSaveFile::save_snapshot(vmg0_);
         }
 
-        /* create and stack the reflection LookupTable for macros */
-        create_macro_symtab_lookup_table(vmg0_);
-        if (reflection_macros_ != VM_INVALID_OBJ)
-            G_stk->push()->set_obj(reflection_macros_);
-
-        /* 
-         *   run static initializers (do this after creating the symbol
-         *   table, in case any of the initializers want to access the
-         *   symbol table) 
-         */
-        run_static_init(vmg0_);
+        /* keep the post-initializer state for fast restarts */
+        CVmSaveFile::save_pristine(vmg0_);
 
         /* if there's a saved state file to restore, push it */
         if (saved_state != 0)
@@ -933,22 +1030,29 @@ void CVmImageLoader::run(VMG_ const char *const *argv, int argc,
             (const uchar *)G_code_pool->get_ptr(entry_code_ofs),
             entry_code_argc, &rc);
 
-        /* 
-         *   if we pushed a global symbol table LookupTable object, pop it -
-         *   we left it on the stack to protect it from the garbage
-         *   collector, since it's always implicitly referenced from the
-         *   intrinsic function that retrieves the symbol table object 
-         */
-        if (reflection_macros_ != VM_INVALID_OBJ)
-            G_stk->discard();
-        if (reflection_symtab_ != VM_INVALID_OBJ)
-            G_stk->discard();
     }
     err_finally
     {
         /* forget the image loader */
         G_image_loader = 0;
 
+        /* 
+         *   drop the reflection LookupTables, if we built them; they're
+         *   specific to the symbol tables we're about to restore 
+         */
+        if (reflection_symtab_var_ != 0)
+        {
+            G_obj_table->delete_global_var(reflection_symtab_var_);
+            reflection_symtab_var_ = 0;
+        }
+        if (reflection_macros_var_ != 0)
+        {
+            G_obj_table->delete_global_var(reflection_macros_var_);
+            reflection_macros_var_ = 0;
+        }
+        reflection_symtab_ = VM_INVALID_OBJ;
+        reflection_macros_ = VM_INVALID_OBJ;
+
         /* restore the original runtime symbol tables */
         runtime_symtab_ = orig_runtime_symtab;
         runtime_macros_ = orig_runtime_macros;
@@ -974,6 +1078,30 @@ void CVmImageLoader::run(VMG_ const char *const *argv, int argc,
     err_end;
 }
 
+/*
+ *   Set the pristine state 
+ */
+void CVmImageLoader::set_pristine_state(char *buf, size_t len)
+{
+    /* drop any previous state, and take over the new one */
+    if (pristine_ != 0)
+        t3free(pristine_);
+    pristine_ = buf;
+    pristine_len_ = len;
+}
+
+/*
+ *   Take the pristine state 
+ */
+char *CVmImageLoader::take_pristine_state(size_t *len)
+{
+    char *buf = pristine_;
+    *len = pristine_len_;
+    pristine_ = 0;
+    pristine_len_ = 0;
+    return buf;
+}
+
 /*
  *   Run static initializers 
  */
@@ -1076,6 +1204,21 @@ void CVmImageLoader::unload(VMG0_)
 }
 
 /* ------------------------------------------------------------------------ */
+/*
+ *   Get the reflection LookupTables, building them on first use 
+ */
+vm_obj_id_t CVmImageLoader::get_reflection_symtab(VMG0_)
+{
+    create_global_symtab_lookup_table(vmg0_);
+    return reflection_symtab_;
+}
+
+vm_obj_id_t CVmImageLoader::get_reflection_macros(VMG0_)
+{
+    create_macro_symtab_lookup_table(vmg0_);
+    return reflection_macros_;
+}
+
 /*
  *   Create a LookupTable to hold the symbols in the global symbol table. 
  */
@@ -1105,8 +1248,13 @@ void CVmImageLoader::create_global_symtab_lookup_table(VMG0_)
     /* get the object, properly cast */
     lookup = (CVmObjLookupTable *)vm_objp(vmg_ reflection_symtab_);
 
-    /* push the lookup table onto the stack for gc protection */
-    G_stk->push()->set_obj(reflection_symtab_);
+    /* 
+     *   keep it in a global variable, which protects it from gc while we
+     *   build it and for as long as the program runs, since it's always
+     *   implicitly referenced from the intrinsic that retrieves it 
+     */
+    reflection_symtab_var_ = G_obj_table->create_global_var();
+    reflection_symtab_var_->val.set_obj(reflection_symtab_);
 
     /* run through the symbols and populate the LookupTable */
     for (sym = runtime_symtab_->get_head() ; sym != 0 ; sym = sym->nxt)
@@ -1135,9 +1283,6 @@ void CVmImageLoader::create_global_symtab_lookup_table(VMG0_)
          */
         lookup->add_entry(vmg_ &str, &sym->val);
     }
-
-    /* done working - discard our gc protection */
-    G_stk->discard();
 }
 
 /*
@@ -1166,8 +1311,9 @@ void CVmImageLoader::create_macro_symtab_lookup_table(VMG0_)
     /* get the object, properly cast */
     lookup = (CVmObjLookupTable *)vm_objp(vmg_ reflection_macros_);
 
-    /* push the lookup table onto the stack for gc protection */
-    G_stk->push()->set_obj(reflection_macros_);
+    /* keep it in a global variable, as with the global symbol table */
+    reflection_macros_var_ = G_obj_table->create_global_var();
+    reflection_macros_var_->val.set_obj(reflection_macros_);
 
     /* run through the symbols and populate the LookupTable */
     for (sym = runtime_macros_->get_head() ; sym != 0 ; sym = sym->nxt)
@@ -1231,9 +1377,6 @@ void CVmImageLoader::create_macro_symtab_lookup_table(VMG0_)
         /* done with the symbol and list gc protection */
         G_stk->discard(2);
     }
-
-    /* done working - discard our gc protection */
-    G_stk->discard();
 }
 
 
@@ -2796,15 +2939,51 @@ const char *CVmImagePool::
                              size_t load_size)
 {
     CVmImagePool_pg *info;
+    const char *mem;
     
     /* get the page information */
     info = get_page_info_ofs(ofs);
+
+    /* 
+     *   Remember the current file position, so that we can restore it when
+     *   we're done.  A pool that loads pages on demand can ask for a page
+     *   at any time, including while the loader is in the middle of
+     *   reading another block from the same file.  
+     */
+    long oldpos = fp_->get_seek();
     
     /* seek to the correct location in the image file */
     seek_page_ofs(ofs);
 
-    /* ask the underlying file to load the data */
-    return fp_->alloc_and_read(load_size, info->xor_mask, load_size);
+    /* 
+     *   If the page is masked and the file can't give us a private copy
+     *   (as with an in-memory image), make our own copy to unmask.
+     *   Otherwise, ask the underlying file to load the data.  
+     */
+    if (info->xor_mask != 0 && !fp_->allow_write_to_alloc())
+    {
+        /* if another VM instance has already unmasked it, share that */
+        if ((mem = fp_->alloc_and_read_shared(load_size,
+                                              info->xor_mask)) != 0)
+        {
+            fp_->seek(oldpos);
+            return mem;
+        }
+
+        char *buf = (char *)t3malloc(load_size);
+        if (buf == 0)
+            err_throw(VMERR_OUT_OF_MEMORY);
+
+        fp_->copy_data(buf, load_size);
+        apply_xor_mask(buf, load_size, info->xor_mask);
+        mem = buf;
+    }
+    else
+        mem = fp_->alloc_and_read(load_size, info->xor_mask, load_size);
+
+    /* go back to where we were, and return the page */
+    fp_->seek(oldpos);
+    return mem;
 }
 
 /*
@@ -2818,6 +2997,9 @@ void CVmImagePool::vmpbs_load_page(pool_ofs_t ofs, size_t /*page_size*/,
     /* get the page information */
     info = get_page_info_ofs(ofs);
 
+    /* note the current file position, so we can restore it afterwards */
+    long oldpos = fp_->get_seek();
+
     /* seek to the correct location in the image file */
     seek_page_ofs(ofs);
 
@@ -2826,16 +3008,29 @@ void CVmImagePool::vmpbs_load_page(pool_ofs_t ofs, size_t /*page_size*/,
 
     /* apply the XOR mask to the loaded data */
     apply_xor_mask(mem, load_size, info->xor_mask);
+
+    /* go back to where we were */
+    fp_->seek(oldpos);
 }
 
 /* 
  *   free a page previously loaded 
  */
-void CVmImagePool::vmpbs_free_page(const char *mem, pool_ofs_t /*ofs*/,
+void CVmImagePool::vmpbs_free_page(const char *mem, pool_ofs_t ofs,
                                    size_t /*page_size*/)
 {
-    /* tell the file to free the memory */
-    fp_->free_mem(mem);
+    /* 
+     *   if we got a shared unmasked copy of the page, release it; if we made
+     *   our own copy, free it; otherwise tell the file to free the memory 
+     */
+    if (get_page_info_ofs(ofs)->xor_mask != 0
+        && !fp_->allow_write_to_alloc())
+    {
+        if (!fp_->free_shared(mem))
+            t3free((char *)mem);
+    }
+    else
+        fp_->free_mem(mem);
 }
 
 /*
@@ -3154,6 +3349,39 @@ const char *CVmImageFileMem::alloc_and_read(size_t len, uchar xor_mask,
     return ret;
 }
 
+/*
+ *   get a shared unmasked copy of masked data 
+ */
+const char *CVmImageFileMem::alloc_and_read_shared(size_t len,
+                                                   uchar xor_mask)
+{
+    /* if we're past the end of the file, throw an error */
+    if (pos_ + len > len_)
+        err_throw(VMERR_READ_PAST_IMG_END);
+
+    /* we can only share through the host that mapped our memory */
+    if (hostifc_ == 0)
+        return 0;
+
+    /* ask the host for its copy */
+    const char *ret = hostifc_->get_shared_page(mem_ + pos_, len, xor_mask);
+
+    /* if we got it, seek past the data */
+    if (ret != 0)
+        pos_ += len;
+
+    /* return the copy */
+    return ret;
+}
+
+/*
+ *   release a shared copy 
+ */
+int CVmImageFileMem::free_shared(const char *mem)
+{
+    return hostifc_ != 0 && hostifc_->release_shared_page(mem);
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Generic stream implementation for an image file block 
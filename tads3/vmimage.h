@@ -221,6 +221,34 @@ private:
     class CVmImageFile *fp_;
 };
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Startup timer.  A host application that wants to see where the time
+ *   goes while an image starts up can install one of these with
+ *   CVmImageLoader::set_startup_timer().  The loader then reports the time
+ *   it spends on each type of image block, and on static initialization.
+ *   The VM has no portable high-resolution clock of its own, so the host
+ *   supplies the clock, too.  
+ */
+class CVmStartupTimer
+{
+public:
+    virtual ~CVmStartupTimer() { }
+
+    /* get the current time in milliseconds, from an arbitrary zero point */
+    virtual double now_ms() = 0;
+
+    /* 
+     *   record a startup phase: 'name' is a short description, 'start_ms'
+     *   is the time (per now_ms()) when the phase started, 'ms' is the
+     *   elapsed time, and 'cnt' is the number of times the phase ran (for
+     *   example, the number of image blocks of a given type, in which case
+     *   'start_ms' is the start of the first one) 
+     */
+    virtual void add_phase(const char *name, double start_ms, double ms,
+                           ulong cnt) = 0;
+};
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Image loader.  This takes an image file interface object (see below),
@@ -286,6 +314,10 @@ public:
     /* run all static initializers */
     void run_static_init(VMG0_);
 
+    /* get the runtime global symbol table, if we have one */
+    class CVmRuntimeSymbols *get_runtime_symtab() const
+        { return runtime_symtab_; }
+
     /*
      *   Unload the image.  This should be called after execution is
      *   finished to disactivate the pools, which must be done before the
@@ -333,12 +365,12 @@ public:
 
     /* 
      *   get the object ID of the LookupTable with the global symbol table
-     *   for reflection purposes 
+     *   for reflection purposes; we build the table on the first call 
      */
-    vm_obj_id_t get_reflection_symtab() const { return reflection_symtab_; }
+    vm_obj_id_t get_reflection_symtab(VMG0_);
 
     /* get the object ID of the LookupTable with the macro table */
-    vm_obj_id_t get_reflection_macros() const { return reflection_macros_; }
+    vm_obj_id_t get_reflection_macros(VMG0_);
 
     /*
      *   perform dynamic linking after loading, resetting, or restoring 
@@ -362,12 +394,32 @@ public:
     int restore_synth_exports(VMG_ class CVmFile *fp,
                               class CVmObjFixup *fixups);
 
+    /*
+     *   Set the pristine state: a saved state image (in the format of
+     *   CVmSaveFile::save_to_memory()) of the program as it stood just
+     *   after the static initializers ran.  We take ownership of the
+     *   buffer, which must be allocated with t3malloc().  
+     */
+    void set_pristine_state(char *buf, size_t len);
+
+    /* 
+     *   Take the pristine state buffer, if we have one.  The caller owns
+     *   the buffer until it gives it back with set_pristine_state().  
+     */
+    char *take_pristine_state(size_t *len);
+
     /* get the starting offset of static initializers in the code pool */
     ulong get_static_cs_ofs() const { return static_cs_ofs_; }
 
     /* get the entrypoint function's code pool offset */
     uint32_t get_entrypt() const { return entrypt_; }
 
+    /* 
+     *   set the startup timer (null to turn off startup timing); this
+     *   applies to all loaders in the process 
+     */
+    static void set_startup_timer(CVmStartupTimer *t) { startup_timer_ = t; }
+
 private:
     /* load external resource files associated with an image file */
     void load_ext_resfiles(VMG0_);
@@ -535,6 +587,20 @@ private:
     /* object ID of LookupTable containing the macro symbol table */
     vm_obj_id_t reflection_macros_;
 
+    /* 
+     *   global variables holding the reflection LookupTables, to keep them
+     *   from being collected once we've built them 
+     */
+    struct vm_globalvar_t *reflection_symtab_var_;
+    struct vm_globalvar_t *reflection_macros_var_;
+
+    /* the startup timer, if startup timing is on */
+    static CVmStartupTimer *startup_timer_;
+
+    /* the pristine state, if we have one (see set_pristine_state()) */
+    char *pristine_;
+    size_t pristine_len_;
+
     /* head/tail of list of static initializer pages */
     class CVmStaticInitPage *static_head_;
     class CVmStaticInitPage *static_tail_;
@@ -676,6 +742,24 @@ public:
     /* free memory previously allocated by alloc_and_read */
     virtual void free_mem(const char *mem) = 0;
 
+    /*
+     *   Get a shared, read-only, unmasked copy of the masked data at the
+     *   current file position, for a file that can't unmask the data in
+     *   place (see allow_write_to_alloc()).  Several VM instances running
+     *   the same image can share such copies.  On success, seeks past the
+     *   data and returns the copy, which must be released with
+     *   free_shared().  Returns null, without moving the seek position, if
+     *   sharing isn't available; the caller must then make its own copy.
+     */
+    virtual const char *alloc_and_read_shared(size_t len, uchar xor_mask)
+        { return 0; }
+
+    /*
+     *   Release memory if it came from alloc_and_read_shared().  Returns
+     *   true if so, false if the memory isn't ours to release.
+     */
+    virtual int free_shared(const char *mem) { return FALSE; }
+
     /* seek to a new file position, as an offset from the start of the file */
     virtual void seek(long pos) = 0;
 
@@ -877,12 +961,19 @@ class CVmImageFileMem: public CVmImageFile
 public:
     ~CVmImageFileMem() { }
     
-    /* initialize with an underlying block of pre-loaded data */
-    CVmImageFileMem(const char *mem, long len)
+    /*
+     *   Initialize with an underlying block of pre-loaded data.  If the
+     *   block is a mapping created with the host interface's map_file(),
+     *   pass in the host interface, so that we can use its shared pages
+     *   for masked data.  
+     */
+    CVmImageFileMem(const char *mem, long len,
+                    class CVmHostIfc *hostifc = 0)
     {
         /* remember where our data are */
         mem_ = mem;
         len_ = len;
+        hostifc_ = hostifc;
 
         /* start at the beginning of the data */
         pos_ = 0;
@@ -891,7 +982,7 @@ public:
     /* duplicate the file interface */
     CVmImageFile *dup(const char *mode)
     {
-        return new CVmImageFileMem(mem_, len_);
+        return new CVmImageFileMem(mem_, len_, hostifc_);
     }
 
     /* 
@@ -919,6 +1010,10 @@ public:
      */
     void free_mem(const char *) { }
 
+    /* get/release shared unmasked data, via the host interface */
+    const char *alloc_and_read_shared(size_t len, uchar xor_mask);
+    int free_shared(const char *mem);
+
     /* seek to a new file position */
     void seek(long pos) { pos_ = pos; }
 
@@ -937,6 +1032,9 @@ private:
 
     /* current offset within the memory block */
     long pos_;
+
+    /* the host interface that mapped the block, if any */
+    class CVmHostIfc *hostifc_;
 };
 
 
@@ -50,6 +50,8 @@ Modified
 #include "osifcnet.h"
 #include "vmhash.h"
 #include "vmtz.h"
+#include "vmstr.h"
+#include "vmpack.h"
 
 
 
@@ -135,6 +137,12 @@ void vm_init_base(vm_globals **vmg, const vm_init_options *opts)
     /* create the time zone cache */
     G_tzcache = new CVmTimeZoneCache();
 
+    /* create the string hash cache */
+    G_strhash_cache = new CVmObjStrHashCache();
+
+    /* create the pack/unpack template cache */
+    G_pack_cache = new CVmPackCache();
+
     /* initialize the metaclass registration tables */
     vm_register_metaclasses();
 
@@ -165,6 +173,9 @@ void vm_init_base(vm_globals **vmg, const vm_init_options *opts)
     /* presume we're in normal execution mode (not preinit) */
     G_preinit_mode = FALSE;
 
+    /* write uncompressed saved state files by default */
+    G_save_compress = FALSE;
+
     /* allocate the TADS intrinsic function set's globals */
     G_bif_tads_globals = new CVmBifTADSGlobals(vmg0_);
 
@@ -365,6 +376,12 @@ void vm_terminate(vm_globals *vmg__, CVmMainClientIfc *clientifc)
     /* delete the time zone cache */
     delete G_tzcache;
 
+    /* delete the string hash cache */
+    delete G_strhash_cache;
+
+    /* delete the pack/unpack template cache */
+    delete G_pack_cache;
+
     /* delete the error context */
     err_terminate();
 
@@ -17,6 +17,7 @@ Modified
 
 #include "vminit.h"
 #include "vmpool.h"
+#include "vmpoolsl.h"
 #include "vmglob.h"
 
 /* ------------------------------------------------------------------------ */
@@ -37,7 +38,7 @@ void vm_init_flat(vm_globals **vmg, const vm_init_options *opts)
     vmg__ = *vmg;
 
     /* create the flat pools */
-    VM_IF_ALLOC_PRE_GLOBAL(G_code_pool = new CVmPoolFlat());
-    VM_IF_ALLOC_PRE_GLOBAL(G_const_pool = new CVmPoolFlat());
+    VM_IF_ALLOC_PRE_GLOBAL(G_code_pool = new CVmPool_CLASS());
+    VM_IF_ALLOC_PRE_GLOBAL(G_const_pool = new CVmPool_CLASS());
 }
 
@@ -144,6 +144,67 @@ CVmObjIterIdx::CVmObjIterIdx(VMG_ const vm_val_t *coll,
     set_flags(0);
 }
 
+/*
+ *   mark an iterator as belonging to a foreach loop 
+ */
+void CVmObjIterIdx::mark_foreach(VMG_ const vm_val_t *iter)
+{
+    if (iter->typ == VM_OBJ && is_iteridx_obj(vmg_ iter->val.obj))
+    {
+        CVmObjIterIdx *it = (CVmObjIterIdx *)vm_objp(vmg_ iter->val.obj);
+        it->set_flags(it->get_flags() | VMOBJITERIDX_FOREACH);
+    }
+}
+
+/*
+ *   get the collection of a foreach loop iterator 
+ */
+int CVmObjIterIdx::get_foreach_coll(VMG_ const vm_val_t *iter,
+                                    vm_val_t *coll)
+{
+    /* it has to be an indexed iterator marked as a foreach iterator */
+    if (iter->typ != VM_OBJ || !is_iteridx_obj(vmg_ iter->val.obj))
+        return FALSE;
+
+    CVmObjIterIdx *it = (CVmObjIterIdx *)vm_objp(vmg_ iter->val.obj);
+    if ((it->get_flags() & VMOBJITERIDX_FOREACH) == 0)
+        return FALSE;
+
+    /* return the collection */
+    it->get_coll_val(coll);
+    return TRUE;
+}
+
+/*
+ *   reset a foreach loop iterator 
+ */
+int CVmObjIterIdx::reset_foreach(VMG_ const vm_val_t *iter,
+                                 const vm_val_t *coll,
+                                 long first_valid_index,
+                                 long last_valid_index)
+{
+    /* it has to be an indexed iterator marked as a foreach iterator */
+    if (iter->typ != VM_OBJ || !is_iteridx_obj(vmg_ iter->val.obj))
+        return FALSE;
+
+    CVmObjIterIdx *it = (CVmObjIterIdx *)vm_objp(vmg_ iter->val.obj);
+    if ((it->get_flags() & VMOBJITERIDX_FOREACH) == 0)
+        return FALSE;
+
+    /* 
+     *   Set up the new state just as the constructor would.  We don't save
+     *   undo for this, since nothing outside the loop can see the iterator,
+     *   so there's no visible state to restore. 
+     */
+    vmb_put_dh(it->ext_, coll);
+    it->set_cur_index_no_undo(first_valid_index - 1);
+    it->set_first_valid(first_valid_index);
+    it->set_last_valid(last_valid_index);
+
+    /* recycled */
+    return TRUE;
+}
+
 /*
  *   notify of deletion 
  */
@@ -121,6 +121,12 @@ protected:
  *   
  *   VMOBJITERIDX_UNDO - we've saved undo for this savepoint.  If this is
  *   set, we won't save additional undo for the same savepoint.
+ *   
+ *   VMOBJITERIDX_FOREACH - the iterator was created to run a foreach loop,
+ *   and is held only in the loop's hidden iterator local.  Nothing else
+ *   can refer to it, so when the same loop starts again in the same frame,
+ *   the iterator can be reset in place instead of creating a new one.  If
+ *   the collection is a Vector, it's the iterator's private snapshot copy.
  */
 
 /* total extension size */
@@ -133,6 +139,9 @@ protected:
 /* we've saved undo for the current savepoint */
 #define VMOBJITERIDX_UNDO   0x0001
 
+/* we belong to a foreach loop, and can be recycled for the same loop */
+#define VMOBJITERIDX_FOREACH  0x0002
+
 /*
  *   indexed iterator class 
  */
@@ -173,6 +182,32 @@ public:
                                        long first_valid_index,
                                        long last_valid_index);
 
+    /* is the given object an indexed iterator? */
+    static int is_iteridx_obj(VMG_ vm_obj_id_t obj)
+        { return vm_objp(vmg_ obj)->is_of_metaclass(metaclass_reg_); }
+
+    /* 
+     *   Mark a newly created iterator as belonging to a foreach loop (see
+     *   VMOBJITERIDX_FOREACH).  Does nothing if 'iter' isn't an indexed
+     *   iterator. 
+     */
+    static void mark_foreach(VMG_ const vm_val_t *iter);
+
+    /* 
+     *   Get the collection of a foreach loop iterator.  Returns false if
+     *   'iter' isn't an indexed iterator marked with mark_foreach(). 
+     */
+    static int get_foreach_coll(VMG_ const vm_val_t *iter, vm_val_t *coll);
+
+    /* 
+     *   Reset a foreach loop iterator to run over the given collection,
+     *   as though it had just been created with create_for_coll().
+     *   Returns false, without changing anything, if 'iter' isn't an
+     *   indexed iterator marked with mark_foreach(). 
+     */
+    static int reset_foreach(VMG_ const vm_val_t *iter, const vm_val_t *coll,
+                             long first_valid_index, long last_valid_index);
+
     /* notify of deletion */
     void notify_delete(VMG_ int in_root_set);
 
@@ -145,6 +145,77 @@ vm_lookup_ext *vm_lookup_ext::expand_ext(VMG_ CVmObjLookupTable *self,
     return new_ext;
 }
 
+/*
+ *   Reallocate an extension structure with more buckets and values. 
+ */
+vm_lookup_ext *vm_lookup_ext::rehash_ext(VMG_ CVmObjLookupTable *self,
+                                         vm_lookup_ext *old_ext,
+                                         uint new_bucket_cnt,
+                                         uint new_value_cnt)
+{
+    vm_lookup_ext *new_ext;
+    vm_lookup_val **bucketp;
+    vm_lookup_val **free_tail;
+    vm_lookup_val *oldval;
+    vm_lookup_val *newval;
+    uint i;
+
+    /* we must have at least as many entries as the old one had */
+    assert(new_value_cnt >= old_ext->value_cnt);
+
+    /* allocate a new extension structure of the requested size */
+    new_ext = alloc_ext(vmg_ self, new_bucket_cnt, new_value_cnt);
+
+    /* copy the default value */
+    new_ext->default_value = old_ext->default_value;
+
+    /* all of the new buckets are initially empty */
+    for (i = new_bucket_cnt, bucketp = new_ext->buckets ; i != 0 ;
+         --i, ++bucketp)
+        *bucketp = 0;
+
+    /* 
+     *   Copy the values, keeping each at its old pool index.  Link each
+     *   value that's in use into the bucket for its key's hash under the
+     *   new bucket count, and build the free list out of the rest, in
+     *   pool order. 
+     */
+    free_tail = &new_ext->first_free;
+    for (i = 0, newval = new_ext->idx_to_val(0) ; i < new_value_cnt ;
+         ++i, ++newval)
+    {
+        /* get the old value at this index, if there is one */
+        oldval = (i < old_ext->value_cnt ? old_ext->idx_to_val(i) : 0);
+
+        if (oldval != 0 && oldval->key.typ != VM_EMPTY)
+        {
+            /* copy the entry and link it into its new bucket */
+            uint hash = oldval->key.calc_hash(vmg0_) % new_bucket_cnt;
+            newval->key = oldval->key;
+            newval->val = oldval->val;
+            newval->nxt = new_ext->buckets[hash];
+            new_ext->buckets[hash] = newval;
+        }
+        else
+        {
+            /* it's free - mark it as empty and add it to the free list */
+            newval->key.set_empty();
+            newval->val.set_empty();
+            *free_tail = newval;
+            free_tail = &newval->nxt;
+        }
+    }
+
+    /* terminate the free list */
+    *free_tail = 0;
+
+    /* delete the old memory */
+    G_mem->get_var_heap()->free_mem(old_ext);
+
+    /* return the new extension */
+    return new_ext;
+}
+
 /*
  *   Copy extension data 
  */
@@ -1103,9 +1174,29 @@ void CVmObjLookupTable::expand_if_needed(VMG0_)
     if (new_entry_cnt < get_entry_count() + 16)
         new_entry_cnt = get_entry_count() + 16;
 
-    /* reallocate the extension at the new size */
-    ext_ = (char *)vm_lookup_ext::expand_ext(
-        vmg_ this, get_ext(), new_entry_cnt);
+    /* 
+     *   If the bigger pool would overload the buckets, add buckets too, so
+     *   that the average chain stays short.  Otherwise just add values. 
+     */
+    uint bucket_cnt = get_bucket_count();
+    if (new_entry_cnt > bucket_cnt * VMLOOKUP_MAX_LOAD
+        && bucket_cnt < VMLOOKUP_MAX_BUCKETS)
+    {
+        /* aim for about one entry per bucket in the new pool */
+        uint new_bucket_cnt = new_entry_cnt | 1;
+        if (new_bucket_cnt > VMLOOKUP_MAX_BUCKETS)
+            new_bucket_cnt = VMLOOKUP_MAX_BUCKETS;
+
+        /* reallocate and rehash the extension */
+        ext_ = (char *)vm_lookup_ext::rehash_ext(
+            vmg_ this, get_ext(), new_bucket_cnt, new_entry_cnt);
+    }
+    else
+    {
+        /* reallocate the extension at the new size */
+        ext_ = (char *)vm_lookup_ext::expand_ext(
+            vmg_ this, get_ext(), new_entry_cnt);
+    }
 }
 
 /* ------------------------------------------------------------------------ */
@@ -1391,6 +1482,10 @@ int CVmObjLookupTable::for_each_gen(VMG_ vm_obj_id_t self,
     /* the function to invoke is the top argument */
     fn = G_stk->get(0);
 
+    /* resolve the callback once for all of the calls below */
+    vm_cbcall cbc;
+    G_interpreter->prep_callback(vmg_ &cbc, fn, pass_key_to_cb ? 2 : 1);
+
     /* push a self-reference for gc protection */
     G_stk->push()->set_obj(self);
 
@@ -1412,8 +1507,7 @@ int CVmObjLookupTable::for_each_gen(VMG_ vm_obj_id_t self,
                 G_stk->push(&entry->key);
             
             /* invoke the callback */
-            G_interpreter->call_func_ptr(vmg_ fn, pass_key_to_cb ? 2 : 1,
-                                         rc, 0);
+            G_interpreter->call_prepared(vmg_ &cbc, rc);
         }
     }
 
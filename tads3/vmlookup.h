@@ -80,6 +80,20 @@ Modified
 /* value entry size */
 #define VMLOOKUP_VALUE_SIZE  (VMB_DATAHOLDER + VMB_DATAHOLDER + VMB_UINT2)
 
+/*
+ *   Maximum average hash chain length.  When we expand the value pool, if
+ *   the new pool would hold more than this many entries per bucket, we add
+ *   buckets as well, so that lookups in a table that has grown well past
+ *   its creation size don't degrade into long linear chain scans.  
+ */
+#define VMLOOKUP_MAX_LOAD  2
+
+/* 
+ *   Maximum number of buckets we'll grow to on our own.  The bucket count
+ *   is stored as a UINT2 in the image and saved state formats. 
+ */
+#define VMLOOKUP_MAX_BUCKETS  65521
+
 /* ------------------------------------------------------------------------ */
 /*
  *   in-memory value entry structure 
@@ -124,6 +138,17 @@ struct vm_lookup_ext
                                      vm_lookup_ext *old_ext,
                                      uint new_value_cnt);
 
+    /*
+     *   Reallocate the structure with a larger number of buckets and
+     *   values, rehashing the keys into the new buckets.  Each value keeps
+     *   its index in the value pool, so iteration order (which follows the
+     *   pool) is unchanged.  Deletes the old structure.  
+     */
+    static vm_lookup_ext *rehash_ext(VMG_ class CVmObjLookupTable *self,
+                                     vm_lookup_ext *old_ext,
+                                     uint new_bucket_cnt,
+                                     uint new_value_cnt);
+
     /* 
      *   Copy the given extension's data into myself.  This can only be used
      *   when we have the same bucket count as the original (the entry count
@@ -326,6 +351,9 @@ public:
 
     /* notify of deletion */
     void notify_delete(VMG_ int in_root_set);
+    /* report our memory use */
+    size_t get_mem_usage(VMG_ int) const
+        { return get_ext_heap_bytes(vmg0_); }
 
     /* set a property */
     void set_prop(VMG_ class CVmUndo *undo,
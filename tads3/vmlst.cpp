@@ -506,6 +506,7 @@ void CVmObjList::add_to_list(VMG_ vm_val_t *result,
     int lhs_cnt, rhs_cnt, alo_cnt;
     vm_obj_id_t obj;
     CVmObjList *objptr;
+    const char *rhs_lst;
 
     /* push self and the other list for protection against GC */
     G_stk->push()->set_obj(self);
@@ -533,6 +534,16 @@ void CVmObjList::add_to_list(VMG_ vm_val_t *result,
         /* single value - add it as-is */
         objptr->cons_set_element(lhs_cnt, rhs);
     }
+    else if ((rhs_lst = rhs->get_as_list(vmg0_)) != 0)
+    {
+        /* 
+         *   The right-hand side is an actual list, so its elements are
+         *   already in our format - copy them as a block rather than
+         *   retrieving and storing them one at a time.  This is the common
+         *   case of building up a list by concatenation.  
+         */
+        objptr->cons_copy_elements(lhs_cnt, rhs_lst);
+    }
     else
     {
         /* 
@@ -1159,6 +1170,17 @@ void CVmObjList::new_iterator(VMG_ vm_val_t *retval,
     retval->set_obj(CVmObjIterIdx::create_for_coll(vmg_ self_val, 1, len));
 }
 
+/*
+ *   Reset a foreach loop iterator.  Since a list is immutable, the
+ *   iterator can refer directly to the list, just as in new_iterator().  
+ */
+int CVmObjList::reset_iterator(VMG_ const vm_val_t *iter,
+                               const vm_val_t *self_val)
+{
+    return CVmObjIterIdx::reset_foreach(
+        vmg_ iter, self_val, 1, vmb_get_len(self_val->get_as_list(vmg0_)));
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Evaluate a property 
@@ -1253,44 +1275,47 @@ int CVmObjList::getp_subset(VMG_ vm_val_t *retval, const vm_val_t *self_val,
     /* get the function pointer argument, but leave it on the stack */
     func_val = G_stk->get(0);
 
+    /* resolve the callback once for all of the calls below */
+    vm_cbcall cbc;
+    G_interpreter->prep_callback(vmg_ &cbc, func_val, 1);
+
     /* push a self-reference while allocating to protect from gc */
     G_stk->push(self_val);
 
     /* 
-     *   Make a copy of our list for the return value.  The result value
-     *   will be at most the same size as our current list; since we have
-     *   no way of knowing exactly how large it will be, and since we
-     *   don't want to run through the selection functions twice, we'll
-     *   just allocate at the maximum size and leave it partially unused
-     *   if we don't need all of the space.  By making a copy of the input
-     *   list, we also can avoid worrying about whether the input list was
-     *   a constant, and hence we don't have to worry about the
-     *   possibility of constant page swapping.  
+     *   Push a placeholder for the result list.  We'll fill it in if and
+     *   when we create the list, and it will protect the list from the
+     *   garbage collector, which could be invoked in the course of
+     *   executing the user callback.  
      */
-    retval->set_obj(create(vmg_ FALSE, lst));
-
-    /* get the return value list data */
-    new_lst_obj = (CVmObjList *)vm_objp(vmg_ retval->val.obj);
-    new_lst = new_lst_obj->ext_;
+    vm_val_t *new_lst_val = G_stk->push();
+    new_lst_val->set_nil();
+    new_lst_obj = 0;
 
     /* get the length of the list */
-    cnt = vmb_get_len(new_lst);
-
-    /* 
-     *   push a reference to the new list to protect it from the garbage
-     *   collector, which could be invoked in the course of executing the
-     *   user callback 
-     */
-    G_stk->push(retval);
+    cnt = vmb_get_len(lst);
 
     /*
      *   Go through each element of our list, and invoke the callback on
      *   each element.  If the element passes, write it to the current
      *   output location in the list; otherwise, just skip it.
      *   
-     *   Note that we're using the same list as source and destination,
-     *   which is easy because the list will either shrink or stay the
-     *   same - we'll never need to insert new elements.  
+     *   We don't create the result list until we find the first element
+     *   that fails the test.  Until then, the result is simply a prefix of
+     *   the original list, and if every element passes, the result is
+     *   identical to the original list - since lists are immutable, we can
+     *   just return the original in that case, and skip making a copy at
+     *   all.  Filters that pass everything are common in practice (a
+     *   subset() that trims an occasional element from a list that's
+     *   usually already clean, for example), and in those cases this saves
+     *   the whole allocation.
+     *   
+     *   Once we do make the copy, we use it as both source and destination,
+     *   which is easy because the list will either shrink or stay the same
+     *   - we'll never need to insert new elements.  By working from a copy
+     *   of the input list, we also can avoid worrying about whether the
+     *   input list was a constant, and hence we don't have to worry about
+     *   the possibility of constant page swapping.  
      */
     for (src = dst = 0 ; src < cnt ; ++src)
     {
@@ -1299,13 +1324,23 @@ int CVmObjList::getp_subset(VMG_ vm_val_t *retval, const vm_val_t *self_val,
         
         /* 
          *   get this element (using a 1-based index), and push it as the
-         *   callback's argument 
+         *   callback's argument; until we've made our copy, read from the
+         *   original list, re-translating it in case of swapping 
          */
-        index_list(vmg_ &ele, new_lst, src + 1);
+        if (new_lst_obj != 0)
+        {
+            index_list(vmg_ &ele, new_lst, src + 1);
+        }
+        else
+        {
+            VM_IF_SWAPPING_POOL(if (self_val->typ == VM_LIST)
+                lst = self_val->get_as_list(vmg0_);)
+            index_list(vmg_ &ele, lst, src + 1);
+        }
         G_stk->push(&ele);
 
         /* invoke the callback */
-        G_interpreter->call_func_ptr(vmg_ func_val, 1, &rc, 0);
+        G_interpreter->call_prepared(vmg_ &cbc, &rc);
 
         /* get the result from R0 */
         val = G_interpreter->get_r0();
@@ -1317,23 +1352,65 @@ int CVmObjList::getp_subset(VMG_ vm_val_t *retval, const vm_val_t *self_val,
         if (val->typ == VM_NIL
             || (val->typ == VM_INT && val->val.intval == 0))
         {
-            /* it's nil or zero - don't include it in the result */
+            /* 
+             *   It's nil or zero - don't include it in the result.  If this
+             *   is the first element we've rejected, it's time to make our
+             *   copy of the list; everything before this element passed,
+             *   so the copy's first 'dst' elements are already correct.  
+             */
+            if (new_lst_obj == 0)
+            {
+                /* re-translate the list address in case of swapping */
+                VM_IF_SWAPPING_POOL(if (self_val->typ == VM_LIST)
+                    lst = self_val->get_as_list(vmg0_);)
+
+                /* make the copy */
+                new_lst_val->set_obj(create(vmg_ FALSE, lst));
+
+                /* get the return value list data */
+                new_lst_obj = (CVmObjList *)vm_objp(vmg_ new_lst_val->val.obj);
+                new_lst = new_lst_obj->ext_;
+            }
         }
         else
         {
-            /* include this element in the result */
-            new_lst_obj->cons_set_element(dst, &ele);
+            /* include this element in the result, if we're copying */
+            if (new_lst_obj != 0)
+                new_lst_obj->cons_set_element(dst, &ele);
 
             /* advance the output index */
             ++dst;
         }
     }
 
-    /* 
-     *   set the result list length to the number of elements we actually
-     *   copied 
-     */
-    new_lst_obj->cons_set_len(dst);
+    if (new_lst_obj != 0)
+    {
+        /* 
+         *   set the result list length to the number of elements we
+         *   actually copied 
+         */
+        new_lst_obj->cons_set_len(dst);
+
+        /* return the new list */
+        *retval = *new_lst_val;
+    }
+    else if (self_val->typ == VM_LIST
+             || (self_val->typ == VM_OBJ
+                 && vm_objp(vmg_ self_val->val.obj)->get_metaclass_reg()
+                    == metaclass_reg_))
+    {
+        /* every element passed, so the result is the original list */
+        *retval = *self_val;
+    }
+    else
+    {
+        /* 
+         *   every element passed, but 'self' is something other than a
+         *   plain list (an instance of a subclass, for example), so return
+         *   a plain list copy of it as usual 
+         */
+        retval->set_obj(create(vmg_ FALSE, lst));
+    }
 
     /* discard our gc protection (self, return value) and our arguments */
     G_stk->discard(3);
@@ -1368,6 +1445,10 @@ int CVmObjList::getp_map(VMG_ vm_val_t *retval, const vm_val_t *self_val,
     /* get the function pointer argument, but leave it on the stack */
     func_val = G_stk->get(0);
 
+    /* resolve the callback once for all of the calls below */
+    vm_cbcall cbc;
+    G_interpreter->prep_callback(vmg_ &cbc, func_val, 1);
+
     /* push a self-reference while allocating to protect from gc */
     G_stk->push(self_val);
 
@@ -1409,7 +1490,7 @@ int CVmObjList::getp_map(VMG_ vm_val_t *retval, const vm_val_t *self_val,
         index_and_push(vmg_ new_lst, idx + 1);
         
         /* invoke the callback */
-        G_interpreter->call_func_ptr(vmg_ func_val, 1, &rc, 0);
+        G_interpreter->call_prepared(vmg_ &cbc, &rc);
 
         /* store the result in the list */
         new_lst_obj->cons_set_element(idx, G_interpreter->get_r0());
@@ -1705,6 +1786,10 @@ int CVmObjList::gen_index_which(VMG_ vm_val_t *retval,
     /* get the function pointer argument, but leave it on the stack */
     const vm_val_t *func_val = G_stk->get(0);
 
+    /* resolve the callback once for all of the calls below */
+    vm_cbcall cbc;
+    G_interpreter->prep_callback(vmg_ &cbc, func_val, 1);
+
     /* push a self-reference while allocating to protect from gc */
     G_stk->push(self_val);
 
@@ -1739,7 +1824,7 @@ int CVmObjList::gen_index_which(VMG_ vm_val_t *retval,
         index_and_push(vmg_ lst, idx);
 
         /* invoke the callback */
-        G_interpreter->call_func_ptr(vmg_ func_val, 1, rc, 0);
+        G_interpreter->call_prepared(vmg_ &cbc, rc);
 
         /* 
          *   if the callback returned true, we've found the element we're
@@ -1817,6 +1902,11 @@ int CVmObjList::for_each_gen(VMG_ vm_val_t *retval,
     /* get the function pointer argument, but leave it on the stack */
     const vm_val_t *func_val = G_stk->get(0);
 
+    /* resolve the callback once for all of the calls below */
+    vm_cbcall cbc;
+    G_interpreter->prep_callback(vmg_ &cbc, func_val,
+                                 send_idx_to_cb ? 2 : 1);
+
     /* push a self-reference while allocating to protect from gc */
     G_stk->push(self_val);
 
@@ -1844,8 +1934,7 @@ int CVmObjList::for_each_gen(VMG_ vm_val_t *retval,
             G_stk->push()->set_int(idx);
 
         /* invoke the callback */
-        G_interpreter->call_func_ptr(vmg_ func_val, send_idx_to_cb ? 2 : 1,
-                                     rc, 0);
+        G_interpreter->call_prepared(vmg_ &cbc, rc);
     }
 
     /* discard our gc protection (self) and our arguments */
@@ -2032,6 +2121,10 @@ int CVmObjList::getp_count_which(VMG_ vm_val_t *retval,
     /* get the function pointer argument, but leave it on the stack */
     const vm_val_t *func_val = G_stk->get(0);
 
+    /* resolve the callback once for all of the calls below */
+    vm_cbcall cbc;
+    G_interpreter->prep_callback(vmg_ &cbc, func_val, 1);
+
     /* set up a native callback descriptor */
     vm_rcdesc rc(vmg_ "List.countWhich", self_val, 16, G_stk->get(0), argc);
 
@@ -2062,7 +2155,7 @@ int CVmObjList::getp_count_which(VMG_ vm_val_t *retval,
         index_and_push(vmg_ lst, idx);
 
         /* invoke the callback */
-        G_interpreter->call_func_ptr(vmg_ func_val, 1, &rc, 0);
+        G_interpreter->call_prepared(vmg_ &cbc, &rc);
 
         /* get the result from R0 */
         val = G_interpreter->get_r0();
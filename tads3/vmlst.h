@@ -173,6 +173,9 @@ public:
 
     /* notify of deletion */
     void notify_delete(VMG_ int in_root_set);
+    /* report our memory use; an image-file list owns no heap memory */
+    size_t get_mem_usage(VMG_ int in_root_set) const
+        { return in_root_set ? 0 : get_ext_heap_bytes(vmg0_); }
 
     /* set a property */
     void set_prop(VMG_ class CVmUndo *undo,
@@ -638,6 +641,10 @@ protected:
                                    const vm_val_t *self_val)
         { new_iterator(vmg_ retval, self_val); }
 
+    /* reset a foreach loop iterator to iterate over this list */
+    virtual int reset_iterator(VMG_ const vm_val_t *iter,
+                               const vm_val_t *self_val);
+
     /* get the number of elements in the list */
     size_t get_ele_count() const { return vmb_get_len(ext_); }
 
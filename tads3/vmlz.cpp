@@ -0,0 +1,308 @@
+/*
+ *   Please see the accompanying license file, LICENSE.TXT, for information
+ *   on using and copying this software.
+ */
+/*
+Name
+  vmlz.cpp - fast LZ77 block compression
+Function
+  Implements the LZ4 block format compressor and decompressor.
+Notes
+  
+Modified
+  10/14/26  - Creation
+*/
+
+#include <string.h>
+#include "t3std.h"
+#include "vmlz.h"
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Format parameters 
+ */
+
+/* minimum match length */
+#define LZ_MIN_MATCH     4
+
+/* maximum match offset */
+#define LZ_MAX_OFFSET    65535
+
+/* 
+ *   the last match must start at least this many bytes before the end of
+ *   the block, and the last this-many bytes are always literals 
+ */
+#define LZ_MF_LIMIT      12
+#define LZ_LAST_LITERALS 5
+
+/* match finder hash table size (as a power of 2) */
+#define LZ_HASH_BITS     12
+#define LZ_HASH_SIZE     (1 << LZ_HASH_BITS)
+
+/*
+ *   Blocks smaller than this are stored as a single literal run; there's
+ *   no room for a match that meets the end-of-block rules.  
+ */
+#define LZ_MIN_BLOCK     (LZ_MF_LIMIT + 1)
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Hash the four bytes at the given position 
+ */
+static inline unsigned int lz_hash(const unsigned char *p)
+{
+    unsigned long v = (unsigned long)p[0]
+                      | ((unsigned long)p[1] << 8)
+                      | ((unsigned long)p[2] << 16)
+                      | ((unsigned long)p[3] << 24);
+    return (unsigned int)(((v * 2654435761UL) & 0xFFFFFFFFUL)
+                          >> (32 - LZ_HASH_BITS));
+}
+
+/*
+ *   Write an extended length value (the part of a length beyond the 15
+ *   that fits in a token nibble).  Returns the updated output pointer, or
+ *   null if there's no room.  
+ */
+static unsigned char *lz_put_len(unsigned char *op, unsigned char *oend,
+                                 size_t len)
+{
+    for ( ; len >= 255 ; len -= 255)
+    {
+        if (op >= oend)
+            return 0;
+        *op++ = 255;
+    }
+    if (op >= oend)
+        return 0;
+    *op++ = (unsigned char)len;
+    return op;
+}
+
+/*
+ *   Write a sequence: the literal run [lit, lit+litlen), followed by a
+ *   match of 'mlen' bytes at 'offset' back (mlen == 0 means no match,
+ *   for the final sequence).  Returns the updated output pointer, or null
+ *   if there's no room.  
+ */
+static unsigned char *lz_put_seq(unsigned char *op, unsigned char *oend,
+                                 const unsigned char *lit, size_t litlen,
+                                 size_t mlen, size_t offset)
+{
+    /* write the token */
+    if (op >= oend)
+        return 0;
+    unsigned char *tok = op++;
+    *tok = (unsigned char)((litlen >= 15 ? 15 : litlen) << 4);
+
+    /* write the extended literal length and the literals */
+    if (litlen >= 15 && (op = lz_put_len(op, oend, litlen - 15)) == 0)
+        return 0;
+    if ((size_t)(oend - op) < litlen)
+        return 0;
+    memcpy(op, lit, litlen);
+    op += litlen;
+
+    /* if there's no match, we're done */
+    if (mlen == 0)
+        return op;
+
+    /* write the offset */
+    if (oend - op < 2)
+        return 0;
+    *op++ = (unsigned char)(offset & 0xFF);
+    *op++ = (unsigned char)(offset >> 8);
+
+    /* add the match length to the token, and write any extension */
+    mlen -= LZ_MIN_MATCH;
+    *tok |= (unsigned char)(mlen >= 15 ? 15 : mlen);
+    if (mlen >= 15 && (op = lz_put_len(op, oend, mlen - 15)) == 0)
+        return 0;
+
+    return op;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Compress a block 
+ */
+size_t lz_compress(const char *src, size_t srclen, char *dst, size_t dstlen)
+{
+    const unsigned char *base = (const unsigned char *)src;
+    const unsigned char *ip = base;
+    const unsigned char *iend = base + srclen;
+    const unsigned char *anchor = base;
+    unsigned char *op = (unsigned char *)dst;
+    unsigned char *oend = op + dstlen;
+
+    /* search for matches if the block is big enough to have any */
+    if (srclen >= LZ_MIN_BLOCK)
+    {
+        /* 
+         *   hash table of positions, as offsets from the base plus one (so
+         *   that zero means an empty slot) 
+         */
+        size_t *htab = (size_t *)t3malloc(LZ_HASH_SIZE * sizeof(size_t));
+        if (htab == 0)
+            return 0;
+        memset(htab, 0, LZ_HASH_SIZE * sizeof(size_t));
+
+        /* matches must start before this point */
+        const unsigned char *mflimit = iend - LZ_MF_LIMIT;
+
+        /* matches must end before this point */
+        const unsigned char *mlimit = iend - LZ_LAST_LITERALS;
+
+        while (ip < mflimit)
+        {
+            /* look up and update the hash slot for this position */
+            unsigned int h = lz_hash(ip);
+            size_t cand = htab[h];
+            htab[h] = (size_t)(ip - base) + 1;
+
+            /* if there's no usable candidate, move on */
+            const unsigned char *ref = base + cand - 1;
+            if (cand == 0
+                || (size_t)(ip - ref) > LZ_MAX_OFFSET
+                || memcmp(ref, ip, LZ_MIN_MATCH) != 0)
+            {
+                ++ip;
+                continue;
+            }
+
+            /* extend the match forwards */
+            const unsigned char *mp = ip + LZ_MIN_MATCH;
+            const unsigned char *rp = ref + LZ_MIN_MATCH;
+            while (mp < mlimit && *mp == *rp)
+                ++mp, ++rp;
+
+            /* extend the match backwards into the pending literals */
+            while (ip > anchor && ref > base && ip[-1] == ref[-1])
+                --ip, --ref;
+
+            /* write the sequence */
+            op = lz_put_seq(op, oend, anchor, ip - anchor,
+                            mp - ip, ip - ref);
+            if (op == 0)
+            {
+                t3free(htab);
+                return 0;
+            }
+
+            /* 
+             *   Add the position just before the end of the match to the
+             *   hash table, so that runs of repeated records find each
+             *   other, then continue after the match.  
+             */
+            if (mp - 2 < mflimit)
+                htab[lz_hash(mp - 2)] = (size_t)(mp - 2 - base) + 1;
+            ip = anchor = mp;
+        }
+
+        /* done with the hash table */
+        t3free(htab);
+    }
+
+    /* write the remaining literals as the final sequence */
+    op = lz_put_seq(op, oend, anchor, iend - anchor, 0, 0);
+    if (op == 0)
+        return 0;
+
+    /* return the compressed size */
+    return op - (unsigned char *)dst;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Read an extended length.  Returns non-zero on error (running off the
+ *   end of the input).  
+ */
+static int lz_get_len(const unsigned char **ipp, const unsigned char *iend,
+                      size_t *len)
+{
+    const unsigned char *ip = *ipp;
+    for (;;)
+    {
+        if (ip >= iend)
+            return 1;
+
+        unsigned char b = *ip++;
+        *len += b;
+        if (b != 255)
+            break;
+    }
+
+    *ipp = ip;
+    return 0;
+}
+
+/*
+ *   Decompress a block 
+ */
+int lz_decompress(const char *src, size_t srclen, char *dst, size_t dstlen)
+{
+    const unsigned char *ip = (const unsigned char *)src;
+    const unsigned char *iend = ip + srclen;
+    unsigned char *op = (unsigned char *)dst;
+    unsigned char *obase = op;
+    unsigned char *oend = op + dstlen;
+
+    for (;;)
+    {
+        /* read the token */
+        if (ip >= iend)
+            return 1;
+        unsigned char tok = *ip++;
+
+        /* read the literal length and copy the literals */
+        size_t litlen = tok >> 4;
+        if (litlen == 15 && lz_get_len(&ip, iend, &litlen))
+            return 1;
+        if ((size_t)(iend - ip) < litlen || (size_t)(oend - op) < litlen)
+            return 1;
+        memcpy(op, ip, litlen);
+        ip += litlen;
+        op += litlen;
+
+        /* the final sequence ends exactly at the end of the input */
+        if (ip == iend)
+            break;
+
+        /* read the match offset */
+        if (iend - ip < 2)
+            return 1;
+        size_t offset = ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - obase))
+            return 1;
+
+        /* read the match length */
+        size_t mlen = tok & 0x0F;
+        if (mlen == 15 && lz_get_len(&ip, iend, &mlen))
+            return 1;
+        mlen += LZ_MIN_MATCH;
+        if ((size_t)(oend - op) < mlen)
+            return 1;
+
+        /* 
+         *   copy the match; go byte by byte, since the source can overlap
+         *   the destination when the offset is less than the length 
+         */
+        const unsigned char *ref = op - offset;
+        if (offset >= mlen)
+        {
+            memcpy(op, ref, mlen);
+            op += mlen;
+        }
+        else
+        {
+            while (mlen-- != 0)
+                *op++ = *ref++;
+        }
+    }
+
+    /* make sure we produced exactly the expected amount of data */
+    return op != oend;
+}
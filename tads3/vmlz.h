@@ -0,0 +1,57 @@
+/*
+ *   Please see the accompanying license file, LICENSE.TXT, for information
+ *   on using and copying this software.
+ */
+/*
+Name
+  vmlz.h - fast LZ77 block compression
+Function
+  Compresses and decompresses memory blocks using the LZ4 block format.
+  This is a byte-oriented LZ77 scheme that trades some compression ratio
+  for speed: the compressor makes a single pass with a small hash table,
+  and the decompressor is little more than a series of memory copies.
+  That suits saved game files, which are highly repetitive (the same
+  object IDs, property IDs and type tags occur over and over) and are
+  written at times when the player is waiting.
+Notes
+  The block format is the standard LZ4 one: a series of sequences, each
+  with a token byte giving the literal run length in the high nibble and
+  the match length minus 4 in the low nibble, followed by any extended
+  literal length bytes, the literals, a two-byte little-endian match
+  offset, and any extended match length bytes.  The final sequence has
+  only literals.
+Modified
+  10/14/26  - Creation
+*/
+
+#ifndef VMLZ_H
+#define VMLZ_H
+
+#include <stdlib.h>
+
+
+/*
+ *   Get the worst-case compressed size for a block of 'len' bytes.  A
+ *   buffer of this size is always big enough for lz_compress().
+ */
+inline size_t lz_compress_bound(size_t len)
+{
+    return len + len/255 + 16;
+}
+
+/*
+ *   Compress 'srclen' bytes from 'src' into 'dst', which has room for
+ *   'dstlen' bytes.  Returns the compressed size, or zero if the result
+ *   doesn't fit.
+ */
+size_t lz_compress(const char *src, size_t srclen, char *dst, size_t dstlen);
+
+/*
+ *   Decompress a block.  'dstlen' is the exact expected decompressed size.
+ *   Returns zero on success, non-zero if the compressed data are malformed
+ *   or don't decompress to exactly 'dstlen' bytes.  We never read or write
+ *   outside of the given buffers, even for corrupted input.
+ */
+int lz_decompress(const char *src, size_t srclen, char *dst, size_t dstlen);
+
+#endif /* VMLZ_H */
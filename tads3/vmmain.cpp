@@ -39,6 +39,7 @@ Modified
 #include "vminit.h"
 #include "vmpredef.h"
 #include "vmobj.h"
+#include "vmconsol.h"
 #include "vmvsn.h"
 #include "charmap.h"
 #include "vmsave.h"
@@ -47,8 +48,13 @@ Modified
 #include "vmmcreg.h"
 #include "vmbifreg.h"
 #include "vmbiftad.h"
+#include "vmregex.h"
 #include "sha2.h"
 #include "vmnet.h"
+#include "vmsample.h"
+#include "vmreplay.h"
+#include "vmalloctr.h"
+#include "vmundo.h"
 
 
 /* ------------------------------------------------------------------------ */
@@ -81,6 +87,65 @@ static char *file_param_to_abs_path(const char *param)
 }
 
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Idle-time garbage collection.  We keep track of the globals for the
+ *   program that's currently running, so that the host can reach the
+ *   garbage collector from its input loop.  The host's input loop runs on
+ *   the same thread as the program, so when several programs are running
+ *   on separate threads, each thread has its own.  
+ */
+static T3_DECL_PER_THREAD(int, S_idle_gc_ok) = FALSE;
+static T3_DECL_PER_THREAD(vm_globals *, S_idle_gc_vmg) = 0;
+
+int vm_idle_gc_step()
+{
+    /* if there's no program running, there's nothing to do */
+    if (!S_idle_gc_ok)
+        return FALSE;
+
+    /* do the next increment of work */
+    VMGLOB_PTR(S_idle_gc_vmg);
+    return G_obj_table->gc_bg_step(vmg0_);
+}
+
+void vm_idle_gc_finish()
+{
+    /* if there's a program running, finish its collection pass */
+    if (S_idle_gc_ok)
+    {
+        VMGLOB_PTR(S_idle_gc_vmg);
+        G_obj_table->gc_bg_finish(vmg0_);
+    }
+}
+
+void vm_autosave()
+{
+    /* if there's no program running, there's nothing to save */
+    if (!S_idle_gc_ok)
+        return;
+
+    /* 
+     *   save only if the program is waiting at its command prompt, and
+     *   only once per prompt 
+     */
+    VMGLOB_PTR(S_idle_gc_vmg);
+    if (G_console->take_autosave_request())
+        CVmSaveFile::autosave(vmg0_);
+}
+
+int vm_get_gc_stats(vm_gc_stats *stats)
+{
+    /* if there's no program running, there are no statistics */
+    if (!S_idle_gc_ok)
+        return FALSE;
+
+    /* get the statistics */
+    VMGLOB_PTR(S_idle_gc_vmg);
+    G_obj_table->get_gc_stats(vmg_ stats);
+    return TRUE;
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Execute an image file.  If an exception occurs, we'll display a
@@ -94,6 +159,8 @@ int vm_run_image(const vm_run_image_params *params)
     CVmImageLoader *volatile loader = 0;
     CVmImageFile *volatile imagefp = 0;
     unsigned long image_file_base = 0;
+    const char *volatile image_map = 0;
+    unsigned long image_map_len = 0;
     int retval;
     vm_globals *vmg__;
 
@@ -118,6 +185,27 @@ int vm_run_image(const vm_run_image_params *params)
                          params->charset, params->log_charset);
     vm_initialize(&vmg__, &opts);
 
+    /* set the garbage collector's pause target and compaction option */
+    G_obj_table->set_gc_pause_budget(params->gc_pause_ms);
+    G_obj_table->set_gc_compact(params->gc_compact);
+
+    /* set the image object loading mode */
+    G_obj_table->set_lazy_load(params->lazy_load);
+
+    /* set the compiled regular expression cache size, if specified */
+    if (params->rex_cache_size >= 0)
+        G_bif_tads_globals->rex_cache->set_max_cnt(params->rex_cache_size);
+
+    /* set the undo memory budget, if specified */
+    if (params->undo_budget > 0)
+        G_undo->set_mem_budget(vmg_ (size_t)params->undo_budget);
+
+    /* set the saved state compression mode */
+    G_save_compress = params->save_compress;
+
+    /* open the garbage collection log, if one was requested */
+    G_obj_table->open_gc_log(getenv("T3_GC_LOG"));
+
     /* catch any errors that occur during loading and running */
     err_try
     {
@@ -165,6 +253,17 @@ int vm_run_image(const vm_run_image_params *params)
             image_file_base = osfpos(exe_fp);
             fp->set_file(exe_fp, image_file_base);
         }
+        else if (params->map_image
+                 && (image_map = params->hostifc->map_file(
+                     G_os_gamename, &image_map_len)) != 0)
+        {
+            /* 
+             *   we've mapped the file into memory - read it directly from
+             *   the mapping 
+             */
+            imagefp = new CVmImageFileMem(image_map, image_map_len,
+                                           params->hostifc);
+        }
         else
         {
             /* reading from a normal file - open the file */
@@ -172,7 +271,8 @@ int vm_run_image(const vm_run_image_params *params)
         }
 
         /* create the loader */
-        imagefp = new CVmImageFileExt(fp);
+        if (imagefp == 0)
+            imagefp = new CVmImageFileExt(fp);
         loader = new CVmImageLoader(imagefp, G_os_gamename, image_file_base);
 
         /* load the image */
@@ -201,6 +301,19 @@ int vm_run_image(const vm_run_image_params *params)
         }
 #endif /* TADSNET */
 
+        /* start the sampling profiler, if it's requested */
+        VM_IF_SAMPLER(vm_sampler_start_from_env(vmg0_));
+
+        /* start collecting command replay statistics, if requested */
+        vm_replay_stats_start_from_env(vmg0_);
+
+        /* start the allocation trace, if it's requested */
+        VM_IF_ALLOC_TRACE(vm_alloc_trace_start_from_env(vmg0_));
+
+        /* the host can now do idle-time garbage collection */
+        S_idle_gc_vmg = VMGLOB_ADDR;
+        S_idle_gc_ok = TRUE;
+
         /* run the program from the main entrypoint */
         loader->run(vmg_ params->prog_argv, params->prog_argc,
                     0, 0, params->saved_state);
@@ -233,6 +346,24 @@ int vm_run_image(const vm_run_image_params *params)
     }
     err_end;
 
+    /* execution is over, so idle-time garbage collection is no longer safe */
+    S_idle_gc_ok = FALSE;
+
+    /* 
+     *   stop the sampling profiler and write its results (do this before
+     *   unloading the image, since we need its symbols) 
+     */
+    VM_IF_SAMPLER(vm_sampler_stop(vmg0_));
+
+    /* stop the allocation trace and write its report (this needs symbols) */
+    VM_IF_ALLOC_TRACE(vm_alloc_trace_stop(vmg0_));
+
+    /* 
+     *   if the program ended in the middle of a replay, write the replay
+     *   statistics now 
+     */
+    vm_replay_stats_stop(vmg0_);
+
     /* done with the file base path and sandbox path */
     lib_free_str(G_file_path);
     lib_free_str(G_sandbox_path);
@@ -267,6 +398,13 @@ int vm_run_image(const vm_run_image_params *params)
     if (fp != 0)
         delete fp;
 
+    /* 
+     *   release the image file mapping, if we used one; we do this last,
+     *   since objects loaded from the image point directly into it 
+     */
+    if (image_map != 0)
+        params->hostifc->unmap_file(image_map);
+
     /* return the status code */
     return retval;
 }
@@ -539,6 +677,19 @@ int vm_run_image_main(CVmMainClientIfc *clientifc,
             }
             break;
 
+        case 'g':
+            if (strcmp(argv[curarg], "-gcpause") == 0)
+            {
+                /* set the garbage collector pause target */
+                if (++curarg < argc && isdigit(argv[curarg][0]))
+                    params.gc_pause_ms = atol(argv[curarg]);
+                else
+                    goto opt_error;
+            }
+            else
+                goto opt_error;
+            break;
+
         case 'i':
         case 'I':
             /* 
@@ -795,6 +946,8 @@ int vm_run_image_main(CVmMainClientIfc *clientifc,
                     "and display\n"
                     "  -csl xxx - use character set 'xxx' for log files\n"
                     "  -d path - set default directory for file operations\n"
+                    "  -gcpause ms - set the target garbage collection "
+                    "pause time\n"
                     "  -i file - read command input from file (quiet mode)\n"
                     "  -I file - read command input from file (echo mode)\n"
                     "  -l file - log all console input/output to file\n"
@@ -1103,6 +1256,12 @@ int vm_get_game_arg(int argc, const char *const *argv,
             }
             break;
 
+        case 'g':
+            /* tads 3 -gcpause <ms> - skip the <ms> parameter */
+            if (strcmp(argv[i], "-gcpause") == 0)
+                ++i;
+            break;
+
         case 'u':
             /* 
              *   tads 2 "-uSize" - argument required, so consume the next
@@ -158,6 +158,27 @@ struct vm_run_image_params
 
         /* assume no network configuration */
         netconfig = 0;
+
+        /* use the default garbage collector pause target */
+        gc_pause_ms = 0;
+
+        /* compact the variable heap after background collections */
+        gc_compact = TRUE;
+
+        /* create all image file objects at load time */
+        lazy_load = FALSE;
+
+        /* use the default regular expression cache size */
+        rex_cache_size = -1;
+
+        /* use the default undo memory budget */
+        undo_budget = 0;
+
+        /* write uncompressed saved state files by default */
+        save_compress = FALSE;
+
+        /* read the image file normally by default */
+        map_image = FALSE;
     }
     
     /* 
@@ -278,6 +299,60 @@ struct vm_run_image_params
      *   host mode, with the network parameters specified in this object.
      */
     class TadsNetConfig *netconfig;
+
+    /*
+     *   Target pause time for a garbage collection pass, in milliseconds.
+     *   The collector sizes the amount of allocation it allows between
+     *   passes to try to stay within this time.  Zero selects the default.
+     */
+    long gc_pause_ms;
+
+    /*
+     *   Compact the variable-size heap after garbage collection passes
+     *   that run while the VM is waiting for input.  This returns memory
+     *   from sparsely used heap pages to the system.
+     */
+    int gc_compact;
+
+    /*
+     *   Load image file objects lazily.  When this is set, objects whose
+     *   metaclass allows it aren't created when the image is loaded, but
+     *   the first time they're used.  This speeds up starting a large
+     *   game, and saves the memory for objects the game never touches.  
+     */
+    int lazy_load;
+
+    /*
+     *   Number of compiled regular expressions to cache for expressions
+     *   that the program passes to the regex functions as strings.  Zero
+     *   disables the cache; a negative value selects the default.  
+     */
+    int rex_cache_size;
+
+    /*
+     *   Memory budget for the undo log, in bytes.  When the log fills up,
+     *   the oldest savepoints (turns) are discarded to make room, so this
+     *   determines how many turns of undo are available.  Zero selects the
+     *   default.  
+     */
+    long undo_budget;
+
+    /*
+     *   Compress saved state files.  Compressed files are considerably
+     *   smaller, which speeds up saving and restoring on slow storage.
+     *   Both kinds of file can always be restored.  
+     */
+    int save_compress;
+
+    /*
+     *   Map the image file into memory rather than reading it, if the host
+     *   interface supports it (see CVmHostIfc::map_file()).  The loader
+     *   then refers to the object, symbol and other data blocks directly
+     *   in the mapping instead of copying each one into the heap, which
+     *   saves both memory and load time for large games.  This doesn't
+     *   apply when loading an image embedded in the executable.  
+     */
+    int map_image;
 };
 
 /*
@@ -301,6 +376,45 @@ struct vm_run_image_params
  */
 int vm_run_image(const vm_run_image_params *params);
 
+/*
+ *   Idle-time garbage collection.  A host application can call
+ *   vm_idle_gc_step() repeatedly while the VM is blocked waiting for user
+ *   input, to get garbage collection work done while the user is typing
+ *   rather than in the middle of the next command.  Each call does a small
+ *   slice of work and returns true if there's more to do.  These do nothing
+ *   if no program is currently executing in vm_run_image().
+ *   
+ *   If vm_idle_gc_step() has been called during the wait, the host MUST
+ *   call vm_idle_gc_finish() before returning control to the VM, to
+ *   complete the collection pass in progress (see
+ *   CVmObjTable::gc_bg_step()).  
+ */
+int vm_idle_gc_step();
+void vm_idle_gc_finish();
+
+/*
+ *   Autosave.  If the host application has asked for autosaves (see
+ *   CVmHostIfc::get_autosave_file()), it calls this while the VM is blocked
+ *   waiting for a line of input, once vm_idle_gc_step() has returned false
+ *   to indicate that the idle collection pass is done.  The save reuses
+ *   that pass rather than running a full collection of its own.  This only
+ *   saves if the program is reading a command at its command prompt, and
+ *   only once per prompt; input read in the course of a command is
+ *   skipped, since the program's state is in mid-change at that point (see
+ *   CVmConsole::take_autosave_request()).  It does nothing if no program
+ *   is executing.  
+ */
+void vm_autosave();
+
+/*
+ *   Get the garbage collector statistics (see CVmObjTable::get_gc_stats())
+ *   for the program currently executing in vm_run_image(), for a host
+ *   application that wants to display them.  Like the idle-time GC
+ *   functions, this can only be called while the VM is blocked waiting for
+ *   user input.  Returns false if no program is executing.  
+ */
+int vm_get_gc_stats(struct vm_gc_stats *stats);
+
 
 /*
  *   Execute an image file using argc/argv conventions.  We'll parse the
@@ -428,6 +428,17 @@ void CVmMetaTable::create_from_image(VMG_ uint idx, vm_obj_id_t id,
     if (idx >= count_)
         err_throw(VMERR_BAD_METACLASS_INDEX);
 
+    /* 
+     *   if we're loading lazily, and the metaclass allows it, just note
+     *   where the object's data are, and create it when it's first used 
+     */
+    if (G_obj_table->is_lazy_load() && table_[idx].meta_->can_load_lazily())
+    {
+        G_obj_table->alloc_lazy_obj_with_id(
+            id, table_[idx].meta_->get_reg_idx(), ptr, siz);
+        return;
+    }
+
     /* create the object table entry in the memory manager */
     G_obj_table->alloc_obj_with_id(id, TRUE);
 
@@ -24,6 +24,7 @@ Modified
 #include <memory.h>
 #include <assert.h>
 
+#include "os.h"
 #include "t3std.h"
 #include "vmtype.h"
 #include "vmobj.h"
@@ -32,6 +33,7 @@ Modified
 #include "vmrun.h"
 #include "vmfile.h"
 #include "vmmeta.h"
+#include "vmmcreg.h"
 #include "vmlst.h"
 #include "vmstr.h"
 #include "vmintcls.h"
@@ -42,6 +44,7 @@ Modified
 #include "vmtobj.h"
 #include "vmanonfn.h"
 #include "vmdynfunc.h"
+#include "vmtrace.h"
 
 
 
@@ -61,6 +64,8 @@ struct
         cur_freed = 0;
         max_freed = 0;
         t = 0;
+        sweep_t = 0;
+        sweep_visits = 0;
     }
 
     void begin_pass()
@@ -87,6 +92,21 @@ struct
         ++tot_freed;
     }
 
+    void begin_sweep()
+    {
+        sweep_t0 = os_get_sys_clock_ms();
+    }
+
+    void end_sweep()
+    {
+        sweep_t += os_get_sys_clock_ms() - sweep_t0;
+    }
+
+    void count_sweep_visit()
+    {
+        ++sweep_visits;
+    }
+
     void count_alloc_bytes(size_t siz)
     {
         cur_bytes += siz;
@@ -115,7 +135,9 @@ struct
                "  peak heap bytes:       %ld\n"
                "  peak garbage bytes:    %ld\n"
                "  total gc time (ms):    %ld\n"
-               "  average gc time (ms):  %ld\n",
+               "  average gc time (ms):  %ld\n"
+               "  total sweep time (ms): %ld\n"
+               "  entries swept:         %ld\n",
                runs,
                tot_freed,
                runs != 0 ? tot_freed/runs : 0,
@@ -123,7 +145,9 @@ struct
                max_bytes,
                max_garbage_bytes,
                t,
-               runs != 0 ? t/runs : 0);
+               runs != 0 ? t/runs : 0,
+               sweep_t,
+               sweep_visits);
     }
 
     /* number of times the gc has run */
@@ -156,6 +180,14 @@ struct
     /* starting time in ticks of current run */
     long t0;
 
+    /* 
+     *   time spent in the sweep phase, the starting time of the current
+     *   sweep, and the number of table entries the sweep examined 
+     */
+    long sweep_t;
+    long sweep_t0;
+    long sweep_visits;
+
 } gc_stats;
 
 #else /* VMOBJ_GC_STATS */
@@ -215,6 +247,14 @@ void *CVmObject::operator new(size_t siz, VMG_ vm_obj_id_t obj_id)
     return G_obj_table->get_obj(obj_id);
 }
 
+/*
+ *   Get the size of our extension's block in the variable heap 
+ */
+size_t CVmObject::get_ext_heap_bytes(VMG0_) const
+{
+    return (ext_ != 0 ? G_mem->get_var_heap()->get_block_size(ext_) : 0);
+}
+
 /*
  *   Determine if this object is an instance of the given object.  By
  *   default, we will simply check to see if the given object is the
@@ -1399,9 +1439,13 @@ public:
 CVmObjTable::CVmObjTable()
 {
     pages_ = 0;
+    page_bits_ = 0;
     page_slots_ = 0;
     pages_used_ = 0;
     image_ptr_head_ = 0;
+    gc_log_ = 0;
+    gc_pass_start_bytes_ = 0;
+    memset(&gc_totals_, 0, sizeof(gc_totals_));
     globals_ = 0;
     global_var_head_ = 0;
     post_load_init_table_ = 0;
@@ -1415,9 +1459,11 @@ void CVmObjTable::init(VMG0_)
     /* allocate the initial set of page slots */
     page_slots_ = 10;
     pages_ = (CVmObjPageEntry **)t3malloc(page_slots_ * sizeof(*pages_));
+    page_bits_ = (CVmObjPageBits **)
+                 t3malloc(page_slots_ * sizeof(*page_bits_));
 
     /* if that failed, throw an error */
-    if (pages_ == 0)
+    if (pages_ == 0 || page_bits_ == 0)
         err_throw(VMERR_OUT_OF_MEMORY);
 
     /* no pages are in use yet */
@@ -1428,6 +1474,7 @@ void CVmObjTable::init(VMG0_)
 
     /* there's nothing in the GC work queue yet */
     gc_queue_head_ = VM_INVALID_OBJ;
+    gc_trace_nonroot_ = FALSE;
 
     /* nothing in the finalizer work queue yet */
     finalize_queue_head_ = VM_INVALID_OBJ;
@@ -1487,14 +1534,38 @@ void CVmObjTable::init(VMG0_)
      *   large working sets can hurt performance by reducing locality of
      *   reference (for CPU caching) and even triggering OS-level disk
      *   swapping.
+     *   
+     *   These are only the starting values.  No fixed setting is right
+     *   for every program, since a game with a large static object set
+     *   pays to rescan its live objects on every pass, while a small game
+     *   on a constrained device wants a small working set.  So, after each
+     *   pass, gc_adapt_thresholds() resizes the limits from the surviving
+     *   heap and the measured pause time.  
      */
 //    max_allocs_between_gc_ = 17500;
     max_allocs_between_gc_ = 10000;
     max_bytes_between_gc_ = 6*1024*1024;
+    gc_pause_budget_ms_ = VM_GC_DEFAULT_PAUSE_MS;
+    gc_pass_start_ms_ = 0;
+
+    /* there's no background pass in progress */
+    gc_bg_state_ = VMOBJ_GC_BG_IDLE;
+    gc_bg_work_ms_ = 0;
 
     /* enable the garbage collector */
     gc_enabled_ = TRUE;
 
+    /* compact the variable heap after background passes */
+    gc_compact_ = TRUE;
+
+    /* 
+     *   create all image objects at load time unless told otherwise, and
+     *   note that we haven't done any post-load initialization yet 
+     */
+    lazy_load_ = FALSE;
+    post_load_started_ = FALSE;
+    lazy_vmg_ = VMGLOB_ADDR;
+
     /* there are no saved image data pointers yet */
     image_ptr_head_ = 0;
     image_ptr_tail_ = 0;
@@ -1520,6 +1591,7 @@ void CVmObjTable::init(VMG0_)
     new (vmg_ VM_INVALID_OBJ) CVmObjNil;
     CVmObjPageEntry *obj0 = get_entry(0);
     obj0->free_ = TRUE;
+    clear_page_bits(0);
     obj0->in_root_set_ = TRUE;
     obj0->reachable_ = VMOBJ_REACHABLE;
     obj0->finalize_state_ = VMOBJ_UNFINALIZABLE;
@@ -1548,6 +1620,13 @@ void CVmObjTable::clear_obj_table(VMG0_)
     /* delete all entries in the post-load initialization table */
     post_load_init_table_->delete_all_entries();
 
+    /* 
+     *   if we're keeping a garbage collection log, finish it with a census
+     *   of what's left in the heap at exit 
+     */
+    if (gc_log_ != 0)
+        log_heap_census(vmg0_);
+
     /* go through the pages and delete the entries */
     for (size_t i = 0 ; i < pages_used_ ; ++i)
     {
@@ -1556,8 +1635,11 @@ void CVmObjTable::clear_obj_table(VMG0_)
         CVmObjPageEntry *entry;
         for (j = 0, entry = pages_[i] ; j < VM_OBJ_PAGE_CNT ; ++j, ++entry)
         {
-            /* if this entry is still in use, delete it */
-            if (!entry->free_)
+            /* 
+             *   if this entry is still in use, delete it (a lazy image
+             *   object was never created, so there's nothing to delete) 
+             */
+            if (!entry->free_ && !entry->lazy_)
                 entry->get_vm_obj()->notify_delete(vmg_ entry->in_root_set_);
         }
     }
@@ -1570,15 +1652,27 @@ void CVmObjTable::clear_obj_table(VMG0_)
  */
 void CVmObjTable::delete_obj_table(VMG0_)
 {
-    /* delete each page we've allocated */
+    /* delete each page we've allocated, along with its summary */
     for (size_t i = 0 ; i < pages_used_ ; ++i)
+    {
         t3free(pages_[i]);
+        t3free(page_bits_[i]);
+    }
 
-    /* free the master page table */
+    /* free the master page table and the summary table */
     t3free(pages_);
+    t3free(page_bits_);
 
     /* we no longer have any pages */
     pages_ = 0;
+    page_bits_ = 0;
+
+    /* close the garbage collection log, if we have one */
+    if (gc_log_ != 0)
+    {
+        delete gc_log_;
+        gc_log_ = 0;
+    }
     page_slots_ = 0;
     pages_used_ = 0;
 
@@ -1586,6 +1680,7 @@ void CVmObjTable::delete_obj_table(VMG0_)
     first_free_ = VM_INVALID_OBJ;
     gc_queue_head_ = VM_INVALID_OBJ;
     finalize_queue_head_ = VM_INVALID_OBJ;
+    gc_bg_state_ = VMOBJ_GC_BG_IDLE;
 
     /* clear the gc statistics */
     allocs_since_gc_ = 0;
@@ -1676,6 +1771,9 @@ vm_obj_id_t CVmObjTable::alloc_obj(VMG_ int in_root_set,
     init_entry_for_alloc(ret, entry, in_root_set,
                          can_have_refs, can_have_weak_refs);
 
+    /* trace the allocation if desired */
+    VM_IF_ALLOC_TRACE(vm_alloc_trace_obj(ret));
+
     /* return the free object */
     return ret;
 }
@@ -1685,6 +1783,16 @@ vm_obj_id_t CVmObjTable::alloc_obj(VMG_ int in_root_set,
  */
 void CVmObjTable::gc_before_alloc(VMG0_)
 {
+    /* 
+     *   if a background pass is in progress, finish it instead - that
+     *   collects everything a new pass would 
+     */
+    if (gc_bg_state_ != VMOBJ_GC_BG_IDLE)
+    {
+        gc_bg_finish(vmg0_);
+        return;
+    }
+
     /* count it if in statistics mode */
     IF_GC_STATS(gc_stats.begin_pass());
 
@@ -1733,6 +1841,72 @@ void CVmObjTable::alloc_obj_with_id(vm_obj_id_t id, int in_root_set,
                          can_have_refs, can_have_weak_refs);
 }
 
+/*
+ *   Allocate a lazily loaded image object 
+ */
+void CVmObjTable::alloc_lazy_obj_with_id(vm_obj_id_t id, uint meta_reg_idx,
+                                         const char *ptr, size_t siz)
+{
+    /* 
+     *   Allocate the entry in the root set.  Mark it as unable to have
+     *   references of any kind: there's no object yet to trace, and this
+     *   keeps the entry out of the GC work queue, which leaves next_obj_
+     *   free for us to use to hold the metaclass index. 
+     */
+    alloc_obj_with_id(id, TRUE, FALSE, FALSE);
+
+    /* remember where to find the object when we need it */
+    CVmObjPageEntry *entry = get_entry(id);
+    entry->lazy_ = TRUE;
+    entry->ptr_.image_.ptr_ = ptr;
+    entry->ptr_.image_.siz_ = siz;
+    entry->next_obj_ = (vm_obj_id_t)meta_reg_idx;
+}
+
+/*
+ *   Create a lazily loaded image object on its first use 
+ */
+CVmObject *CVmObjTable::create_lazy_obj(vm_obj_id_t id,
+                                        CVmObjPageEntry *entry)
+{
+    VMGLOB_PTR(lazy_vmg_);
+
+    /* retrieve the image data location and metaclass */
+    const char *ptr = entry->ptr_.image_.ptr_;
+    size_t siz = entry->ptr_.image_.siz_;
+    CVmMetaclass *meta = *G_meta_reg_table[entry->next_obj_].meta;
+
+    /* 
+     *   The entry is now a normal object.  Restore the conservative GC
+     *   characteristics (the metaclass constructor can narrow them), and
+     *   put the object in the GC work queue, as we do for any root-set
+     *   object, so that it's traced in the next pass.  This is safe even
+     *   if we're called from the finalizer scan in the middle of a sweep,
+     *   since the sweep re-queues all of the root set after that scan.  
+     */
+    entry->lazy_ = FALSE;
+    entry->can_have_refs_ = TRUE;
+    entry->can_have_weak_refs_ = TRUE;
+    entry->reachable_ = VMOBJ_UNREACHABLE;
+    add_to_gc_queue(id, entry, VMOBJ_REACHABLE);
+
+    /* create the object and load it from its image data */
+    meta->create_for_image_load(vmg_ id);
+    CVmObject *obj = entry->get_vm_obj();
+    obj->load_from_image(vmg_ id, ptr, siz);
+
+    /* 
+     *   If the program has already been through post-load initialization,
+     *   we've missed that, so initialize the object now.  (Before then,
+     *   the object's request will be handled along with everyone else's.) 
+     */
+    if (post_load_started_)
+        ensure_post_load_init(vmg_ id);
+
+    /* return the new object */
+    return obj;
+}
+
 /*
  *   Initialize an object table entry that we've just allocated 
  */
@@ -1744,6 +1918,7 @@ void CVmObjTable::init_entry_for_alloc(vm_obj_id_t id,
 {
     /* mark the entry as in use */
     entry->free_ = FALSE;
+    set_page_bits(id, in_root_set);
 
     /* no undo savepoint has been created since the object was created */
     entry->in_undo_ = FALSE;
@@ -1761,6 +1936,12 @@ void CVmObjTable::init_entry_for_alloc(vm_obj_id_t id,
     entry->can_have_refs_ = can_have_refs;
     entry->can_have_weak_refs_ = can_have_weak_refs;
 
+    /* it hasn't been traced yet, so it's not known to be clean */
+    entry->gc_clean_ = FALSE;
+
+    /* it's a real object, not a lazy image object */
+    entry->lazy_ = FALSE;
+
     /* 
      *   Mark the object as initially unreachable and unfinalizable.  It's
      *   not necessarily really unreachable at this point, but we mark it
@@ -1807,6 +1988,7 @@ void CVmObjTable::delete_entry(VMG_ vm_obj_id_t id, CVmObjPageEntry *entry)
 {
     /* mark the object table entry as free */
     entry->free_ = TRUE;
+    clear_page_bits(id);
 
     /* it's not in the root set if it's free */
     entry->in_root_set_ = FALSE;
@@ -1858,16 +2040,23 @@ void CVmObjTable::alloc_new_page()
         /* allocate space for the increased number of slots */
         pages_ = (CVmObjPageEntry **)t3realloc(
             pages_, page_slots_ * sizeof(*pages_));
+        page_bits_ = (CVmObjPageBits **)t3realloc(
+            page_bits_, page_slots_ * sizeof(*page_bits_));
     }
     
-    /* allocate a new page */
+    /* allocate a new page and its summary */
     pages_[pages_used_] =
         (CVmObjPageEntry *)t3malloc(VM_OBJ_PAGE_CNT * sizeof(*pages_[0]));
+    page_bits_[pages_used_] =
+        (CVmObjPageBits *)t3malloc(sizeof(*page_bits_[0]));
 
     /* if that failed, throw an error */
-    if (pages_[pages_used_] == 0)
+    if (pages_[pages_used_] == 0 || page_bits_[pages_used_] == 0)
         err_throw(VMERR_OUT_OF_MEMORY);
 
+    /* every entry on the new page is free */
+    memset(page_bits_[pages_used_], 0, sizeof(*page_bits_[0]));
+
     /* 
      *   initialize the new page to be entirely free - add each element of
      *   the page to the free list 
@@ -1887,6 +2076,7 @@ void CVmObjTable::alloc_new_page()
 
         /* ...and it's certainly not a collectable object */
         entry->in_root_set_ = TRUE;
+        entry->gc_clean_ = FALSE;
 
         /* skip it for the impending free list construction */
         ++i;
@@ -1915,6 +2105,7 @@ void CVmObjTable::alloc_new_page()
 
         /* presume it's not part of the root set */
         entry->in_root_set_ = FALSE;
+        entry->gc_clean_ = FALSE;
 
         /* 
          *   mark it initially unreachable and finalized, since it's not
@@ -1974,6 +2165,11 @@ void CVmObjTable::add_to_globals(vm_obj_id_t obj)
  */
 void CVmObjTable::gc_full(VMG0_)
 {
+    CVmTraceSpan trace("gc", "gc pass");
+
+    /* finish any background pass before starting a new one */
+    gc_bg_finish(vmg0_);
+
     /* count it if in statistics mode */
     IF_GC_STATS(gc_stats.begin_pass());
 
@@ -2008,6 +2204,12 @@ void CVmObjTable::gc_pass_init(VMG0_)
     allocs_since_gc_ = 0;
     bytes_since_gc_ = 0;
 
+    /* note the starting time, for adapting the next pass's threshold */
+    gc_pass_start_ms_ = os_get_sys_clock_ms();
+
+    /* note the heap size, so that we can tell how much the pass frees */
+    gc_pass_start_bytes_ = G_mem->get_var_heap()->get_bytes_in_use();
+
     /* trace objects reachable from the stack */
     gc_trace_stack(vmg0_);
 
@@ -2068,16 +2270,45 @@ int CVmObjTable::gc_pass_continue(VMG_ int trace_transient)
         /* remove this entry from the work queue */
         gc_queue_head_ = entry->next_obj_;
 
+        /* 
+         *   start loading the next entry in the queue, so that the fetch
+         *   overlaps with tracing this one 
+         */
+        if (gc_queue_head_ != VM_INVALID_OBJ)
+            VMOBJ_PREFETCH(get_entry(gc_queue_head_));
+
         /* 
          *   Tell this object to mark its references.  Mark the referenced
          *   objects with the same state as this object, if they're not
          *   already marked with a stronger state.
          *   
          *   If we're not tracing transients, do not trace this object if
-         *   it's transient.  
+         *   it's transient.
+         *   
+         *   If the object is marked as clean, it's a root-set object that
+         *   references only other root-set objects.  Those are all marked
+         *   as reachable at the start of every pass, so tracing it again
+         *   can't find anything new, and we can skip it.  This matters
+         *   because the root set - everything loaded from the image - is
+         *   typically most of the object table, and is fully traced on
+         *   every pass otherwise.  
          */
-        if (trace_transient || !entry->transient_)
-            entry->get_vm_obj()->mark_refs(vmg_ entry->reachable_);
+        if ((trace_transient || !entry->transient_) && !entry->gc_clean_)
+        {
+            /* trace the object, noting if it refers outside the root set */
+            gc_trace_nonroot_ = FALSE;
+            CVmObject *obj = entry->get_vm_obj();
+            obj->mark_refs(vmg_ entry->reachable_);
+
+            /* 
+             *   if it's a root-set object that only refers to other
+             *   root-set objects, and its metaclass will tell us when that
+             *   changes, we don't need to trace it again until it does 
+             */
+            if (entry->in_root_set_ && !gc_trace_nonroot_
+                && obj->has_gc_write_barrier())
+                entry->gc_clean_ = TRUE;
+        }
     }
 
     /* 
@@ -2093,12 +2324,30 @@ int CVmObjTable::gc_pass_continue(VMG_ int trace_transient)
  *   after any number of calls (even zero) to gc_pass_continue().  
  */
 void CVmObjTable::gc_pass_finish(VMG0_)
+{
+    /* finish tracing and delete the garbage */
+    gc_pass_sweep(vmg0_);
+
+    /*
+     *   All of the finalizable objects are now in the finalizer queue.  Run
+     *   through the finalizer queue and run each such object's finalizer. 
+     */
+    run_finalizers(vmg0_);
+}
+
+/*
+ *   Finish a garbage collection pass, up to the point of running
+ *   finalizers. 
+ */
+void CVmObjTable::gc_pass_sweep(VMG0_)
 {
     CVmObjPageEntry **pg;
     CVmObjPageEntry *entry;
     size_t i;
     size_t j;
     vm_obj_id_t id;
+    ulong survivors = 0;
+    ulong freed = 0;
 
     /* 
      *   Make sure we're done processing the work queue -- keep calling
@@ -2108,6 +2357,9 @@ void CVmObjTable::gc_pass_finish(VMG0_)
      */
     gc_trace_work_queue(vmg_ TRUE);
 
+    /* time the sweep in statistics mode */
+    IF_GC_STATS(gc_stats.begin_sweep());
+
     /*
      *   We've now marked everything that's reachable from the root set as
      *   VMOBJ_REACHABLE.  We can therefore determine the set of objects
@@ -2117,16 +2369,32 @@ void CVmObjTable::gc_pass_finish(VMG0_)
      *   So, scan all objects for eligibility for the 'finalizable'
      *   transition, and make the transition in those objects.  
      */
-    for (id = 0, i = pages_used_, pg = pages_ ; i > 0 ; ++pg, --i)
+    for (id = 0, i = 0, pg = pages_ ; i < pages_used_ ; ++pg, ++i)
     {
+        CVmObjPageBits *bits = page_bits_[i];
+
         /* go through each entry on this page */
-        for (j = VM_OBJ_PAGE_CNT, entry = *pg ; j > 0 ; --j, ++entry, ++id)
+        for (j = 0, entry = *pg ; j < VM_OBJ_PAGE_CNT ; ++j, ++entry, ++id)
         {
             /* 
-             *   if this entry is not free and is not in the root set, check
-             *   to see if its finalization status is changing 
+             *   if the page summary shows that none of the next 32 entries
+             *   is a candidate, skip them all without touching them 
+             */
+            if ((j & 31) == 0 && bits->nonroot_[j >> 5] == 0)
+            {
+                j += 31;
+                entry += 31;
+                id += 31;
+                continue;
+            }
+
+            /* 
+             *   if this entry is not free and is not in the root set (as
+             *   the page summary tells us without our having to read the
+             *   entry), check to see if its finalization status is changing 
              */
-            if (!entry->free_ && !entry->in_root_set_)
+            IF_GC_STATS(gc_stats.count_sweep_visit());
+            if (bits->test_nonroot(j))
             {
                 /*
                  *   If the entry is not reachable, and was previously
@@ -2203,73 +2471,450 @@ void CVmObjTable::gc_pass_finish(VMG0_)
      *   We have now marked everything that's fully reachable as being in
      *   state 'reachable', and everything that's reachable from a
      *   finalizable object as being in state 'f-reachable'.  Anything that
-     *   is still in state 'unreachable' is garbage and can be collected.  
+     *   is still in state 'unreachable' is garbage and can be collected.
+     *   
+     *   We sweep in two passes.  The first deletes the garbage.  The second
+     *   handles the survivors, and in particular asks the ones that keep
+     *   weak references to drop references to the objects we deleted.
+     *   Those clean-ups have to scan everything the object refers to, which
+     *   for a big Dictionary or WeakRefLookupTable is far more work than a
+     *   pass over the object table, so it's worth knowing first whether we
+     *   deleted anything at all: if not, nothing can have gone stale, and
+     *   we skip them entirely.  
      */
-    for (id = 0, i = pages_used_, pg = pages_ ; i > 0 ; ++pg, --i)
+    for (id = 0, i = 0, pg = pages_ ; i < pages_used_ ; ++pg, ++i)
     {
+        CVmObjPageBits *bits = page_bits_[i];
+
         /* go through each entry on this page */
-        for (j = VM_OBJ_PAGE_CNT, entry = *pg ; j > 0 ; --j, ++entry, ++id)
+        for (j = 0, entry = *pg ; j < VM_OBJ_PAGE_CNT ; ++j, ++entry, ++id)
         {
-            /* if it's not already free, process it */
-            if (!entry->free_)
+            /* skip runs of 32 free entries, as shown by the page summary */
+            if ((j & 31) == 0 && bits->used_[j >> 5] == 0)
             {
-                /* if the object is deletable, delete it */
-                if (entry->is_deletable())
-                {
-                    /*
-                     *   This object is completely unreachable, and it has
-                     *   already been finalized.  This means there is no
-                     *   possibility that the object could ever become
-                     *   reachable again, hence we can discard the object.
-                     */
-                    delete_entry(vmg_ id, entry);
-                }
-                else
-                {
-                    /*
-                     *   The object is reachable, so keep it around.  Since
-                     *   it's staying around, and since we know which
-                     *   objects we're deleting and which are staying, we
-                     *   can ask this object to remove all of its "stale
-                     *   weak references" - that is, weak references to
-                     *   objects that we're about to delete.  Don't bother
-                     *   notifying the object if it's incapable of keeping
-                     *   weak references.  
-                     */
-                    if (entry->can_have_weak_refs_)
-                        entry->get_vm_obj()->remove_stale_weak_refs(vmg0_);
+                j += 31;
+                entry += 31;
+                id += 31;
+                continue;
+            }
 
-                    /*
-                     *   If this object is finalizable, put it in the
-                     *   finalizer queue, so that we can run its finalizer
-                     *   when we're done scanning the table.  
-                     */
-                    if (entry->finalize_state_ == VMOBJ_FINALIZABLE)
-                        add_to_finalize_queue(id, entry);
+            /* if it's in use and deletable, delete it */
+            IF_GC_STATS(gc_stats.count_sweep_visit());
+            if (bits->test_used(j) && entry->is_deletable())
+            {
+                /*
+                 *   This object is completely unreachable, and it has
+                 *   already been finalized.  This means there is no
+                 *   possibility that the object could ever become reachable
+                 *   again, hence we can discard the object.
+                 */
+                delete_entry(vmg_ id, entry);
+                ++freed;
+            }
+        }
+    }
 
-                    /* 
-                     *   restore initial conditions for this object, so that
-                     *   we're properly set up for the next GC pass 
-                     */
-                    gc_set_init_conditions(id, entry);
-                }
+    /* now go through the survivors */
+    for (id = 0, i = 0, pg = pages_ ; i < pages_used_ ; ++pg, ++i)
+    {
+        CVmObjPageBits *bits = page_bits_[i];
+
+        /* go through each entry on this page */
+        for (j = 0, entry = *pg ; j < VM_OBJ_PAGE_CNT ; ++j, ++entry, ++id)
+        {
+            /* skip runs of 32 free entries, as shown by the page summary */
+            if ((j & 31) == 0 && bits->used_[j >> 5] == 0)
+            {
+                j += 31;
+                entry += 31;
+                id += 31;
+                continue;
             }
+
+            /* skip free entries (including the ones we just freed) */
+            if (!bits->test_used(j))
+                continue;
+
+            /*
+             *   Since we know which objects we deleted, we can ask this
+             *   object to remove all of its "stale weak references" - that
+             *   is, weak references to the deleted objects.  Don't bother
+             *   if we didn't delete anything, or if the object is incapable
+             *   of keeping weak references.  
+             */
+            if (freed != 0 && entry->can_have_weak_refs_)
+                entry->get_vm_obj()->remove_stale_weak_refs(vmg0_);
+
+            /*
+             *   If this object is finalizable, put it in the finalizer
+             *   queue, so that we can run its finalizer when we're done
+             *   scanning the table.  
+             */
+            if (entry->finalize_state_ == VMOBJ_FINALIZABLE)
+                add_to_finalize_queue(id, entry);
+
+            /* 
+             *   restore initial conditions for this object, so that we're
+             *   properly set up for the next GC pass 
+             */
+            gc_set_init_conditions(id, entry);
+
+            /* count the survivor */
+            ++survivors;
         }
     }
-    
+
+    /* the sweep proper is done */
+    IF_GC_STATS(gc_stats.end_sweep());
+
     /*
      *   Go through the undo records and clear any stale weak references
-     *   contained in the undo list.  
+     *   contained in the undo list (again, only if we deleted anything).  
      */
-    G_undo->gc_remove_stale_weak_refs(vmg0_);
+    if (freed != 0)
+        G_undo->gc_remove_stale_weak_refs(vmg0_);
 
-    /*
-     *   All of the finalizable objects are now in the finalizer queue.  Run
-     *   through the finalizer queue and run each such object's finalizer. 
+    /* 
+     *   Set the threshold for the next pass, based on this one.  Do this
+     *   before running finalizers, since those run arbitrary byte code
+     *   that shouldn't count against the pause time.  For a background
+     *   pass, count only the time we actually spent working, not the time
+     *   between steps.  
      */
+    long elapsed_ms = (gc_bg_state_ != VMOBJ_GC_BG_IDLE
+                       ? gc_bg_work_ms_
+                       : os_get_sys_clock_ms() - gc_pass_start_ms_);
+    gc_record_pass(vmg_ elapsed_ms, freed, survivors);
+    gc_adapt_thresholds(elapsed_ms, survivors);
+}
+
+/*
+ *   Record the statistics for a pass, and write the log line if we're
+ *   keeping a log 
+ */
+void CVmObjTable::gc_record_pass(VMG_ long elapsed_ms, ulong freed,
+                                 ulong survivors)
+{
+    CVmVarHeap *heap = G_mem->get_var_heap();
+    ulong bytes = heap->get_bytes_in_use();
+
+    /* update the totals */
+    ++gc_totals_.passes;
+    gc_totals_.total_pause_ms += elapsed_ms;
+    if ((ulong)elapsed_ms > gc_totals_.max_pause_ms)
+        gc_totals_.max_pause_ms = elapsed_ms;
+    gc_totals_.objs_freed += freed;
+    if (bytes < gc_pass_start_bytes_)
+        gc_totals_.bytes_freed += gc_pass_start_bytes_ - bytes;
+    gc_totals_.live_objs = survivors;
+    gc_totals_.live_bytes = bytes;
+
+    /* if there's a log, write a line for the pass */
+    if (gc_log_ != 0)
+    {
+        char buf[256];
+        t3sprintf(buf, sizeof(buf),
+                  "gc %lu: pause %ldms, freed %lu objects %lu bytes, "
+                  "live %lu objects %lu bytes, peak %lu bytes, "
+                  "finalize queue %lu\n",
+                  gc_totals_.passes, elapsed_ms, freed,
+                  bytes < gc_pass_start_bytes_
+                  ? gc_pass_start_bytes_ - bytes : 0,
+                  survivors, bytes, heap->get_peak_bytes(),
+                  count_finalize_queue());
+
+        /* 
+         *   write it; the log is only a diagnostic aid, so ignore any
+         *   error writing it 
+         */
+        err_try
+        {
+            gc_log_->write_bytes(buf, strlen(buf));
+        }
+        err_catch_disc
+        {
+        }
+        err_end;
+    }
+}
+
+/*
+ *   Count the objects in the finalizer queue 
+ */
+ulong CVmObjTable::count_finalize_queue() const
+{
+    ulong cnt;
+    vm_obj_id_t id;
+
+    for (cnt = 0, id = finalize_queue_head_ ; id != VM_INVALID_OBJ ;
+         id = get_entry(id)->next_obj_)
+        ++cnt;
+
+    return cnt;
+}
+
+/*
+ *   Get the garbage collector statistics 
+ */
+void CVmObjTable::get_gc_stats(VMG_ vm_gc_stats *stats) const
+{
+    /* start with the running totals */
+    *stats = gc_totals_;
+
+    /* fill in the values that we figure on request */
+    stats->peak_bytes = G_mem->get_var_heap()->get_peak_bytes();
+    stats->finalize_queue_len = count_finalize_queue();
+
+    /* add the undo log usage */
+    stats->undo_bytes = G_undo->get_mem_used();
+    stats->undo_budget = G_undo->get_mem_budget();
+    stats->undo_savepts = G_undo->get_savept_cnt();
+}
+
+/*
+ *   Take a census of the live objects by metaclass 
+ */
+vm_heap_census *CVmObjTable::heap_census(VMG_ size_t *cnt) const
+{
+    size_t meta_cnt, i, used;
+
+    /* count the registered metaclasses */
+    for (meta_cnt = 0 ; G_meta_reg_table[meta_cnt].meta != 0 ; ++meta_cnt) ;
+
+    /* allocate an entry per metaclass, indexed by registration index */
+    vm_heap_census *arr = (vm_heap_census *)t3malloc(
+        (meta_cnt != 0 ? meta_cnt : 1) * sizeof(arr[0]));
+    for (i = 0 ; i < meta_cnt ; ++i)
+    {
+        arr[i].meta = *G_meta_reg_table[i].meta;
+        arr[i].objs = 0;
+        arr[i].bytes = 0;
+    }
+
+    /* tally each live object under its metaclass */
+    for (i = 0 ; i < pages_used_ ; ++i)
+    {
+        size_t j;
+        CVmObjPageEntry *entry;
+        for (j = 0, entry = pages_[i] ; j < VM_OBJ_PAGE_CNT ; ++j, ++entry)
+        {
+            /* skip free slots and image objects we haven't created yet */
+            if (entry->free_ || entry->lazy_)
+                continue;
+
+            /* count it */
+            CVmObject *obj = entry->get_vm_obj();
+            vm_heap_census *c = &arr[obj->get_metaclass_reg()->get_reg_idx()];
+            c->objs += 1;
+            c->bytes += sizeof(CVmObjPageEntry)
+                        + obj->get_mem_usage(vmg_ entry->in_root_set_);
+        }
+    }
+
+    /* squeeze out the metaclasses with no live objects */
+    for (i = used = 0 ; i < meta_cnt ; ++i)
+    {
+        if (arr[i].objs != 0)
+            arr[used++] = arr[i];
+    }
+
+    /* return the array */
+    *cnt = used;
+    return arr;
+}
+
+/*
+ *   Write a heap census to the garbage collection log 
+ */
+void CVmObjTable::log_heap_census(VMG0_)
+{
+    size_t cnt, i;
+    vm_heap_census *arr = heap_census(vmg_ &cnt);
+
+    /* the log is only a diagnostic aid, so ignore any error writing it */
+    err_try
+    {
+        for (i = 0 ; i < cnt ; ++i)
+        {
+            char buf[256];
+            t3sprintf(buf, sizeof(buf), "heap %s: %lu objects %lu bytes\n",
+                      arr[i].meta->get_meta_name(),
+                      arr[i].objs, arr[i].bytes);
+            gc_log_->write_bytes(buf, strlen(buf));
+        }
+    }
+    err_catch_disc
+    {
+    }
+    err_end;
+
+    /* done with the census */
+    t3free(arr);
+}
+
+/*
+ *   Open the garbage collection log 
+ */
+void CVmObjTable::open_gc_log(const char *fname)
+{
+    /* if there's no file name, there's no log */
+    if (fname == 0 || fname[0] == '\0')
+        return;
+
+    /* 
+     *   open the file; if that fails, just run without a log, since this
+     *   is only a diagnostic aid 
+     */
+    CVmFile *fp = new CVmFile();
+    err_try
+    {
+        fp->open_write(fname, OSFTTEXT);
+        gc_log_ = fp;
+    }
+    err_catch_disc
+    {
+        delete fp;
+    }
+    err_end;
+}
+
+/*
+ *   Background garbage collection - do one increment of work 
+ */
+int CVmObjTable::gc_bg_step(VMG0_)
+{
+    /* note the starting time of this step */
+    long t0 = os_get_sys_clock_ms();
+    double trace_t0 = (vm_trace_active() ? vm_trace_now() : 0);
+
+    switch (gc_bg_state_)
+    {
+    case VMOBJ_GC_BG_IDLE:
+        /* 
+         *   if the collector is disabled, or nothing has been allocated
+         *   since the last pass, there's nothing to do 
+         */
+        if (!gc_enabled_ || (allocs_since_gc_ == 0 && bytes_since_gc_ == 0))
+            return FALSE;
+
+        /* start a new pass */
+        IF_GC_STATS(gc_stats.begin_pass());
+        gc_bg_state_ = VMOBJ_GC_BG_MARKING;
+        gc_bg_work_ms_ = 0;
+        gc_pass_init(vmg0_);
+        break;
+
+    case VMOBJ_GC_BG_MARKING:
+        /* 
+         *   trace the next slice of the work queue; when the queue runs
+         *   dry, sweep up the garbage 
+         */
+        if (!gc_pass_continue(vmg_ TRUE))
+        {
+            gc_pass_sweep(vmg0_);
+            gc_bg_state_ = VMOBJ_GC_BG_SWEPT;
+        }
+        break;
+
+    case VMOBJ_GC_BG_SWEPT:
+        /* 
+         *   The garbage is gone, and the VM is blocked, so nothing is
+         *   holding pointers into object extensions - this is the time to
+         *   compact the variable heap 
+         */
+        if (gc_compact_)
+        {
+            G_mem->get_var_heap()->compact(vmg0_);
+            if (vm_trace_active())
+                vm_trace_phase("gc", "gc compact", trace_t0, 0);
+        }
+        gc_bg_state_ = VMOBJ_GC_BG_COMPACTED;
+        return FALSE;
+
+    case VMOBJ_GC_BG_COMPACTED:
+        /* only the finalizers remain, and they have to wait for the VM */
+        return FALSE;
+    }
+
+    /* count the time spent */
+    gc_bg_work_ms_ += os_get_sys_clock_ms() - t0;
+    if (vm_trace_active())
+        vm_trace_phase("gc", "gc background step", trace_t0, 0);
+
+    /* 
+     *   there's more to do if we're still marking, or if we have yet to
+     *   compact the heap 
+     */
+    return (gc_bg_state_ == VMOBJ_GC_BG_MARKING
+            || (gc_bg_state_ == VMOBJ_GC_BG_SWEPT && gc_compact_));
+}
+
+/*
+ *   Background garbage collection - finish the pass in progress 
+ */
+void CVmObjTable::gc_bg_finish(VMG0_)
+{
+    switch (gc_bg_state_)
+    {
+    case VMOBJ_GC_BG_IDLE:
+        /* there's no pass in progress */
+        return;
+
+    case VMOBJ_GC_BG_MARKING:
+        /* finish marking and sweep */
+        gc_pass_sweep(vmg0_);
+        break;
+    }
+
+    /* 
+     *   the pass is now complete apart from finalizers; mark the background
+     *   pass as done before running them, since they can allocate objects 
+     */
+    gc_bg_state_ = VMOBJ_GC_BG_IDLE;
+    IF_GC_STATS(gc_stats.end_pass());
+
+    /* run the finalizers */
     run_finalizers(vmg0_);
 }
 
+/*
+ *   Adapt the garbage collection thresholds after a pass.
+ *   
+ *   The cost of a pass has a part that's proportional to the live heap,
+ *   since every surviving object is scanned, and a part that's
+ *   proportional to the garbage, which is roughly the number of
+ *   allocations since the last pass.  To keep the live-heap part from
+ *   dominating, we allow the heap to grow by half of the surviving object
+ *   count before the next pass, so a program with a large live set runs
+ *   the collector less often.  Then, if this pass went over the pause
+ *   budget, we scale the threshold down in proportion, since the garbage
+ *   part is the part we can control.  
+ */
+void CVmObjTable::gc_adapt_thresholds(long elapsed_ms, ulong survivors)
+{
+    /* start with half of the surviving heap */
+    ulong n = survivors / 2;
+
+    /* if we went over the pause budget, reduce the threshold accordingly */
+    if (elapsed_ms > gc_pause_budget_ms_)
+    {
+        ulong lim = (ulong)max_allocs_between_gc_ * gc_pause_budget_ms_
+                    / elapsed_ms;
+        if (lim < n)
+            n = lim;
+    }
+
+    /* keep it within bounds */
+    if (n < VM_GC_MIN_ALLOCS)
+        n = VM_GC_MIN_ALLOCS;
+    else if (n > VM_GC_MAX_ALLOCS)
+        n = VM_GC_MAX_ALLOCS;
+
+    /* set the new limits */
+    max_allocs_between_gc_ = (uint)n;
+    max_bytes_between_gc_ = n * VM_GC_BYTES_PER_ALLOC;
+}
+
 /*
  *   Trace all objects reachable from the work queue. 
  */
@@ -2467,8 +3112,12 @@ void CVmObjTable::notify_new_savept()
                  */
                 entry->in_undo_ = TRUE;
                 
-                /* notify the object of the new savepoint */
-                entry->get_vm_obj()->notify_new_savept();
+                /* 
+                 *   notify the object of the new savepoint (unless it's a
+                 *   lazy image object, which has no undo state yet) 
+                 */
+                if (!entry->lazy_)
+                    entry->get_vm_obj()->notify_new_savept();
             }
         }
     }
@@ -2536,10 +3185,16 @@ void CVmObjTable::add_metadeps_for_instances(VMG0_)
         /* go through each entry on this page */
         for ( ; j > 0 ; --j, ++entry, ++id)
         {
-            /* if this entry is in use, add its metaclass if necessary */
+            /* 
+             *   if this entry is in use, add its metaclass if necessary
+             *   (for a lazy image object, we have the registration index
+             *   without having to create the object) 
+             */
             if (!entry->free_)
                 G_meta_table->add_entry_if_new(
-                    entry->get_vm_obj()->get_metaclass_reg()->get_reg_idx(),
+                    entry->lazy_
+                    ? (uint)entry->next_obj_
+                    : entry->get_vm_obj()->get_metaclass_reg()->get_reg_idx(),
                     0, VM_INVALID_PROP, VM_INVALID_PROP);
         }
     }
@@ -2559,6 +3214,11 @@ CVmObjFixup::CVmObjFixup(ulong entry_cnt)
     
     /* no entries are used yet */
     used_ = 0;
+
+    /* no direct index until the table is complete */
+    direct_ = 0;
+    direct_base_ = 0;
+    direct_cnt_ = 0;
     
     /* if we have no entries, there's nothing to do */
     if (cnt_ == 0)
@@ -2599,6 +3259,10 @@ CVmObjFixup::~CVmObjFixup()
 {
     uint i;
 
+    /* delete the direct index */
+    if (direct_ != 0)
+        t3free(direct_);
+
     /* if we never allocated an array, there's nothing to do */
     if (arr_ == 0)
         return;
@@ -2624,6 +3288,46 @@ void CVmObjFixup::add_fixup(vm_obj_id_t old_id, vm_obj_id_t new_id)
     /* store it */
     entry->old_id = old_id;
     entry->new_id = new_id;
+
+    /* if that completes the table, build the direct index if possible */
+    if (used_ == cnt_)
+        build_direct();
+}
+
+/*
+ *   build the direct index 
+ */
+void CVmObjFixup::build_direct()
+{
+    /* 
+     *   get the ID range - the entries are in ascending order of old ID, so
+     *   the first and last entries give us the bounds 
+     */
+    vm_obj_id_t lo = get_entry(0)->old_id;
+    vm_obj_id_t hi = get_entry(cnt_ - 1)->old_id;
+    ulong range = (ulong)(hi - lo) + 1;
+
+    /* if the range is too sparse, stick with the binary search */
+    if (hi < lo || range / VMOBJFIXUP_DIRECT_DENSITY > cnt_)
+        return;
+
+    /* allocate the index; if we can't, just use the binary search */
+    direct_ = (vm_obj_id_t *)t3malloc(range * sizeof(direct_[0]));
+    if (direct_ == 0)
+        return;
+
+    /* every ID maps to itself, except the ones in the table */
+    for (ulong i = 0 ; i < range ; ++i)
+        direct_[i] = lo + (vm_obj_id_t)i;
+    for (ulong i = 0 ; i < cnt_ ; ++i)
+    {
+        obj_fixup_entry *entry = get_entry(i);
+        direct_[entry->old_id - lo] = entry->new_id;
+    }
+
+    /* remember the range */
+    direct_base_ = lo;
+    direct_cnt_ = range;
 }
 
 /*
@@ -2640,6 +3344,14 @@ vm_obj_id_t CVmObjFixup::get_new_id(VMG_ vm_obj_id_t old_id)
         && G_obj_table->is_obj_in_root_set(old_id))
         return old_id;
 
+    /* if we have a direct index, look it up there */
+    if (direct_ != 0)
+    {
+        ulong idx = (ulong)(old_id - direct_base_);
+        return (old_id >= direct_base_ && idx < direct_cnt_
+                ? direct_[idx] : old_id);
+    }
+
     /* find the entry by the object ID */
     obj_fixup_entry *entry = find_entry(old_id);
     
@@ -2788,9 +3500,17 @@ void CVmObjTable::save(VMG_ CVmFile *fp)
      *   set of objects that must be saved, and hence won't save any objects
      *   that are only weakly referenced, which would leave dangling
      *   references in the saved state if those weak references weren't
-     *   cleaned up before the objects containing them are saved. 
+     *   cleaned up before the objects containing them are saved.
+     *   
+     *   If a background pass has already swept the heap while the VM has
+     *   been blocked waiting for input (see vm_autosave()), nothing can
+     *   have changed since, so that pass serves the same purpose; its
+     *   finalizers will run as usual when the host finishes the pass.  
      */
-    gc_full(vmg0_);
+    if (!((gc_bg_state_ == VMOBJ_GC_BG_SWEPT
+           || gc_bg_state_ == VMOBJ_GC_BG_COMPACTED)
+          && allocs_since_gc_ == 0 && bytes_since_gc_ == 0))
+        gc_full(vmg0_);
 
     /* 
      *   Make sure that all of the metaclasses that we are actually using
@@ -3143,12 +3863,15 @@ void CVmObjTable::reset_to_image(VMG0_)
              *   if it's not free, and it's in the root set, and it's not
              *   transient, reset it 
              */
-            if (!entry->free_ && entry->in_root_set_ && !entry->transient_)
+            if (!entry->free_ && entry->in_root_set_ && !entry->transient_
+                && !entry->lazy_)
             {
                 /*
                  *   This object is part of the root set, so it's part of
                  *   the state immediately after loading the image.  Reset
-                 *   the object to its load file conditions.  
+                 *   the object to its load file conditions.  (A lazy image
+                 *   object hasn't been created yet, so it's still in its
+                 *   load file conditions.)  
                  */
                 entry->get_vm_obj()->reset_to_image(vmg_ id);
             }
@@ -3406,6 +4129,12 @@ void CVmObjTable::do_all_post_load_init(VMG0_)
     /* set up our context */
     ctx.globals = VMGLOB_ADDR;
 
+    /* 
+     *   from now on, lazy image objects must be initialized as they're
+     *   created, since they'll miss this enumeration 
+     */
+    post_load_started_ = TRUE;
+
     /* first, mark all entries as having status 'uninitialized' */
     post_load_init_table_->enum_entries(&pli_status_cb, &ctx);
 
@@ -3463,7 +4192,7 @@ CVmMemory::CVmMemory(VMG_ CVmVarHeap *varheap)
  *   we can ignore the size parameter; the heap manager will only route us
  *   requests that fit in our blocks.  
  */
-CVmVarHeapHybrid_hdr *CVmVarHeapHybrid_head::alloc(size_t)
+CVmVarHeapHybrid_hdr *CVmVarHeapHybrid_head::alloc(size_t siz)
 {
     /* if there isn't an entry, allocate another array */
     if (first_free_ == 0)
@@ -3490,10 +4219,14 @@ CVmVarHeapHybrid_hdr *CVmVarHeapHybrid_head::alloc(size_t)
         if (arr == 0)
             err_throw(VMERR_OUT_OF_MEMORY);
 
-        /* link the array into the master list */
+        /* link the array into the master list, and note its owner */
         arr->next_array = mem_mgr_->first_array_;
+        arr->head = this;
         mem_mgr_->first_array_ = arr;
 
+        /* count the page */
+        IF_GC_STATS(++st_pages_);
+
         /* 
          *   Build the free list.  Each cell goes into the free list; the
          *   'next' pointer is stored in the data area of the cell. 
@@ -3521,6 +4254,15 @@ CVmVarHeapHybrid_hdr *CVmVarHeapHybrid_head::alloc(size_t)
     /* fill in the block's pointer to the allocating heap (i.e., this) */
     ret->block = this;
 
+    /* count the space */
+    mem_mgr_->usage_.add(cell_size_);
+
+    /* count statistics */
+    IF_GC_STATS(++st_allocs_);
+    IF_GC_STATS(st_cur_bytes_ += siz);
+    IF_GC_STATS(if (++st_cur_cells_ > st_peak_cells_)
+        st_peak_cells_ = st_cur_cells_);
+
     /* return the item */
     return ret;
 }
@@ -3537,7 +4279,10 @@ void *CVmVarHeapHybrid_head::realloc(CVmVarHeapHybrid_hdr *mem, size_t siz,
      *   return the client-visible portion 
      */
     if (siz <= cell_size_)
+    {
+        IF_GC_STATS(st_cur_bytes_ += siz - mem->siz);
         return (void *)(mem + 1);
+    }
 
     /*
      *   The memory won't fit in our cell size, so not only can't we
@@ -3564,11 +4309,39 @@ void *CVmVarHeapHybrid_head::realloc(CVmVarHeapHybrid_hdr *mem, size_t siz,
     return new_mem;
 }
 
+#ifdef VMOBJ_GC_STATS
+/*
+ *   Display statistics for the size class
+ */
+void CVmVarHeapHybrid_head::display_stats() const
+{
+    /* figure the internal fragmentation as a percentage of cell space */
+    long cell_bytes = st_cur_cells_ * (long)cell_size_;
+    long frag = (cell_bytes != 0
+                 ? (cell_bytes - st_cur_bytes_) * 100 / cell_bytes : 0);
+
+    printf("  %5lu: allocs %ld, frees %ld, pages %ld (%ld bytes), "
+           "live cells %ld (peak %ld), waste %ld%%\n",
+           (unsigned long)cell_size_, st_allocs_, st_frees_, st_pages_,
+           st_pages_ * (long)page_count_
+           * (long)osrndsz(cell_size_ + osrndsz(sizeof(CVmVarHeapHybrid_hdr))),
+           st_cur_cells_, st_peak_cells_, frag);
+}
+#endif /* VMOBJ_GC_STATS */
+
 /*
  *   Release memory 
  */
 void CVmVarHeapHybrid_head::free(CVmVarHeapHybrid_hdr *mem)
 {
+    /* count statistics */
+    IF_GC_STATS(++st_frees_);
+    IF_GC_STATS(--st_cur_cells_);
+    IF_GC_STATS(st_cur_bytes_ -= mem->siz);
+
+    /* uncount the space */
+    mem_mgr_->usage_.sub(cell_size_);
+
     /* link the block into our free list */
     *(void **)mem = first_free_;
     first_free_ = (void *)mem;
@@ -3587,8 +4360,21 @@ CVmVarHeapHybrid::CVmVarHeapHybrid(CVmObjTable *objtab)
     /* remember my object table */
     objtab_ = objtab;
 
+    /* 
+     *   The cell sizes.  These go up in alternating steps of 1.5x and 1.33x
+     *   (i.e., powers of two and the halfway points between them), so that
+     *   the space wasted by rounding a request up to its cell size is at
+     *   most a third of the request.  Strings and lists in the range of a
+     *   few hundred bytes to a few kilobytes are common, so we go up to
+     *   VMVH_CELL_MAX before falling back on malloc.  
+     */
+    static const size_t cell_sizes[] = {
+        32, 48, 64, 96, 128, 192, 256, 384, 512, 768,
+        1024, 1536, 2048, 3072, VMVH_CELL_MAX
+    };
+
     /* set the cell heap count */
-    cell_heap_cnt_ = 5;
+    cell_heap_cnt_ = countof(cell_sizes);
 
     /* allocate our cell heap pointer array */
     cell_heaps_ = (CVmVarHeapHybrid_head **)
@@ -3600,16 +4386,32 @@ CVmVarHeapHybrid::CVmVarHeapHybrid(CVmObjTable *objtab)
 
     /* 
      *   Allocate our cell heaps.  Set up the heaps so that the pages run
-     *   about 32k each.  
+     *   about 32k each, but with at least 8 cells per page for the larger
+     *   sizes.  
      */
-    cell_heaps_[0] = new CVmVarHeapHybrid_head(this, 32, 850);
-    cell_heaps_[1] = new CVmVarHeapHybrid_head(this, 64, 400);
-    cell_heaps_[2] = new CVmVarHeapHybrid_head(this, 128, 200);
-    cell_heaps_[3] = new CVmVarHeapHybrid_head(this, 256, 100);
-    cell_heaps_[4] = new CVmVarHeapHybrid_head(this, 512, 50);
+    size_t i;
+    for (i = 0 ; i < cell_heap_cnt_ ; ++i)
+    {
+        size_t cnt = 32768 / (cell_sizes[i] + sizeof(CVmVarHeapHybrid_hdr));
+        if (cnt < 8)
+            cnt = 8;
+        cell_heaps_[i] = new CVmVarHeapHybrid_head(this, cell_sizes[i], cnt);
+    }
+
+    /* build the size class map */
+    size_t j;
+    for (i = 0, j = 0 ; i < countof(size_map_) ; ++i)
+    {
+        /* advance to the first cell heap large enough for this slot */
+        while (cell_heaps_[j]->get_cell_size() < i * VMVH_CELL_GRAN)
+            ++j;
+
+        /* set the slot */
+        size_map_[i] = cell_heaps_[j];
+    }
 
     /* allocate our malloc heap manager */
-    malloc_heap_ = new CVmVarHeapHybrid_malloc();
+    malloc_heap_ = new CVmVarHeapHybrid_malloc(&usage_);
 
     /* we haven't allocated any cell array pages yet */
     first_array_ = 0;
@@ -3621,6 +4423,11 @@ CVmVarHeapHybrid::CVmVarHeapHybrid(CVmObjTable *objtab)
 CVmVarHeapHybrid::~CVmVarHeapHybrid()
 {
     size_t i;
+
+    /* show statistics if applicable */
+    IF_GC_STATS(printf("Variable heap size class statistics:\n"));
+    IF_GC_STATS(for (i = 0 ; i < cell_heap_cnt_ ; ++i)
+        cell_heaps_[i]->display_stats());
     
     /* delete our cell heaps */
     for (i = 0 ; i < cell_heap_cnt_ ; ++i)
@@ -3651,33 +4458,30 @@ CVmVarHeapHybrid::~CVmVarHeapHybrid()
 /*
  *   allocate memory 
  */
-void *CVmVarHeapHybrid::alloc_mem(size_t siz, CVmObject *)
+void *CVmVarHeapHybrid::alloc_mem(size_t siz, CVmObject *obj)
 {
-    CVmVarHeapHybrid_head **subheap;
-    size_t i;
-
     /* count the gc statistics if desired */
     IF_GC_STATS(gc_stats.count_alloc_bytes(siz));
 
+    /* trace the allocation if desired */
+    VM_IF_ALLOC_TRACE(vm_alloc_trace_mem(siz, obj));
+
     /* count the allocation */
     objtab_->count_alloc(siz);
 
-    /* scan for a cell-based subheap that can handle the request */
-    for (i = 0, subheap = cell_heaps_ ; i < cell_heap_cnt_ ; ++i, ++subheap)
+    /* 
+     *   If it will fit in one of our cell sizes, look up the best-fitting
+     *   subheap in the size class map and allocate it there.  Note that we
+     *   must adjust the return pointer so that it points to the
+     *   caller-visible portion of the block returned from the subheap,
+     *   which immediately follows the internal header.  
+     */
+    if (siz <= VMVH_CELL_MAX)
     {
-        /* 
-         *   If it will fit in this one's cell size, allocate it from this
-         *   subheap.  Note that we must adjust the return pointer so that
-         *   it points to the caller-visible portion of the block returned
-         *   from the subheap, which immediately follows the internal
-         *   header.  
-         */
-        if (siz <= (*subheap)->get_cell_size())
-        {
-            CVmVarHeapHybrid_hdr *hdr = (*subheap)->alloc(siz);
-            IF_GC_STATS(hdr->siz = siz);
-            return (void *)(hdr + 1);
-        }
+        CVmVarHeapHybrid_hdr *hdr =
+            size_map_[(siz + VMVH_CELL_GRAN - 1) / VMVH_CELL_GRAN]->alloc(siz);
+        IF_GC_STATS(hdr->siz = siz);
+        return (void *)(hdr + 1);
     }
 
     /*
@@ -3710,6 +4514,9 @@ void *CVmVarHeapHybrid::realloc_mem(size_t siz, void *mem,
      */
     objtab_->count_alloc(siz);
 
+    /* trace the allocation if desired */
+    VM_IF_ALLOC_TRACE(vm_alloc_trace_mem(siz, obj));
+
     /* 
      *   get the block header, which immediately precedes the
      *   caller-visible block 
@@ -3717,13 +4524,22 @@ void *CVmVarHeapHybrid::realloc_mem(size_t siz, void *mem,
     hdr = ((CVmVarHeapHybrid_hdr *)mem) - 1;
 
     /* count the gc statistics if desired */
-    IF_GC_STATS((gc_stats.count_realloc_bytes(hdr->siz, siz), hdr->siz = siz));
+    IF_GC_STATS(gc_stats.count_realloc_bytes(hdr->siz, siz));
 
     /*
      *   read the header to get the block manager that originally
      *   allocated the memory, and ask it to reallocate the memory 
      */
-    return hdr->block->realloc(hdr, siz, obj);
+    void *ret = hdr->block->realloc(hdr, siz, obj);
+
+    /* 
+     *   note the new size (only after the reallocation, since the block
+     *   manager's own statistics need the old size) 
+     */
+    IF_GC_STATS(((CVmVarHeapHybrid_hdr *)ret - 1)->siz = siz);
+
+    /* return the new block */
+    return ret;
 }
 
 /*
@@ -3749,3 +4565,253 @@ void CVmVarHeapHybrid::free_mem(void *mem)
     hdr->block->free(hdr);
 }
 
+/*
+ *   Heap compaction page descriptor.  compact() builds a table of these,
+ *   sorted by address, so that it can find the page containing a cell.
+ */
+struct vmvh_page_info
+{
+    /* the page */
+    CVmVarHeapHybrid_array *arr;
+
+    /* the bounds of the page's cell area */
+    char *lo;
+    char *hi;
+
+    /* number of cells in use */
+    size_t live;
+
+    /* number of cells in use by objects that can be relocated */
+    size_t movable;
+
+    /* are we evacuating this page? */
+    int evac;
+};
+
+/* heap compaction context */
+struct vmvh_compact_ctx
+{
+    /* the page table, and the number of entries */
+    vmvh_page_info *pages;
+    size_t cnt;
+};
+
+/* page table sort callback - order by address */
+static int vmvh_page_cmp(const void *a0, const void *b0)
+{
+    const vmvh_page_info *a = (const vmvh_page_info *)a0;
+    const vmvh_page_info *b = (const vmvh_page_info *)b0;
+    return (a->lo < b->lo ? -1 : a->lo > b->lo ? 1 : 0);
+}
+
+/* find the page containing the given address, or null if none */
+static vmvh_page_info *vmvh_find_page(vmvh_compact_ctx *ctx, const char *p)
+{
+    size_t lo = 0, hi = ctx->cnt;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi)/2;
+        vmvh_page_info *pg = &ctx->pages[mid];
+
+        if (p < pg->lo)
+            hi = mid;
+        else if (p >= pg->hi)
+            lo = mid + 1;
+        else
+            return pg;
+    }
+    return 0;
+}
+
+/*
+ *   Compact the cell pages.
+ *
+ *   Each cell heap only ever grows its page list, so after a long session
+ *   with a stable live set, the pages can end up mostly empty, with the
+ *   surviving cells scattered across all of them.  We find the pages
+ *   where no more than a quarter of the cells are in use, and where all of
+ *   the cells in use belong to objects that let us move their extensions.
+ *   We take the free cells in those pages out of the free lists, copy the
+ *   live cells into cells from the other pages (or into new, dense pages),
+ *   and then give the evacuated pages back to the system.
+ */
+void CVmVarHeapHybrid::compact(VMG0_)
+{
+    vmvh_compact_ctx ctx;
+    CVmVarHeapHybrid_array *arr;
+    size_t i;
+    int found;
+
+    /* count the pages */
+    for (ctx.cnt = 0, arr = first_array_ ; arr != 0 ; arr = arr->next_array)
+        ++ctx.cnt;
+
+    /* if there are no pages, there's nothing to do */
+    if (ctx.cnt == 0)
+        return;
+
+    /* 
+     *   allocate the page table; this is only an optimization, so if we
+     *   can't get the memory, simply skip it 
+     */
+    ctx.pages = (vmvh_page_info *)t3malloc(ctx.cnt * sizeof(ctx.pages[0]));
+    if (ctx.pages == 0)
+        return;
+
+    /* build the page table, initially counting every cell as in use */
+    for (i = 0, arr = first_array_ ; arr != 0 ; arr = arr->next_array, ++i)
+    {
+        vmvh_page_info *pg = &ctx.pages[i];
+        pg->arr = arr;
+        pg->lo = arr->mem;
+        pg->hi = arr->mem
+                 + arr->head->page_count_ * arr->head->get_real_cell_size();
+        pg->live = arr->head->page_count_;
+        pg->movable = 0;
+        pg->evac = FALSE;
+    }
+
+    /* sort the table by address */
+    qsort(ctx.pages, ctx.cnt, sizeof(ctx.pages[0]), &vmvh_page_cmp);
+
+    /* uncount the free cells */
+    for (i = 0 ; i < cell_heap_cnt_ ; ++i)
+    {
+        void *p;
+        for (p = cell_heaps_[i]->first_free_ ; p != 0 ; p = *(void **)p)
+            --vmvh_find_page(&ctx, (char *)p)->live;
+    }
+
+    /* count the cells that belong to objects we can move */
+    objtab_->for_each(vmg_ &compact_count_cb, &ctx);
+
+    /* choose the pages to evacuate */
+    for (found = FALSE, i = 0 ; i < ctx.cnt ; ++i)
+    {
+        vmvh_page_info *pg = &ctx.pages[i];
+        if (pg->live * 4 <= pg->arr->head->page_count_
+            && pg->movable == pg->live)
+            pg->evac = found = TRUE;
+    }
+
+    /* if we didn't find anything worth compacting, we're done */
+    if (!found)
+    {
+        t3free(ctx.pages);
+        return;
+    }
+
+    /* 
+     *   take the free cells in the evacuated pages out of the free lists,
+     *   so that the live cells we move don't land in those pages again 
+     */
+    for (i = 0 ; i < cell_heap_cnt_ ; ++i)
+    {
+        void **pp;
+        for (pp = &cell_heaps_[i]->first_free_ ; *pp != 0 ; )
+        {
+            if (vmvh_find_page(&ctx, (char *)*pp)->evac)
+                *pp = *(void **)*pp;
+            else
+                pp = (void **)*pp;
+        }
+    }
+
+    /* move the live cells out of the evacuated pages */
+    objtab_->for_each(vmg_ &compact_move_cb, &ctx);
+
+    /* release the evacuated pages */
+    CVmVarHeapHybrid_array **arrp;
+    for (arrp = &first_array_ ; *arrp != 0 ; )
+    {
+        vmvh_page_info *pg = vmvh_find_page(&ctx, (*arrp)->mem);
+        if (pg != 0 && pg->evac)
+        {
+            /* unlink it and free it */
+            arr = *arrp;
+            *arrp = arr->next_array;
+            IF_GC_STATS(--arr->head->st_pages_);
+            t3free(arr);
+        }
+        else
+            arrp = &(*arrp)->next_array;
+    }
+
+    /* done with the page table */
+    t3free(ctx.pages);
+}
+
+/*
+ *   compaction callback - count the cells that belong to objects that can
+ *   be moved 
+ */
+void CVmVarHeapHybrid::compact_count_cb(VMG_ vm_obj_id_t id, void *ctx0)
+{
+    vmvh_compact_ctx *ctx = (vmvh_compact_ctx *)ctx0;
+
+    /* a lazy image object has no extension yet, so don't create it */
+    if (G_obj_table->is_obj_lazy(id))
+        return;
+
+    CVmObject *obj = vm_objp(vmg_ id);
+    char *ext = get_obj_ext(obj);
+
+    /* if the object allows it, and it's in a cell page, count it */
+    if (ext != 0 && obj->can_relocate_ext())
+    {
+        vmvh_page_info *pg = vmvh_find_page(
+            ctx, (char *)((CVmVarHeapHybrid_hdr *)ext - 1));
+        if (pg != 0)
+            ++pg->movable;
+    }
+}
+
+/*
+ *   compaction callback - move an object's extension out of an evacuated
+ *   page 
+ */
+void CVmVarHeapHybrid::compact_move_cb(VMG_ vm_obj_id_t id, void *ctx0)
+{
+    vmvh_compact_ctx *ctx = (vmvh_compact_ctx *)ctx0;
+
+    /* a lazy image object has no extension yet, so there's nothing to move */
+    if (G_obj_table->is_obj_lazy(id))
+        return;
+
+    CVmObject *obj = vm_objp(vmg_ id);
+    char *ext = get_obj_ext(obj);
+
+    /* if the object can't be moved, skip it */
+    if (ext == 0 || !obj->can_relocate_ext())
+        return;
+
+    /* if it's not in an evacuated page, leave it where it is */
+    CVmVarHeapHybrid_hdr *hdr = (CVmVarHeapHybrid_hdr *)ext - 1;
+    vmvh_page_info *pg = vmvh_find_page(ctx, (char *)hdr);
+    if (pg == 0 || !pg->evac)
+        return;
+
+    /* allocate a new cell from the same cell heap, and copy the contents */
+    CVmVarHeapHybrid_head *head = pg->arr->head;
+#ifdef VMOBJ_GC_STATS
+    size_t siz = hdr->siz;
+#else
+    size_t siz = head->get_cell_size();
+#endif
+    CVmVarHeapHybrid_hdr *new_hdr = head->alloc(siz);
+    IF_GC_STATS(new_hdr->siz = siz);
+    memcpy(new_hdr + 1, hdr + 1, head->get_cell_size());
+
+    /* 
+     *   the old cell is going away with its page, so count it as freed
+     *   (but don't put it back in the free list) 
+     */
+    IF_GC_STATS(++head->st_frees_);
+    IF_GC_STATS(--head->st_cur_cells_);
+    IF_GC_STATS(head->st_cur_bytes_ -= siz);
+    head->mem_mgr_->usage_.sub(head->get_cell_size());
+
+    /* tell the object about its new extension */
+    obj->relocate_ext(vmg_ (char *)(new_hdr + 1));
+}
+
@@ -30,6 +30,7 @@ Modified
 #include "vmtype.h"
 #include "vmerr.h"
 #include "vmerrnum.h"
+#include "vmalloctr.h"
 
 
 /* ------------------------------------------------------------------------ */
@@ -106,6 +107,42 @@ Modified
  */
 const int VM_GC_WORK_INCREMENT = 500;
 
+/*
+ *   Adaptive garbage collection trigger parameters.  After each pass, the
+ *   object table sets the allocation threshold for the next pass from the
+ *   number of objects that survived, and then reduces it if the pass took
+ *   longer than the target pause time.  The result is kept within the
+ *   minimum and maximum given here.  The byte threshold is derived from
+ *   the object threshold using an average bytes-per-allocation figure.  
+ */
+const long VM_GC_DEFAULT_PAUSE_MS = 20;
+const uint VM_GC_MIN_ALLOCS = 2000;
+const uint VM_GC_MAX_ALLOCS = 250000;
+const ulong VM_GC_BYTES_PER_ALLOC = 640;
+
+/* 
+ *   background garbage collection states: idle (no pass in progress),
+ *   marking, swept (only heap compaction and the finalizers remain), and
+ *   compacted (only the finalizers remain) 
+ */
+#define VMOBJ_GC_BG_IDLE       0
+#define VMOBJ_GC_BG_MARKING    1
+#define VMOBJ_GC_BG_SWEPT      2
+#define VMOBJ_GC_BG_COMPACTED  3
+
+/*
+ *   Memory prefetch hint.  The work queue is a linked list threaded
+ *   through the object table entries, and the entries of a large heap are
+ *   mostly out of cache by the time they're traced, so the collector asks
+ *   for the next entry while it's tracing the current one.  This is only a
+ *   hint, so it's a no-op on compilers that don't offer it.  
+ */
+#if defined(__GNUC__)
+#define VMOBJ_PREFETCH(p)  __builtin_prefetch(p)
+#else
+#define VMOBJ_PREFETCH(p)
+#endif
+
 
 
 /* ------------------------------------------------------------------------ */
@@ -232,6 +269,19 @@ public:
      */
     virtual void notify_delete(VMG_ int in_root_set) = 0;
 
+    /*
+     *   Get the number of bytes of memory this object owns, apart from its
+     *   object table entry: its variable-heap extension plus anything else
+     *   it allocates separately.  This is for heap diagnostics only (see
+     *   CVmObjTable::heap_census()), so an estimate is fine.  'in_root_set'
+     *   has the same meaning as for notify_delete(); root-set objects
+     *   whose data lives in the image file own nothing.  By default, we
+     *   don't report anything, since we can't tell whether our extension
+     *   came from the variable heap.  
+     */
+    virtual size_t get_mem_usage(VMG_ int /*in_root_set*/) const
+        { return 0; }
+
     /*
      *   Create an instance of this class.  If this object does not
      *   represent a class, or cannot be instanced, throw an error.  By
@@ -544,6 +594,38 @@ public:
      */
     virtual int is_changed_since_load() const { return FALSE; }
 
+    /*
+     *   Does this metaclass call the object table's GC write barrier
+     *   (CVmObjTable::gc_write_barrier()) whenever it stores a reference that
+     *   could point to an object outside of the root set?  If so, the
+     *   garbage collector can skip tracing a root-set instance whose
+     *   references were all to other root-set objects the last time it was
+     *   traced, since root-set objects are always reachable anyway.  Most
+     *   metaclasses don't bother, so the default is false.  
+     */
+    virtual int has_gc_write_barrier() const { return FALSE; }
+
+    /*
+     *   Can the variable heap move this object's extension?  The heap can
+     *   compact itself by copying extensions out of sparsely used pages
+     *   (see CVmVarHeap::compact()), but only for metaclasses that allow
+     *   it.  A metaclass that returns true must keep its entire variable
+     *   part in the single block that ext_ points to, must not let
+     *   anything outside the object keep a pointer into that block, and
+     *   must override relocate_ext() if the block contains pointers to
+     *   itself.  Most metaclasses don't bother, so the default is false.
+     */
+    virtual int can_relocate_ext() const { return FALSE; }
+
+    /*
+     *   Receive notification that the variable heap has moved the
+     *   extension.  The heap has already copied the contents of the old
+     *   block to 'new_ext'; we must point ext_ at the new block and fix up
+     *   any internal pointers.  The old block is still intact during the
+     *   call, but is released immediately afterwards.
+     */
+    virtual void relocate_ext(VMG_ char *new_ext) { ext_ = new_ext; }
+
     /* 
      *   save this object to a file, so that it can be restored to its
      *   current state via restore_from_file 
@@ -992,6 +1074,12 @@ public:
     void *operator new(size_t siz, VMG_ vm_obj_id_t obj_id);
 
 protected:
+    /* 
+     *   get the size of our extension's variable-heap block, for
+     *   get_mem_usage() implementations 
+     */
+    size_t get_ext_heap_bytes(VMG0_) const;
+
     /*
      *   Find a modifier property.  This is an internal service routine that
      *   we use to traverse the hierarchy of modifier objects associated with
@@ -1230,6 +1318,23 @@ public:
      */
     virtual void create_for_image_load(VMG_ vm_obj_id_t id) = 0;
 
+    /*
+     *   Can instances of this metaclass be loaded lazily from the image
+     *   file?  If this returns true, then when lazy loading is enabled (see
+     *   CVmObjTable::set_lazy_load()), the loader doesn't create the
+     *   object at all; it simply records the location of the object's
+     *   image data, and the object table creates the object (via
+     *   create_for_image_load() and load_from_image()) the first time
+     *   anyone asks for it.
+     *   
+     *   A metaclass can only allow this if loading an instance has no
+     *   side effects that other code depends upon before the object is
+     *   first used, and if the image data refers only to root-set
+     *   objects, since the garbage collector doesn't trace into an object
+     *   that hasn't been created yet.  
+     */
+    virtual int can_load_lazily() const { return FALSE; }
+
     /*
      *   Create an instance of the metaclass with the given ID in
      *   preparation for restoring the object from a saved state file. 
@@ -1388,6 +1493,16 @@ struct obj_fixup_entry
 /* fixup table subarray size */
 #define VMOBJFIXUP_SUB_SIZE 2048
 
+/*
+ *   Direct index density limit.  Once the table is complete, if the range
+ *   of old IDs is no more than this many times the number of entries, we
+ *   build a direct index from old ID to new ID, so that translating an ID
+ *   is a single array lookup rather than a binary search.  The saved state
+ *   table of contents usually covers a nearly contiguous block of IDs, so
+ *   this is the normal case; sparse tables keep using the binary search.  
+ */
+#define VMOBJFIXUP_DIRECT_DENSITY 4
+
 class CVmObjFixup
 {
 public:
@@ -1421,6 +1536,9 @@ private:
     /* find an entry given the old object ID */
     struct obj_fixup_entry *find_entry(vm_obj_id_t old_entry);
 
+    /* build the direct index, if the table is dense enough */
+    void build_direct();
+
     /* get an entry at the given array index */
     struct obj_fixup_entry *get_entry(ulong idx) const
     {
@@ -1438,6 +1556,15 @@ private:
 
     /* number of entries used so far */
     ulong used_;
+
+    /* 
+     *   Direct index, or null if we don't have one.  Element i gives the
+     *   new ID for old ID direct_base_ + i.  IDs in the range that aren't
+     *   in the table map to themselves, as they do with find_entry().  
+     */
+    vm_obj_id_t *direct_;
+    vm_obj_id_t direct_base_;
+    ulong direct_cnt_;
 };
 
 
@@ -1575,6 +1702,17 @@ struct CVmObjPageEntry
          *   slot is allocated to an object.  
          */
         char obj_[sizeof(CVmObject)];
+
+        /*
+         *   If it's an image file object that hasn't been created yet (see
+         *   lazy_ below), the location of its image data.  The object's
+         *   metaclass registration index is in next_obj_ in this case.  
+         */
+        struct
+        {
+            const char *ptr_;
+            size_t siz_;
+        } image_;
         
         /* 
          *   if it's in the free list, we just have a pointer to the
@@ -1686,6 +1824,26 @@ struct CVmObjPageEntry
     uint can_have_refs_ : 1;
     uint can_have_weak_refs_ : 1;
 
+    /*
+     *   Flag: the object is "clean" for GC purposes.  This is set only for
+     *   a root-set object whose metaclass has a GC write barrier, after a
+     *   trace found that every object it references is itself in the root
+     *   set.  Since root-set objects are always reachable, there's nothing
+     *   to gain by tracing such an object again, so the collector skips it
+     *   until the write barrier clears the flag.  
+     */
+    uint gc_clean_ : 1;
+
+    /*
+     *   Flag: the object was loaded lazily from the image file, and
+     *   hasn't been created yet.  The entry is allocated and in the root
+     *   set, but there's no C++ object in it; ptr_.image_ tells us where
+     *   to find the image data when we need to create the object.  The
+     *   entry is marked as unable to have references, which keeps it out
+     *   of the GC work queue.  
+     */
+    uint lazy_ : 1;
+
     /* 
      *   An entry is deletable if it's unreachable and has been finalized.
      *   If the entry is marked as free, it's already been deleted, hence
@@ -1732,7 +1890,7 @@ struct CVmObjPageEntry
                 && !transient_
                 && reachable_ == VMOBJ_REACHABLE
                 && (!in_root_set_
-                    || get_vm_obj()->is_changed_since_load()));
+                    || (!lazy_ && get_vm_obj()->is_changed_since_load())));
     }
 
     /*
@@ -1749,6 +1907,88 @@ struct CVmObjPageEntry
     }
 };
 
+/*
+ *   Object table page summary.  Alongside each page of entries, we keep a
+ *   pair of bitmaps with one bit per entry, so that the garbage collector's
+ *   sweep can find the entries it has to look at without reading the
+ *   entries themselves.  An entry is 24 bytes or more, so a scan of the
+ *   entries touches a cache line for every two or three objects, while a
+ *   32-bit word of the bitmap covers 32 objects; in particular, a run of
+ *   free entries or root-set objects costs next to nothing to skip.  
+ */
+const unsigned int VM_OBJ_PAGE_BITS_WORDS = VM_OBJ_PAGE_CNT / 32;
+struct CVmObjPageBits
+{
+    /* the entry is in use (not free) */
+    uint32_t used_[VM_OBJ_PAGE_BITS_WORDS];
+
+    /* the entry is in use and is not in the root set */
+    uint32_t nonroot_[VM_OBJ_PAGE_BITS_WORDS];
+
+    /* test the bits for the entry at index 'j' within the page */
+    int test_used(size_t j) const
+        { return (used_[j >> 5] & ((uint32_t)1 << (j & 31))) != 0; }
+    int test_nonroot(size_t j) const
+        { return (nonroot_[j >> 5] & ((uint32_t)1 << (j & 31))) != 0; }
+};
+
+/*
+ *   Garbage collector statistics.  The object table keeps these up to date
+ *   on every pass, so that a program (through the t3vmTEST function set) or
+ *   the host can monitor the collector's behavior.  All times are in
+ *   milliseconds and all sizes are in bytes of variable-size heap space.  
+ */
+struct vm_gc_stats
+{
+    /* number of passes completed */
+    ulong passes;
+
+    /* total and longest pause, up to the point of running finalizers */
+    ulong total_pause_ms;
+    ulong max_pause_ms;
+
+    /* total objects deleted and heap bytes released */
+    ulong objs_freed;
+    ulong bytes_freed;
+
+    /* number of objects and heap bytes that survived the last pass */
+    ulong live_objs;
+    ulong live_bytes;
+
+    /* the heap high-water mark */
+    ulong peak_bytes;
+
+    /* objects currently awaiting finalization (filled in on request) */
+    ulong finalize_queue_len;
+
+    /* 
+     *   undo log bytes in use, the undo log's memory budget, and the number
+     *   of savepoints currently held (filled in on request) 
+     */
+    ulong undo_bytes;
+    ulong undo_budget;
+    ulong undo_savepts;
+};
+
+/*
+ *   Heap census entry: the live objects of one metaclass, and the memory
+ *   they use.  See CVmObjTable::heap_census().  
+ */
+struct vm_heap_census
+{
+    /* the metaclass */
+    class CVmMetaclass *meta;
+
+    /* number of live objects */
+    ulong objs;
+
+    /* 
+     *   bytes in use - the object table entries, plus the memory each
+     *   object reports through CVmObject::get_mem_usage() 
+     */
+    ulong bytes;
+};
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Object table.
@@ -1781,10 +2021,35 @@ public:
     /* get an object given an object ID */
     inline CVmObject *get_obj(vm_obj_id_t id) const
     {
-        /* get the page entry, and get the object from the entry */
-        return (CVmObject *)&get_entry(id)->ptr_.obj_;
+        /* get the page entry */
+        CVmObjPageEntry *entry = get_entry(id);
+
+        /* if it's a lazy image object, create it now */
+        if (entry->lazy_)
+            return ((CVmObjTable *)this)->create_lazy_obj(id, entry);
+
+        /* get the object from the entry */
+        return (CVmObject *)&entry->ptr_.obj_;
     }
 
+    /* 
+     *   Is the given object a lazily loaded image object that hasn't been
+     *   created yet?  Code that visits every object in the table for
+     *   bookkeeping purposes can use this to skip such objects, rather
+     *   than forcing them into existence. 
+     */
+    int is_obj_lazy(vm_obj_id_t id) const { return get_entry(id)->lazy_; }
+
+    /*
+     *   Enable or disable lazy loading of image file objects.  When this is
+     *   enabled, the image loader defers creating instances of metaclasses
+     *   that allow it (see CVmMetaclass::can_load_lazily()) until each
+     *   object is first used.  This must be set before the image is
+     *   loaded.  It's off by default.  
+     */
+    void set_lazy_load(int enable) { lazy_load_ = (enable != 0); }
+    int is_lazy_load() const { return lazy_load_; }
+
     /*
      *   Turn garbage collection on or off.  When performing a series of
      *   allocations of values that won't be stored on the stack, this can
@@ -1794,6 +2059,47 @@ public:
      */
     int enable_gc(VMG_ int enable);
 
+    /*
+     *   Set the target pause time for a garbage collection pass, in
+     *   milliseconds.  The collector uses this to decide how much
+     *   allocation to allow between passes.  Zero or less selects the
+     *   default. 
+     */
+    void set_gc_pause_budget(long ms)
+        { gc_pause_budget_ms_ = (ms > 0 ? ms : VM_GC_DEFAULT_PAUSE_MS); }
+
+    /*
+     *   Enable or disable heap compaction.  When enabled, a background
+     *   pass (see gc_bg_step()) compacts the variable heap after sweeping,
+     *   since that's a point where no native code can be holding a pointer
+     *   into an object's extension.  Compaction is enabled by default. 
+     */
+    void set_gc_compact(int enable) { gc_compact_ = (enable != 0); }
+
+    /* get the garbage collector statistics */
+    void get_gc_stats(VMG_ vm_gc_stats *stats) const;
+
+    /*
+     *   Take a census of the live objects by metaclass.  Returns a new
+     *   array, allocated with t3malloc() (the caller must t3free() it),
+     *   with one entry per metaclass that has any live objects, and fills
+     *   in '*cnt' with the number of entries.  Objects from the image file
+     *   that haven't been loaded yet aren't counted.  
+     */
+    vm_heap_census *heap_census(VMG_ size_t *cnt) const;
+
+    /* write a heap census to the garbage collection log */
+    void log_heap_census(VMG0_);
+
+    /*
+     *   Open a garbage collection log.  If a log is open, we write a line
+     *   of statistics to it at the end of each pass, and a heap census
+     *   (see heap_census()) when the VM shuts down.  'fname' can be null,
+     *   in which case we do nothing.  The log is closed when the table is
+     *   deleted.  
+     */
+    void open_gc_log(const char *fname);
+
     /* allocate a new object ID */
     vm_obj_id_t alloc_obj(VMG_ int in_root_set)
     {
@@ -1822,6 +2128,16 @@ public:
     void alloc_obj_with_id(vm_obj_id_t id, int in_root_set,
                            int can_have_refs, int can_have_weak_refs);
 
+    /*
+     *   Allocate a lazily loaded image file object with the given ID.  This
+     *   allocates the entry as a root-set object, but doesn't create the
+     *   object; instead, we remember the metaclass (by registration table
+     *   index) and the location of the image data, and create the object
+     *   the first time get_obj() is called for it.  
+     */
+    void alloc_lazy_obj_with_id(vm_obj_id_t id, uint meta_reg_idx,
+                                const char *ptr, size_t siz);
+
     /* 
      *   Collect all garbage.  This runs an entire garbage collection pass
      *   to completion with a single call.  This can be used for
@@ -1859,6 +2175,30 @@ public:
     int  gc_pass_continue(VMG0_) { return gc_pass_continue(vmg_ TRUE); }
     void gc_pass_finish(VMG0_);
 
+    /*
+     *   Background garbage collection.  This lets the host application do
+     *   garbage collection work while the VM is blocked waiting for
+     *   something external, such as user input, so that the work doesn't
+     *   interrupt execution later.
+     *   
+     *   gc_bg_step() does one increment of work, starting a new pass if
+     *   necessary, and returns true if there's more work to do.  The
+     *   marking phase proceeds a slice at a time; when it completes, we
+     *   sweep the unreachable objects, and then (in a separate step)
+     *   compact the variable heap, if enabled, but we leave the finalizers
+     *   for gc_bg_finish(), since those run byte code.  If nothing has been
+     *   allocated since the last pass, there's nothing to collect, so we
+     *   don't start a new one.
+     *   
+     *   Since the VM is blocked, nothing can change any object while the
+     *   pass is in progress, so the mark phase sees a consistent snapshot
+     *   of the heap without needing a write barrier.  The flip side is that
+     *   the host MUST call gc_bg_finish() before returning control to the
+     *   VM, to complete any pass in progress.  
+     */
+    int  gc_bg_step(VMG0_);
+    void gc_bg_finish(VMG0_);
+
     /*
      *   Run pending finalizers.  This can be run at any time other than
      *   during garbage collection (i.e., between gc_pass_init() and
@@ -2022,7 +2362,26 @@ public:
      *   the objects to which it refers as referenced.  
      */
     void mark_all_refs(vm_obj_id_t obj, uint state)
-        { add_to_gc_queue(obj, state); }
+    {
+        CVmObjPageEntry *entry = get_entry(obj);
+
+        /* note if the object we're tracing refers outside the root set */
+        if (!entry->in_root_set_)
+            gc_trace_nonroot_ = TRUE;
+
+        /* queue the object */
+        add_to_gc_queue(obj, entry, state);
+    }
+
+    /*
+     *   GC write barrier.  A metaclass that overrides
+     *   has_gc_write_barrier() to return true must call this whenever an
+     *   instance might have acquired a reference to an object that's not
+     *   in the root set.  This ensures that the collector traces the object
+     *   on the next pass. 
+     */
+    void gc_write_barrier(vm_obj_id_t obj)
+        { get_entry(obj)->gc_clean_ = FALSE; }
 
     /*
      *   Receive notification from the undo manager that we're starting a
@@ -2231,6 +2590,31 @@ private:
     {
         return &pages_[id >> VM_OBJ_PAGE_CNT_LOG2][id & (VM_OBJ_PAGE_CNT - 1)];
     }
+
+    /* note in the page summary that an entry is now in use */
+    void set_page_bits(vm_obj_id_t id, int in_root_set)
+    {
+        CVmObjPageBits *bits = page_bits_[id >> VM_OBJ_PAGE_CNT_LOG2];
+        size_t w = (id & (VM_OBJ_PAGE_CNT - 1)) >> 5;
+        uint32_t b = (uint32_t)1 << (id & 31);
+
+        bits->used_[w] |= b;
+        if (in_root_set)
+            bits->nonroot_[w] &= ~b;
+        else
+            bits->nonroot_[w] |= b;
+    }
+
+    /* note in the page summary that an entry is now free */
+    void clear_page_bits(vm_obj_id_t id)
+    {
+        CVmObjPageBits *bits = page_bits_[id >> VM_OBJ_PAGE_CNT_LOG2];
+        size_t w = (id & (VM_OBJ_PAGE_CNT - 1)) >> 5;
+        uint32_t b = (uint32_t)1 << (id & 31);
+
+        bits->used_[w] &= ~b;
+        bits->nonroot_[w] &= ~b;
+    }
     
     /* delete an entry */
     void delete_entry(VMG_ vm_obj_id_t id, CVmObjPageEntry *entry);
@@ -2347,6 +2731,19 @@ private:
      */
     void gc_before_alloc(VMG0_);
 
+    /*
+     *   Set the allocation thresholds for the next pass, given the time the
+     *   pass just completed took and the number of objects that survived
+     *   it. 
+     */
+    void gc_adapt_thresholds(long elapsed_ms, ulong survivors);
+
+    /* record the statistics for a pass that just completed its sweep */
+    void gc_record_pass(VMG_ long elapsed_ms, ulong freed, ulong survivors);
+
+    /* count the objects in the finalizer queue */
+    ulong count_finalize_queue() const;
+
     /* garbage collection: trace objects reachable from the stack */
     void gc_trace_stack(VMG0_);
 
@@ -2362,6 +2759,12 @@ private:
     /* continue a GC pass */
     int gc_pass_continue(VMG_ int trace_transient);
 
+    /* 
+     *   finish a GC pass, except for running finalizers: finish tracing,
+     *   identify finalizable objects, and delete unreachable objects 
+     */
+    void gc_pass_sweep(VMG0_);
+
     /* 
      *   set the initial GC conditions for an object -- this puts the
      *   object into the appropriate queue and sets the appropriate
@@ -2388,6 +2791,9 @@ private:
             add_to_gc_queue(id, entry, VMOBJ_REACHABLE);
     }
 
+    /* create a lazily loaded image object on its first use */
+    CVmObject *create_lazy_obj(vm_obj_id_t id, CVmObjPageEntry *entry);
+
     /* hash table of objects requested post_load_init() service */
     class CVmHashTable *post_load_init_table_;
 
@@ -2409,6 +2815,12 @@ private:
      */
     CVmObjPageEntry **pages_;
 
+    /* 
+     *   Page summary table.  This parallels pages_: page_bits_[i] is the
+     *   summary bitmap for pages_[i]. 
+     */
+    CVmObjPageBits **page_bits_;
+
     /* number of page slots allocated, and the number actually used */
     size_t page_slots_;
     size_t pages_used_;
@@ -2428,6 +2840,12 @@ private:
     /* head of garbage collection work queue */
     vm_obj_id_t gc_queue_head_;
 
+    /* 
+     *   flag: the object currently being traced in gc_pass_continue()
+     *   referenced an object outside of the root set 
+     */
+    int gc_trace_nonroot_;
+
     /* head of finalizer queue */
     vm_obj_id_t finalize_queue_head_;
 
@@ -2456,8 +2874,48 @@ private:
     uint max_allocs_between_gc_;
     ulong max_bytes_between_gc_;
 
+    /* target time for a single garbage collection pass, in milliseconds */
+    long gc_pause_budget_ms_;
+
+    /* system clock time at the start of the current gc pass */
+    long gc_pass_start_ms_;
+
+    /* heap bytes in use at the start of the current gc pass */
+    ulong gc_pass_start_bytes_;
+
+    /* cumulative garbage collector statistics */
+    vm_gc_stats gc_totals_;
+
+    /* garbage collection log file, if any */
+    class CVmFile *gc_log_;
+
+    /* 
+     *   background collection state (a VMOBJ_GC_BG_xxx value), and the
+     *   time spent so far on the current background pass 
+     */
+    int gc_bg_state_;
+    long gc_bg_work_ms_;
+
     /* garbage collection enabled */
     uint gc_enabled_ : 1;
+
+    /* compact the variable heap after background passes */
+    uint gc_compact_ : 1;
+
+    /* load image file objects lazily */
+    uint lazy_load_ : 1;
+
+    /* 
+     *   flag: the initial post-load initialization has started, so objects
+     *   we create lazily must be initialized as we create them 
+     */
+    uint post_load_started_ : 1;
+
+    /* 
+     *   the VM globals, for creating lazy objects from get_obj(), which
+     *   doesn't take a globals parameter 
+     */
+    struct vm_globals *lazy_vmg_;
 };
 
 /* ------------------------------------------------------------------------ */
@@ -2581,6 +3039,37 @@ public:
      */
     virtual void free_mem(void *varpart) = 0;
 
+    /*
+     *   Compact the heap.  A heap manager that can tell which of its pages
+     *   are sparsely used may move the extensions of objects that allow it
+     *   (see CVmObject::can_relocate_ext()) into other pages, so that it
+     *   can give the sparse pages back to the system.
+     *
+     *   This may only be called at a point where no native code is holding
+     *   a pointer into any object's extension, which in practice means that
+     *   the VM must be blocked at the top level, as it is while waiting for
+     *   user input.  This routine isn't required to do anything at all.
+     */
+    virtual void compact(VMG0_) { }
+
+    /*
+     *   Get the number of bytes currently allocated to variable parts, and
+     *   the most that has ever been allocated at once.  These count the
+     *   space given out to callers, including any rounding up to block
+     *   sizes, but not the heap manager's own overhead.  A heap manager
+     *   that doesn't keep track can simply return zero.  
+     */
+    virtual ulong get_bytes_in_use() const { return 0; }
+    virtual ulong get_peak_bytes() const { return 0; }
+
+    /* 
+     *   Get the size of a variable-size block, counted the same way as
+     *   get_bytes_in_use().  A heap manager that doesn't keep track can
+     *   return zero.  
+     */
+    virtual size_t get_block_size(const void * /*varpart*/) const
+        { return 0; }
+
 #if 0
     /* 
      *   This is not currently used by the heap implementation (and doesn't
@@ -2606,6 +3095,10 @@ public:
      */
     virtual void finish_gc_pass() = 0;
 #endif
+
+protected:
+    /* get an object's extension pointer, for heap managers that move it */
+    static char *get_obj_ext(CVmObject *obj) { return obj->ext_; }
 };
 
 
@@ -2641,8 +3134,11 @@ public:
     void terminate() { }
 
     /* allocate memory */
-    void *alloc_mem(size_t siz, CVmObject *)
+    void *alloc_mem(size_t siz, CVmObject *obj)
     {
+        /* trace the allocation if desired */
+        VM_IF_ALLOC_TRACE(vm_alloc_trace_mem(siz, obj));
+
         /* allocate space for the block plus the header */
         CVmVarHeapMallocHdr *hdr = (CVmVarHeapMallocHdr *)
               t3malloc(siz + sizeof(CVmVarHeapMallocHdr));
@@ -2655,10 +3151,13 @@ public:
     }
 
     /* reallocate memory */
-    void *realloc_mem(size_t siz, void *varpart, CVmObject *)
+    void *realloc_mem(size_t siz, void *varpart, CVmObject *obj)
     {
         CVmVarHeapMallocHdr *hdr;
 
+        /* trace the allocation if desired */
+        VM_IF_ALLOC_TRACE(vm_alloc_trace_mem(siz, obj));
+
         /* 
          *   get the original header, which immediately precedes the
          *   original variable part in memory 
@@ -2680,6 +3179,10 @@ public:
         return (void *)(hdr + 1);
     }
 
+    /* get a block's size */
+    size_t get_block_size(const void *varpart) const
+        { return (((const CVmVarHeapMallocHdr *)varpart) - 1)->siz_; }
+
     /* free memory */
     void free_mem(void *varpart)
     {
@@ -2741,6 +3244,30 @@ struct CVmVarHeapHybrid_hdr
     IF_GC_STATS(size_t siz;)
 };
 
+/*
+ *   Hybrid heap usage counter.  The heap manager owns one of these, and
+ *   each sub-block manager adds and removes the space it gives out.  
+ */
+struct CVmVarHeapHybrid_usage
+{
+    CVmVarHeapHybrid_usage() { cur = peak = 0; }
+
+    /* count space allocated */
+    void add(size_t siz)
+    {
+        cur += siz;
+        if (cur > peak)
+            peak = cur;
+    }
+
+    /* count space released */
+    void sub(size_t siz) { cur -= siz; }
+
+    /* current and peak bytes in use */
+    ulong cur;
+    ulong peak;
+};
+
 /*
  *   Hybrid heap allocator - sub-block interface.  Each small-object cell
  *   list is represented by one of these objects, as is the fallback
@@ -2757,6 +3284,9 @@ public:
     /* free memory */
     virtual void free(struct CVmVarHeapHybrid_hdr *) = 0;
 
+    /* get the space a block takes, as counted in the heap's usage */
+    virtual size_t get_size(const struct CVmVarHeapHybrid_hdr *) const = 0;
+
     /*
      *   Reallocate memory.  If necessary, allocate new memory, copy the
      *   data to the new memory, and delete the old memory.  We receive
@@ -2771,34 +3301,53 @@ public:
 };
 
 /*
- *   Malloc suballocator 
+ *   Malloc suballocator.  Since the system heap doesn't tell us how big a
+ *   block is, we store each block's total size in a prefix ahead of the
+ *   header, so that we can keep the usage count up to date when the block
+ *   is freed or resized.  
  */
 class CVmVarHeapHybrid_malloc: public CVmVarHeapHybrid_block
 {
 public:
+    CVmVarHeapHybrid_malloc(CVmVarHeapHybrid_usage *usage)
+        { usage_ = usage; }
+
     /* allocate memory */
     virtual struct CVmVarHeapHybrid_hdr *alloc(size_t siz)
     {
         CVmVarHeapHybrid_hdr *ptr;
+        char *p;
         
-        /* adjust the size to add in the required header */
-        siz = osrndsz(siz + sizeof(CVmVarHeapHybrid_hdr));
+        /* adjust the size to add in the required header and prefix */
+        siz = osrndsz(siz + sizeof(CVmVarHeapHybrid_hdr)) + prefix_size();
         
         /* allocate directly via the default system heap manager */
-        ptr = (CVmVarHeapHybrid_hdr *)t3malloc(siz);
+        p = (char *)t3malloc(siz);
 
-        /* fill in the header */
+        /* fill in the prefix and the header */
+        *(size_t *)p = siz;
+        ptr = (CVmVarHeapHybrid_hdr *)(p + prefix_size());
         ptr->block = this;
 
+        /* count it */
+        usage_->add(siz);
+
         /* return the new block */
         return ptr;
     }
 
+    /* get a block's size from its prefix */
+    virtual size_t get_size(const CVmVarHeapHybrid_hdr *mem) const
+        { return *get_prefix((CVmVarHeapHybrid_hdr *)mem); }
+
     /* release memory */
     virtual void free(CVmVarHeapHybrid_hdr *mem)
     {
+        /* uncount it */
+        usage_->sub(*get_prefix(mem));
+
         /* release the memory directly to the default system heap manager */
-        t3free(mem);
+        t3free(get_prefix(mem));
     }
 
     /* reallocate memory */
@@ -2806,19 +3355,35 @@ public:
                           CVmObject *)
     {
         CVmVarHeapHybrid_hdr *ptr;
+        char *p;
         
-        /* adjust the new size to add in the required header */
-        siz = osrndsz(siz + sizeof(CVmVarHeapHybrid_hdr));
+        /* adjust the new size to add in the required header and prefix */
+        siz = osrndsz(siz + sizeof(CVmVarHeapHybrid_hdr)) + prefix_size();
 
-        /* reallocate the block */
-        ptr = (CVmVarHeapHybrid_hdr *)t3realloc(mem, siz);
+        /* reallocate the block, counting the change in size */
+        usage_->sub(*get_prefix(mem));
+        p = (char *)t3realloc(get_prefix(mem), siz);
+        usage_->add(siz);
 
-        /* fill in the header in the new block */
+        /* fill in the prefix and the header in the new block */
+        *(size_t *)p = siz;
+        ptr = (CVmVarHeapHybrid_hdr *)(p + prefix_size());
         ptr->block = this;
 
         /* return the caller-visible part of the new block */
         return (void *)(ptr + 1);
     }
+
+private:
+    /* size of the size prefix, rounded to keep the block aligned */
+    static size_t prefix_size() { return osrndsz(sizeof(size_t)); }
+
+    /* get the size prefix for a block */
+    static size_t *get_prefix(CVmVarHeapHybrid_hdr *mem)
+        { return (size_t *)((char *)mem - prefix_size()); }
+
+    /* the heap's usage counter */
+    CVmVarHeapHybrid_usage *usage_;
 };
 
 /*
@@ -2829,6 +3394,8 @@ public:
  */
 class CVmVarHeapHybrid_head: public CVmVarHeapHybrid_block
 {
+    friend class CVmVarHeapHybrid;
+
 public:
     CVmVarHeapHybrid_head(class CVmVarHeapHybrid *mem_mgr,
                           size_t cell_size, size_t page_count)
@@ -2842,6 +3409,10 @@ public:
 
         /* we have nothing in our free list yet */
         first_free_ = 0;
+
+        /* no statistics yet */
+        IF_GC_STATS(st_allocs_ = st_frees_ = st_pages_ = 0);
+        IF_GC_STATS(st_cur_cells_ = st_peak_cells_ = st_cur_bytes_ = 0);
     }
     
     /* allocate an object from my pool, expanding the pool if necessary */
@@ -2850,6 +3421,10 @@ public:
     /* free a cell */
     void free(CVmVarHeapHybrid_hdr *mem);
 
+    /* every block in this manager is one cell */
+    virtual size_t get_size(const CVmVarHeapHybrid_hdr *) const
+        { return cell_size_; }
+
     /* reallocate */
     virtual void *realloc(struct CVmVarHeapHybrid_hdr *mem, size_t siz,
                           class CVmObject *obj);
@@ -2857,6 +3432,28 @@ public:
     /* get the cell size for this cell manager */
     size_t get_cell_size() const { return cell_size_; }
 
+    /* get the size of a cell including its header */
+    size_t get_real_cell_size() const
+        { return osrndsz(cell_size_ + osrndsz(sizeof(CVmVarHeapHybrid_hdr))); }
+
+#ifdef VMOBJ_GC_STATS
+    /* display statistics for this size class */
+    void display_stats() const;
+
+    /* 
+     *   Statistics: total allocations and frees, pages allocated, cells
+     *   currently in use and peak cells in use, and requested bytes in the
+     *   cells currently in use (the difference between this and the cell
+     *   space in use is the internal fragmentation for the class) 
+     */
+    long st_allocs_;
+    long st_frees_;
+    long st_pages_;
+    long st_cur_cells_;
+    long st_peak_cells_;
+    long st_cur_bytes_;
+#endif
+
 private:
     /* size of each cell in the array */
     size_t cell_size_;
@@ -2880,6 +3477,9 @@ struct CVmVarHeapHybrid_array
     /* next array in the master list */
     CVmVarHeapHybrid_array *next_array;
 
+    /* the cell heap that owns this array */
+    class CVmVarHeapHybrid_head *head;
+
     /* 
      *   memory for allocation (we over-allocate the structure to make
      *   room for some number of our fixed-size cells) 
@@ -2887,6 +3487,13 @@ struct CVmVarHeapHybrid_array
     char mem[1];
 };
 
+/*
+ *   Largest cell size, and the granularity of the size class map.  Blocks
+ *   larger than VMVH_CELL_MAX go to the malloc heap.  
+ */
+const size_t VMVH_CELL_MAX = 4096;
+const size_t VMVH_CELL_GRAN = 16;
+
 /*
  *   heap implementation 
  */
@@ -2913,6 +3520,21 @@ public:
     /* free memory */
     void free_mem(void *varpart);
 
+    /* compact the cell pages */
+    void compact(VMG0_);
+
+    /* get the current and peak usage */
+    ulong get_bytes_in_use() const { return usage_.cur; }
+    ulong get_peak_bytes() const { return usage_.peak; }
+
+    /* get a block's size from the sub-block manager that allocated it */
+    size_t get_block_size(const void *varpart) const
+    {
+        const CVmVarHeapHybrid_hdr *hdr =
+            ((const CVmVarHeapHybrid_hdr *)varpart) - 1;
+        return hdr->block->get_size(hdr);
+    }
+
 #if 0
     /* removed with the removal of move_var_part() */
     
@@ -2925,6 +3547,10 @@ public:
 #endif
     
 private:
+    /* object table enumeration callbacks for compact() */
+    static void compact_count_cb(VMG_ vm_obj_id_t id, void *ctx);
+    static void compact_move_cb(VMG_ vm_obj_id_t id, void *ctx);
+
     /* 
      *   Head of list of arrays.  We keep this list so that we can delete
      *   all of the arrays when we delete this heap manager object itself.
@@ -2941,6 +3567,14 @@ private:
     /* number of cell heap managers */
     size_t cell_heap_cnt_;
 
+    /*
+     *   Size class map.  Element i points to the smallest cell heap whose
+     *   cells hold at least i*VMVH_CELL_GRAN bytes, so that we can find the
+     *   best fit for a request with a simple table lookup rather than by
+     *   searching the cell heap list.  
+     */
+    CVmVarHeapHybrid_head *size_map_[VMVH_CELL_MAX/VMVH_CELL_GRAN + 1];
+
     /*
      *   Our fallback malloc heap manager.  We'll use this allocator for
      *   any blocks that we can't allocate from one of our cell-based
@@ -2948,6 +3582,9 @@ private:
      */
     CVmVarHeapHybrid_malloc *malloc_heap_;
 
+    /* space currently and at most given out by all of the sub-blocks */
+    CVmVarHeapHybrid_usage usage_;
+
     /* object table */
     CVmObjTable *objtab_;
 };
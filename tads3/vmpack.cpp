@@ -314,6 +314,52 @@ struct CVmPackType
 };
 
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Cached parse result for one type code or group modifier list.  The
+ *   type descriptor is the result of parsing without the enclosing group's
+ *   defaults: big_endian is -1 if the item has no '<' or '>' modifier, and
+ *   tilde and pct are set only if the item has its own '~' or '%'.  
+ */
+struct CVmPackParsed
+{
+    /* the parsed type descriptor */
+    CVmPackType t;
+
+    /* template byte offset of the literal text, for '"' and '{' types */
+    size_t lit_ofs;
+
+    /* template byte offset and character index just past the parsed text */
+    size_t end_ofs;
+    int end_idx;
+};
+
+/*
+ *   Parsed template cache entry 
+ */
+struct CVmPackTemplate
+{
+    /* next entry in the cache's MRU list */
+    CVmPackTemplate *nxt;
+
+    /* our copy of the template text, its length, and its hash value */
+    char *fmt;
+    size_t len;
+    uint hash;
+
+    /* number of pack/unpack calls using the entry */
+    int refs;
+
+    /* 
+     *   Parse results, indexed by the template byte offset of the type code
+     *   or group open paren.  An entry is null if we haven't parsed that
+     *   position yet.  
+     */
+    CVmPackParsed **types;
+    CVmPackParsed **groups;
+};
+
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Pack string group.  This represents a ( ) group within the string.  The
@@ -324,10 +370,13 @@ struct CVmPackType
 struct CVmPackGroup
 {
     /* set up the defaults for the root group */
-    CVmPackGroup(CVmPackPos *pos, CVmDataSource *ds)
+    CVmPackGroup(CVmPackPos *pos, CVmDataSource *ds,
+                 struct CVmPackTemplate *tpl)
         : start(pos)
     {
         this->ds = ds;
+        this->tpl = tpl;
+        fmt_base = pos->p.getptr();
         parent = 0;
         big_endian = FALSE;
         tilde = FALSE;
@@ -345,6 +394,8 @@ struct CVmPackGroup
         : parent(parent), start(pos)
     {
         ds = parent->ds;
+        tpl = parent->tpl;
+        fmt_base = parent->fmt_base;
         stream_ofs = ds->get_pos();
         cur_iter = 1;
         big_endian = t->big_endian;
@@ -392,6 +443,14 @@ struct CVmPackGroup
     /* data stream */
     CVmDataSource *ds;
 
+    /* 
+     *   parsed template cache entry, or null if we're not caching, and the
+     *   start of the template string (which the cached offsets are
+     *   relative to) 
+     */
+    struct CVmPackTemplate *tpl;
+    const char *fmt_base;
+
     /* 
      *   Group starting offset in the data stream.  Each iteration of a group
      *   resets the zero point for '@' codes within the group. 
@@ -427,9 +486,11 @@ CVmPackType::CVmPackType(const CVmPackGroup *g)
     count = ITER_NONE;
     count_as_type = 0;
     count_in_bytes = FALSE;
+    up_to_count = FALSE;
     bang = FALSE;
     qu = FALSE;
     null_term = FALSE;
+    fmtidx = 0;
 
     /* inherit group attributes */
     big_endian = g->big_endian;
@@ -600,23 +661,36 @@ void CVmPack::pack(VMG_ int arg_index, int argc, CVmDataSource *dst)
     size_t fmtlen = vmb_get_len(fmt);
     fmt += VMB_LEN;
 
-    /* pack the root group */
-    CVmPackPos p(fmt, fmtlen);
-    CVmPackGroup root(&p, dst);
-    StackArgs args(vmg_ arg_index + 1, argc - 1);
-    pack_group(vmg_ &p, &args, &root, FALSE);
+    /* look up the parsed template in the cache */
+    CVmPackTemplate *tpl = G_pack_cache->get(fmt, fmtlen);
 
-    /* make sure we exhausted the string */
-    if (p.more())
-        err_throw_a(VMERR_PACK_PARSE, 1, ERR_TYPE_INT, p.index());
+    err_try
+    {
+        /* pack the root group */
+        CVmPackPos p(fmt, fmtlen);
+        CVmPackGroup root(&p, dst, tpl);
+        StackArgs args(vmg_ arg_index + 1, argc - 1);
+        pack_group(vmg_ &p, &args, &root, FALSE);
 
-    /* 
-     *   if we didn't consume all of the arguments, it means that the format
-     *   string didn't have enough entries for the supplied arguments - flag
-     *   an error 
-     */
-    if (args.more())
-        err_throw_a(VMERR_PACK_ARGC_MISMATCH, 1, ERR_TYPE_INT, (int)fmtlen+1);
+        /* make sure we exhausted the string */
+        if (p.more())
+            err_throw_a(VMERR_PACK_PARSE, 1, ERR_TYPE_INT, p.index());
+
+        /* 
+         *   if we didn't consume all of the arguments, it means that the
+         *   format string didn't have enough entries for the supplied
+         *   arguments - flag an error 
+         */
+        if (args.more())
+            err_throw_a(VMERR_PACK_ARGC_MISMATCH, 1, ERR_TYPE_INT,
+                        (int)fmtlen+1);
+    }
+    err_finally
+    {
+        /* done with the cached template */
+        G_pack_cache->release(tpl);
+    }
+    err_end;
 }
 
 /*
@@ -773,7 +847,7 @@ void CVmPack::pack_subgroup(VMG_ CVmPackPos *p, CVmPackArgs *args,
     
     /* parse the group modifiers */
     CVmPackType gt(group);
-    parse_group_mods(p, &gt);
+    parse_group_mods(p, &gt, group);
 
     /* note the open paren */
     wchar_t paren = p->getch();
@@ -2476,14 +2550,26 @@ void CVmPack::unpack(VMG_ vm_val_t *retval, const char *fmt, size_t fmtlen,
     /* we don't have any elements in our list yet */
     int retcnt = 0;
 
-    /* unpack the root group */
-    CVmPackPos p(fmt, fmtlen);
-    CVmPackGroup root(&p, src);
-    unpack_group(vmg_ &p, retlst, &retcnt, &root, FALSE);
+    /* look up the parsed template in the cache */
+    CVmPackTemplate *tpl = G_pack_cache->get(fmt, fmtlen);
 
-    /* make sure we made it all the way through the format string */
-    if (p.more())
-        err_throw_a(VMERR_PACK_PARSE, 1, ERR_TYPE_INT, p.index());
+    err_try
+    {
+        /* unpack the root group */
+        CVmPackPos p(fmt, fmtlen);
+        CVmPackGroup root(&p, src, tpl);
+        unpack_group(vmg_ &p, retlst, &retcnt, &root, FALSE);
+
+        /* make sure we made it all the way through the format string */
+        if (p.more())
+            err_throw_a(VMERR_PACK_PARSE, 1, ERR_TYPE_INT, p.index());
+    }
+    err_finally
+    {
+        /* done with the cached template */
+        G_pack_cache->release(tpl);
+    }
+    err_end;
 
     /* set the return list's final length */
     retlst->cons_set_len(retcnt);
@@ -2633,7 +2719,7 @@ void CVmPack::unpack_subgroup(VMG_ CVmPackPos *p,
 {
     /* group - parse the group modifiers */
     CVmPackType gt(group);
-    parse_group_mods(p, &gt);
+    parse_group_mods(p, &gt, group);
 
     /* note the open paren type */
     wchar_t paren = p->getch();
@@ -3188,6 +3274,44 @@ void CVmPack::unpack_item(VMG_ vm_val_t *val,
  */
 void CVmPack::parse_type(CVmPackPos *p, CVmPackType *info,
                          const CVmPackGroup *group)
+{
+    /* if we've parsed this item before, use the cached result */
+    size_t ofs;
+    CVmPackParsed *pr = find_parsed(group, p, FALSE, &ofs);
+    if (pr != 0)
+    {
+        /* copy the cached descriptor, and point its literal into our copy */
+        *info = pr->t;
+        if (info->type_code == '"' || info->type_code == '{')
+            info->lit.p.set((char *)group->fmt_base + pr->lit_ofs);
+
+        /* skip past the parsed text */
+        p->p.set((char *)group->fmt_base + pr->end_ofs);
+        p->len = group->tpl->len - pr->end_ofs;
+        p->idx = pr->end_idx;
+    }
+    else
+    {
+        /* parse it */
+        parse_type_text(p, info);
+
+        /* cache the result */
+        save_parsed(group, FALSE, ofs, info, p);
+    }
+
+    /* apply the group defaults for modifiers the item didn't specify */
+    if (info->big_endian < 0)
+        info->big_endian = group->big_endian;
+    info->tilde |= group->tilde;
+    info->pct |= group->pct;
+}
+
+/*
+ *   Parse the text of a type code and its modifiers.  This doesn't apply the
+ *   group defaults: we leave big_endian at -1 if there's no '<' or '>'
+ *   modifier, and only set tilde and pct for explicit '~' and '%'.  
+ */
+void CVmPack::parse_type_text(CVmPackPos *p, CVmPackType *info)
 {
     /* get the type code */
     wchar_t c = p->nextch();
@@ -3260,9 +3384,9 @@ void CVmPack::parse_type(CVmPackPos *p, CVmPackType *info,
     }
 
     /* set the default modifiers */
-    info->big_endian = group->big_endian;
-    info->tilde = group->tilde;
-    info->pct = group->pct;
+    info->big_endian = -1;
+    info->tilde = FALSE;
+    info->pct = FALSE;
     info->count = ITER_NONE;
     info->count_as_type = 0;
     info->count_in_bytes = FALSE;
@@ -3277,13 +3401,92 @@ void CVmPack::parse_type(CVmPackPos *p, CVmPackType *info,
  *   Parse group modifiers.  Call this at the open parenthesis of a group to
  *   find the matching close paren and parse the suffix qualifiers.  
  */
-void CVmPack::parse_group_mods(const CVmPackPos *p, CVmPackType *gt)
+void CVmPack::parse_group_mods(const CVmPackPos *p, CVmPackType *gt,
+                               const CVmPackGroup *group)
 {
     /* set up a copy of the pointer, so we don't alter the original */
     CVmPackPos p2(p);
 
-    /* parse and skip the group and modifiers */
-    skip_group_mods(&p2, gt);
+    /* 
+     *   If we've parsed this group before, use the cached result.
+     *   Otherwise, parse and skip the group and modifiers, starting without
+     *   the parent group defaults, so that we can cache the result.  This
+     *   saves a scan for the end of the group every time we enter it.  
+     */
+    size_t ofs;
+    CVmPackParsed *pr = find_parsed(group, &p2, TRUE, &ofs);
+    CVmPackType t;
+    if (pr != 0)
+    {
+        /* use the cached descriptor */
+        t = pr->t;
+    }
+    else
+    {
+        /* parse it */
+        t.big_endian = -1;
+        skip_group_mods(&p2, &t);
+
+        /* cache the result */
+        save_parsed(group, TRUE, ofs, &t, &p2);
+    }
+
+    /* apply the parent group defaults for anything not specified */
+    if (t.big_endian < 0)
+        t.big_endian = group->big_endian;
+    t.tilde |= group->tilde;
+    t.pct |= group->pct;
+
+    /* return the result */
+    *gt = t;
+}
+
+/*
+ *   Look up a cached parse result 
+ */
+CVmPackParsed *CVmPack::find_parsed(const CVmPackGroup *group,
+                                    CVmPackPos *p, int is_group,
+                                    size_t *ofs)
+{
+    /* if we're not caching this template, there's nothing to find */
+    CVmPackTemplate *tpl = group->tpl;
+    if (tpl == 0)
+        return 0;
+
+    /* 
+     *   skip any spaces, so that the offset identifies the item itself, and
+     *   get the offset 
+     */
+    p->getch();
+    *ofs = (size_t)(p->p.getptr() - group->fmt_base);
+
+    /* look up the entry */
+    return (is_group ? tpl->groups : tpl->types)[*ofs];
+}
+
+/*
+ *   Save a parse result in the cache 
+ */
+void CVmPack::save_parsed(const CVmPackGroup *group, int is_group,
+                          size_t ofs, const CVmPackType *t,
+                          const CVmPackPos *endp)
+{
+    /* if we're not caching this template, there's nothing to do */
+    CVmPackTemplate *tpl = group->tpl;
+    if (tpl == 0)
+        return;
+
+    /* create the entry */
+    CVmPackParsed *pr = new CVmPackParsed();
+    pr->t = *t;
+    pr->lit_ofs = 0;
+    if (!is_group && (t->type_code == '"' || t->type_code == '{'))
+        pr->lit_ofs = (size_t)(t->lit.p.getptr() - group->fmt_base);
+    pr->end_ofs = (size_t)(endp->p.getptr() - group->fmt_base);
+    pr->end_idx = endp->idx;
+
+    /* store it */
+    (is_group ? tpl->groups : tpl->types)[ofs] = pr;
 }
 
 /*
@@ -3537,3 +3740,157 @@ void CVmPack::parse_mods(CVmPackPos *p, CVmPackType *t)
         }
     }
 }
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Parsed template cache 
+ */
+
+/*
+ *   delete a template cache entry 
+ */
+static void delete_pack_template(CVmPackTemplate *tpl)
+{
+    /* delete the parse results */
+    for (size_t i = 0 ; i < tpl->len ; ++i)
+    {
+        delete tpl->types[i];
+        delete tpl->groups[i];
+    }
+
+    /* delete the tables, the text, and the entry itself */
+    t3free(tpl->types);
+    t3free(tpl->groups);
+    t3free(tpl->fmt);
+    t3free(tpl);
+}
+
+/*
+ *   construction 
+ */
+CVmPackCache::CVmPackCache()
+{
+    head_ = 0;
+    cnt_ = 0;
+}
+
+/*
+ *   destruction 
+ */
+CVmPackCache::~CVmPackCache()
+{
+    while (head_ != 0)
+    {
+        CVmPackTemplate *nxt = head_->nxt;
+        delete_pack_template(head_);
+        head_ = nxt;
+    }
+}
+
+/*
+ *   Find or create the entry for a template 
+ */
+CVmPackTemplate *CVmPackCache::get(const char *fmt, size_t len)
+{
+    CVmPackTemplate *tpl;
+    CVmPackTemplate *prv;
+    CVmPackTemplate *victim;
+    CVmPackTemplate *victim_prv;
+
+    /* don't bother with empty or very long templates */
+    if (len == 0 || len > VMPACK_CACHE_MAX_LEN)
+        return 0;
+
+    /* compute the hash of the template text */
+    uint hash = 2166136261U;
+    for (size_t i = 0 ; i < len ; ++i)
+        hash = (hash ^ (uchar)fmt[i]) * 16777619U;
+
+    /* 
+     *   look for an existing entry, noting the last unreferenced entry
+     *   along the way, in case we need to evict one 
+     */
+    for (tpl = head_, prv = 0, victim = victim_prv = 0 ; tpl != 0 ;
+         prv = tpl, tpl = tpl->nxt)
+    {
+        if (tpl->hash == hash && tpl->len == len
+            && memcmp(tpl->fmt, fmt, len) == 0)
+        {
+            /* found it - move it to the head of the list */
+            if (prv != 0)
+            {
+                prv->nxt = tpl->nxt;
+                tpl->nxt = head_;
+                head_ = tpl;
+            }
+
+            /* add the caller's reference and return it */
+            ++tpl->refs;
+            return tpl;
+        }
+
+        /* note the least recently used unreferenced entry */
+        if (tpl->refs == 0)
+        {
+            victim = tpl;
+            victim_prv = prv;
+        }
+    }
+
+    /* if the cache is full, evict the least recently used free entry */
+    if (cnt_ >= VMPACK_CACHE_SIZE)
+    {
+        /* if everything's in use, don't cache this template */
+        if (victim == 0)
+            return 0;
+
+        /* unlink and delete the victim */
+        if (victim_prv != 0)
+            victim_prv->nxt = victim->nxt;
+        else
+            head_ = victim->nxt;
+        delete_pack_template(victim);
+        --cnt_;
+    }
+
+    /* create the new entry */
+    tpl = (CVmPackTemplate *)t3malloc(sizeof(CVmPackTemplate));
+    tpl->fmt = (char *)t3malloc(len);
+    tpl->types = (CVmPackParsed **)t3malloc(len * sizeof(CVmPackParsed *));
+    tpl->groups = (CVmPackParsed **)t3malloc(len * sizeof(CVmPackParsed *));
+    if (tpl->fmt == 0 || tpl->types == 0 || tpl->groups == 0)
+    {
+        /* out of memory - just don't cache it */
+        t3free(tpl->fmt);
+        t3free(tpl->types);
+        t3free(tpl->groups);
+        t3free(tpl);
+        return 0;
+    }
+
+    /* set it up */
+    memcpy(tpl->fmt, fmt, len);
+    memset(tpl->types, 0, len * sizeof(CVmPackParsed *));
+    memset(tpl->groups, 0, len * sizeof(CVmPackParsed *));
+    tpl->len = len;
+    tpl->hash = hash;
+    tpl->refs = 1;
+
+    /* link it in at the head of the list */
+    tpl->nxt = head_;
+    head_ = tpl;
+    ++cnt_;
+
+    /* return it */
+    return tpl;
+}
+
+/*
+ *   Release a reference to an entry 
+ */
+void CVmPackCache::release(CVmPackTemplate *tpl)
+{
+    if (tpl != 0)
+        --tpl->refs;
+}
@@ -112,12 +112,31 @@ protected:
     static void parse_type(struct CVmPackPos *p, struct CVmPackType *info,
                            const struct CVmPackGroup *group);
 
+    /* parse the text of a type code, without applying group defaults */
+    static void parse_type_text(struct CVmPackPos *p,
+                                struct CVmPackType *info);
+
     /* 
      *   parse the suffix modifiers for a group, given a pointer to the
      *   opening parenthesis of the group 
      */
     static void parse_group_mods(const struct CVmPackPos *p,
-                                 struct CVmPackType *gt);
+                                 struct CVmPackType *gt,
+                                 const struct CVmPackGroup *group);
+
+    /* 
+     *   look up a cached parse result for the given template position in
+     *   the type code or group table; returns null if it's not cached 
+     */
+    static struct CVmPackParsed *find_parsed(
+        const struct CVmPackGroup *group, struct CVmPackPos *p,
+        int is_group, size_t *ofs);
+
+    /* cache a parse result for a template position */
+    static void save_parsed(const struct CVmPackGroup *group,
+                            int is_group, size_t ofs,
+                            const struct CVmPackType *t,
+                            const struct CVmPackPos *endp);
 
     /* find the close parenthesis/bracket of a group */
     static void skip_group(struct CVmPackPos *p, wchar_t close_paren);
@@ -129,4 +148,48 @@ protected:
     static void parse_mods(struct CVmPackPos *p, struct CVmPackType *t);
 };
 
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Parsed template cache.  Programs that pack and unpack records in a loop
+ *   tend to use the same few templates over and over, so rather than
+ *   re-parsing a template's type codes and group modifiers on every call,
+ *   we remember each parse result the first time we see it, keyed by the
+ *   template text and the byte offset of the item within it.  Later calls
+ *   with the same template go straight from one item to the next.
+ *   
+ *   Only successful parses are cached, so a template with an error still
+ *   reports the error the same way each time.  
+ */
+
+/* number of templates we cache */
+const size_t VMPACK_CACHE_SIZE = 32;
+
+/* longest template we'll cache */
+const size_t VMPACK_CACHE_MAX_LEN = 1024;
+
+class CVmPackCache
+{
+public:
+    CVmPackCache();
+    ~CVmPackCache();
+
+    /* 
+     *   Find or create the cache entry for a template, and add a reference
+     *   to it; the caller must release() it when done.  Returns null if
+     *   the template can't be cached.  
+     */
+    struct CVmPackTemplate *get(const char *fmt, size_t len);
+
+    /* release a reference to an entry */
+    void release(struct CVmPackTemplate *tpl);
+
+protected:
+    /* head of the entry list, in most-recently-used order */
+    struct CVmPackTemplate *head_;
+
+    /* number of entries in the list */
+    size_t cnt_;
+};
+
 #endif /* VMPACK_H */
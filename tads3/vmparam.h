@@ -124,9 +124,10 @@ Modified
  *   dominate - in other words, since savepoints cost nothing, there is no
  *   point in artificially limiting them.
  *   
- *   An undo record takes up about 16 bytes (on a machine with 32-bit
- *   pointers and 32-bit alignment; this will obviously vary for hardware
- *   with different sizes or alignment requirements).
+ *   The undo log packs each record into only as many bytes as it needs,
+ *   which is typically 12 to 16 bytes for a property change.  The log is
+ *   allocated at VMUNDO_BYTES_PER_REC (16) bytes per record of this limit,
+ *   so the record limit is a nominal, lower-bound figure.
  */
 #ifndef VM_UNDO_MAX_RECORDS
 # define VM_UNDO_MAX_RECORDS  4096
@@ -595,5 +595,98 @@ private:
     void free_backing_pages();
 };
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Demand-loaded pool implementation.  This pool doesn't load anything
+ *   when it's attached to the backing store; it just notes the size of
+ *   each page.  A page is loaded the first time something translates an
+ *   address on it, and then stays in memory until we're detached.  Since
+ *   a typical session only runs a fraction of a large program's code,
+ *   this lets startup time and memory use scale with the code and data
+ *   actually used rather than with the size of the image.
+ *   
+ *   Loaded pages never move, so pointers obtained from get_ptr() remain
+ *   valid for as long as the pool is attached, just as with the in-memory
+ *   pools.  
+ */
+class CVmPoolLazy: public CVmPoolPaged
+{
+public:
+    CVmPoolLazy() { }
+
+    /* delete - call our non-virtual terminator */
+    ~CVmPoolLazy() { terminate_nv(); }
+
+    /* terminate */
+    void terminate()
+    {
+        /* call our own non-virtual termination routine */
+        terminate_nv();
+
+        /* inherit our base class handling */
+        CVmPoolPaged::terminate();
+    }
+
+    /* attach to the backing store - notes the page sizes */
+    void attach_backing_store(class CVmPoolBackingStore *backing_store);
+
+    /* detach from the backing store */
+    void detach_backing_store();
+
+    /* 
+     *   translate an address, loading the page if we haven't already 
+     */
+    inline const char *get_ptr(pool_ofs_t ofs)
+    {
+        /* get the page, loading it if necessary */
+        CVmPool_pg *pg = &pages_[get_page_for_ofs(ofs)];
+        if (pg->mem == 0)
+            load_page(pg, ofs);
+
+        /* translate the address */
+        return pg->mem + get_ofs_for_ofs(ofs);
+    }
+
+    /* 
+     *   Validate an offset value.  We can tell this from the page sizes we
+     *   noted at attach time, without loading the page.  
+     */
+    inline int validate_ofs(pool_ofs_t ofs)
+    {
+        size_t pg = get_page_for_ofs(ofs);
+        return (pg < page_slots_ && get_ofs_for_ofs(ofs) < pages_[pg].siz);
+    }
+
+    /* get the pool offset given a pointer */
+    inline int get_ofs(const char *p, pool_ofs_t *ofs)
+    {
+        /* check each loaded page */
+        pool_ofs_t page_ofs = 0;
+        for (size_t i = 0 ; i < page_slots_ ; ++i, page_ofs += page_size_)
+        {
+            /* if it's in this page, it's a valid address */
+            const char *mem = pages_[i].mem;
+            if (mem != 0 && p >= mem && p < mem + pages_[i].siz)
+            {
+                *ofs = (p - mem) + page_ofs;
+                return TRUE;
+            }
+        }
+
+        /* didn't find it */
+        return FALSE;
+    }
+
+private:
+    /* load the page containing the given offset */
+    void load_page(CVmPool_pg *pg, pool_ofs_t ofs);
+
+    /* non-virtual termination */
+    void terminate_nv();
+
+    /* free any pages we loaded from the backing store */
+    void free_backing_pages();
+};
+
 #endif /* VMPOOL_H */
 
@@ -0,0 +1,100 @@
+/*
+ *   Please see the accompanying license file, LICENSE.TXT, for information
+ *   on using and copying this software.
+ */
+/*
+Name
+  vmpoollz.cpp - demand-loaded memory pool
+Function
+  Implements the demand-loaded pool, which loads each page from the
+  backing store the first time the page is accessed.
+Notes
+  
+Modified
+  10/14/26  - Creation
+*/
+
+#include <stdlib.h>
+#include <memory.h>
+
+#include "t3std.h"
+#include "vmerr.h"
+#include "vmpool.h"
+
+/*
+ *   attach to the backing store 
+ */
+void CVmPoolLazy::attach_backing_store(CVmPoolBackingStore *backing_store)
+{
+    size_t i;
+    pool_ofs_t ofs;
+
+    /* inherit default handling - this sets up the (empty) page list */
+    CVmPoolPaged::attach_backing_store(backing_store);
+
+    /* 
+     *   Note the size of each page, so that we can validate offsets without
+     *   loading anything.  Don't load any pages yet - we'll load each one
+     *   the first time it's used.  
+     */
+    for (i = 0, ofs = 0 ; i < page_slots_ ; ++i, ofs += page_size_)
+        pages_[i].siz = backing_store_->vmpbs_get_page_size(ofs, page_size_);
+}
+
+/*
+ *   load a page on first use 
+ */
+void CVmPoolLazy::load_page(CVmPool_pg *pg, pool_ofs_t ofs)
+{
+    /* if there's no data on this page, it's an invalid reference */
+    if (pg->siz == 0)
+        err_throw(VMERR_LOAD_UNDEF_PAGE);
+
+    /* load the page from the backing store */
+    pg->mem = backing_store_->vmpbs_alloc_and_load_page(
+        get_page_start_ofs(get_page_for_ofs(ofs)), page_size_, pg->siz);
+}
+
+/*
+ *   detach from the backing store 
+ */
+void CVmPoolLazy::detach_backing_store()
+{
+    /* free the pages we loaded */
+    free_backing_pages();
+
+    /* inherit default */
+    CVmPoolPaged::detach_backing_store();
+}
+
+/*
+ *   non-virtual termination 
+ */
+void CVmPoolLazy::terminate_nv()
+{
+    /* free the pages we loaded */
+    free_backing_pages();
+}
+
+/*
+ *   free the pages we loaded from the backing store 
+ */
+void CVmPoolLazy::free_backing_pages()
+{
+    size_t i;
+    pool_ofs_t ofs;
+
+    /* if we don't have a backing store, there's nothing to free */
+    if (backing_store_ == 0 || pages_ == 0)
+        return;
+
+    /* free each page we loaded */
+    for (i = 0, ofs = 0 ; i < page_slots_ ; ++i, ofs += page_size_)
+    {
+        if (pages_[i].mem != 0)
+        {
+            backing_store_->vmpbs_free_page(pages_[i].mem, ofs, page_size_);
+            pages_[i].mem = 0;
+        }
+    }
+}
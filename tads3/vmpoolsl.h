@@ -59,11 +59,19 @@ Modified
 #define VM_IF_SWAPPING_POOL(x)
 
 /* 
- *   The non-swapping pool comes in two varieties.  Select the FLAT or PAGED
- *   pool, as desired.  The FLAT pool is slightly faster, but it doesn't have
- *   any dynamic memory capabilities, which are required for the debugger.  
+ *   The non-swapping pool comes in three varieties.  Select the FLAT, LAZY
+ *   or PAGED pool, as desired.  The FLAT pool is slightly faster, but it
+ *   doesn't have any dynamic memory capabilities, which are required for
+ *   the debugger.  The LAZY pool is a PAGED pool that loads each page from
+ *   the image file the first time it's used, rather than loading
+ *   everything at startup.  
  */
-#ifdef VM_FLAT_POOL
+#if defined(VM_LAZY_POOL)
+
+/* select the non-swapped demand-loaded pool */
+#define CVmPool_CLASS CVmPoolLazy
+
+#elif defined(VM_FLAT_POOL)
 
 /* select the non-swapped FLAT pool */
 #define CVmPool_CLASS CVmPoolFlat
@@ -73,7 +81,7 @@ Modified
 /* select the non-swapped PAGED pool */
 #define CVmPool_CLASS CVmPoolInMem
 
-#endif /* VM_FLAT_POOL */
+#endif /* VM_LAZY_POOL, VM_FLAT_POOL */
 
 #endif /* VM_SWAPPING_POOL */
 
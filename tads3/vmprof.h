@@ -54,6 +54,30 @@ Modified
 
 #endif /* VM_PROFILER */
 
+/*
+ *   Opcode statistics.  #define VM_OPSTATS, along with VM_PROFILER, to have
+ *   the interpreter count the opcodes and opcode pairs (bigrams) executed
+ *   in each function while profiling is active.  This is purely a tuning
+ *   aid - it slows down execution considerably, since it has to disable
+ *   threaded dispatch and instruction fusion to see every instruction - so
+ *   it's never enabled by default.  The counts are retrieved through
+ *   CVmRun::get_opstats_data(), which enumerates the same per-function
+ *   master table as the regular profiler data.  
+ */
+#ifdef VM_OPSTATS
+
+#ifndef VM_PROFILER
+#error VM_OPSTATS requires VM_PROFILER
+#endif
+
+#define VM_IF_OPSTATS(x)       x
+
+#else /* VM_OPSTATS */
+
+#define VM_IF_OPSTATS(x)
+
+#endif /* VM_OPSTATS */
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Profiler function call record.
@@ -88,6 +112,17 @@ struct vm_profiler_rec
      *   not in the stack) 
      */
     unsigned long call_cnt;
+
+#ifdef VM_OPSTATS
+    /* 
+     *   opcode statistics for the function (this points to the statistics
+     *   in the running total record, so the stack records share them) 
+     */
+    struct vm_prof_opstats *opstats;
+
+    /* the last opcode executed in this activation, or -1 if none yet */
+    int prev_op;
+#endif
 };
 
 /* ------------------------------------------------------------------------ */
@@ -0,0 +1,766 @@
+/*
+ *   Please see the accompanying license file, LICENSE.TXT, for information
+ *   on using and copying this software.
+ */
+/*
+Name
+  vmredfa.cpp - lazy DFA matcher for T3 regular expressions
+Function
+  Matches the deterministic subset of compiled regular expressions by
+  simulating the pattern's state machine in parallel, caching each set of
+  active states as a DFA state.  See vmredfa.h.
+Notes
+
+Modified
+  10/14/26  - Creation
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "t3std.h"
+#include "vmuni.h"
+#include "utf8.h"
+#include "vmregex.h"
+#include "vmredfa.h"
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Thread key encoding: the NFA state in the low 16 bits, and the index
+ *   into a literal string recognizer in the high 16 bits.
+ */
+#define RE_DFA_KEY(st, idx) \
+    ((unsigned int)(st) | ((unsigned int)(idx) << 16))
+#define RE_DFA_KEY_STATE(k)   ((re_state_id)((k) & 0xFFFF))
+#define RE_DFA_KEY_IDX(k)     ((size_t)((k) >> 16))
+
+/* the largest NFA state ID or literal string index we can encode */
+#define RE_DFA_KEY_MAX        0xFFFF
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Create a DFA for a pattern, if the pattern is eligible
+ */
+CRegexDFA *CRegexDFA::create(const re_compiled_pattern *pat)
+{
+    /* make sure the pattern only uses features we can handle */
+    int needs_regs;
+    if (!is_eligible(pat, &needs_regs))
+        return 0;
+
+    /* create the DFA */
+    CRegexDFA *dfa = new CRegexDFA(pat);
+    dfa->needs_regs_ = (needs_regs != 0);
+    return dfa;
+}
+
+/*
+ *   construction
+ */
+CRegexDFA::CRegexDFA(const re_compiled_pattern *pat)
+{
+    /* remember the pattern and its match mode */
+    pat_ = pat;
+    longest_ = pat->longest_match;
+    needs_regs_ = FALSE;
+
+    /* no states yet */
+    start_[0] = start_[1] = 0;
+    memset(hash_, 0, sizeof(hash_));
+    mem_used_ = 0;
+
+    /* allocate the work set; we'll expand it as needed */
+    work_max_ = pat->tuple_cnt + 16;
+    work_ = (unsigned int *)t3malloc(work_max_ * sizeof(work_[0]));
+    work_cnt_ = 0;
+
+    /* allocate the visit marks and the closure stack */
+    mark_ = (unsigned int *)t3malloc(pat->tuple_cnt * sizeof(mark_[0]));
+    memset(mark_, 0, pat->tuple_cnt * sizeof(mark_[0]));
+    gen_ = 0;
+    stk_ = (re_state_id *)t3malloc(pat->tuple_cnt * sizeof(stk_[0]));
+}
+
+/*
+ *   deletion
+ */
+CRegexDFA::~CRegexDFA()
+{
+    /* discard the cached states */
+    flush();
+
+    /* free the work areas */
+    t3free(work_);
+    t3free(mark_);
+    t3free(stk_);
+}
+
+/*
+ *   Determine if a pattern is suitable for the DFA.  We walk the states
+ *   reachable from the initial state, and reject the pattern if we find any
+ *   recognizer that depends on anything other than the current input
+ *   character and the beginning/end of the text.
+ */
+int CRegexDFA::is_eligible(const re_compiled_pattern *pat, int *needs_regs)
+{
+    /* presume we won't need the group registers */
+    *needs_regs = FALSE;
+
+    /* we can only encode so many states in a thread key */
+    if (pat->tuple_cnt > RE_DFA_KEY_MAX)
+        return FALSE;
+
+    /* the DFA only does exact character matching */
+    if (pat->case_sensitivity_specified && !pat->case_sensitive)
+        return FALSE;
+
+    /* a zero-length machine needs no DFA - the matcher handles it directly */
+    re_state_id init = pat->machine.init;
+    re_state_id final = pat->machine.final;
+    if (init == final || init == RE_STATE_INVALID)
+        return FALSE;
+
+    /* set up a visit list and a stack for the walk */
+    char *seen = (char *)t3malloc(pat->tuple_cnt);
+    re_state_id *stk = (re_state_id *)t3malloc(
+        pat->tuple_cnt * sizeof(stk[0]));
+    memset(seen, 0, pat->tuple_cnt);
+
+    /* start at the initial state */
+    int ok = TRUE;
+    size_t sp = 0;
+    stk[sp++] = init;
+    seen[init] = TRUE;
+
+    /* visit each reachable state */
+    while (ok && sp != 0)
+    {
+        /* get the next state; the final state's transitions don't matter */
+        re_state_id st = stk[--sp];
+        if (st == final)
+            continue;
+
+        /* check the recognizer type */
+        const re_tuple *t = &pat->tuples[st];
+        switch (t->typ)
+        {
+        case RE_LITSTR:
+        case RE_LITSTRA:
+            /* we can only encode so many string positions in a key */
+            {
+                size_t len = wcslen(t->info.str.str);
+                if (len == 0 || len > RE_DFA_KEY_MAX)
+                    ok = FALSE;
+            }
+            break;
+
+        case RE_GROUP_ENTER:
+        case RE_GROUP_EXIT:
+            /* note if this sets a register */
+            if (t->info.ch < RE_GROUP_REG_CNT)
+                *needs_regs = TRUE;
+            break;
+
+        case RE_LITERAL:
+        case RE_EPSILON:
+        case RE_WILDCARD:
+        case RE_TEXT_BEGIN:
+        case RE_TEXT_END:
+        case RE_WORD_CHAR:
+        case RE_NON_WORD_CHAR:
+        case RE_RANGE:
+        case RE_RANGE_EXCL:
+        case RE_ALPHA:
+        case RE_DIGIT:
+        case RE_NON_DIGIT:
+        case RE_UPPER:
+        case RE_LOWER:
+        case RE_ALPHANUM:
+        case RE_SPACE:
+        case RE_NON_SPACE:
+        case RE_PUNCT:
+        case RE_NEWLINE:
+        case RE_VSPACE:
+        case RE_NON_VSPACE:
+            /* these are all fine */
+            break;
+
+        default:
+            /* anything else requires the backtracking matcher */
+            ok = FALSE;
+            break;
+        }
+
+        /*
+         *   In longest-match mode, a shortest-match closure makes the
+         *   winning path depend on the order of the branches, which the DFA
+         *   can't reproduce.  (In shortest-match mode every branch takes
+         *   the shortest alternative, so the flag makes no difference.)
+         */
+        if (pat->longest_match && (t->flags & RE_STATE_SHORTEST) != 0)
+            ok = FALSE;
+
+        /* visit the successor states */
+        if (t->next_state_1 != RE_STATE_INVALID && !seen[t->next_state_1])
+        {
+            seen[t->next_state_1] = TRUE;
+            stk[sp++] = t->next_state_1;
+        }
+        if (t->typ == RE_EPSILON
+            && t->next_state_2 != RE_STATE_INVALID
+            && !seen[t->next_state_2])
+        {
+            seen[t->next_state_2] = TRUE;
+            stk[sp++] = t->next_state_2;
+        }
+    }
+
+    /* done with the work areas */
+    t3free(seen);
+    t3free(stk);
+
+    /* return the result */
+    return ok;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Discard all cached states
+ */
+void CRegexDFA::flush()
+{
+    /* free each state in each hash chain */
+    for (size_t i = 0 ; i < RE_DFA_HASH_SIZE ; ++i)
+    {
+        re_dfa_state *s, *nxt;
+        for (s = hash_[i] ; s != 0 ; s = nxt)
+        {
+            nxt = s->nxt;
+            t3free(s);
+        }
+        hash_[i] = 0;
+    }
+
+    /* forget the start states */
+    start_[0] = start_[1] = 0;
+
+    /* we're no longer using any memory for states */
+    mem_used_ = 0;
+}
+
+/*
+ *   Start a new closure computation
+ */
+void CRegexDFA::begin_work()
+{
+    /* clear the work set */
+    work_cnt_ = 0;
+
+    /* advance the visit generation, clearing the marks if it wraps */
+    if (++gen_ == 0)
+    {
+        memset(mark_, 0, pat_->tuple_cnt * sizeof(mark_[0]));
+        gen_ = 1;
+    }
+}
+
+/*
+ *   Add a key to the work set
+ */
+void CRegexDFA::add_key(unsigned int key)
+{
+    /* expand the work set if necessary */
+    if (work_cnt_ == work_max_)
+    {
+        work_max_ += work_max_/2 + 16;
+        work_ = (unsigned int *)t3realloc(
+            work_, work_max_ * sizeof(work_[0]));
+    }
+
+    /* add the key */
+    work_[work_cnt_++] = key;
+}
+
+/*
+ *   Add the epsilon closure of an NFA state to the work set.  This follows
+ *   all of the paths from the state that don't consume any input, adding
+ *   the character-consuming states we reach to the work set.
+ */
+void CRegexDFA::add_closure(re_state_id st, int at_begin, int at_end,
+                            int *accept, int *has_end)
+{
+    const re_tuple *tuples = pat_->tuples;
+    re_state_id final = pat_->machine.final;
+
+    /* if we've already visited this state in this computation, skip it */
+    if (st == RE_STATE_INVALID || mark_[st] == gen_)
+        return;
+
+    /* push the starting state */
+    size_t sp = 0;
+    stk_[sp++] = st;
+    mark_[st] = gen_;
+
+    /* process states until the stack is empty */
+    while (sp != 0)
+    {
+        /* pop the next state */
+        st = stk_[--sp];
+
+        /* if it's the final state, we've found a match */
+        if (st == final)
+        {
+            *accept = TRUE;
+            continue;
+        }
+
+        /* figure the successors that we can reach without consuming input */
+        const re_tuple *t = &tuples[st];
+        re_state_id n1 = RE_STATE_INVALID, n2 = RE_STATE_INVALID;
+        switch (t->typ)
+        {
+        case RE_EPSILON:
+            n1 = t->next_state_1;
+            n2 = t->next_state_2;
+            break;
+
+        case RE_GROUP_ENTER:
+        case RE_GROUP_EXIT:
+            n1 = t->next_state_1;
+            break;
+
+        case RE_TEXT_BEGIN:
+            /* this only passes at the very start of the text */
+            if (at_begin)
+                n1 = t->next_state_1;
+            break;
+
+        case RE_TEXT_END:
+            /*
+             *   This only passes at the very end of the text.  If we're not
+             *   there now, keep the state in the set as a pending thread,
+             *   so that we can check it if we run out of input here.
+             */
+            if (at_end)
+                n1 = t->next_state_1;
+            else
+            {
+                add_key(RE_DFA_KEY(st, 0));
+                *has_end = TRUE;
+            }
+            break;
+
+        default:
+            /* it's a character-consuming state - add it to the set */
+            add_key(RE_DFA_KEY(st, 0));
+            break;
+        }
+
+        /* push the successors we haven't visited yet */
+        if (n1 != RE_STATE_INVALID && mark_[n1] != gen_)
+        {
+            mark_[n1] = gen_;
+            stk_[sp++] = n1;
+        }
+        if (n2 != RE_STATE_INVALID && mark_[n2] != gen_)
+        {
+            mark_[n2] = gen_;
+            stk_[sp++] = n2;
+        }
+    }
+}
+
+/*
+ *   key comparison callback for qsort
+ */
+static int re_dfa_key_cmp(const void *a, const void *b)
+{
+    unsigned int ka = *(const unsigned int *)a;
+    unsigned int kb = *(const unsigned int *)b;
+    return (ka < kb ? -1 : ka > kb ? 1 : 0);
+}
+
+/*
+ *   Find or create the DFA state for the current work set.  Returns null if
+ *   adding the state would exceed our memory limit; in this case we discard
+ *   all of the cached states, so the caller must not use any state pointers
+ *   it's holding.
+ */
+re_dfa_state *CRegexDFA::intern(int accept, int has_end)
+{
+    /* put the keys in canonical order, and remove duplicates */
+    size_t cnt = 0;
+    if (work_cnt_ != 0)
+    {
+        qsort(work_, work_cnt_, sizeof(work_[0]), &re_dfa_key_cmp);
+        cnt = 1;
+        for (size_t i = 1 ; i < work_cnt_ ; ++i)
+        {
+            if (work_[i] != work_[cnt - 1])
+                work_[cnt++] = work_[i];
+        }
+    }
+
+    /* compute the hash value */
+    unsigned int h = (accept ? 0x9E3779B9U : 0);
+    for (size_t i = 0 ; i < cnt ; ++i)
+        h = (h ^ work_[i]) * 0x01000193U;
+
+    /* look for an existing state with the same key set */
+    re_dfa_state **bucket = &hash_[h % RE_DFA_HASH_SIZE];
+    for (re_dfa_state *s = *bucket ; s != 0 ; s = s->nxt)
+    {
+        if (s->hash == h && s->cnt == cnt
+            && (s->accept != 0) == (accept != 0)
+            && memcmp(s->keys, work_, cnt * sizeof(work_[0])) == 0)
+            return s;
+    }
+
+    /* make sure we have room for a new state */
+    size_t siz = sizeof(re_dfa_state) + cnt * sizeof(work_[0]);
+    if (mem_used_ + siz > RE_DFA_MAX_MEM)
+    {
+        flush();
+        return 0;
+    }
+
+    /* allocate the state, with its key array following the structure */
+    re_dfa_state *s = (re_dfa_state *)t3malloc(siz);
+    mem_used_ += siz;
+
+    /* set it up */
+    s->keys = (unsigned int *)(s + 1);
+    s->cnt = cnt;
+    memcpy(s->keys, work_, cnt * sizeof(work_[0]));
+    s->hash = h;
+    s->accept = (accept != 0);
+    s->has_end = (has_end != 0);
+    s->end_known = FALSE;
+    s->end_accept = FALSE;
+    memset(s->trans, 0, sizeof(s->trans));
+
+    /* link it into the hash table */
+    s->nxt = *bucket;
+    *bucket = s;
+
+    /* return the new state */
+    return s;
+}
+
+/*
+ *   Get the start state
+ */
+re_dfa_state *CRegexDFA::get_start(int at_begin)
+{
+    /* if we've already built it, use the cached copy */
+    if (start_[at_begin] != 0)
+        return start_[at_begin];
+
+    /* build the closure of the machine's initial state */
+    int accept = FALSE, has_end = FALSE;
+    begin_work();
+    add_closure(pat_->machine.init, at_begin, FALSE, &accept, &has_end);
+
+    /* create the state and cache it */
+    return start_[at_begin] = intern(accept, has_end);
+}
+
+/*
+ *   Compute the transition from a state on a character
+ */
+re_dfa_state *CRegexDFA::step(const re_dfa_state *s, wchar_t ch)
+{
+    const re_tuple *tuples = pat_->tuples;
+    int accept = FALSE, has_end = FALSE;
+
+    /* start a new work set */
+    begin_work();
+
+    /* advance each thread that accepts the character */
+    for (size_t i = 0 ; i < s->cnt ; ++i)
+    {
+        unsigned int key = s->keys[i];
+        re_state_id st = RE_DFA_KEY_STATE(key);
+        const re_tuple *t = &tuples[st];
+
+        switch (t->typ)
+        {
+        case RE_TEXT_END:
+            /* a pending end-of-text assertion can't consume anything */
+            break;
+
+        case RE_LITSTR:
+        case RE_LITSTRA:
+            /*
+             *   literal string - if the character matches, move on to the
+             *   next character of the string, or to the next state if
+             *   that's the end of the string
+             */
+            {
+                size_t idx = RE_DFA_KEY_IDX(key);
+                if (t->info.str.str[idx] == ch)
+                {
+                    if (t->info.str.str[idx + 1] == 0)
+                        add_closure(t->next_state_1, FALSE, FALSE,
+                                    &accept, &has_end);
+                    else
+                        add_key(RE_DFA_KEY(st, idx + 1));
+                }
+            }
+            break;
+
+        default:
+            /* single-character recognizer */
+            if (accepts_char(t, ch))
+                add_closure(t->next_state_1, FALSE, FALSE, &accept, &has_end);
+            break;
+        }
+    }
+
+    /* find or create the new state */
+    return intern(accept, has_end);
+}
+
+/*
+ *   Determine if a state accepts at the end of the text.  This is true if
+ *   any of its pending end-of-text assertions lead to the final state.
+ */
+int CRegexDFA::accepts_at_end(re_dfa_state *s, int at_begin)
+{
+    /* if we've already figured this out, use the cached answer */
+    if (s->end_known && !at_begin)
+        return s->end_accept;
+
+    /* follow each pending assertion with the end-of-text condition set */
+    int accept = FALSE, has_end = FALSE;
+    begin_work();
+    for (size_t i = 0 ; i < s->cnt && !accept ; ++i)
+    {
+        re_state_id st = RE_DFA_KEY_STATE(s->keys[i]);
+        if (pat_->tuples[st].typ == RE_TEXT_END)
+            add_closure(pat_->tuples[st].next_state_1, at_begin, TRUE,
+                        &accept, &has_end);
+    }
+
+    /*
+     *   Cache the answer.  The beginning-of-text case only arises for an
+     *   empty text, so don't bother caching that one.
+     */
+    if (!at_begin)
+    {
+        s->end_known = TRUE;
+        s->end_accept = (accept != 0);
+    }
+
+    /* return the result */
+    return accept;
+}
+
+/*
+ *   Determine if a recognizer accepts a character.  This mirrors the
+ *   case-sensitive tests in CRegexSearcher::match().
+ */
+int CRegexDFA::accepts_char(const re_tuple *t, wchar_t ch)
+{
+    switch (t->typ)
+    {
+    case RE_LITERAL:
+        return t->info.ch == ch;
+
+    case RE_WILDCARD:
+        return TRUE;
+
+    case RE_WORD_CHAR:
+        return t3_is_alpha(ch) || t3_is_digit(ch);
+
+    case RE_NON_WORD_CHAR:
+        return !(t3_is_alpha(ch) || t3_is_digit(ch));
+
+    case RE_ALPHA:
+        return t3_is_alpha(ch);
+
+    case RE_DIGIT:
+        return t3_is_digit(ch);
+
+    case RE_NON_DIGIT:
+        return !t3_is_digit(ch);
+
+    case RE_UPPER:
+        return t3_is_upper(ch);
+
+    case RE_LOWER:
+        return t3_is_lower(ch);
+
+    case RE_ALPHANUM:
+        return t3_is_alpha(ch) || t3_is_digit(ch);
+
+    case RE_SPACE:
+        return t3_is_space(ch);
+
+    case RE_NON_SPACE:
+        return !t3_is_space(ch);
+
+    case RE_VSPACE:
+        return t3_is_vspace(ch);
+
+    case RE_NON_VSPACE:
+        return !t3_is_vspace(ch);
+
+    case RE_PUNCT:
+        return t3_is_punct(ch);
+
+    case RE_NEWLINE:
+        return (ch == 0x000A || ch == 0x000D || ch == 0x000B
+                || ch == 0x2028 || ch == 0x2029);
+
+    case RE_RANGE:
+    case RE_RANGE_EXCL:
+        {
+            /* search for the character in the range list */
+            int match = FALSE;
+            size_t i;
+            const wchar_t *rp;
+            for (i = t->info.range.char_range_cnt,
+                 rp = t->info.range.char_range ;
+                 i != 0 && !match ; i -= 2, rp += 2)
+            {
+                if (rp[0] == '\0')
+                {
+                    /* it's a class specifier */
+                    switch (rp[1])
+                    {
+                    case RE_ALPHA:
+                        match = t3_is_alpha(ch);
+                        break;
+
+                    case RE_DIGIT:
+                        match = t3_is_digit(ch);
+                        break;
+
+                    case RE_UPPER:
+                        match = t3_is_upper(ch);
+                        break;
+
+                    case RE_LOWER:
+                        match = t3_is_lower(ch);
+                        break;
+
+                    case RE_ALPHANUM:
+                        match = t3_is_alpha(ch) || t3_is_digit(ch);
+                        break;
+
+                    case RE_SPACE:
+                        match = t3_is_space(ch);
+                        break;
+
+                    case RE_VSPACE:
+                        match = t3_is_vspace(ch);
+                        break;
+
+                    case RE_PUNCT:
+                        match = t3_is_punct(ch);
+                        break;
+
+                    case RE_NEWLINE:
+                        match = (ch == 0x000A || ch == 0x000D
+                                 || ch == 0x000B || ch == 0x2028
+                                 || ch == 0x2029);
+                        break;
+
+                    case RE_NULLCHAR:
+                        match = (ch == 0);
+                        break;
+
+                    default:
+                        break;
+                    }
+                }
+                else
+                {
+                    /* it's a literal range */
+                    match = (ch >= rp[0] && ch <= rp[1]);
+                }
+            }
+
+            /* a range needs a match; an exclusion needs no match */
+            return (t->typ == RE_RANGE ? match : !match);
+        }
+
+    default:
+        /* we don't handle anything else */
+        return FALSE;
+    }
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Match the pattern at the start of the given string
+ */
+int CRegexDFA::match(const char *entire_str, size_t entire_len,
+                     const char *str, size_t len)
+{
+    /* get the start state */
+    int at_begin = (str == entire_str);
+    re_dfa_state *s = get_start(at_begin);
+    if (s == 0)
+        return RE_DFA_GIVE_UP;
+
+    /* run the automaton until we run out of input or threads */
+    int best = RE_DFA_NO_MATCH;
+    utf8_ptr p((char *)str);
+    size_t rem = len;
+    for (;;)
+    {
+        /*
+         *   If this state accepts, note the match.  In shortest-match mode,
+         *   the first match we find is the answer.
+         */
+        if (s->accept)
+        {
+            best = (int)(p.getptr() - str);
+            if (!longest_)
+                return best;
+        }
+
+        /*
+         *   if we're out of input, check for end-of-text assertions that
+         *   pass here, and we're done
+         */
+        if (rem == 0)
+        {
+            if (s->has_end
+                && p.getptr() == entire_str + entire_len
+                && accepts_at_end(s, p.getptr() == entire_str))
+                best = (int)(p.getptr() - str);
+
+            return best;
+        }
+
+        /* if there are no threads left, there's nothing more to find */
+        if (s->cnt == 0)
+            return best;
+
+        /* get the transition on the next character */
+        wchar_t ch = p.getch();
+        re_dfa_state *nxt = (ch < RE_DFA_CACHED_CHARS ? s->trans[ch] : 0);
+        if (nxt == 0)
+        {
+            /*
+             *   compute the transition; if the cache overflowed, give up
+             *   (this discards all states, including 's', so don't touch it)
+             */
+            if ((nxt = step(s, ch)) == 0)
+                return RE_DFA_GIVE_UP;
+
+            /* cache it if it's an ASCII character */
+            if (ch < RE_DFA_CACHED_CHARS)
+                s->trans[ch] = nxt;
+        }
+
+        /* move on to the next character and state */
+        p.inc(&rem);
+        s = nxt;
+    }
+}
@@ -0,0 +1,207 @@
+/*
+ *   Please see the accompanying license file, LICENSE.TXT, for information
+ *   on using and copying this software.
+ */
+/*
+Name
+  vmredfa.h - lazy DFA matcher for T3 regular expressions
+Function
+  Provides a fast matcher for the subset of compiled regular expressions
+  that can be recognized by a deterministic automaton.  Rather than
+  backtracking through the pattern's state machine (as CRegexSearcher
+  does), we simulate all of the possible paths through the machine in
+  parallel, one input character at a time.  Each distinct set of active
+  machine states becomes a DFA state, which we construct the first time
+  we need it and cache for later use, along with its transitions on the
+  ASCII characters.
+Notes
+  The DFA only tells us whether the pattern matches at a given position,
+  and how long the match is; it can't tell which path through the machine
+  won, so it doesn't fill in group registers.  The searcher uses it to
+  reject non-matching positions quickly, and falls back on the full
+  backtracking matcher to fill in the registers when the pattern has
+  capturing groups.
+
+  We only build a DFA for patterns that don't use features that depend on
+  the path taken or on context the DFA can't see: look-ahead and
+  look-back assertions, group back-references, counted loops, word
+  boundaries, and mixed shortest/longest closures are all excluded.  We
+  also only use the DFA for case-sensitive matching, since case folding
+  can match a single pattern character to several input characters.
+
+  The state cache is bounded by RE_DFA_MAX_MEM.  If a match needs more
+  states than fit, we discard the cache and let the caller use the
+  backtracking matcher for that match.
+Modified
+  10/14/26  - Creation
+*/
+
+#ifndef VMREDFA_H
+#define VMREDFA_H
+
+#include <stdlib.h>
+#include "t3std.h"
+#include "vmregex.h"
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   DFA match result codes.  Non-negative results are match lengths.
+ */
+
+/* no match */
+#define RE_DFA_NO_MATCH   (-1)
+
+/* the state cache overflowed - use the backtracking matcher instead */
+#define RE_DFA_GIVE_UP    (-2)
+
+/* maximum memory we'll devote to cached DFA states for one pattern */
+#define RE_DFA_MAX_MEM    (256*1024)
+
+/* number of hash buckets for looking up DFA states */
+#define RE_DFA_HASH_SIZE  256
+
+/* number of characters for which we cache transitions in each state */
+#define RE_DFA_CACHED_CHARS  128
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   A DFA state.  This represents a set of "threads" through the pattern's
+ *   NFA, each of which is a character-consuming NFA state.  For literal
+ *   string states, the thread also records how far into the string we've
+ *   matched.  Each thread key encodes the NFA state ID in the low 16 bits
+ *   and the string index in the high 16 bits.
+ */
+struct re_dfa_state
+{
+    /* the thread keys, in ascending order */
+    unsigned int *keys;
+    size_t cnt;
+
+    /* hash value of the thread set, and next state in the hash chain */
+    unsigned int hash;
+    re_dfa_state *nxt;
+
+    /* the NFA's final state is reachable without consuming more input */
+    unsigned int accept : 1;
+
+    /* the key set includes end-of-text assertion states */
+    unsigned int has_end : 1;
+
+    /*
+     *   have we determined whether we accept at the end of the text, and if
+     *   so, the answer
+     */
+    unsigned int end_known : 1;
+    unsigned int end_accept : 1;
+
+    /* cached transitions for the ASCII characters, null if not yet known */
+    re_dfa_state *trans[RE_DFA_CACHED_CHARS];
+};
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Lazy DFA for a compiled pattern
+ */
+class CRegexDFA
+{
+public:
+    /*
+     *   Create a DFA for a compiled pattern.  Returns null if the pattern
+     *   uses any features that the DFA can't handle.  The pattern must
+     *   remain valid for the life of the DFA.
+     */
+    static CRegexDFA *create(const re_compiled_pattern *pat);
+
+    /* delete */
+    ~CRegexDFA();
+
+    /*
+     *   Match the pattern against the leading substring of 'str', looking
+     *   at no more than 'len' bytes.  'entire_str' and 'entire_len' give
+     *   the full text, for the beginning/end-of-text assertions.  Returns
+     *   the byte length of the match, RE_DFA_NO_MATCH if there's no match,
+     *   or RE_DFA_GIVE_UP if the state cache overflowed.
+     */
+    int match(const char *entire_str, size_t entire_len,
+              const char *str, size_t len);
+
+    /*
+     *   Does the pattern set group registers?  If so, the caller must run
+     *   the backtracking matcher after a successful DFA match to fill them
+     *   in.
+     */
+    int needs_regs() const { return needs_regs_; }
+
+protected:
+    CRegexDFA(const re_compiled_pattern *pat);
+
+    /* determine if a pattern is suitable for the DFA */
+    static int is_eligible(const re_compiled_pattern *pat, int *needs_regs);
+
+    /* get the start state for the given beginning-of-text context */
+    re_dfa_state *get_start(int at_begin);
+
+    /* compute the transition from a state on a given input character */
+    re_dfa_state *step(const re_dfa_state *s, wchar_t ch);
+
+    /* determine if a state accepts at the end of the text */
+    int accepts_at_end(re_dfa_state *s, int at_begin);
+
+    /*
+     *   add the epsilon closure of an NFA state to the work set; sets
+     *   *accept if the closure reaches the final state, and *has_end if it
+     *   includes any pending end-of-text assertions
+     */
+    void add_closure(re_state_id st, int at_begin, int at_end,
+                     int *accept, int *has_end);
+
+    /* start a new closure computation */
+    void begin_work();
+
+    /* add a thread key to the work set */
+    void add_key(unsigned int key);
+
+    /* find or create the state for the current work set */
+    re_dfa_state *intern(int accept, int has_end);
+
+    /* discard all cached states */
+    void flush();
+
+    /* does the given NFA state accept the given character? */
+    static int accepts_char(const re_tuple *t, wchar_t ch);
+
+    /* the pattern */
+    const re_compiled_pattern *pat_;
+
+    /* are we in longest-match mode? */
+    unsigned int longest_ : 1;
+
+    /* does the pattern set group registers? */
+    unsigned int needs_regs_ : 1;
+
+    /* start states, indexed by beginning-of-text status */
+    re_dfa_state *start_[2];
+
+    /* state hash table */
+    re_dfa_state *hash_[RE_DFA_HASH_SIZE];
+
+    /* memory used by cached states */
+    size_t mem_used_;
+
+    /* work set of thread keys for the state under construction */
+    unsigned int *work_;
+    size_t work_cnt_;
+    size_t work_max_;
+
+    /* per-NFA-state visit marks for closure computations */
+    unsigned int *mark_;
+    unsigned int gen_;
+
+    /* closure stack */
+    re_state_id *stk_;
+};
+
+#endif /* VMREDFA_H */
@@ -160,6 +160,7 @@ Modified
 
 #include "t3std.h"
 #include "vmregex.h"
+#include "vmredfa.h"
 #include "utf8.h"
 #include "vmerr.h"
 #include "vmerrnum.h"
@@ -867,6 +868,9 @@ re_status_t CRegexParser::compile(const char *expr_str, size_t exprlen,
     /* we have no looping variables yet */
     pat->loop_var_cnt = 0;
 
+    /* we don't have a DFA (compile_pattern() creates one if possible) */
+    pat->dfa = 0;
+
     /* get the length of the expression in characters */
     size_t exprchars = utf8_ptr::s_len(expr_str, exprlen);
 
@@ -1662,6 +1666,9 @@ re_status_t CRegexParser::compile(const char *expr_str, size_t exprlen,
     pat->machine = alter_machine;
     pat->tuple_cnt = next_state_;
 
+    /* note the literal text that matches must start with */
+    find_literal_prefix(pat);
+
     /* limit the group count to the maximum */
     if (pat->group_cnt > RE_GROUP_REG_CNT)
         pat->group_cnt = RE_GROUP_REG_CNT;
@@ -2478,6 +2485,84 @@ void CRegexParser::consolidate_strings(re_machine *machine)
     }
 }
 
+/*
+ *   Find the literal prefix of a compiled expression.  We follow the
+ *   machine from its initial state for as long as the path is
+ *   unconditional - through group markers and single-branch epsilons - and
+ *   collect the literal characters we pass along the way.  We stop at the
+ *   first branch or any other kind of recognizer, since beyond that point
+ *   we don't know what the match will contain.  
+ */
+void CRegexParser::find_literal_prefix(re_compiled_pattern_base *pat)
+{
+    /* no prefix yet */
+    pat->prefix_len = 0;
+
+    /* follow the path from the initial state */
+    utf8_ptr dst(pat->prefix);
+    re_state_id i = pat->machine.init;
+    for (int steps = 0 ; i != RE_STATE_INVALID && i != pat->machine.final
+         && steps < next_state_ ; ++steps)
+    {
+        const re_tuple *t = &tuple_arr_[i];
+        const wchar_t *str;
+        wchar_t chbuf[2];
+        switch (t->typ)
+        {
+        case RE_GROUP_ENTER:
+        case RE_GROUP_EXIT:
+            /* these don't consume anything - keep going */
+            i = t->next_state_1;
+            continue;
+
+        case RE_EPSILON:
+            /* stop at a branch; otherwise just keep going */
+            if (t->next_state_2 != RE_STATE_INVALID)
+                return;
+            i = t->next_state_1;
+            continue;
+
+        case RE_LITERAL:
+            /* 
+             *   a single literal character - stop at a null character,
+             *   since we use null-terminated strings below 
+             */
+            if (t->info.ch == 0)
+                return;
+            chbuf[0] = t->info.ch;
+            chbuf[1] = 0;
+            str = chbuf;
+            break;
+
+        case RE_LITSTR:
+        case RE_LITSTRA:
+            /* a literal string */
+            str = t->info.str.str;
+            break;
+
+        default:
+            /* anything else ends the prefix */
+            return;
+        }
+
+        /* add the characters to the prefix, as many as will fit */
+        for ( ; *str != 0 ; ++str)
+        {
+            /* stop if it won't fit */
+            size_t csiz = utf8_ptr::s_wchar_size(*str);
+            if (pat->prefix_len + csiz > RE_PREFIX_MAX)
+                return;
+
+            /* add it */
+            dst.setch(*str);
+            pat->prefix_len += csiz;
+        }
+
+        /* on to the next state */
+        i = t->next_state_1;
+    }
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Compile an expression and return a newly-allocated pattern object.  
@@ -2612,6 +2697,12 @@ re_status_t CRegexParser::compile_pattern(const char *expr_str,
         }
     }
 
+    /* 
+     *   if the pattern is simple enough, set up a lazy DFA for it; this
+     *   refers to the packed tuples, so it has to wait until they're final 
+     */
+    pat->dfa = CRegexDFA::create(pat);
+
     /* success */
     return stat;
 }
@@ -2621,6 +2712,10 @@ re_status_t CRegexParser::compile_pattern(const char *expr_str,
  */
 void CRegexParser::free_pattern(re_compiled_pattern *pattern)
 {
+    /* delete the DFA, if we created one */
+    if (pattern->dfa != 0)
+        delete pattern->dfa;
+
     /* we allocate each pattern as a single unit, so it's easy to free */
     t3free(pattern);
 }
@@ -2735,6 +2830,35 @@ int CRegexSearcher::match(const char *entire_str, size_t entire_str_len,
     if (cur_state == final_state)
         return 0;
 
+    /* note if we're matching the pattern's main machine with exact case */
+    int exact_main = (case_sensitive
+                      && machine->init == pattern->machine.init
+                      && machine->final == pattern->machine.final);
+
+    /* 
+     *   if the pattern has a literal prefix, and the string doesn't start
+     *   with it, there's no match 
+     */
+    if (exact_main && pattern->prefix_len != 0
+        && (origlen < pattern->prefix_len
+            || memcmp(str, pattern->prefix, pattern->prefix_len) != 0))
+        return -1;
+
+    /* 
+     *   If the pattern has a DFA, try it first.  A DFA mismatch is
+     *   definitive.  A DFA match is too, unless we need the group registers,
+     *   in which case we still have to run the full matcher to find out
+     *   which path matched; likewise if the DFA gives up.  
+     */
+    if (exact_main && pattern->dfa != 0)
+    {
+        int dfa_len = pattern->dfa->match(
+            entire_str, entire_str_len, str, origlen);
+        if (dfa_len == RE_DFA_NO_MATCH
+            || (dfa_len >= 0 && !pattern->dfa->needs_regs()))
+            return dfa_len;
+    }
+
     /* start at the beginning of the string */
     utf8_ptr p((char *)str);
     size_t curlen = origlen;
@@ -3909,6 +4033,30 @@ int CRegexSearcher::match(const char *entire_str, size_t entire_str_len,
     }
 }
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Find the next occurrence of a literal prefix in a string.  Returns a
+ *   pointer to the start of the occurrence, or null if there isn't one.
+ *   The first byte of a UTF-8 character is never a continuation byte, so
+ *   any byte match we find is at a character boundary.  
+ */
+const char *CRegexSearcher::find_prefix(const char *p, size_t len,
+                                        const char *prefix, size_t prefix_len)
+{
+    /* scan for the first byte, then check the rest of the prefix */
+    for (const char *end = p + len ; (size_t)(end - p) >= prefix_len ; ++p)
+    {
+        p = (const char *)memchr(p, prefix[0], end - p - prefix_len + 1);
+        if (p == 0)
+            return 0;
+        if (memcmp(p, prefix, prefix_len) == 0)
+            return p;
+    }
+
+    /* not found */
+    return 0;
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Search for a regular expression within a string.  Returns -1 if the
@@ -3934,6 +4082,18 @@ int CRegexSearcher::search(const char *entirestr, const char *str, size_t len,
 
     /* figure the length of the overall string */
     size_t entirelen = len + (str - entirestr);
+
+    /* 
+     *   If we're matching with exact case, and the pattern has a literal
+     *   prefix, a match can only start where the prefix occurs, so we can
+     *   skip straight to those positions. 
+     */
+    size_t prefix_len = 0;
+    if (pattern->prefix_len != 0
+        && machine->init == pattern->machine.init
+        && (pattern->case_sensitivity_specified
+            ? pattern->case_sensitive : default_case_sensitive_))
+        prefix_len = pattern->prefix_len;
     
     /*
      *   Starting at the first character in the string, search for the
@@ -3943,6 +4103,18 @@ int CRegexSearcher::search(const char *entirestr, const char *str, size_t len,
     utf8_ptr p;
     for (p.set((char *)str) ; p.getptr() <= max_start_pos ; p.inc(&len))
     {
+        /* skip ahead to the next occurrence of the prefix, if we have one */
+        if (prefix_len != 0)
+        {
+            const char *nxt = find_prefix(
+                p.getptr(), len, pattern->prefix, prefix_len);
+            if (nxt == 0 || nxt > max_start_pos)
+                break;
+
+            len -= nxt - p.getptr();
+            p.set((char *)nxt);
+        }
+
         /* check for a match */
         int matchlen = match(entirestr, entirelen, p.getptr(), len,
                              pattern, tuple_arr, machine, regs, loop_vars);
@@ -4416,3 +4588,187 @@ int CRegexSearcherSimple::compile_and_search_back(
     /* return the result */
     return m;
 }
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Compiled pattern cache 
+ */
+
+/*
+ *   construction 
+ */
+CRegexCache::CRegexCache(CRegexParser *parser, size_t max_cnt)
+{
+    parser_ = parser;
+    head_ = tail_ = 0;
+    cnt_ = 0;
+    max_cnt_ = max_cnt;
+}
+
+/*
+ *   deletion 
+ */
+CRegexCache::~CRegexCache()
+{
+    /* free all of the entries, whether or not they're in use */
+    entry *e, *nxt;
+    for (e = head_ ; e != 0 ; e = nxt)
+    {
+        nxt = e->nxt;
+        CRegexParser::free_pattern(e->pat);
+        t3free(e);
+    }
+}
+
+/*
+ *   set the maximum cache size 
+ */
+void CRegexCache::set_max_cnt(size_t cnt)
+{
+    /* remember the new limit, and drop entries as needed to meet it */
+    max_cnt_ = cnt;
+    trim(cnt);
+}
+
+/*
+ *   Get the compiled pattern for an expression 
+ */
+re_compiled_pattern *CRegexCache::get(const char *expr, size_t exprlen)
+{
+    /* if the cache is disabled, there's nothing to do */
+    if (max_cnt_ == 0)
+        return 0;
+
+    /* hash the expression text */
+    unsigned int h = 2166136261U;
+    for (size_t i = 0 ; i < exprlen ; ++i)
+        h = (h ^ (unsigned char)expr[i]) * 16777619U;
+
+    /* look for an existing entry */
+    entry *e;
+    for (e = head_ ; e != 0 ; e = e->nxt)
+    {
+        if (e->hash == h && e->len == exprlen
+            && memcmp(e->expr, expr, exprlen) == 0)
+        {
+            /* found it - move it to the head of the list */
+            if (e != head_)
+            {
+                unlink(e);
+                e->nxt = head_;
+                e->prv = 0;
+                head_->prv = e;
+                head_ = e;
+            }
+
+            /* return the pattern */
+            return e->pat;
+        }
+    }
+
+    /* make room for the new entry; if we can't, don't bother compiling */
+    trim(max_cnt_ - 1);
+    if (cnt_ >= max_cnt_)
+        return 0;
+
+    /* compile the pattern */
+    re_compiled_pattern *pat;
+    if (parser_->compile_pattern(expr, exprlen, &pat) != RE_STATUS_SUCCESS)
+        return 0;
+
+    /* create the entry, with space for the expression text */
+    e = (entry *)t3malloc(sizeof(entry) + exprlen);
+    e->hash = h;
+    e->len = exprlen;
+    e->pat = pat;
+    e->refs = 0;
+    memcpy(e->expr, expr, exprlen);
+
+    /* link it in at the head of the list */
+    e->prv = 0;
+    e->nxt = head_;
+    if (head_ != 0)
+        head_->prv = e;
+    else
+        tail_ = e;
+    head_ = e;
+    ++cnt_;
+
+    /* return the new pattern */
+    return pat;
+}
+
+/*
+ *   find the entry for a pattern 
+ */
+CRegexCache::entry *CRegexCache::find_pat(re_compiled_pattern *pat)
+{
+    entry *e;
+    for (e = head_ ; e != 0 && e->pat != pat ; e = e->nxt) ;
+    return e;
+}
+
+/*
+ *   add a reference to a pattern 
+ */
+void CRegexCache::add_ref(re_compiled_pattern *pat)
+{
+    entry *e = find_pat(pat);
+    if (e != 0)
+        ++e->refs;
+}
+
+/*
+ *   release a pattern reference 
+ */
+void CRegexCache::release(re_compiled_pattern *pat)
+{
+    entry *e = find_pat(pat);
+    if (e != 0 && e->refs > 0)
+    {
+        /* drop the reference */
+        --e->refs;
+
+        /* 
+         *   if the cache was shrunk while this entry was in use, we might
+         *   be over the limit now that it's free 
+         */
+        trim(max_cnt_);
+    }
+}
+
+/*
+ *   unlink an entry from the list 
+ */
+void CRegexCache::unlink(entry *e)
+{
+    if (e->prv != 0)
+        e->prv->nxt = e->nxt;
+    else
+        head_ = e->nxt;
+
+    if (e->nxt != 0)
+        e->nxt->prv = e->prv;
+    else
+        tail_ = e->prv;
+}
+
+/*
+ *   evict entries until we're down to the given count 
+ */
+void CRegexCache::trim(size_t cnt)
+{
+    /* work from the least recently used end, skipping entries in use */
+    entry *e, *prv;
+    for (e = tail_ ; e != 0 && cnt_ > cnt ; e = prv)
+    {
+        prv = e->prv;
+        if (e->refs == 0)
+        {
+            unlink(e);
+            CRegexParser::free_pattern(e->pat);
+            t3free(e);
+            --cnt_;
+        }
+    }
+}
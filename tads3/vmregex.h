@@ -322,6 +322,10 @@ struct re_machine
 };
 
 
+/* maximum length in bytes of a compiled pattern's literal prefix */
+#define RE_PREFIX_MAX  16
+
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Compiled pattern description.  This is not a complete compiled pattern,
@@ -366,6 +370,23 @@ struct re_compiled_pattern_base
      *   ambiguity; otherwise, we match the string that ends first 
      */
     unsigned int first_begin : 1;
+
+    /*
+     *   The literal text, in UTF-8, that every match must start with, if
+     *   the pattern has one.  This is the run of literal characters leading
+     *   up to the first branch or non-literal recognizer.  When matching
+     *   with exact case, the searcher uses this to skip ahead to the
+     *   positions where a match could start.  
+     */
+    char prefix[RE_PREFIX_MAX];
+    size_t prefix_len;
+
+    /* 
+     *   Lazy DFA for the pattern, if it's simple enough for one (see
+     *   vmredfa.h).  This is only created for compiled pattern objects
+     *   built through CRegexParser::compile_pattern(); it's null otherwise.
+     */
+    class CRegexDFA *dfa;
 };
 
 /*
@@ -534,6 +555,9 @@ protected:
     /* consolidate runs of characters into strings */
     void consolidate_strings(re_machine *machine);
 
+    /* find the literal prefix that every match must start with */
+    void find_literal_prefix(re_compiled_pattern_base *pat);
+
     /* next available state ID */
     re_state_id next_state_;
 
@@ -1136,6 +1160,10 @@ protected:
                     const struct re_machine *machine,
                     re_group_register *regs, int *result_len);
 
+    /* find the next occurrence of a literal prefix in a string */
+    static const char *find_prefix(const char *p, size_t len,
+                                   const char *prefix, size_t prefix_len);
+
     /* clear a set of group registers */
     void clear_group_regs(re_group_register *regs)
     {
@@ -1332,5 +1360,94 @@ protected:
     class CRegexParser *parser_;
 };
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Compiled pattern cache.  When a program passes a regular expression to
+ *   one of the search functions as a string rather than a RexPattern
+ *   object, we'd have to compile it on every call.  Programs tend to do
+ *   this with the same handful of expressions over and over, often in
+ *   loops, so we keep the most recently used compiled patterns here, keyed
+ *   by the expression text.  (The compiled form depends only on the text;
+ *   case-folding options are applied by the searcher at match time.)
+ *   
+ *   The cache owns its patterns.  A pattern returned from get() remains
+ *   valid until the next call to get(); a caller that needs to hold onto a
+ *   pattern across other cache lookups must call add_ref(), and release()
+ *   when done, to keep the pattern from being evicted.  
+ */
+class CRegexCache
+{
+public:
+    CRegexCache(class CRegexParser *parser, size_t max_cnt);
+    ~CRegexCache();
+
+    /* get/set the maximum number of patterns we'll keep */
+    size_t get_max_cnt() const { return max_cnt_; }
+    void set_max_cnt(size_t cnt);
+
+    /*
+     *   Get the compiled pattern for an expression, compiling it and adding
+     *   it to the cache if it's not already there.  Returns null if the
+     *   expression doesn't compile, or if there's no room in the cache (if
+     *   the cache is disabled, or every entry is in use); the caller should
+     *   compile the expression itself in this case.  
+     */
+    re_compiled_pattern *get(const char *expr, size_t exprlen);
+
+    /* add a reference to a cached pattern, to keep it from being evicted */
+    void add_ref(re_compiled_pattern *pat);
+
+    /* release a reference added with add_ref() */
+    void release(re_compiled_pattern *pat);
+
+protected:
+    /* cache entry */
+    struct entry
+    {
+        /* next/previous entries in most-recently-used order */
+        entry *nxt;
+        entry *prv;
+
+        /* hash value and length of the expression text */
+        unsigned int hash;
+        size_t len;
+
+        /* the compiled pattern */
+        re_compiled_pattern *pat;
+
+        /* number of references added with add_ref() */
+        int refs;
+
+        /* the expression text (overallocated to the actual length) */
+        char expr[1];
+    };
+
+    /* find the entry for a pattern */
+    entry *find_pat(re_compiled_pattern *pat);
+
+    /* unlink an entry from the list */
+    void unlink(entry *e);
+
+    /* 
+     *   evict the least recently used entries that aren't in use, until we
+     *   have no more than 'cnt' entries 
+     */
+    void trim(size_t cnt);
+
+    /* our parser */
+    class CRegexParser *parser_;
+
+    /* head (most recently used) and tail of the entry list */
+    entry *head_;
+    entry *tail_;
+
+    /* number of entries, and the maximum number we'll keep */
+    size_t cnt_;
+    size_t max_cnt_;
+};
+
+/* default number of patterns to keep in a CRegexCache */
+#define RE_CACHE_DEFAULT_SIZE  32
+
 #endif /* VMREGEX_H */
 
@@ -0,0 +1,257 @@
+/*
+ *   Please see the accompanying license file, LICENSE.TXT, for information
+ *   on using and copying this software.
+ */
+/*
+Name
+  vmreplay.cpp - T3 VM command replay statistics
+Function
+  See vmreplay.h.
+Notes
+
+Modified
+  10/15/26  - Creation
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "t3std.h"
+#include "os.h"
+#include "vmglob.h"
+#include "vmobj.h"
+#include "vmreplay.h"
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Limits
+ */
+
+/* number of slowest commands we list in the report */
+const size_t VMREPLAY_SLOWEST = 10;
+
+/* number of characters of command text we keep for the slowest commands */
+const size_t VMREPLAY_CMD_LEN = 60;
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   One of the slowest commands 
+ */
+struct vmreplay_slow_cmd
+{
+    /* command number (from 1), latency and GC pause time, in milliseconds */
+    ulong num;
+    ulong ms;
+    ulong gc_ms;
+
+    /* the command text, truncated */
+    char cmd[VMREPLAY_CMD_LEN + 1];
+};
+
+/*
+ *   Statistics state.  Like the console's script stack, this is process
+ *   state; the replay covers whatever VM is reading the script.
+ */
+static struct
+{
+    /* report file name; null if we're not collecting statistics */
+    char *fname;
+
+    /* latencies of the finished commands, in milliseconds */
+    ulong *lat;
+    size_t lat_cnt;
+    size_t lat_alo;
+
+    /* the command in progress */
+    int in_cmd;
+    char cmd[VMREPLAY_CMD_LEN + 1];
+    long cmd_start;
+    vm_gc_stats cmd_gc;
+
+    /* the slowest commands so far, slowest first */
+    vmreplay_slow_cmd slow[VMREPLAY_SLOWEST];
+    size_t slow_cnt;
+
+    /* GC totals */
+    ulong gc_passes;
+    ulong gc_pause_ms;
+    ulong gc_max_pause_ms;
+
+    /* undo log high-water mark, sampled at the end of each command */
+    ulong undo_peak;
+} S;
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Start collecting statistics 
+ */
+void vm_replay_stats_start_from_env(VMG0_)
+{
+    const char *fname = getenv("T3_REPLAY_STATS");
+
+    /* if there's no file, or we're already running, there's nothing to do */
+    if (fname == 0 || fname[0] == '\0' || S.fname != 0)
+        return;
+
+    /* reset the statistics and remember the file */
+    memset(&S, 0, sizeof(S));
+    S.fname = lib_copy_str(fname);
+}
+
+/*
+ *   End the command in progress, if any 
+ */
+static void end_command(VMG0_)
+{
+    vm_gc_stats gc;
+    ulong ms, gc_ms;
+    size_t i;
+
+    /* if there's no command in progress, there's nothing to do */
+    if (!S.in_cmd)
+        return;
+    S.in_cmd = FALSE;
+
+    /* figure the latency and the GC activity during the command */
+    ms = (ulong)(os_get_sys_clock_ms() - S.cmd_start);
+    G_obj_table->get_gc_stats(vmg_ &gc);
+    gc_ms = gc.total_pause_ms - S.cmd_gc.total_pause_ms;
+    S.gc_passes += gc.passes - S.cmd_gc.passes;
+    S.gc_pause_ms += gc_ms;
+    if (gc.max_pause_ms > S.gc_max_pause_ms)
+        S.gc_max_pause_ms = gc.max_pause_ms;
+    if (gc.undo_bytes > S.undo_peak)
+        S.undo_peak = gc.undo_bytes;
+
+    /* add the latency to the list */
+    if (S.lat_cnt == S.lat_alo)
+    {
+        if (S.lat == 0)
+        {
+            S.lat_alo = 256;
+            S.lat = (ulong *)t3malloc(S.lat_alo * sizeof(S.lat[0]));
+        }
+        else
+        {
+            S.lat_alo *= 2;
+            S.lat = (ulong *)t3realloc(S.lat, S.lat_alo * sizeof(S.lat[0]));
+        }
+    }
+    S.lat[S.lat_cnt++] = ms;
+
+    /* if it's among the slowest commands, insert it in the slow list */
+    for (i = S.slow_cnt ; i > 0 && S.slow[i-1].ms < ms ; --i) ;
+    if (i < VMREPLAY_SLOWEST)
+    {
+        if (S.slow_cnt < VMREPLAY_SLOWEST)
+            ++S.slow_cnt;
+        memmove(&S.slow[i+1], &S.slow[i],
+                (S.slow_cnt - i - 1) * sizeof(S.slow[0]));
+        S.slow[i].num = S.lat_cnt;
+        S.slow[i].ms = ms;
+        S.slow[i].gc_ms = gc_ms;
+        strcpy(S.slow[i].cmd, S.cmd);
+    }
+}
+
+/*
+ *   Note a command 
+ */
+void vm_replay_stats_command(VMG_ const char *cmd)
+{
+    size_t len;
+
+    /* if we're not collecting statistics, ignore it */
+    if (S.fname == 0)
+        return;
+
+    /* the previous command ends when the next one is read */
+    end_command(vmg0_);
+
+    /* start the new command */
+    S.in_cmd = TRUE;
+    len = strlen(cmd);
+    while (len > 0 && (cmd[len-1] == '\n' || cmd[len-1] == '\r'))
+        --len;
+    if (len > VMREPLAY_CMD_LEN)
+        len = VMREPLAY_CMD_LEN;
+    memcpy(S.cmd, cmd, len);
+    S.cmd[len] = '\0';
+    G_obj_table->get_gc_stats(vmg_ &S.cmd_gc);
+    S.cmd_start = os_get_sys_clock_ms();
+}
+
+/*
+ *   comparison callback for sorting the latencies 
+ */
+static int cmp_lat(const void *a, const void *b)
+{
+    ulong la = *(const ulong *)a, lb = *(const ulong *)b;
+    return (la < lb ? -1 : la > lb ? 1 : 0);
+}
+
+/*
+ *   get a percentile from the sorted latency list 
+ */
+static ulong percentile(int pct)
+{
+    return S.lat[(S.lat_cnt - 1) * pct / 100];
+}
+
+/*
+ *   Stop, and write the report 
+ */
+void vm_replay_stats_stop(VMG0_)
+{
+    vm_gc_stats gc;
+    FILE *fp;
+    ulong total;
+    size_t i;
+
+    /* if we're not collecting statistics, there's nothing to do */
+    if (S.fname == 0)
+        return;
+
+    /* finish the last command */
+    end_command(vmg0_);
+
+    /* if we timed any commands, write the report */
+    if (S.lat_cnt != 0 && (fp = fopen(S.fname, "w")) != 0)
+    {
+        /* add up the total time, then sort for the percentiles */
+        for (total = 0, i = 0 ; i < S.lat_cnt ; ++i)
+            total += S.lat[i];
+        qsort(S.lat, S.lat_cnt, sizeof(S.lat[0]), cmp_lat);
+
+        /* get the final undo state */
+        G_obj_table->get_gc_stats(vmg_ &gc);
+
+        fprintf(fp, "commands: %lu\n", (ulong)S.lat_cnt);
+        fprintf(fp, "latency (ms): total %lu, mean %.1f, p50 %lu, p90 %lu, "
+                "p99 %lu, max %lu\n",
+                total, (double)total / S.lat_cnt, percentile(50),
+                percentile(90), percentile(99), S.lat[S.lat_cnt - 1]);
+        fprintf(fp, "gc: %lu passes, %lu ms paused, longest pause %lu ms\n",
+                S.gc_passes, S.gc_pause_ms, S.gc_max_pause_ms);
+        fprintf(fp, "undo: peak %lu bytes, final %lu bytes in %lu "
+                "savepoints\n",
+                S.undo_peak, gc.undo_bytes, gc.undo_savepts);
+        fprintf(fp, "slowest commands:\n");
+        fprintf(fp, "%8s %8s %8s  %s\n", "number", "ms", "gc ms", "command");
+        for (i = 0 ; i < S.slow_cnt ; ++i)
+            fprintf(fp, "%8lu %8lu %8lu  %s\n", S.slow[i].num, S.slow[i].ms,
+                    S.slow[i].gc_ms, S.slow[i].cmd);
+
+        fclose(fp);
+    }
+
+    /* done with the statistics */
+    lib_free_str(S.fname);
+    if (S.lat != 0)
+        t3free(S.lat);
+    memset(&S, 0, sizeof(S));
+}
@@ -0,0 +1,49 @@
+/*
+ *   Please see the accompanying license file, LICENSE.TXT, for information
+ *   on using and copying this software.
+ */
+/*
+Name
+  vmreplay.h - T3 VM command replay statistics
+Function
+  Measures how long the program takes to respond to each command read from
+  a command script, so that interpreter builds can be compared on a real
+  game by replaying a walkthrough through the console's ordinary script
+  input facility.
+
+  A command's latency runs from the moment its line is read from the
+  script until the program asks for the next line of input.  For each
+  command we also note the garbage collection passes and pause time, and
+  the undo log size when it finishes.  When the outermost script ends (or
+  the program terminates), we write a report with latency percentiles, GC
+  and undo totals, and the slowest commands.
+Notes
+  Timings come from os_get_sys_clock_ms(), so they have millisecond
+  resolution.  Only line input is timed; events read from an event script
+  by inputEvent() don't start a new command.
+Modified
+  10/15/26  - Creation
+*/
+
+#ifndef VMREPLAY_H
+#define VMREPLAY_H
+
+#include "vmglob.h"
+
+/*
+ *   Start collecting replay statistics if requested through the
+ *   environment.  If the variable T3_REPLAY_STATS is set, it gives the name
+ *   of the report file.
+ */
+void vm_replay_stats_start_from_env(VMG0_);
+
+/* note that a command line was read from a script */
+void vm_replay_stats_command(VMG_ const char *cmd);
+
+/* 
+ *   end the current command, write the report (if there's anything to
+ *   report), and stop collecting statistics 
+ */
+void vm_replay_stats_stop(VMG0_);
+
+#endif /* VMREPLAY_H */
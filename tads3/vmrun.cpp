@@ -48,6 +48,113 @@ Modified
 #include "vmbignum.h"
 
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Threaded opcode dispatch.  If VMRUN_THREADED_DISPATCH is defined (see
+ *   qtads.pro), and the compiler supports the GNU "labels as values"
+ *   extension, we dispatch each instruction through a jump table of label
+ *   addresses ("computed goto") rather than through the main 'switch' in
+ *   CVmRun::run().  This lets the compiler replicate the indirect jump at
+ *   the end of each instruction handler, so each opcode gets its own
+ *   branch-prediction history, which is noticeably faster on modern CPUs.
+ *   
+ *   The 'switch' remains in place either way - handlers are still 'case'
+ *   labels in the same block of code, and 'continue' and 'break' work the
+ *   same way in both modes - so compilers without the extension (MSVC, for
+ *   example) simply use the switch.  
+ */
+#if defined(VMRUN_THREADED_DISPATCH) && defined(__GNUC__)
+# define VMRUN_COMPUTED_GOTO
+#endif
+
+#ifdef VMRUN_COMPUTED_GOTO
+# define VMRUN_CASE(op) case op: vmrun_op_##op
+# define VMRUN_DISPATCH_ENTRY(op) dispatch_tbl[op] = &&vmrun_op_##op
+#else
+# define VMRUN_CASE(op) case op
+#endif
+
+/*
+ *   Proceed to the next instruction.  Handlers use this in place of a plain
+ *   'continue' so that, in threaded mode, each handler ends with its own
+ *   copy of the dispatch jump.  The debugger has to look at every
+ *   instruction at the top of the loop, so debugger builds always go back
+ *   through the loop.  
+ */
+#if defined(VMRUN_COMPUTED_GOTO) && !defined(VM_DEBUGGER) \
+    && !defined(VM_OPSTATS)
+# define VMRUN_NEXT  last_pc = p; goto *dispatch_tbl[*p++]
+#else
+# define VMRUN_NEXT  continue
+#endif
+
+/*
+ *   Fused instruction pairs ("super-instructions").  A few instruction
+ *   pairs occur often enough that it's worth executing them with a single
+ *   dispatch: the handler for the first instruction peeks at the next
+ *   opcode, and if it's the expected partner, carries out both
+ *   instructions at once.  The code itself is never rewritten, so every
+ *   PC the debugger, profiler or exception tables see is still exact;
+ *   when a fused handler moves on to the second instruction, it updates
+ *   last_pc so that errors are reported against the right instruction.
+ *   
+ *   The debugger needs to see every instruction individually, so we don't
+ *   fuse anything in debugger builds, nor in opcode statistics builds
+ *   (which exist to find the instruction sequences worth fusing).  Define
+ *   VMRUN_NO_FUSED_OPS to turn this off for other builds.  
+ */
+#if !defined(VM_DEBUGGER) && !defined(VM_OPSTATS) \
+    && !defined(VMRUN_NO_FUSED_OPS)
+# define VMRUN_FUSED_OPS
+#endif
+
+/*
+ *   Push the boolean result of a comparison instruction.  With fused
+ *   instructions enabled, if the next instruction is a conditional jump
+ *   that simply tests the result, we take the jump decision directly
+ *   rather than pushing the result and popping it right back off.  
+ */
+#ifdef VMRUN_FUSED_OPS
+# define VMRUN_PUSH_CMP(expr) \
+    { \
+        int cond_ = (expr); \
+        if (*p == OPC_JNIL || *p == OPC_JF) \
+        { \
+            last_pc = p++; \
+            p += (!cond_ ? osrp2s(p) : 2); \
+        } \
+        else if (*p == OPC_JNOTNIL || *p == OPC_JT) \
+        { \
+            last_pc = p++; \
+            p += (cond_ ? osrp2s(p) : 2); \
+        } \
+        else \
+            push_bool(vmg_ cond_); \
+    }
+#else
+# define VMRUN_PUSH_CMP(expr) push_bool(vmg_ (expr))
+#endif
+
+/*
+ *   Finish an integer arithmetic instruction whose result is at top of
+ *   stack.  With fused instructions enabled, if the next instruction just
+ *   stores the result in a local (SETLCL1), we store it directly rather
+ *   than dispatching SETLCL1 to pop it back off the stack.  
+ */
+#ifdef VMRUN_FUSED_OPS
+# define VMRUN_INT_RESULT(valp) \
+    if (*p == OPC_SETLCL1) \
+    { \
+        last_pc = p; \
+        *get_local(vmg_ p[1]) = *(valp); \
+        discard(); \
+        p += 2; \
+    }
+#else
+# define VMRUN_INT_RESULT(valp)
+#endif
+
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Define static global variables for certain VM registers, if we're
@@ -71,6 +178,9 @@ VM_IF_REGS_IN_GLOBALS(const uchar **pc_ptr_;)
 /*
  *   Initialize 
  */
+/* exception table cache generation; start at 1 so empty slots are invalid */
+unsigned long CVmRun::exc_cache_gen_ = 1;
+
 CVmRun::CVmRun(size_t max_depth, size_t reserve_depth)
     : CVmStack(max_depth, reserve_depth)
 {
@@ -103,9 +213,15 @@ void CVmRun::init()
     /* no debugger halt requested yet */
     halt_vm_ = FALSE;
 
+    /* start counting calls toward the first os_yield() */
+    yield_cnt_ = VMRUN_YIELD_CALLS;
+
     /* we have no program counter yet */
     pc_ptr_ = 0;
 
+    /* the exception table cache is empty */
+    memset(exc_cache_, 0, sizeof(exc_cache_));
+
     /*
      *   If we're including the profiler in the build, allocate and
      *   initialize its memory structures. 
@@ -143,6 +259,14 @@ CVmRun::~CVmRun()
 
 void CVmRun::terminate()
 {
+    /* delete the exception table cache */
+    for (size_t i = 0 ; i < VMRUN_EXC_CACHE_SIZE ; ++i)
+    {
+        if (exc_cache_[i].ent != 0)
+            t3free(exc_cache_[i].ent);
+    }
+    memset(exc_cache_, 0, sizeof(exc_cache_));
+
     /*
      *   If we're including the profiler in the build, delete its memory
      *   structures.  
@@ -816,10 +940,23 @@ public:
         switch(self.typ)
         {
         case VM_OBJ:
-            /* get the property value from the target object */
-            return vm_objp(vmg_ self.val.obj)
-                ->get_prop(vmg_ target_prop, &val, self.val.obj,
-                           &defining_obj, &argc);
+            {
+                CVmObject *objp = vm_objp(vmg_ self.val.obj);
+
+                /* 
+                 *   for an ordinary TadsObject, use the call-site cache,
+                 *   keyed on the return address for this instruction 
+                 */
+                if (objp->get_metaclass_reg() == CVmObjTads::metaclass_reg_)
+                    return ((CVmObjTads *)objp)->get_prop_at_site(
+                        vmg_ G_interpreter->get_entry_ptr() + caller_ofs,
+                        target_prop, &val, self.val.obj,
+                        &defining_obj, &argc);
+
+                /* get the property value from the target object */
+                return objp->get_prop(vmg_ target_prop, &val, self.val.obj,
+                                      &defining_obj, &argc);
+            }
 
         case VM_LIST:
             f_const_get_prop = &CVmObjList::const_get_prop;
@@ -1149,6 +1286,195 @@ void CVmRun::run(VMG_ const uchar *start_pc)
     old_pc_ptr = pc_ptr_;
     pc_ptr_ = &last_pc;
 
+#ifdef VMRUN_COMPUTED_GOTO
+    /* 
+     *   Set up the threaded dispatch table the first time through.  The
+     *   table has to be built here, since the label addresses are local to
+     *   this function; any slot we don't fill in is an invalid opcode.  
+     */
+    static void *dispatch_tbl[256];
+    static int dispatch_tbl_inited = FALSE;
+    if (!dispatch_tbl_inited)
+    {
+        int i;
+
+        /* start with every opcode pointing to the invalid opcode handler */
+        for (i = 0 ; i < 256 ; ++i)
+            dispatch_tbl[i] = &&vmrun_op_invalid;
+
+        /* fill in the handlers for the opcodes we implement */
+        VMRUN_DISPATCH_ENTRY(OPC_GETARGN0);
+        VMRUN_DISPATCH_ENTRY(OPC_GETPROPSELF);
+        VMRUN_DISPATCH_ENTRY(OPC_GETR0);
+        VMRUN_DISPATCH_ENTRY(OPC_DUPR0);
+        VMRUN_DISPATCH_ENTRY(OPC_GETSETLCL1R0);
+        VMRUN_DISPATCH_ENTRY(OPC_GETSETLCL1);
+        VMRUN_DISPATCH_ENTRY(OPC_SETPROPSELF);
+        VMRUN_DISPATCH_ENTRY(OPC_SETLCL1R0);
+        VMRUN_DISPATCH_ENTRY(OPC_GETARGN1);
+        VMRUN_DISPATCH_ENTRY(OPC_GETLCLN0);
+        VMRUN_DISPATCH_ENTRY(OPC_SETLCL1);
+        VMRUN_DISPATCH_ENTRY(OPC_PUSHSELF);
+        VMRUN_DISPATCH_ENTRY(OPC_RETNIL);
+        VMRUN_DISPATCH_ENTRY(OPC_RETVAL);
+        VMRUN_DISPATCH_ENTRY(OPC_GETPROPLCL1);
+        VMRUN_DISPATCH_ENTRY(OPC_JNIL);
+        VMRUN_DISPATCH_ENTRY(OPC_RET);
+        VMRUN_DISPATCH_ENTRY(OPC_PUSHENUM);
+        VMRUN_DISPATCH_ENTRY(OPC_JMP);
+        VMRUN_DISPATCH_ENTRY(OPC_JNE);
+        VMRUN_DISPATCH_ENTRY(OPC_JR0F);
+        VMRUN_DISPATCH_ENTRY(OPC_GETARGN2);
+        VMRUN_DISPATCH_ENTRY(OPC_JGT);
+        VMRUN_DISPATCH_ENTRY(OPC_CALLPROPSELF);
+        VMRUN_DISPATCH_ENTRY(OPC_INDEX);
+        VMRUN_DISPATCH_ENTRY(OPC_DUP);
+        VMRUN_DISPATCH_ENTRY(OPC_IDXLCL1INT8);
+        VMRUN_DISPATCH_ENTRY(OPC_GETLCLN2);
+        VMRUN_DISPATCH_ENTRY(OPC_CALLPROP);
+        VMRUN_DISPATCH_ENTRY(OPC_GETLCLN1);
+        VMRUN_DISPATCH_ENTRY(OPC_GETARGN3);
+        VMRUN_DISPATCH_ENTRY(OPC_GETLCLN3);
+        VMRUN_DISPATCH_ENTRY(OPC_JNOTNIL);
+        VMRUN_DISPATCH_ENTRY(OPC_ITERNEXT);
+        VMRUN_DISPATCH_ENTRY(OPC_PUSH_0);
+        VMRUN_DISPATCH_ENTRY(OPC_GETPROP);
+        VMRUN_DISPATCH_ENTRY(OPC_GETLCLN4);
+        VMRUN_DISPATCH_ENTRY(OPC_JE);
+        VMRUN_DISPATCH_ENTRY(OPC_PUSHNIL);
+        VMRUN_DISPATCH_ENTRY(OPC_PUSHTRUE);
+        VMRUN_DISPATCH_ENTRY(OPC_PUSH_1);
+        VMRUN_DISPATCH_ENTRY(OPC_PUSHINT8);
+        VMRUN_DISPATCH_ENTRY(OPC_PUSHINT);
+        VMRUN_DISPATCH_ENTRY(OPC_INC);
+        VMRUN_DISPATCH_ENTRY(OPC_ADD);
+        VMRUN_DISPATCH_ENTRY(OPC_DEC);
+        VMRUN_DISPATCH_ENTRY(OPC_SUB);
+        VMRUN_DISPATCH_ENTRY(OPC_PUSHSTR);
+        VMRUN_DISPATCH_ENTRY(OPC_DISC);
+        VMRUN_DISPATCH_ENTRY(OPC_DISC1);
+        VMRUN_DISPATCH_ENTRY(OPC_PUSHLST);
+        VMRUN_DISPATCH_ENTRY(OPC_PUSHOBJ);
+        VMRUN_DISPATCH_ENTRY(OPC_PUSHPROPID);
+        VMRUN_DISPATCH_ENTRY(OPC_PUSHFNPTR);
+        VMRUN_DISPATCH_ENTRY(OPC_PUSHPARLST);
+        VMRUN_DISPATCH_ENTRY(OPC_MAKELSTPAR);
+        VMRUN_DISPATCH_ENTRY(OPC_NEG);
+        VMRUN_DISPATCH_ENTRY(OPC_BNOT);
+        VMRUN_DISPATCH_ENTRY(OPC_MUL);
+        VMRUN_DISPATCH_ENTRY(OPC_DIV);
+        VMRUN_DISPATCH_ENTRY(OPC_MOD);
+        VMRUN_DISPATCH_ENTRY(OPC_BAND);
+        VMRUN_DISPATCH_ENTRY(OPC_BOR);
+        VMRUN_DISPATCH_ENTRY(OPC_SHL);
+        VMRUN_DISPATCH_ENTRY(OPC_ASHR);
+        VMRUN_DISPATCH_ENTRY(OPC_LSHR);
+        VMRUN_DISPATCH_ENTRY(OPC_XOR);
+        VMRUN_DISPATCH_ENTRY(OPC_NOT);
+        VMRUN_DISPATCH_ENTRY(OPC_BOOLIZE);
+        VMRUN_DISPATCH_ENTRY(OPC_EQ);
+        VMRUN_DISPATCH_ENTRY(OPC_NE);
+        VMRUN_DISPATCH_ENTRY(OPC_LT);
+        VMRUN_DISPATCH_ENTRY(OPC_LE);
+        VMRUN_DISPATCH_ENTRY(OPC_GT);
+        VMRUN_DISPATCH_ENTRY(OPC_GE);
+        VMRUN_DISPATCH_ENTRY(OPC_VARARGC);
+        VMRUN_DISPATCH_ENTRY(OPC_NAMEDARGPTR);
+        VMRUN_DISPATCH_ENTRY(OPC_NAMEDARGTAB);
+        VMRUN_DISPATCH_ENTRY(OPC_CALL);
+        VMRUN_DISPATCH_ENTRY(OPC_PTRCALL);
+        VMRUN_DISPATCH_ENTRY(OPC_RETTRUE);
+        VMRUN_DISPATCH_ENTRY(OPC_GETPROPR0);
+        VMRUN_DISPATCH_ENTRY(OPC_CALLPROPLCL1);
+        VMRUN_DISPATCH_ENTRY(OPC_CALLPROPR0);
+        VMRUN_DISPATCH_ENTRY(OPC_PTRCALLPROP);
+        VMRUN_DISPATCH_ENTRY(OPC_PTRCALLPROPSELF);
+        VMRUN_DISPATCH_ENTRY(OPC_OBJGETPROP);
+        VMRUN_DISPATCH_ENTRY(OPC_OBJCALLPROP);
+        VMRUN_DISPATCH_ENTRY(OPC_GETLCL1);
+        VMRUN_DISPATCH_ENTRY(OPC_GETLCLN5);
+        VMRUN_DISPATCH_ENTRY(OPC_GETLCL2);
+        VMRUN_DISPATCH_ENTRY(OPC_GETARG1);
+        VMRUN_DISPATCH_ENTRY(OPC_GETARG2);
+        VMRUN_DISPATCH_ENTRY(OPC_SETSELF);
+        VMRUN_DISPATCH_ENTRY(OPC_STORECTX);
+        VMRUN_DISPATCH_ENTRY(OPC_LOADCTX);
+        VMRUN_DISPATCH_ENTRY(OPC_PUSHCTXELE);
+        VMRUN_DISPATCH_ENTRY(OPC_GETARGC);
+        VMRUN_DISPATCH_ENTRY(OPC_DUP2);
+        VMRUN_DISPATCH_ENTRY(OPC_SWITCH);
+        VMRUN_DISPATCH_ENTRY(OPC_JT);
+        VMRUN_DISPATCH_ENTRY(OPC_JR0T);
+        VMRUN_DISPATCH_ENTRY(OPC_JF);
+        VMRUN_DISPATCH_ENTRY(OPC_JGE);
+        VMRUN_DISPATCH_ENTRY(OPC_JLT);
+        VMRUN_DISPATCH_ENTRY(OPC_JLE);
+        VMRUN_DISPATCH_ENTRY(OPC_JST);
+        VMRUN_DISPATCH_ENTRY(OPC_JSF);
+        VMRUN_DISPATCH_ENTRY(OPC_LJSR);
+        VMRUN_DISPATCH_ENTRY(OPC_LRET);
+        VMRUN_DISPATCH_ENTRY(OPC_SWAP);
+        VMRUN_DISPATCH_ENTRY(OPC_SWAP2);
+        VMRUN_DISPATCH_ENTRY(OPC_SWAPN);
+        VMRUN_DISPATCH_ENTRY(OPC_GETSPN);
+        VMRUN_DISPATCH_ENTRY(OPC_SAY);
+        VMRUN_DISPATCH_ENTRY(OPC_SAYVAL);
+        VMRUN_DISPATCH_ENTRY(OPC_INHERIT);
+        VMRUN_DISPATCH_ENTRY(OPC_PTRINHERIT);
+        VMRUN_DISPATCH_ENTRY(OPC_EXPINHERIT);
+        VMRUN_DISPATCH_ENTRY(OPC_PTREXPINHERIT);
+        VMRUN_DISPATCH_ENTRY(OPC_DELEGATE);
+        VMRUN_DISPATCH_ENTRY(OPC_PTRDELEGATE);
+        VMRUN_DISPATCH_ENTRY(OPC_BUILTIN_A);
+        VMRUN_DISPATCH_ENTRY(OPC_BUILTIN_B);
+        VMRUN_DISPATCH_ENTRY(OPC_BUILTIN_C);
+        VMRUN_DISPATCH_ENTRY(OPC_BUILTIN_D);
+        VMRUN_DISPATCH_ENTRY(OPC_BUILTIN1);
+        VMRUN_DISPATCH_ENTRY(OPC_BUILTIN2);
+        VMRUN_DISPATCH_ENTRY(OPC_IDXINT8);
+        VMRUN_DISPATCH_ENTRY(OPC_NEW1);
+        VMRUN_DISPATCH_ENTRY(OPC_TRNEW1);
+        VMRUN_DISPATCH_ENTRY(OPC_NEW2);
+        VMRUN_DISPATCH_ENTRY(OPC_TRNEW2);
+        VMRUN_DISPATCH_ENTRY(OPC_NOP);
+        VMRUN_DISPATCH_ENTRY(OPC_INCLCL);
+        VMRUN_DISPATCH_ENTRY(OPC_DECLCL);
+        VMRUN_DISPATCH_ENTRY(OPC_ADDILCL1);
+        VMRUN_DISPATCH_ENTRY(OPC_ADDILCL4);
+        VMRUN_DISPATCH_ENTRY(OPC_ADDTOLCL);
+        VMRUN_DISPATCH_ENTRY(OPC_SUBFROMLCL);
+        VMRUN_DISPATCH_ENTRY(OPC_ZEROLCL1);
+        VMRUN_DISPATCH_ENTRY(OPC_ZEROLCL2);
+        VMRUN_DISPATCH_ENTRY(OPC_NILLCL1);
+        VMRUN_DISPATCH_ENTRY(OPC_NILLCL2);
+        VMRUN_DISPATCH_ENTRY(OPC_ONELCL1);
+        VMRUN_DISPATCH_ENTRY(OPC_ONELCL2);
+        VMRUN_DISPATCH_ENTRY(OPC_SETLCL2);
+        VMRUN_DISPATCH_ENTRY(OPC_SETARG1);
+        VMRUN_DISPATCH_ENTRY(OPC_SETARG2);
+        VMRUN_DISPATCH_ENTRY(OPC_SETIND);
+        VMRUN_DISPATCH_ENTRY(OPC_SETINDLCL1I8);
+        VMRUN_DISPATCH_ENTRY(OPC_SETPROP);
+        VMRUN_DISPATCH_ENTRY(OPC_PTRSETPROP);
+        VMRUN_DISPATCH_ENTRY(OPC_OBJSETPROP);
+        VMRUN_DISPATCH_ENTRY(OPC_PUSHSTRI);
+        VMRUN_DISPATCH_ENTRY(OPC_PUSHBIFPTR);
+        VMRUN_DISPATCH_ENTRY(OPC_THROW);
+        VMRUN_DISPATCH_ENTRY(OPC_GETPROPDATA);
+        VMRUN_DISPATCH_ENTRY(OPC_PTRGETPROPDATA);
+        VMRUN_DISPATCH_ENTRY(OPC_GETDBARGC);
+        VMRUN_DISPATCH_ENTRY(OPC_GETDBLCL);
+        VMRUN_DISPATCH_ENTRY(OPC_GETDBARG);
+        VMRUN_DISPATCH_ENTRY(OPC_SETDBLCL);
+        VMRUN_DISPATCH_ENTRY(OPC_SETDBARG);
+        VMRUN_DISPATCH_ENTRY(OPC_BP);
+        VMRUN_DISPATCH_ENTRY(OPC_CALLEXT);
+
+        /* the table is now ready */
+        dispatch_tbl_inited = TRUE;
+    }
+#endif /* VMRUN_COMPUTED_GOTO */
+
     /* we're not done yet */
     done = FALSE;
 
@@ -1226,6 +1552,10 @@ resume_execution:
              */
             last_pc = p;
 
+            /* count the instruction, if we're gathering opcode statistics */
+            VM_IF_OPSTATS(if (profiling_)
+                prof_count_op(*p));
+
             /* 
              *   Execute the current instruction.
              *   
@@ -1239,134 +1569,156 @@ resume_execution:
              *   machines, and even if it doesn't help on a given machine, it
              *   shouldn't do any harm relative to a randomly ordered case
              *   table.  
+             *   
+             *   In threaded dispatch mode, we jump straight to the handler
+             *   through the label table, bypassing the switch itself (but
+             *   not its body - see VMRUN_COMPUTED_GOTO above).  
              */
+#ifdef VMRUN_COMPUTED_GOTO
+            goto *dispatch_tbl[*p++];
+#endif
             switch(*p++)
             {
-            case OPC_GETARGN0:
+            VMRUN_CASE(OPC_GETARGN0):
                 push(get_param(vmg_ 0));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETPROPSELF:
+            VMRUN_CASE(OPC_GETPROPSELF):
                 /* evaluate the property of 'self' */
                 prop = get_op_uint16(&p);
                 p = propev.get_prop(
                     vmg_ p - entry_ptr_native_, get_self(vmg0_), prop);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETR0:
+            VMRUN_CASE(OPC_GETR0):
                 /* push the contents of R0 */
                 push(&r0_);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_DUPR0:
+            VMRUN_CASE(OPC_DUPR0):
                 /* push the contents of R0 twice */
                 push(&r0_);
                 push(&r0_);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETSETLCL1R0:
+            VMRUN_CASE(OPC_GETSETLCL1R0):
                 /* set local from R0 and leave value on stack */
                 push(&r0_);
                 *get_local(vmg_ get_op_uint8(&p)) = r0_;
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETSETLCL1:
+            VMRUN_CASE(OPC_GETSETLCL1):
                 /* set local and leave value on stack */
                 *get_local(vmg_ get_op_uint8(&p)) = *get(0);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SETPROPSELF:
+            VMRUN_CASE(OPC_SETPROPSELF):
                 /* get the value to set */
                 pop(&val);
 
                 /* set it */
                 set_prop(vmg_ get_self(vmg0_), get_op_uint16(&p), &val);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SETLCL1R0:
+            VMRUN_CASE(OPC_SETLCL1R0):
                 /* store R0 in the specific local */
                 *get_local(vmg_ get_op_uint8(&p)) = r0_;
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETARGN1:
+            VMRUN_CASE(OPC_GETARGN1):
                 push(get_param(vmg_ 1));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETLCLN0:
+            VMRUN_CASE(OPC_GETLCLN0):
                 push(get_local(vmg_ 0));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SETLCL1:
+            VMRUN_CASE(OPC_SETLCL1):
                 /* get a pointer to the local */
                 valp = get_local(vmg_ get_op_uint8(&p));
 
                 /* pop the value into the local */
                 pop(valp);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PUSHSELF:
+            VMRUN_CASE(OPC_PUSHSELF):
+#ifdef VMRUN_FUSED_OPS
+                /* PUSHSELF + CALLPROP: call the property of 'self' directly */
+                if (*p == OPC_CALLPROP)
+                {
+                    /* move on to the CALLPROP */
+                    last_pc = p++;
+
+                    /* evaluate the property of 'self' */
+                    propev.self = *get_self_val(vmg0_);
+                    argc = get_op_uint8(&p);
+                    prop = get_op_uint16(&p);
+                    p = propev.get_prop(vmg_ p - entry_ptr_native_, prop, argc);
+                    VMRUN_NEXT;
+                }
+#endif
                 /* push 'self' */
                 push(get_self_val(vmg0_));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_RETNIL:
+            VMRUN_CASE(OPC_RETNIL):
                 /* store nil in R0 */
                 r0_.set_nil();
 
                 /* return */
                 if ((p = do_return(vmg0_)) == 0)
                     goto exit_loop;
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_RETVAL:
+            VMRUN_CASE(OPC_RETVAL):
                 /* pop the return value into R0 */
                 pop(&r0_);
 
                 /* return */
                 if ((p = do_return(vmg0_)) == 0)
                     goto exit_loop;
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETPROPLCL1:
+            VMRUN_CASE(OPC_GETPROPLCL1):
                 /* get the local whose property we're evaluating */
                 propev.self = *get_local(vmg_ get_op_uint8(&p));
 
                 /* evaluate the property of the local variable */
                 prop = get_op_uint16(&p);
                 p = propev.get_prop(vmg_ p - entry_ptr_native_, prop);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_JNIL:
+            VMRUN_CASE(OPC_JNIL):
                 /* jump if top of stack is nil */
                 valp = get(0);
                 p += (valp->typ == VM_NIL ? osrp2s(p) : 2);
 
                 /* discard the top value, regardless of what happened */
                 discard();
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_RET:
+            VMRUN_CASE(OPC_RET):
                 /* return, leaving R0 unchanged */
                 if ((p = do_return(vmg0_)) == 0)
                     goto exit_loop;
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PUSHENUM:
+            VMRUN_CASE(OPC_PUSHENUM):
                 /* push a UINT4 operand value */
                 push()->set_enum(get_op_uint32(&p));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_JMP:
+            VMRUN_CASE(OPC_JMP):
                 /* unconditionally jump to the given offset */
                 p += osrp2s(p);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_JNE:
+            VMRUN_CASE(OPC_JNE):
                 /* jump if the two values at top of stack are not equal */
                 p += (!pop2_equal(vmg0_) ? osrp2s(p) : 2);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_JR0F:
+            VMRUN_CASE(OPC_JR0F):
                 /* 
                  *   if R0 is true, or it's a non-zero numeric value, or any
                  *   non-numeric and non-boolean value, stay put; otherwise,
@@ -1382,18 +1734,18 @@ resume_execution:
                     /* it's non-zero and non-nil - do not jump */
                     p += 2;
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETARGN2:
+            VMRUN_CASE(OPC_GETARGN2):
                 push(get_param(vmg_ 2));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_JGT:
+            VMRUN_CASE(OPC_JGT):
                 /* jump if greater */
                 p += (pop2_compare_gt(vmg0_) ? osrp2s(p) : 2);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_CALLPROPSELF:
+            VMRUN_CASE(OPC_CALLPROPSELF):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -1402,9 +1754,9 @@ resume_execution:
                 propev.self.set_obj(get_self(vmg0_));
                 prop = get_op_uint16(&p);
                 p = propev.get_prop(vmg_ p - entry_ptr_native_, prop, argc);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_INDEX:
+            VMRUN_CASE(OPC_INDEX):
                 /* index TOS-1 by TOS, storing the result at TOS-1 */
                 valp = get(1);
                 if (apply_index(vmg_ valp, valp, get(0)))
@@ -1420,14 +1772,14 @@ resume_execution:
                                     &val, G_predef->operator_idx, 1,
                                     VMERR_CANNOT_INDEX_TYPE);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_DUP:
+            VMRUN_CASE(OPC_DUP):
                 /* re-push the item at top of stack */
                 push(get(0));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_IDXLCL1INT8:
+            VMRUN_CASE(OPC_IDXLCL1INT8):
                 /* get the local */
                 valp = get_local(vmg_ get_op_uint8(&p));
 
@@ -1449,13 +1801,13 @@ resume_execution:
                                     valp, G_predef->operator_idx, 1,
                                     VMERR_CANNOT_INDEX_TYPE);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETLCLN2:
+            VMRUN_CASE(OPC_GETLCLN2):
                 push(get_local(vmg_ 2));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_CALLPROP:
+            VMRUN_CASE(OPC_CALLPROP):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -1466,30 +1818,30 @@ resume_execution:
                 /* evaluate the property given by the immediate data */
                 prop = get_op_uint16(&p);
                 p = propev.get_prop(vmg_ p - entry_ptr_native_, prop, argc);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETLCLN1:
+            VMRUN_CASE(OPC_GETLCLN1):
                 push(get_local(vmg_ 1));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETARGN3:
+            VMRUN_CASE(OPC_GETARGN3):
                 push(get_param(vmg_ 3));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETLCLN3:
+            VMRUN_CASE(OPC_GETLCLN3):
                 push(get_local(vmg_ 3));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_JNOTNIL:
+            VMRUN_CASE(OPC_JNOTNIL):
                 /* jump if top of stack is not nil */
                 valp = get(0);
                 p += (valp->typ != VM_NIL ? osrp2s(p) : 2);
 
                 /* discard the top value, regardless of what happened */
                 discard();
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_ITERNEXT:
+            VMRUN_CASE(OPC_ITERNEXT):
                 /* get the iterator object from the local */
                 valp = get_local(vmg_ get_op_uint16(&p));
 
@@ -1509,28 +1861,28 @@ resume_execution:
                 }
                 break;
 
-            case OPC_PUSH_0:
+            VMRUN_CASE(OPC_PUSH_0):
                 /* push the constant value 0 */
                 push()->set_int(0);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETPROP:
+            VMRUN_CASE(OPC_GETPROP):
                 /* get the object whose property we're fetching */
                 pop(&propev.self);
 
                 /* evaluate the property */
                 prop = get_op_uint16(&p);
                 p = propev.get_prop(vmg_ p - entry_ptr_native_, prop);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETLCLN4:
+            VMRUN_CASE(OPC_GETLCLN4):
                 push(get_local(vmg_ 4));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_JE:
+            VMRUN_CASE(OPC_JE):
                 /* jump if the two values at top of stack are equal */
                 p += (pop2_equal(vmg0_) ? osrp2s(p) : 2);
-                continue;
+                VMRUN_NEXT;
 
                 /* 
                  *   End of case table sorting by instruction execution
@@ -1540,32 +1892,32 @@ resume_execution:
                  *   only so large.  
                  */
 
-            case OPC_PUSHNIL:
+            VMRUN_CASE(OPC_PUSHNIL):
                 /* push nil */
                 push()->set_nil();
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PUSHTRUE:
+            VMRUN_CASE(OPC_PUSHTRUE):
                 /* push true */
                 push()->set_true();
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PUSH_1:
+            VMRUN_CASE(OPC_PUSH_1):
                 /* push the constant value 1 */
                 push()->set_int(1);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PUSHINT8:
+            VMRUN_CASE(OPC_PUSHINT8):
                 /* push an SBYTE operand value */
                 push()->set_int(get_op_int8(&p));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PUSHINT:
+            VMRUN_CASE(OPC_PUSHINT):
                 /* push a UINT4 operand value */
                 push()->set_int(get_op_int32(&p));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_INC:
+            VMRUN_CASE(OPC_INC):
                 /* 
                  *   Increment the value at top of stack.  We must perform
                  *   the same type conversions as the ADD instruction does.
@@ -1577,15 +1929,16 @@ resume_execution:
                 {
                     /* it's an integer - increment it, and we're done */
                     ++(valp->val.intval);
+                    VMRUN_INT_RESULT(valp);
                 }
                 else
                 {
                     /* for other types, use the general handler */
                     p = compute_sum_inc(vmg_ p);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_ADD:
+            VMRUN_CASE(OPC_ADD):
                 /* if they're both integers, add them the quick way */
                 valp = get(0);
                 valp2 = get(1);
@@ -1596,15 +1949,16 @@ resume_execution:
 
                     /* discard the second value */
                     discard();
+                    VMRUN_INT_RESULT(valp2);
                 }
                 else
                 {
                     /* for other types, use the general handler */
                     p = compute_sum_add(vmg_ p);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_DEC:
+            VMRUN_CASE(OPC_DEC):
                 /* 
                  *   Decrement the value at top of stack.  We must perform
                  *   the same type conversions as the SUB instruction does.
@@ -1616,15 +1970,16 @@ resume_execution:
                 {
                     /* it's an integer - decrement it, and we're done */
                     INT_SUB(valp, 1);
+                    VMRUN_INT_RESULT(valp);
                 }
                 else
                 {
                     /* for other types, use the general handler */
                     p = compute_diff_dec(vmg_ p);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SUB:
+            VMRUN_CASE(OPC_SUB):
                 /* if they're both integers, subtract them the quick way */
                 valp = get(0);
                 valp2 = get(1);
@@ -1635,50 +1990,51 @@ resume_execution:
 
                     /* discard the second value */
                     discard();
+                    VMRUN_INT_RESULT(valp2);
                 }
                 else
                 {
                     /* for other types, use the general handler */
                     p = compute_diff_sub(vmg_ p);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PUSHSTR:
+            VMRUN_CASE(OPC_PUSHSTR):
                 /* push UINT4 offset operand as a string */
                 push()->set_sstring(get_op_uint32(&p));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_DISC:
+            VMRUN_CASE(OPC_DISC):
                 /* discard the item at the top of the stack */
                 discard();
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_DISC1:
+            VMRUN_CASE(OPC_DISC1):
                 /* discard n items */
                 discard(get_op_uint8(&p));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PUSHLST:
+            VMRUN_CASE(OPC_PUSHLST):
                 /* push UINT4 offset operand as a list */
                 push()->set_list(get_op_uint32(&p));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PUSHOBJ:
+            VMRUN_CASE(OPC_PUSHOBJ):
                 /* push UINT4 object ID operand */
                 push()->set_obj(get_op_uint32(&p));
-                continue;
+                VMRUN_NEXT;
                 
-            case OPC_PUSHPROPID:
+            VMRUN_CASE(OPC_PUSHPROPID):
                 /* push UINT2 property ID operand */
                 push()->set_propid(get_op_uint16(&p));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PUSHFNPTR:
+            VMRUN_CASE(OPC_PUSHFNPTR):
                 /* push a function pointer operand */
                 push()->set_fnptr(get_op_uint32(&p));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PUSHPARLST:
+            VMRUN_CASE(OPC_PUSHPARLST):
                 {
                     /* get the number of fixed parameters */
                     uint cnt = *p++;
@@ -1690,13 +2046,13 @@ resume_execution:
                     /* push the new list */
                     push()->set_obj(obj);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_MAKELSTPAR:
+            VMRUN_CASE(OPC_MAKELSTPAR):
                 makelstpar(vmg0_);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_NEG:
+            VMRUN_CASE(OPC_NEG):
                 /* if it's an integer value, do the calculation inline */
                 if ((valp = get(0))->typ == VM_INT)
                 {
@@ -1718,9 +2074,9 @@ resume_execution:
                                     &val, G_predef->operator_neg, 0,
                                     VMERR_BAD_TYPE_NEG);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_BNOT:
+            VMRUN_CASE(OPC_BNOT):
                 /* check the type */
                 if ((valp = get(0))->typ == VM_INT)
                 {
@@ -1735,9 +2091,9 @@ resume_execution:
                                     &val, G_predef->operator_bit_not, 0,
                                     VMERR_BAD_TYPE_BIT_NOT);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_MUL:
+            VMRUN_CASE(OPC_MUL):
                 /* if they're both integers, this is easy */
                 valp = get(0);
                 valp2 = get(1);
@@ -1762,9 +2118,9 @@ resume_execution:
                                     &val, G_predef->operator_mul, 1,
                                     VMERR_BAD_TYPE_MUL);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_DIV:
+            VMRUN_CASE(OPC_DIV):
                 /* if they're both integers, do the division inline */
                 valp = get(0);
                 valp2 = get(1);
@@ -1789,9 +2145,9 @@ resume_execution:
                                     &val, G_predef->operator_div, 1,
                                     VMERR_BAD_TYPE_DIV);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_MOD:
+            VMRUN_CASE(OPC_MOD):
                 /* remainder number at (TOS-1) by number at top of stack */
                 valp = get(0);
                 valp2 = get(1);
@@ -1821,9 +2177,9 @@ resume_execution:
                                     &val, G_predef->operator_mod, 1,
                                     VMERR_BAD_TYPE_MOD);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_BAND:
+            VMRUN_CASE(OPC_BAND):
                 /* bitwise AND two integers on top of stack */
                 valp = get(0);
                 valp2 = get(1);
@@ -1845,9 +2201,9 @@ resume_execution:
                                     &val, G_predef->operator_bit_and, 1,
                                     VMERR_BAD_TYPE_BIT_AND);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_BOR:
+            VMRUN_CASE(OPC_BOR):
                 /* bitwise OR two integers on top of stack */
                 valp = get(0);
                 valp2 = get(1);
@@ -1869,9 +2225,9 @@ resume_execution:
                                     &val, G_predef->operator_bit_or, 1,
                                     VMERR_BAD_TYPE_BIT_OR);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SHL:
+            VMRUN_CASE(OPC_SHL):
                 /* 
                  *   bit-shift left integer at (TOS-1) by integer at top
                  *   of stack 
@@ -1896,9 +2252,9 @@ resume_execution:
                                     &val, G_predef->operator_shl, 1,
                                     VMERR_BAD_TYPE_SHL);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_ASHR:
+            VMRUN_CASE(OPC_ASHR):
                 /* 
                  *   arithmetic shift right integer at (TOS-1) by integer at
                  *   top of stack 
@@ -1924,9 +2280,9 @@ resume_execution:
                                     &val, G_predef->operator_ashr, 1,
                                     VMERR_BAD_TYPE_ASHR);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_LSHR:
+            VMRUN_CASE(OPC_LSHR):
                 /* 
                  *   logical shift right integer at (TOS-1) by integer at
                  *   top of stack 
@@ -1952,9 +2308,9 @@ resume_execution:
                                     &val, G_predef->operator_lshr, 1,
                                     VMERR_BAD_TYPE_LSHR);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_XOR:
+            VMRUN_CASE(OPC_XOR):
                 /* XOR two values at top of stack */
                 popval_2(vmg_ &val, &val2);
                 if (!xor_and_push(vmg_ &val, &val2))
@@ -1965,9 +2321,9 @@ resume_execution:
                                     &val, G_predef->operator_xor, 1,
                                     VMERR_BAD_TYPE_XOR);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_NOT:
+            VMRUN_CASE(OPC_NOT):
                 /* 
                  *   invert the logic value; if the value is a number,
                  *   treat 0 as nil and non-zero as true 
@@ -2004,9 +2360,9 @@ resume_execution:
                 default:
                     err_throw(VMERR_NO_LOG_CONV);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_BOOLIZE:
+            VMRUN_CASE(OPC_BOOLIZE):
                 /* set to a boolean value */
                 valp = get(0);
                 switch(valp->typ)
@@ -2029,39 +2385,39 @@ resume_execution:
                 default:
                     err_throw(VMERR_NO_LOG_CONV);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_EQ:
+            VMRUN_CASE(OPC_EQ):
                 /* compare two values at top of stack for equality */
-                push_bool(vmg_ pop2_equal(vmg0_));
-                continue;
+                VMRUN_PUSH_CMP(pop2_equal(vmg0_));
+                VMRUN_NEXT;
 
-            case OPC_NE:
+            VMRUN_CASE(OPC_NE):
                 /* compare two values at top of stack for inequality */
-                push_bool(vmg_ !pop2_equal(vmg0_));
-                continue;
+                VMRUN_PUSH_CMP(!pop2_equal(vmg0_));
+                VMRUN_NEXT;
 
-            case OPC_LT:
+            VMRUN_CASE(OPC_LT):
                 /* compare values at top of stack - true if (TOS-1) < TOS */
-                push_bool(vmg_ pop2_compare_lt(vmg0_));
-                continue;
+                VMRUN_PUSH_CMP(pop2_compare_lt(vmg0_));
+                VMRUN_NEXT;
 
-            case OPC_LE:
+            VMRUN_CASE(OPC_LE):
                 /* compare values at top of stack - true if (TOS-1) <= TOS */
-                push_bool(vmg_ pop2_compare_le(vmg0_));
-                continue;
+                VMRUN_PUSH_CMP(pop2_compare_le(vmg0_));
+                VMRUN_NEXT;
 
-            case OPC_GT:
+            VMRUN_CASE(OPC_GT):
                 /* compare values at top of stack - true if (TOS-1) > TOS */
-                push_bool(vmg_ pop2_compare_gt(vmg0_));
-                continue;
+                VMRUN_PUSH_CMP(pop2_compare_gt(vmg0_));
+                VMRUN_NEXT;
 
-            case OPC_GE:
+            VMRUN_CASE(OPC_GE):
                 /* compare values at top of stack - true if (TOS-1) >= TOS */
-                push_bool(vmg_ pop2_compare_ge(vmg0_));
-                continue;
+                VMRUN_PUSH_CMP(pop2_compare_ge(vmg0_));
+                VMRUN_NEXT;
 
-            case OPC_VARARGC:
+            VMRUN_CASE(OPC_VARARGC):
                 {
                     /* get the modified opcode */
                     uchar opc = *p++;
@@ -2159,9 +2515,9 @@ resume_execution:
                         continue;
                     }
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_NAMEDARGPTR:
+            VMRUN_CASE(OPC_NAMEDARGPTR):
                 /* 
                  *   Pointer to named argument table.  Discard the named
                  *   arguments (the count is given by a one-byte operand),
@@ -2169,9 +2525,9 @@ resume_execution:
                  */
                 discard(get_op_uint8(&p));
                 p += 2;
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_NAMEDARGTAB:
+            VMRUN_CASE(OPC_NAMEDARGTAB):
                 /* 
                  *   Named argument table.  As with NAMEDARGPTR, we must
                  *   discard the named arguments.  Then we simply skip the
@@ -2182,9 +2538,9 @@ resume_execution:
                     discard(get_op_uint16(&p));
                     p += ofs - 2;
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_CALL:
+            VMRUN_CASE(OPC_CALL):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2196,9 +2552,9 @@ resume_execution:
                     /* call it */
                     p = do_call_func_nr(vmg_ p - entry_ptr_native_, ofs, argc);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PTRCALL:
+            VMRUN_CASE(OPC_PTRCALL):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2216,25 +2572,25 @@ resume_execution:
                 
                 /* call the function */
                 p = call_func_ptr(vmg_ &val, argc, 0, p - entry_ptr_native_);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_RETTRUE:
+            VMRUN_CASE(OPC_RETTRUE):
                 /* store true in R0 */
                 r0_.set_true();
 
                 /* return */
                 if ((p = do_return(vmg0_)) == 0)
                     goto exit_loop;
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETPROPR0:
+            VMRUN_CASE(OPC_GETPROPR0):
                 /* evaluate the property of R0 */
                 propev.self = r0_;
                 prop = get_op_uint16(&p);
                 p = propev.get_prop(vmg_ p - entry_ptr_native_, prop);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_CALLPROPLCL1:
+            VMRUN_CASE(OPC_CALLPROPLCL1):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2245,9 +2601,9 @@ resume_execution:
                 /* call the property of the local */
                 prop = get_op_uint16(&p);
                 p = propev.get_prop(vmg_ p - entry_ptr_native_, prop, argc);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_CALLPROPR0:
+            VMRUN_CASE(OPC_CALLPROPR0):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2256,9 +2612,9 @@ resume_execution:
                 propev.self = r0_;
                 prop = get_op_uint16(&p);
                 p = propev.get_prop(vmg_ p - entry_ptr_native_, prop, argc);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PTRCALLPROP:
+            VMRUN_CASE(OPC_PTRCALLPROP):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2273,9 +2629,9 @@ resume_execution:
                 /* evaluate the property */
                 p = propev.get_prop(vmg_ p - entry_ptr_native_,
                                     val.val.prop, argc);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PTRCALLPROPSELF:
+            VMRUN_CASE(OPC_PTRCALLPROPSELF):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2288,18 +2644,18 @@ resume_execution:
                 propev.self.set_obj(get_self(vmg0_));
                 p = propev.get_prop(vmg_ p - entry_ptr_native_,
                                     val.val.prop, argc);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_OBJGETPROP:
+            VMRUN_CASE(OPC_OBJGETPROP):
                 /* get the object */
                 propev.self.set_obj((vm_obj_id_t)get_op_uint32(&p));
 
                 /* evaluate the property */
                 prop = get_op_uint16(&p);
                 p = propev.get_prop(vmg_ p - entry_ptr_native_, prop);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_OBJCALLPROP:
+            VMRUN_CASE(OPC_OBJCALLPROP):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2310,33 +2666,49 @@ resume_execution:
                 /* evaluate the property */
                 prop = get_op_uint16(&p);
                 p = propev.get_prop(vmg_ p - entry_ptr_native_, prop, argc);
-                continue;
+                VMRUN_NEXT;
+
+            VMRUN_CASE(OPC_GETLCL1):
+#ifdef VMRUN_FUSED_OPS
+                /* GETLCL1 + GETPROP: evaluate the property of the local */
+                if (p[1] == OPC_GETPROP)
+                {
+                    /* get the local whose property we're evaluating */
+                    propev.self = *get_local(vmg_ get_op_uint8(&p));
+
+                    /* move on to the GETPROP */
+                    last_pc = p++;
 
-            case OPC_GETLCL1:
+                    /* evaluate the property */
+                    prop = get_op_uint16(&p);
+                    p = propev.get_prop(vmg_ p - entry_ptr_native_, prop);
+                    VMRUN_NEXT;
+                }
+#endif
                 /* push the local */
                 pushval(vmg_ get_local(vmg_ get_op_uint8(&p)));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETLCLN5:
+            VMRUN_CASE(OPC_GETLCLN5):
                 pushval(vmg_ get_local(vmg_ 5));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETLCL2:
+            VMRUN_CASE(OPC_GETLCL2):
                 /* push the local */
                 pushval(vmg_ get_local(vmg_ get_op_uint16(&p)));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETARG1:
+            VMRUN_CASE(OPC_GETARG1):
                 /* push the argument */
                 pushval(vmg_ get_param(vmg_ get_op_uint8(&p)));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETARG2:
+            VMRUN_CASE(OPC_GETARG2):
                 /* push the argument */
                 pushval(vmg_ get_param(vmg_ get_op_uint16(&p)));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SETSELF:
+            VMRUN_CASE(OPC_SETSELF):
                 /* retrieve the 'self' object */
                 pop(&val);
                 
@@ -2346,18 +2718,18 @@ resume_execution:
 
                 /* set 'self' */
                 set_self(vmg_ &val);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_STORECTX:
+            VMRUN_CASE(OPC_STORECTX):
                 /* create the context object */
                 create_loadctx_obj(vmg_ push(),
                                    get_self(vmg0_),
                                    get_defining_obj(vmg0_),
                                    get_orig_target_obj(vmg0_),
                                    get_target_prop(vmg0_));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_LOADCTX:
+            VMRUN_CASE(OPC_LOADCTX):
                 {
                     /* 
                      *   convert the context object (at top of stack) to a
@@ -2382,9 +2754,9 @@ resume_execution:
                     /* discard the context object at top of stack */
                     discard();
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PUSHCTXELE:
+            VMRUN_CASE(OPC_PUSHCTXELE):
                 /* check our context element type */
                 switch(*p++)
                 {
@@ -2412,14 +2784,14 @@ resume_execution:
                     /* the opcode is not valid in this VM version */
                     err_throw(VMERR_INVALID_OPCODE);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETARGC:
+            VMRUN_CASE(OPC_GETARGC):
                 /* push the argument counter */
                 push_int(vmg_ get_cur_argc(vmg0_));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_DUP2:
+            VMRUN_CASE(OPC_DUP2):
                 /* 
                  *   duplicate the top two elements: first push the
                  *   second-from-top, then push the old top (which will now
@@ -2427,9 +2799,9 @@ resume_execution:
                  */
                 pushval(vmg_ get(1));
                 pushval(vmg_ get(1));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SWITCH:
+            VMRUN_CASE(OPC_SWITCH):
                 {
                     /* get the control value */
                     valp = get(0);
@@ -2462,9 +2834,9 @@ resume_execution:
                     if (cnt == 0)
                         p += osrp2s(p);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_JT:
+            VMRUN_CASE(OPC_JT):
                 /* get the value */
                 valp = get(0);
 
@@ -2485,9 +2857,9 @@ resume_execution:
 
                 /* discard the value */
                 discard();
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_JR0T:
+            VMRUN_CASE(OPC_JR0T):
                 /* 
                  *   if R0 is true, or it's a non-zero numeric value, or any
                  *   non-numeric and non-boolean value, jump 
@@ -2502,9 +2874,9 @@ resume_execution:
                     /* it's non-zero and non-nil - jump */
                     p += osrp2s(p);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_JF:
+            VMRUN_CASE(OPC_JF):
                 /* get the value */
                 valp = get(0);
 
@@ -2526,24 +2898,24 @@ resume_execution:
 
                 /* discard the value */
                 discard();
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_JGE:
+            VMRUN_CASE(OPC_JGE):
                 /* jump if greater or equal */
                 p += (pop2_compare_ge(vmg0_) ? osrp2s(p) : 2);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_JLT:
+            VMRUN_CASE(OPC_JLT):
                 /* jump if less */
                 p += (pop2_compare_lt(vmg0_) ? osrp2s(p) : 2);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_JLE:
+            VMRUN_CASE(OPC_JLE):
                 /* jump if less or equal */
                 p += (pop2_compare_le(vmg0_) ? osrp2s(p) : 2);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_JST:
+            VMRUN_CASE(OPC_JST):
                 /* get (do not remove) the element at top of stack */
                 valp = get(0);
 
@@ -2570,9 +2942,9 @@ resume_execution:
                     /* skip to the next instruction */
                     p += 2;
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_JSF:
+            VMRUN_CASE(OPC_JSF):
                 /* get (do not remove) the element at top of stack */
                 valp = get(0);
 
@@ -2593,9 +2965,9 @@ resume_execution:
                     /* skip to the next instruction */
                     p += 2;
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_LJSR:
+            VMRUN_CASE(OPC_LJSR):
                 /* 
                  *   compute and push the offset of the next instruction
                  *   (at +2 because of the branch offset operand) from our
@@ -2607,9 +2979,9 @@ resume_execution:
 
                 /* jump to the target address */
                 p += osrp2s(p);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_LRET:
+            VMRUN_CASE(OPC_LRET):
                 /* get the indicated local variable */
                 valp = get_local(vmg_ get_op_uint16(&p));
                 
@@ -2623,9 +2995,9 @@ resume_execution:
                  *   current method header pointer 
                  */
                 p = entry_ptr_native_ + valp->val.intval;
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SWAP:
+            VMRUN_CASE(OPC_SWAP):
                 /* swap the top two elements on the stack */
                 valp = get(0);
                 valp2 = get(1);
@@ -2638,9 +3010,9 @@ resume_execution:
 
                 /* copy the working copy of TOS over TOS-1 */
                 *valp2 = val;
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SWAP2:
+            VMRUN_CASE(OPC_SWAP2):
                 /* swap the top two elements with the next two */
                 valp = get(0);
                 valp2 = get(1);
@@ -2656,9 +3028,9 @@ resume_execution:
                 /* copy the saved 2,3 over 0,1 */
                 *valp = val;
                 *valp2 = val2;
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SWAPN:
+            VMRUN_CASE(OPC_SWAPN):
                 /* swap elements at two given stack indices */
                 valp = get(get_op_uint8(&p));
                 valp2 = get(get_op_uint8(&p));
@@ -2671,14 +3043,14 @@ resume_execution:
 
                 /* write the copy of val1 over val2 */
                 *valp2 = val;
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETSPN:
+            VMRUN_CASE(OPC_GETSPN):
                 /* push stack element at index */
                 push(get(get_op_uint8(&p)));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SAY:
+            VMRUN_CASE(OPC_SAY):
                 {
                     /* get the string offset */
                     pool_ofs_t ofs = get_op_int32(&p);
@@ -2687,15 +3059,15 @@ resume_execution:
                     p = disp_dstring(vmg_ ofs, p - entry_ptr_native_,
                                      get_self_check(vmg0_));
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SAYVAL:
+            VMRUN_CASE(OPC_SAYVAL):
                 /* invoke the default string display function */
                 p = disp_string_val(vmg_ p - entry_ptr_native_,
                                     get_self_check(vmg0_));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_INHERIT:
+            VMRUN_CASE(OPC_INHERIT):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2703,9 +3075,9 @@ resume_execution:
                 /* inherit the property */
                 prop = (vm_prop_id_t)get_op_uint16(&p);
                 p = inh_prop(vmg_ p - entry_ptr_native_, prop, argc);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PTRINHERIT:
+            VMRUN_CASE(OPC_PTRINHERIT):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2715,9 +3087,9 @@ resume_execution:
 
                 /* inherit it */
                 p = inh_prop(vmg_ p - entry_ptr_native_, val.val.prop, argc);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_EXPINHERIT:
+            VMRUN_CASE(OPC_EXPINHERIT):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2737,9 +3109,9 @@ resume_execution:
                 val2.set_obj(get_self(vmg0_));
                 p = get_prop(vmg_ p - entry_ptr_native_,
                              &val, prop, &val2, argc, 0);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PTREXPINHERIT:
+            VMRUN_CASE(OPC_PTREXPINHERIT):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2754,9 +3126,9 @@ resume_execution:
                 val2.set_obj(get_self(vmg0_));
                 p = get_prop(vmg_ p - entry_ptr_native_,
                              &val3, val.val.prop, &val2, argc, 0);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_DELEGATE:
+            VMRUN_CASE(OPC_DELEGATE):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2772,9 +3144,9 @@ resume_execution:
 
                 p = get_prop(vmg_ p - entry_ptr_native_,
                              &val, prop, &val2, argc, 0);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PTRDELEGATE:
+            VMRUN_CASE(OPC_PTRDELEGATE):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2789,9 +3161,9 @@ resume_execution:
                 val3.set_obj(get_self(vmg0_));
                 p = get_prop(vmg_ p - entry_ptr_native_,
                              &val2, val.val.prop, &val3, argc, 0);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_BUILTIN_A:
+            VMRUN_CASE(OPC_BUILTIN_A):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2803,9 +3175,9 @@ resume_execution:
                     /* call the function in set #0 */
                     call_bif(vmg_ 0, idx, argc);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_BUILTIN_B:
+            VMRUN_CASE(OPC_BUILTIN_B):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2817,9 +3189,9 @@ resume_execution:
                     /* call the function in set #1 */
                     call_bif(vmg_ 1, idx, argc);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_BUILTIN_C:
+            VMRUN_CASE(OPC_BUILTIN_C):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2831,9 +3203,9 @@ resume_execution:
                     /* call the function in set #2 */
                     call_bif(vmg_ 2, idx, argc);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_BUILTIN_D:
+            VMRUN_CASE(OPC_BUILTIN_D):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2845,9 +3217,9 @@ resume_execution:
                     /* call the function in set #3 */
                     call_bif(vmg_ 3, idx, argc);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_BUILTIN1:
+            VMRUN_CASE(OPC_BUILTIN1):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2860,9 +3232,9 @@ resume_execution:
                     /* call the function */
                     call_bif(vmg_ set_idx, idx, argc);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_BUILTIN2:
+            VMRUN_CASE(OPC_BUILTIN2):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2875,9 +3247,9 @@ resume_execution:
                     /* call the function in set #0 */
                     call_bif(vmg_ set_idx, idx, argc);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_IDXINT8:
+            VMRUN_CASE(OPC_IDXINT8):
                 /* 
                  *   make a copy of the value to index, so we can overwrite
                  *   the stack slot with the result 
@@ -2900,9 +3272,9 @@ resume_execution:
                                     &val, G_predef->operator_idx, 1,
                                     VMERR_CANNOT_INDEX_TYPE);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_NEW1:
+            VMRUN_CASE(OPC_NEW1):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2913,9 +3285,9 @@ resume_execution:
                     uint idx = get_op_uint8(&p);
                     p = new_and_store_r0(vmg_ p, idx, argc, FALSE);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_TRNEW1:
+            VMRUN_CASE(OPC_TRNEW1):
                 /* get the argument count */
                 argc = get_op_uint8(&p);
 
@@ -2927,9 +3299,9 @@ resume_execution:
                     uint idx = get_op_uint8(&p);
                     p = new_and_store_r0(vmg_ p, idx, argc, TRUE);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_NEW2:
+            VMRUN_CASE(OPC_NEW2):
                 /* get the argument count */
                 argc = get_op_uint16(&p);
 
@@ -2942,9 +3314,9 @@ resume_execution:
                     /* create the new object */
                     p = new_and_store_r0(vmg_ p, idx, argc, FALSE);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_TRNEW2:
+            VMRUN_CASE(OPC_TRNEW2):
                 /* get the argument count */
                 argc = get_op_uint16(&p);
 
@@ -2957,13 +3329,13 @@ resume_execution:
                     /* create the new object */
                     p = new_and_store_r0(vmg_ p, idx, argc, TRUE);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_NOP:
+            VMRUN_CASE(OPC_NOP):
                 /* NO OP - no effect */
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_INCLCL:
+            VMRUN_CASE(OPC_INCLCL):
                 /* get the local */
                 {
                     int itmp = get_op_uint16(&p);
@@ -2993,9 +3365,9 @@ resume_execution:
                         }
                     }
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_DECLCL:
+            VMRUN_CASE(OPC_DECLCL):
                 {
                     /* get the local */
                     int itmp = get_op_uint16(&p);
@@ -3025,9 +3397,9 @@ resume_execution:
                         }
                     }
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_ADDILCL1:
+            VMRUN_CASE(OPC_ADDILCL1):
                 {
                     /* get the local */
                     int itmp = get_op_uint8(&p);
@@ -3048,9 +3420,9 @@ resume_execution:
                         p = compute_sum_lcl_imm(vmg_ valp, &val2, itmp, p);
                     }
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_ADDILCL4:
+            VMRUN_CASE(OPC_ADDILCL4):
                 {
                     /* get the local */
                     int itmp = get_op_uint16(&p);
@@ -3071,9 +3443,9 @@ resume_execution:
                         p = compute_sum_lcl_imm(vmg_ valp, &val2, itmp, p);
                     }
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_ADDTOLCL:
+            VMRUN_CASE(OPC_ADDTOLCL):
                 {
                     /* get the local */
                     int itmp = get_op_uint16(&p);
@@ -3112,9 +3484,9 @@ resume_execution:
                         }
                     }
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SUBFROMLCL:
+            VMRUN_CASE(OPC_SUBFROMLCL):
                 {
                     /* get the local */
                     int itmp = get_op_uint16(&p);
@@ -3150,63 +3522,63 @@ resume_execution:
                                         VMERR_BAD_TYPE_SUB);
                     }
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_ZEROLCL1:
+            VMRUN_CASE(OPC_ZEROLCL1):
                 /* get the local and set it to zero */
                 get_local(vmg_ get_op_uint8(&p))->set_int(0);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_ZEROLCL2:
+            VMRUN_CASE(OPC_ZEROLCL2):
                 /* get the local and set it to zero */
                 get_local(vmg_ get_op_uint16(&p))->set_int(0);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_NILLCL1:
+            VMRUN_CASE(OPC_NILLCL1):
                 /* get the local and set it to zero */
                 get_local(vmg_ get_op_uint8(&p))->set_nil();
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_NILLCL2:
+            VMRUN_CASE(OPC_NILLCL2):
                 /* get the local and set it to zero */
                 get_local(vmg_ get_op_uint16(&p))->set_nil();
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_ONELCL1:
+            VMRUN_CASE(OPC_ONELCL1):
                 /* get the local and set it to zero */
                 get_local(vmg_ get_op_uint8(&p))->set_int(1);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_ONELCL2:
+            VMRUN_CASE(OPC_ONELCL2):
                 /* get the local and set it to zero */
                 get_local(vmg_ get_op_uint16(&p))->set_int(1);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SETLCL2:
+            VMRUN_CASE(OPC_SETLCL2):
                 /* get a pointer to the local */
                 valp = get_local(vmg_ get_op_uint16(&p));
 
                 /* pop the value into the local */
                 popval(vmg_ valp);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SETARG1:
+            VMRUN_CASE(OPC_SETARG1):
                 /* get a pointer to the parameter */
                 valp = get_param(vmg_ get_op_uint8(&p));
 
                 /* pop the value into the parameter */
                 popval(vmg_ valp);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SETARG2:
+            VMRUN_CASE(OPC_SETARG2):
                 /* get a pointer to the parameter */
                 valp = get_param(vmg_ get_op_uint16(&p));
 
                 /* pop the value into the parameter */
                 popval(vmg_ valp);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SETIND:
+            VMRUN_CASE(OPC_SETIND):
                 /* pop the index */
                 popval(vmg_ &val2);
 
@@ -3231,9 +3603,9 @@ resume_execution:
                                     &val, G_predef->operator_setidx, 2,
                                     VMERR_CANNOT_INDEX_TYPE);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SETINDLCL1I8:
+            VMRUN_CASE(OPC_SETINDLCL1I8):
                 {
                     /* get the local */
                     int itmp = get_op_uint8(&p);
@@ -3259,9 +3631,9 @@ resume_execution:
                                         VMERR_CANNOT_INDEX_TYPE);
                     }
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SETPROP:
+            VMRUN_CASE(OPC_SETPROP):
                 /* get the object whose property we're setting */
                 pop_obj(vmg_ &val);
 
@@ -3270,9 +3642,9 @@ resume_execution:
 
                 /* set the value */
                 set_prop(vmg_ val.val.obj, get_op_uint16(&p), &val2);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PTRSETPROP:
+            VMRUN_CASE(OPC_PTRSETPROP):
                 /* get the property and object to set */
                 pop_prop(vmg_ &val);
                 pop_obj(vmg_ &val2);
@@ -3282,9 +3654,9 @@ resume_execution:
 
                 /* set it */
                 set_prop(vmg_ val2.val.obj, val.val.prop, &val3);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_OBJSETPROP:
+            VMRUN_CASE(OPC_OBJSETPROP):
                 /* get the object */
                 obj = (vm_obj_id_t)get_op_uint32(&p);
 
@@ -3293,9 +3665,9 @@ resume_execution:
 
                 /* set the property */
                 set_prop(vmg_ obj, get_op_uint16(&p), &val);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PUSHSTRI:
+            VMRUN_CASE(OPC_PUSHSTRI):
                 /* push inline string */
                 {
                     /* get the length prefix */
@@ -3311,18 +3683,18 @@ resume_execution:
                     /* push the new string */
                     push()->set_obj(obj);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PUSHBIFPTR:
+            VMRUN_CASE(OPC_PUSHBIFPTR):
                 {
                     /* push pointer to built-in function */
                     uint idx = get_op_uint16(&p);
                     push()->set_bifptr(get_op_uint16(&p), (ushort)idx);
                     validate_bifptr(vmg0_);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_THROW:
+            VMRUN_CASE(OPC_THROW):
                 /* pop the exception object */
                 pop_obj(vmg_ &val);
 
@@ -3340,11 +3712,11 @@ resume_execution:
                     /* terminate execution */
                     goto exit_loop;
                 }
-                continue;
+                VMRUN_NEXT;
 
 #ifdef VM_DEBUGGER
 
-            case OPC_GETPROPDATA:
+            VMRUN_CASE(OPC_GETPROPDATA):
                 /* get the object whose property we're fetching */
                 pop(&propev.self);
 
@@ -3365,9 +3737,9 @@ resume_execution:
 
                 /* evaluate the property given by the immediate data */
                 p = propev.get_prop(vmg_ p - entry_ptr_native_, prop);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_PTRGETPROPDATA:
+            VMRUN_CASE(OPC_PTRGETPROPDATA):
                 /* get the property and object to evaluate */
                 pop_prop(vmg_ &val);
                 pop(&propev.self);
@@ -3386,14 +3758,14 @@ resume_execution:
 
                 /* evaluate it */
                 p = propev.get_prop(vmg_ p - entry_ptr_native_, val.val.prop);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETDBARGC:
+            VMRUN_CASE(OPC_GETDBARGC):
                 /* push the argument count from the selected frame */
                 push_int(vmg_ get_argc_at_level(vmg_ get_op_uint16(&p) + 1));
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETDBLCL:
+            VMRUN_CASE(OPC_GETDBLCL):
                 {
                     /* get the local variable number and stack level */
                     uint idx = get_op_uint16(&p);
@@ -3402,9 +3774,9 @@ resume_execution:
                     /* push the value */
                     pushval(vmg_ get_local_at_level(vmg_ idx, level + 1));
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_GETDBARG:
+            VMRUN_CASE(OPC_GETDBARG):
                 {
                     /* get the parameter variable number and stack level */
                     uint idx = get_op_uint16(&p);
@@ -3413,9 +3785,9 @@ resume_execution:
                     /* push the value */
                     pushval(vmg_ get_param_at_level(vmg_ idx, level + 1));
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SETDBLCL:
+            VMRUN_CASE(OPC_SETDBLCL):
                 {
                     /* get the local variable number and stack level */
                     uint idx = get_op_uint16(&p);
@@ -3427,9 +3799,9 @@ resume_execution:
                     /* pop the value into the local */
                     popval(vmg_ valp);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_SETDBARG:
+            VMRUN_CASE(OPC_SETDBARG):
                 {
                     /* get the parameter variable number and stack level */
                     uint idx = get_op_uint16(&p);
@@ -3441,9 +3813,9 @@ resume_execution:
                     /* pop the value into the local */
                     popval(vmg_ valp);
                 }
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_BP:
+            VMRUN_CASE(OPC_BP):
                 /* step back to the breakpoint location itself */
                 --p;
 
@@ -3465,27 +3837,27 @@ resume_execution:
 
 #else /* VM_DEBUGGER */
 
-            case OPC_GETDBARGC:
-            case OPC_GETDBLCL:
-            case OPC_GETDBARG:
-            case OPC_SETDBLCL:
-            case OPC_SETDBARG:
-            case OPC_GETPROPDATA:
-            case OPC_PTRGETPROPDATA:
+            VMRUN_CASE(OPC_GETDBARGC):
+            VMRUN_CASE(OPC_GETDBLCL):
+            VMRUN_CASE(OPC_GETDBARG):
+            VMRUN_CASE(OPC_SETDBLCL):
+            VMRUN_CASE(OPC_SETDBARG):
+            VMRUN_CASE(OPC_GETPROPDATA):
+            VMRUN_CASE(OPC_PTRGETPROPDATA):
                 err_throw(VMERR_NO_DEBUGGER);
-                continue;
+                VMRUN_NEXT;
 
-            case OPC_BP:
+            VMRUN_CASE(OPC_BP):
                 /* if there's no debugger, it's an error */
                 err_throw(VMERR_BREAKPOINT);
-                continue;
+                VMRUN_NEXT;
 
 #endif /* VM_DEBUGGER */
 
-            case OPC_CALLEXT:
+            VMRUN_CASE(OPC_CALLEXT):
                 //$$$
                 err_throw(VMERR_CALLEXT_NOT_IMPL);
-                continue;
+                VMRUN_NEXT;
 
 #ifdef OS_FILL_OUT_CASE_TABLES
             /*
@@ -3507,6 +3879,9 @@ resume_execution:
              *   switch is critical to VM performance so we want it as fast
              *   as possible.  
              */
+#ifdef VMRUN_COMPUTED_GOTO
+            vmrun_op_invalid:
+#endif
             case 0x00: val.val.intval = 0x00;
             case 0x11: val.val.intval = 0x11;
             case 0x12: val.val.intval = 0x12;
@@ -3630,6 +4005,9 @@ resume_execution:
                  */
                 err_throw(VMERR_INVALID_OPCODE);
 
+#ifdef VMRUN_COMPUTED_GOTO
+            vmrun_op_invalid:
+#endif
             default:
                 /* unrecognized opcode */
                 err_throw(VMERR_INVALID_OPCODE);
@@ -4216,6 +4594,57 @@ void CVmRun::throw_new_rtesub(VMG_ vm_obj_id_t cls, uint argc, int errnum)
 }
 
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Get the decoded exception table for a method, decoding it into the
+ *   cache if necessary 
+ */
+const vm_exc_cache_slot *CVmRun::get_exc_table(VMG_ const uchar *func_start)
+{
+    /* find the slot for this method */
+    size_t h = (size_t)func_start;
+    vm_exc_cache_slot *slot =
+        &exc_cache_[(h ^ (h >> 7)) & (VMRUN_EXC_CACHE_SIZE - 1)];
+
+    /* if it's already there, we're done */
+    if (slot->func == func_start && slot->gen == exc_cache_gen_)
+        return slot;
+
+    /* decode the table, if the method has one */
+    CVmExcTablePtr tab;
+    slot->cnt = 0;
+    if (tab.set(func_start))
+    {
+        /* make sure we have room */
+        size_t cnt = tab.get_count();
+        if (cnt > slot->alloc)
+        {
+            if (slot->ent != 0)
+                t3free(slot->ent);
+            slot->ent = (vm_exc_entry *)t3malloc(cnt * sizeof(slot->ent[0]));
+            slot->alloc = cnt;
+        }
+
+        /* decode the entries */
+        CVmExcEntryPtr entry;
+        tab.set_entry_ptr(vmg_ &entry, 0);
+        for (size_t i = 0 ; i < cnt ; ++i, entry.inc(vmg0_))
+        {
+            vm_exc_entry *e = &slot->ent[i];
+            e->start_ofs = entry.get_start_ofs();
+            e->end_ofs = entry.get_end_ofs();
+            e->exc = entry.get_exception();
+            e->handler_ofs = entry.get_handler_ofs();
+        }
+        slot->cnt = cnt;
+    }
+
+    /* the slot now belongs to this method */
+    slot->func = func_start;
+    slot->gen = exc_cache_gen_;
+    return slot;
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Throw an exception.  Returns true if an exception handler was found,
@@ -4233,29 +4662,21 @@ const uchar *CVmRun::do_throw(VMG_ const uchar *pc, vm_obj_id_t exception_obj)
      */
     for (;;)
     {
-        CVmExcTablePtr tab;
-        const uchar *func_start;
-        uint ofs;
-
         /* get a pointer to the start of the current function */
-        func_start = entry_ptr_native_;
+        const uchar *func_start = entry_ptr_native_;
 
-        /* set up a pointer to the current exception table */
-        if (func_start != 0 && tab.set(func_start))
+        /* search the current function's exception table, if it has one */
+        if (func_start != 0)
         {
-            size_t cnt;
-            size_t i;
-            CVmExcEntryPtr entry;
+            /* get the decoded exception table */
+            const vm_exc_cache_slot *tab = get_exc_table(vmg_ func_start);
 
             /* calculate our offset in the current function */
-            ofs = pc - func_start;
+            uint ofs = pc - func_start;
 
-            /* set up a pointer to the first table entry */
-            tab.set_entry_ptr(vmg_ &entry, 0);
-            
             /* loop through the entries */
-            for (i = 0, cnt = tab.get_count() ; i < cnt ;
-                 ++i, entry.inc(vmg0_))
+            const vm_exc_entry *entry = tab->ent;
+            for (size_t i = tab->cnt ; i != 0 ; --i, ++entry)
             {
                 /* 
                  *   Check to see if we're in the range for this entry.
@@ -4264,18 +4685,18 @@ const uchar *CVmRun::do_throw(VMG_ const uchar *pc, vm_obj_id_t exception_obj)
                  *   this exception (or derives from that class), this
                  *   handler handles this exception. 
                  */
-                if (ofs >= entry.get_start_ofs()
-                    && ofs <= entry.get_end_ofs()
-                    && (entry.get_exception() == VM_INVALID_OBJ
-                        || exception_obj == entry.get_exception()
+                if (ofs >= entry->start_ofs
+                    && ofs <= entry->end_ofs
+                    && (entry->exc == VM_INVALID_OBJ
+                        || exception_obj == entry->exc
                         || (vm_objp(vmg_ exception_obj)
-                            ->is_instance_of(vmg_ entry.get_exception()))))
+                            ->is_instance_of(vmg_ entry->exc))))
                 {
                     /* 
                      *   this is it - move the program counter to the
                      *   first byte of the handler's code 
                      */
-                    pc = func_start + entry.get_handler_ofs();
+                    pc = func_start + entry->handler_ofs;
 
                     /* push the exception so that the handler can get at it */
                     push_obj(vmg_ exception_obj);
@@ -4434,6 +4855,122 @@ const uchar *CVmRun::call_func_ptr_fr(VMG_ const vm_val_t *funcptr, uint argc,
     }
 }
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Prepare a callback for repeated calls 
+ */
+void CVmRun::prep_callback(VMG_ vm_cbcall *cb, const vm_val_t *funcptr,
+                           uint argc)
+{
+    vm_val_t invoker;
+    CVmFuncPtr hdr_ptr;
+
+    /* remember the value and argument count */
+    cb->funcptr = funcptr;
+    cb->argc = argc;
+    cb->target_ptr = 0;
+
+    /* resolve the byte-code entrypoint, if there is one */
+    switch (funcptr->typ)
+    {
+    case VM_FUNCPTR:
+        cb->target_ptr = (const uchar *)G_code_pool->get_ptr(
+            funcptr->val.ofs);
+        break;
+
+    case VM_OBJ:
+        if (vm_objp(vmg_ funcptr->val.obj)->get_invoker(vmg_ &invoker))
+        {
+            if (invoker.typ == VM_FUNCPTR)
+                cb->target_ptr = (const uchar *)G_code_pool->get_ptr(
+                    invoker.val.ofs);
+            else if (invoker.typ == VM_CODEPTR)
+                cb->target_ptr = (const uchar *)invoker.val.ptr;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    /* if we didn't find code to call, leave it to the general path */
+    if (cb->target_ptr == 0)
+        return;
+
+    /* 
+     *   Check the argument count.  If it's wrong, use the general path, so
+     *   that the error is reported from within the new frame just as it
+     *   would be for an ordinary call. 
+     */
+    hdr_ptr.set(cb->target_ptr);
+    if (!hdr_ptr.argc_ok(argc))
+    {
+        cb->target_ptr = 0;
+        return;
+    }
+
+    /* note the space requirements */
+    cb->local_cnt = hdr_ptr.get_local_cnt();
+    cb->stack_depth = hdr_ptr.get_stack_depth();
+}
+
+/*
+ *   Call a prepared callback.  This is do_call() for a recursive call from
+ *   native code, with the header information and argument check already
+ *   taken care of by prep_callback().  
+ */
+void CVmRun::do_call_prepared(VMG_ const vm_cbcall *cb,
+                              const vm_rcdesc *recurse_ctx)
+{
+    vm_val_t *fp;
+    uint i;
+
+    /* give the host a chance to keep its UI alive during long computations */
+    maybe_yield();
+
+    /* store nil in R0 */
+    r0_.set_nil();
+
+    /* make sure we have room for the invocation frame and the function */
+    if (!check_frame_space(cb->stack_depth + 16))
+        err_throw(VMERR_STACK_OVERFLOW);
+
+    /* 
+     *   Push the invocation frame, as call_func_ptr() does, followed by the
+     *   rest of the frame, as do_call() does.  
+     */
+    fp = push(11 + cb->local_cnt);
+    (fp++)->set_propid(VM_INVALID_PROP);
+    (fp++)->set_nil();
+    (fp++)->set_nil();
+    if (cb->funcptr->typ == VM_OBJ)
+        (fp++)->set_obj(cb->funcptr->val.obj);
+    else
+        (fp++)->set_nil_obj();
+    *(fp++) = *cb->funcptr;
+    (fp++)->set_nil();
+    (fp++)->set_codeptr(recurse_ctx);
+    (fp++)->set_codeofs(0);
+    (fp++)->set_codeptr(entry_ptr_native_);
+    (fp++)->set_int((int32_t)cb->argc);
+    (fp++)->set_stack(frame_ptr_);
+
+    /* establish the new frame and entry pointers */
+    frame_ptr_ = fp;
+    entry_ptr_native_ = cb->target_ptr;
+
+    /* push nil for each local */
+    for (i = cb->local_cnt ; i != 0 ; --i)
+        (fp++)->set_nil();
+
+    /* create and activate the new function's profiler frame */
+    VM_IF_PROFILER(if (profiling_)
+        prof_enter(vmg_ cb->target_ptr));
+
+    /* recursively call the interpreter loop */
+    run(vmg_ cb->target_ptr + get_funchdr_size());
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Call a function, non-recursively. 
@@ -4454,6 +4991,9 @@ const uchar *CVmRun::do_call_func_nr(VMG_ uint caller_ofs,
     vm_val_t *fp;
     int lcl_cnt;
 
+    /* give the host a chance to keep its UI alive during long computations */
+    maybe_yield();
+
     /* store nil in R0 */
     r0_.set_nil();
 
@@ -4467,7 +5007,7 @@ const uchar *CVmRun::do_call_func_nr(VMG_ uint caller_ofs,
     lcl_cnt = hdr_ptr.get_local_cnt();
 
     /* get the target's stack space needs and check for stack overflow */
-    if (!check_space(hdr_ptr.get_stack_depth() + 11))
+    if (!check_frame_space(hdr_ptr.get_stack_depth() + 11))
         err_throw(VMERR_STACK_OVERFLOW);
 
     /* allocate the stack frame */
@@ -4624,6 +5164,9 @@ const uchar *CVmRun::do_call(VMG_ uint caller_ofs,
     vm_val_t *fp;
     int lcl_cnt;
 
+    /* give the host a chance to keep its UI alive during long computations */
+    maybe_yield();
+
     /* store nil in R0 */
     r0_.set_nil();
 
@@ -4641,7 +5184,7 @@ const uchar *CVmRun::do_call(VMG_ uint caller_ofs,
      *   entrypoint offset, the actual parameter count, and the enclosing
      *   frame pointer) in our space needs.  
      */
-    if (!check_space(hdr_ptr.get_stack_depth() + 11))
+    if (!check_frame_space(hdr_ptr.get_stack_depth() + 11))
         err_throw(VMERR_STACK_OVERFLOW);
 
     /* 
@@ -6058,6 +6601,105 @@ int CVmRun::get_stm_bounds(VMG_ const CVmFuncPtr *func_ptr,
  */
 #ifdef VM_PROFILER
 
+#ifdef VM_OPSTATS
+/*
+ *   Opcode statistics for a function.  We keep a simple array of counters
+ *   for the individual opcodes.  Only a small fraction of the 64k possible
+ *   opcode pairs ever occur in a given function, so we keep the pair
+ *   counters in a small open-addressed hash table that we grow as needed.  
+ */
+struct vm_prof_opstats
+{
+    vm_prof_opstats()
+    {
+        memset(op_cnt, 0, sizeof(op_cnt));
+        pair_siz = 0;
+        pair_used = 0;
+        pairs = 0;
+    }
+
+    ~vm_prof_opstats()
+    {
+        if (pairs != 0)
+            t3free(pairs);
+    }
+
+    /* count an opcode pair */
+    void count_pair(uint op1, uint op2)
+    {
+        /* grow the table if it's getting full */
+        if (pair_used * 2 >= pair_siz)
+            expand();
+
+        /* look up the key, using linear probing */
+        uint key = ((op1 << 8) | op2) + 1;
+        size_t i;
+        for (i = hash(key) ; pairs[i].key != 0 && pairs[i].key != key ;
+             i = (i + 1) & (pair_siz - 1)) ;
+
+        /* if it's a new entry, set it up */
+        if (pairs[i].key == 0)
+        {
+            pairs[i].key = key;
+            pairs[i].cnt = 0;
+            ++pair_used;
+        }
+
+        /* count it */
+        ++pairs[i].cnt;
+    }
+
+    /* hash a key */
+    size_t hash(uint key) const
+        { return (size_t)(key * 2654435761U) & (pair_siz - 1); }
+
+    /* expand the pair table */
+    void expand()
+    {
+        /* allocate the new table */
+        size_t old_siz = pair_siz;
+        pair *old_pairs = pairs;
+        pair_siz = (old_siz == 0 ? 64 : old_siz * 2);
+        pairs = (pair *)t3malloc(pair_siz * sizeof(pairs[0]));
+        memset(pairs, 0, pair_siz * sizeof(pairs[0]));
+
+        /* rehash the old entries into the new table */
+        for (size_t j = 0 ; j < old_siz ; ++j)
+        {
+            if (old_pairs[j].key != 0)
+            {
+                size_t i;
+                for (i = hash(old_pairs[j].key) ; pairs[i].key != 0 ;
+                     i = (i + 1) & (pair_siz - 1)) ;
+                pairs[i] = old_pairs[j];
+            }
+        }
+
+        /* done with the old table */
+        if (old_pairs != 0)
+            t3free(old_pairs);
+    }
+
+    /* execution count for each opcode */
+    unsigned long op_cnt[256];
+
+    /* 
+     *   pair table - the key is ((first opcode << 8) | second opcode) + 1,
+     *   so that zero can mark an empty slot 
+     */
+    struct pair
+    {
+        uint key;
+        unsigned long cnt;
+    };
+    pair *pairs;
+
+    /* number of slots in the pair table, and number in use */
+    size_t pair_siz;
+    size_t pair_used;
+};
+#endif /* VM_OPSTATS */
+
 /*
  *   Profiler master hash table entry 
  */
@@ -6077,12 +6719,23 @@ public:
         rec_.sum_direct.hi = rec_.sum_direct.lo = 0;
         rec_.sum_chi.hi = rec_.sum_chi.lo = 0;
         rec_.call_cnt = 0;
+
+        /* allocate the opcode statistics */
+        VM_IF_OPSTATS(rec_.opstats = new vm_prof_opstats();
+                      rec_.prev_op = -1;)
+    }
+
+    ~CVmHashEntryProfiler()
+    {
+        /* delete the opcode statistics */
+        VM_IF_OPSTATS(delete rec_.opstats;)
     }
 
     /* our profiler record */
     vm_profiler_rec rec_;
 };
 
+
 /*
  *   Begin profiling 
  */
@@ -6127,8 +6780,16 @@ struct vmrun_prof_enum
     void (*cb)(void *, const char *, unsigned long, unsigned long,
                unsigned long);
     void *cb_ctx;
+
+    /* client callback for opcode statistics */
+    VM_IF_OPSTATS(void (*opcb)(void *, const char *, int, int,
+                               unsigned long);)
 };
 
+/* generate the name of a profiled function or method */
+static void vmrun_prof_name(VMG_ vmrun_prof_enum *ctx,
+                            CVmHashEntryProfiler *entry, char *namebuf);
+
 /*
  *   Get the profiling data 
  */
@@ -6166,6 +6827,106 @@ void CVmRun::prof_enum_cb(void *ctx0, CVmHashEntry *entry0)
     VMGLOB_PTR(ctx->globals);
     CVmHashEntryProfiler *entry = (CVmHashEntryProfiler *)entry0;
     char namebuf[128];
+
+    /* generate the name of the function or method */
+    vmrun_prof_name(vmg_ ctx, entry, namebuf);
+
+    /* invoke the callback with the data */
+    (*ctx->cb)(ctx->cb_ctx, namebuf,
+               os_prof_time_to_ms(&entry->rec_.sum_direct),
+               os_prof_time_to_ms(&entry->rec_.sum_chi),
+               entry->rec_.call_cnt);
+}
+
+#ifdef VM_OPSTATS
+/*
+ *   Get the opcode statistics 
+ */
+void CVmRun::get_opstats_data(VMG_
+                              void (*cb)(void *ctx, const char *func_name,
+                                         int op1, int op2,
+                                         unsigned long cnt),
+                              void *cb_ctx)
+{
+    vmrun_prof_enum our_ctx;
+
+    /* if there's no debugger, we can't get symbols, so we can't proceed */
+    if (G_debugger == 0)
+        return;
+
+    /* set up our callback context */
+    our_ctx.globals = VMGLOB_ADDR;
+    our_ctx.terp = this;
+    our_ctx.dbg = G_debugger;
+    our_ctx.opcb = cb;
+    our_ctx.cb_ctx = cb_ctx;
+
+    /* enumerate the master table entries through our callback */
+    prof_master_table_->enum_entries(&prof_opstats_enum_cb, &our_ctx);
+}
+
+/*
+ *   Callback for enumerating the opcode statistics 
+ */
+void CVmRun::prof_opstats_enum_cb(void *ctx0, CVmHashEntry *entry0)
+{
+    vmrun_prof_enum *ctx = (vmrun_prof_enum *)ctx0;
+    VMGLOB_PTR(ctx->globals);
+    CVmHashEntryProfiler *entry = (CVmHashEntryProfiler *)entry0;
+    const vm_prof_opstats *st = entry->rec_.opstats;
+    char namebuf[128];
+    size_t i;
+
+    /* generate the name of the function or method */
+    vmrun_prof_name(vmg_ ctx, entry, namebuf);
+
+    /* report the individual opcode counts */
+    for (i = 0 ; i < 256 ; ++i)
+    {
+        if (st->op_cnt[i] != 0)
+            (*ctx->opcb)(ctx->cb_ctx, namebuf, (int)i, -1, st->op_cnt[i]);
+    }
+
+    /* report the pair counts */
+    for (i = 0 ; i < st->pair_siz ; ++i)
+    {
+        uint key = st->pairs[i].key;
+        if (key != 0)
+        {
+            --key;
+            (*ctx->opcb)(ctx->cb_ctx, namebuf, (int)(key >> 8),
+                         (int)(key & 0xff), st->pairs[i].cnt);
+        }
+    }
+}
+
+/*
+ *   Count an opcode in the current function's statistics 
+ */
+void CVmRun::prof_count_op(uint op)
+{
+    /* if there's no valid current level, there's nothing to count */
+    if (prof_stack_idx_ == 0 || prof_stack_idx_ > prof_stack_max_)
+        return;
+
+    /* count the opcode, and the pair it forms with the last opcode */
+    vm_profiler_rec *p = &prof_stack_[prof_stack_idx_ - 1];
+    ++p->opstats->op_cnt[op];
+    if (p->prev_op >= 0)
+        p->opstats->count_pair((uint)p->prev_op, op);
+
+    /* this is now the last opcode */
+    p->prev_op = (int)op;
+}
+#endif /* VM_OPSTATS */
+
+/*
+ *   Generate the display name of the function or method for a profiler
+ *   master table entry 
+ */
+static void vmrun_prof_name(VMG_ vmrun_prof_enum *ctx,
+                            CVmHashEntryProfiler *entry, char *namebuf)
+{
     const char *p;
 
     /* generate the name of the function or method */
@@ -6214,12 +6975,6 @@ void CVmRun::prof_enum_cb(void *ctx0, CVmHashEntry *entry0)
         /* it must be system code */
         strcpy(namebuf, "<System>");
     }
-
-    /* invoke the callback with the data */
-    (*ctx->cb)(ctx->cb_ctx, namebuf,
-               os_prof_time_to_ms(&entry->rec_.sum_direct),
-               os_prof_time_to_ms(&entry->rec_.sum_chi),
-               entry->rec_.call_cnt);
 }
 
 
@@ -6270,6 +7025,13 @@ void CVmRun::prof_enter(VMG_ const uchar *fptr)
         /* we have no cumulative time yet */
         p->sum_direct.hi = p->sum_direct.lo = 0;
         p->sum_chi.hi = p->sum_chi.lo = 0;
+
+        /* 
+         *   point to the master record's opcode statistics, and note that
+         *   we haven't executed any opcodes in this activation yet 
+         */
+        VM_IF_OPSTATS(p->opstats = prof_find_master_rec(p)->rec_.opstats;
+                      p->prev_op = -1;)
     }
 
     /* count the level */
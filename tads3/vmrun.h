@@ -31,6 +31,59 @@ Modified
 #include "vmfunc.h"
 
 
+/*
+ *   Number of function calls between calls to os_yield().  At typical
+ *   interpreter speeds this comes to every few milliseconds of byte code
+ *   execution; the OS layer decides whether it's actually time to yield.  
+ */
+#define VMRUN_YIELD_CALLS  4096
+
+/*
+ *   Exception table cache.  When an exception is thrown, we search the
+ *   exception table of each frame as we unwind.  Rather than reading each
+ *   table out of its method header every time, we keep the decoded tables
+ *   of recently searched methods, keyed on the method's code address.
+ *   Library code that uses exceptions for control flow tends to throw
+ *   through the same few methods over and over.
+ *   
+ *   Byte code in the code pool stays put for the life of the VM, but a
+ *   DynamicFunc's code goes away when the object is deleted, and a new
+ *   one could land at the same address, so deleting a DynamicFunc
+ *   discards the whole cache (see CVmRun::inval_exc_cache()).  
+ */
+
+/* number of methods in the exception table cache (must be a power of 2) */
+#define VMRUN_EXC_CACHE_SIZE  64
+
+/* decoded exception table entry */
+struct vm_exc_entry
+{
+    /* protected range (inclusive), as offsets from the method start */
+    uint start_ofs;
+    uint end_ofs;
+
+    /* exception class handled, or VM_INVALID_OBJ for all exceptions */
+    vm_obj_id_t exc;
+
+    /* handler offset */
+    uint handler_ofs;
+};
+
+/* decoded exception table for one method */
+struct vm_exc_cache_slot
+{
+    /* the method's code address, or null if the slot is unused */
+    const uchar *func;
+
+    /* cache generation when we decoded the table */
+    unsigned long gen;
+
+    /* the entries, and the allocated size of the array */
+    vm_exc_entry *ent;
+    size_t cnt;
+    size_t alloc;
+};
+
 /* ------------------------------------------------------------------------ */
 /*
  *   for debugger use - interpreter context save structure 
@@ -164,6 +217,35 @@ struct vm_rcdesc
     const uchar *caller_addr;
 };
 
+/*
+ *   Prepared callback descriptor.  Intrinsic methods that invoke the same
+ *   callback once per element of a collection (forEach, mapAll, subset,
+ *   indexWhich, and so on) can resolve the callback value once, with
+ *   CVmRun::prep_callback(), and then make each call with
+ *   CVmRun::call_prepared().  This skips the invoker lookup, the function
+ *   header decoding and the argument count check on every call after the
+ *   first, since none of these can change while the callback value is
+ *   held on the stack.  
+ */
+struct vm_cbcall
+{
+    /* the callback value */
+    const vm_val_t *funcptr;
+
+    /* number of arguments we pass on each call */
+    uint argc;
+
+    /* 
+     *   the resolved byte-code entrypoint, or null if the callback isn't a
+     *   byte-code function (in which case we use the general call path) 
+     */
+    const uchar *target_ptr;
+
+    /* from the function header: local variable count and stack depth */
+    uint local_cnt;
+    uint stack_depth;
+};
+
 
 /* ------------------------------------------------------------------------ */
 /*
@@ -380,6 +462,34 @@ public:
     const uchar *do_call_func_nr(VMG_ uint caller_ofs, pool_ofs_t ofs,
                                  uint argc);
 
+    /* make a recursive call to a prepared byte-code callback */
+    void do_call_prepared(VMG_ const vm_cbcall *cb,
+                          const vm_rcdesc *recurse_ctx);
+
+    /* 
+     *   Discard all cached exception tables.  This must be called when
+     *   byte code that might be in the cache is freed. 
+     */
+    static void inval_exc_cache() { ++exc_cache_gen_; }
+
+    /*
+     *   Count a function call, and let the OS layer yield the CPU every
+     *   VMRUN_YIELD_CALLS calls.  Long-running game code doesn't otherwise
+     *   return control to the host application until it needs input, which
+     *   on single-threaded GUI hosts freezes the user interface.  Counting
+     *   calls rather than instructions keeps the check out of the opcode
+     *   dispatch path, while still catching practically any lengthy
+     *   computation.  
+     */
+    void maybe_yield()
+    {
+        if (--yield_cnt_ == 0)
+        {
+            yield_cnt_ = VMRUN_YIELD_CALLS;
+            os_yield();
+        }
+    }
+
     /*
      *   Call a function pointer value.  If 'funcptr' contains a function
      *   pointer, we'll simply call the function; if it contains an
@@ -392,6 +502,28 @@ public:
     const uchar *call_func_ptr_fr(VMG_ const vm_val_t *funcptr, uint argc,
                                   const vm_rcdesc *recurse_ctx,
                                   uint caller_ofs);
+
+    /* 
+     *   Prepare a callback for repeated recursive calls with 'argc'
+     *   arguments.  'funcptr' must stay valid (and unchanged) for as long
+     *   as the descriptor is in use; it's usually the callback argument
+     *   still on the stack. 
+     */
+    void prep_callback(VMG_ vm_cbcall *cb, const vm_val_t *funcptr,
+                       uint argc);
+
+    /* 
+     *   Invoke a prepared callback recursively.  The caller pushes the
+     *   arguments first, as for call_func_ptr(); the result is in R0. 
+     */
+    void call_prepared(VMG_ const vm_cbcall *cb,
+                       const vm_rcdesc *recurse_ctx)
+    {
+        if (cb->target_ptr != 0)
+            do_call_prepared(vmg_ cb, recurse_ctx);
+        else
+            call_func_ptr(vmg_ cb->funcptr, cb->argc, recurse_ctx, 0);
+    }
         
     /*
      *   Get the descriptive message, if any, from an exception object.
@@ -1093,6 +1225,17 @@ public:
                                        unsigned long call_cnt),
                             void *cb_ctx);
 
+    /*
+     *   Get the opcode statistics (only available in VM_OPSTATS builds).
+     *   We invoke the callback once for each opcode executed in each
+     *   function, with op2 set to -1, and once for each opcode pair, with
+     *   op1 set to the first opcode of the pair and op2 to the second.  
+     */
+    void get_opstats_data(VMG_
+                          void (*cb)(void *ctx, const char *func_name,
+                                     int op1, int op2, unsigned long cnt),
+                          void *cb_ctx);
+
     /* get the last program counter address */
     VM_REG_ACCESS const uchar *get_last_pc() VM_REG_CONST
         { return pc_ptr_ != 0 ? *pc_ptr_ : 0; }
@@ -1307,8 +1450,14 @@ protected:
      */
     int pop2_equal(VMG0_)
     {
-        /* compare the values and return the result */
-        int ret = get(1)->equals(vmg_ get(0));
+        /* 
+         *   compare the values and return the result; handle the common
+         *   case of two integers inline 
+         */
+        const vm_val_t *a = get(1), *b = get(0);
+        int ret = (a->typ == VM_INT && b->typ == VM_INT
+                   ? a->val.intval == b->val.intval
+                   : a->equals(vmg_ b));
 
         /* discard the values */
         discard(2);
@@ -1448,6 +1597,9 @@ protected:
     /* record a function or method exit in the profiler data */
     void prof_leave();
 
+    /* count an opcode in the opcode statistics */
+    void prof_count_op(uint op);
+
     /* find or create a function entry in the master profiler table */
     class CVmHashEntryProfiler
         *prof_find_master_rec(const struct vm_profiler_rec *p);
@@ -1462,6 +1614,9 @@ protected:
     /* hash table enumeration callback for dumping profiler data */
     static void prof_enum_cb(void *ctx0, class CVmHashEntry *entry0);
 
+    /* hash table enumeration callback for dumping opcode statistics */
+    static void prof_opstats_enum_cb(void *ctx0, class CVmHashEntry *entry0);
+
     /* validate the built-in function pointer at top of stack */
     void validate_bifptr(VMG0_);
 
@@ -1470,6 +1625,15 @@ protected:
      */
     size_t funchdr_size_;
 
+    /* get the decoded exception table for a method */
+    const vm_exc_cache_slot *get_exc_table(VMG_ const uchar *func_start);
+
+    /* exception table cache */
+    vm_exc_cache_slot exc_cache_[VMRUN_EXC_CACHE_SIZE];
+
+    /* exception table cache generation */
+    static unsigned long exc_cache_gen_;
+
     /*
      *   A pointer to a global variable in the object table (CVmObjTable)
      *   containing the function to invoke for the SAY and SAYVAL opcodes.
@@ -1519,6 +1683,12 @@ protected:
      */
     int halt_vm_;
 
+    /* 
+     *   Function calls remaining until we next give the OS layer a chance
+     *   to yield the CPU (see maybe_yield()).  
+     */
+    uint yield_cnt_;
+
     /* flag: profiling is active */
     int profiling_;
 
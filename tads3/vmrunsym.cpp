@@ -20,6 +20,8 @@ Modified
   02/17/01 MJRoberts  - Creation
 */
 
+#include <string.h>
+
 #include "t3std.h"
 #include "vmtype.h"
 #include "vmrunsym.h"
@@ -167,3 +169,57 @@ const char *CVmRuntimeSymbols::find_val_name(VMG_ const vm_val_t *val,
     *name_len = 0;
     return 0;
 }
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Build a display name for a function or method 
+ */
+void vm_code_name(VMG_ const CVmRuntimeSymbols *symtab,
+                  char *buf, size_t buflen, const uchar *ep,
+                  vm_obj_id_t defobj, vm_prop_id_t prop,
+                  const vm_val_t *invokee)
+{
+    const char *sym;
+    size_t len;
+
+    if (ep == 0)
+    {
+        /* no byte code was running */
+        t3sprintf(buf, buflen, "<vm>");
+    }
+    else if (defobj != VM_INVALID_OBJ)
+    {
+        /* 
+         *   it's a method - name it as object.property; keep the object
+         *   name to half the buffer, so that there's room for the property 
+         */
+        if (symtab != 0
+            && (sym = symtab->find_obj_name(vmg_ defobj, &len)) != 0)
+            t3sprintf(buf, buflen / 2, "%.*s", (int)len, sym);
+        else
+            t3sprintf(buf, buflen / 2, "obj#%lx", (long)defobj);
+
+        size_t used = strlen(buf);
+        if (symtab != 0
+            && (sym = symtab->find_prop_name(vmg_ prop, &len)) != 0)
+            t3sprintf(buf + used, buflen - used, ".%.*s", (int)len, sym);
+        else
+            t3sprintf(buf + used, buflen - used, ".prop#%x", (int)prop);
+    }
+    else if (invokee->typ == VM_FUNCPTR && symtab != 0
+             && (sym = symtab->find_val_name(vmg_ invokee, &len)) != 0)
+    {
+        /* it's a named function */
+        t3sprintf(buf, buflen, "%.*s", (int)len, sym);
+    }
+    else if (invokee->typ == VM_FUNCPTR)
+    {
+        /* it's a function we can't name - use its code offset */
+        t3sprintf(buf, buflen, "func#%lx", (long)invokee->val.ofs);
+    }
+    else
+    {
+        /* anonymous function or other system code */
+        t3sprintf(buf, buflen, "<code@%lx>", (unsigned long)(size_t)ep);
+    }
+}
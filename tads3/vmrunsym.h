@@ -123,6 +123,23 @@ protected:
     size_t cnt_;
 };
 
+/*
+ *   Build a display name for a function or method, for diagnostic reports
+ *   such as the sampling profiler's.  'ep' is the entry pointer of the
+ *   code; 'defobj' and 'prop' are the defining object and property for a
+ *   method, or VM_INVALID_OBJ for a function, in which case 'invokee' is
+ *   the function value.  Methods are named as "object.property", and
+ *   functions by name; anything we can't find in 'symtab' (which can be
+ *   null if the program has no symbols) is named by its ID or code
+ *   address.  A null 'ep' means that no byte code was running.  The name
+ *   is truncated as needed to fit 'buflen' bytes, including the null
+ *   terminator.  
+ */
+void vm_code_name(VMG_ const CVmRuntimeSymbols *symtab,
+                  char *buf, size_t buflen, const uchar *ep,
+                  vm_obj_id_t defobj, vm_prop_id_t prop,
+                  const vm_val_t *invokee);
+
 /*
  *   A Symbol
  */
@@ -0,0 +1,429 @@
+/*
+ *   Please see the accompanying license file, LICENSE.TXT, for information
+ *   on using and copying this software.
+ */
+/*
+Name
+  vmsample.cpp - T3 VM sampling profiler
+Function
+  See vmsample.h.
+Notes
+
+Modified
+  10/14/26  - Creation
+*/
+
+#include "vmsample.h"
+
+#ifdef VM_SAMPLER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "t3std.h"
+#include "os.h"
+#include "vmtype.h"
+#include "vmglob.h"
+#include "vmrun.h"
+#include "vmstack.h"
+#include "vmfunc.h"
+#include "vmhash.h"
+#include "vmimage.h"
+#include "vmrunsym.h"
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Sampler limits
+ */
+
+/* maximum number of stack frames we record per sample */
+const size_t VMSAMPLE_MAX_DEPTH = 64;
+
+/* number of frame records in the sample buffer */
+const size_t VMSAMPLE_BUF_FRAMES = 256*1024;
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Raw frame record.  The signal handler fills these in; each sample is a
+ *   header record (with a null entry pointer, and the number of frames in
+ *   the 'ofs' field) followed by its frames, innermost first.
+ */
+struct vmsample_frame
+{
+    /* entry pointer of the function (the method header) */
+    const uchar *ep;
+
+    /* offset of the current instruction from the entry pointer */
+    ulong ofs;
+
+    /* defining object and target property, for a method */
+    vm_obj_id_t defobj;
+    vm_prop_id_t prop;
+
+    /* the invokee, for a function */
+    vm_val_t invokee;
+};
+
+/*
+ *   Sampler state.  This is static, since the signal handler needs to get
+ *   at it.
+ */
+static struct
+{
+    /* globals for the VM we're sampling */
+    vm_globals *vmg;
+
+    /* the thread running the VM */
+    pthread_t thread;
+
+    /* output file name */
+    char *fname;
+
+    /* sample buffer, and number of records in use */
+    vmsample_frame *buf;
+    volatile size_t used;
+
+    /* number of samples taken, and number dropped due to a full buffer */
+    volatile unsigned long taken;
+    volatile unsigned long dropped;
+
+    /* original SIGPROF action, to restore when we're done */
+    struct sigaction old_action;
+
+    /* flag: sampling is active */
+    volatile sig_atomic_t active;
+} S;
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Timer signal handler.  This takes a sample of the current stack.  We
+ *   only read VM state here, and only store into the preallocated buffer,
+ *   so we're safe no matter what the interpreter was doing when the signal
+ *   arrived.
+ */
+static void vmsample_handler(int)
+{
+    /* if we're not active, ignore it */
+    if (!S.active)
+        return;
+
+    /*
+     *   The timer counts CPU time for the whole process, and the kernel
+     *   delivers the signal to whichever thread happens to be running when
+     *   it expires.  If that's not the VM thread (one of the host's image
+     *   decoding or sound threads, say), the time wasn't spent running byte
+     *   code, and the VM's state can't be read safely from here anyway, so
+     *   skip this tick.
+     */
+    if (!pthread_equal(pthread_self(), S.thread))
+        return;
+
+    /* set up access to the VM globals */
+    VMGLOB_PTR(S.vmg);
+
+    /* if there's not enough room for a full sample, drop it */
+    if (S.used + VMSAMPLE_MAX_DEPTH + 1 > VMSAMPLE_BUF_FRAMES)
+    {
+        ++S.dropped;
+        return;
+    }
+
+    /* if the VM isn't running byte code right now, there's nothing to do */
+    const uchar *pc = G_interpreter->get_last_pc();
+    vm_val_t *fp = G_interpreter->get_frame_ptr();
+    const uchar *ep = G_interpreter->get_entry_ptr();
+    if (pc == 0 || fp == 0 || ep == 0)
+        return;
+
+    /* set up the sample header */
+    vmsample_frame *hdr = &S.buf[S.used];
+    vmsample_frame *dst = hdr + 1;
+    size_t depth;
+
+    /* walk the frame chain */
+    for (depth = 0 ; depth < VMSAMPLE_MAX_DEPTH && fp != 0 && ep != 0 ;
+         ++depth, ++dst)
+    {
+        /*
+         *   make sure the frame pointer is within the active part of the
+         *   stack - if not, we've caught a frame in mid-construction, so
+         *   stop here
+         */
+        ulong idx = G_stk->ptr_to_index(fp);
+        if (idx <= (ulong)(-VMRUN_FPOFS_ARG1) || idx > G_stk->get_depth())
+            break;
+
+        /* record this frame */
+        dst->ep = ep;
+        dst->ofs = (ulong)(pc - ep);
+        dst->defobj = G_interpreter->get_defining_obj_from_frame(vmg_ fp);
+        dst->prop = G_interpreter->get_target_prop_from_frame(vmg_ fp);
+        dst->invokee = *G_interpreter->get_invokee_from_frame(vmg_ fp);
+
+        /*
+         *   move to the caller; if this frame was invoked recursively from
+         *   native code, the calling instruction is the one that invoked
+         *   the native code, which we can't see, so stop at the start of
+         *   the calling function
+         */
+        pc = G_interpreter->get_return_addr_from_frame(vmg_ fp);
+        ep = G_interpreter->get_enclosing_entry_ptr_from_frame(vmg_ fp);
+        fp = G_interpreter->get_enclosing_frame_ptr(vmg_ fp);
+        if (pc == 0)
+            pc = ep;
+    }
+
+    /* if we got any frames, commit the sample */
+    if (depth != 0)
+    {
+        hdr->ep = 0;
+        hdr->ofs = depth;
+        S.used += depth + 1;
+        ++S.taken;
+    }
+}
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Start sampling
+ */
+void vm_sampler_start(VMG_ const char *fname, unsigned long interval_us)
+{
+    /* if we're already running, ignore the request */
+    if (S.active || S.buf != 0)
+        return;
+
+    /* set up the state */
+    S.vmg = VMGLOB_ADDR;
+    S.thread = pthread_self();
+    S.fname = lib_copy_str(fname);
+    S.buf = (vmsample_frame *)t3malloc(
+        VMSAMPLE_BUF_FRAMES * sizeof(vmsample_frame));
+    S.used = 0;
+    S.taken = S.dropped = 0;
+    if (S.buf == 0)
+        return;
+
+    /* install the signal handler */
+    struct sigaction act;
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = &vmsample_handler;
+    act.sa_flags = SA_RESTART;
+    sigemptyset(&act.sa_mask);
+    sigaction(SIGPROF, &act, &S.old_action);
+
+    /* start the CPU-time interval timer */
+    S.active = TRUE;
+    struct itimerval tv;
+    tv.it_interval.tv_sec = interval_us / 1000000;
+    tv.it_interval.tv_usec = interval_us % 1000000;
+    tv.it_value = tv.it_interval;
+    setitimer(ITIMER_PROF, &tv, 0);
+}
+
+/*
+ *   Start sampling if requested in the environment
+ */
+void vm_sampler_start_from_env(VMG0_)
+{
+    const char *fname = getenv("T3_SAMPLE_PROFILE");
+    if (fname != 0 && fname[0] != '\0')
+    {
+        /* get the interval, if specified */
+        const char *ival = getenv("T3_SAMPLE_INTERVAL");
+        unsigned long interval_us = (ival != 0 ? strtoul(ival, 0, 10) : 0);
+        if (interval_us == 0)
+            interval_us = 1000;
+
+        /* start sampling */
+        vm_sampler_start(vmg_ fname, interval_us);
+    }
+}
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Hash table entries for building the output
+ */
+
+/* function name cache entry, keyed on the raw frame identity */
+class CVmHashEntrySampleName: public CVmHashEntryCS
+{
+public:
+    CVmHashEntrySampleName(const char *key, size_t len, const char *name)
+        : CVmHashEntryCS(key, len, TRUE)
+        { name_ = lib_copy_str(name); }
+
+    ~CVmHashEntrySampleName() { lib_free_str(name_); }
+
+    /* the display name */
+    char *name_;
+};
+
+/* collapsed stack entry, keyed on the stack text */
+class CVmHashEntrySampleStack: public CVmHashEntryCS
+{
+public:
+    CVmHashEntrySampleStack(const char *key, size_t len)
+        : CVmHashEntryCS(key, len, TRUE)
+        { cnt_ = 0; }
+
+    /* number of samples with this stack */
+    unsigned long cnt_;
+};
+
+/*
+ *   Get the display name for a sampled frame
+ */
+static const char *vmsample_frame_name(VMG_ CVmHashTable *names,
+                                       const vmsample_frame *f)
+{
+    /* build the key from the frame's identity */
+    char key[sizeof(f->ep) + sizeof(f->defobj) + sizeof(f->prop)];
+    memcpy(key, &f->ep, sizeof(f->ep));
+    memcpy(key + sizeof(f->ep), &f->defobj, sizeof(f->defobj));
+    memcpy(key + sizeof(f->ep) + sizeof(f->defobj),
+           &f->prop, sizeof(f->prop));
+
+    /* if we've already named this one, use the cached name */
+    CVmHashEntrySampleName *entry = (CVmHashEntrySampleName *)
+                                    names->find(key, sizeof(key));
+    if (entry != 0)
+        return entry->name_;
+
+    /* 
+     *   generate the name, replacing any characters that are special in
+     *   the collapsed-stack format 
+     */
+    char buf[256];
+    vm_code_name(vmg_ G_image_loader != 0
+                      ? G_image_loader->get_runtime_symtab() : 0,
+                 buf, sizeof(buf), f->ep, f->defobj, f->prop, &f->invokee);
+    for (char *p = buf ; *p != '\0' ; ++p)
+    {
+        if (*p == ';' || *p == ' ')
+            *p = '_';
+    }
+
+    /* cache it */
+    entry = new CVmHashEntrySampleName(key, sizeof(key), buf);
+    names->add(entry);
+    return entry->name_;
+}
+
+/*
+ *   Write a collapsed stack entry to the output file
+ */
+static void vmsample_write_cb(void *ctx, CVmHashEntry *entry0)
+{
+    osfildef *fp = (osfildef *)ctx;
+    CVmHashEntrySampleStack *entry = (CVmHashEntrySampleStack *)entry0;
+    char buf[32];
+
+    /* write "stack count" */
+    osfwb(fp, entry->getstr(), entry->getlen());
+    sprintf(buf, " %lu\n", entry->cnt_);
+    os_fprintz(fp, buf);
+}
+
+/*
+ *   Stop sampling and write the results
+ */
+void vm_sampler_stop(VMG0_)
+{
+    /* if we never started, there's nothing to do */
+    if (S.buf == 0)
+        return;
+
+    /* stop the timer and restore the original signal handler */
+    struct itimerval tv;
+    memset(&tv, 0, sizeof(tv));
+    setitimer(ITIMER_PROF, &tv, 0);
+    S.active = FALSE;
+    sigaction(SIGPROF, &S.old_action, 0);
+
+    /* fold the samples into distinct stacks */
+    CVmHashTable *names = new CVmHashTable(1024, new CVmHashFuncCS(), TRUE);
+    CVmHashTable *stacks = new CVmHashTable(4096, new CVmHashFuncCS(), TRUE);
+    size_t bufsiz = VMSAMPLE_MAX_DEPTH * 300;
+    char *stk = (char *)t3malloc(bufsiz);
+    for (size_t i = 0 ; i < S.used ; )
+    {
+        /* get the sample header */
+        size_t depth = (size_t)S.buf[i].ofs;
+        const vmsample_frame *frames = &S.buf[i + 1];
+        i += depth + 1;
+
+        /* build the stack text, outermost frame first */
+        size_t len = 0;
+        for (size_t j = depth ; j != 0 ; --j)
+        {
+            const vmsample_frame *f = &frames[j - 1];
+            const char *name = vmsample_frame_name(vmg_ names, f);
+            char linebuf[32];
+
+            /* add the source line, if we have debug records for it */
+            CVmFuncPtr func(f->ep);
+            CVmDbgLinePtr line;
+            const uchar *stm_start, *stm_end;
+            linebuf[0] = '\0';
+            if (CVmRun::get_stm_bounds(vmg_ &func, f->ofs, &line,
+                                       &stm_start, &stm_end))
+                t3sprintf(linebuf, sizeof(linebuf), ":%lu",
+                          line.get_source_line());
+
+            /* add the separator and the frame */
+            size_t need = strlen(name) + strlen(linebuf) + 1;
+            if (len + need + 1 > bufsiz)
+                break;
+            if (len != 0)
+                stk[len++] = ';';
+            strcpy(stk + len, name);
+            strcat(stk + len, linebuf);
+            len += strlen(stk + len);
+        }
+
+        /* count it */
+        CVmHashEntrySampleStack *entry =
+            (CVmHashEntrySampleStack *)stacks->find(stk, len);
+        if (entry == 0)
+        {
+            entry = new CVmHashEntrySampleStack(stk, len);
+            stacks->add(entry);
+        }
+        ++entry->cnt_;
+    }
+
+    /* write the output file */
+    osfildef *fp = osfopwt(S.fname, OSFTTEXT);
+    if (fp != 0)
+    {
+        stacks->enum_entries(&vmsample_write_cb, fp);
+        if (S.dropped != 0)
+        {
+            char buf[64];
+            sprintf(buf, "<dropped> %lu\n", S.dropped);
+            os_fprintz(fp, buf);
+        }
+        osfcls(fp);
+    }
+
+    /* clean up */
+    t3free(stk);
+    delete stacks;
+    delete names;
+    t3free(S.buf);
+    S.buf = 0;
+    lib_free_str(S.fname);
+    S.fname = 0;
+}
+
+#endif /* VM_SAMPLER */
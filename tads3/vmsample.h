@@ -0,0 +1,74 @@
+/*
+ *   Please see the accompanying license file, LICENSE.TXT, for information
+ *   on using and copying this software.
+ */
+/*
+Name
+  vmsample.h - T3 VM sampling profiler
+Function
+  A low-overhead statistical profiler for T3 byte code.  Rather than
+  instrumenting every call and return, as the regular profiler (vmprof.h)
+  does, we take a snapshot of the current program counter and the chain of
+  active stack frames at a fixed interval, driven by a CPU-time interval
+  timer.  Between samples, the interpreter runs at full speed.
+
+  When sampling stops, we map each frame back to a function or
+  object.property name through the runtime global symbol table (and to a
+  source line, if the image has debug line records), and write the samples
+  as a "collapsed stack" file: one line per distinct call stack, with the
+  frames listed outermost first and separated by semicolons, followed by
+  the number of samples.  This is the input format of the common flame
+  graph tools.
+Notes
+  The sampler relies on setitimer() and SIGPROF, so it's only available on
+  Unix-like systems.  It's compiled in only if VM_SAMPLER is defined (see
+  the t3_sampler option in qtads.pro).
+
+  The signal handler only copies raw frame data into a buffer allocated in
+  advance; all symbol lookups and file output happen after the timer is
+  stopped.  If the buffer fills up, further samples are counted but
+  dropped.
+
+  The timer measures CPU time for the whole process, so it also runs while
+  the host's other threads (image decoders, sound) are busy.  Ticks delivered
+  to any thread other than the one that started the sampler are ignored,
+  so the samples cover only time spent on the VM thread.
+Modified
+  10/14/26  - Creation
+*/
+
+#ifndef VMSAMPLE_H
+#define VMSAMPLE_H
+
+#include "vmglob.h"
+
+#ifdef VM_SAMPLER
+
+/* include sampler-only code */
+#define VM_IF_SAMPLER(x)  x
+
+/*
+ *   Start sampling.  'fname' is the name of the collapsed-stack file to
+ *   write when sampling stops, and 'interval_us' is the sampling interval
+ *   in microseconds of CPU time.
+ */
+void vm_sampler_start(VMG_ const char *fname, unsigned long interval_us);
+
+/*
+ *   Start sampling if requested through the environment.  If the variable
+ *   T3_SAMPLE_PROFILE is set, it gives the output file name; the optional
+ *   variable T3_SAMPLE_INTERVAL gives the interval in microseconds (the
+ *   default is 1000, for one millisecond).
+ */
+void vm_sampler_start_from_env(VMG0_);
+
+/* stop sampling and write the collapsed-stack file */
+void vm_sampler_stop(VMG0_);
+
+#else /* VM_SAMPLER */
+
+#define VM_IF_SAMPLER(x)
+
+#endif /* VM_SAMPLER */
+
+#endif /* VMSAMPLE_H */
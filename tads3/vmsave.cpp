@@ -68,6 +68,8 @@ Modified
 #include "vmcrc.h"
 #include "vmlookup.h"
 #include "vmstr.h"
+#include "vmhost.h"
+#include "vmlz.h"
 
 
 /* ------------------------------------------------------------------------ */
@@ -90,39 +92,26 @@ Modified
  */
 #define VMSAVEFILE_SIG "T3-state-v000A\015\012\032"
 
+/*
+ *   Compressed saved state signature.  A compressed file has the same
+ *   layout as an uncompressed one up through the metadata table, so tools
+ *   can still find the image filename and metadata without decompressing
+ *   anything.  The object data that follow are stored as the uncompressed
+ *   size (UINT4), the compressed size (UINT4), and an LZ4 block (see
+ *   vmlz.h).  The checksum covers the stored (compressed) bytes.  This
+ *   has the same length as the uncompressed signature.  
+ */
+#define VMSAVEFILE_SIG_LZ "T3-state-z000A\015\012\032"
+
 
 /* ------------------------------------------------------------------------ */
 /*
- *   Compute the checksum of the contents of a file stream.  We'll compute
- *   the checksum of the given file, starting at the current seek position
- *   and running for the requested number of bytes.  
+ *   Compute the checksum of a block of memory 
  */
-static unsigned long compute_checksum(CVmFile *fp, unsigned long len)
+static unsigned long compute_checksum(const char *buf, size_t len)
 {
     CVmCRC32 crc;
-
-    /* read the file and compute the CRC value for its contents */
-    while (len != 0)
-    {
-        char buf[256];
-        size_t cur_len;
-        
-        /* figure out how much we can load from the file */
-        cur_len = sizeof(buf);
-        if (cur_len > len)
-            cur_len = (size_t)len;
-
-        /* load the data from the file */
-        fp->read_bytes(buf, cur_len);
-
-        /* deduct the amount we read from the overall file length remaining */
-        len -= cur_len;
-
-        /* scan this block into the checksum */
-        crc.scan_bytes(buf, cur_len);
-    }
-
-    /* return the computed value */
+    crc.scan_bytes(buf, len);
     return crc.get_crc_val();
 }
 
@@ -181,16 +170,54 @@ struct metatab_saver
  */
 void CVmSaveFile::save(VMG_ CVmFile *fp, CVmObjLookupTable *metatab)
 {
-    /* write the signature */
-    fp->write_bytes(VMSAVEFILE_SIG, sizeof(VMSAVEFILE_SIG)-1);
-
-    /* note the seek position of the start of the file header */
-    long startpos = fp->get_pos();
-
-    /* write a placeholder for the stream size and checksum */
-    fp->write_uint4(0);
-    fp->write_uint4(0);
+    /* note whether we're writing a compressed file */
+    int compress = G_save_compress;
+
+    /*
+     *   Write everything after the size/checksum fields into memory first.
+     *   Parts of the data are written out of order (some writers go back
+     *   to fill in counts), so we can't checksum them on the way out; once
+     *   they're in memory, we can checksum them there and then write the
+     *   whole file in one sequential pass, rather than writing the file
+     *   and reading it all back for the checksum.  
+     */
+    CVmFile *body = new CVmFile();
+    char *buf = 0;
+    err_try
+    {
+        body->open_memory();
+        save_body(vmg_ body, metatab, compress);
+
+        /* take the buffer, and compute its checksum */
+        size_t datasize;
+        buf = body->detach_memory(&datasize);
+        unsigned long crcval = compute_checksum(buf, datasize);
+
+        /* write the signature */
+        fp->write_bytes(compress ? VMSAVEFILE_SIG_LZ : VMSAVEFILE_SIG,
+                        sizeof(VMSAVEFILE_SIG)-1);
+
+        /* write the stream size and checksum, then the stream */
+        fp->write_uint4(datasize);
+        fp->write_uint4(crcval);
+        fp->write_bytes(buf, datasize);
+    }
+    err_finally
+    {
+        if (buf != 0)
+            t3free(buf);
+        delete body;
+    }
+    err_end;
+}
 
+/*
+ *   Write the part of the saved state that follows the size/checksum
+ *   fields 
+ */
+void CVmSaveFile::save_body(VMG_ CVmFile *fp, CVmObjLookupTable *metatab,
+                            int compress)
+{
     /* write the image file's timestamp */
     fp->write_bytes(G_image_loader->get_timestamp(), 24);
 
@@ -237,41 +264,331 @@ void CVmSaveFile::save(VMG_ CVmFile *fp, CVmObjLookupTable *metatab)
         fp->write_uint2(0);
     }
 
-    /* save all modified object state */
-    G_obj_table->save(vmg_ fp);
+    if (compress)
+    {
+        /* save the object data compressed */
+        save_compressed(vmg_ fp);
+    }
+    else
+    {
+        /* save all modified object state */
+        G_obj_table->save(vmg_ fp);
 
-    /* save the synthesized exports */
-    G_image_loader->save_synth_exports(vmg_ fp);
+        /* save the synthesized exports */
+        G_image_loader->save_synth_exports(vmg_ fp);
+    }
+}
 
-    /* remember where the file ends */
-    long endpos = fp->get_pos();
+/* ------------------------------------------------------------------------ */
+/*
+ *   Save the object data section compressed.  We write the section into a
+ *   memory file exactly as we would for an uncompressed save, then
+ *   compress the whole thing as a single block.  
+ */
+void CVmSaveFile::save_compressed(VMG_ CVmFile *fp)
+{
+    CVmFile *mem = new CVmFile();
+    char *buf = 0;
+    char *cbuf = 0;
+    err_try
+    {
+        /* write the object data into memory */
+        mem->open_memory();
+        G_obj_table->save(vmg_ mem);
+        G_image_loader->save_synth_exports(vmg_ mem);
+
+        /* take the buffer from the memory file */
+        size_t len;
+        buf = mem->detach_memory(&len);
+
+        /* compress it */
+        size_t cmax = lz_compress_bound(len);
+        cbuf = (char *)t3malloc(cmax);
+        if (cbuf == 0)
+            err_throw(VMERR_OUT_OF_MEMORY);
+        size_t clen = lz_compress(buf, len, cbuf, cmax);
+        if (clen == 0)
+            err_throw(VMERR_WRITE_FILE);
+
+        /* write the sizes and the compressed data */
+        fp->write_uint4(len);
+        fp->write_uint4(clen);
+        fp->write_bytes(cbuf, clen);
+    }
+    err_finally
+    {
+        /* free our buffers and the memory file */
+        if (cbuf != 0)
+            t3free(cbuf);
+        if (buf != 0)
+            t3free(buf);
+        delete mem;
+    }
+    err_end;
+}
 
-    /* 
-     *   compute the size of the data stream - this includes everything
-     *   after the size/checksum fields 
-     */
-    unsigned long datasize = endpos - startpos - 8;
+/*
+ *   Load and decompress the object data section of a compressed saved
+ *   state file.  Returns a memory file positioned at the start of the
+ *   uncompressed data, or null if the data are corrupted.  
+ */
+CVmFile *CVmSaveFile::load_compressed(CVmFile *fp)
+{
+    /* read the sizes */
+    unsigned long len = fp->read_uint4();
+    unsigned long clen = fp->read_uint4();
+
+    /* allocate the buffers */
+    char *cbuf = (char *)t3malloc(clen != 0 ? clen : 1);
+    char *buf = (char *)t3malloc(len != 0 ? len : 1);
+    if (cbuf == 0 || buf == 0)
+    {
+        if (cbuf != 0)
+            t3free(cbuf);
+        if (buf != 0)
+            t3free(buf);
+        err_throw(VMERR_OUT_OF_MEMORY);
+    }
+
+    /* read and decompress the data */
+    int bad = TRUE;
+    err_try
+    {
+        fp->read_bytes(cbuf, clen);
+        bad = (len == 0 || lz_decompress(cbuf, clen, buf, len) != 0);
+    }
+    err_finally
+    {
+        t3free(cbuf);
+        if (bad)
+            t3free(buf);
+    }
+    err_end;
+
+    /* if the data are bad, say so */
+    if (bad)
+        return 0;
+
+    /* set up a memory file on the decompressed data */
+    CVmFile *mem = new CVmFile();
+    mem->open_memory(buf, len);
+    return mem;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Save VM state to a memory buffer 
+ */
+char *CVmSaveFile::save_to_memory(VMG_ CVmObjLookupTable *metatab,
+                                  size_t *len)
+{
+    /* set up a memory file and save the state into it */
+    CVmFile *file = new CVmFile();
+    err_try
+    {
+        file->open_memory();
+        save(vmg_ file, metatab);
+    }
+    err_catch_disc
+    {
+        /* discard the partial file and pass the error along */
+        delete file;
+        err_rethrow();
+    }
+    err_end;
+
+    /* take the buffer from the file, and we're done with the file */
+    char *buf = file->detach_memory(len);
+    delete file;
+
+    /* return the buffer */
+    return buf;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Autosave.  We do all of the work that needs the VM here, on the VM
+ *   thread: the game state is serialized into a memory buffer.  This still
+ *   has to visit every saved object, so it's only done at the command
+ *   prompt, after the idle collection pass has done the garbage collection
+ *   that a save otherwise starts with.  We then hand the finished buffer
+ *   to the host, which can write it out in the background while the player
+ *   types.  
+ */
+void CVmSaveFile::autosave(VMG0_)
+{
+    /* if the host doesn't want autosaves, there's nothing to do */
+    const char *fname = G_host_ifc->get_autosave_file();
+    if (fname == 0)
+        return;
+
+    err_try
+    {
+        /* save the state to memory */
+        size_t len;
+        char *buf = save_to_memory(vmg_ 0, &len);
+
+        /* hand it to the host to write out */
+        G_host_ifc->write_autosave(fname, buf, len);
+    }
+    err_catch_disc
+    {
+        /* 
+         *   ignore errors - an autosave failure shouldn't interrupt the
+         *   game, and the player can still save explicitly 
+         */
+    }
+    err_end;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Restore the startup snapshot 
+ */
+int CVmSaveFile::restore_snapshot(VMG0_)
+{
+    /* if the host doesn't keep snapshots, there's nothing to restore */
+    const char *fname = G_host_ifc->get_snapshot_file();
+    if (fname == 0)
+        return FALSE;
+
+    /* if there's no snapshot yet, the caller must run the initializers */
+    osfildef *fp = osfoprb(fname, OSFTT3SAV);
+    if (fp == 0)
+        return FALSE;
+
+    int ok = FALSE;
+    CVmFile *file = new CVmFile(fp, 0);
+    err_try
+    {
+        /* 
+         *   Restore the snapshot.  restore() checks the signature, checksum
+         *   and image timestamp before it touches the VM state, and simply
+         *   returns an error code if any of those are wrong, so a stale
+         *   snapshot leaves us exactly where we started.  
+         */
+        ok = (restore(vmg_ file) == 0);
+    }
+    err_catch_disc
+    {
+        /* 
+         *   The snapshot failed partway through loading, so the object
+         *   state is unusable.  Start over from the image, which runs the
+         *   static initializers for us.  
+         */
+        reset(vmg0_);
+        ok = TRUE;
+    }
+    err_end;
+
+    /* done with the file */
+    delete file;
 
     /* 
-     *   seek back to just after the size/checksum header - this is the
-     *   start of the section of the file for which we must compute the
-     *   checksum 
+     *   if the snapshot didn't restore cleanly, delete it, so that the
+     *   caller's new snapshot replaces it 
      */
-    fp->set_pos(startpos + 8);
+    if (!ok)
+        osfdel(fname);
 
-    /* compute the checksum */
-    unsigned long crcval = compute_checksum(fp, datasize);
+    /* tell the caller whether the static init state is ready */
+    return ok;
+}
+
+/*
+ *   Save the startup snapshot 
+ */
+void CVmSaveFile::save_snapshot(VMG0_)
+{
+    /* if the host doesn't keep snapshots, there's nothing to do */
+    const char *fname = G_host_ifc->get_snapshot_file();
+    if (fname == 0)
+        return;
+
+    err_try
+    {
+        /* 
+         *   save the state to memory, and hand it to the host to write out
+         *   the same way it writes autosaves, which lets it do the disk
+         *   write in the background while the program starts up 
+         */
+        size_t len;
+        char *buf = save_to_memory(vmg_ 0, &len);
+        G_host_ifc->write_autosave(fname, buf, len);
+    }
+    err_catch_disc
+    {
+        /* ignore errors - the snapshot is only a cache */
+    }
+    err_end;
+}
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Save the pristine state 
+ */
+void CVmSaveFile::save_pristine(VMG0_)
+{
     /* 
-     *   seek back to the size/checksum header, and fill in those fields now
-     *   that we know their values 
+     *   don't compress it - it never leaves memory, and we want restoring
+     *   it to be as fast as possible 
      */
-    fp->set_pos(startpos);
-    fp->write_uint4(datasize);
-    fp->write_uint4(crcval);
+    int old_compress = G_save_compress;
+    G_save_compress = FALSE;
+
+    err_try
+    {
+        size_t len;
+        char *buf = save_to_memory(vmg_ 0, &len);
+        G_image_loader->set_pristine_state(buf, len);
+    }
+    err_catch_disc
+    {
+        /* ignore errors - without the state, reset() does a full reset */
+    }
+    err_end;
+
+    G_save_compress = old_compress;
+}
+
+/*
+ *   Restore the pristine state 
+ */
+int CVmSaveFile::restore_pristine(VMG0_)
+{
+    /* if we don't have the pristine state, the caller must do a full reset */
+    size_t len;
+    char *buf = G_image_loader->take_pristine_state(&len);
+    if (buf == 0)
+        return FALSE;
+
+    /* restore from a memory file on the state */
+    int ok = FALSE;
+    CVmFile *file = new CVmFile();
+    file->open_memory(buf, len);
+    err_try
+    {
+        ok = (restore(vmg_ file) == 0);
+    }
+    err_catch_disc
+    {
+        /* 
+         *   the object state is unusable after a partial restore; the
+         *   caller's full reset will fix it 
+         */
+    }
+    err_end;
+
+    /* take the buffer back, and keep it for next time if it worked */
+    buf = file->detach_memory(&len);
+    delete file;
+    if (ok)
+        G_image_loader->set_pristine_state(buf, len);
+    else
+        t3free(buf);
 
-    /* seek back to the end of the file */
-    fp->set_pos(endpos);
+    /* tell the caller whether we reset the state */
+    return ok;
 }
 
 /* ------------------------------------------------------------------------ */
@@ -288,7 +605,8 @@ int CVmSaveFile::restore_get_image(osfildef *fp,
         return VMERR_READ_FILE;
 
     /* check the signature */
-    if (memcmp(buf, VMSAVEFILE_SIG, sizeof(VMSAVEFILE_SIG)-1) != 0)
+    if (memcmp(buf, VMSAVEFILE_SIG, sizeof(VMSAVEFILE_SIG)-1) != 0
+        && memcmp(buf, VMSAVEFILE_SIG_LZ, sizeof(VMSAVEFILE_SIG_LZ)-1) != 0)
         return VMERR_NOT_SAVED_STATE;
 
     /* read the length of the image file name */
@@ -320,38 +638,79 @@ int CVmSaveFile::restore_get_image(osfildef *fp,
  */
 int CVmSaveFile::restore(VMG_ CVmFile *fp)
 {
-    /* we don't have a fixup table yet (the object loader will create one) */
-    CVmObjFixup *fixups = 0;
-
     /* read the file's signature */
     char buf[128];
     fp->read_bytes(buf, sizeof(VMSAVEFILE_SIG)-1);
 
-    /* check the signature */
-    if (memcmp(buf, VMSAVEFILE_SIG, sizeof(VMSAVEFILE_SIG)-1) != 0)
+    /* check the signature, noting whether the file is compressed */
+    int compressed = FALSE;
+    if (memcmp(buf, VMSAVEFILE_SIG_LZ, sizeof(VMSAVEFILE_SIG_LZ)-1) == 0)
+        compressed = TRUE;
+    else if (memcmp(buf, VMSAVEFILE_SIG, sizeof(VMSAVEFILE_SIG)-1) != 0)
         return VMERR_NOT_SAVED_STATE;
 
     /* read the size/checksum fields */
     unsigned long datasize = fp->read_uint4();
     unsigned long old_crcval = fp->read_uint4();
 
-    /* note the starting position of the datastream */
-    long startpos = fp->get_pos();
-
-    /* compute the checksum of the file data */
-    unsigned long new_crcval = compute_checksum(fp, datasize);
+    /* 
+     *   Read the rest of the file into memory in one pass.  We need to
+     *   check the whole stream's checksum before we parse any of it, and
+     *   having it in memory saves reading the file a second time.  
+     */
+    char *data = (char *)t3malloc(datasize != 0 ? datasize : 1);
+    if (data == 0)
+        return VMERR_BAD_SAVED_STATE;
+    err_try
+    {
+        fp->read_bytes(data, datasize);
+    }
+    err_catch_disc
+    {
+        t3free(data);
+        err_rethrow();
+    }
+    err_end;
 
     /* 
-     *   if the checksum we computed doesn't match the one stored in the
+     *   if the checksum we compute doesn't match the one stored in the
      *   file, the file is corrupted 
      */
-    if (new_crcval != old_crcval)
+    if (compute_checksum(data, datasize) != old_crcval)
+    {
+        t3free(data);
         return VMERR_BAD_SAVED_STATE;
+    }
 
-    /* seek back to the starting position */
-    fp->set_pos(startpos);
+    /* read the rest from a memory file on the data */
+    CVmFile *body = new CVmFile();
+    body->open_memory(data, datasize);
+    int err = 0;
+    err_try
+    {
+        err = restore_body(vmg_ body, compressed);
+    }
+    err_finally
+    {
+        delete body;
+    }
+    err_end;
+
+    /* return the result */
+    return err;
+}
+
+/*
+ *   Restore the part of the saved state that follows the size/checksum
+ *   fields, once we've checked the checksum 
+ */
+int CVmSaveFile::restore_body(VMG_ CVmFile *fp, int compressed)
+{
+    /* we don't have a fixup table yet (the object loader will create one) */
+    CVmObjFixup *fixups = 0;
 
     /* check the timestamp */
+    char buf[24];
     fp->read_bytes(buf, 24);
     if (memcmp(buf, G_image_loader->get_timestamp(), 24) != 0)
         return VMERR_WRONG_SAVED_STATE;
@@ -370,6 +729,14 @@ int CVmSaveFile::restore(VMG_ CVmFile *fp)
      */
     fp->set_pos_from_cur(fp->read_int2());
 
+    /* 
+     *   if the object data are compressed, decompress them into memory, and
+     *   read the rest of the state from there 
+     */
+    CVmFile *datafp = fp;
+    if (compressed && (datafp = load_compressed(fp)) == 0)
+        return VMERR_BAD_SAVED_STATE;
+
     /* 
      *   discard all undo information - any undo information we currently
      *   have obviously can't be applied to the restored state 
@@ -392,11 +759,11 @@ int CVmSaveFile::restore(VMG_ CVmFile *fp)
         G_meta_table->forget_intrinsic_class_instances(vmg0_);
 
         /* load the object data from the file */
-        if ((err = G_obj_table->restore(vmg_ fp, &fixups)) != 0)
+        if ((err = G_obj_table->restore(vmg_ datafp, &fixups)) != 0)
             goto read_done;
         
         /* load the synthesized exports from the file */
-        err = G_image_loader->restore_synth_exports(vmg_ fp, fixups);
+        err = G_image_loader->restore_synth_exports(vmg_ datafp, fixups);
         if (err != 0)
             goto read_done;
 
@@ -425,6 +792,10 @@ int CVmSaveFile::restore(VMG_ CVmFile *fp)
     if (fixups != 0)
         delete fixups;
 
+    /* if we decompressed the data into memory, we're done with it */
+    if (datafp != fp)
+        delete datafp;
+
     /* restore the garbage collector's enabled state */
     G_obj_table->enable_gc(vmg_ old_gc_enabled);
 
@@ -450,6 +821,14 @@ int CVmSaveFile::restore(VMG_ CVmFile *fp)
  */
 void CVmSaveFile::reset(VMG0_)
 {
+    /* 
+     *   If we have the pristine state, restore it.  That's the same state
+     *   we'd reach by resetting from the image and running the static
+     *   initializers, but it's much faster to reach.  
+     */
+    if (restore_pristine(vmg0_))
+        return;
+
     /* 
      *   discard undo information, since it applies only to the current VM
      *   state and obviously is no longer relevant after we reset to the
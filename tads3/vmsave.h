@@ -45,6 +45,24 @@ public:
     static void save(VMG_ class CVmFile *fp,
                      class CVmObjLookupTable *metadata);
 
+    /*
+     *   Save VM state to a memory buffer rather than a file.  Returns a
+     *   buffer allocated with t3malloc() containing the complete saved
+     *   state file, and fills in '*len' with its length.  The caller must
+     *   free the buffer with t3free().  Throws an error on failure.  
+     */
+    static char *save_to_memory(VMG_ class CVmObjLookupTable *metadata,
+                                size_t *len);
+
+    /*
+     *   Save an autosave snapshot, if the host application has asked for
+     *   autosaves.  This is called through vm_autosave(), while the
+     *   program waits at its command prompt.  The state is serialized into
+     *   memory on the calling thread, and the host application writes it
+     *   to disk, possibly in the background.  Errors are ignored.  
+     */
+    static void autosave(VMG0_);
+
     /* 
      *   given a saved state file, read the name of the image file that
      *   created it 
@@ -61,6 +79,52 @@ public:
     /* reset the VM to the initial image file state */
     static void reset(VMG0_);
 
+    /*
+     *   Restore the startup snapshot, if the host application keeps one
+     *   for this image.  The snapshot is an ordinary saved state file
+     *   taken just after the static initializers ran on an earlier launch,
+     *   so restoring it takes the place of running them again.  Returns
+     *   true if the static initializer state has been established, false
+     *   if the caller must run the static initializers itself (there's no
+     *   snapshot, or it's stale or unreadable).  
+     */
+    static int restore_snapshot(VMG0_);
+
+    /*
+     *   Save the startup snapshot.  Call this immediately after running
+     *   the static initializers, when restore_snapshot() returned false.
+     *   Errors are ignored, since the snapshot is only a cache.  
+     */
+    static void save_snapshot(VMG0_);
+
+    /*
+     *   Save the pristine state.  Call this once the static initializer
+     *   state has been established at startup.  We keep a saved state image
+     *   of it in memory, and reset() restores that rather than reloading
+     *   every object from the image file and running the static
+     *   initializers again.  Errors are ignored; reset() then does a full
+     *   reset.  
+     */
+    static void save_pristine(VMG0_);
+
+protected:
+    /* write/read everything after the size/checksum fields */
+    static void save_body(VMG_ class CVmFile *fp,
+                          class CVmObjLookupTable *metadata, int compress);
+    static int restore_body(VMG_ class CVmFile *fp, int compressed);
+
+    /* save the object data section of a compressed file */
+    static void save_compressed(VMG_ class CVmFile *fp);
+
+    /* load the object data section of a compressed file into memory */
+    static class CVmFile *load_compressed(class CVmFile *fp);
+
+    /* 
+     *   restore the pristine state; returns true on success, false if we
+     *   don't have it or it failed to restore 
+     */
+    static int restore_pristine(VMG0_);
+
 protected:
 };
 
@@ -11,17 +11,17 @@ static char RCSid[] =
  */
 /*
 Name
-  vmsort.cpp - T3 VM quicksort implementation
+  vmsort.cpp - T3 VM sort implementation
 Function
-  Implements quicksort.  We use our own implementation rather than the
-  standard C library's qsort() routine for two reasons.  First, we might
-  want to throw an exception out of the comparison routine, and it is
-  not clear that it is safe to longjmp() past qsort() on every type of
-  machine and every C run-time implementation.  Second, the standard C
-  library's qsort() routine doesn't provide any means to pass a context
-  to the comparison callback, and further insists that the data to be
-  sorted be arranged as an array; we provide a higher-level abstraction
-  for the comparison callback.
+  Implements an introsort (a quicksort with a heapsort fallback).  We use
+  our own implementation rather than the standard C library's qsort()
+  routine for two reasons.  First, we might want to throw an exception out
+  of the comparison routine, and it is not clear that it is safe to
+  longjmp() past qsort() on every type of machine and every C run-time
+  implementation.  Second, the standard C library's qsort() routine doesn't
+  provide any means to pass a context to the comparison callback, and
+  further insists that the data to be sorted be arranged as an array; we
+  provide a higher-level abstraction for the comparison callback.
 Notes
   
 Modified
@@ -34,59 +34,189 @@ Modified
 #include "vmsort.h"
 
 
+/*
+ *   Ranges of this many elements or fewer are finished with an insertion
+ *   sort, which does fewer comparisons than quicksort on short runs.  
+ */
+#define VMSORT_INSERTION_CUTOFF  12
+
+
 /* ------------------------------------------------------------------------ */
 /*
- *   perform a quicksort
+ *   Sort a range.  This is an introsort: a quicksort with median-of-three
+ *   pivots, which finishes short ranges with an insertion sort, and which
+ *   switches to a heapsort if the partitioning goes badly enough that the
+ *   recursion depth exceeds twice the log of the range size.  The
+ *   median-of-three pivot keeps already-sorted and reverse-sorted input -
+ *   both very common in practice - at n log n, where the old pure quicksort
+ *   with a fixed pivot went quadratic; the heapsort fallback guarantees n
+ *   log n for any input.
+ *   
+ *   The comparison callback is arbitrary user code, so it might not define
+ *   a consistent ordering.  We therefore never rely on sentinels to stop a
+ *   scan: every loop is bounded by the range limits, so a bad comparison
+ *   function gives a badly sorted result but can't run us off the array.  
  */
 void CVmQSortData::sort(VMG_ size_t l, size_t r)
 {
     /* proceed if we have a non-empty range */
     if (r > l)
     {
-        size_t i, j;
-        size_t v_idx = r;
+        /* figure the depth limit: twice the log2 of the element count */
+        int depth = 0;
+        for (size_t n = r - l + 1 ; n > 1 ; n >>= 1)
+            depth += 2;
 
-        /* start at the ends of the range */
-        i = l - 1;
-        j = r;
+        /* sort the range */
+        introsort(vmg_ l, r, depth);
+    }
+}
 
-        /* partition the range */
-        do
+/*
+ *   introsort a range 
+ */
+void CVmQSortData::introsort(VMG_ size_t l, size_t r, int depth)
+{
+    /* 
+     *   Partition until the range is small enough for the insertion sort.
+     *   We recurse on the smaller partition and loop on the larger one, so
+     *   the recursion depth is at most log2 of the range size.  
+     */
+    while (r - l + 1 > VMSORT_INSERTION_CUTOFF)
+    {
+        /* if we've partitioned too many times, use a heapsort instead */
+        if (depth-- == 0)
         {
-            /* find the leftmost element >= the right element */
+            heapsort(vmg_ l, r);
+            return;
+        }
+
+        /* 
+         *   Choose the pivot as the median of the first, middle, and last
+         *   elements, and put the three in order, so that the first is no
+         *   greater and the last is no less than the pivot. 
+         */
+        size_t m = l + (r - l)/2;
+        if (compare(vmg_ m, l) < 0)
+            exchange(vmg_ m, l);
+        if (compare(vmg_ r, m) < 0)
+        {
+            exchange(vmg_ r, m);
+            if (compare(vmg_ m, l) < 0)
+                exchange(vmg_ m, l);
+        }
+
+        /* 
+         *   move the pivot next to the end, out of the way; the last element
+         *   is already on the correct side 
+         */
+        size_t p = r - 1;
+        exchange(vmg_ m, p);
+
+        /* 
+         *   Partition the range between the first element and the pivot.
+         *   Both scans stop at elements equal to the pivot, which splits
+         *   runs of duplicates evenly between the two sides.  
+         */
+        size_t i = l, j = p;
+        for (;;)
+        {
+            /* find the leftmost element >= the pivot */
             do
             {
                 ++i;
-            } while (i != r && compare(vmg_ i, v_idx) < 0);
+            } while (i < p && compare(vmg_ i, p) < 0);
 
-            /* find the rightmost element <= the right element */
+            /* find the rightmost element <= the pivot */
             do
             {
                 --j;
-            } while (j != l && compare(vmg_ j, v_idx) > 0);
+            } while (j > l && compare(vmg_ j, p) > 0);
 
-            /* exchange elements i and j */
+            /* if the scans have met, we're done */
+            if (i >= j)
+                break;
+
+            /* exchange the out-of-place elements */
             exchange(vmg_ i, j);
+        }
 
-            /* if we moved the 'v' element, follow that in the index */
-            if (v_idx == i)
-                v_idx = j;
-            else if (v_idx == j)
-                v_idx = i;
+        /* move the pivot into its final position */
+        exchange(vmg_ i, p);
 
-        } while (j > i);
+        /* sort the smaller side recursively, and the larger side in place */
+        if (i - l < r - i)
+        {
+            introsort(vmg_ l, i - 1, depth);
+            l = i + 1;
+        }
+        else
+        {
+            introsort(vmg_ i + 1, r, depth);
+            r = i - 1;
+        }
+    }
 
-        /* undo the last exchange */
-        exchange(vmg_ i, j);
+    /* finish the remaining short range with an insertion sort */
+    insertion_sort(vmg_ l, r);
+}
 
-        /* exchange the right value into the pivot point */
-        exchange(vmg_ i, r);
+/*
+ *   insertion sort a range 
+ */
+void CVmQSortData::insertion_sort(VMG_ size_t l, size_t r)
+{
+    /* insert each element into the sorted run to its left */
+    for (size_t i = l + 1 ; i <= r ; ++i)
+    {
+        for (size_t j = i ; j > l && compare(vmg_ j - 1, j) > 0 ; --j)
+            exchange(vmg_ j - 1, j);
+    }
+}
+
+/*
+ *   heapsort a range 
+ */
+void CVmQSortData::heapsort(VMG_ size_t l, size_t r)
+{
+    size_t cnt = r - l + 1;
+    size_t i;
 
-        /* recursively sort the subranges */
-        if (i > l)
-            sort(vmg_ l, i - 1);
-        if (i < r)
-            sort(vmg_ i + 1, r);
+    /* build a max-heap */
+    for (i = cnt/2 ; i > 0 ; --i)
+        sift_down(vmg_ l, i - 1, cnt);
+
+    /* repeatedly move the largest element to the end */
+    for (i = cnt - 1 ; i > 0 ; --i)
+    {
+        exchange(vmg_ l, l + i);
+        sift_down(vmg_ l, 0, i);
     }
 }
 
+/*
+ *   Sift an element down into a heap.  'base' is the index of the first
+ *   element of the heap, 'root' is the heap-relative index of the element
+ *   to sift, and 'cnt' is the number of elements in the heap. 
+ */
+void CVmQSortData::sift_down(VMG_ size_t base, size_t root, size_t cnt)
+{
+    for (;;)
+    {
+        /* find the larger child, if there are any children */
+        size_t child = 2*root + 1;
+        if (child >= cnt)
+            break;
+        if (child + 1 < cnt
+            && compare(vmg_ base + child, base + child + 1) < 0)
+            ++child;
+
+        /* if the root is at least as large as the child, we're done */
+        if (compare(vmg_ base + root, base + child) >= 0)
+            break;
+
+        /* move the child up, and keep going from its position */
+        exchange(vmg_ base + root, base + child);
+        root = child;
+    }
+}
@@ -8,7 +8,7 @@
  */
 /*
 Name
-  vmsort.h - T3 VM quicksort implementation
+  vmsort.h - T3 VM sort implementation
 Function
   
 Notes
@@ -49,6 +49,17 @@ public:
 
     /* exchange two elements */
     virtual void exchange(VMG_ size_t idx_a, size_t idx_b) = 0;
+
+protected:
+    /* introsort a range, with the given partitioning depth limit */
+    void introsort(VMG_ size_t l, size_t r, int depth);
+
+    /* insertion sort a range */
+    void insertion_sort(VMG_ size_t l, size_t r);
+
+    /* heapsort a range */
+    void heapsort(VMG_ size_t l, size_t r);
+    void sift_down(VMG_ size_t base, size_t root, size_t cnt);
 };
 
 /* ------------------------------------------------------------------------ */
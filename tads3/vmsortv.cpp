@@ -62,6 +62,12 @@ int CVmQSortVal::compare(VMG_ size_t a, size_t b)
         /* get the result value */
         result = val.num_to_int(vmg0_);
     }
+    else if (val_a.typ == VM_INT && val_b.typ == VM_INT)
+    {
+        /* integers are by far the most common case, so compare inline */
+        result = (val_a.val.intval < val_b.val.intval ? -1 :
+                  val_a.val.intval > val_b.val.intval ? 1 : 0);
+    }
     else
     {
         /* compare the values */
@@ -25,11 +25,190 @@ Modified
 #include "vmstack.h"
 #include "vmfile.h"
 
+#ifdef VM_STACK_GUARD
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+# define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/* 
+ *   Size of the guard region, in slots.  This must hold the largest frame a
+ *   function can declare (its header gives the depth as a 16-bit value),
+ *   plus the fixed frame data and the few slots intrinsics push without
+ *   checking.  Every frame starts with a store at the old stack pointer, so
+ *   as long as no frame can reach past the guard, an overflowing frame has
+ *   to touch the guard before it can touch anything beyond.  
+ */
+const size_t VMSTACK_GUARD_SLOTS = 65535 + 64;
+
+/* maximum number of guarded stacks (one per VM instance) at a time */
+const int VMSTACK_GUARD_MAX = 64;
+
+/* 
+ *   Registry of guarded stacks, for the signal handler.  A slot is claimed
+ *   by setting 'lo', and only matches faults once 'stk' is set.  
+ */
+static struct
+{
+    char *volatile lo;
+    char *volatile hi;
+    CVmStack *volatile stk;
+} S_guard_tab[VMSTACK_GUARD_MAX];
+
+/* flag: the handler is installed; and the actions it replaced */
+static volatile int S_handler_installed = FALSE;
+static struct sigaction S_old_segv;
+static struct sigaction S_old_bus;
+
+/* round a byte size up to a whole number of pages */
+static size_t round_to_pages(size_t siz, size_t pg)
+{
+    return (siz + pg - 1) / pg * pg;
+}
+
+/*
+ *   Fault handler.  If the fault is in a guarded stack's protected range,
+ *   throw a stack overflow; this longjmp()s out of the handler, which is
+ *   safe here because the fault comes from a store into the VM stack, never
+ *   from inside the C library.  Any other fault goes to whoever had the
+ *   signal before us.  
+ */
+void CVmStack::guard_handler(int sig, siginfo_t *info, void *ctx)
+{
+    char *addr = (char *)info->si_addr;
+    int i;
+
+    /* look for the stack the fault is in */
+    for (i = 0 ; i < VMSTACK_GUARD_MAX ; ++i)
+    {
+        CVmStack *stk = S_guard_tab[i].stk;
+        if (stk != 0 && addr >= S_guard_tab[i].lo && addr < S_guard_tab[i].hi)
+            stk->guard_fault();
+    }
+
+    /* it's not ours - pass it along */
+    struct sigaction *old = (sig == SIGBUS ? &S_old_bus : &S_old_segv);
+    if ((old->sa_flags & SA_SIGINFO) != 0)
+    {
+        old->sa_sigaction(sig, info, ctx);
+    }
+    else if (old->sa_handler != SIG_DFL && old->sa_handler != SIG_IGN)
+    {
+        old->sa_handler(sig);
+    }
+    else
+    {
+        /* 
+         *   restore the default action; when we return, the faulting
+         *   instruction runs again and gets it 
+         */
+        struct sigaction dfl;
+        memset(&dfl, 0, sizeof(dfl));
+        dfl.sa_handler = SIG_DFL;
+        sigemptyset(&dfl.sa_mask);
+        sigaction(sig, &dfl, 0);
+    }
+}
+
+/*
+ *   Handle a fault in our protected range 
+ */
+void CVmStack::guard_fault()
+{
+    /* 
+     *   If the fault came from filling in a block allocated with push(n),
+     *   the stack pointer is already past the limit.  Pull it back, so that
+     *   the exception handler has the reserve to work with, just as it would
+     *   if the overflow had been caught by an explicit check.  
+     */
+    if (sp_ > arr_ + max_depth_)
+        sp_ = arr_ + max_depth_;
+
+    /* throw the normal stack overflow error */
+    err_throw(VMERR_STACK_OVERFLOW);
+}
+
+/*
+ *   Make the reserve accessible or protect it again 
+ */
+void CVmStack::set_reserve_access(int on)
+{
+    mprotect((char *)arr_ + stk_bytes_, reserve_bytes_,
+             on ? PROT_READ | PROT_WRITE : PROT_NONE);
+}
+#endif /* VM_STACK_GUARD */
+
 /*
  *   allocate the stack 
  */
 CVmStack::CVmStack(size_t max_depth, size_t reserve)
 {
+#ifdef VM_STACK_GUARD
+    size_t pg = (size_t)sysconf(_SC_PAGESIZE);
+    size_t guard_bytes;
+    void *mem;
+    int i;
+
+    /* 
+     *   Map the stack, the reserve and the guard, all inaccessible, then
+     *   open up the stack proper.  The stack gets whatever extra slots
+     *   rounding up to whole pages gives us.  
+     */
+    stk_bytes_ = round_to_pages(max_depth * sizeof(arr_[0]), pg);
+    reserve_bytes_ = round_to_pages(reserve * sizeof(arr_[0]), pg);
+    guard_bytes = round_to_pages(VMSTACK_GUARD_SLOTS * sizeof(arr_[0]), pg);
+    map_size_ = stk_bytes_ + reserve_bytes_ + guard_bytes;
+    mem = mmap(0, map_size_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        err_throw(VMERR_OUT_OF_MEMORY);
+    if (mprotect(mem, stk_bytes_, PROT_READ | PROT_WRITE) != 0)
+    {
+        munmap(mem, map_size_);
+        err_throw(VMERR_OUT_OF_MEMORY);
+    }
+    arr_ = (vm_val_t *)mem;
+
+    /* the depths are whatever fits in the stack and the reserve */
+    max_depth_ = stk_bytes_ / sizeof(arr_[0]);
+    reserve_depth_ = (stk_bytes_ + reserve_bytes_) / sizeof(arr_[0])
+                     - max_depth_;
+
+    /* register the protected range with the fault handler */
+    for (i = 0 ; i < VMSTACK_GUARD_MAX ; ++i)
+    {
+        if (__sync_bool_compare_and_swap(&S_guard_tab[i].lo, (char *)0,
+                                         (char *)mem + stk_bytes_))
+        {
+            S_guard_tab[i].hi = (char *)mem + map_size_;
+            S_guard_tab[i].stk = this;
+            break;
+        }
+    }
+    if (i == VMSTACK_GUARD_MAX)
+    {
+        munmap(mem, map_size_);
+        err_throw(VMERR_OUT_OF_MEMORY);
+    }
+
+    /* install the fault handler, if no one has yet */
+    if (__sync_bool_compare_and_swap(&S_handler_installed, FALSE, TRUE))
+    {
+        /* 
+         *   SA_NODEFER leaves the signal unblocked when we longjmp() out of
+         *   the handler 
+         */
+        struct sigaction act;
+        memset(&act, 0, sizeof(act));
+        act.sa_sigaction = &CVmStack::guard_handler;
+        act.sa_flags = SA_SIGINFO | SA_NODEFER;
+        sigemptyset(&act.sa_mask);
+        sigaction(SIGSEGV, &act, &S_old_segv);
+        sigaction(SIGBUS, &act, &S_old_bus);
+    }
+#else
     /* 
      *   Allocate the array of stack elements.  Allocate the requested
      *   maximum depth plus the requested reserve space.  Overallocate by a
@@ -43,6 +222,7 @@ CVmStack::CVmStack(size_t max_depth, size_t reserve)
     /* remember the maximum depth and the reserve depth */
     max_depth_ = max_depth;
     reserve_depth_ = reserve;
+#endif
 
     /* the reserve is not yet in use */
     reserve_in_use_ = FALSE;
@@ -56,7 +236,24 @@ CVmStack::CVmStack(size_t max_depth, size_t reserve)
  */
 CVmStack::~CVmStack()
 {
+#ifdef VM_STACK_GUARD
+    /* remove our registration, releasing the slot last */
+    for (int i = 0 ; i < VMSTACK_GUARD_MAX ; ++i)
+    {
+        if (S_guard_tab[i].stk == this)
+        {
+            S_guard_tab[i].stk = 0;
+            S_guard_tab[i].hi = 0;
+            __sync_synchronize();
+            S_guard_tab[i].lo = 0;
+            break;
+        }
+    }
+
+    /* unmap the stack */
+    munmap(arr_, map_size_);
+#else
     /* delete the stack element array */
     t3free(arr_);
+#endif
 }
-
@@ -12,7 +12,14 @@ Name
 Function
   
 Notes
-  
+  Function entry normally checks that the new frame fits in the remaining
+  stack space.  If VM_STACK_GUARD is defined (see the t3_stack_guard option
+  in qtads.pro), the stack is instead mapped with mmap() and followed by a
+  protected guard region large enough to hold any single function's frame,
+  so an overflow faults as soon as it touches the guard.  A signal handler
+  turns the fault into the usual VMERR_STACK_OVERFLOW error, and function
+  entry skips the explicit check.  This is only available on Unix-like
+  systems.
 Modified
   10/28/98 MJRoberts  - Creation
 */
@@ -24,6 +31,10 @@ Modified
 #include "vmerr.h"
 #include "vmerrnum.h"
 
+#ifdef VM_STACK_GUARD
+#include <signal.h>
+#endif
+
 
 /* ------------------------------------------------------------------------ */
 /*
@@ -53,6 +64,13 @@ Modified
 /* declare the stack pointer register as an extern global, if appropriate */
 VM_IF_REGS_IN_GLOBALS(extern vm_val_t *sp_;)
 
+/* include guard-page code only if configured */
+#ifdef VM_STACK_GUARD
+# define VM_IF_STACK_GUARD(x)  x
+#else
+# define VM_IF_STACK_GUARD(x)
+#endif
+
 
 /* ------------------------------------------------------------------------ */
 /*
@@ -241,6 +259,22 @@ public:
     int check_space(int nslots) const
         { return (get_depth() + nslots <= max_depth_); }
 
+    /*
+     *   Check space for a new function frame.  'nslots' must be no more than
+     *   the frame size a function header can declare (a 16-bit stack depth)
+     *   plus the fixed frame data; with a guard region, that always fits in
+     *   the guard, so an overflow faults as soon as the frame is written and
+     *   we don't need to check here.  
+     */
+    int check_frame_space(int nslots) const
+    {
+#ifdef VM_STACK_GUARD
+        return TRUE;
+#else
+        return check_space(nslots);
+#endif
+    }
+
     /* check space for 'nslots' new slots, throwing an error on overflow */
     void check_throw(int nslots) const
     {
@@ -262,6 +296,9 @@ public:
         if (reserve_in_use_)
             return FALSE;
 
+        /* make the reserve accessible, if it's behind the guard */
+        VM_IF_STACK_GUARD(set_reserve_access(TRUE);)
+
         /* add the reserve space to the maximum stack depth */
         max_depth_ += reserve_depth_;
 
@@ -286,6 +323,9 @@ public:
             /* remove the reserve from the stack */
             max_depth_ -= reserve_depth_;
 
+            /* protect it again */
+            VM_IF_STACK_GUARD(set_reserve_access(FALSE);)
+
             /* mark the reserve as available again */
             reserve_in_use_ = FALSE;
         }
@@ -312,6 +352,26 @@ private:
 
     /* flag: the reserve has been released for VM use */
     int reserve_in_use_;
+
+#ifdef VM_STACK_GUARD
+    /* 
+     *   Guard-page mode.  The mapping holds the stack proper, then the
+     *   reserve, then the guard region, each a whole number of pages.  The
+     *   reserve is protected along with the guard while it's not in use.  
+     */
+    void set_reserve_access(int on);
+
+    /* handle a fault in our protected range by throwing a stack overflow */
+    void guard_fault();
+
+    /* SIGSEGV/SIGBUS handler */
+    static void guard_handler(int sig, siginfo_t *info, void *ctx);
+
+    /* sizes in bytes of the whole mapping, the stack proper and the reserve */
+    size_t map_size_;
+    size_t stk_bytes_;
+    size_t reserve_bytes_;
+#endif
 };
 
 #endif /* VMSTACK_H */
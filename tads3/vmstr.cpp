@@ -57,6 +57,12 @@ Modified
 #include "vmbiftad.h"
 #include "vmfindrep.h"
 
+/* use SSE2 to scan for special characters where we have it */
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__SSE2__)
+#  define VMSTR_SSE2
+#  include <emmintrin.h>
+#endif
+
 
 /* ------------------------------------------------------------------------ */
 /*
@@ -350,6 +356,7 @@ char *CVmObjString::cons_ensure_space(VMG_ char *ptr, size_t len,
 
     /* expand to the needed size plus the margin */
     size_t newlen = need + margin;
+    G_strhash_cache->forget(ext_);
     ext_ = (char *)G_mem->get_var_heap()->realloc_mem(
         newlen + VMB_LEN, ext_, this);
 
@@ -408,6 +415,7 @@ void CVmObjString::cons_shrink_buffer(VMG_ char *ptr)
     if (vmb_get_len(ext_) - siz >= 256)
     {
         /* reallocate at the new size */
+        G_strhash_cache->forget(ext_);
         ext_ = (char *)G_mem->get_var_heap()->realloc_mem(
             siz + VMB_LEN, ext_, this);
     }
@@ -424,9 +432,12 @@ void CVmObjString::cons_shrink_buffer(VMG_ char *ptr)
  */
 void CVmObjString::notify_delete(VMG_ int in_root_set)
 {
-    /* free our extension */
+    /* free our extension, removing it from the hash cache */
     if (ext_ != 0 && !in_root_set)
+    {
+        G_strhash_cache->forget(ext_);
         G_mem->get_var_heap()->free_mem(ext_);
+    }
 }
 
 /* ------------------------------------------------------------------------ */
@@ -489,6 +500,7 @@ void CVmObjString::restore_from_file(VMG_ vm_obj_id_t,
     /* free any existing extension */
     if (ext_ != 0)
     {
+        G_strhash_cache->forget(ext_);
         G_mem->get_var_heap()->free_mem(ext_);
         ext_ = 0;
     }
@@ -1112,6 +1124,10 @@ int CVmObjString::const_equals(VMG_ const char *str, const vm_val_t *val)
     if (str2 == 0)
         return FALSE;
 
+    /* if it's the very same string data, it's trivially equal */
+    if (str2 == str)
+        return TRUE;
+
     /* 
      *   if their lengths match, and the bytes match exactly, we have a
      *   match; otherwise, they're not equal 
@@ -1127,7 +1143,29 @@ int CVmObjString::const_equals(VMG_ const char *str, const vm_val_t *val)
  */
 uint CVmObjString::calc_hash(VMG_ vm_obj_id_t self, int /*depth*/) const
 {
-    return const_calc_hash(ext_);
+    return const_calc_hash_cached(vmg_ ext_);
+}
+
+/*
+ *   Hash value calculation through the hash cache 
+ */
+uint CVmObjString::const_calc_hash_cached(VMG_ const char *str)
+{
+    uint hash;
+
+    /* short strings are cheaper to hash than to cache */
+    if (vmb_get_len(str) < VMSTR_HASH_CACHE_MIN_LEN)
+        return const_calc_hash(str);
+
+    /* if we don't already have it, calculate it and cache it */
+    if (!G_strhash_cache->find(str, &hash))
+    {
+        hash = const_calc_hash(str);
+        G_strhash_cache->store(str, hash);
+    }
+
+    /* return the result */
+    return hash;
 }
 
 /*
@@ -1498,6 +1536,36 @@ int CVmObjString::getp_len(VMG_ vm_val_t *retval, const vm_val_t *self_val,
 }
 
 /* ------------------------------------------------------------------------ */
+/*
+ *   Skip ahead by up to 'cnt' characters, stopping at the end of the
+ *   buffer.  Runs of plain ASCII are skipped in bulk.  Returns the number
+ *   of characters left unskipped (non-zero if we reached the end first). 
+ */
+static long skip_chars(utf8_ptr *p, size_t *rem, long cnt)
+{
+    while (cnt > 0 && *rem != 0)
+    {
+        /* skip any ASCII run in one step */
+        size_t n = utf8_ptr::s_ascii_len(
+            p->getptr(), (size_t)cnt < *rem ? (size_t)cnt : *rem);
+        if (n != 0)
+        {
+            p->set(p->getptr() + n);
+            *rem -= n;
+            cnt -= (long)n;
+        }
+        else
+        {
+            /* skip a single non-ASCII character */
+            p->inc(rem);
+            --cnt;
+        }
+    }
+
+    /* return the remaining count */
+    return cnt;
+}
+
 /*
  *   property evaluator - extract a substring
  */
@@ -1547,8 +1615,7 @@ int CVmObjString::getp_substr(VMG_ vm_val_t *retval, const vm_val_t *self_val,
          *   (since a start value of 1 tells us to start at the first
          *   character) 
          */
-        for ( ; start > 1 && rem != 0 ; --start)
-            p.inc(&rem);
+        skip_chars(&p, &rem, start - 1);
     }
     else if (start < 0)
     {
@@ -1584,8 +1651,7 @@ int CVmObjString::getp_substr(VMG_ vm_val_t *retval, const vm_val_t *self_val,
              *   keep starting at the starting index.  Skip ahead by the
              *   desired length to figure the end pointer. 
              */
-            for ( ; len > 0 && rem != 0 ; --len)
-                p.inc(&rem);
+            skip_chars(&p, &rem, len);
         }
         else
         {
@@ -1609,11 +1675,20 @@ int CVmObjString::getp_substr(VMG_ vm_val_t *retval, const vm_val_t *self_val,
         new_len = start_rem;
     }
 
-    /* create the new string */
-    obj = CVmObjString::create(vmg_ FALSE, start_p.getptr(), new_len);
-
-    /* return the new object */
-    retval->set_obj(obj);
+    /* 
+     *   if the substring is the entire string, simply return the original
+     *   string, since strings are immutable; otherwise create the new
+     *   string 
+     */
+    if (new_len == vmb_get_len(str))
+    {
+        *retval = *self_val;
+    }
+    else
+    {
+        obj = CVmObjString::create(vmg_ FALSE, start_p.getptr(), new_len);
+        retval->set_obj(obj);
+    }
 
     /* discard the GC protection references */
     G_stk->discard();
@@ -2316,6 +2391,74 @@ int CVmObjString::getp_to_uni(VMG_ vm_val_t *retval,
     return TRUE;
 }
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Find the first byte in [p, endp) that's one of the eight bytes in
+ *   'stops' (which can repeat), or, if 'ctl' is true, a control character
+ *   or space (0x00-0x20).  Returns endp if there's no such byte.  The text
+ *   is UTF-8, but as long as the stop bytes aren't continuation bytes
+ *   (0x80-0xBF), a byte scan only ever stops at a character boundary.
+ *   
+ *   Where we have SSE2, we check sixteen bytes at a time, which lets
+ *   htmlify and specialsToHtml copy long runs of plain text in bulk.  
+ */
+static const char *find_special_byte(const char *p, const char *endp,
+                                     const uchar *stops, int ctl)
+{
+#ifdef VMSTR_SSE2
+    __m128i s[8];
+    __m128i sp = _mm_set1_epi8(ctl ? 0x20 : 0);
+    __m128i zero = _mm_setzero_si128();
+    int i;
+
+    /* load the stop bytes */
+    for (i = 0 ; i < 8 ; ++i)
+        s[i] = _mm_set1_epi8((char)stops[i]);
+
+    /* scan sixteen bytes at a time */
+    for ( ; endp - p >= 16 ; p += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i m;
+        int bits;
+
+        /* check for each stop byte */
+        m = _mm_or_si128(
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, s[0]),
+                                      _mm_cmpeq_epi8(v, s[1])),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, s[2]),
+                                      _mm_cmpeq_epi8(v, s[3]))),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, s[4]),
+                                      _mm_cmpeq_epi8(v, s[5])),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, s[6]),
+                                      _mm_cmpeq_epi8(v, s[7]))));
+
+        /* 
+         *   check for control characters: v <= 0x20 (unsigned) exactly
+         *   when v saturates to zero when we subtract 0x20 
+         */
+        if (ctl)
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_subs_epu8(v, sp), zero));
+
+        /* if anything matched, return the first match */
+        if ((bits = _mm_movemask_epi8(m)) != 0)
+            return p + __builtin_ctz(bits);
+    }
+#endif
+
+    /* check the rest a byte at a time */
+    for ( ; p < endp ; ++p)
+    {
+        uchar c = (uchar)*p;
+        if ((ctl && c <= 0x20)
+            || c == stops[0] || c == stops[1] || c == stops[2]
+            || c == stops[3] || c == stops[4] || c == stops[5]
+            || c == stops[6] || c == stops[7])
+            break;
+    }
+    return p;
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   property evaluator - htmlify
@@ -2342,12 +2485,14 @@ int CVmObjString::getp_htmlify(VMG_ vm_val_t *retval,
                                const char *str, uint *in_argc)
 {
     size_t bytelen;
-    utf8_ptr p;
-    utf8_ptr dstp;
-    size_t rem;
-    size_t extra;
+    const char *p;
+    const char *endp;
+    const char *clean;
     long flags;
-    vm_obj_id_t result_obj;
+    uchar stops[8];
+    int nstops;
+    CVmObjString *result;
+    char *dst;
     int prv_was_sp;
 
     /* check arguments */
@@ -2376,43 +2521,86 @@ int CVmObjString::getp_htmlify(VMG_ vm_val_t *retval,
     str += VMB_LEN;
 
     /* 
-     *   scan the string to determine how much space we'll have to add to
-     *   generate the htmlified version 
+     *   Figure the bytes we have to stop at.  The markup characters always
+     *   need escaping.  In preserve-spaces mode, a space after any kind of
+     *   whitespace becomes '&nbsp;', so we have to see all of the
+     *   whitespace characters to keep track; otherwise we only need the
+     *   ones we translate.  0xE2 is the first byte of U+2028 (and of other
+     *   characters, which we just copy).  Fill the unused slots with
+     *   duplicates.  
+     */
+    stops[0] = '&';
+    stops[1] = '<';
+    stops[2] = '>';
+    nstops = 3;
+    if ((flags & (VMSTR_HTMLIFY_KEEP_SPACES | VMSTR_HTMLIFY_KEEP_TABS)) != 0)
+        stops[nstops++] = '\t';
+    if ((flags & (VMSTR_HTMLIFY_KEEP_SPACES
+                  | VMSTR_HTMLIFY_KEEP_NEWLINES)) != 0)
+    {
+        stops[nstops++] = '\n';
+        stops[nstops++] = 0xE2;
+    }
+    if ((flags & VMSTR_HTMLIFY_KEEP_SPACES) != 0)
+        stops[nstops++] = ' ';
+    while (nstops < 8)
+        stops[nstops++] = '&';
+
+    /* 
+     *   Translate the string in a single pass, copying each run of text
+     *   that needs no translation in one piece.  We don't create the result
+     *   string until we find the first character that actually changes;
+     *   if there isn't one, we can simply return the original string.  
      */
-    for (prv_was_sp = FALSE, extra = 0, p.set((char *)str), rem = bytelen ;
-         rem != 0 ; p.inc(&rem))
+    result = 0;
+    dst = 0;
+    for (prv_was_sp = FALSE, p = clean = str, endp = str + bytelen ; ; )
     {
+        const char *nxt;
+        const char *rep;
+        size_t clen;
         int this_is_sp;
 
-        /* presume it's not a space */
+        /* find the next byte of interest */
+        nxt = find_special_byte(p, endp, stops, FALSE);
+
+        /* anything we skipped was non-whitespace */
+        if (nxt != p)
+            prv_was_sp = FALSE;
+
+        /* stop at the end of the string */
+        if ((p = nxt) == endp)
+            break;
+
+        /* presume it's a one-byte character we'll copy unchanged */
+        rep = 0;
+        clen = 1;
         this_is_sp = FALSE;
-        
+
         /* check what we have */
-        switch(p.getch())
+        switch ((uchar)*p)
         {
         case '&':
-            /* we must replace '&' with '&amp;' - this adds four bytes */
-            extra += 4;
+            /* replace '&' with '&amp;' */
+            rep = "&amp;";
             break;
-            
+
         case '<':
-            /* we must replace '<' with '&lt;' - this adds three bytes */
-            extra += 3;
+            rep = "&lt;";
             break;
 
         case '>':
-            /* replace '>' with '&gt;' */
-            extra += 3;
+            rep = "&gt;";
             break;
 
         case ' ':
             /* 
-             *   If we're in preserve-spaces mode, and the previous space
-             *   was some kind of whitespace character, change this to
-             *   '&nbsp;' - this adds five bytes 
+             *   if we're in preserve-spaces mode (which we must be, to have
+             *   stopped here), and the previous character was some kind of
+             *   whitespace, change this to '&nbsp;' 
              */
-            if (prv_was_sp && (flags & VMSTR_HTMLIFY_KEEP_SPACES) != 0)
-                extra += 5;
+            if (prv_was_sp)
+                rep = "&nbsp;";
 
             /* note that this was a whitespace character */
             this_is_sp = TRUE;
@@ -2421,118 +2609,82 @@ int CVmObjString::getp_htmlify(VMG_ vm_val_t *retval,
         case '\t':
             /* if we're in preserve-tabs mode, change this to '<tab>' */
             if ((flags & VMSTR_HTMLIFY_KEEP_TABS) != 0)
-                extra += 4;
+                rep = "<tab>";
 
             /* note that this was a whitespace character */
             this_is_sp = TRUE;
             break;
 
         case '\n':
-        case 0x2028:
             /* if we're in preserve-newlines mode, change this to '<br>' */
             if ((flags & VMSTR_HTMLIFY_KEEP_NEWLINES) != 0)
-                extra += 3;
+                rep = "<br>";
 
             /* note that this was a whitespace character */
             this_is_sp = TRUE;
             break;
-        }
-
-        /* for next time, remember whether this is a space */
-        prv_was_sp = this_is_sp;
-    }
-
-    /* allocate space for the new string */
-    result_obj = create(vmg_ FALSE, bytelen + extra);
-
-    /* get a pointer to the result buffer */
-    dstp.set(((CVmObjString *)vm_objp(vmg_ result_obj))->cons_get_buf());
-
-    /* translate the string and write the result */
-    for (prv_was_sp = FALSE, p.set((char *)str), rem = bytelen ;
-         rem != 0 ; p.inc(&rem))
-    {
-        wchar_t ch;
-        int this_is_sp;
-
-        /* get this character */
-        ch = p.getch();
-
-        /* presume it's not a space */
-        this_is_sp = FALSE;
-        
-        /* check what we have */
-        switch(ch)
-        {
-        case '&':
-            /* replace '&' with '&amp;' */
-            dstp.setch_str("&amp;");
-            break;
-
-        case '<':
-            /* we must replace '<' with '&lt;' - this adds three bytes */
-            dstp.setch_str("&lt;");
-            break;
 
-        case '>':
-            dstp.setch_str("&gt;");
+        case 0xE2:
+            /* the lead byte of a three-byte character - see which one */
+            clen = utf8_ptr::s_charsize(*p);
+            if (clen > (size_t)(endp - p))
+                clen = endp - p;
+            if (clen == 3 && utf8_ptr::s_getch(p) == 0x2028)
+            {
+                /* Unicode line separator - treat it like '\n' */
+                if ((flags & VMSTR_HTMLIFY_KEEP_NEWLINES) != 0)
+                    rep = "<br>";
+                this_is_sp = TRUE;
+            }
             break;
+        }
 
-        case ' ':
-            /* note that this was a whitespace character */
-            this_is_sp = TRUE;
-
+        /* if we're translating this character, write the replacement */
+        if (rep != 0)
+        {
             /* 
-             *   ignore it if not in preserve-spaces mode, or if the
-             *   previous character wasn't whitespace of some kind 
+             *   Create the result string the first time through.  Allow a
+             *   little room to grow; we'll expand it further as needed,
+             *   in proportion to what's left to translate.  
              */
-            if (!prv_was_sp || (flags & VMSTR_HTMLIFY_KEEP_SPACES) == 0)
-                goto do_default;
-
-            /* add the nbsp */
-            dstp.setch_str("&nbsp;");
-            break;
-
-        case '\t':
-            /* note that this was a whitespace character */
-            this_is_sp = TRUE;
-
-            /* ignore if not in preserve-tabs mode */
-            if ((flags & VMSTR_HTMLIFY_KEEP_TABS) == 0)
-                goto do_default;
-
-            /* add the <tab> */
-            dstp.setch_str("<tab>");
-            break;
-
-        case '\n':
-        case 0x2028:
-            /* note that this was a whitespace character */
-            this_is_sp = TRUE;
-
-            /* if we're not in preserve-newlines mode, ignore it */
-            if ((flags & VMSTR_HTMLIFY_KEEP_NEWLINES) == 0)
-                goto do_default;
-
-            /* add the <br> */
-            dstp.setch_str("<br>");
-            break;
+            if (result == 0)
+            {
+                vm_val_t resval;
+                resval.set_obj(create(vmg_ FALSE, bytelen + bytelen/8 + 16));
+                G_stk->push(&resval);
+                result = (CVmObjString *)vm_objp(vmg_ resval.val.obj);
+                dst = result->cons_get_buf();
+            }
 
-        default:
-        do_default:
-            /* copy this character unchanged */
-            dstp.setch(ch);
-            break;
+            /* write the clean text before this character, then the markup */
+            size_t margin = (endp - p)/4 + 64;
+            dst = result->cons_append(vmg_ dst, clean, p - clean, margin);
+            dst = result->cons_append(vmg_ dst, rep, strlen(rep), margin);
+            clean = p + clen;
         }
 
-        /* for next time, remember whether this is a space */
+        /* move on, remembering whether this was a space */
+        p += clen;
         prv_was_sp = this_is_sp;
     }
 
-    /* return the new string */
-    retval->set_obj(result_obj);
+    if (result == 0)
+    {
+        /* nothing changed - return the original string */
+        *retval = *self_val;
+    }
+    else
+    {
+        /* write the remaining clean text, and set the final length */
+        dst = result->cons_append(vmg_ dst, clean, endp - clean, 0);
+        result->cons_shrink_buffer(vmg_ dst);
+
+        /* return the new string, and discard its GC protection */
+        retval->set_obj(G_stk->get(0)->val.obj);
+        G_stk->discard();
+    }
     
-    /* discard the GC protection */
+    /* discard the self-reference */
     G_stk->discard();
 
     /* handled */
@@ -2920,11 +3072,18 @@ int CVmObjString::getp_split(VMG_ vm_val_t *retval,
             str += utf8_ptr::s_bytelen(str, 1);
     }
 
-    /* add a final element for the remainder of the string */
+    /* 
+     *   add a final element for the remainder of the string; if that's the
+     *   whole string (because we didn't split it at all), use the original
+     *   string rather than making a copy 
+     */
     if (len != 0)
     {
         lst->cons_ensure_space(vmg_ cnt, 0);
-        ele.set_obj(CVmObjString::create(vmg_ FALSE, str, len));
+        if (str == basestr)
+            ele = *self_val;
+        else
+            ele.set_obj(CVmObjString::create(vmg_ FALSE, str, len));
         lst->cons_set_element(cnt, &ele);
 
         /* count it */
@@ -3218,10 +3377,53 @@ int CVmObjString::specialsTo(VMG_ vm_val_t *retval,
             }
         }
 
+        /* 
+         *   the bytes that need more than a plain copy: '<' and '&', plus
+         *   spaces and the control characters, which find_special_byte()
+         *   checks for us 
+         */
+        static const uchar stops[8] = {
+            '<', '&', '<', '&', '<', '&', '<', '&'
+        };
+
         /* parse the string */
         utf8_ptr p;
         for (p.set((char *)str) ; len != 0 ; p.inc(&len))
         {
+            /* 
+             *   If we're in plain text, with nothing pending, copy the run
+             *   of ordinary characters up to the next special byte in one
+             *   piece.  This is the same as copying them one at a time
+             *   below, except that we have to count the characters for
+             *   the tab-stop column.  
+             */
+            if (!in_tag && !in_entity && !space && !qspace
+                && !caps && !nocaps)
+            {
+                const char *run = p.getptr();
+                const char *stop = find_special_byte(run, run + len,
+                                                     stops, TRUE);
+                if (stop != run)
+                {
+                    /* copy the run */
+                    buf->append(run, stop - run);
+                    in_line = TRUE;
+
+                    /* count the characters (the non-continuation bytes) */
+                    for (const char *r = run ; r != stop ; ++r)
+                    {
+                        if ((*r & 0xC0) != 0x80)
+                            ++col;
+                    }
+
+                    /* skip the run; stop if that's the end of the string */
+                    len -= stop - run;
+                    p.set((char *)stop);
+                    if (len == 0)
+                        break;
+                }
+            }
+
             /* get the next character */
             wchar_t ch = p.getch();
 
@@ -20,6 +20,8 @@ Modified
 #ifndef VMSTR_H
 #define VMSTR_H
 
+#include <string.h>
+
 #include "vmglob.h"
 #include "vmobj.h"
 
@@ -156,6 +158,9 @@ public:
 
     /* notify of deletion */
     void notify_delete(VMG_ int in_root_set);
+    /* report our memory use; an image-file string owns no heap memory */
+    size_t get_mem_usage(VMG_ int in_root_set) const
+        { return in_root_set ? 0 : get_ext_heap_bytes(vmg0_); }
 
     /* set a property */
     void set_prop(VMG_ class CVmUndo *undo,
@@ -334,6 +339,14 @@ public:
      */
     static uint const_calc_hash(const char *str);
 
+    /*
+     *   Constant string hash value calculation, using the string hash
+     *   cache.  This can only be used for a string whose contents can't
+     *   change as long as it's at its current address - a constant pool
+     *   string, or a string object's extension (see CVmObjStrHashCache). 
+     */
+    static uint const_calc_hash_cached(VMG_ const char *str);
+
     /*
      *   Constant string magnitude comparison routine.  Compares the given
      *   constant string (in portable format) to the other value.  Returns
@@ -643,6 +656,74 @@ protected:
 };
 
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   String hash cache.  Hashing a string decodes every character, and the
+ *   same strings tend to be hashed over and over - a LookupTable key is
+ *   hashed again on every lookup, for example.  So we keep the most recent
+ *   results in a small direct-mapped table, keyed by the address of the
+ *   string data.
+ *   
+ *   An entry is only valid as long as the data at its address don't
+ *   change, so we only cache hashes for constant pool strings, which
+ *   never change, and string object extensions.  A string object removes
+ *   its extension from the cache whenever it frees or reallocates it.
+ *   (Strings are immutable once constructed, so the contents can't
+ *   otherwise change in place.)  Short strings aren't worth the trouble,
+ *   since hashing them costs about as much as probing the cache.  
+ */
+const size_t VMSTR_HASH_CACHE_SIZE = 512;
+const size_t VMSTR_HASH_CACHE_MIN_LEN = 16;
+
+class CVmObjStrHashCache
+{
+public:
+    CVmObjStrHashCache() { memset(ent_, 0, sizeof(ent_)); }
+
+    /* look up the hash for a string; returns true if we have it cached */
+    int find(const char *str, uint *hash) const
+    {
+        const entry *e = &ent_[row(str)];
+        if (e->str == str)
+        {
+            *hash = e->hash;
+            return TRUE;
+        }
+        return FALSE;
+    }
+
+    /* store the hash for a string */
+    void store(const char *str, uint hash)
+    {
+        entry *e = &ent_[row(str)];
+        e->str = str;
+        e->hash = hash;
+    }
+
+    /* forget a string, when its memory is being freed or reallocated */
+    void forget(const char *str)
+    {
+        entry *e = &ent_[row(str)];
+        if (e->str == str)
+            e->str = 0;
+    }
+
+private:
+    /* get the table row for an address */
+    static size_t row(const char *str)
+    {
+        size_t a = (size_t)str;
+        return ((a >> 3) ^ (a >> 12)) & (VMSTR_HASH_CACHE_SIZE - 1);
+    }
+
+    struct entry
+    {
+        const char *str;
+        uint hash;
+    };
+    entry ent_[VMSTR_HASH_CACHE_SIZE];
+};
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Registration table object 
@@ -92,6 +92,7 @@ vm_strbuf_ext *vm_strbuf_ext::alloc_ext(VMG_ CVmObjStringBuffer *self,
 
     /* the buffer is currently empty */
     ext->len = 0;
+    ext->gap = 0;
 
     /* return the new extension */
     return ext;
@@ -117,10 +118,18 @@ vm_strbuf_ext *vm_strbuf_ext::expand_ext(VMG_ CVmObjStringBuffer *self,
                       * old_ext->inc;
     vm_strbuf_ext *new_ext = alloc_ext(vmg_ self, new_alo, old_ext->inc);
 
-    /* copy the current string buffer to the new extension */
+    /* 
+     *   copy the current string buffer to the new extension, keeping the
+     *   gap where it is: the part before the gap goes at the start of the
+     *   new buffer, and the part after the gap goes at the end 
+     */
+    int32_t tail = old_ext->len - old_ext->gap;
     new_ext->len = old_ext->len;
+    new_ext->gap = old_ext->gap;
     memcpy(new_ext->buf, old_ext->buf,
-           old_ext->len * sizeof(old_ext->buf[0]));
+           old_ext->gap * sizeof(old_ext->buf[0]));
+    memcpy(new_ext->buf + new_alo - tail, old_ext->buf + old_ext->alo - tail,
+           tail * sizeof(old_ext->buf[0]));
 
     /* delete the old memory */
     G_mem->get_var_heap()->free_mem(old_ext);
@@ -129,6 +138,30 @@ vm_strbuf_ext *vm_strbuf_ext::expand_ext(VMG_ CVmObjStringBuffer *self,
     return new_ext;
 }
 
+/*
+ *   Move the gap to the given logical index.  This moves only the
+ *   characters between the old and new gap positions, so edits that stay
+ *   near one another in the buffer don't have to shift the whole tail of
+ *   the string each time.
+ */
+void vm_strbuf_ext::move_gap(int32_t idx)
+{
+    int32_t gsiz = gap_size();
+    if (idx < gap)
+    {
+        /* move the characters from idx to the gap to after the gap */
+        memmove(buf + idx + gsiz, buf + idx, (gap - idx) * sizeof(buf[0]));
+    }
+    else if (idx > gap)
+    {
+        /* move the characters from the gap to idx to before the gap */
+        memmove(buf + gap, buf + gap + gsiz, (idx - gap) * sizeof(buf[0]));
+    }
+
+    /* the gap is now at idx */
+    gap = idx;
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   StringBuffer object statics 
@@ -416,8 +449,9 @@ void CVmObjStringBuffer::load_image_data(VMG_ const char *ptr, size_t siz)
     vm_strbuf_ext *ext = vm_strbuf_ext::alloc_ext(vmg_ this, alo, inc);
     ext_ = (char *)ext;
 
-    /* set the length */
+    /* set the length; the string is contiguous */
     ext->len = len;
+    ext->gap = len;
 
     /* read the string data into the buffer */
     for (wchar_t *dst = ext->buf ; len != 0 ;
@@ -432,6 +466,9 @@ void CVmObjStringBuffer::save_to_file(VMG_ class CVmFile *fp)
 {
     vm_strbuf_ext *ext = get_ext();
 
+    /* make sure the string is contiguous */
+    close_gap();
+
     /* write our allocation and string length data */
     fp->write_uint4(ext->alo);
     fp->write_uint4(ext->inc);
@@ -471,8 +508,9 @@ void CVmObjStringBuffer::restore_from_file(VMG_ vm_obj_id_t self,
     if (len > alo)
         len = alo;
 
-    /* store it in the extension */
+    /* store it in the extension; the string is contiguous */
     ext->len = len;
+    ext->gap = len;
 
     /* read the string contents */
     wchar_t *dst;
@@ -534,9 +572,18 @@ void CVmObjStringBuffer::add_undo_rec(
     rec->old_len = old_len;
     rec->new_len = new_len;
 
-    /* if we're deleting or replacing text, save the old text */
+    /* 
+     *   If we're deleting or replacing text, save the old text.  Move the
+     *   gap to the edit point first, so that the old text is contiguous
+     *   just after the gap; the splice is about to put the gap there
+     *   anyway, so this doesn't cost anything extra.  
+     */
     if (action == STRBUF_UNDO_DEL || action == STRBUF_UNDO_REPL)
-        memcpy(rec->str, get_ext()->buf + idx, old_len * sizeof(rec->str[0]));
+    {
+        get_ext()->move_gap(idx);
+        memcpy(rec->str, get_ext()->buf + idx + get_ext()->gap_size(),
+               old_len * sizeof(rec->str[0]));
+    }
     
     /* 
      *   Add the record to the global undo stream.  (We don't have anything
@@ -581,6 +628,8 @@ int CVmObjStringBuffer::equals(VMG_ vm_obj_id_t self,
         /* compare the buffers character by character */
         CVmObjStringBuffer *other =
             (CVmObjStringBuffer *)vm_objp(vmg_ val->val.obj);
+        close_gap();
+        other->close_gap();
         int32_t len1 = get_ext()->len, len2 = other->get_ext()->len;
         const wchar_t *buf1 = get_ext()->buf, *buf2 = other->get_ext()->buf;
 
@@ -610,6 +659,7 @@ int CVmObjStringBuffer::equals(VMG_ vm_obj_id_t self,
 int CVmObjStringBuffer::equals_str(const char *str) const
 {
     /* get the buffer pointers and character lengths */
+    close_gap();
     const wchar_t *p1 = get_ext()->buf;
     utf8_ptr p2((char *)str + VMB_LEN);
     int32_t len1 = get_ext()->len, len2 = p2.len(vmb_get_len(str));
@@ -645,6 +695,8 @@ int CVmObjStringBuffer::compare_to(VMG_ vm_obj_id_t self,
         /* compare the buffers character by character */
         CVmObjStringBuffer *other =
             (CVmObjStringBuffer *)vm_objp(vmg_ val->val.obj);
+        close_gap();
+        other->close_gap();
         int32_t len1 = get_ext()->len, len2 = other->get_ext()->len;
         const wchar_t *buf1 = get_ext()->buf, *buf2 = other->get_ext()->buf;
         for (int32_t i = 0 ; i < len1 && i < len2 ; ++i, ++buf1, ++buf2)
@@ -681,6 +733,7 @@ int CVmObjStringBuffer::compare_to(VMG_ vm_obj_id_t self,
 int CVmObjStringBuffer::compare_str(const char *str) const
 {
     /* get the buffer pointers and character lengths */
+    close_gap();
     const wchar_t *p1 = get_ext()->buf;
     utf8_ptr p2((char *)str + VMB_LEN);
     int32_t len1 = get_ext()->len, len2 = p2.len(vmb_get_len(str));
@@ -710,6 +763,7 @@ int CVmObjStringBuffer::compare_str(const char *str) const
 uint CVmObjStringBuffer::calc_hash(VMG_ vm_obj_id_t self, int) const
 {
     uint hash = 0;
+    close_gap();
     const wchar_t *p = get_ext()->buf;
     int32_t len = get_ext()->len;
 
@@ -770,6 +824,9 @@ int32_t CVmObjStringBuffer::utf8_length() const
 {
     vm_strbuf_ext *ext = get_ext();
 
+    /* make sure the string is contiguous */
+    close_gap();
+
     /* get our character length */
     int32_t rem = ext->len;
 
@@ -822,7 +879,7 @@ void CVmObjStringBuffer::to_utf8(char *buf, int32_t &idx, int32_t &bytelen)
     for (actual = 0 ; actual < bytelen && idx < (int32_t)ext->len ; ++idx)
     {
         /* get the next source character */
-        wchar_t c = ext->buf[idx];
+        wchar_t c = ext->get_char(idx);
         int clen = utf8_ptr::s_wchar_size(c);
         
         /* make sure it fits in the remaining output buffer space */
@@ -851,6 +908,9 @@ const char *CVmObjStringBuffer::substr_to_string(
     /* keep the arguments within our limits */
     adjust_args(&idx, &len, 0);
 
+    /* make sure the string is contiguous */
+    close_gap();
+
     /* calculate the size in bytes of the UTF-8 version of the string */
     utf8_ptr p;
     int32_t bytelen = p.setwchars(ext->buf + idx, len, 0);
@@ -977,17 +1037,23 @@ void CVmObjStringBuffer::splice_move(
         ensure_added_space(vmg_ ins - del);
 
     /* 
-     *   if we're doing a net insertion or deletion, move the part of the
-     *   string after the deleted text so that it'll be aligned at the end of
-     *   the inserted text 
+     *   Move the gap to the splice point.  The part of the string after
+     *   the splice point is now stored at the end of the buffer, so we can
+     *   delete characters simply by dropping them from the start of that
+     *   segment, and insert characters by writing them into the gap.  This
+     *   only moves the text between the previous edit point and this one,
+     *   rather than the whole tail of the string, which makes a series of
+     *   edits at or near the same point cheap.  
      */
-    if (ins != del && idx + del < get_ext()->len)
-        memmove(get_ext()->buf + idx + ins,
-                get_ext()->buf + idx + del,
-                (get_ext()->len - (idx + del)) * sizeof(wchar_t));
+    vm_strbuf_ext *ext = get_ext();
+    ext->move_gap(idx);
 
-    /* adjust the buffer length */
-    get_ext()->len += ins - del;
+    /* 
+     *   adjust the buffer length, and move the gap past the inserted text;
+     *   the caller will copy the new text into buf[idx..idx+ins-1] 
+     */
+    ext->len += ins - del;
+    ext->gap = idx + ins;
 }
 
 /* 
@@ -1076,7 +1142,7 @@ int CVmObjStringBuffer::getp_char_at(VMG_ vm_obj_id_t self,
         err_throw(VMERR_INDEX_OUT_OF_RANGE);
 
     /* return the character at the given index, as an integer Unicode code */
-    retval->set_int(get_ext()->buf[idx]);
+    retval->set_int(get_ext()->get_char(idx));
 
     /* handled */
     return TRUE;
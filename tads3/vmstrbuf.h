@@ -75,6 +75,27 @@ struct vm_strbuf_ext
     /* the incremental allocation size */
     int32_t inc;
 
+    /*
+     *   The position of the gap.  To make repeated edits near the same
+     *   point cheap, we keep the unused part of the buffer at the most
+     *   recent edit point rather than at the end.  Characters before 'gap'
+     *   are stored at the start of the buffer as usual; the characters
+     *   from 'gap' to the end of the string are stored at the END of the
+     *   allocated buffer, so the free space is between the two segments.
+     *   When gap == len, the string is contiguous in buf[0..len-1].
+     */
+    int32_t gap;
+
+    /* get the size of the gap (the unused part of the buffer) */
+    int32_t gap_size() const { return alo - len; }
+
+    /* get the character at a logical index, allowing for the gap */
+    wchar_t get_char(int32_t idx) const
+        { return buf[idx < gap ? idx : idx + gap_size()]; }
+
+    /* move the gap to the given logical index */
+    void move_gap(int32_t idx);
+
     /* 
      *   The string data, as 16-bit unicode character values.  We
      *   overallocate the structure to make room for an actual array length
@@ -285,13 +306,18 @@ public:
 
     /* 
      *   Get my string buffer.  Use with caution; the underlying buffer
-     *   pointer can change if we modify the contents. 
+     *   pointer can change if we modify the contents.  This closes the
+     *   edit gap, so that the returned buffer is contiguous.
      */
-    const wchar_t *get_buf() const { return get_ext()->buf; }
+    const wchar_t *get_buf() const { close_gap(); return get_ext()->buf; }
 
     /* get the current character length */
     size_t get_len() const { return get_ext()->len; }
 
+    /* append UTF-8 text to the end of the buffer, with undo */
+    void append_utf8(VMG_ vm_obj_id_t self, const char *src, int32_t bytes)
+        { insert_text(vmg_ self, get_ext()->len, src, bytes, TRUE); }
+
 protected:
     /* get my extension data */
     vm_strbuf_ext *get_ext() const { return (vm_strbuf_ext *)ext_; }
@@ -306,6 +332,16 @@ protected:
     /* move the tail of the buffer for a splice operation */
     void splice_move(VMG_ int32_t idx, int32_t del, int32_t ins);
 
+    /* 
+     *   close the edit gap, so that the string is contiguous in the buffer;
+     *   anything that reads the buffer directly must call this first 
+     */
+    void close_gap() const
+    {
+        if (get_ext() != 0 && get_ext()->gap != get_ext()->len)
+            get_ext()->move_gap(get_ext()->len);
+    }
+
     /* load or reload image data */
     void load_image_data(VMG_ const char *ptr, size_t siz);
 
@@ -556,6 +556,25 @@ void CVmObjStrComp::alloc_ext(VMG_ size_t trunc_len, int case_sensitive,
         /* set the mapping for this character */
         ext->equiv[idx1][idx2] = nxt_equiv;
     }
+
+    /* build the Latin-1 fast-path tables */
+    for (i = 0 ; i < 256 ; ++i)
+    {
+        wchar_t ch = (wchar_t)i;
+        const wchar_t *f;
+
+        /* figure the comparison character: the folded form, if any */
+        if (case_sensitive || (f = t3_to_fold(ch)) == 0)
+            ext->val_fold[i] = ch;
+        else if (f[0] != 0 && f[1] == 0)
+            ext->val_fold[i] = f[0];
+        else
+            ext->val_fold[i] = 0;
+
+        /* reference characters with equivalence mappings take the slow path */
+        ext->ref_fold[i] = (ext->equiv[0] != 0 && ext->equiv[0][i] != 0
+                            ? 0 : ext->val_fold[i]);
+    }
 }
 
 /* ------------------------------------------------------------------------ */
@@ -798,6 +817,17 @@ unsigned int CVmObjStrComp::calc_str_hash(const char *strp, size_t len)
     {
         /* get the current character */
         wchar_t ch = p.getch();
+
+        /* 
+         *   if it's a Latin-1 character with no mapping and a simple case
+         *   folding, add its comparison character directly 
+         */
+        if (ch < 256 && ext->ref_fold[ch] != 0)
+        {
+            if (!hash.add(ext->ref_fold[ch]))
+                return hash.hash;
+            continue;
+        }
         
         /* check for a substitution mapping for this character */
         vmobj_strcmp_equiv **t1, *eq;
@@ -946,6 +976,27 @@ unsigned long CVmObjStrComp::match_strings(const char *valstr, size_t vallen,
             continue;
         }
 
+        /* 
+         *   If both are Latin-1 characters with simple case foldings, and
+         *   the reference character has no equivalence mapping, we can
+         *   decide the match from the fast-path tables: the characters match
+         *   if their case foldings do, and otherwise there's nothing else to
+         *   try.  
+         */
+        if (refch < 256 && valch < 256
+            && ext->ref_fold[refch] != 0 && ext->val_fold[valch] != 0)
+        {
+            /* if they're not equivalent, we don't have a match */
+            if (ext->ref_fold[refch] != ext->val_fold[valch])
+                return 0;
+
+            /* they match with case folding */
+            ret |= RF_CASEFOLD;
+            valp.inc(&vallen);
+            refp.inc(&reflen);
+            continue;
+        }
+
         /* check for a case-folded match if we're insensitive to case */
         if (fold_case
             && t3_compare_case_fold_min(valp, vallen, refp, reflen) == 0)
@@ -1095,6 +1146,14 @@ size_t CVmObjStrComp::match_chars(const wchar_t *valstr, size_t vallen,
     /* check for an exact match first */
     if (refch == valch)
         return 1;
+
+    /* 
+     *   if both are Latin-1 characters that the fast-path tables cover, the
+     *   tables tell us whether they match 
+     */
+    if (refch < 256 && valch < 256
+        && ext->ref_fold[refch] != 0 && ext->val_fold[valch] != 0)
+        return (ext->ref_fold[refch] == ext->val_fold[valch] ? 1 : 0);
             
     /* check for a case-folded match if we're insensitive to case */
     if (fold_case)
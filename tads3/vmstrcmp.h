@@ -116,6 +116,20 @@ struct vmobj_strcmp_ext
      *   character.  
      */
     struct vmobj_strcmp_equiv **equiv[256];
+
+    /*
+     *   Fast-path tables for Latin-1 characters (0-255), which make up
+     *   nearly all of the text in most games.  For each character, these
+     *   give the single character that stands for it in comparisons and
+     *   hashing: the case folding of the character if we're insensitive to
+     *   case, or the character itself otherwise.  A zero entry means that
+     *   the fast path doesn't apply to the character, because its case
+     *   folding expands to several characters; ref_fold also has a zero
+     *   entry for each character with an equivalence mapping.  We build
+     *   these when we create the comparator.  
+     */
+    wchar_t val_fold[256];
+    wchar_t ref_fold[256];
 };
 
 /*
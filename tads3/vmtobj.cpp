@@ -49,7 +49,8 @@ Modified
  */
 vm_tadsobj_hdr *vm_tadsobj_hdr::alloc(VMG_ CVmObjTads *self,
                                       unsigned short sc_cnt,
-                                      unsigned short prop_cnt)
+                                      unsigned short prop_cnt,
+                                      int shaped)
 {
     ushort hash_siz;
     size_t siz;
@@ -91,7 +92,7 @@ vm_tadsobj_hdr *vm_tadsobj_hdr::alloc(VMG_ CVmObjTads *self,
     /* figure the size of the structure we need */
     siz = sizeof(vm_tadsobj_hdr)
           + (sc_cnt - 1) * sizeof(hdr->sc[0])
-          + (hash_siz) * sizeof(hdr->hash_arr[0])
+          + (shaped ? 0 : hash_siz) * sizeof(hdr->hash_arr[0])
           + prop_cnt * sizeof(hdr->prop_entry_arr[0]);
 
     /* allocate the memory */
@@ -110,16 +111,30 @@ vm_tadsobj_hdr *vm_tadsobj_hdr::alloc(VMG_ CVmObjTads *self,
     /* the object has no precalculated inheritance path yet */
     hdr->inh_path = 0;
 
-    /* suballocate the hash buckets */
-    hdr->hash_siz = hash_siz;
-    hdr->hash_arr = (vm_tadsobj_prop **)mem;
+    /* we don't have any image data yet */
+    hdr->image_data = 0;
 
-    /* clear out the hash buckets */
-    for (hashp = hdr->hash_arr, i = hash_siz ; i != 0 ; ++hashp, --i)
-        *hashp = 0;
+    /* 
+     *   A shaped object starts out with the empty shape, and uses the
+     *   shape's index instead of hash buckets.  Otherwise, suballocate and
+     *   clear the hash buckets.  
+     */
+    hdr->hash_siz = hash_siz;
+    if (shaped)
+    {
+        hdr->shape = G_tadsobj_shapes->get_root();
+        hdr->hash_arr = 0;
+    }
+    else
+    {
+        hdr->shape = 0;
+        hdr->hash_arr = (vm_tadsobj_prop **)mem;
+        for (hashp = hdr->hash_arr, i = hash_siz ; i != 0 ; ++hashp, --i)
+            *hashp = 0;
 
-    /* move past the memory taken by the hash buckets */
-    mem = (char *)(hdr->hash_arr + hash_siz);
+        /* move past the memory taken by the hash buckets */
+        mem = (char *)(hdr->hash_arr + hash_siz);
+    }
 
     /* suballocate the array of hash entries */
     hdr->prop_entry_cnt = prop_cnt;
@@ -128,6 +143,12 @@ vm_tadsobj_hdr *vm_tadsobj_hdr::alloc(VMG_ CVmObjTads *self,
     /* all entries are currently free, so point to the first entry */
     hdr->prop_entry_free = 0;
 
+    /* we haven't saved any undo yet */
+    hdr->undo_cnt = 0;
+
+    /* we haven't built a property list yet */
+    hdr->prop_list = VM_INVALID_OBJ;
+
     /* remember the superclass count */
     hdr->sc_cnt = sc_cnt;
 
@@ -145,6 +166,52 @@ void vm_tadsobj_hdr::free_mem()
         t3free(inh_path);
 }
 
+/*
+ *   Relocate a header.  The heap has copied us byte for byte from 'old_hdr'
+ *   to 'new_hdr', so our suballocated hash table and property entries have
+ *   moved along with us, but the pointers into them still point into the
+ *   old block.  Adjust each one by the distance the block moved.
+ */
+void vm_tadsobj_hdr::relocate(const vm_tadsobj_hdr *old_hdr,
+                              vm_tadsobj_hdr *new_hdr)
+{
+    const char *old_base = (const char *)old_hdr;
+    char *new_base = (char *)new_hdr;
+    size_t i;
+    vm_tadsobj_prop **hashp;
+    vm_tadsobj_prop *entryp;
+
+/* move a pointer into the old block to the same offset in the new block */
+#define VMTOBJ_RELOC(typ, p) ((typ)(new_base + ((const char *)(p) - old_base)))
+
+    /* fix the sub-array pointers */
+    new_hdr->prop_entry_arr =
+        VMTOBJ_RELOC(vm_tadsobj_prop *, old_hdr->prop_entry_arr);
+
+    /* a shaped object has no hash table, and its chain pointers are null */
+    if (new_hdr->hash_arr == 0)
+        return;
+
+    /* fix the hash bucket heads */
+    new_hdr->hash_arr = VMTOBJ_RELOC(vm_tadsobj_prop **, old_hdr->hash_arr);
+    for (hashp = new_hdr->hash_arr, i = new_hdr->hash_siz ; i != 0 ;
+         ++hashp, --i)
+    {
+        if (*hashp != 0)
+            *hashp = VMTOBJ_RELOC(vm_tadsobj_prop *, *hashp);
+    }
+
+    /* fix the hash chains in the entries in use */
+    for (entryp = new_hdr->prop_entry_arr, i = new_hdr->prop_entry_free ;
+         i != 0 ; ++entryp, --i)
+    {
+        if (entryp->nxt != 0)
+            entryp->nxt = VMTOBJ_RELOC(vm_tadsobj_prop *, entryp->nxt);
+    }
+
+#undef VMTOBJ_RELOC
+}
+
 /*
  *   Expand an existing object header to make room for more properties 
  */
@@ -174,14 +241,17 @@ vm_tadsobj_hdr *vm_tadsobj_hdr::expand(VMG_ CVmObjTads *self,
 vm_tadsobj_hdr *vm_tadsobj_hdr::expand_to(VMG_ CVmObjTads *self,
                                           vm_tadsobj_hdr *hdr,
                                           size_t new_sc_cnt,
-                                          size_t new_prop_cnt)
+                                          size_t new_prop_cnt,
+                                          int to_hash)
 {
     vm_tadsobj_hdr *new_hdr;
     size_t i;
     vm_tadsobj_prop *entryp;
+    int shaped = (hdr->shape != 0 && !to_hash);
 
     /* allocate a new object at the expanded property table size */
-    new_hdr = alloc(vmg_ self, (ushort)new_sc_cnt, (ushort)new_prop_cnt);
+    new_hdr = alloc(vmg_ self, (ushort)new_sc_cnt, (ushort)new_prop_cnt,
+                    shaped);
 
     /* copy the superclasses from the original object */
     memcpy(new_hdr->sc, hdr->sc,
@@ -191,6 +261,7 @@ vm_tadsobj_hdr *vm_tadsobj_hdr::expand_to(VMG_ CVmObjTads *self,
     /* use the same flags from the original object */
     new_hdr->li_obj_flags = hdr->li_obj_flags;
     new_hdr->intern_obj_flags = hdr->intern_obj_flags;
+    new_hdr->undo_cnt = hdr->undo_cnt;
 
     /* 
      *   if the superclass count is changing, we're obviously changing the
@@ -203,17 +274,35 @@ vm_tadsobj_hdr *vm_tadsobj_hdr::expand_to(VMG_ CVmObjTads *self,
     /* copy the old inheritance path (if we still have one) */
     new_hdr->inh_path = hdr->inh_path;
 
-    /* 
-     *   Run through all of the existing properties and duplicate them in the
-     *   new object, to build the new object's hash table.  Note that the
-     *   free index is inherently equivalent to the count of properties in
-     *   use.  
-     */
-    for (i = hdr->prop_entry_free, entryp = hdr->prop_entry_arr ; i != 0 ;
-         --i, ++entryp)
+    /* copy the image data pointer */
+    new_hdr->image_data = hdr->image_data;
+
+    if (shaped)
+    {
+        /* 
+         *   we're keeping our shape, so the entries stay in the same slots
+         *   - just copy them 
+         */
+        memcpy(new_hdr->prop_entry_arr, hdr->prop_entry_arr,
+               hdr->prop_entry_free * sizeof(hdr->prop_entry_arr[0]));
+        new_hdr->prop_entry_free = hdr->prop_entry_free;
+        new_hdr->shape = hdr->shape;
+    }
+    else
     {
-        /* add this property to the new table */
-        new_hdr->alloc_prop_entry(entryp->prop, &entryp->val, entryp->flags);
+        /* 
+         *   Run through all of the existing properties and duplicate them
+         *   in the new object, to build the new object's hash table.  Note
+         *   that the free index is inherently equivalent to the count of
+         *   properties in use.  
+         */
+        for (i = hdr->prop_entry_free, entryp = hdr->prop_entry_arr ; i != 0 ;
+             --i, ++entryp)
+        {
+            /* add this property to the new table */
+            new_hdr->alloc_prop_entry(vmg_ entryp->prop, &entryp->val,
+                                      entryp->flags);
+        }
     }
 
     /* delete the old header */
@@ -231,20 +320,33 @@ vm_tadsobj_hdr *vm_tadsobj_hdr::expand_to(VMG_ CVmObjTads *self,
  *   our table.  
  */
 vm_tadsobj_prop *vm_tadsobj_hdr::alloc_prop_entry(
-    vm_prop_id_t prop, const vm_val_t *val, unsigned int flags)
+    VMG_ vm_prop_id_t prop, const vm_val_t *val, unsigned int flags)
 {
-    /* get the hash code for the property */
-    unsigned int hash = calc_hash(prop);
-
     /* use the next free entry */
     vm_tadsobj_prop *entry = &prop_entry_arr[prop_entry_free];
 
-    /* link this entry into the list for its hash bucket */
-    entry->nxt = hash_arr[hash];
-    hash_arr[hash] = entry;
+    if (shape != 0)
+    {
+        /* 
+         *   the new entry goes in the next slot, so move to the child shape
+         *   that adds this property 
+         */
+        shape = G_tadsobj_shapes->add(shape, prop);
+        entry->nxt = 0;
+    }
+    else
+    {
+        /* link this entry into the list for its hash bucket */
+        unsigned int hash = calc_hash(prop);
+        entry->nxt = hash_arr[hash];
+        hash_arr[hash] = entry;
+    }
 
     /* count our use of the free entry */
     ++prop_entry_free;
+
+    /* the cached property list no longer covers every entry */
+    prop_list = VM_INVALID_OBJ;
     
     /* set the new entry's property ID */
     entry->prop = prop;
@@ -262,6 +364,13 @@ vm_tadsobj_prop *vm_tadsobj_hdr::alloc_prop_entry(
  */
 vm_tadsobj_prop *vm_tadsobj_hdr::find_prop_entry(uint prop)
 {
+    /* if we have a shape, it tells us the slot */
+    if (shape != 0)
+    {
+        int slot = shape->find((vm_prop_id_t)prop);
+        return (slot >= 0 ? &prop_entry_arr[slot] : 0);
+    }
+
     /* scan the list of entries in this bucket */
     for (vm_tadsobj_prop *entry = hash_arr[calc_hash(prop)] ;
          entry != 0 ; entry = entry->nxt)
@@ -275,6 +384,95 @@ vm_tadsobj_prop *vm_tadsobj_hdr::find_prop_entry(uint prop)
     return 0;
 }
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Property table shapes 
+ */
+
+/*
+ *   Build a shape's index 
+ */
+void vm_tadsobj_shape::build_index()
+{
+    /* keep the table at most half full, for short probe sequences */
+    size_t siz;
+    for (siz = 2 ; siz < (size_t)cnt * 2 ; siz <<= 1) ;
+
+    /* allocate it, with every entry empty */
+    idx = (vm_tadsobj_shape_idx *)t3malloc(siz * sizeof(idx[0]));
+    memset(idx, 0, siz * sizeof(idx[0]));
+    idx_siz = (unsigned short)siz;
+
+    /* 
+     *   enter each property; the shapes on the way back to the root each
+     *   add one property, in the slot just before the shape's count 
+     */
+    for (vm_tadsobj_shape *s = this ; s->cnt != 0 ; s = s->parent)
+    {
+        size_t h;
+        for (h = s->prop & (siz - 1) ; idx[h].prop != VM_INVALID_PROP ;
+             h = (h + 1) & (siz - 1)) ;
+        idx[h].prop = s->prop;
+        idx[h].slot = s->cnt - 1;
+    }
+}
+
+/*
+ *   Get or create a child shape 
+ */
+vm_tadsobj_shape *CVmObjTadsShapeTable::add(vm_tadsobj_shape *s,
+                                            vm_prop_id_t prop)
+{
+    /* if we already have this transition, use the existing shape */
+    vm_tadsobj_shape *c = find_child(s, prop);
+    if (c != 0)
+        return c;
+
+    /* create the new shape */
+    c = (vm_tadsobj_shape *)t3malloc(sizeof(vm_tadsobj_shape));
+    c->parent = s;
+    c->prop = prop;
+    c->cnt = s->cnt + 1;
+    c->idx_siz = 0;
+    c->idx = 0;
+
+    /* link it into the transition table */
+    size_t h = hash(s, prop);
+    c->nxt = hash_[h];
+    hash_[h] = c;
+
+    /* count its memory, including the index it will need */
+    mem_used_ += sizeof(vm_tadsobj_shape)
+                 + 2 * c->cnt * sizeof(vm_tadsobj_shape_idx);
+
+    /* return the new shape */
+    return c;
+}
+
+/*
+ *   Delete all shapes 
+ */
+void CVmObjTadsShapeTable::clear()
+{
+    for (size_t i = 0 ; i < VMTOBJ_SHAPE_HASH_SIZE ; ++i)
+    {
+        vm_tadsobj_shape *cur, *nxt;
+        for (cur = hash_[i] ; cur != 0 ; cur = nxt)
+        {
+            nxt = cur->nxt;
+            if (cur->idx != 0)
+                t3free(cur->idx);
+            t3free(cur);
+        }
+        hash_[i] = 0;
+    }
+
+    if (root_.idx != 0)
+        t3free(root_.idx);
+    memset(&root_, 0, sizeof(root_));
+    mem_used_ = 0;
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   statics 
@@ -322,6 +520,21 @@ void CVmObjTads::class_init(VMG0_)
     VM_IFELSE_ALLOC_PRE_GLOBAL(
         G_tadsobj_queue = new CVmObjTadsInhQueue(),
         G_tadsobj_queue->init());
+
+    /* allocate the call-site property cache */
+    VM_IFELSE_ALLOC_PRE_GLOBAL(
+        G_tadsobj_cache = new CVmObjTadsPropCache(),
+        G_tadsobj_cache->init());
+
+    /* allocate the per-class instance index */
+    VM_IFELSE_ALLOC_PRE_GLOBAL(
+        G_tadsobj_insts = new CVmObjTadsInstIndex(),
+        G_tadsobj_insts->init());
+
+    /* allocate the shape table */
+    VM_IFELSE_ALLOC_PRE_GLOBAL(
+        G_tadsobj_shapes = new CVmObjTadsShapeTable(),
+        G_tadsobj_shapes->init());
 }
 
 /*
@@ -334,6 +547,205 @@ void CVmObjTads::class_term(VMG0_)
         delete G_tadsobj_queue;
         G_tadsobj_queue = 0;
     )
+
+    /* delete the call-site property cache */
+    VM_IF_ALLOC_PRE_GLOBAL(
+        delete G_tadsobj_cache;
+        G_tadsobj_cache = 0;
+    )
+
+    /* 
+     *   delete the instance index; if it's a static global, at least
+     *   discard its lists, since they refer to this session's objects 
+     */
+    G_tadsobj_insts->invalidate();
+    VM_IF_ALLOC_PRE_GLOBAL(
+        delete G_tadsobj_insts;
+        G_tadsobj_insts = 0;
+    )
+
+    /* 
+     *   delete the shapes (nothing looks at the remaining objects' shapes
+     *   as they're deleted, so this is safe) 
+     */
+    G_tadsobj_shapes->clear();
+    VM_IF_ALLOC_PRE_GLOBAL(
+        delete G_tadsobj_shapes;
+        G_tadsobj_shapes = 0;
+    )
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Per-class instance index 
+ */
+
+/*
+ *   discard all of the lists 
+ */
+void CVmObjTadsInstIndex::invalidate()
+{
+    /* free the ID arrays and mark the slots as unused */
+    for (size_t i = 0 ; i < VMTOBJ_INST_IDX_SLOTS ; ++i)
+    {
+        vm_tadsobj_inst_list *l = &lists_[i];
+        if (l->ids != 0)
+            t3free(l->ids);
+        l->ids = 0;
+        l->cnt = l->alloc = 0;
+        l->cls = VM_INVALID_OBJ;
+    }
+
+    /* there's nothing left to update */
+    list_cnt_ = 0;
+    pending_cnt_ = 0;
+}
+
+/*
+ *   add an object to a list, keeping the list in ascending order 
+ */
+void CVmObjTadsInstIndex::insert(vm_tadsobj_inst_list *l, vm_obj_id_t obj)
+{
+    /* find the insertion point */
+    size_t lo = 0, hi = l->cnt;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (l->ids[mid] < obj)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    /* 
+     *   if it's already there, we're done - this happens when a deleted
+     *   object's ID is reused 
+     */
+    if (lo < l->cnt && l->ids[lo] == obj)
+        return;
+
+    /* make room */
+    if (l->cnt == l->alloc)
+    {
+        size_t new_alloc = (l->alloc < 16 ? 16 : l->alloc * 2);
+        vm_obj_id_t *new_ids = (vm_obj_id_t *)t3realloc(
+            l->ids, new_alloc * sizeof(l->ids[0]));
+        if (new_ids == 0)
+            err_throw(VMERR_OUT_OF_MEMORY);
+        l->ids = new_ids;
+        l->alloc = new_alloc;
+    }
+
+    /* insert it */
+    memmove(l->ids + lo + 1, l->ids + lo, (l->cnt - lo) * sizeof(l->ids[0]));
+    l->ids[lo] = obj;
+    ++l->cnt;
+}
+
+/*
+ *   merge the pending new objects into the lists 
+ */
+void CVmObjTadsInstIndex::merge_pending(VMG0_)
+{
+    for (size_t i = 0 ; i < pending_cnt_ ; ++i)
+    {
+        /* 
+         *   skip it if it's been deleted already (if its ID has since been
+         *   reused, the new object will be in the pending list as well) 
+         */
+        vm_obj_id_t obj = pending_[i];
+        if (!G_obj_table->is_obj_id_valid(obj))
+            continue;
+
+        /* add it to the list of each class it inherits from */
+        CVmObject *objp = vm_objp(vmg_ obj);
+        for (size_t j = 0 ; j < VMTOBJ_INST_IDX_SLOTS ; ++j)
+        {
+            vm_tadsobj_inst_list *l = &lists_[j];
+            if (l->cls != VM_INVALID_OBJ && objp->is_instance_of(vmg_ l->cls))
+                insert(l, obj);
+        }
+    }
+
+    /* the pending list is now empty */
+    pending_cnt_ = 0;
+}
+
+/*
+ *   get the candidate list for a class 
+ */
+const vm_obj_id_t *CVmObjTadsInstIndex::get_list(
+    VMG_ vm_obj_id_t cls, size_t *cnt)
+{
+    vm_tadsobj_inst_list *l;
+    size_t i;
+
+    /* bring the existing lists up to date */
+    if (pending_cnt_ != 0)
+        merge_pending(vmg0_);
+
+    /* 
+     *   look for an existing list, noting the slot to use if we don't find
+     *   one: the first unused slot, or else the least recently used one 
+     */
+    vm_tadsobj_inst_list *victim = 0;
+    for (i = 0, l = lists_ ; i < VMTOBJ_INST_IDX_SLOTS ; ++i, ++l)
+    {
+        /* if this is the class we're looking for, return its list */
+        if (l->cls == cls)
+        {
+            l->last_use = ++use_seq_;
+            *cnt = l->cnt;
+            return l->ids;
+        }
+
+        if (l->cls == VM_INVALID_OBJ)
+        {
+            if (victim == 0 || victim->cls != VM_INVALID_OBJ)
+                victim = l;
+        }
+        else if (victim == 0
+                 || (victim->cls != VM_INVALID_OBJ
+                     && l->last_use < victim->last_use))
+            victim = l;
+    }
+
+    /* build a new list in the chosen slot */
+    l = victim;
+    if (l->cls == VM_INVALID_OBJ)
+        ++list_cnt_;
+    l->cls = cls;
+    l->cnt = 0;
+    l->last_use = ++use_seq_;
+
+    /* 
+     *   Scan the object table for instances and subclasses.  The scan runs
+     *   in ID order, so simply appending keeps the list sorted.  If we
+     *   throw partway through, drop the slot, since it would be
+     *   incomplete.  
+     */
+    err_try
+    {
+        vm_obj_id_t max_id = G_obj_table->get_max_used_obj_id();
+        for (vm_obj_id_t obj = 1 ; obj < max_id ; ++obj)
+        {
+            if (G_obj_table->is_obj_id_valid(obj)
+                && vm_objp(vmg_ obj)->is_instance_of(vmg_ cls))
+                insert(l, obj);
+        }
+    }
+    err_catch_disc
+    {
+        l->cls = VM_INVALID_OBJ;
+        l->cnt = 0;
+        --list_cnt_;
+        err_rethrow();
+    }
+    err_end;
+
+    /* return the new list */
+    *cnt = l->cnt;
+    return l->ids;
 }
 
 /* ------------------------------------------------------------------------ */
@@ -400,7 +812,10 @@ vm_obj_id_t CVmObjTads::create_from_stack_intern(
 
     /* set the object's superclass */
     if (val.typ != VM_NIL)
+    {
         obj->set_sc(vmg_ 0, val.val.obj);
+        G_tadsobj_insts->note_new(id);
+    }
 
     /* 
      *   Invoke the object's "construct" method, passing it the arguments
@@ -551,6 +966,9 @@ vm_obj_id_t CVmObjTads::create_from_stack_multi(
         obj->set_sc(vmg_ i, sc.val.obj);
     }
 
+    /* add it to the instance lists of its classes */
+    G_tadsobj_insts->note_new(id);
+
     /* set up the resursive invocation context */
     vm_rcdesc rc("TadsObject.contructMulti");
 
@@ -643,6 +1061,17 @@ void CVmObjTads::notify_delete(VMG_ int in_root_set)
     /* free our extension */
     if (ext_ != 0)
     {
+        /* 
+         *   if we're part of a cached inheritance search, our ID could be
+         *   reused for an unrelated object, so drop the cached results 
+         */
+        if ((get_hdr()->intern_obj_flags & (VMTO_OBJ_SC | VMTO_OBJ_KEY)) != 0)
+            G_tadsobj_cache->invalidate();
+
+        /* likewise any ofKind results for us as a superclass */
+        if ((get_hdr()->intern_obj_flags & VMTO_OBJ_SC) != 0)
+            G_tadsobj_cache->invalidate_kind();
+
         /* tell the header to delete its memory */
         get_hdr()->free_mem();
 
@@ -651,6 +1080,16 @@ void CVmObjTads::notify_delete(VMG_ int in_root_set)
     }
 }
 
+/*
+ *   receive notification that the heap has moved our extension 
+ */
+void CVmObjTads::relocate_ext(VMG_ char *new_ext)
+{
+    /* fix up the internal pointers in the new copy, then switch to it */
+    vm_tadsobj_hdr::relocate(get_hdr(), (vm_tadsobj_hdr *)new_ext);
+    ext_ = new_ext;
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Create an instance of this class 
@@ -752,6 +1191,116 @@ void CVmObjTads::clear_undo_flags()
         /* clear this entry's undo flag */
         entry->flags &= ~VMTO_PROP_UNDO;
     }
+
+    /* we have no undo records or snapshot in the new savepoint yet */
+    hdr->intern_obj_flags &= ~VMTO_OBJ_SNAP;
+    hdr->undo_cnt = 0;
+}
+
+/*
+ *   Save an undo snapshot of the property table 
+ */
+void CVmObjTads::save_undo_snapshot(VMG_ CVmUndo *undo, vm_obj_id_t self)
+{
+    vm_tadsobj_hdr *hdr = get_hdr();
+
+    /* 
+     *   mark the object as snapshotted for this savepoint, whether or not
+     *   we end up saving anything: if the undo manager won't take the
+     *   record, it wouldn't take individual property records either 
+     */
+    hdr->intern_obj_flags |= VMTO_OBJ_SNAP;
+
+    /* 
+     *   if the object doesn't need undo in this savepoint (because it was
+     *   created after the savepoint started), don't bother 
+     */
+    if (!G_obj_table->is_obj_in_undo(self))
+        return;
+
+    /* make a copy of the entries in use */
+    vm_tadsobj_snap *snap = (vm_tadsobj_snap *)t3malloc(
+        sizeof(vm_tadsobj_snap)
+        + (hdr->prop_entry_free - 1)*sizeof(snap->ent[0]));
+    if (snap == 0)
+        err_throw(VMERR_OUT_OF_MEMORY);
+    snap->cnt = hdr->prop_entry_free;
+    memcpy(snap->ent, hdr->prop_entry_arr,
+           hdr->prop_entry_free * sizeof(snap->ent[0]));
+
+    /* 
+     *   save it in a pointer-keyed record, with our special 'empty' marker
+     *   value; if the undo manager doesn't keep it, discard it 
+     */
+    vm_val_t v;
+    v.set_empty();
+    v.val.intval = 2;
+    if (!undo->add_new_record_ptr_key(vmg_ self, snap, &v))
+        t3free(snap);
+}
+
+/*
+ *   Is the given record a snapshot record? 
+ */
+int CVmObjTads::is_undo_snapshot(const CVmUndoRecord *rec)
+{
+    return (rec->oldval.typ == VM_EMPTY && rec->oldval.val.intval == 2
+            && rec->id.ptrval != 0);
+}
+
+/*
+ *   Restore the property table from an undo snapshot 
+ */
+void CVmObjTads::apply_undo_snapshot(VMG_ const vm_tadsobj_snap *snap)
+{
+    vm_tadsobj_hdr *hdr = get_hdr();
+    size_t i;
+
+    /* 
+     *   Remove the properties added since the snapshot.  Entries are
+     *   allocated in order and never moved (expansion preserves their
+     *   order), so these are simply the entries past the snapshot's count.
+     */
+    if (hdr->prop_entry_free > snap->cnt)
+    {
+        if (hdr->shape != 0)
+        {
+            /* go back to the shape we had with the snapshot's entries */
+            hdr->shape = CVmObjTadsShapeTable::truncate(hdr->shape, snap->cnt);
+        }
+        else
+        {
+            for (i = hdr->prop_entry_free ; i > snap->cnt ; --i)
+            {
+                vm_tadsobj_prop *entry = &hdr->prop_entry_arr[i - 1];
+                vm_tadsobj_prop *cur, **prv;
+
+                /* find it in its hash chain and unlink it */
+                for (prv = &hdr->hash_arr[hdr->calc_hash(entry->prop)] ;
+                     (cur = *prv) != 0 && cur != entry ; prv = &cur->nxt) ;
+                if (cur == entry)
+                    *prv = entry->nxt;
+            }
+        }
+
+        /* return the entries to the free list */
+        hdr->prop_entry_free = snap->cnt;
+        hdr->prop_list = VM_INVALID_OBJ;
+
+        /* a cached search might have resolved to one of these entries */
+        if ((hdr->intern_obj_flags & VMTO_OBJ_SC) != 0)
+            G_tadsobj_cache->invalidate();
+    }
+
+    /* restore the values and flags of the remaining entries */
+    for (i = 0 ; i < hdr->prop_entry_free ; ++i)
+    {
+        vm_tadsobj_prop *entry = &hdr->prop_entry_arr[i];
+
+        assert(entry->prop == snap->ent[i].prop);
+        entry->val = snap->ent[i].val;
+        entry->flags = snap->ent[i].flags;
+    }
 }
 
 /* ------------------------------------------------------------------------ */
@@ -767,6 +1316,20 @@ void CVmObjTads::set_prop(VMG_ CVmUndo *undo, vm_obj_id_t self,
     /* look for an existing property entry */
     vm_tadsobj_prop *entry = hdr->find_prop_entry(prop);
 
+    /*
+     *   If this change needs undo, and we've already saved enough property
+     *   records in this savepoint to cover a good fraction of the object,
+     *   save a snapshot of the whole property table instead.  We have to do
+     *   this before making the change, since the snapshot must reflect the
+     *   old value.  
+     */
+    if (undo != 0
+        && (hdr->intern_obj_flags & VMTO_OBJ_SNAP) == 0
+        && hdr->undo_cnt >= VMTOBJ_UNDO_SNAP_MIN
+        && hdr->undo_cnt >= hdr->prop_entry_free / 4
+        && (entry == 0 || (entry->flags & VMTO_PROP_UNDO) == 0))
+        save_undo_snapshot(vmg_ undo, self);
+
     /* check for an existing entry for the property */
     vm_val_t oldval;
     if (entry != 0)
@@ -781,8 +1344,20 @@ void CVmObjTads::set_prop(VMG_ CVmUndo *undo, vm_obj_id_t self,
     {
         /* 
          *   We didn't find an existing entry for the property, so we have to
-         *   add a new one.  If we don't have any free property slots left,
-         *   expand the object to create some more property slots.  
+         *   add a new one.  If we have a shape, and there's no shape for our
+         *   properties plus this one, our property set has diverged from
+         *   the shared shapes, so switch to a hash table of our own.  
+         */
+        if (hdr->shape != 0 && !G_tadsobj_shapes->can_add(hdr->shape, prop))
+        {
+            ext_ = (char *)vm_tadsobj_hdr::expand_to(
+                vmg_ this, hdr, hdr->sc_cnt, hdr->prop_entry_cnt, TRUE);
+            hdr = get_hdr();
+        }
+
+        /* 
+         *   If we don't have any free property slots left, expand the
+         *   object to create some more property slots.  
          */
         if (!hdr->has_free_entries(1))
         {
@@ -794,7 +1369,14 @@ void CVmObjTads::set_prop(VMG_ CVmUndo *undo, vm_obj_id_t self,
         }
 
         /* allocate a new entry */
-        entry = hdr->alloc_prop_entry(prop, val, 0);
+        entry = hdr->alloc_prop_entry(vmg_ prop, val, 0);
+
+        /* 
+         *   if a cached inheritance search went through this object, the
+         *   new property could override the cached result 
+         */
+        if ((hdr->intern_obj_flags & VMTO_OBJ_SC) != 0)
+            G_tadsobj_cache->invalidate();
 
         /* 
          *   The old value didn't exist, so mark it emtpy, with an intval of
@@ -809,10 +1391,12 @@ void CVmObjTads::set_prop(VMG_ CVmUndo *undo, vm_obj_id_t self,
      *   If we already have undo for this property for the current
      *   savepoint, as indicated by the undo flag for the property, we don't
      *   need to save undo for this change, since we already have an undo
-     *   record in the current savepoint.  Otherwise, we need to add an undo
-     *   record for this savepoint.  
+     *   record in the current savepoint.  Likewise, if we've saved a
+     *   snapshot of the whole property table, it covers this change too.
+     *   Otherwise, we need to add an undo record for this savepoint.  
      */
-    if (undo != 0 && (entry->flags & VMTO_PROP_UNDO) == 0)
+    if (undo != 0 && (entry->flags & VMTO_PROP_UNDO) == 0
+        && (hdr->intern_obj_flags & VMTO_OBJ_SNAP) == 0)
     {
         /* save the undo record */
         undo->add_new_record_prop_key(vmg_ self, prop, &oldval);
@@ -820,6 +1404,9 @@ void CVmObjTads::set_prop(VMG_ CVmUndo *undo, vm_obj_id_t self,
         /* mark the property as now having undo in this savepoint */
         entry->flags |= VMTO_PROP_UNDO;
 
+        /* count it */
+        ++hdr->undo_cnt;
+
         /* 
          *   If the entry wasn't previously marked as modified, remember this
          *   by storing an extra 'empty' undo record with intval 1 after the
@@ -842,6 +1429,11 @@ void CVmObjTads::set_prop(VMG_ CVmUndo *undo, vm_obj_id_t self,
     /* mark the property entry as modified */
     entry->flags |= VMTO_PROP_MOD;
 
+    /* if we now refer to an object outside the root set, tell the GC */
+    if ((val->typ == VM_OBJ || val->typ == VM_OBJX)
+        && !G_obj_table->is_obj_in_root_set(val->val.obj))
+        G_obj_table->gc_write_barrier(self);
+
     /* mark the overall object as modified */
     mark_modified(vmg_ undo, self);
 }
@@ -887,6 +1479,17 @@ void CVmObjTads::build_prop_list(VMG_ vm_obj_id_t self, vm_val_t *retval)
     vm_tadsobj_prop *entry;
     vm_tadsobj_hdr *hdr = get_hdr();
     
+    /* 
+     *   if the property table hasn't changed since we last built the list,
+     *   return the same list again - lists are immutable, so sharing it
+     *   is invisible to the caller 
+     */
+    if (hdr->prop_list != VM_INVALID_OBJ)
+    {
+        retval->set_obj(hdr->prop_list);
+        return;
+    }
+
     /* the next free index is also the number of properties we have */
     cnt = hdr->prop_entry_free;
 
@@ -910,6 +1513,14 @@ void CVmObjTads::build_prop_list(VMG_ vm_obj_id_t self, vm_val_t *retval)
 
     /* set the final length of the list */
     lst->cons_set_len(idx);
+
+    /* 
+     *   cache the list for next time (re-fetching the header, since
+     *   creating the list could have run the garbage collector), and
+     *   since this is a new reference, have the GC trace us again 
+     */
+    get_hdr()->prop_list = retval->val.obj;
+    G_obj_table->gc_write_barrier(self);
 }
 
 
@@ -1033,6 +1644,100 @@ struct tadsobj_sc_search_ctx
         return FALSE;
     }
 
+    /*
+     *   Find the given property in the current object, searching its
+     *   superclasses as needed.  This is equivalent to find_prop(), but uses
+     *   the inheritance cache for the superclass search where possible.  For
+     *   an object with a single superclass, we check the superclass directly
+     *   before going to the cache, so that the cache entry is keyed on the
+     *   class rather than on each of its instances.  
+     */
+    int find_prop_cached(VMG_ uint prop, vm_val_t *val, vm_obj_id_t *source)
+    {
+        /* check the current object */
+        vm_tadsobj_prop *entry = curhdr->find_prop_entry(prop);
+        if (entry != 0)
+        {
+            *val = entry->val;
+            *source = cur;
+            return TRUE;
+        }
+
+        /* if we have a single superclass, step up to it and check it */
+        if (path_sc == 0 && curhdr->sc_cnt == 1)
+        {
+            to_next(vmg0_);
+            if ((entry = curhdr->find_prop_entry(prop)) != 0)
+            {
+                *val = entry->val;
+                *source = cur;
+                return TRUE;
+            }
+        }
+
+        /* search the rest of the superclasses */
+        return find_prop_above(vmg_ prop, val, source);
+    }
+
+    /*
+     *   Find the given property in the superclasses of the current object,
+     *   not including the current object itself.  If we're not following a
+     *   multiple-inheritance path from an earlier object, the result depends
+     *   only on the current object, so we can use the inheritance cache.  We
+     *   tag every object we visit on the way, so that any change to their
+     *   property tables will invalidate the cached result.  
+     */
+    int find_prop_above(VMG_ uint prop, vm_val_t *val, vm_obj_id_t *source)
+    {
+        /* 
+         *   if we're partway through a multiple-inheritance path, the rest
+         *   of the search depends on where we started, so don't cache it 
+         */
+        if (path_sc != 0)
+            return to_next(vmg0_) && find_prop(vmg_ prop, val, source);
+
+        /* check the cache */
+        CVmObjTadsPropCache *pc = G_tadsobj_cache;
+        vm_obj_id_t key = cur;
+        vm_obj_id_t src;
+        vm_tadsobj_prop *entry;
+        if (pc->find_inh(key, prop, &src))
+        {
+            /* if the cache says there's no definition, we're done */
+            if (src == VM_INVALID_OBJ)
+                return FALSE;
+
+            /* get the value from the defining object */
+            entry = ((CVmObjTads *)vm_objp(vmg_ src))
+                    ->get_hdr()->find_prop_entry(prop);
+            if (entry != 0)
+            {
+                *val = entry->val;
+                *source = src;
+                return TRUE;
+            }
+        }
+
+        /* tag the key object, and search the superclasses, tagging each */
+        curhdr->intern_obj_flags |= VMTO_OBJ_KEY;
+        while (to_next(vmg0_))
+        {
+            curhdr->intern_obj_flags |= VMTO_OBJ_SC;
+            if ((entry = curhdr->find_prop_entry(prop)) != 0)
+            {
+                /* found it - cache and return the result */
+                *val = entry->val;
+                *source = cur;
+                pc->store_inh(key, prop, cur);
+                return TRUE;
+            }
+        }
+
+        /* no superclass defines it - remember that, too */
+        pc->store_inh(key, prop, VM_INVALID_OBJ);
+        return FALSE;
+    }
+
     /*  
      *   Move to the next superclass.  This updates 'cur' to refer to the
      *   next object in inheritance order.  Returns true if there is a next
@@ -1217,13 +1922,12 @@ int CVmObjTads::search_for_prop_from(VMG_ uint prop,
         if (!curpos.skip_to(vmg_ defining_obj))
             return FALSE;
 
-        /* skip defining_obj itself */
-        if (!curpos.to_next(vmg0_))
-            return FALSE;
+        /* search past defining_obj */
+        return curpos.find_prop_above(vmg_ prop, val, source_obj);
     }
 
     /* find the property */
-    return curpos.find_prop(vmg_ prop, val, source_obj);
+    return curpos.find_prop_cached(vmg_ prop, val, source_obj);
 }
 
 /* ------------------------------------------------------------------------ */
@@ -1240,7 +1944,7 @@ int CVmObjTads::get_prop(VMG_ vm_prop_id_t prop, vm_val_t *val,
      *   superclass property list 
      */
     tadsobj_sc_search_ctx curpos(vmg_ self, this);
-    if (curpos.find_prop(vmg_ prop, val, source_obj))
+    if (curpos.find_prop_cached(vmg_ prop, val, source_obj))
         return TRUE;
 
     /* 
@@ -1257,6 +1961,81 @@ int CVmObjTads::get_prop(VMG_ vm_prop_id_t prop, vm_val_t *val,
     return CVmObject::get_prop(vmg_ prop, val, self, source_obj, argc);
 }
 
+/*
+ *   Get a property at a given call site.  This follows the same search
+ *   order as get_prop(), but for the common single-superclass case we
+ *   consult the call-site cache before walking the superclass chain.  
+ */
+int CVmObjTads::get_prop_at_site(VMG_ const uchar *site, vm_prop_id_t prop,
+                                 vm_val_t *val, vm_obj_id_t self,
+                                 vm_obj_id_t *source_obj, uint *argc)
+{
+    vm_tadsobj_hdr *hdr = get_hdr();
+    if (hdr->sc_cnt == 1)
+    {
+        /* a property defined directly in the object always wins */
+        vm_tadsobj_prop *entry = hdr->find_prop_entry(prop);
+        if (entry != 0)
+        {
+            *val = entry->val;
+            *source_obj = self;
+            return TRUE;
+        }
+
+        /* check the cache for this site and superclass */
+        CVmObjTadsPropCache *ic = G_tadsobj_cache;
+        vm_obj_id_t sc = hdr->sc[0].id;
+        vm_obj_id_t src = ic->find(site, sc, prop);
+        if (src != VM_INVALID_OBJ)
+        {
+            /* get the value from the defining object */
+            entry = ((CVmObjTads *)vm_objp(vmg_ src))
+                    ->get_hdr()->find_prop_entry(prop);
+            if (entry != 0)
+            {
+                *val = entry->val;
+                *source_obj = src;
+                return TRUE;
+            }
+        }
+
+        /* 
+         *   Search the superclass.  Tag it, so that a change to its property
+         *   table invalidates the result we're about to cache; the
+         *   inheritance search above it tags the rest of the chain.  
+         */
+        tadsobj_sc_search_ctx curpos(vmg_ self, this);
+        curpos.to_next(vmg0_);
+        curpos.curhdr->intern_obj_flags |= VMTO_OBJ_SC;
+        if ((entry = curpos.curhdr->find_prop_entry(prop)) != 0)
+        {
+            *val = entry->val;
+            *source_obj = curpos.cur;
+            ic->store(site, sc, prop, curpos.cur);
+            return TRUE;
+        }
+        else if (curpos.find_prop_above(vmg_ prop, val, source_obj))
+        {
+            ic->store(site, sc, prop, *source_obj);
+            return TRUE;
+        }
+    }
+    else
+    {
+        /* multiple inheritance - do the full search */
+        tadsobj_sc_search_ctx curpos(vmg_ self, this);
+        if (curpos.find_prop_cached(vmg_ prop, val, source_obj))
+            return TRUE;
+    }
+
+    /* try the intrinsic class methods */
+    if (get_prop_intrinsic(vmg_ prop, val, self, source_obj, argc))
+        return TRUE;
+
+    /* inherit from the base metaclass */
+    return CVmObject::get_prop(vmg_ prop, val, self, source_obj, argc);
+}
+
 /*
  *   Inherit a property.  
  */
@@ -1387,11 +2166,63 @@ void CVmObjTads::enum_props(VMG_ vm_obj_id_t self,
 
 
 /* ------------------------------------------------------------------------ */
+/*
+ *   Determine if a superclass is or inherits from the given object, using
+ *   the ofKind cache when we can 
+ */
+int CVmObjTads::sc_is_kind_of(VMG_ const vm_tadsobj_sc *sc,
+                              vm_obj_id_t obj)
+{
+    int result;
+
+    /* if it's the object itself, we have our answer */
+    if (sc->id == obj)
+        return TRUE;
+
+    /* check the cache */
+    if (G_tadsobj_cache->find_kind(sc->id, obj, &result))
+        return result;
+
+    /* 
+     *   Ask the superclass, which will consult the cache for its own
+     *   superclasses in turn.  Tag it, so that the entry is discarded if
+     *   it's deleted and its ID is reused. 
+     */
+    result = sc->objp->is_instance_of(vmg_ obj);
+    sc->objp->get_hdr()->intern_obj_flags |= VMTO_OBJ_SC;
+    G_tadsobj_cache->store_kind(sc->id, obj, result);
+
+    /* return the result */
+    return result;
+}
+
 /*
  *   Determine if I'm an instance of the given object 
  */
 int CVmObjTads::is_instance_of(VMG_ vm_obj_id_t obj)
 {
+    /* 
+     *   We're an instance of 'obj' if any of our superclasses is 'obj' or
+     *   inherits from it.  Check each of our direct superclasses against
+     *   the ofKind cache; this is usually a single probe. 
+     */
+    vm_tadsobj_hdr *hdr = get_hdr();
+    if (hdr->sc_cnt != 0)
+    {
+        for (ushort i = 0 ; i < hdr->sc_cnt ; ++i)
+        {
+            if (sc_is_kind_of(vmg_ &hdr->sc[i], obj))
+                return TRUE;
+        }
+
+        /* 
+         *   None of our superclasses derive from 'obj'.  Each superclass
+         *   has already checked whether 'obj' is the TadsObject metaclass,
+         *   which is our metaclass as well, so the answer is no. 
+         */
+        return FALSE;
+    }
+
     /* 
      *   Set up a superclass search position.  Since the first thing we'll
      *   do is call 'to_next', and since 'to_next' doesn't require a valid
@@ -1442,6 +2273,20 @@ void CVmObjTads::apply_undo(VMG_ CVmUndoRecord *rec)
     /* get my header */
     vm_tadsobj_hdr *hdr = get_hdr();
 
+    /* the old value could refer to any object, so tell the GC */
+    G_obj_table->gc_write_barrier(rec->obj);
+
+    /* if it's a snapshot record, restore the property table from it */
+    if (is_undo_snapshot(rec))
+    {
+        apply_undo_snapshot(vmg_ (const vm_tadsobj_snap *)rec->id.ptrval);
+
+        /* the snapshot has been applied, so we're done with it */
+        t3free(rec->id.ptrval);
+        rec->id.ptrval = 0;
+        return;
+    }
+
     /* 
      *   if the property is valid, it's a simple property change record;
      *   otherwise it's some other object-level change 
@@ -1508,21 +2353,40 @@ void CVmObjTads::apply_undo(VMG_ CVmUndoRecord *rec)
             case 0:
                 /*
                  *   Empty with intval 0 indicates a property addition, which
-                 *   we undo by deleting the property.  First, find it in the
-                 *   hash chain.  
+                 *   we undo by deleting the property.  If we have a shape,
+                 *   the property is necessarily the last one we added, and
+                 *   deleting it takes us back to the parent shape.
+                 *   Otherwise, find it in the hash chain.  
                  */
-                for (prv = &hdr->hash_arr[hash] ;
-                     (cur = *prv) != 0 && cur != entry ;
-                     prv = &cur->nxt) ;
+                if (hdr->shape != 0)
+                {
+                    cur = (entry == &hdr->prop_entry_arr[
+                        hdr->prop_entry_free - 1] ? entry : 0);
+                    prv = 0;
+                }
+                else
+                {
+                    for (prv = &hdr->hash_arr[hash] ;
+                         (cur = *prv) != 0 && cur != entry ;
+                         prv = &cur->nxt) ;
+                }
                 
                 /* make sure we found it */
                 if (cur == entry)
                 {
                     /* unlink it */
-                    *prv = entry->nxt;
+                    if (hdr->shape != 0)
+                        hdr->shape = hdr->shape->parent;
+                    else
+                        *prv = entry->nxt;
+
+                    /* a cached search might have resolved to this entry */
+                    if ((hdr->intern_obj_flags & VMTO_OBJ_SC) != 0)
+                        G_tadsobj_cache->invalidate();
                     
                     /* return it to the free list */
                     hdr->prop_entry_free -= 1;
+                    hdr->prop_list = VM_INVALID_OBJ;
                     assert(entry == &hdr->prop_entry_arr[hdr->prop_entry_free]);
                 }
                 else
@@ -1583,6 +2447,10 @@ void CVmObjTads::mark_refs(VMG_ uint state)
     vm_tadsobj_sc *scp = hdr->sc, *sclast = scp + hdr->sc_cnt;
     for ( ; scp != sclast ; ++scp)
         G_obj_table->mark_all_refs(scp->id, state);
+
+    /* keep our cached property list alive */
+    if (hdr->prop_list != VM_INVALID_OBJ)
+        G_obj_table->mark_all_refs(hdr->prop_list, state);
 }
 
 
@@ -1592,11 +2460,39 @@ void CVmObjTads::mark_refs(VMG_ uint state)
  */
 void CVmObjTads::mark_undo_ref(VMG_ CVmUndoRecord *undo)
 {
+    /* if it's a snapshot, mark the objects its values refer to */
+    if (is_undo_snapshot(undo))
+    {
+        const vm_tadsobj_snap *snap = (const vm_tadsobj_snap *)undo->id.ptrval;
+        const vm_tadsobj_prop *entry = snap->ent;
+        size_t i;
+        for (i = snap->cnt ; i != 0 ; --i, ++entry)
+        {
+            if (entry->val.typ == VM_OBJ || entry->val.typ == VM_OBJX)
+                G_obj_table->mark_all_refs(entry->val.val.obj,
+                                           VMOBJ_REACHABLE);
+        }
+        return;
+    }
+
     /* if the undo record refers to an object, mark the object */
     if (undo->oldval.typ == VM_OBJ || undo->oldval.typ == VM_OBJX)
         G_obj_table->mark_all_refs(undo->oldval.val.obj, VMOBJ_REACHABLE);
 }
 
+/*
+ *   Discard an undo record 
+ */
+void CVmObjTads::discard_undo(VMG_ CVmUndoRecord *rec)
+{
+    /* if it's a snapshot, free the snapshot copy */
+    if (is_undo_snapshot(rec))
+    {
+        t3free(rec->id.ptrval);
+        rec->id.ptrval = 0;
+    }
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Determine if the object has been changed since it was loaded from the
@@ -1622,12 +2518,17 @@ void CVmObjTads::save_to_file(VMG_ CVmFile *fp)
     uint cnt;
     vm_tadsobj_hdr *hdr = get_hdr();
 
-    /* count the number of properties that have actually been modified */
+    /* 
+     *   Count the number of properties that have actually been modified.
+     *   Skip any that have been changed back to their original image file
+     *   values: on restore, we reset to the image file state before
+     *   loading the saved properties, so these will come back on their own.
+     */
     for (cnt = 0, i = hdr->prop_entry_free, entry = hdr->prop_entry_arr ;
          i != 0 ; --i, ++entry)
     {
         /* if the slot is modified, count it */
-        if ((entry->flags & VMTO_PROP_MOD) != 0)
+        if ((entry->flags & VMTO_PROP_MOD) != 0 && !prop_matches_image(entry))
             ++cnt;
     }
 
@@ -1646,7 +2547,7 @@ void CVmObjTads::save_to_file(VMG_ CVmFile *fp)
          i != 0 ; --i, ++entry)
     {
         /* if the slot is modified, write it out */
-        if ((entry->flags & VMTO_PROP_MOD) != 0)
+        if ((entry->flags & VMTO_PROP_MOD) != 0 && !prop_matches_image(entry))
         {
             char slot[16];
 
@@ -1660,6 +2561,78 @@ void CVmObjTads::save_to_file(VMG_ CVmFile *fp)
     }
 }
 
+/*
+ *   Determine if a property entry has the same value as in the image file 
+ */
+int CVmObjTads::prop_matches_image(const vm_tadsobj_prop *entry) const
+{
+    const char *p = get_hdr()->image_data;
+    ushort sc_cnt, li_cnt;
+
+    /* if we didn't come from the image file, there's nothing to match */
+    if (p == 0)
+        return FALSE;
+
+    /* skip the header and superclass list to get to the properties */
+    sc_cnt = osrp2(p);
+    li_cnt = osrp2(p + 2);
+    p += 6 + 4*sc_cnt;
+
+    /* look for the property */
+    for ( ; li_cnt != 0 ; --li_cnt, p += 2 + VMB_DATAHOLDER)
+    {
+        if ((vm_prop_id_t)osrp2(p) == entry->prop)
+        {
+            vm_val_t val;
+
+            /* decode the image value */
+            vmb_get_dh(p + 2, &val);
+
+            /* compare the value bit for bit */
+            if (val.typ != entry->val.typ)
+                return FALSE;
+            switch (val.typ)
+            {
+            case VM_NIL:
+            case VM_TRUE:
+                return TRUE;
+
+            case VM_OBJ:
+            case VM_OBJX:
+                return val.val.obj == entry->val.val.obj;
+
+            case VM_PROP:
+                return val.val.prop == entry->val.val.prop;
+
+            case VM_INT:
+                return val.val.intval == entry->val.val.intval;
+
+            case VM_ENUM:
+                return val.val.enumval == entry->val.val.enumval;
+
+            case VM_SSTRING:
+            case VM_DSTRING:
+            case VM_LIST:
+            case VM_CODEOFS:
+            case VM_FUNCPTR:
+                return val.val.ofs == entry->val.val.ofs;
+
+            case VM_BIFPTR:
+            case VM_BIFPTRX:
+                return (val.val.bifptr.set_idx == entry->val.val.bifptr.set_idx
+                        && (val.val.bifptr.func_idx
+                            == entry->val.val.bifptr.func_idx));
+
+            default:
+                return FALSE;
+            }
+        }
+    }
+
+    /* the property isn't in the image data */
+    return FALSE;
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Restore the object from a file 
@@ -1667,6 +2640,9 @@ void CVmObjTads::save_to_file(VMG_ CVmFile *fp)
 void CVmObjTads::restore_from_file(VMG_ vm_obj_id_t self,
                                    CVmFile *fp, CVmObjFixup *fixups)
 {
+    /* we're about to replace our properties, so tell the GC */
+    G_obj_table->gc_write_barrier(self);
+
     /* read number of modified properties */
     ushort mod_count = (ushort)fp->read_uint2();
 
@@ -1734,6 +2710,13 @@ void CVmObjTads::restore_from_file(VMG_ vm_obj_id_t self,
      */
     hdr->inval_inh_path();
 
+    /* restoring can change anything, so drop the call-site cache */
+    G_tadsobj_cache->invalidate();
+    G_tadsobj_cache->invalidate_kind();
+
+    /* likewise the instance lists */
+    G_tadsobj_insts->invalidate();
+
     /* read the modified properties */
     for (ushort i = 0 ; i < mod_count ; ++i)
     {
@@ -1782,6 +2765,13 @@ void CVmObjTads::post_load_init(VMG_ vm_obj_id_t self)
     /* cache the superclass object pointers */
     for (int i = 0 ; i < hdr->sc_cnt ; ++i)
         hdr->sc[i].objp = (CVmObjTads *)vm_objp(vmg_ hdr->sc[i].id);
+
+    /* our superclass list is new, so drop the call-site cache */
+    G_tadsobj_cache->invalidate();
+    G_tadsobj_cache->invalidate_kind();
+
+    /* the instance lists might not include us */
+    G_tadsobj_insts->invalidate();
 }
 
 /* ------------------------------------------------------------------------ */
@@ -1807,13 +2797,41 @@ void CVmObjTads::load_from_image(VMG_ vm_obj_id_t self,
     /* get the number of load image properties */
     ushort li_cnt = osrp2(ptr + 2);
 
+    /* 
+     *   Find the shape for the image properties, in the order we'll add
+     *   them.  If the shape table won't take them, use a hash table.  
+     */
+    int shaped = TRUE;
+    vm_tadsobj_shape *shape = G_tadsobj_shapes->get_root();
+    const char *p = ptr + 6 + sc_cnt*4;
+    for (ushort i = 0 ; i < li_cnt ; ++i, p += 2 + VMB_DATAHOLDER)
+    {
+        vm_prop_id_t prop = (vm_prop_id_t)osrp2(p);
+        if (!G_tadsobj_shapes->can_add(shape, prop))
+        {
+            shaped = FALSE;
+            break;
+        }
+        shape = G_tadsobj_shapes->add(shape, prop);
+    }
+
     /* allocate our header */
-    ext_ = (char *)vm_tadsobj_hdr::alloc(vmg_ this, sc_cnt, li_cnt);
+    ext_ = (char *)vm_tadsobj_hdr::alloc(vmg_ this, sc_cnt, li_cnt, shaped);
     vm_tadsobj_hdr *hdr = get_hdr();
 
+    /* a new header has no cache tags, so drop the call-site cache */
+    G_tadsobj_cache->invalidate();
+    G_tadsobj_cache->invalidate_kind();
+
+    /* we're a new object as far as the instance lists are concerned */
+    G_tadsobj_insts->invalidate();
+
     /* read the object flags from the image file and store them */
     hdr->li_obj_flags = osrp2(ptr + 4);
 
+    /* remember the image data, for finding original property values */
+    hdr->image_data = ptr;
+
     /* 
      *   set our internal flags - we come from the load image file, and we're
      *   not yet modified from the load image data
@@ -1838,6 +2856,16 @@ void CVmObjTads::reload_from_image(VMG_ vm_obj_id_t self,
     /* get my header */
     vm_tadsobj_hdr *hdr = get_hdr();
 
+    /* 
+     *   If we haven't been modified since loading, we're already in our
+     *   image file state, so there's nothing to do.  Every change to our
+     *   properties or superclasses sets the 'modified' flag, and undoing
+     *   back to the unmodified state clears it along with the changes.
+     *   This saves rebuilding every image object on each restore.  
+     */
+    if ((hdr->intern_obj_flags & VMTO_OBJ_MOD) == 0)
+        return;
+
     /* get the number of superclasses */
     ushort sc_cnt = osrp2(ptr);
 
@@ -1849,7 +2877,18 @@ void CVmObjTads::reload_from_image(VMG_ vm_obj_id_t self,
      *   out the hash table.  
      */
     hdr->prop_entry_free = 0;
-    memset(hdr->hash_arr, 0, hdr->hash_siz * sizeof(hdr->hash_arr[0]));
+    hdr->prop_list = VM_INVALID_OBJ;
+    if (hdr->shape != 0)
+        hdr->shape = G_tadsobj_shapes->get_root();
+    else
+        memset(hdr->hash_arr, 0, hdr->hash_siz * sizeof(hdr->hash_arr[0]));
+
+    /* we're discarding properties, so drop the call-site cache */
+    G_tadsobj_cache->invalidate();
+    G_tadsobj_cache->invalidate_kind();
+
+    /* our references are changing, so have the GC trace us again */
+    G_obj_table->gc_write_barrier(self);
 
     /* if we need space for more superclasses, reallocate the header */
     if (sc_cnt > hdr->sc_cnt)
@@ -1909,7 +2948,7 @@ void CVmObjTads::load_image_props_and_scs(VMG_ const char *ptr, size_t siz)
         vmb_get_dh(p + 2, &val);
 
         /* store the property */
-        hdr->alloc_prop_entry(prop, &val, 0);
+        hdr->alloc_prop_entry(vmg_ prop, &val, 0);
     }
 }
 
@@ -1997,6 +3036,9 @@ int CVmObjTads::getp_create_clone(VMG_ vm_obj_id_t self,
     for (i = 0 ; i < get_sc_count() ; ++i)
         tobj->set_sc(vmg_ i, get_sc(i));
 
+    /* add it to the instance lists of its classes */
+    G_tadsobj_insts->note_new(new_obj);
+
     /* copy my properties to the new object */
     for (i = hdr->prop_entry_free, entry = hdr->prop_entry_arr ;
          i != 0 ; --i, ++entry)
@@ -2073,8 +3115,12 @@ struct set_sc_cb_ctx
 
 void CVmObjTads::set_sc_cb(VMG_ vm_obj_id_t obj, void *ctx0)
 {
-    /* if this is a TadsObject instance, update it */
-    if (CVmObjTads::is_tadsobj_obj(vmg_ obj))
+    /* 
+     *   if this is a TadsObject instance, update it (a lazy image object
+     *   hasn't been created yet, so it can't have a cached path) 
+     */
+    if (!G_obj_table->is_obj_lazy(obj)
+        && CVmObjTads::is_tadsobj_obj(vmg_ obj))
     {
         /* cast the context to our private structure */
         set_sc_cb_ctx *ctx = (set_sc_cb_ctx *)ctx0;
@@ -2208,6 +3254,9 @@ int CVmObjTads::getp_set_sc_list(VMG_ vm_obj_id_t self,
     /* update the superclass list with the given list */
     change_superclass_list(vmg_ lst, sc_cnt);
 
+    /* the new superclasses might not be in the root set, so tell the GC */
+    G_obj_table->gc_write_barrier(self);
+
     /* discard arguments */
     G_stk->discard();
 
@@ -2267,6 +3316,13 @@ void CVmObjTads::change_superclass_list(VMG_ const vm_val_t *lst, int cnt)
 
     /* invalidate the cached inheritance path */
     hdr->inval_inh_path();
+
+    /* the inheritance graph changed, so drop all call-site cache entries */
+    G_tadsobj_cache->invalidate();
+    G_tadsobj_cache->invalidate_kind();
+
+    /* the instance lists of our old and new superclasses are out of date */
+    G_tadsobj_insts->invalidate();
 }
 
 /* ------------------------------------------------------------------------ */
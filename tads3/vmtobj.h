@@ -81,10 +81,14 @@ struct vm_tadsobj_sc
  */
 struct vm_tadsobj_hdr
 {
-    /* allocate */
+    /* 
+     *   allocate; if 'shaped' is true, the object starts out with the empty
+     *   shape and no hash table of its own 
+     */
     static vm_tadsobj_hdr *alloc(VMG_ class CVmObjTads *self,
                                  unsigned short sc_cnt,
-                                 unsigned short prop_cnt);
+                                 unsigned short prop_cnt,
+                                 int shaped = TRUE);
 
     /* delete */
     void free_mem();
@@ -95,11 +99,17 @@ struct vm_tadsobj_hdr
 
     /* 
      *   reallocate an existing object to expand its property table to the
-     *   given minimum number of property entries 
+     *   given minimum number of property entries; if 'to_hash' is true, the
+     *   new object leaves its shape and gets a hash table of its own 
      */
     static vm_tadsobj_hdr *expand_to(VMG_ class CVmObjTads *self,
                                      vm_tadsobj_hdr *obj,
-                                     size_t new_sc_cnt, size_t min_prop_cnt);
+                                     size_t new_sc_cnt, size_t min_prop_cnt,
+                                     int to_hash = FALSE);
+
+    /* fix up our internal pointers after the heap copies us to a new block */
+    static void relocate(const vm_tadsobj_hdr *old_hdr,
+                         vm_tadsobj_hdr *new_hdr);
 
     /* invalidate the cached inheritance path, if any */
     void inval_inh_path()
@@ -117,7 +127,7 @@ struct vm_tadsobj_hdr
     struct vm_tadsobj_prop *find_prop_entry(uint prop);
 
     /* allocate a new hash entry */
-    vm_tadsobj_prop *alloc_prop_entry(vm_prop_id_t prop,
+    vm_tadsobj_prop *alloc_prop_entry(VMG_ vm_prop_id_t prop,
                                       const vm_val_t *val,
                                       unsigned int flags);
 
@@ -145,18 +155,35 @@ struct vm_tadsobj_hdr
      */
     struct tadsobj_objid_and_ptr *inh_path;
 
+    /* 
+     *   The object's load image data, if it came from the image file, or
+     *   null for a dynamically created object.  We use this when saving to
+     *   find the original values of modified properties.  
+     */
+    const char *image_data;
+
     /* load image object flags (a combination of VMTOBJ_OBJF_xxx values) */
     unsigned short li_obj_flags;
 
     /* internal object flags (a combination of VMTO_OBJ_xxx values) */
     unsigned short intern_obj_flags;
 
+    /*
+     *   The object's shape, if it has one (see vm_tadsobj_shape).  A shaped
+     *   object's property entries hold exactly the shape's properties, in
+     *   slot order, and we find properties through the shape's index; the
+     *   object has no hash buckets, and the entries' hash chain pointers
+     *   are unused.  If this is null, we use our own hash table.  
+     */
+    struct vm_tadsobj_shape *shape;
+
     /* 
      *   Number of hash buckets, and a pointer to the bucket array.  (The
      *   hash bucket array is allocated as part of the same memory block as
      *   this structure - we suballocate it from the memory block when
      *   allocating the structure.)  'hash_arr[hash]' points to the head of
-     *   a list of property entries with the given hash value.
+     *   a list of property entries with the given hash value.  A shaped
+     *   object has no buckets, so 'hash_arr' is null.
      */
     unsigned short hash_siz;
     struct vm_tadsobj_prop **hash_arr;
@@ -189,6 +216,22 @@ struct vm_tadsobj_hdr
      *   the hash table size.  
      */
     unsigned short prop_entry_free;
+
+    /* 
+     *   Number of property undo records we've saved since the last
+     *   savepoint.  Once this gets large enough, we switch to saving a
+     *   snapshot of the whole property table instead (see
+     *   VMTOBJ_UNDO_SNAP_MIN).  
+     */
+    unsigned short undo_cnt;
+
+    /*
+     *   Cached result of getPropList(), or VM_INVALID_OBJ if we haven't
+     *   built one since the property table last gained or lost entries.
+     *   The list is immutable, so we can hand the same object back to
+     *   every caller; we hold a strong reference to it (see mark_refs).  
+     */
+    vm_obj_id_t prop_list;
     
     /* 
      *   Number of superclasses, and the array of superclasses.  We
@@ -202,21 +245,28 @@ struct vm_tadsobj_hdr
 
 /*
  *   Tads-object property entry.  Each hash table entry points to a linked
- *   list of these entries.  
+ *   list of these entries.
+ *   
+ *   The members are ordered widest first so that the small property ID and
+ *   flags share the tail padding of the value, rather than each being
+ *   padded out to pointer alignment on its own.  On 64-bit hosts this
+ *   takes an entry from 40 bytes to 32, which matters because property
+ *   tables are the bulk of a running game's heap and are scanned on every
+ *   GC pass.  
  */
 struct vm_tadsobj_prop
 {
-    /* my property ID */
-    vm_prop_id_t prop;
-
     /* pointer to the next entry at the same hash value */
     vm_tadsobj_prop *nxt;
 
-    /* flags */
-    unsigned char flags;
-
     /* my value */
     vm_val_t val;
+
+    /* my property ID */
+    vm_prop_id_t prop;
+
+    /* flags */
+    unsigned char flags;
 };
 
 
@@ -230,6 +280,27 @@ struct vm_tadsobj_prop
 /* modified - object has been modified since being loaded from image */
 #define VMTO_OBJ_MOD     0x0002
 
+/* 
+ *   cached - the object was visited on a superclass search whose result is
+ *   in the call-site property cache, so adding or removing properties
+ *   must invalidate the cache 
+ */
+#define VMTO_OBJ_SC      0x0004
+
+/* 
+ *   cache key - the object's ID is used as a key in the inheritance cache,
+ *   so deleting the object (and thus freeing the ID for reuse) must
+ *   invalidate the cache 
+ */
+#define VMTO_OBJ_KEY     0x0008
+
+/* 
+ *   snapshot - we've saved a snapshot of the property table as undo for
+ *   the current savepoint, so further changes to properties don't need
+ *   their own undo records until the next savepoint 
+ */
+#define VMTO_OBJ_SNAP    0x0010
+
 
 /*
  *   Property entry flags 
@@ -241,6 +312,32 @@ struct vm_tadsobj_prop
 /* we've stored undo for this property since the last savepoint */
 #define VMTO_PROP_UNDO    0x02
 
+/*
+ *   Undo snapshot threshold.  Normally we save one undo record for each
+ *   property changed in a savepoint.  An object that's being heavily
+ *   modified - a daemon's scratch object, say - can generate a lot of these
+ *   per turn, so once an object has saved at least this many property
+ *   records in one savepoint, and they cover at least a quarter of its
+ *   properties, we instead save a single snapshot of its property table
+ *   and stop recording individual changes until the next savepoint. 
+ */
+#define VMTOBJ_UNDO_SNAP_MIN  8
+
+/*
+ *   Undo snapshot.  This is a copy of the property entries in use at the
+ *   time of the snapshot.  We save this in a pointer-keyed undo record,
+ *   whose value is 'empty' with intval 2 to distinguish it from ordinary
+ *   property records.  
+ */
+struct vm_tadsobj_snap
+{
+    /* number of entries in use */
+    unsigned short cnt;
+
+    /* the entries (overallocated to the actual count) */
+    vm_tadsobj_prop ent[1];
+};
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Load Image Object Flag Values - these values are stored in the image
@@ -312,6 +409,9 @@ public:
 
     /* notify of deletion */
     void notify_delete(VMG_ int in_root_set);
+    /* report our memory use */
+    size_t get_mem_usage(VMG_ int) const
+        { return get_ext_heap_bytes(vmg0_); }
 
     /* create an instance of this object */
     void create_instance(VMG_ vm_obj_id_t self,
@@ -398,6 +498,17 @@ public:
     int get_prop(VMG_ vm_prop_id_t prop, vm_val_t *val,
                  vm_obj_id_t self, vm_obj_id_t *source_obj, uint *argc);
 
+    /* 
+     *   Get a property on behalf of a GETPROP/CALLPROP-style instruction at
+     *   the given code address.  This is equivalent to get_prop(), but uses
+     *   the call-site cache to skip the superclass search when this site
+     *   has already resolved the property for an object with the same
+     *   superclass.  
+     */
+    int get_prop_at_site(VMG_ const uchar *site, vm_prop_id_t prop,
+                         vm_val_t *val, vm_obj_id_t self,
+                         vm_obj_id_t *source_obj, uint *argc);
+
     /* inherit a property */
     int inh_prop(VMG_ vm_prop_id_t prop, vm_val_t *val,
                  vm_obj_id_t self,
@@ -427,6 +538,9 @@ public:
     /* mark a reference in an undo record */
     void mark_undo_ref(VMG_ struct CVmUndoRecord *undo);
 
+    /* discard an undo record */
+    void discard_undo(VMG_ struct CVmUndoRecord *rec);
+
     /* 
      *   remove stale weak references from an undo record -- we keep only
      *   normal strong references, so we don't need to do anything here 
@@ -455,6 +569,19 @@ public:
     /* determine if the object has been changed since it was loaded */
     int is_changed_since_load() const;
 
+    /* 
+     *   we notify the object table whenever we might acquire a reference
+     *   to a non-root-set object, so the GC can skip tracing us otherwise 
+     */
+    int has_gc_write_barrier() const { return TRUE; }
+
+    /* 
+     *   our whole variable part is one heap block, so the heap can move it
+     *   when compacting, as long as we fix up our internal pointers 
+     */
+    int can_relocate_ext() const { return TRUE; }
+    void relocate_ext(VMG_ char *new_ext);
+
     /* save to a file */
     void save_to_file(VMG_ class CVmFile *fp);
 
@@ -499,6 +626,10 @@ protected:
      */
     CVmObjTads(VMG_ ushort superclass_count, ushort prop_count);
 
+    /* determine if a superclass is or inherits from the given object */
+    static int sc_is_kind_of(VMG_ const vm_tadsobj_sc *sc,
+                             vm_obj_id_t obj);
+
     /* internal handler to create from stack arguments */
     static vm_obj_id_t create_from_stack_intern(VMG_ const uchar **pc_ptr,
                                                 uint argc, int is_transient);
@@ -574,6 +705,21 @@ protected:
     /* clear all undo flags */
     void clear_undo_flags();
 
+    /* 
+     *   determine if a modified property entry has the same value it had
+     *   in the load image 
+     */
+    int prop_matches_image(const vm_tadsobj_prop *entry) const;
+
+    /* save an undo snapshot of the property table */
+    void save_undo_snapshot(VMG_ class CVmUndo *undo, vm_obj_id_t self);
+
+    /* restore the property table from an undo snapshot */
+    void apply_undo_snapshot(VMG_ const vm_tadsobj_snap *snap);
+
+    /* is the given undo record a snapshot record? */
+    static int is_undo_snapshot(const struct CVmUndoRecord *rec);
+
 
     /* -------------------------------------------------------------------- */
     /*
@@ -651,6 +797,13 @@ public:
         new (vmg_ id) CVmObjTads();
         G_obj_table->set_obj_gc_characteristics(id, TRUE, FALSE);
     }
+
+    /* 
+     *   we can be loaded lazily: an image file object only refers to other
+     *   root-set objects, and the superclass pointers and image pointer
+     *   that loading sets up aren't needed until the object is used 
+     */
+    int can_load_lazily() const { return TRUE; }
     
     /* create from restoring from saved state */
     void create_for_restore(VMG_ vm_obj_id_t id)
@@ -1073,6 +1226,575 @@ protected:
     pfq_page *alloc_;
 };
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Call-site property cache.  Each GETPROP/CALLPROP-style instruction
+ *   tends to see objects of only one or two classes, so we remember, per
+ *   call site, which object along the superclass chain defined the property
+ *   the last time we evaluated it.  An entry is keyed on the instruction
+ *   address, the target's sole superclass, and the property ID; it applies
+ *   to any target with that single superclass that doesn't define the
+ *   property directly.
+ *   
+ *   
+ *   Alongside the call-site table we keep a VM-wide inheritance table,
+ *   keyed on (object, property), recording which superclass of the object
+ *   (if any) defines the property.  This serves get_prop() and inh_prop()
+ *   lookups that don't come from a call site, and lets call-site misses
+ *   skip most of the chain walk.
+ *   
+ *   We don't try to track exactly which entries depend on which objects.
+ *   Instead, every entry carries the generation number in effect when it
+ *   was stored, and any change that could alter an inheritance search
+ *   result (a property added to or removed from an object tagged with
+ *   VMTO_OBJ_SC, a superclass list change, an object load or restore)
+ *   simply bumps the generation, which discards everything at once.  These
+ *   events are rare compared to property lookups.  
+ *   
+ *   Finally, we keep an ofKind table, keyed on (class, target), recording
+ *   whether the class is or inherits from the target.  ofKind() on an
+ *   object with superclasses looks up each superclass here, which turns
+ *   the usual test into a single probe instead of a walk up the whole
+ *   inheritance graph.  Only the shape of the class graph matters for
+ *   these entries, not property values, so they have a generation number
+ *   of their own that's bumped only by superclass changes, loads,
+ *   restores, and the deletion of a class we've cached.  
+ */
+
+/* number of rows in the cache table (must be a power of 2) */
+const size_t VMTOBJ_IC_ROWS = 1024;
+
+/* number of entries per row */
+const size_t VMTOBJ_IC_WAYS = 2;
+
+/* number of entries in the inheritance cache (must be a power of 2) */
+const size_t VMTOBJ_INH_CACHE_SIZE = 4096;
+
+/* number of entries in the ofKind cache (must be a power of 2) */
+const size_t VMTOBJ_KIND_CACHE_SIZE = 2048;
+
+/* call-site cache entry */
+struct vm_tadsobj_ic_entry
+{
+    /* call site (instruction address) */
+    const uchar *site;
+
+    /* the target object's superclass */
+    vm_obj_id_t sc;
+
+    /* the property */
+    vm_prop_id_t prop;
+
+    /* the object that defines the property */
+    vm_obj_id_t source;
+
+    /* cache generation when the entry was stored */
+    unsigned long gen;
+};
+
+/* 
+ *   inheritance cache entry - this records the result of searching the
+ *   superclasses of 'obj' (not including 'obj' itself) for 'prop' 
+ */
+struct vm_tadsobj_inh_entry
+{
+    /* the object whose superclasses were searched */
+    vm_obj_id_t obj;
+
+    /* the property */
+    vm_prop_id_t prop;
+
+    /* the defining object, or VM_INVALID_OBJ if no superclass defines it */
+    vm_obj_id_t source;
+
+    /* cache generation when the entry was stored */
+    unsigned long gen;
+};
+
+/* 
+ *   ofKind cache entry - this records whether 'cls' is 'target' or
+ *   inherits from it 
+ */
+struct vm_tadsobj_kind_entry
+{
+    /* the class */
+    vm_obj_id_t cls;
+
+    /* the possible ancestor */
+    vm_obj_id_t target;
+
+    /* true if 'cls' is or derives from 'target' */
+    int result;
+
+    /* ofKind generation when the entry was stored */
+    unsigned long gen;
+};
+
+/* ofKind cache statistics */
+struct vm_tadsobj_kind_stats
+{
+    unsigned long hits;
+    unsigned long misses;
+};
+
+class CVmObjTadsPropCache
+{
+public:
+    CVmObjTadsPropCache()
+    {
+        /* start at generation 1, so that zeroed entries are never valid */
+        memset(ic_, 0, sizeof(ic_));
+        memset(inh_, 0, sizeof(inh_));
+        memset(kind_, 0, sizeof(kind_));
+        gen_ = 1;
+        kind_gen_ = 1;
+        kind_stats_.hits = kind_stats_.misses = 0;
+    }
+
+    /* initialize */
+    void init() { }
+
+    /* invalidate all cached entries */
+    void invalidate()
+    {
+        /* 
+         *   bump the generation; on the (unlikely) wraparound, clear the
+         *   table so that ancient entries can't come back to life 
+         */
+        if (++gen_ == 0)
+        {
+            memset(ic_, 0, sizeof(ic_));
+            memset(inh_, 0, sizeof(inh_));
+            gen_ = 1;
+        }
+    }
+
+    /* invalidate the ofKind entries */
+    void invalidate_kind()
+    {
+        if (++kind_gen_ == 0)
+        {
+            memset(kind_, 0, sizeof(kind_));
+            kind_gen_ = 1;
+        }
+    }
+
+    /* 
+     *   Look up whether 'cls' is or inherits from 'target'.  Returns true
+     *   if we have a valid entry, in which case we fill in *result. 
+     */
+    int find_kind(vm_obj_id_t cls, vm_obj_id_t target, int *result)
+    {
+        const vm_tadsobj_kind_entry *e = &kind_[kind_idx(cls, target)];
+        if (e->cls == cls && e->target == target && e->gen == kind_gen_)
+        {
+            ++kind_stats_.hits;
+            *result = e->result;
+            return TRUE;
+        }
+
+        /* not found */
+        ++kind_stats_.misses;
+        return FALSE;
+    }
+
+    /* store an ofKind result */
+    void store_kind(vm_obj_id_t cls, vm_obj_id_t target, int result)
+    {
+        vm_tadsobj_kind_entry *e = &kind_[kind_idx(cls, target)];
+        e->cls = cls;
+        e->target = target;
+        e->result = result;
+        e->gen = kind_gen_;
+    }
+
+    /* get the ofKind statistics */
+    const vm_tadsobj_kind_stats *get_kind_stats() const
+        { return &kind_stats_; }
+
+    /* 
+     *   look up a property at a call site for a target with the given
+     *   superclass; returns the defining object, or VM_INVALID_OBJ if we
+     *   don't have a valid entry 
+     */
+    vm_obj_id_t find(const uchar *site, vm_obj_id_t sc, vm_prop_id_t prop)
+    {
+        vm_tadsobj_ic_entry *e = ic_[row(site, prop)];
+        for (size_t i = 0 ; i < VMTOBJ_IC_WAYS ; ++i, ++e)
+        {
+            if (e->site == site && e->sc == sc && e->prop == prop
+                && e->gen == gen_)
+                return e->source;
+        }
+
+        /* not found */
+        return VM_INVALID_OBJ;
+    }
+
+    /* store a resolved lookup */
+    void store(const uchar *site, vm_obj_id_t sc, vm_prop_id_t prop,
+               vm_obj_id_t source)
+    {
+        /* 
+         *   move the older entry down and put the new one in front, so the
+         *   most recently stored entry is always checked first 
+         */
+        vm_tadsobj_ic_entry *e = ic_[row(site, prop)];
+        for (size_t i = VMTOBJ_IC_WAYS - 1 ; i != 0 ; --i)
+            e[i] = e[i-1];
+
+        e->site = site;
+        e->sc = sc;
+        e->prop = prop;
+        e->source = source;
+        e->gen = gen_;
+    }
+
+    /* 
+     *   Look up the inherited definition of a property for an object.
+     *   Returns true if we have a valid entry, in which case we fill in
+     *   *source with the defining superclass (VM_INVALID_OBJ if the entry
+     *   records that no superclass defines the property).  
+     */
+    int find_inh(vm_obj_id_t obj, vm_prop_id_t prop, vm_obj_id_t *source)
+    {
+        const vm_tadsobj_inh_entry *e = &inh_[inh_idx(obj, prop)];
+        if (e->obj == obj && e->prop == prop && e->gen == gen_)
+        {
+            *source = e->source;
+            return TRUE;
+        }
+
+        /* not found */
+        return FALSE;
+    }
+
+    /* store an inherited definition */
+    void store_inh(vm_obj_id_t obj, vm_prop_id_t prop, vm_obj_id_t source)
+    {
+        vm_tadsobj_inh_entry *e = &inh_[inh_idx(obj, prop)];
+        e->obj = obj;
+        e->prop = prop;
+        e->source = source;
+        e->gen = gen_;
+    }
+
+protected:
+    /* figure the ofKind cache index for a class and target */
+    static size_t kind_idx(vm_obj_id_t cls, vm_obj_id_t target)
+    {
+        return (((size_t)cls * 13) ^ ((size_t)target * 31))
+            & (VMTOBJ_KIND_CACHE_SIZE - 1);
+    }
+
+    /* figure the inheritance cache index for an object and property */
+    static size_t inh_idx(vm_obj_id_t obj, vm_prop_id_t prop)
+    {
+        return (((size_t)obj * 7) ^ ((size_t)prop * 31))
+            & (VMTOBJ_INH_CACHE_SIZE - 1);
+    }
+
+    /* figure the row for a call site and property */
+    static size_t row(const uchar *site, vm_prop_id_t prop)
+    {
+        size_t h = (size_t)site;
+        return ((h ^ (h >> 10) ^ ((size_t)prop * 31)) & (VMTOBJ_IC_ROWS - 1));
+    }
+
+    /* the call-site cache table */
+    vm_tadsobj_ic_entry ic_[VMTOBJ_IC_ROWS][VMTOBJ_IC_WAYS];
+
+    /* the inheritance cache table */
+    vm_tadsobj_inh_entry inh_[VMTOBJ_INH_CACHE_SIZE];
+
+    /* the ofKind cache table */
+    vm_tadsobj_kind_entry kind_[VMTOBJ_KIND_CACHE_SIZE];
+
+    /* current generation */
+    unsigned long gen_;
+
+    /* current ofKind generation */
+    unsigned long kind_gen_;
+
+    /* ofKind statistics */
+    vm_tadsobj_kind_stats kind_stats_;
+};
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Per-class instance index.  firstObj() and nextObj() with a class
+ *   filter have to find the objects that inherit from the class, which
+ *   otherwise means testing every object in the object table.  Loops that
+ *   enumerate the same class again and again (forEachInstance() in the
+ *   library, for example) pay for the full table scan each time.
+ *   
+ *   For a TadsObject class, we build a sorted list of the IDs of all of
+ *   its instances and subclasses with one scan, and keep it for later
+ *   enumerations of the same class.  A list is always a superset of the
+ *   class's current instances: objects deleted since the list was built
+ *   stay in it until the next rebuild, so callers must still check each
+ *   candidate.  Objects created since then are recorded in a pending list
+ *   and merged into the class lists the next time a list is requested.
+ *   Anything that could change which classes an existing object inherits
+ *   from (a superclass list change, an object load or restore) simply
+ *   discards all of the lists.  
+ */
+
+/* number of classes we keep lists for */
+const size_t VMTOBJ_INST_IDX_SLOTS = 16;
+
+/* maximum number of new objects we queue up before discarding the lists */
+const size_t VMTOBJ_INST_IDX_PENDING = 512;
+
+/* instance list for one class */
+struct vm_tadsobj_inst_list
+{
+    /* the class, or VM_INVALID_OBJ if the slot is unused */
+    vm_obj_id_t cls;
+
+    /* the IDs of the instances and subclasses, in ascending order */
+    vm_obj_id_t *ids;
+    size_t cnt;
+    size_t alloc;
+
+    /* last use sequence number, for choosing a slot to replace */
+    unsigned long last_use;
+};
+
+class CVmObjTadsInstIndex
+{
+public:
+    CVmObjTadsInstIndex()
+    {
+        memset(lists_, 0, sizeof(lists_));
+        for (size_t i = 0 ; i < VMTOBJ_INST_IDX_SLOTS ; ++i)
+            lists_[i].cls = VM_INVALID_OBJ;
+        pending_cnt_ = 0;
+        list_cnt_ = 0;
+        use_seq_ = 0;
+    }
+
+    ~CVmObjTadsInstIndex() { invalidate(); }
+
+    /* initialize */
+    void init() { }
+
+    /* discard all of the lists */
+    void invalidate();
+
+    /* 
+     *   Note a newly created object.  Call this once the object's
+     *   superclasses have been set. 
+     */
+    void note_new(vm_obj_id_t obj)
+    {
+        /* if we don't have any lists, there's nothing to update */
+        if (list_cnt_ == 0)
+            return;
+
+        /* queue it, or start over if too many objects are waiting */
+        if (pending_cnt_ < VMTOBJ_INST_IDX_PENDING)
+            pending_[pending_cnt_++] = obj;
+        else
+            invalidate();
+    }
+
+    /* 
+     *   Get the candidate list for a class, building it if necessary.
+     *   Fills in *cnt with the number of IDs in the list.  
+     */
+    const vm_obj_id_t *get_list(VMG_ vm_obj_id_t cls, size_t *cnt);
+
+protected:
+    /* merge the pending new objects into the lists */
+    void merge_pending(VMG0_);
+
+    /* add an object to a list, keeping the list in order */
+    static void insert(vm_tadsobj_inst_list *l, vm_obj_id_t obj);
+
+    /* the class lists */
+    vm_tadsobj_inst_list lists_[VMTOBJ_INST_IDX_SLOTS];
+
+    /* number of slots in use */
+    size_t list_cnt_;
+
+    /* objects created since the lists were last updated */
+    vm_obj_id_t pending_[VMTOBJ_INST_IDX_PENDING];
+    size_t pending_cnt_;
+
+    /* use sequence counter */
+    unsigned long use_seq_;
+};
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Property table shapes.  Objects created the same way - instances of a
+ *   class whose constructor sets the same properties in the same order,
+ *   say - end up with the same properties in the same property table
+ *   slots.  Rather than giving each of them a hash table, we let them
+ *   share a "shape", which records which property is in which slot.  A
+ *   shaped object's property table is then just a dense array of values,
+ *   and a lookup is a probe of the shared index.
+ *   
+ *   Shapes form a tree.  The root is the empty shape, and each other shape
+ *   is its parent plus one more property in the next slot.  Adding a
+ *   property to a shaped object moves it to the child shape for that
+ *   property, so objects that add the same properties in the same order
+ *   follow the same path through the tree.  Removing the last property
+ *   (which undo does) moves it back to the parent.
+ *   
+ *   Shapes are never freed before the VM terminates, so objects can keep
+ *   plain pointers to them.  To keep the tree from growing without bound,
+ *   we won't create shapes with more than VMTOBJ_SHAPE_MAX_PROPS
+ *   properties, or once the shapes use VMTOBJ_SHAPE_MAX_MEM bytes.  An
+ *   object that can't move to a new shape leaves the tree and gets its own
+ *   hash table, which it keeps from then on.  
+ */
+
+/* maximum number of properties in a shape */
+const size_t VMTOBJ_SHAPE_MAX_PROPS = 64;
+
+/* memory we'll devote to shapes */
+const size_t VMTOBJ_SHAPE_MAX_MEM = 1024*1024;
+
+/* number of buckets in the transition table (must be a power of 2) */
+const size_t VMTOBJ_SHAPE_HASH_SIZE = 1024;
+
+/* shape index entry */
+struct vm_tadsobj_shape_idx
+{
+    /* the property, or VM_INVALID_PROP for an empty entry */
+    vm_prop_id_t prop;
+
+    /* the property's slot */
+    unsigned short slot;
+};
+
+struct vm_tadsobj_shape
+{
+    /* the parent shape, or null for the empty shape */
+    vm_tadsobj_shape *parent;
+
+    /* the property this shape adds to its parent, in slot cnt-1 */
+    vm_prop_id_t prop;
+
+    /* number of properties */
+    unsigned short cnt;
+
+    /* next shape in the transition table chain */
+    vm_tadsobj_shape *nxt;
+
+    /* 
+     *   Index from property ID to slot, as an open hash table with idx_siz
+     *   entries (a power of 2).  Many shapes are only passed through on the
+     *   way to a larger one, so we build this on the first lookup.  
+     */
+    unsigned short idx_siz;
+    vm_tadsobj_shape_idx *idx;
+
+    /* find the slot holding a property; returns -1 if it's not here */
+    int find(vm_prop_id_t p)
+    {
+        /* build the index if we haven't already */
+        if (idx == 0)
+            build_index();
+
+        /* probe the index */
+        size_t mask = idx_siz - 1;
+        for (size_t h = p & mask ; ; h = (h + 1) & mask)
+        {
+            if (idx[h].prop == p)
+                return idx[h].slot;
+            if (idx[h].prop == VM_INVALID_PROP)
+                return -1;
+        }
+    }
+
+    /* build the index */
+    void build_index();
+};
+
+class CVmObjTadsShapeTable
+{
+public:
+    CVmObjTadsShapeTable()
+    {
+        memset(hash_, 0, sizeof(hash_));
+        memset(&root_, 0, sizeof(root_));
+        mem_used_ = 0;
+    }
+
+    ~CVmObjTadsShapeTable() { clear(); }
+
+    /* initialize */
+    void init() { }
+
+    /* delete all shapes */
+    void clear();
+
+    /* get the empty shape */
+    vm_tadsobj_shape *get_root() { return &root_; }
+
+    /* 
+     *   Can we add a property to an object with the given shape without
+     *   leaving the tree?  This is true if the child shape exists or we can
+     *   create it.  
+     */
+    int can_add(vm_tadsobj_shape *s, vm_prop_id_t prop)
+    {
+        return (find_child(s, prop) != 0
+                || (s->cnt < VMTOBJ_SHAPE_MAX_PROPS
+                    && mem_used_ < VMTOBJ_SHAPE_MAX_MEM));
+    }
+
+    /* 
+     *   Get the child of a shape for the given property, creating it if
+     *   necessary.  This always succeeds; callers that want to respect our
+     *   limits check can_add() first.  
+     */
+    vm_tadsobj_shape *add(vm_tadsobj_shape *s, vm_prop_id_t prop);
+
+    /* get the ancestor of a shape with the given number of properties */
+    static vm_tadsobj_shape *truncate(vm_tadsobj_shape *s, size_t cnt)
+    {
+        while (s->cnt > cnt)
+            s = s->parent;
+        return s;
+    }
+
+protected:
+    /* find an existing child shape */
+    vm_tadsobj_shape *find_child(vm_tadsobj_shape *s, vm_prop_id_t prop)
+    {
+        for (vm_tadsobj_shape *c = hash_[hash(s, prop)] ; c != 0 ; c = c->nxt)
+        {
+            if (c->parent == s && c->prop == prop)
+                return c;
+        }
+        return 0;
+    }
+
+    /* transition table hash function */
+    static size_t hash(const vm_tadsobj_shape *s, vm_prop_id_t prop)
+    {
+        size_t h = (size_t)s;
+        return ((h ^ (h >> 7) ^ ((size_t)prop * 31))
+                & (VMTOBJ_SHAPE_HASH_SIZE - 1));
+    }
+
+    /* the empty shape */
+    vm_tadsobj_shape root_;
+
+    /* transition table - every shape except the root is in here */
+    vm_tadsobj_shape *hash_[VMTOBJ_SHAPE_HASH_SIZE];
+
+    /* 
+     *   memory used by shapes, counting each shape's index whether or not
+     *   we've built it yet 
+     */
+    size_t mem_used_;
+};
+
 
 
 
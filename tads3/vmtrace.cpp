@@ -0,0 +1,198 @@
+/*
+ *   Please see the accompanying license file, LICENSE.TXT, for information
+ *   on using and copying this software.
+ */
+/*
+Name
+  vmtrace.cpp - phase tracing in Chrome trace-event format
+Function
+  See vmtrace.h.
+Notes
+
+Modified
+  10/15/26  - Creation
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "t3std.h"
+#include "os.h"
+#include "vmtrace.h"
+
+
+/* number of characters of command text we keep */
+const size_t VMTRACE_CMD_LEN = 60;
+
+/*
+ *   Trace state
+ */
+static struct
+{
+    /* the trace file; null if we're not tracing */
+    FILE *fp;
+
+    /* the time we opened the trace */
+    os_time_t base_sec;
+    long base_ns;
+
+    /* the command in progress */
+    int in_cmd;
+    double cmd_start;
+    char cmd[VMTRACE_CMD_LEN + 1];
+} S;
+
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Open the trace
+ */
+int vm_trace_open(const char *fname)
+{
+    /* close any trace we already have */
+    vm_trace_close();
+
+    /* open the file */
+    if ((S.fp = fopen(fname, "w")) == 0)
+        return FALSE;
+
+    /* this is time zero */
+    os_time_ns(&S.base_sec, &S.base_ns);
+    S.in_cmd = FALSE;
+
+    /*
+     *   Start the event array.  The viewers accept a trace that ends
+     *   without the closing bracket, so the events are usable even if we
+     *   never get to close the file.  The process name metadata event
+     *   goes first, so every real event follows a comma.
+     */
+    fputs("[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+          "\"args\":{\"name\":\"QTads\"}}", S.fp);
+    return TRUE;
+}
+
+/*
+ *   Close the trace
+ */
+void vm_trace_close()
+{
+    if (S.fp == 0)
+        return;
+
+    /* record the command in progress, if any */
+    vm_trace_command_end();
+
+    /* close the event array */
+    fputs("\n]\n", S.fp);
+    fclose(S.fp);
+    S.fp = 0;
+}
+
+/*
+ *   Are we tracing?
+ */
+int vm_trace_active()
+{
+    return S.fp != 0;
+}
+
+/*
+ *   Get the current trace time
+ */
+double vm_trace_now()
+{
+    os_time_t sec;
+    long ns;
+
+    os_time_ns(&sec, &ns);
+    return (double)(sec - S.base_sec) * 1000000.0
+        + (double)(ns - S.base_ns) / 1000.0;
+}
+
+/*
+ *   Write a string as a JSON string literal
+ */
+static void write_json_str(const char *p)
+{
+    putc('"', S.fp);
+    for ( ; *p != '\0' ; ++p)
+    {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\')
+        {
+            putc('\\', S.fp);
+            putc(c, S.fp);
+        }
+        else if (c < 0x20)
+            fprintf(S.fp, "\\u%04x", c);
+        else
+            putc(c, S.fp);
+    }
+    putc('"', S.fp);
+}
+
+/*
+ *   Record a phase
+ */
+void vm_trace_phase(const char *cat, const char *name, double start,
+                    const char *detail)
+{
+    if (S.fp == 0)
+        return;
+
+    fputs(",\n{\"name\":", S.fp);
+    write_json_str(name);
+    fputs(",\"cat\":", S.fp);
+    write_json_str(cat);
+    fprintf(S.fp, ",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f",
+            start, vm_trace_now() - start);
+    if (detail != 0)
+    {
+        fputs(",\"args\":{\"detail\":", S.fp);
+        write_json_str(detail);
+        putc('}', S.fp);
+    }
+    putc('}', S.fp);
+}
+
+/*
+ *   Start a command
+ */
+void vm_trace_command_begin(const char *cmd)
+{
+    size_t len;
+
+    if (S.fp == 0)
+        return;
+
+    /* end the previous command, in case nobody asked for input since */
+    vm_trace_command_end();
+
+    /* note the start time and the command text */
+    S.in_cmd = TRUE;
+    S.cmd_start = vm_trace_now();
+    if (cmd == 0)
+        cmd = "";
+    len = strlen(cmd);
+    if (len > VMTRACE_CMD_LEN)
+    {
+        /* don't cut a UTF-8 character in half */
+        len = VMTRACE_CMD_LEN;
+        while (len > 0 && (cmd[len] & 0xC0) == 0x80)
+            --len;
+    }
+    memcpy(S.cmd, cmd, len);
+    S.cmd[len] = '\0';
+}
+
+/*
+ *   End the command in progress
+ */
+void vm_trace_command_end()
+{
+    if (S.fp == 0 || !S.in_cmd)
+        return;
+
+    S.in_cmd = FALSE;
+    vm_trace_phase("vm", "command", S.cmd_start, S.cmd);
+}
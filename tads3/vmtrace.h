@@ -0,0 +1,96 @@
+/*
+ *   Please see the accompanying license file, LICENSE.TXT, for information
+ *   on using and copying this software.
+ */
+/*
+Name
+  vmtrace.h - phase tracing in Chrome trace-event format
+Function
+  Records how long the major phases of a turn take - command execution,
+  grammar parsing, garbage collection, and, on the host side, HTML parsing,
+  formatting, painting and resource loading - as a trace file that Chrome's
+  about:tracing page or Perfetto can display.  This lets us see a whole turn
+  across the VM and the user interface on one timeline.
+
+  The trace is process state, since the host's phases interleave with the
+  VM's.  The host opens the trace file, and everyone records phases into it
+  with CVmTraceSpan.
+Notes
+  Each phase is written as one "complete" event (ph "X") when it ends, so a
+  phase that's abandoned by an exception simply doesn't show up, and nothing
+  needs to be balanced.  Everything is reported on a single thread.
+
+  Timestamps come from os_time_ns(), in microseconds since the trace was
+  opened.
+Modified
+  10/15/26  - Creation
+*/
+
+#ifndef VMTRACE_H
+#define VMTRACE_H
+
+/*
+ *   Open the trace file.  Returns true on success.  If a trace is already
+ *   open, it's closed first.
+ */
+int vm_trace_open(const char *fname);
+
+/* finish and close the trace file, if one is open */
+void vm_trace_close();
+
+/* is a trace being recorded? */
+int vm_trace_active();
+
+/* the current trace time, in microseconds since the trace was opened */
+double vm_trace_now();
+
+/*
+ *   Record a phase that started at 'start' (a vm_trace_now() value) and
+ *   ends now.  'cat' is the event category, shown and filtered on by the
+ *   trace viewer.  'detail' is optional text to show with the event.
+ */
+void vm_trace_phase(const char *cat, const char *name, double start,
+                    const char *detail);
+
+/*
+ *   Note the start and end of a command.  A command runs from the moment
+ *   the program gets its input line until it asks for the next one, which
+ *   happens in different functions, so we keep track of the start for the
+ *   caller.
+ */
+void vm_trace_command_begin(const char *cmd);
+void vm_trace_command_end();
+
+/*
+ *   Scoped phase.  Records the time from construction to destruction, if a
+ *   trace is being recorded.  The strings must remain valid for the life of
+ *   the object.
+ */
+class CVmTraceSpan
+{
+public:
+    CVmTraceSpan(const char *cat, const char *name, const char *detail = 0)
+    {
+        cat_ = cat;
+        name_ = name;
+        detail_ = detail;
+        active_ = vm_trace_active();
+        if (active_)
+            start_ = vm_trace_now();
+    }
+
+    ~CVmTraceSpan()
+    {
+        if (active_)
+            vm_trace_phase(cat_, name_, start_, detail_);
+    }
+
+protected:
+    const char *cat_;
+    const char *name_;
+    const char *detail_;
+    int active_;
+    double start_;
+};
+
+#endif /* VMTRACE_H */
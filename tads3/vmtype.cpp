@@ -173,7 +173,7 @@ uint vm_val_t::calc_hash(VMG_ int depth) const
     case VM_SSTRING:
         /* get the hash of the constant string */
         return CVmObjString::
-            const_calc_hash(G_const_pool->get_ptr(val.ofs));
+            const_calc_hash_cached(vmg_ G_const_pool->get_ptr(val.ofs));
         break;
 
     case VM_LIST:
@@ -1192,6 +1192,10 @@ CVmTimeZone::CVmTimeZone(ZoneHashEntryDb *entry, const char *file_data,
     ttype_ = (ttype_cnt_ = type_cnt) != 0 ? new vmtz_ttype[type_cnt] : 0;
     abbr_ = (abbr_bytes != 0 ? new char[abbr_bytes] : 0);
 
+    /* we haven't resolved any rules yet */
+    rule_memo_ = 0;
+    rule_memo_cnt_ = rule_memo_next_ = 0;
+
     /* assume we have no descriptive data */
     country_[0] = '\0';
     coords_[0] = '\0';
@@ -1364,6 +1368,10 @@ void CVmTimeZone::init(const os_tzinfo_t *desc)
     rule_ = 0;
     rule_cnt_ = 0;
 
+    /* we haven't resolved any rules yet */
+    rule_memo_ = 0;
+    rule_memo_cnt_ = rule_memo_next_ = 0;
+
     /* make a copy of our one abbreviation(s) */
     size_t std_abbr_len = strlen(desc->std_abbr);
     size_t dst_abbr_len = strlen(desc->dst_abbr);
@@ -1455,6 +1463,8 @@ CVmTimeZone::~CVmTimeZone()
         delete [] ttype_;
     if (rule_ != 0)
         delete [] rule_;
+    if (rule_memo_ != 0)
+        delete [] rule_memo_;
     if (abbr_ != 0)
         delete [] abbr_;
     if (desc_ != 0)
@@ -1855,21 +1865,16 @@ void CVmTimeZone::query(vmtzquery *result, int32_t dayno, int32_t daytime,
             caldate_t cd(dayno);
             for (int yy = cd.y + 1 ; yy >= cd.y - 2 ; --yy)
             {
+                /* get the concrete dates for the rules in this year */
+                const int32_t *rdates = resolve_rules(yy);
+
                 /* look for the last rule firing on or after the target */
                 int latest = -1;
                 int32_t latest_rday = 0, latest_rtime = 0;
                 for (int i = 0 ; i < rule_cnt_ ; ++i)
                 {
-                    /* 
-                     *   we might need the previous rule to resolve the
-                     *   current rule; the list is circular because it forms
-                     *   an annual cycle 
-                     */
-                    int iprv = (i == 0 ? rule_cnt_ : i) - 1;
-                    
                     /* get the concrete date for this rule in this year */
-                    int32_t rday, rtime;
-                    rule_[i].resolve(rday, rtime, yy, &rule_[iprv]);
+                    int32_t rday = rdates[i*2], rtime = rdates[i*2 + 1];
                     
                     /* adjust to local time if that's what we're looking for */
                     if (local)
@@ -1998,6 +2003,50 @@ void CVmTimeZone::query(vmtzquery *result, int32_t dayno, int32_t daytime,
     result->set(&trans_[cur]);
 }
 
+/*
+ *   Resolve the ongoing rules in the given year, using the memo if we've
+ *   already done this year 
+ */
+const int32_t *CVmTimeZone::resolve_rules(int year) const
+{
+    int slot;
+
+    /* allocate the memo on first use */
+    if (rule_memo_ == 0)
+        rule_memo_ = new int32_t[RULE_MEMO_YEARS * rule_cnt_ * 2];
+
+    /* if we already have this year, return the saved dates */
+    for (slot = 0 ; slot < rule_memo_cnt_ ; ++slot)
+    {
+        if (rule_memo_year_[slot] == year)
+            return rule_memo_ + slot * rule_cnt_ * 2;
+    }
+
+    /* take the next slot, reusing the slots in round-robin order */
+    slot = rule_memo_next_;
+    rule_memo_next_ = (slot + 1) % RULE_MEMO_YEARS;
+    if (rule_memo_cnt_ < RULE_MEMO_YEARS)
+        ++rule_memo_cnt_;
+    rule_memo_year_[slot] = year;
+
+    /* resolve each rule into the slot */
+    int32_t *dst = rule_memo_ + slot * rule_cnt_ * 2;
+    for (int i = 0 ; i < rule_cnt_ ; ++i)
+    {
+        /* 
+         *   we might need the previous rule to resolve the current rule;
+         *   the list is circular because it forms an annual cycle 
+         */
+        int iprv = (i == 0 ? rule_cnt_ : i) - 1;
+
+        /* get the concrete date for this rule in this year */
+        rule_[i].resolve(dst[i*2], dst[i*2 + 1], year, &rule_[iprv]);
+    }
+
+    /* return the new slot */
+    return dst;
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Compare my date to the given date, which can be expressed in either UTC
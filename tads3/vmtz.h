@@ -460,6 +460,13 @@ protected:
     /* initialize from an OS timezone descriptor */
     void init(const os_tzinfo_t *desc);
 
+    /* 
+     *   Get the UTC firing dates of the ongoing rules in the given year.
+     *   Returns an array of rule_cnt_ (dayno, daytime) pairs, in rule list
+     *   order.  The result stays valid until the next call. 
+     */
+    const int32_t *resolve_rules(int year) const;
+
     /* my hash table entry */
     class ZoneHashEntry *hashentry_;
 
@@ -478,6 +485,21 @@ protected:
     int rule_cnt_;
     vmtz_rule *rule_;
 
+    /* 
+     *   Memo of resolved rule dates.  Each query() past the end of the
+     *   transition list resolves every rule in several years around the
+     *   target date, which takes a fair amount of calendar arithmetic.
+     *   Programs tend to convert many dates close together, so we keep
+     *   the resolved dates for the last few years we've looked at.
+     *   rule_memo_ holds RULE_MEMO_YEARS slots of rule_cnt_ (dayno,
+     *   daytime) pairs; it's allocated on first use.  
+     */
+    static const int RULE_MEMO_YEARS = 4;
+    mutable int32_t *rule_memo_;
+    mutable int rule_memo_year_[RULE_MEMO_YEARS];
+    mutable int rule_memo_cnt_;
+    mutable int rule_memo_next_;
+
     /* abbreviations */
     char *abbr_;
 
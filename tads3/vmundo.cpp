@@ -42,17 +42,12 @@ CVmUndo::CVmUndo(size_t undo_record_cnt, uint max_savepts)
     /* no savepoints have been created yet */
     savept_cnt_ = 0;
 
-    /* create the undo record array */
-    rec_arr_size_ = undo_record_cnt;
-    rec_arr_ = (CVmUndoMeta *)t3malloc(rec_arr_size_
-                                       * sizeof(rec_arr_[0]));
+    /* create the record arena */
+    arena_size_ = undo_record_cnt * VMUNDO_BYTES_PER_REC;
+    arena_ = (unsigned char *)t3malloc(arena_size_);
 
-    /* we have no records at all yet, so we have no "firsts" */
-    cur_first_ = 0;
-    oldest_first_ = 0;
-
-    /* start allocating from the first entry in the array */
-    next_free_ = rec_arr_;
+    /* we have no records at all yet */
+    reset_arena();
 }
 
 /*
@@ -60,36 +55,221 @@ CVmUndo::CVmUndo(size_t undo_record_cnt, uint max_savepts)
  */
 CVmUndo::~CVmUndo()
 {
-    /* delete the array of undo records */
-    t3free(rec_arr_);
+    /* delete the record arena */
+    t3free(arena_);
+}
+
+/*
+ *   Set the memory budget 
+ */
+void CVmUndo::set_mem_budget(VMG_ size_t bytes)
+{
+    /* enforce the minimum size */
+    if (bytes < VMUNDO_MIN_BUDGET)
+        bytes = VMUNDO_MIN_BUDGET;
+
+    /* the records in the old arena are going away, so drop all undo */
+    drop_undo(vmg0_);
+
+    /* reallocate the arena */
+    t3free(arena_);
+    arena_size_ = bytes;
+    arena_ = (unsigned char *)t3malloc(arena_size_);
+
+    /* start over with an empty arena */
+    reset_arena();
+}
+
+/*
+ *   Get the number of arena bytes in use 
+ */
+size_t CVmUndo::get_mem_used() const
+{
+    /* if we have no savepoints, there are no live records */
+    if (savept_cnt_ == 0 || oldest_first_ == VMUNDO_NO_REC)
+        return 0;
+
+    /* 
+     *   if the live records don't wrap, it's the span from the oldest
+     *   record to the free pointer; otherwise it's the part up to the wrap
+     *   point plus the part at the start of the arena 
+     */
+    if (next_free_ > oldest_first_)
+        return next_free_ - oldest_first_;
+    else
+        return (wrap_ofs_ - oldest_first_) + next_free_;
+}
+
+/* ------------------------------------------------------------------------ */
+/*
+ *   Figure the payload size class for a value 
+ */
+int CVmUndo::val_class(const vm_val_t *val)
+{
+    switch (val->typ)
+    {
+    case VM_NIL:
+    case VM_TRUE:
+        /* the type says it all */
+        return VMUNDO_VAL_NONE;
+
+    case VM_OBJ:
+    case VM_OBJX:
+    case VM_PROP:
+    case VM_INT:
+    case VM_ENUM:
+    case VM_SSTRING:
+    case VM_DSTRING:
+    case VM_LIST:
+    case VM_CODEOFS:
+    case VM_FUNCPTR:
+    case VM_BIFPTR:
+    case VM_BIFPTRX:
+    case VM_EMPTY:
+        /* 
+         *   these all fit in the first 32 bits of the value union (note
+         *   that 'empty' values can carry an integer marker) 
+         */
+        return VMUNDO_VAL_INT;
+
+    default:
+        /* pointers and anything else get the whole union */
+        return VMUNDO_VAL_FULL;
+    }
 }
 
+/*
+ *   Get the size of the record at the given offset 
+ */
+size_t CVmUndo::rec_size(size_t ofs) const
+{
+    int tag = arena_[ofs];
+
+    /* link records have a fixed size */
+    if ((tag & 0x03) == VMUNDO_KIND_LINK)
+        return 2 + 2*sizeof(size_t);
+
+    /* figure the size from the key kind and payload class */
+    return 2 + sizeof(vm_obj_id_t) + key_size(tag & 0x03)
+        + val_size((tag >> 2) & 0x03) + 1;
+}
+
+/*
+ *   Decode a record 
+ */
+void CVmUndo::decode_rec(size_t ofs, CVmUndoRecord *rec) const
+{
+    const unsigned char *p = arena_ + ofs;
+    int kind = p[0] & 0x03;
+    int cls = (p[0] >> 2) & 0x03;
+
+    /* get the object ID */
+    memcpy(&rec->obj, p + 2, sizeof(rec->obj));
+    p += 2 + sizeof(rec->obj);
+
+    /* get the key */
+    memset(&rec->id, 0, sizeof(rec->id));
+    switch (kind)
+    {
+    case VMUNDO_KIND_PROP:
+        memcpy(&rec->id.prop, p, sizeof(rec->id.prop));
+        break;
+
+    case VMUNDO_KIND_INT:
+        memcpy(&rec->id.intval, p, sizeof(rec->id.intval));
+        break;
+
+    default:
+        memcpy(&rec->id.ptrval, p, sizeof(rec->id.ptrval));
+        break;
+    }
+    p += key_size(kind);
+
+    /* 
+     *   get the value; a value with no payload is nil or true, so set the
+     *   object field to 'invalid' in case anyone reads a nil as an object 
+     */
+    rec->oldval.typ = (vm_datatype_t)arena_[ofs + 1];
+    memset(&rec->oldval.val, 0, sizeof(rec->oldval.val));
+    if (cls == VMUNDO_VAL_NONE)
+        rec->oldval.val.obj = VM_INVALID_OBJ;
+    else
+        memcpy(&rec->oldval.val, p, val_size(cls));
+}
+
+/*
+ *   Store a modified record back into its slot 
+ */
+int CVmUndo::rewrite_rec(size_t ofs, const CVmUndoRecord *rec)
+{
+    unsigned char *p = arena_ + ofs;
+    int kind = p[0] & 0x03;
+    int cls = (p[0] >> 2) & 0x03;
+
+    /* make sure the new value fits in the existing payload space */
+    if (val_size(val_class(&rec->oldval)) > val_size(cls))
+        return FALSE;
+
+    /* store the object ID */
+    memcpy(p + 2, &rec->obj, sizeof(rec->obj));
+    p += 2 + sizeof(rec->obj);
+
+    /* store the key */
+    switch (kind)
+    {
+    case VMUNDO_KIND_PROP:
+        memcpy(p, &rec->id.prop, sizeof(rec->id.prop));
+        break;
+
+    case VMUNDO_KIND_INT:
+        memcpy(p, &rec->id.intval, sizeof(rec->id.intval));
+        break;
+
+    default:
+        memcpy(p, &rec->id.ptrval, sizeof(rec->id.ptrval));
+        break;
+    }
+    p += key_size(kind);
+
+    /* store the value, keeping the slot's payload size */
+    arena_[ofs + 1] = (unsigned char)rec->oldval.typ;
+    memcpy(p, &rec->oldval.val, val_size(cls));
+
+    /* success */
+    return TRUE;
+}
+
+/* ------------------------------------------------------------------------ */
 /*
  *   create a savepoint 
  */
 void CVmUndo::create_savept(VMG0_)
 {
-    CVmUndoMeta *rec;
+    size_t rec;
 
     /* 
-     *   Allocate an undo record to serve as the link pointer for this
-     *   savepoint.  If this fails, we cannot create a savepoint; we won't
-     *   need to do anything else in this case, since we will have deleted
-     *   all existing savepoints if we ran out of records.  
+     *   Allocate a link record for this savepoint.  If this fails, we
+     *   cannot create a savepoint; we won't need to do anything else in
+     *   this case, since we will have deleted all existing savepoints if
+     *   we ran out of space.  
      */
-    rec = alloc_rec(vmg0_);
-    if (rec == 0)
+    rec = alloc_rec(vmg_ 2 + 2*sizeof(size_t));
+    if (rec == VMUNDO_NO_REC)
         return;
 
+    /* set up the link record's tag and length */
+    arena_[rec] = VMUNDO_KIND_LINK;
+    arena_[rec + 1 + 2*sizeof(size_t)] = (unsigned char)(2 + 2*sizeof(size_t));
+
     /* if we have an old savepoint, the new record starts the next one */
-    if (cur_first_ != 0)
-        cur_first_->link.next_first = rec;
+    if (cur_first_ != VMUNDO_NO_REC)
+        set_link(cur_first_, TRUE, rec);
 
     /* the old savepoint (if any) is our previous savepoint */
-    rec->link.prev_first = cur_first_;
+    set_link(rec, FALSE, cur_first_);
 
     /* there's nothing after us yet */
-    rec->link.next_first = 0;
+    set_link(rec, TRUE, VMUNDO_NO_REC);
 
     /* this record is now the current savepoint's first record */
     cur_first_ = rec;
@@ -98,7 +278,7 @@ void CVmUndo::create_savept(VMG0_)
      *   if we didn't have any savepoints recorded yet, this is now the
      *   first record in the oldest savepoint 
      */
-    if (oldest_first_ == 0)
+    if (oldest_first_ == VMUNDO_NO_REC)
         oldest_first_ = rec;
 
     /* 
@@ -141,35 +321,45 @@ void CVmUndo::drop_oldest_savept(VMG0_)
     --savept_cnt_;
 
     /* forget the oldest lead pointer */
-    if (oldest_first_ != 0)
+    if (oldest_first_ != VMUNDO_NO_REC)
     {
         /* 
          *   discard records from the oldest lead pointer to the next
          *   oldest lead pointer 
          */
-        CVmUndoMeta *meta;
-        for (meta = oldest_first_, inc_rec_ptr(&meta) ;
-             meta != oldest_first_->link.next_first && meta != next_free_ ; )
+        size_t next_first = get_link(oldest_first_, TRUE);
+        size_t cur;
+        for (cur = next_rec(oldest_first_) ;
+             cur != next_first && cur != next_free_ ; cur = next_rec(cur))
         {
             /* discard this entry, if it still exists */
-            if (meta->rec.obj != VM_INVALID_OBJ)
-                vm_objp(vmg_ meta->rec.obj)->discard_undo(vmg_ &meta->rec);
-            
-            /* advance to the next record */
-            inc_rec_ptr(&meta);
+            if (get_rec_obj(cur) != VM_INVALID_OBJ)
+            {
+                CVmUndoRecord rec;
+                decode_rec(cur, &rec);
+                vm_objp(vmg_ rec.obj)->discard_undo(vmg_ &rec);
+            }
         }
+
+        /* 
+         *   if the next savepoint is before this one in the arena, we've
+         *   discarded everything before the wrap point, so what's left no
+         *   longer wraps 
+         */
+        if (next_first != VMUNDO_NO_REC && next_first < oldest_first_)
+            wrap_ofs_ = arena_size_;
         
         /* advance the oldest pointer to the next savepoint's first record */
-        oldest_first_ = oldest_first_->link.next_first;
+        oldest_first_ = next_first;
 
         /* there's now nothing before this one */
-        if (oldest_first_ != 0)
-            oldest_first_->link.prev_first = 0;
+        if (oldest_first_ != VMUNDO_NO_REC)
+            set_link(oldest_first_, FALSE, VMUNDO_NO_REC);
     }
 
     /* if we don't have an oldest, we also don't have a current */
-    if (oldest_first_ == 0)
-        cur_first_ = 0;
+    if (oldest_first_ == VMUNDO_NO_REC)
+        cur_first_ = VMUNDO_NO_REC;
 }
 
 /*
@@ -184,53 +374,72 @@ void CVmUndo::drop_undo(VMG0_)
     /* reset the savepoint number */
     cur_savept_ = 0;
 
-    /* we have no "firsts" */
-    cur_first_ = 0;
-    oldest_first_ = 0;
-
-    /* start allocating from the start of the array */
-    next_free_ = rec_arr_;
+    /* start allocating from the start of the arena */
+    reset_arena();
 }
 
 /*
- *   Allocate an undo record.  If we run out of free records, delete
- *   savepoints, starting with the oldest savepoint, until we have a free
- *   record.  
+ *   Allocate space for an undo record.  If we run out of free space,
+ *   delete savepoints, starting with the oldest savepoint, until we have
+ *   room.  
  */
-CVmUndoMeta *CVmUndo::alloc_rec(VMG0_)
+size_t CVmUndo::alloc_rec(VMG_ size_t len)
 {
     /* 
-     *   keep trying until we find an entry or run out of savepoints to
+     *   keep trying until we find space or run out of savepoints to
      *   delete 
      */
     for (;;)
     {
+        size_t ret = VMUNDO_NO_REC;
+
+        /* if we have no savepoints at all, the whole arena is free */
+        if (savept_cnt_ == 0)
+            reset_arena();
+
         /*
-         *   If we have no savepoints at all, all records are free.
-         *   Otherwise, if the next free pointer hasn't bumped up against
-         *   the oldest allocated record yet, we can allocate another
-         *   record.  
+         *   Look for room.  If the live records don't wrap (the oldest
+         *   record is at or before the free pointer), we can use the space
+         *   at the end of the arena, or else wrap to the start, as long as
+         *   we don't run into the oldest record.  Otherwise the free space
+         *   is the gap between the free pointer and the oldest record.  We
+         *   never let the free pointer catch up to the oldest record, so
+         *   that equal pointers always mean "empty".  
          */
-        if (savept_cnt_ == 0 || next_free_ != oldest_first_)
+        if (savept_cnt_ == 0 || next_free_ >= oldest_first_)
         {
-            CVmUndoMeta *ret;
-            
-            /* remember the current free record */
+            if (next_free_ + len < arena_size_
+                || (next_free_ + len == arena_size_
+                    && (savept_cnt_ == 0 || oldest_first_ != 0)))
+            {
+                /* there's room at the end of the arena */
+                ret = next_free_;
+                next_free_ += len;
+                if (next_free_ == arena_size_)
+                    next_free_ = 0;
+            }
+            else if (savept_cnt_ == 0 || len < oldest_first_)
+            {
+                /* leave the end unused, and wrap to the start */
+                wrap_ofs_ = next_free_;
+                ret = 0;
+                next_free_ = len;
+            }
+        }
+        else if (next_free_ + len < oldest_first_)
+        {
+            /* there's room before the oldest record */
             ret = next_free_;
+            next_free_ += len;
+        }
 
-            /* 
-             *   advance to the next record, wrapping if we reach the end
-             *   of the array (since we treat the array as circular) 
-             */
-            inc_rec_ptr(&next_free_);
-
-            /* return the record */
+        /* if we found space, return it */
+        if (ret != VMUNDO_NO_REC)
             return ret;
-        }
         
         /* 
          *   If we have at least one old savepoint, discard the oldest
-         *   savepoint, which may free up some records, and try again;
+         *   savepoint, which may free up some space, and try again;
          *   otherwise, give up.  
          */
         if (savept_cnt_ > 1)
@@ -246,11 +455,11 @@ CVmUndoMeta *CVmUndo::alloc_rec(VMG0_)
             /* 
              *   we are down to our last savepoint (or none at all) - it's
              *   no longer valid (since we can't keep it complete due to
-             *   the lack of available records), so delete it and return
+             *   the lack of available space), so delete it and return
              *   failure 
              */
             drop_oldest_savept(vmg0_);
-            return 0;
+            return VMUNDO_NO_REC;
         }
     }
 }
@@ -261,23 +470,7 @@ CVmUndoMeta *CVmUndo::alloc_rec(VMG0_)
 void CVmUndo::add_new_record_prop_key(VMG_ vm_obj_id_t obj, vm_prop_id_t key,
                                       const vm_val_t *val)
 {
-    CVmUndoRecord *rec;
-
-    /* allocate the new record */
-    rec = add_new_record(vmg_ obj);
-
-    /* if we successfully allocated a record, set it up */
-    if (rec != 0)
-    {
-        /* set the object */
-        rec->obj = obj;
-        
-        /* set the key */
-        rec->id.prop = key;
-
-        /* set the value */
-        rec->oldval = *val;
-    }
+    add_new_record(vmg_ obj, VMUNDO_KIND_PROP, &key, val);
 }
 
 /*
@@ -286,24 +479,7 @@ void CVmUndo::add_new_record_prop_key(VMG_ vm_obj_id_t obj, vm_prop_id_t key,
 void CVmUndo::add_new_record_int_key(VMG_ vm_obj_id_t obj, uint32_t key,
                                      const vm_val_t *val)
 {
-    CVmUndoRecord *rec;
-
-    /* allocate the new record */
-    rec = add_new_record(vmg_ obj);
-
-    /* if we successfully allocated a record, set it up */
-    if (rec != 0)
-    {
-        /* set the object */
-        rec->obj = obj;
-        
-        /* set the key */
-
-        rec->id.intval = key;
-
-        /* set the value */
-        rec->oldval = *val;
-    }
+    add_new_record(vmg_ obj, VMUNDO_KIND_INT, &key, val);
 }
 
 /*
@@ -312,38 +488,19 @@ void CVmUndo::add_new_record_int_key(VMG_ vm_obj_id_t obj, uint32_t key,
 int CVmUndo::add_new_record_ptr_key(VMG_ vm_obj_id_t obj, void *key,
                                     const vm_val_t *val)
 {
-    CVmUndoRecord *rec;
-
-    /* allocate the new record */
-    rec = add_new_record(vmg_ obj);
-
-    /* if we successfully allocated a record, set it up */
-    if (rec != 0)
-    {
-        /* set the object */
-        rec->obj = obj;
-
-        /* set the key */
-        rec->id.ptrval = key;
-
-        /* set the value */
-        rec->oldval = *val;
-    }
-
     /* return an indication as to whether the record was created */
-    return (rec != 0);
+    return add_new_record(vmg_ obj, VMUNDO_KIND_PTR, &key, val);
 }
 
 /*
  *   Add a new undo record 
  */
-CVmUndoRecord *CVmUndo::add_new_record(VMG_ vm_obj_id_t controlling_obj)
+int CVmUndo::add_new_record(VMG_ vm_obj_id_t controlling_obj, int kind,
+                            const void *key, const vm_val_t *val)
 {
-    CVmUndoMeta *meta;
-    
     /* if there is not an active savepoint, do not keep undo */
     if (savept_cnt_ == 0)
-        return 0;
+        return FALSE;
 
     /* 
      *   if the object was created after the current savepoint was created,
@@ -352,13 +509,31 @@ CVmUndoRecord *CVmUndo::add_new_record(VMG_ vm_obj_id_t controlling_obj)
      *   the object didn't even exist 
      */
     if (!G_obj_table->is_obj_in_undo(controlling_obj))
-        return 0;
-    
-    /* allocate a new record */
-    meta = alloc_rec(vmg0_);
+        return FALSE;
+
+    /* figure the encoded size */
+    int cls = val_class(val);
+    size_t klen = key_size(kind);
+    size_t vlen = val_size(cls);
+    size_t len = 2 + sizeof(vm_obj_id_t) + klen + vlen + 1;
     
-    /* return the undo record, if we succeeded */
-    return (meta == 0 ? 0 : &meta->rec);
+    /* allocate space for the record */
+    size_t ofs = alloc_rec(vmg_ len);
+    if (ofs == VMUNDO_NO_REC)
+        return FALSE;
+
+    /* encode the record */
+    unsigned char *p = arena_ + ofs;
+    p[0] = (unsigned char)(kind | (cls << 2));
+    p[1] = (unsigned char)val->typ;
+    memcpy(p + 2, &controlling_obj, sizeof(controlling_obj));
+    p += 2 + sizeof(controlling_obj);
+    memcpy(p, key, klen);
+    memcpy(p + klen, &val->val, vlen);
+    p[klen + vlen] = (unsigned char)len;
+
+    /* success */
+    return TRUE;
 }
 
 /*
@@ -366,7 +541,7 @@ CVmUndoRecord *CVmUndo::add_new_record(VMG_ vm_obj_id_t controlling_obj)
  */
 void CVmUndo::undo_to_savept(VMG0_)
 {
-    CVmUndoMeta *meta;
+    size_t cur;
     
     /* if we don't have any savepoints, there's nothing to do */
     if (savept_cnt_ == 0)
@@ -376,42 +551,29 @@ void CVmUndo::undo_to_savept(VMG0_)
      *   Starting with the most recently-added record, apply each record
      *   in sequence until we reach the first savepoint in the undo list.  
      */
-    meta = next_free_;
-    for (;;)
+    for (cur = prev_rec(next_free_) ; cur != cur_first_ ;
+         cur = prev_rec(cur))
     {
-        /* 
-         *   move to the previous record, wrapping to the end of the array
-         *   at the first record (since we treat the array as circular) 
-         */
-        if (meta == rec_arr_)
-            meta = rec_arr_ + rec_arr_size_;
-        --meta;
-
-        /* 
-         *   if we're at the first record in the current savepoint, we're
-         *   done 
-         */
-        if (meta == cur_first_)
-            break;
-
         /* apply this undo record */
-        G_obj_table->apply_undo(vmg_ &meta->rec);
+        CVmUndoRecord rec;
+        decode_rec(cur, &rec);
+        G_obj_table->apply_undo(vmg_ &rec);
     }
 
     /*
      *   Unwind the undo stack -- get the first record in the previous
-     *   savepoint from the link pointer. 
+     *   savepoint from the link record. 
      */
-    cur_first_ = cur_first_->link.prev_first;
+    cur_first_ = get_link(cur, FALSE);
 
     /* 
      *   there's nothing following the current savepoint any more -- the
      *   savepoint we just applied is gone now 
      */
-    if (cur_first_ != 0)
-        cur_first_->link.next_first = 0;
+    if (cur_first_ != VMUNDO_NO_REC)
+        set_link(cur_first_, TRUE, VMUNDO_NO_REC);
     else
-        oldest_first_ = 0;
+        oldest_first_ = VMUNDO_NO_REC;
 
     /* that's one less savepoint */
     --savept_cnt_;
@@ -422,7 +584,11 @@ void CVmUndo::undo_to_savept(VMG0_)
         cur_savept_ = VM_SAVEPT_MAX;
 
     /* the savepoint link we just removed is now the next free record */
-    next_free_ = meta;
+    next_free_ = cur;
+
+    /* if the remaining records no longer wrap, forget the wrap point */
+    if (oldest_first_ != VMUNDO_NO_REC && next_free_ >= oldest_first_)
+        wrap_ofs_ = arena_size_;
 
     /* 
      *   notify objects that a new savepoint is in effect - the savepoint
@@ -440,25 +606,23 @@ void CVmUndo::undo_to_savept(VMG0_)
  */
 void CVmUndo::gc_mark_refs(VMG0_)
 {
-    CVmUndoMeta *cur;
-    CVmUndoMeta *next_link;
+    size_t cur;
+    size_t next_link;
 
     /* if we don't have any records, there's nothing to do */
-    if (oldest_first_ == 0)
+    if (oldest_first_ == VMUNDO_NO_REC)
         return;
 
     /* the first record is a linking record */
     next_link = oldest_first_;
 
-    /* start at the first record */
-    cur = oldest_first_;
-
     /* 
      *   Go through all undo records, from the oldest to the newest.  Note
      *   that we must keep track of each "link" record, because these are
      *   not ordinary undo records and must be handled differently.  
      */
-    for (;;)
+    cur = oldest_first_;
+    do
     {
         /* check to see if this is a linking record or an ordinary record */
         if (cur == next_link)
@@ -467,9 +631,9 @@ void CVmUndo::gc_mark_refs(VMG0_)
              *   this is a linking record - simply note the next linking
              *   record and otherwise ignore this record 
              */
-            next_link = cur->link.next_first;
+            next_link = get_link(cur, TRUE);
         }
-        else if (cur->rec.obj != VM_INVALID_OBJ)
+        else if (get_rec_obj(cur) != VM_INVALID_OBJ)
         {
             /* 
              *   It's an ordinary undo record -- mark its references.
@@ -480,18 +644,15 @@ void CVmUndo::gc_mark_refs(VMG0_)
              *   keep any undo information for it; so, we don't mark the
              *   owner object itself as reachable at this point.  
              */
-            G_obj_table->mark_obj_undo_rec(vmg_ cur->rec.obj, &cur->rec);
+            CVmUndoRecord rec;
+            decode_rec(cur, &rec);
+            G_obj_table->mark_obj_undo_rec(vmg_ rec.obj, &rec);
         }
-        
-        /* advance to the next record, wrapping at the end of the array */
-        ++cur;
-        if (cur == rec_arr_ + rec_arr_size_)
-            cur = rec_arr_;
-
-        /* stop if we've reached the last record */
-        if (cur == next_free_)
-            break;
+
+        /* advance to the next record */
+        cur = next_rec(cur);
     }
+    while (cur != next_free_);
 }
 
 /*
@@ -503,25 +664,23 @@ void CVmUndo::gc_mark_refs(VMG0_)
  */
 void CVmUndo::gc_remove_stale_weak_refs(VMG0_)
 {
-    CVmUndoMeta *cur;
-    CVmUndoMeta *next_link;
+    size_t cur;
+    size_t next_link;
 
     /* if we don't have any records, there's nothing to do */
-    if (oldest_first_ == 0)
+    if (oldest_first_ == VMUNDO_NO_REC)
         return;
 
     /* the first record is a linking record */
     next_link = oldest_first_;
 
-    /* start at the first record */
-    cur = oldest_first_;
-
     /* 
      *   Go through all undo records, from the oldest to the newest.  Note
      *   that we must keep track of each "link" record, because these are
      *   not ordinary undo records and must be handled differently.  
      */
-    for (;;)
+    cur = oldest_first_;
+    do
     {
         /* check to see if this is a linking record or an ordinary record */
         if (cur == next_link)
@@ -530,9 +689,9 @@ void CVmUndo::gc_remove_stale_weak_refs(VMG0_)
              *   this is a linking record - simply note the next linking
              *   record and otherwise ignore this record 
              */
-            next_link = cur->link.next_first;
+            next_link = get_link(cur, TRUE);
         }
-        else if (cur->rec.obj != VM_INVALID_OBJ)
+        else if (get_rec_obj(cur) != VM_INVALID_OBJ)
         {
             /* 
              *   It's an ordinary undo record -- delete its stale
@@ -541,30 +700,42 @@ void CVmUndo::gc_remove_stale_weak_refs(VMG0_)
              *   the entire undo record -- undo records themselves only
              *   weakly reference their owning objects.  
              */
-            if (!G_obj_table->is_obj_deletable(cur->rec.obj))
+            if (!G_obj_table->is_obj_deletable(get_rec_obj(cur)))
             {
+                CVmUndoRecord rec;
+                
                 /* it's not ready for deletion - clean up its weak refs */
+                decode_rec(cur, &rec);
                 G_obj_table->remove_obj_stale_undo_weak_ref(
-                    vmg_ cur->rec.obj, &cur->rec);
+                    vmg_ rec.obj, &rec);
+
+                /* 
+                 *   store back any changes; cleaning up weak references
+                 *   only ever clears values, so the result should always
+                 *   fit, but if it somehow doesn't, drop the record 
+                 */
+                if (!rewrite_rec(cur, &rec))
+                    invalidate_rec(cur);
             }
             else
             {
+                CVmUndoRecord rec;
+
                 /* 
-                 *   it's no longer reachable - delete the undo record by
-                 *   setting the owning object to 'invalid' 
+                 *   it's no longer reachable - let the object free any
+                 *   private data attached to the record (the object won't
+                 *   actually be deleted until after we return), then delete
+                 *   the undo record by setting the owning object to
+                 *   'invalid' 
                  */
-                cur->rec.obj = VM_INVALID_OBJ;
+                decode_rec(cur, &rec);
+                vm_objp(vmg_ rec.obj)->discard_undo(vmg_ &rec);
+                invalidate_rec(cur);
             }
         }
 
-        /* advance to the next record, wrapping at the end of the array */
-        ++cur;
-        if (cur == rec_arr_ + rec_arr_size_)
-            cur = rec_arr_;
-
-        /* stop if we've reached the last record */
-        if (cur == next_free_)
-            break;
+        /* advance to the next record */
+        cur = next_rec(cur);
     }
+    while (cur != next_free_);
 }
-
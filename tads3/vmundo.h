@@ -20,6 +20,7 @@ Modified
 #ifndef VMUNDO_H
 #define VMUNDO_H
 
+#include <string.h>
 #include "t3std.h"
 #include "vmtype.h"
 
@@ -71,26 +72,54 @@ struct CVmUndoRecord
 
 
 /*
- *   Undo meta-record.  Each slot in the undo array is one of these
- *   meta-records, which is a union of the normal undo record and an undo
- *   link pointer.  The first undo record in any savepoint is always a
- *   link pointer; all of the other records are normal undo records. 
+ *   Undo log encoding.  Rather than storing each record as a fixed-size
+ *   CVmUndoRecord, the undo manager packs records into a circular byte
+ *   arena, using only as many bytes as each record actually needs:
+ *   
+ *.  tag (1 byte) - the record kind (VMUNDO_KIND_xxx) in the low two bits,
+ *.    and the value payload size class (VMUNDO_VAL_xxx) in the next two bits
+ *   
+ *   For a link record (the first record of each savepoint), the tag is
+ *   followed by the arena offsets of the first records in the previous and
+ *   next savepoints, as size_t values.  For any other record, it's
+ *   followed by:
+ *   
+ *.  value type (1 byte) - the vm_datatype_t of the old value
+ *.  object ID (vm_obj_id_t)
+ *.  key (vm_prop_id_t, uint32_t, or void *, according to the record kind)
+ *.  value payload (0 bytes, 4 bytes, or a full vm_val_t value union)
+ *   
+ *   Every record ends with a one-byte copy of its total length, so that we
+ *   can walk the log backwards when applying undo.  Multi-byte fields are
+ *   stored in native byte order, since the log never leaves memory.
+ *   
+ *   We decode records into a CVmUndoRecord when handing them to the
+ *   objects that own them, so the objects never see the packed format.  
  */
-union CVmUndoMeta
-{
-    /* the first entry in each savepoint is a link entry */
-    struct
-    {
-        /* pointer to the first record in the previous savepoint */
-        CVmUndoMeta *prev_first;
 
-        /* pointer to the first record in the next savepoint */
-        CVmUndoMeta *next_first;
-    } link;
-    
-    /* every entry but the first in a savepoint is an ordinary undo record */
-    CVmUndoRecord rec;
-};
+/* record kinds */
+#define VMUNDO_KIND_LINK   0                    /* savepoint link record */
+#define VMUNDO_KIND_PROP   1                         /* property ID key */
+#define VMUNDO_KIND_INT    2                             /* integer key */
+#define VMUNDO_KIND_PTR    3                             /* pointer key */
+
+/* value payload size classes */
+#define VMUNDO_VAL_NONE    0      /* no payload (nil, true): type is enough */
+#define VMUNDO_VAL_INT     1          /* 32-bit payload (int, obj, ofs...) */
+#define VMUNDO_VAL_FULL    2              /* the entire vm_val_t union */
+
+/* 
+ *   Arena bytes to allocate per nominal undo record.  Typical property
+ *   records pack into 12 to 16 bytes, so this gives us at least as many
+ *   records as the old fixed-size array, in less memory.  
+ */
+#define VMUNDO_BYTES_PER_REC  16
+
+/* 'no record' offset value */
+#define VMUNDO_NO_REC  ((size_t)-1)
+
+/* smallest arena we'll allow for a memory budget setting */
+#define VMUNDO_MIN_BUDGET  1024
 
 
 /* ------------------------------------------------------------------------ */
@@ -124,6 +153,19 @@ public:
     /* drop all undo information */
     void drop_undo(VMG0_);
 
+    /*
+     *   Set the memory budget for the undo log, in bytes.  This discards
+     *   all existing undo information and reallocates the log at the new
+     *   size, so it's meant to be used at start-up.  When the log fills
+     *   up, we discard the oldest savepoints, a whole savepoint (normally
+     *   a turn) at a time, to make room.  
+     */
+    void set_mem_budget(VMG_ size_t bytes);
+
+    /* get the memory budget and the bytes currently used */
+    size_t get_mem_budget() const { return arena_size_; }
+    size_t get_mem_used() const;
+
     /*
      *   Allocate and initialize an undo record with a property key or
      *   with an integer key.
@@ -188,32 +230,107 @@ public:
 
 private:
     /*
-     *   Allocate an undo record.  Returns null if no records are
+     *   Allocate 'len' bytes of arena space for a record.  Returns the
+     *   arena offset of the space, or VMUNDO_NO_REC if no space is
      *   available, in which case the caller should simply skip saving
      *   undo.  
      */
-    CVmUndoMeta *alloc_rec(VMG0_);
+    size_t alloc_rec(VMG_ size_t len);
 
-    /* 
-     *   increment a record pointer, wrapping back at the end of the array
-     *   to the first record 
+    /*
+     *   Add a new record with the given kind and key, encoding the value.
+     *   If we don't have an active savepoint, or we can't find space for
+     *   the record, we'll return false without saving anything.  
      */
-    void inc_rec_ptr(CVmUndoMeta **rec)
+    int add_new_record(VMG_ vm_obj_id_t controlling_obj, int kind,
+                       const void *key, const vm_val_t *val);
+
+    /* get the size of a record's key, given its kind */
+    static size_t key_size(int kind)
     {
-        /* increment the record pointer */
-        ++(*rec);
+        return (kind == VMUNDO_KIND_PROP ? sizeof(vm_prop_id_t) :
+                kind == VMUNDO_KIND_INT ? sizeof(uint32_t) :
+                sizeof(void *));
+    }
 
-        /* if it's at the end of the array, wrap back to the start */
-        if (*rec == rec_arr_ + rec_arr_size_)
-            *rec = rec_arr_;
+    /* get the size of a value payload, given its size class */
+    static size_t val_size(int cls)
+    {
+        return (cls == VMUNDO_VAL_NONE ? 0 :
+                cls == VMUNDO_VAL_INT ? 4 :
+                sizeof(((vm_val_t *)0)->val));
     }
 
-    /*
-     *   Add a new record and return the new record.  If we don't have an
-     *   active savepoint, this will return null, since there's no need to
-     *   keep undo.  
+    /* get the payload size class we need for a value */
+    static int val_class(const vm_val_t *val);
+
+    /* get the total size of the record at the given offset */
+    size_t rec_size(size_t ofs) const;
+
+    /* get the offset of the record after/before the given record */
+    size_t next_rec(size_t ofs) const
+    {
+        /* skip the record, wrapping at the end of the used arena space */
+        ofs += rec_size(ofs);
+        return (ofs == wrap_ofs_ || ofs == arena_size_ ? 0 : ofs);
+    }
+    size_t prev_rec(size_t ofs) const
+    {
+        /* 
+         *   back up to the end of the previous record, then back up by its
+         *   length, which is stored in its last byte 
+         */
+        if (ofs == 0)
+            ofs = wrap_ofs_;
+        return ofs - arena_[ofs - 1];
+    }
+
+    /* get/set the fields of a link record */
+    size_t get_link(size_t ofs, int next) const
+    {
+        size_t val;
+        memcpy(&val, arena_ + ofs + 1 + (next ? sizeof(size_t) : 0),
+               sizeof(val));
+        return val;
+    }
+    void set_link(size_t ofs, int next, size_t val)
+    {
+        memcpy(arena_ + ofs + 1 + (next ? sizeof(size_t) : 0),
+               &val, sizeof(val));
+    }
+
+    /* get the object ID from the record at the given offset */
+    vm_obj_id_t get_rec_obj(size_t ofs) const
+    {
+        vm_obj_id_t obj;
+        memcpy(&obj, arena_ + ofs + 2, sizeof(obj));
+        return obj;
+    }
+
+    /* delete a record by setting its object to VM_INVALID_OBJ */
+    void invalidate_rec(size_t ofs)
+    {
+        vm_obj_id_t obj = VM_INVALID_OBJ;
+        memcpy(arena_ + ofs + 2, &obj, sizeof(obj));
+    }
+
+    /* decode the record at the given offset */
+    void decode_rec(size_t ofs, CVmUndoRecord *rec) const;
+
+    /* 
+     *   Store a record's key and value back into its arena slot, after the
+     *   owning object has had a chance to change it.  The new value must
+     *   fit in the slot's original payload space; returns false if not.  
      */
-    CVmUndoRecord *add_new_record(VMG_ vm_obj_id_t controlling_obj);
+    int rewrite_rec(size_t ofs, const CVmUndoRecord *rec);
+
+    /* reset the arena to empty */
+    void reset_arena()
+    {
+        cur_first_ = oldest_first_ = VMUNDO_NO_REC;
+        next_free_ = 0;
+        wrap_ofs_ = arena_size_;
+    }
 
     /* discard the oldest savepoint */
     void drop_oldest_savept(VMG0_);
@@ -241,27 +358,36 @@ private:
     vm_savept_t max_savepts_;
     
     /* 
-     *   Pointer to the first record in the current savepoint.  This isn't
-     *   a real undo record -- it's a link record.  
+     *   Arena offset of the first record in the current savepoint.  This
+     *   isn't a real undo record -- it's a link record.  
      */
-    CVmUndoMeta *cur_first_;
+    size_t cur_first_;
 
     /*
-     *   Pointer to the first undo record in the oldest savepoint.  This
-     *   is a link record. 
+     *   Arena offset of the first undo record in the oldest savepoint.
+     *   This is a link record.  
      */
-    CVmUndoMeta *oldest_first_;
+    size_t oldest_first_;
 
-    /* pointer to the next free undo record */
-    CVmUndoMeta *next_free_;
+    /* arena offset of the next free byte */
+    size_t next_free_;
+
+    /*
+     *   Wrap point.  When a record doesn't fit in the space remaining at
+     *   the end of the arena, we leave that space unused and continue at
+     *   the start of the arena; this is the offset of the end of the last
+     *   record before the unused space.  When the live records don't wrap,
+     *   this is simply the arena size.  
+     */
+    size_t wrap_ofs_;
 
     /*
-     *   Master array of undo records, and the number of records in this
-     *   list.  We pre-allocate a fixed array of these records.  If we run
-     *   out, we start discarding old undo.  
+     *   The record arena, and its size in bytes.  We allocate the arena
+     *   up front and use it as a circular buffer.  If we run out of space,
+     *   we start discarding old undo.  
      */
-    CVmUndoMeta *rec_arr_;
-    size_t rec_arr_size_;
+    unsigned char *arena_;
+    size_t arena_size_;
 };
 
 
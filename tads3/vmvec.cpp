@@ -474,6 +474,54 @@ void CVmObjVector::new_iterator(VMG_ vm_val_t *retval,
     G_stk->discard();
 }
 
+/*
+ *   Reset a foreach loop iterator.  As in new_iterator(), the iterator has
+ *   to work from a snapshot of the vector.  If the iterator's old snapshot
+ *   is big enough, we copy our elements into it; it's private to the
+ *   iterator, so no one else can see the change.  Otherwise we make a new
+ *   copy.  
+ */
+int CVmObjVector::reset_iterator(VMG_ const vm_val_t *iter,
+                                 const vm_val_t *self_val)
+{
+    vm_val_t copy_val;
+
+    /* we can only reset a foreach loop iterator */
+    if (!CVmObjIterIdx::get_foreach_coll(vmg_ iter, &copy_val))
+        return FALSE;
+
+    /* 
+     *   if the old collection is a vector snapshot with enough space, reuse
+     *   it; otherwise create a new copy 
+     */
+    size_t cnt = get_element_count();
+    CVmObjVector *copy;
+    if (copy_val.typ == VM_OBJ
+        && copy_val.val.obj != self_val->val.obj
+        && is_vector_obj(vmg_ copy_val.val.obj)
+        && (copy = (CVmObjVector *)vm_objp(vmg_ copy_val.val.obj))
+           ->get_allocated_count() >= cnt)
+    {
+        /* copy our elements into the old snapshot */
+        copy->set_element_count(cnt);
+        memcpy(copy->get_element_ptr(0), get_element_ptr(0),
+               calc_alloc_ele(cnt));
+    }
+    else
+    {
+        /* make a new snapshot */
+        copy_val.set_obj(create_copy(vmg_ self_val));
+    }
+
+    /* reset the iterator to run over the snapshot */
+    G_stk->push(&copy_val);
+    CVmObjIterIdx::reset_foreach(vmg_ iter, &copy_val, 1, cnt);
+    G_stk->discard();
+
+    /* reset */
+    return TRUE;
+}
+
 /*
  *   Create a live iterator 
  */
@@ -570,6 +618,38 @@ void CVmObjVector::expand_by(VMG_ vm_obj_id_t self, size_t added_elements)
 }
 
 
+/* ------------------------------------------------------------------------ */
+/*
+ *   Make sure we have space allocated for at least the given number of
+ *   elements 
+ */
+void CVmObjVector::reserve(VMG_ size_t cnt)
+{
+    /* if we already have enough space, there's nothing to do */
+    if (cnt <= get_allocated_count())
+        return;
+
+    /* 
+     *   make sure the new size is legal before we touch the memory, so that
+     *   we don't leave the allocation size out of sync with the block 
+     */
+    if (cnt > 65535)
+        err_throw(VMERR_OUT_OF_RANGE);
+
+    /* reallocate our memory at the new, larger size */
+    ext_ = (char *)G_mem->get_var_heap()->realloc_mem(calc_alloc(cnt),
+                                                      ext_, this);
+
+    /* set the new allocation size */
+    set_allocated_count(cnt);
+
+    /* 
+     *   clear the undo bits (it's easier than moving them, and the only
+     *   cost is that we might generate some redundant undo records) 
+     */
+    clear_undo_bits();
+}
+
 /* ------------------------------------------------------------------------ */
 /*
  *   Append an element, with no undo 
@@ -579,15 +659,7 @@ void CVmObjVector::append_element(VMG_ vm_obj_id_t self, const vm_val_t *val)
     /* expand the vector if necessary */
     size_t cnt = get_element_count();
     if (cnt >= get_allocated_count())
-    {
-        /* expand by 50% of the current size, or at least 5 new elements */
-        int inc = cnt/2;
-        if (inc < 5)
-            inc = 5;
-
-        /* do the expansion */
-        expand_by(vmg_ self, inc);
-    }
+        reserve(vmg_ calc_grow_count(cnt + 1));
 
     /* set the element */
     set_element(cnt, val);
@@ -648,33 +720,7 @@ void CVmObjVector::set_element_count_undo(VMG_ vm_obj_id_t self,
      *   increase the allocated size 
      */
     if (new_ele_cnt > get_allocated_count())
-    {
-        size_t new_alloc_cnt;
-        size_t new_mem_size;
-
-        /* bump up the allocated size */
-        new_alloc_cnt = get_allocated_count() + get_alloc_count_increment();
-
-        /* if that's still not big enough, go up to the requested size */
-        if (new_alloc_cnt < new_ele_cnt)
-            new_alloc_cnt = new_ele_cnt;
-
-        /* get the new size we need */
-        new_mem_size = calc_alloc(new_alloc_cnt);
-
-        /* reallocate our memory at the new, larger size */
-        ext_ = (char *)G_mem->get_var_heap()
-               ->realloc_mem(new_mem_size, ext_, this);
-
-        /* set the new allocation size */
-        set_allocated_count(new_alloc_cnt);
-
-        /* 
-         *   clear the undo bits (it's easier than moving them, and the only
-         *   cost is that we might generate some redundant undo records) 
-         */
-        clear_undo_bits();
-    }
+        reserve(vmg_ calc_grow_count(new_ele_cnt));
 
     /* 
      *   if we're expanding the in-use size of the vector, set each
@@ -1522,6 +1568,10 @@ int CVmObjVector::getp_subset(VMG_ vm_obj_id_t self, vm_val_t *retval,
     /* get the function pointer argument, but leave it on the stack */
     func_val = G_stk->get(0);
 
+    /* resolve the callback once for all of the calls below */
+    vm_cbcall cbc;
+    G_interpreter->prep_callback(vmg_ &cbc, func_val, 1);
+
     /* push a self-reference while allocating to protect from gc */
     G_interpreter->push_obj(vmg_ self);
 
@@ -1564,7 +1614,7 @@ int CVmObjVector::getp_subset(VMG_ vm_obj_id_t self, vm_val_t *retval,
         G_stk->push(&ele);
 
         /* invoke the callback */
-        G_interpreter->call_func_ptr(vmg_ func_val, 1, &rc, 0);
+        G_interpreter->call_prepared(vmg_ &cbc, &rc);
 
         /* get the result from R0 */
         val = G_interpreter->get_r0();
@@ -1620,6 +1670,10 @@ int CVmObjVector::getp_apply_all(VMG_ vm_obj_id_t self, vm_val_t *retval,
     /* get the function pointer argument, but leave it on the stack */
     func_val = G_stk->get(0);
 
+    /* resolve the callback once for all of the calls below */
+    vm_cbcall cbc;
+    G_interpreter->prep_callback(vmg_ &cbc, func_val, 1);
+
     /* push a self-reference while working to protect from gc */
     G_interpreter->push_obj(vmg_ self);
 
@@ -1642,7 +1696,7 @@ int CVmObjVector::getp_apply_all(VMG_ vm_obj_id_t self, vm_val_t *retval,
         push_element(vmg_ idx);
 
         /* invoke the callback */
-        G_interpreter->call_func_ptr(vmg_ func_val, 1, &rc, 0);
+        G_interpreter->call_prepared(vmg_ &cbc, &rc);
 
         /* replace this element with the result */
         set_element_undo(vmg_ self, idx, G_interpreter->get_r0());
@@ -1698,6 +1752,10 @@ int CVmObjVector::gen_index_which(VMG_ vm_obj_id_t self, vm_val_t *retval,
     /* get the function pointer argument, but leave it on the stack */
     func_val = G_stk->get(0);
 
+    /* resolve the callback once for all of the calls below */
+    vm_cbcall cbc;
+    G_interpreter->prep_callback(vmg_ &cbc, func_val, 1);
+
     /* push a self-reference while working to protect from gc */
     G_interpreter->push_obj(vmg_ self);
 
@@ -1729,7 +1787,7 @@ int CVmObjVector::gen_index_which(VMG_ vm_obj_id_t self, vm_val_t *retval,
         push_element(vmg_ idx);
 
         /* invoke the callback */
-        G_interpreter->call_func_ptr(vmg_ func_val, 1, rc, 0);
+        G_interpreter->call_prepared(vmg_ &cbc, rc);
 
         /* 
          *   if the callback returned true, we've found the element we're
@@ -1865,6 +1923,11 @@ int CVmObjVector::for_each_gen(VMG_ vm_obj_id_t self,
     /* get the function pointer argument, but leave it on the stack */
     func_val = G_stk->get(0);
 
+    /* resolve the callback once for all of the calls below */
+    vm_cbcall cbc;
+    G_interpreter->prep_callback(vmg_ &cbc, func_val,
+                                 pass_key_to_cb ? 2 : 1);
+
     /* push a self-reference while working to protect from gc */
     G_interpreter->push_obj(vmg_ self);
 
@@ -1891,8 +1954,7 @@ int CVmObjVector::for_each_gen(VMG_ vm_obj_id_t self,
             G_stk->push()->set_int(idx + 1);
 
         /* invoke the callback */
-        G_interpreter->call_func_ptr(vmg_ func_val, pass_key_to_cb ? 2 : 1,
-                                     rc, 0);
+        G_interpreter->call_prepared(vmg_ &cbc, rc);
     }
 
     /* discard our gc protection (self) and our arguments */
@@ -1922,6 +1984,10 @@ int CVmObjVector::getp_map_all(VMG_ vm_obj_id_t self, vm_val_t *retval,
     /* get the function pointer argument, but leave it on the stack */
     func_val = G_stk->get(0);
 
+    /* resolve the callback once for all of the calls below */
+    vm_cbcall cbc;
+    G_interpreter->prep_callback(vmg_ &cbc, func_val, 1);
+
     /* push a self-reference while working to protect from gc */
     G_interpreter->push_obj(vmg_ self);
 
@@ -1955,7 +2021,7 @@ int CVmObjVector::getp_map_all(VMG_ vm_obj_id_t self, vm_val_t *retval,
         push_element(vmg_ idx);
 
         /* invoke the callback */
-        G_interpreter->call_func_ptr(vmg_ func_val, 1, &rc, 0);
+        G_interpreter->call_prepared(vmg_ &cbc, &rc);
 
         /* 
          *   replace this element with the result (there's no need to save
@@ -2754,8 +2820,11 @@ int CVmObjVector::getp_append(VMG_ vm_obj_id_t self, vm_val_t *retval,
     /* expand myself by one element to make room for the addition */
     expand_by(vmg_ self, 1);
 
-    /* add the new element, saving undo */
-    set_element_undo(vmg_ self, cnt, valp);
+    /* 
+     *   add the new element - we don't need undo for it, since undoing the
+     *   size change will truncate the vector to exclude it 
+     */
+    set_element(cnt, valp);
 
     /* discard the argument and gc protection */
     G_stk->discard(2);
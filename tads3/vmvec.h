@@ -271,6 +271,10 @@ protected:
     virtual void new_live_iterator(VMG_ vm_val_t *retval,
                                    const vm_val_t *self_val);
 
+    /* reset a foreach loop iterator to iterate over a copy of this vector */
+    virtual int reset_iterator(VMG_ const vm_val_t *iter,
+                               const vm_val_t *self_val);
+
     /* create a copy of the object */
     vm_obj_id_t create_copy(VMG_ const vm_val_t *self_val);
 
@@ -319,6 +323,9 @@ protected:
 
     /* notify of deletion */
     void notify_delete(VMG_ int in_root_set);
+    /* report our memory use */
+    size_t get_mem_usage(VMG_ int) const
+        { return get_ext_heap_bytes(vmg0_); }
 
     /* allocate space for the vector, given the number of elements */
     void alloc_vector(VMG_ size_t element_count);
@@ -326,16 +333,41 @@ protected:
     /* expand to accommodate the given number of new elements */
     void expand_by(VMG_ vm_obj_id_t self, size_t added_elements);
 
-    /* get the allocation count increment */
-    size_t get_alloc_count_increment() const
+    /* 
+     *   Figure the new allocation size when we need room for 'needed'
+     *   elements.  We grow by half of the current allocation, so that a
+     *   loop that appends one element at a time reallocates only a
+     *   logarithmic number of times, but by at least a minimum increment,
+     *   so that small vectors don't creep up a few elements at a time.  
+     */
+    size_t calc_grow_count(size_t needed) const
     {
+        /* bump up the allocated size */
+        size_t inc = get_allocated_count()/2;
+        size_t cnt = get_allocated_count() + (inc < 16 ? 16 : inc);
+
+        /* if that's still not big enough, go up to the requested size */
+        if (cnt < needed)
+            cnt = needed;
+
         /* 
-         *   we might want to make this parameterizable; for now use a
-         *   fixed increment size 
+         *   don't let the growth increment alone push us past the maximum
+         *   size; only fail if the caller is actually asking for that many 
          */
-        return 16;
+        if (cnt > 65535 && needed <= 65535)
+            cnt = 65535;
+
+        /* return the new size */
+        return cnt;
     }
 
+    /* 
+     *   make sure we have space allocated for at least the given number of
+     *   elements, reallocating our extension if necessary; this doesn't
+     *   change the element count 
+     */
+    void reserve(VMG_ size_t cnt);
+
     /* push an element onto the stack */
     void push_element(VMG_ size_t idx) const
     {
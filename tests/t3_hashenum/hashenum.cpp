@@ -0,0 +1,140 @@
+/*
+ *   Please see the accompanying license file, LICENSE.TXT, for information
+ *   on using and copying this software.
+ */
+/*
+Name
+  hashenum.cpp - test of T3 hash table enumeration with a throwing callback
+Function
+  Enumerates a hash table with callbacks that throw, the way an
+  intrinsic's callback can throw a run-time error out of forEachWord(),
+  and checks that the table still grows when entries are added after
+  each enumeration.  The table puts off growing while an enumeration is
+  in progress, so an enumeration that didn't end when its callback threw
+  would keep it from ever growing again.
+Notes
+  Only the hash table and the error handler are linked in, so we supply
+  the couple of osifc routines they refer to, which live in the front end.
+Modified
+  10/15/26  - Creation
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "t3std.h"
+#include "vmerr.h"
+#include "vmhash.h"
+
+/* 
+ *   Stand-ins for the front end's osifc routines.  We never load a message
+ *   file, so osfrb() is never called; the case-insensitive hash entries
+ *   aren't used here, but they're in the same file.  
+ */
+int osfrb(osfildef *fp, void *buf, int bufl) { return 1; }
+int memicmp(const char *s1, const char *s2, size_t len)
+    { return memcmp(s1, s2, len); }
+
+/* number of buckets we start with */
+#define TEST_TABLE_SIZE  16
+
+/* error code our callbacks throw */
+#define TEST_ERR  1
+
+/* callback: throw on the first entry */
+static void throw_cb(void *ctx, CVmHashEntry *entry)
+{
+    ++*(int *)ctx;
+    err_throw(TEST_ERR);
+}
+
+/* 
+ *   Run one of the table's enumerations with the throwing callback.
+ *   Returns true if the error came out of the enumeration after the
+ *   callback was called.  
+ */
+static int enum_throw(CVmHashTable *tab, int which)
+{
+    int calls = 0;
+    int caught = FALSE;
+
+    err_try
+    {
+        switch (which)
+        {
+        case 0:
+            tab->enum_entries(throw_cb, &calls);
+            break;
+
+        case 1:
+            tab->safe_enum_entries(throw_cb, &calls);
+            break;
+
+        case 2:
+            tab->enum_hash_matches("entry0", 6, throw_cb, &calls);
+            break;
+        }
+    }
+    err_catch_disc
+    {
+        caught = TRUE;
+    }
+    err_end;
+
+    return caught && calls == 1;
+}
+
+/* add 'cnt' more entries to the table, numbering them from 'first' */
+static void add_entries(CVmHashTable *tab, int first, int cnt)
+{
+    for (int i = first ; i < first + cnt ; ++i)
+    {
+        char buf[32];
+        sprintf(buf, "entry%d", i);
+        tab->add(new CVmHashEntryCS(buf, strlen(buf), TRUE));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static const char *const names[] = {
+        "enum_entries", "safe_enum_entries", "enum_hash_matches"
+    };
+    int ok = TRUE;
+
+    err_init(1024);
+
+    for (int which = 0 ; which < 3 ; ++which)
+    {
+        CVmHashTable tab(TEST_TABLE_SIZE, new CVmHashFuncCS(), TRUE);
+
+        /* start with one entry, and throw out of an enumeration */
+        add_entries(&tab, 0, 1);
+        if (!enum_throw(&tab, which))
+        {
+            printf("%s: the error didn't come through\n", names[which]);
+            ok = FALSE;
+            continue;
+        }
+
+        /* 
+         *   fill the table well past its load limit - it must grow now
+         *   that no enumeration is in progress 
+         */
+        add_entries(&tab, 1, TEST_TABLE_SIZE * 8);
+        size_t size = tab.get_table_size();
+        printf("%s: %lu entries in %lu buckets\n", names[which],
+               (unsigned long)tab.get_entry_count(), (unsigned long)size);
+        if (size <= TEST_TABLE_SIZE)
+            ok = FALSE;
+
+        /* the new entries must all be found */
+        if (tab.find("entry100", 8) == 0)
+            ok = FALSE;
+    }
+
+    err_terminate();
+
+    printf(ok ? "PASS\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
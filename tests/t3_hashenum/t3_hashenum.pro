@@ -0,0 +1,17 @@
+QT = core
+TEMPLATE = app
+CONFIG += console testcase warn_off
+CONFIG -= app_bundle
+TARGET = t3_hashenum
+
+T3DIR = ../../tads3
+
+DEFINES += TROLLTECH_QT _M_QT VMGLOB_VARS
+INCLUDEPATH += ../../src ../../tads2 $$T3DIR
+DEPENDPATH += $$T3DIR
+
+SOURCES += \
+    hashenum.cpp \
+    $$T3DIR/vmerr.cpp \
+    $$T3DIR/vmerrmsg.cpp \
+    $$T3DIR/vmhash.cpp
@@ -0,0 +1,177 @@
+/*
+ *   Please see the accompanying license file, LICENSE.TXT, for information
+ *   on using and copying this software.
+ */
+/*
+Name
+  objcache.c - test of the TADS 2 inherited property lookup cache
+Function
+  Loads two games in sequence, each with its own cache manager, and
+  checks that a property lookup in the second game doesn't return the
+  result cached for the same object and property in the first one.  The
+  two games give the same object the same property at different offsets,
+  the way two different game files would.
+Notes
+  The games are loaded through the cache manager's load callback, the
+  way fio.c loads a game file, since loading an object doesn't touch it.
+  The second game's contexts are the same size as the first one's, so the
+  allocator will usually hand out the same addresses again; that's the
+  case the test is really about.
+Modified
+  10/15/26  - Creation
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "os.h"
+#include "std.h"
+#include "err.h"
+#include "mch.h"
+#include "mcm.h"
+#include "obj.h"
+#include "prp.h"
+
+/* the object we look up, and its property */
+#define TEST_OBJ   0
+#define TEST_PROP  10
+
+/* an object image to load */
+struct test_img
+{
+    uchar buf[256];
+    ushort siz;
+};
+
+/* 
+ *   The swap manager is linked in for its context, but we never swap, so
+ *   it never does any file I/O.  These stand in for the osifc routines it
+ *   refers to, which live in the front end.
+ */
+int osfrb(osfildef *fp, void *buf, int bufl) { return 1; }
+int osfwb(osfildef *fp, const void *buf, int bufl) { return 1; }
+int osfseek(osfildef *fp, long pos, int mode) { return 1; }
+
+/* log an error - we don't expect any */
+static void test_logerr(void *ctx, char *fac, int err, int argc, erradef *argv)
+{
+    printf("error %s-%d\n", fac, err);
+}
+
+/* load callback: copy the object image into the cache */
+static void test_load(void *ctx, mclhd handle, uchar *ptr, ushort siz)
+{
+    struct test_img *img = (struct test_img *)handle;
+
+    memcpy(ptr, img->buf, img->siz);
+}
+
+/*
+ *   Build the image of an object that defines each of the 'cnt' properties
+ *   in 'props', in that order, so the last one ends up further into the
+ *   object the more properties come before it.
+ */
+static void build_img(errcxdef *ec, struct test_img *img,
+                      const prpnum *props, int cnt)
+{
+    mcmcx1def *gctx;
+    mcmcxdef  *ctx;
+    objnum     objn;
+    objdef    *o;
+    uchar      val[4];
+    int        i;
+
+    gctx = mcmini(0, 16, 0, (osfildef *)0, (char *)0, ec);
+    ctx = mcmcini(gctx, 16, test_load, 0, objrevert, 0);
+    objnew(ctx, 0, 64, &objn, FALSE);
+    mcmunlck(ctx, objn);
+    for (i = 0 ; i < cnt ; ++i)
+    {
+        oswp4(val, i + 1);
+        objsetp(ctx, objn, props[i], DAT_NUMBER, val, (objucxdef *)0);
+    }
+
+    o = (objdef *)mcmlck(ctx, objn);
+    img->siz = objfree(o);
+    memcpy(img->buf, o, img->siz);
+    mcmunlck(ctx, objn);
+
+    mcmcterm(ctx);
+    mcmterm(gctx);
+}
+
+/*
+ *   Load a game consisting of the one object in 'img', look up our
+ *   property in it, and shut the game down again.  Returns the offset of
+ *   the property as found through the lookup cache; '*directp' gets the
+ *   offset found by searching the object directly, and '*ctxp' the address
+ *   of the client context.
+ */
+static uint run_game(errcxdef *ec, struct test_img *img, uint *directp,
+                     void **ctxp)
+{
+    mcmcx1def *gctx;
+    mcmcxdef  *ctx;
+    uint       ofs;
+
+    gctx = mcmini(0, 16, 0, (osfildef *)0, (char *)0, ec);
+    ctx = mcmcini(gctx, 16, test_load, 0, objrevert, 0);
+    ctx->mcmcxrvc = ctx;
+    mcmrsrv(ctx, (ushort)img->siz, TEST_OBJ, (mclhd)img);
+
+    ofs = objgetap(ctx, TEST_OBJ, TEST_PROP, (objnum *)0, FALSE);
+    *directp = objgetp(ctx, TEST_OBJ, TEST_PROP, (dattyp *)0);
+    *ctxp = ctx;
+
+    mcmcterm(ctx);
+    mcmterm(gctx);
+    return ofs;
+}
+
+int main(int argc, char **argv)
+{
+    errcxdef        errctx;
+    static const prpnum props1[] = { TEST_PROP };
+    static const prpnum props2[] = { 5, 6, TEST_PROP };
+    struct test_img img1;
+    struct test_img img2;
+    uint            ofs1;
+    uint            ofs2;
+    uint            want1;
+    uint            want2;
+    void           *ctx1;
+    void           *ctx2;
+    int             err;
+
+    memset(&errctx, 0, sizeof(errctx));
+    errctx.errcxlog = test_logerr;
+    errctx.errcxlgc = &errctx;
+
+    ERRBEGIN(&errctx)
+    {
+        /* build the two games' objects */
+        build_img(&errctx, &img1, props1, 1);
+        build_img(&errctx, &img2, props2, 3);
+
+        /* run the first game and then the second */
+        ofs1 = run_game(&errctx, &img1, &want1, &ctx1);
+        ofs2 = run_game(&errctx, &img2, &want2, &ctx2);
+    }
+    ERRCATCH(&errctx, err)
+    {
+        printf("FAIL: error %d while loading\n", err);
+        return 1;
+    }
+    ERREND(&errctx)
+
+    printf("first game: offset %u, expected %u\n", ofs1, want1);
+    printf("second game: offset %u, expected %u%s\n", ofs2, want2,
+           ctx1 == ctx2 ? " (same context address)" : "");
+    if (ofs1 == 0 || ofs1 != want1 || ofs2 != want2 || want1 == want2)
+    {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,27 @@
+QT = core
+TEMPLATE = app
+CONFIG += console testcase warn_off
+CONFIG -= app_bundle
+TARGET = tads2_objcache
+
+T2DIR = ../../tads2
+
+DEFINES += TROLLTECH_QT _M_QT
+INCLUDEPATH += ../../src $$T2DIR
+DEPENDPATH += $$T2DIR
+
+# Test the same cache manager QTads is built with (see qtads.pro).
+t2_paged_mcm {
+    SOURCES += $$T2DIR/mcm.c
+} else {
+    DEFINES += MCM_FLAT
+    SOURCES += $$T2DIR/mcmflat.c
+}
+
+SOURCES += \
+    objcache.c \
+    $$T2DIR/dat.c \
+    $$T2DIR/ler.c \
+    $$T2DIR/mch.c \
+    $$T2DIR/mcs.c \
+    $$T2DIR/obj.c
@@ -0,0 +1,5 @@
+# Unit tests for the portable Tads code.  These don't need the QTads front
+# end; build them with "qmake && make" in this directory and run them with
+# "make check".
+TEMPLATE = subdirs
+SUBDIRS = tads2_objcache t3_hashenum